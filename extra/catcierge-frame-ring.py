@@ -0,0 +1,129 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+#
+# Reads the frames catcierge_grabber shares with --frame_ring.
+# See src/catcierge_frame_ring.h for the layout.
+#
+import argparse
+import mmap
+import os
+import struct
+import sys
+import time
+
+MAGIC = 0x47524643
+VERSION = 1
+
+# magic, version, slot_count, header_size, slot_size, frame_seq, writer_pid
+HEADER = struct.Struct("=IIIIQQI")
+FRAME_SEQ_OFFSET = 24
+
+# lock, frame_seq, tv_sec, tv_usec, width, height, channels, stride, size
+SLOT = struct.Struct("=QQqqIIIII")
+SLOT_SIZE = 64
+
+class FrameRing(object):
+	def __init__(self, name):
+		fd = os.open("/dev/shm/" + name.lstrip("/"), os.O_RDONLY)
+		try:
+			self.map = mmap.mmap(fd, 0, mmap.MAP_SHARED, mmap.PROT_READ)
+		finally:
+			os.close(fd)
+
+		(magic, version, self.slot_count, self.header_size,
+			self.slot_size, _, self.writer_pid) = HEADER.unpack_from(self.map, 0)
+
+		if magic != MAGIC or version != VERSION:
+			raise ValueError("%s is not a catcierge frame ring" % name)
+
+	def latest(self):
+		return struct.unpack_from("=Q", self.map, FRAME_SEQ_OFFSET)[0]
+
+	def read(self, frame_seq):
+		"""
+		Returns (info, pixels) or None if the frame was overwritten
+		or is being written.
+		"""
+		if frame_seq == 0 or frame_seq > self.latest():
+			return None
+
+		offset = self.header_size + ((frame_seq - 1) % self.slot_count) * self.slot_size
+		slot = SLOT.unpack_from(self.map, offset)
+		lock = slot[0]
+
+		if (lock & 1) or slot[1] != frame_seq:
+			return None
+
+		size = min(slot[8], self.slot_size - SLOT_SIZE)
+		pixels = self.map[offset + SLOT_SIZE:offset + SLOT_SIZE + size]
+
+		# The seqlock, the slot was rewritten while it was copied.
+		if struct.unpack_from("=Q", self.map, offset)[0] != lock:
+			return None
+
+		info = {
+			"frame_seq": slot[1],
+			"time": slot[2] + slot[3] / 1000000.0,
+			"width": slot[4],
+			"height": slot[5],
+			"channels": slot[6],
+			"stride": slot[7]
+		}
+
+		return info, pixels
+
+def save_pnm(path, info, pixels):
+	w, h, c, stride = info["width"], info["height"], info["channels"], info["stride"]
+
+	with open(path, "wb") as f:
+		f.write(("P%d\n%d %d\n255\n" % (5 if c == 1 else 6, w, h)).encode("ascii"))
+
+		for y in range(h):
+			row = pixels[y * stride:y * stride + w * c]
+
+			# OpenCV stores color as BGR.
+			if c == 3:
+				row = bytearray(row)
+				row[0::3], row[2::3] = row[2::3], row[0::3]
+
+			f.write(bytes(row))
+
+def main():
+	parser = argparse.ArgumentParser(description="Follow the frames of a catcierge frame ring")
+	parser.add_argument("name", help="The --frame_ring name, such as /catcierge")
+	parser.add_argument("--save", metavar="DIR", help="Save each frame as PGM/PPM in this directory")
+	parser.add_argument("--count", type=int, default=0, help="Stop after this many frames")
+	args = parser.parse_args()
+
+	ring = FrameRing(args.name)
+	print("%d slots of %d bytes, written by pid %d" % (ring.slot_count, ring.slot_size, ring.writer_pid))
+
+	last = ring.latest()
+	count = 0
+
+	while not args.count or count < args.count:
+		latest = ring.latest()
+
+		if latest == last:
+			time.sleep(0.01)
+			continue
+
+		# Only the latest frame, older ones are skipped when we fall behind.
+		frame = ring.read(latest)
+		last = latest
+
+		if not frame:
+			print("Frame %d was overwritten" % latest)
+			continue
+
+		info, pixels = frame
+		count += 1
+		print("Frame %d %dx%dx%d at %.3f" % (info["frame_seq"],
+			info["width"], info["height"], info["channels"], info["time"]))
+
+		if args.save:
+			save_pnm(os.path.join(args.save, "frame_%08d.%s" % (info["frame_seq"],
+				"pgm" if info["channels"] == 1 else "ppm")), info, pixels)
+
+if __name__ == "__main__":
+	sys.exit(main())
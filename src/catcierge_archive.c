@@ -0,0 +1,1154 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _WIN32
+#define _FILE_OFFSET_BITS 64 // Archives can grow past 2GB.
+#endif
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "catcierge_config.h"
+#include "catcierge_archive.h"
+#include "catcierge_util.h"
+#include "catcierge_log.h"
+
+#ifdef _WIN32
+#include <io.h>
+#define catcierge_fseek _fseeki64
+#define catcierge_ftell _ftelli64
+#define catcierge_ftruncate(f, size) _chsize_s(_fileno(f), size)
+#else
+#include <unistd.h>
+#define catcierge_fseek fseeko
+#define catcierge_ftell ftello
+#define catcierge_ftruncate(f, size) ftruncate(fileno(f), size)
+#endif
+
+#ifdef CATCIERGE_HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#define CATCIERGE_ARCHIVE_MAGIC "CCAR"
+#define CATCIERGE_ARCHIVE_INDEX_MAGIC "CCAI"
+#define CATCIERGE_ARCHIVE_RECORD_MAGIC "CCRG"
+
+static void catcierge_archive_write_header(unsigned char *b, const char *magic, uint32_t size)
+{
+	memset(b, 0, CATCIERGE_ARCHIVE_HEADER_SIZE);
+	memcpy(b, magic, 4);
+	catcierge_put_u32(b + 4, CATCIERGE_ARCHIVE_VERSION);
+	catcierge_put_u32(b + 8, size);
+}
+
+static int catcierge_archive_check_header(FILE *f, const char *magic, uint32_t size)
+{
+	unsigned char b[CATCIERGE_ARCHIVE_HEADER_SIZE];
+
+	if ((catcierge_fseek(f, 0, SEEK_SET) != 0)
+		|| (fread(b, 1, sizeof(b), f) != sizeof(b))
+		|| memcmp(b, magic, 4)
+		|| (catcierge_get_u32(b + 8) != size))
+	{
+		return -1;
+	}
+
+	if (catcierge_get_u32(b + 4) > CATCIERGE_ARCHIVE_VERSION)
+	{
+		CATERR("Archive version %u is newer than the supported version %d\n",
+			catcierge_get_u32(b + 4), CATCIERGE_ARCHIVE_VERSION);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int64_t catcierge_archive_file_size(FILE *f)
+{
+	if (catcierge_fseek(f, 0, SEEK_END))
+		return -1;
+
+	return catcierge_ftell(f);
+}
+
+static void catcierge_archive_encode_index(unsigned char *b, const catcierge_archive_index_entry_t *e)
+{
+	memset(b, 0, CATCIERGE_ARCHIVE_INDEX_ENTRY_SIZE);
+	catcierge_put_u64(b, e->time_us);
+	catcierge_put_u64(b + 8, e->offset);
+	catcierge_put_u32(b + 16, e->size);
+	b[20] = (unsigned char)e->match_count;
+	b[21] = (unsigned char)e->success;
+	b[22] = (unsigned char)(e->direction + 1);
+	memcpy(b + 24, e->id, strlen(e->id));
+}
+
+static void catcierge_archive_decode_index(const unsigned char *b, catcierge_archive_index_entry_t *e)
+{
+	e->time_us = catcierge_get_u64(b);
+	e->offset = catcierge_get_u64(b + 8);
+	e->size = catcierge_get_u32(b + 16);
+	e->match_count = b[20];
+	e->success = b[21];
+	e->direction = (match_direction_t)((int)b[22] - 1);
+	memcpy(e->id, b + 24, CATCIERGE_ARCHIVE_ID_SIZE);
+	e->id[CATCIERGE_ARCHIVE_ID_SIZE] = '\0';
+}
+
+//
+// Record header:
+//  0  "CCRG"
+//  4  u32 Record size including the header.
+//  8  u32 CRC32 of everything after the header.
+//  12 u16 Entry count.
+//  14 u8  Match count.
+//  15 u8  Success.
+//  16 u64 Match group start time in microseconds.
+//  24 u8  Direction + 1.
+//  32 Match group ID.
+//
+// Each entry:
+//  0  u8  Type.
+//  1  u8  Image format.
+//  2  u8  Match index.
+//  3  u8  Step index.
+//  4  u16 Name length.
+//  8  u32 Data length.
+//  12 Name, followed by the data.
+//
+static void catcierge_archive_decode_record_header(const unsigned char *b,
+		uint64_t offset, catcierge_archive_index_entry_t *e)
+{
+	memset(e, 0, sizeof(*e));
+	e->offset = offset;
+	e->size = catcierge_get_u32(b + 4);
+	e->match_count = b[14];
+	e->success = b[15];
+	e->time_us = catcierge_get_u64(b + 16);
+	e->direction = (match_direction_t)((int)b[24] - 1);
+	memcpy(e->id, b + 32, CATCIERGE_ARCHIVE_ID_SIZE);
+	e->id[CATCIERGE_ARCHIVE_ID_SIZE] = '\0';
+}
+
+// Reads and validates the record at offset. The returned buffer
+// holds the whole record, header included.
+static unsigned char *catcierge_archive_read_record(FILE *f, uint64_t offset,
+		uint64_t end, catcierge_archive_index_entry_t *e)
+{
+	unsigned char header[CATCIERGE_ARCHIVE_RECORD_HEADER_SIZE];
+	unsigned char *buf = NULL;
+	uint32_t size;
+
+	if (((end - offset) < sizeof(header))
+		|| catcierge_fseek(f, (int64_t)offset, SEEK_SET)
+		|| (fread(header, 1, sizeof(header), f) != sizeof(header))
+		|| memcmp(header, CATCIERGE_ARCHIVE_RECORD_MAGIC, 4))
+	{
+		return NULL;
+	}
+
+	size = catcierge_get_u32(header + 4);
+
+	if ((size < sizeof(header))
+		|| (size > CATCIERGE_ARCHIVE_MAX_RECORD_SIZE)
+		|| (size > (end - offset)))
+	{
+		return NULL;
+	}
+
+	if (!(buf = malloc(size)))
+	{
+		CATERR("Out of memory!\n");
+		return NULL;
+	}
+
+	memcpy(buf, header, sizeof(header));
+
+	if ((fread(buf + sizeof(header), 1, size - sizeof(header), f) != (size - sizeof(header)))
+		|| (catcierge_crc32(buf + sizeof(header), size - sizeof(header)) != catcierge_get_u32(header + 8)))
+	{
+		free(buf);
+		return NULL;
+	}
+
+	if (e)
+	{
+		catcierge_archive_decode_record_header(header, offset, e);
+	}
+
+	return buf;
+}
+
+// Calls back for each valid record from offset until the first invalid
+// one and returns the end of the last valid record.
+static uint64_t catcierge_archive_scan(FILE *f, uint64_t offset, uint64_t end,
+		int (*cb)(const catcierge_archive_index_entry_t *e, void *user), void *user)
+{
+	catcierge_archive_index_entry_t e;
+	unsigned char *buf;
+
+	while ((buf = catcierge_archive_read_record(f, offset, end, &e)))
+	{
+		free(buf);
+
+		if (cb(&e, user))
+		{
+			break;
+		}
+
+		offset += e.size;
+	}
+
+	return offset;
+}
+
+void catcierge_archive_record_init(catcierge_archive_record_t *r)
+{
+	assert(r);
+	memset(r, 0, sizeof(*r));
+	r->direction = MATCH_DIR_UNKNOWN;
+}
+
+void catcierge_archive_record_free(catcierge_archive_record_t *r)
+{
+	size_t i;
+	catcierge_archive_entry_t *entry;
+	assert(r);
+
+	for (i = 0; i < r->entry_count; i++)
+	{
+		entry = &r->entries[i];
+		catcierge_xfree(&entry->name);
+
+		if (!r->buf)
+		{
+			catcierge_xfree(&entry->data);
+		}
+
+		if (entry->img)
+		{
+			cvReleaseImage(&entry->img);
+		}
+	}
+
+	catcierge_xfree(&r->entries);
+	catcierge_xfree(&r->buf);
+	catcierge_archive_record_init(r);
+}
+
+static catcierge_archive_entry_t *catcierge_archive_record_add(catcierge_archive_record_t *r,
+		catcierge_archive_entry_type_t type, const char *name)
+{
+	catcierge_archive_entry_t *entries;
+	catcierge_archive_entry_t *entry;
+
+	if (r->entry_count >= CATCIERGE_ARCHIVE_MAX_ENTRIES)
+	{
+		CATERR("Too many archive entries\n");
+		return NULL;
+	}
+
+	if (r->entry_count == r->entry_size)
+	{
+		size_t size = r->entry_size ? (r->entry_size * 2) : 16;
+
+		if (!(entries = realloc(r->entries, size * sizeof(catcierge_archive_entry_t))))
+		{
+			CATERR("Out of memory!\n");
+			return NULL;
+		}
+
+		r->entries = entries;
+		r->entry_size = size;
+	}
+
+	entry = &r->entries[r->entry_count];
+	memset(entry, 0, sizeof(*entry));
+	entry->type = type;
+
+	if (!(entry->name = strdup(name)))
+	{
+		CATERR("Out of memory!\n");
+		return NULL;
+	}
+
+	r->entry_count++;
+
+	return entry;
+}
+
+int catcierge_archive_record_add_data(catcierge_archive_record_t *r,
+		catcierge_archive_entry_type_t type, const char *name,
+		unsigned char *data, size_t data_len)
+{
+	catcierge_archive_entry_t *entry;
+	assert(r);
+	assert(name);
+	assert(!r->buf);
+
+	if (!(entry = catcierge_archive_record_add(r, type, name)))
+	{
+		free(data);
+		return -1;
+	}
+
+	entry->data = data;
+	entry->data_len = data_len;
+
+	return 0;
+}
+
+int catcierge_archive_record_add_image(catcierge_archive_record_t *r,
+		catcierge_archive_entry_type_t type, const char *name,
+		IplImage *img, int match, int step)
+{
+	catcierge_archive_entry_t *entry;
+	assert(r);
+	assert(name);
+	assert(img);
+	assert(!r->buf);
+
+	if (!(entry = catcierge_archive_record_add(r, type, name)))
+	{
+		cvReleaseImage(&img);
+		return -1;
+	}
+
+	entry->img = img;
+	entry->match = match;
+	entry->step = step;
+
+	return 0;
+}
+
+int catcierge_archive_record_encode(catcierge_archive_record_t *r,
+		catcierge_image_format_t format, int png_compression)
+{
+	size_t i;
+	int ret = 0;
+	catcierge_archive_entry_t *entry;
+	assert(r);
+
+	for (i = 0; i < r->entry_count; i++)
+	{
+		entry = &r->entries[i];
+
+		if (!entry->img)
+			continue;
+
+		if (!(entry->data = catcierge_image_encode(entry->img, format,
+				png_compression, &entry->data_len)))
+		{
+			CATERR("Failed to encode archive image %s\n", entry->name);
+			ret = -1;
+		}
+
+		entry->format = format;
+		cvReleaseImage(&entry->img);
+	}
+
+	return ret;
+}
+
+static int catcierge_archive_open_index(catcierge_archive_t *a, const char *index_path)
+{
+	unsigned char header[CATCIERGE_ARCHIVE_HEADER_SIZE];
+
+	if ((a->index = fopen(index_path, "r+b")))
+	{
+		if (!catcierge_archive_check_header(a->index, CATCIERGE_ARCHIVE_INDEX_MAGIC,
+				CATCIERGE_ARCHIVE_INDEX_ENTRY_SIZE))
+		{
+			return 0;
+		}
+
+		CATERR("Invalid archive index %s, rebuilding it\n", index_path);
+		fclose(a->index);
+	}
+
+	if (!(a->index = fopen(index_path, "w+b")))
+	{
+		CATERR("Failed to create archive index %s\n", index_path);
+		return -1;
+	}
+
+	catcierge_archive_write_header(header, CATCIERGE_ARCHIVE_INDEX_MAGIC,
+		CATCIERGE_ARCHIVE_INDEX_ENTRY_SIZE);
+
+	if ((fwrite(header, 1, sizeof(header), a->index) != sizeof(header))
+		|| fflush(a->index))
+	{
+		CATERR("Failed to write archive index %s\n", index_path);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int catcierge_archive_write_index_entry(const catcierge_archive_index_entry_t *e, void *user)
+{
+	FILE *index = (FILE *)user;
+	unsigned char b[CATCIERGE_ARCHIVE_INDEX_ENTRY_SIZE];
+
+	catcierge_archive_encode_index(b, e);
+
+	if ((catcierge_fseek(index, 0, SEEK_END) != 0)
+		|| (fwrite(b, 1, sizeof(b), index) != sizeof(b)))
+	{
+		CATERR("Failed to write archive index entry\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+// Makes sure the index covers all the records in the archive, and
+// cuts off anything written after the last complete record.
+static int catcierge_archive_repair(catcierge_archive_t *a)
+{
+	int64_t data_size;
+	int64_t index_size;
+	uint64_t count;
+	uint64_t end = CATCIERGE_ARCHIVE_HEADER_SIZE;
+	uint64_t valid_end;
+	unsigned char b[CATCIERGE_ARCHIVE_INDEX_ENTRY_SIZE];
+	catcierge_archive_index_entry_t e;
+
+	if (((data_size = catcierge_archive_file_size(a->data)) < 0)
+		|| ((index_size = catcierge_archive_file_size(a->index)) < 0))
+	{
+		return -1;
+	}
+
+	count = (index_size - CATCIERGE_ARCHIVE_INDEX_HEADER_SIZE) / CATCIERGE_ARCHIVE_INDEX_ENTRY_SIZE;
+
+	if (count > 0)
+	{
+		if (catcierge_fseek(a->index, (int64_t)(CATCIERGE_ARCHIVE_INDEX_HEADER_SIZE
+				+ (count - 1) * CATCIERGE_ARCHIVE_INDEX_ENTRY_SIZE), SEEK_SET)
+			|| (fread(b, 1, sizeof(b), a->index) != sizeof(b)))
+		{
+			return -1;
+		}
+
+		catcierge_archive_decode_index(b, &e);
+		end = e.offset + e.size;
+
+		// The index points past the records, start over.
+		if (end > (uint64_t)data_size)
+		{
+			CATERR("Archive index %s is ahead of the archive, rebuilding it\n", a->path);
+			count = 0;
+			end = CATCIERGE_ARCHIVE_HEADER_SIZE;
+		}
+	}
+
+	// Drop any partly written index entry.
+	if ((uint64_t)index_size != (CATCIERGE_ARCHIVE_INDEX_HEADER_SIZE
+			+ count * CATCIERGE_ARCHIVE_INDEX_ENTRY_SIZE))
+	{
+		if (fflush(a->index) || catcierge_ftruncate(a->index,
+			(int64_t)(CATCIERGE_ARCHIVE_INDEX_HEADER_SIZE + count * CATCIERGE_ARCHIVE_INDEX_ENTRY_SIZE)))
+		{
+			CATERR("Failed to truncate archive index of %s\n", a->path);
+			return -1;
+		}
+	}
+
+	if (end < (uint64_t)data_size)
+	{
+		valid_end = catcierge_archive_scan(a->data, end, (uint64_t)data_size,
+						catcierge_archive_write_index_entry, a->index);
+
+		if (valid_end < (uint64_t)data_size)
+		{
+			CATERR("Archive %s has %lld bytes of incomplete records at the end, removing them\n",
+				a->path, (long long)((uint64_t)data_size - valid_end));
+
+			if (fflush(a->data) || catcierge_ftruncate(a->data, (int64_t)valid_end))
+			{
+				CATERR("Failed to truncate archive %s\n", a->path);
+				return -1;
+			}
+		}
+
+		end = valid_end;
+	}
+
+	if (fflush(a->index) || ((index_size = catcierge_archive_file_size(a->index)) < 0))
+	{
+		return -1;
+	}
+
+	a->size = end;
+	a->record_count = (unsigned long)((index_size - CATCIERGE_ARCHIVE_INDEX_HEADER_SIZE)
+						/ CATCIERGE_ARCHIVE_INDEX_ENTRY_SIZE);
+
+	return 0;
+}
+
+int catcierge_archive_open(catcierge_archive_t *a, const char *path)
+{
+	char *index_path = NULL;
+	unsigned char header[CATCIERGE_ARCHIVE_HEADER_SIZE];
+	assert(a);
+	assert(path);
+	memset(a, 0, sizeof(*a));
+
+	if (!(a->path = strdup(path))
+		|| !(index_path = malloc(strlen(path) + 5)))
+	{
+		CATERR("Out of memory!\n");
+		goto fail;
+	}
+
+	sprintf(index_path, "%s.idx", path);
+
+	if ((a->data = fopen(path, "r+b")))
+	{
+		if (catcierge_archive_check_header(a->data, CATCIERGE_ARCHIVE_MAGIC,
+				CATCIERGE_ARCHIVE_RECORD_HEADER_SIZE))
+		{
+			CATERR("%s is not a catcierge archive\n", path);
+			goto fail;
+		}
+	}
+	else
+	{
+		if (!(a->data = fopen(path, "w+b")))
+		{
+			CATERR("Failed to create archive %s\n", path);
+			goto fail;
+		}
+
+		catcierge_archive_write_header(header, CATCIERGE_ARCHIVE_MAGIC,
+			CATCIERGE_ARCHIVE_RECORD_HEADER_SIZE);
+
+		if ((fwrite(header, 1, sizeof(header), a->data) != sizeof(header))
+			|| fflush(a->data))
+		{
+			CATERR("Failed to write archive header to %s\n", path);
+			goto fail;
+		}
+
+		// Any old index belongs to some other archive.
+		remove(index_path);
+	}
+
+	if (catcierge_archive_open_index(a, index_path)
+		|| catcierge_archive_repair(a))
+	{
+		CATERR("Failed to open archive index %s\n", index_path);
+		goto fail;
+	}
+
+	CATLOG("Opened archive %s with %lu match groups\n", path, a->record_count);
+	free(index_path);
+
+	return 0;
+
+fail:
+	catcierge_xfree(&index_path);
+	catcierge_archive_close(a);
+	return -1;
+}
+
+void catcierge_archive_close(catcierge_archive_t *a)
+{
+	assert(a);
+
+	if (a->data)
+	{
+		fclose(a->data);
+		a->data = NULL;
+	}
+
+	if (a->index)
+	{
+		fclose(a->index);
+		a->index = NULL;
+	}
+
+	catcierge_xfree(&a->path);
+}
+
+int catcierge_archive_switch(catcierge_archive_t *a, const char *path)
+{
+	char *dir = NULL;
+	char *sep;
+	int ret = 0;
+	assert(a);
+	assert(path);
+
+	if (a->data && !strcmp(a->path, path))
+	{
+		return 0;
+	}
+
+	catcierge_archive_close(a);
+
+	if (!(dir = strdup(path)))
+	{
+		CATERR("Out of memory!\n");
+		return -1;
+	}
+
+	if ((sep = strrchr(dir, '/'))
+		#ifdef _WIN32
+		|| (sep = strrchr(dir, '\\'))
+		#endif
+		)
+	{
+		*sep = '\0';
+
+		if (*dir && catcierge_make_path("%s", dir))
+		{
+			CATERR("Failed to create archive directory %s\n", dir);
+			ret = -1; goto fail;
+		}
+	}
+
+	ret = catcierge_archive_open(a, path);
+
+fail:
+	free(dir);
+	return ret;
+}
+
+int catcierge_archive_append(catcierge_archive_t *a, const catcierge_archive_record_t *r)
+{
+	size_t i;
+	size_t size = CATCIERGE_ARCHIVE_RECORD_HEADER_SIZE;
+	size_t name_len;
+	unsigned char *buf = NULL;
+	unsigned char *p;
+	const catcierge_archive_entry_t *entry;
+	catcierge_archive_index_entry_t e;
+	assert(a);
+	assert(r);
+	assert(a->data);
+
+	for (i = 0; i < r->entry_count; i++)
+	{
+		entry = &r->entries[i];
+
+		// Images that failed to encode are left out.
+		if (!entry->data)
+			continue;
+
+		size += CATCIERGE_ARCHIVE_ENTRY_HEADER_SIZE
+			  + strlen(entry->name) + entry->data_len;
+	}
+
+	if (size > CATCIERGE_ARCHIVE_MAX_RECORD_SIZE)
+	{
+		CATERR("Archive record too large (%lu bytes)\n", (unsigned long)size);
+		return -1;
+	}
+
+	if (!(buf = calloc(1, size)))
+	{
+		CATERR("Out of memory!\n");
+		return -1;
+	}
+
+	memset(&e, 0, sizeof(e));
+	e.time_us = r->time_us;
+	e.offset = a->size;
+	e.size = (uint32_t)size;
+	e.match_count = r->match_count;
+	e.success = !!r->success;
+	e.direction = r->direction;
+	snprintf(e.id, sizeof(e.id), "%s", r->id);
+
+	p = buf + CATCIERGE_ARCHIVE_RECORD_HEADER_SIZE;
+
+	for (i = 0; i < r->entry_count; i++)
+	{
+		entry = &r->entries[i];
+
+		if (!entry->data)
+			continue;
+
+		name_len = strlen(entry->name);
+		p[0] = (unsigned char)entry->type;
+		p[1] = (unsigned char)entry->format;
+		p[2] = (unsigned char)entry->match;
+		p[3] = (unsigned char)entry->step;
+		catcierge_put_u16(p + 4, (uint16_t)name_len);
+		catcierge_put_u32(p + 8, (uint32_t)entry->data_len);
+		p += CATCIERGE_ARCHIVE_ENTRY_HEADER_SIZE;
+		memcpy(p, entry->name, name_len);
+		p += name_len;
+		memcpy(p, entry->data, entry->data_len);
+		p += entry->data_len;
+		catcierge_put_u16(buf + 12, catcierge_get_u16(buf + 12) + 1);
+	}
+
+	memcpy(buf, CATCIERGE_ARCHIVE_RECORD_MAGIC, 4);
+	catcierge_put_u32(buf + 4, (uint32_t)size);
+	catcierge_put_u32(buf + 8, catcierge_crc32(buf + CATCIERGE_ARCHIVE_RECORD_HEADER_SIZE,
+		size - CATCIERGE_ARCHIVE_RECORD_HEADER_SIZE));
+	buf[14] = (unsigned char)e.match_count;
+	buf[15] = (unsigned char)e.success;
+	catcierge_put_u64(buf + 16, e.time_us);
+	buf[24] = (unsigned char)(e.direction + 1);
+	memcpy(buf + 32, e.id, strlen(e.id));
+
+	// The record goes first, so the index never points at a record
+	// that isn't there. A record without an index entry is picked up
+	// again by catcierge_archive_repair.
+	if (catcierge_fseek(a->data, (int64_t)a->size, SEEK_SET)
+		|| (fwrite(buf, 1, size, a->data) != size)
+		|| fflush(a->data))
+	{
+		CATERR("Failed to write to archive %s\n", a->path);
+		goto fail;
+	}
+
+	a->size += size;
+
+	if (catcierge_archive_write_index_entry(&e, a->index) || fflush(a->index))
+	{
+		CATERR("Failed to write to archive index of %s\n", a->path);
+		goto fail;
+	}
+
+	a->record_count++;
+	free(buf);
+
+	return 0;
+
+fail:
+	free(buf);
+	return -1;
+}
+
+int catcierge_archive_rebuild_index(const char *path)
+{
+	int ret = 0;
+	int64_t data_size;
+	uint64_t end;
+	char *index_path = NULL;
+	unsigned char header[CATCIERGE_ARCHIVE_HEADER_SIZE];
+	FILE *data = NULL;
+	FILE *index = NULL;
+	assert(path);
+
+	if (!(index_path = malloc(strlen(path) + 5)))
+	{
+		CATERR("Out of memory!\n");
+		return -1;
+	}
+
+	sprintf(index_path, "%s.idx", path);
+
+	if (!(data = fopen(path, "rb"))
+		|| catcierge_archive_check_header(data, CATCIERGE_ARCHIVE_MAGIC,
+				CATCIERGE_ARCHIVE_RECORD_HEADER_SIZE))
+	{
+		CATERR("%s is not a catcierge archive\n", path);
+		ret = -1; goto fail;
+	}
+
+	if (!(index = fopen(index_path, "wb")))
+	{
+		CATERR("Failed to create archive index %s\n", index_path);
+		ret = -1; goto fail;
+	}
+
+	catcierge_archive_write_header(header, CATCIERGE_ARCHIVE_INDEX_MAGIC,
+		CATCIERGE_ARCHIVE_INDEX_ENTRY_SIZE);
+
+	if ((fwrite(header, 1, sizeof(header), index) != sizeof(header))
+		|| ((data_size = catcierge_archive_file_size(data)) < 0))
+	{
+		ret = -1; goto fail;
+	}
+
+	end = catcierge_archive_scan(data, CATCIERGE_ARCHIVE_HEADER_SIZE,
+			(uint64_t)data_size, catcierge_archive_write_index_entry, index);
+
+	if (end < (uint64_t)data_size)
+	{
+		CATERR("Archive %s has %lld bytes of invalid records at the end\n",
+			path, (long long)((uint64_t)data_size - end));
+	}
+
+fail:
+	if (index && fclose(index))
+		ret = -1;
+	if (data)
+		fclose(data);
+	free(index_path);
+	return ret;
+}
+
+static int catcierge_archive_reader_add_index_entry(const catcierge_archive_index_entry_t *e, void *user)
+{
+	catcierge_archive_reader_t *rd = (catcierge_archive_reader_t *)user;
+	unsigned char *buf;
+
+	// The entries start right after the header, so the buffer
+	// is grown by one entry at a time. (Only done for records
+	// missing from the index).
+	if (!(buf = realloc(rd->index_buf, CATCIERGE_ARCHIVE_INDEX_HEADER_SIZE
+					+ (rd->count + 1) * CATCIERGE_ARCHIVE_INDEX_ENTRY_SIZE)))
+	{
+		CATERR("Out of memory!\n");
+		return -1;
+	}
+
+	rd->index_buf = buf;
+	catcierge_archive_encode_index(buf + CATCIERGE_ARCHIVE_INDEX_HEADER_SIZE
+		+ rd->count * CATCIERGE_ARCHIVE_INDEX_ENTRY_SIZE, e);
+	rd->index = buf + CATCIERGE_ARCHIVE_INDEX_HEADER_SIZE;
+	rd->count++;
+
+	return 0;
+}
+
+static int catcierge_archive_reader_load_index(catcierge_archive_reader_t *rd,
+		const char *index_path)
+{
+	int64_t index_size;
+	size_t len;
+	FILE *index = NULL;
+
+	if (!(index = fopen(index_path, "rb"))
+		|| catcierge_archive_check_header(index, CATCIERGE_ARCHIVE_INDEX_MAGIC,
+				CATCIERGE_ARCHIVE_INDEX_ENTRY_SIZE)
+		|| ((index_size = catcierge_archive_file_size(index)) < 0))
+	{
+		// The records are scanned instead.
+		if (index) fclose(index);
+		return 0;
+	}
+
+	rd->count = (size_t)((index_size - CATCIERGE_ARCHIVE_INDEX_HEADER_SIZE)
+				/ CATCIERGE_ARCHIVE_INDEX_ENTRY_SIZE);
+	len = CATCIERGE_ARCHIVE_INDEX_HEADER_SIZE + rd->count * CATCIERGE_ARCHIVE_INDEX_ENTRY_SIZE;
+
+	if (rd->count == 0)
+	{
+		fclose(index);
+		return 0;
+	}
+
+	#ifdef CATCIERGE_HAVE_SYS_MMAN_H
+	if ((rd->map = mmap(NULL, len, PROT_READ, MAP_SHARED, fileno(index), 0)) != MAP_FAILED)
+	{
+		rd->map_len = len;
+		rd->index = (unsigned char *)rd->map + CATCIERGE_ARCHIVE_INDEX_HEADER_SIZE;
+		fclose(index);
+		return 0;
+	}
+
+	rd->map = NULL;
+	#endif
+
+	if (!(rd->index_buf = malloc(len))
+		|| catcierge_fseek(index, 0, SEEK_SET)
+		|| (fread(rd->index_buf, 1, len, index) != len))
+	{
+		CATERR("Failed to read archive index %s\n", index_path);
+		rd->count = 0;
+		fclose(index);
+		return -1;
+	}
+
+	rd->index = rd->index_buf + CATCIERGE_ARCHIVE_INDEX_HEADER_SIZE;
+	fclose(index);
+
+	return 0;
+}
+
+static void catcierge_archive_reader_free_index(catcierge_archive_reader_t *rd)
+{
+	#ifdef CATCIERGE_HAVE_SYS_MMAN_H
+	if (rd->map)
+	{
+		munmap(rd->map, rd->map_len);
+		rd->map = NULL;
+		rd->map_len = 0;
+	}
+	#endif
+
+	catcierge_xfree(&rd->index_buf);
+	rd->index = NULL;
+	rd->count = 0;
+}
+
+int catcierge_archive_reader_open(catcierge_archive_reader_t *rd, const char *path)
+{
+	int64_t data_size;
+	uint64_t end = CATCIERGE_ARCHIVE_HEADER_SIZE;
+	size_t len;
+	char *index_path = NULL;
+	unsigned char *buf;
+	catcierge_archive_index_entry_t e;
+	assert(rd);
+	assert(path);
+	memset(rd, 0, sizeof(*rd));
+
+	if (!(index_path = malloc(strlen(path) + 5)))
+	{
+		CATERR("Out of memory!\n");
+		return -1;
+	}
+
+	sprintf(index_path, "%s.idx", path);
+
+	if (!(rd->data = fopen(path, "rb"))
+		|| catcierge_archive_check_header(rd->data, CATCIERGE_ARCHIVE_MAGIC,
+				CATCIERGE_ARCHIVE_RECORD_HEADER_SIZE)
+		|| ((data_size = catcierge_archive_file_size(rd->data)) < 0))
+	{
+		CATERR("%s is not a catcierge archive\n", path);
+		goto fail;
+	}
+
+	if (catcierge_archive_reader_load_index(rd, index_path))
+	{
+		goto fail;
+	}
+
+	if (rd->count > 0)
+	{
+		catcierge_archive_reader_get(rd, rd->count - 1, &e);
+		end = e.offset + e.size;
+
+		if (end > (uint64_t)data_size)
+		{
+			CATERR("Archive index %s is ahead of the archive, ignoring it\n", index_path);
+			catcierge_archive_reader_free_index(rd);
+			end = CATCIERGE_ARCHIVE_HEADER_SIZE;
+		}
+	}
+
+	// Records not in the index yet, either the writer is in the middle
+	// of appending one or it never got to write the index entry.
+	if (end < (uint64_t)data_size)
+	{
+		if (rd->map)
+		{
+			len = CATCIERGE_ARCHIVE_INDEX_HEADER_SIZE + rd->count * CATCIERGE_ARCHIVE_INDEX_ENTRY_SIZE;
+
+			if (!(buf = malloc(len)))
+			{
+				CATERR("Out of memory!\n");
+				goto fail;
+			}
+
+			memcpy(buf, rd->map, len);
+			#ifdef CATCIERGE_HAVE_SYS_MMAN_H
+			munmap(rd->map, rd->map_len);
+			#endif
+			rd->map = NULL;
+			rd->map_len = 0;
+			rd->index_buf = buf;
+			rd->index = buf + CATCIERGE_ARCHIVE_INDEX_HEADER_SIZE;
+		}
+
+		catcierge_archive_scan(rd->data, end, (uint64_t)data_size,
+			catcierge_archive_reader_add_index_entry, rd);
+	}
+
+	free(index_path);
+
+	return 0;
+
+fail:
+	free(index_path);
+	catcierge_archive_reader_close(rd);
+	return -1;
+}
+
+void catcierge_archive_reader_close(catcierge_archive_reader_t *rd)
+{
+	assert(rd);
+
+	catcierge_archive_reader_free_index(rd);
+
+	if (rd->data)
+	{
+		fclose(rd->data);
+		rd->data = NULL;
+	}
+}
+
+void catcierge_archive_reader_get(const catcierge_archive_reader_t *rd, size_t i,
+		catcierge_archive_index_entry_t *e)
+{
+	assert(rd);
+	assert(e);
+	assert(i < rd->count);
+
+	catcierge_archive_decode_index(rd->index + i * CATCIERGE_ARCHIVE_INDEX_ENTRY_SIZE, e);
+}
+
+size_t catcierge_archive_reader_find_time(const catcierge_archive_reader_t *rd, uint64_t time_us)
+{
+	size_t lo = 0;
+	size_t hi;
+	size_t mid;
+	assert(rd);
+
+	hi = rd->count;
+
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+
+		if (catcierge_get_u64(rd->index + mid * CATCIERGE_ARCHIVE_INDEX_ENTRY_SIZE) < time_us)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+int catcierge_archive_reader_find_id(const catcierge_archive_reader_t *rd, const char *id)
+{
+	size_t i;
+	size_t len;
+	assert(rd);
+	assert(id);
+
+	len = strlen(id);
+
+	if ((len == 0) || (len > CATCIERGE_ARCHIVE_ID_SIZE))
+	{
+		return -1;
+	}
+
+	for (i = 0; i < rd->count; i++)
+	{
+		if (!memcmp(rd->index + i * CATCIERGE_ARCHIVE_INDEX_ENTRY_SIZE + 24, id, len))
+		{
+			return (int)i;
+		}
+	}
+
+	return -1;
+}
+
+int catcierge_archive_reader_read(catcierge_archive_reader_t *rd, size_t i,
+		catcierge_archive_record_t *r)
+{
+	catcierge_archive_index_entry_t e;
+	catcierge_archive_entry_t *entry;
+	const unsigned char *p;
+	const unsigned char *end;
+	size_t name_len;
+	size_t data_len;
+	unsigned char *buf = NULL;
+	int entry_count;
+	int j;
+	assert(rd);
+	assert(r);
+
+	catcierge_archive_record_init(r);
+
+	if (i >= rd->count)
+	{
+		return -1;
+	}
+
+	catcierge_archive_reader_get(rd, i, &e);
+
+	if (!(buf = catcierge_archive_read_record(rd->data, e.offset, e.offset + e.size, &e)))
+	{
+		CATERR("Invalid archive record at offset %llu\n", (unsigned long long)e.offset);
+		return -1;
+	}
+
+	r->buf = buf;
+	r->time_us = e.time_us;
+	r->success = e.success;
+	r->direction = e.direction;
+	r->match_count = e.match_count;
+	snprintf(r->id, sizeof(r->id), "%s", e.id);
+
+	entry_count = catcierge_get_u16(buf + 12);
+	p = buf + CATCIERGE_ARCHIVE_RECORD_HEADER_SIZE;
+	end = buf + e.size;
+
+	if (!(r->entries = calloc(entry_count ? entry_count : 1, sizeof(catcierge_archive_entry_t))))
+	{
+		CATERR("Out of memory!\n");
+		goto fail;
+	}
+
+	r->entry_size = entry_count;
+
+	for (j = 0; j < entry_count; j++)
+	{
+		if ((size_t)(end - p) < CATCIERGE_ARCHIVE_ENTRY_HEADER_SIZE)
+			goto corrupt;
+
+		name_len = catcierge_get_u16(p + 4);
+		data_len = catcierge_get_u32(p + 8);
+
+		if ((size_t)(end - p - CATCIERGE_ARCHIVE_ENTRY_HEADER_SIZE) < (name_len + data_len))
+			goto corrupt;
+
+		entry = &r->entries[r->entry_count++];
+		entry->type = (catcierge_archive_entry_type_t)p[0];
+		entry->format = (catcierge_image_format_t)p[1];
+		entry->match = p[2];
+		entry->step = p[3];
+		p += CATCIERGE_ARCHIVE_ENTRY_HEADER_SIZE;
+
+		// The name isn't NUL terminated in the record.
+		if (!(entry->name = malloc(name_len + 1)))
+		{
+			CATERR("Out of memory!\n");
+			goto fail;
+		}
+
+		memcpy(entry->name, p, name_len);
+		entry->name[name_len] = '\0';
+
+		p += name_len;
+		entry->data = (unsigned char *)p;
+		entry->data_len = data_len;
+		p += data_len;
+	}
+
+	return 0;
+
+corrupt:
+	CATERR("Corrupt archive record at offset %llu\n", (unsigned long long)e.offset);
+fail:
+	catcierge_archive_record_free(r);
+	return -1;
+}
+
+const char *catcierge_archive_entry_type_str(catcierge_archive_entry_type_t type)
+{
+	switch (type)
+	{
+		case CATCIERGE_ARCHIVE_META: return "meta";
+		case CATCIERGE_ARCHIVE_MATCH: return "match";
+		case CATCIERGE_ARCHIVE_STEP: return "step";
+		case CATCIERGE_ARCHIVE_OBSTRUCT: return "obstruct";
+		default: return "unknown";
+	}
+}
@@ -0,0 +1,162 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_ARCHIVE_H__
+#define __CATCIERGE_ARCHIVE_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include "catcierge_types.h"
+#include "catcierge_image_format.h"
+
+//
+// Append-only archive holding one record per match group, with the
+// match, step and obstruct images and the event JSON as entries. This
+// replaces the many small files otherwise written for each group.
+//
+// <path>      Records, each with a header followed by its entries.
+// <path>.idx  Fixed size index entries, one per record, in the order
+//             they were written (so also sorted by time). Small enough
+//             to be memory mapped, and it can always be rebuilt from
+//             the records.
+//
+// All integers are stored little endian.
+//
+
+#define CATCIERGE_ARCHIVE_VERSION 1
+#define CATCIERGE_ARCHIVE_ID_SIZE 40		// SHA1 as hex.
+#define CATCIERGE_ARCHIVE_HEADER_SIZE 16
+#define CATCIERGE_ARCHIVE_RECORD_HEADER_SIZE 72
+#define CATCIERGE_ARCHIVE_ENTRY_HEADER_SIZE 12
+#define CATCIERGE_ARCHIVE_INDEX_HEADER_SIZE 16
+#define CATCIERGE_ARCHIVE_INDEX_ENTRY_SIZE 64
+#define CATCIERGE_ARCHIVE_MAX_ENTRIES 1024
+#define CATCIERGE_ARCHIVE_MAX_RECORD_SIZE (512 * 1024 * 1024)
+
+typedef enum catcierge_archive_entry_type_e
+{
+	CATCIERGE_ARCHIVE_META = 0,			// Event JSON.
+	CATCIERGE_ARCHIVE_MATCH = 1,
+	CATCIERGE_ARCHIVE_STEP = 2,
+	CATCIERGE_ARCHIVE_OBSTRUCT = 3
+} catcierge_archive_entry_type_t;
+
+typedef struct catcierge_archive_entry_s
+{
+	catcierge_archive_entry_type_t type;
+	catcierge_image_format_t format;	// Encoding of image entries.
+	int match;							// Match index for match and step images.
+	int step;							// Step index for step images.
+	char *name;							// File name the entry would have had.
+	unsigned char *data;
+	size_t data_len;
+	IplImage *img;						// Not yet encoded image, see catcierge_archive_record_encode.
+} catcierge_archive_entry_t;
+
+typedef struct catcierge_archive_record_s
+{
+	uint64_t time_us;					// Match group start time.
+	char id[CATCIERGE_ARCHIVE_ID_SIZE + 1];
+	int success;
+	match_direction_t direction;
+	int match_count;
+	catcierge_archive_entry_t *entries;
+	size_t entry_count;
+	size_t entry_size;
+	unsigned char *buf;					// Read records point into this instead of owning their data.
+} catcierge_archive_record_t;
+
+typedef struct catcierge_archive_index_entry_s
+{
+	uint64_t time_us;
+	uint64_t offset;					// Offset of the record in the archive.
+	uint32_t size;						// Size of the record including its header.
+	int match_count;
+	int success;
+	match_direction_t direction;
+	char id[CATCIERGE_ARCHIVE_ID_SIZE + 1];
+} catcierge_archive_index_entry_t;
+
+typedef struct catcierge_archive_s
+{
+	char *path;
+	FILE *data;
+	FILE *index;
+	uint64_t size;						// Current end of the archive.
+	unsigned long record_count;
+} catcierge_archive_t;
+
+typedef struct catcierge_archive_reader_s
+{
+	FILE *data;
+	const unsigned char *index;			// Index entries, mapped or read.
+	size_t count;
+	void *map;
+	size_t map_len;
+	unsigned char *index_buf;
+} catcierge_archive_reader_t;
+
+void catcierge_archive_record_init(catcierge_archive_record_t *r);
+void catcierge_archive_record_free(catcierge_archive_record_t *r);
+
+// Takes ownership of data.
+int catcierge_archive_record_add_data(catcierge_archive_record_t *r,
+		catcierge_archive_entry_type_t type, const char *name,
+		unsigned char *data, size_t data_len);
+
+// Takes ownership of img, it is encoded by catcierge_archive_record_encode.
+int catcierge_archive_record_add_image(catcierge_archive_record_t *r,
+		catcierge_archive_entry_type_t type, const char *name,
+		IplImage *img, int match, int step);
+
+// Encodes and releases the images added to the record. Images that
+// fail to encode are left out.
+int catcierge_archive_record_encode(catcierge_archive_record_t *r,
+		catcierge_image_format_t format, int png_compression);
+
+// Opens or creates an archive for appending. A record or index entry
+// that was only partly written (power loss) is repaired.
+int catcierge_archive_open(catcierge_archive_t *a, const char *path);
+void catcierge_archive_close(catcierge_archive_t *a);
+
+// Keeps the archive at path open, closing any other archive. The
+// directory is created if needed. (The archive path can change
+// between match groups when it contains time variables).
+int catcierge_archive_switch(catcierge_archive_t *a, const char *path);
+int catcierge_archive_append(catcierge_archive_t *a, const catcierge_archive_record_t *r);
+
+// Writes a new index by scanning all records in the archive.
+int catcierge_archive_rebuild_index(const char *path);
+
+int catcierge_archive_reader_open(catcierge_archive_reader_t *rd, const char *path);
+void catcierge_archive_reader_close(catcierge_archive_reader_t *rd);
+void catcierge_archive_reader_get(const catcierge_archive_reader_t *rd, size_t i,
+		catcierge_archive_index_entry_t *e);
+
+// Index of the first record at or after time_us (count if none).
+size_t catcierge_archive_reader_find_time(const catcierge_archive_reader_t *rd, uint64_t time_us);
+
+// Index of the first record with an id starting with the given prefix, -1 if none.
+int catcierge_archive_reader_find_id(const catcierge_archive_reader_t *rd, const char *id);
+
+int catcierge_archive_reader_read(catcierge_archive_reader_t *rd, size_t i,
+		catcierge_archive_record_t *r);
+
+const char *catcierge_archive_entry_type_str(catcierge_archive_entry_type_t type);
+
+#endif // __CATCIERGE_ARCHIVE_H__
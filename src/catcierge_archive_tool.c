@@ -0,0 +1,275 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "catcierge_config.h"
+#include "catcierge_archive.h"
+#include "catcierge_util.h"
+#include "cargo.h"
+
+//
+// Lists, extracts and reindexes match group archives written by
+// catcierge_grabber --archive. The records are looked up using the
+// index, so only the records that are printed or extracted are read.
+//
+
+typedef struct archive_tool_ctx_s
+{
+	char **archive_paths;
+	size_t archive_count;
+	char *from_str;
+	char *to_str;
+	uint64_t from;
+	uint64_t to;
+	char *id;
+	int entries;
+	char *extract_path;
+	int reindex;
+} archive_tool_ctx_t;
+
+static const char *get_time_str(uint64_t time_us, char *buf, size_t bufsize)
+{
+	time_t t = (time_t)(time_us / 1000000);
+	struct tm *tm = localtime(&t);
+	size_t len;
+
+	if (!tm || !(len = strftime(buf, bufsize, "%Y-%m-%d %H:%M:%S", tm)))
+	{
+		snprintf(buf, bufsize, "%llu", (unsigned long long)time_us);
+		return buf;
+	}
+
+	snprintf(buf + len, bufsize - len, ".%06d", (int)(time_us % 1000000));
+	return buf;
+}
+
+static int extract_record(archive_tool_ctx_t *ctx, catcierge_archive_record_t *r)
+{
+	size_t i;
+	char path[4096];
+	FILE *f;
+	catcierge_archive_entry_t *entry;
+
+	if (catcierge_make_path("%s%s%s", ctx->extract_path, catcierge_path_sep(), r->id))
+	{
+		fprintf(stderr, "Failed to create directory for %s\n", r->id);
+		return -1;
+	}
+
+	for (i = 0; i < r->entry_count; i++)
+	{
+		entry = &r->entries[i];
+
+		// The names come from the archive, don't let them point elsewhere.
+		if (strchr(entry->name, '/') || strchr(entry->name, '\\')
+			|| !strcmp(entry->name, "..") || !strcmp(entry->name, "."))
+		{
+			fprintf(stderr, "Skipping entry with invalid name \"%s\"\n", entry->name);
+			continue;
+		}
+
+		snprintf(path, sizeof(path), "%s%s%s%s%s", ctx->extract_path,
+			catcierge_path_sep(), r->id, catcierge_path_sep(), entry->name);
+
+		if (!(f = fopen(path, "wb")))
+		{
+			fprintf(stderr, "Failed to open %s for writing\n", path);
+			return -1;
+		}
+
+		if (fwrite(entry->data, 1, entry->data_len, f) != entry->data_len)
+		{
+			fprintf(stderr, "Failed to write %s\n", path);
+			fclose(f);
+			return -1;
+		}
+
+		fclose(f);
+		printf("  %s\n", path);
+	}
+
+	return 0;
+}
+
+static int list_archive(archive_tool_ctx_t *ctx, const char *path)
+{
+	int ret = 0;
+	size_t i;
+	size_t j;
+	int id_index;
+	char time_str[64];
+	catcierge_archive_reader_t rd;
+	catcierge_archive_index_entry_t e;
+	catcierge_archive_record_t r;
+	catcierge_archive_entry_t *entry;
+
+	if (catcierge_archive_reader_open(&rd, path))
+	{
+		return -1;
+	}
+
+	if (ctx->id)
+	{
+		if ((id_index = catcierge_archive_reader_find_id(&rd, ctx->id)) < 0)
+		{
+			goto done;
+		}
+
+		i = (size_t)id_index;
+	}
+	else
+	{
+		i = catcierge_archive_reader_find_time(&rd, ctx->from);
+	}
+
+	for (; i < rd.count; i++)
+	{
+		catcierge_archive_reader_get(&rd, i, &e);
+
+		if (ctx->to && (e.time_us >= ctx->to))
+			break;
+
+		if (ctx->id && strncmp(e.id, ctx->id, strlen(ctx->id)))
+			continue;
+
+		printf("%s  %-40s  %-7s  %-7s  %d matches  %u bytes\n",
+			get_time_str(e.time_us, time_str, sizeof(time_str)),
+			e.id, e.success ? "success" : "fail",
+			catcierge_get_direction_str(e.direction),
+			e.match_count, e.size);
+
+		if (!ctx->entries && !ctx->extract_path)
+			continue;
+
+		if (catcierge_archive_reader_read(&rd, i, &r))
+		{
+			ret = -1;
+			continue;
+		}
+
+		for (j = 0; ctx->entries && (j < r.entry_count); j++)
+		{
+			entry = &r.entries[j];
+			printf("  %-8s  %-50s  %lu bytes\n",
+				catcierge_archive_entry_type_str(entry->type),
+				entry->name, (unsigned long)entry->data_len);
+		}
+
+		if (ctx->extract_path)
+		{
+			ret |= extract_record(ctx, &r);
+		}
+
+		catcierge_archive_record_free(&r);
+	}
+
+done:
+	catcierge_archive_reader_close(&rd);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	int ret = 0;
+	size_t i;
+	cargo_t cargo;
+	archive_tool_ctx_t ctx;
+
+	memset(&ctx, 0, sizeof(ctx));
+
+	if (cargo_init(&cargo, 0, "%s", argv[0]))
+	{
+		fprintf(stderr, "Failed to init command line parsing\n");
+		return -1;
+	}
+
+	cargo_set_description(cargo,
+		"Lists and extracts the match groups in archives "
+		"written by catcierge_grabber --archive.");
+
+	ret |= cargo_add_option(cargo, 0, "archives", "Archives to read.",
+			"[s]+", &ctx.archive_paths, &ctx.archive_count);
+	ret |= cargo_add_option(cargo, 0, "--from",
+			"Only match groups at or after this time. "
+			"\"YYYY-MM-DD\" or \"YYYY-MM-DD HH:MM:SS\" in local time.",
+			"s", &ctx.from_str);
+	ret |= cargo_add_option(cargo, 0, "--to",
+			"Only match groups before this time.",
+			"s", &ctx.to_str);
+	ret |= cargo_add_option(cargo, 0, "--id",
+			"Only the match group with an ID starting with this.",
+			"s", &ctx.id);
+	ret |= cargo_add_option(cargo, 0, "--entries",
+			"List the images and metadata of each match group.",
+			"b", &ctx.entries);
+	ret |= cargo_add_option(cargo, 0, "--extract",
+			"Extract the match groups into a directory per match group "
+			"under this path.",
+			"s", &ctx.extract_path);
+	ret |= cargo_add_option(cargo, 0, "--reindex",
+			"Rebuild the index of the archives from the records.",
+			"b", &ctx.reindex);
+
+	if (ret)
+	{
+		fprintf(stderr, "Failed to add command line options\n");
+		ret = -1; goto fail;
+	}
+
+	if (cargo_parse(cargo, 0, 1, argc, argv))
+	{
+		ret = -1; goto fail;
+	}
+
+	if ((ctx.from_str && catcierge_parse_time(ctx.from_str, &ctx.from))
+		|| (ctx.to_str && catcierge_parse_time(ctx.to_str, &ctx.to)))
+	{
+		fprintf(stderr, "Invalid time, expected \"YYYY-MM-DD\" or \"YYYY-MM-DD HH:MM:SS\"\n");
+		ret = -1; goto fail;
+	}
+
+	for (i = 0; i < ctx.archive_count; i++)
+	{
+		if (ctx.reindex)
+		{
+			if (catcierge_archive_rebuild_index(ctx.archive_paths[i]))
+				ret = -1;
+			else
+				printf("Rebuilt index of %s\n", ctx.archive_paths[i]);
+			continue;
+		}
+
+		if (ctx.archive_count > 1)
+			printf("%s:\n", ctx.archive_paths[i]);
+
+		ret |= list_archive(&ctx, ctx.archive_paths[i]);
+	}
+
+fail:
+	catcierge_free_list(ctx.archive_paths, ctx.archive_count);
+	catcierge_xfree(&ctx.from_str);
+	catcierge_xfree(&ctx.to_str);
+	catcierge_xfree(&ctx.id);
+	catcierge_xfree(&ctx.extract_path);
+	cargo_destroy(&cargo);
+
+	return ret;
+}
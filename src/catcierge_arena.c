@@ -0,0 +1,192 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "catcierge_arena.h"
+#include "catcierge_log.h"
+
+// Alignment good enough for any of the types we store.
+#define CATCIERGE_ARENA_ALIGN(n) (((n) + 15) & ~(size_t)15)
+#define CATCIERGE_ARENA_HEADER_SIZE CATCIERGE_ARENA_ALIGN(sizeof(catcierge_arena_block_t))
+#define CATCIERGE_ARENA_DATA(b) ((char *)(b) + CATCIERGE_ARENA_HEADER_SIZE)
+
+void catcierge_arena_init(catcierge_arena_t *arena, size_t block_size)
+{
+	assert(arena);
+	memset(arena, 0, sizeof(catcierge_arena_t));
+	arena->block_size = block_size;
+}
+
+static void catcierge_arena_free_blocks(catcierge_arena_t *arena)
+{
+	catcierge_arena_block_t *b = arena->blocks;
+	catcierge_arena_block_t *next = NULL;
+
+	while (b)
+	{
+		next = b->next;
+		free(b);
+		b = next;
+	}
+
+	arena->blocks = NULL;
+	arena->last = NULL;
+}
+
+void catcierge_arena_destroy(catcierge_arena_t *arena)
+{
+	assert(arena);
+	catcierge_arena_free_blocks(arena);
+	arena->alloc_count = 0;
+	arena->block_alloc_count = 0;
+}
+
+static catcierge_arena_block_t *catcierge_arena_add_block(catcierge_arena_t *arena, size_t size)
+{
+	catcierge_arena_block_t *b = NULL;
+	size_t block_size = arena->block_size ? arena->block_size : CATCIERGE_ARENA_DEFAULT_BLOCK_SIZE;
+
+	if (size < block_size)
+		size = block_size;
+
+	if (!(b = malloc(CATCIERGE_ARENA_HEADER_SIZE + size)))
+	{
+		CATERR("Out of memory\n"); return NULL;
+	}
+
+	b->size = size;
+	b->used = 0;
+	b->next = arena->blocks;
+	arena->blocks = b;
+	arena->block_alloc_count++;
+
+	return b;
+}
+
+void catcierge_arena_reset(catcierge_arena_t *arena)
+{
+	size_t total = 0;
+	catcierge_arena_block_t *b = NULL;
+	assert(arena);
+
+	if (arena->blocks && arena->blocks->next)
+	{
+		for (b = arena->blocks; b; b = b->next)
+		{
+			total += b->size;
+		}
+
+		catcierge_arena_free_blocks(arena);
+
+		// If this fails we simply start from scratch next time.
+		catcierge_arena_add_block(arena, total);
+	}
+
+	if (arena->blocks)
+	{
+		arena->blocks->used = 0;
+	}
+
+	arena->last = NULL;
+	arena->alloc_count = 0;
+	arena->block_alloc_count = 0;
+}
+
+void *catcierge_arena_alloc(catcierge_arena_t *arena, size_t size)
+{
+	catcierge_arena_block_t *b = NULL;
+	assert(arena);
+
+	size = CATCIERGE_ARENA_ALIGN(size ? size : 1);
+	b = arena->blocks;
+
+	if (!b || ((b->size - b->used) < size))
+	{
+		if (!(b = catcierge_arena_add_block(arena, size)))
+		{
+			return NULL;
+		}
+	}
+
+	arena->last = CATCIERGE_ARENA_DATA(b) + b->used;
+	b->used += size;
+	arena->alloc_count++;
+
+	return arena->last;
+}
+
+void *catcierge_arena_realloc(catcierge_arena_t *arena, void *ptr,
+		size_t old_size, size_t new_size)
+{
+	void *p = NULL;
+	catcierge_arena_block_t *b = NULL;
+	assert(arena);
+
+	if (!ptr)
+		return catcierge_arena_alloc(arena, new_size);
+
+	b = arena->blocks;
+
+	// The latest allocation can grow in place if the block has room.
+	if ((ptr == arena->last) && b)
+	{
+		size_t offset = (char *)ptr - CATCIERGE_ARENA_DATA(b);
+		size_t size = CATCIERGE_ARENA_ALIGN(new_size ? new_size : 1);
+
+		if ((b->size - offset) >= size)
+		{
+			b->used = offset + size;
+			return ptr;
+		}
+	}
+
+	if (!(p = catcierge_arena_alloc(arena, new_size)))
+	{
+		return NULL;
+	}
+
+	memcpy(p, ptr, (old_size < new_size) ? old_size : new_size);
+
+	return p;
+}
+
+char *catcierge_arena_strndup(catcierge_arena_t *arena, const char *str, size_t len)
+{
+	char *s = NULL;
+	assert(str);
+
+	len = strnlen(str, len);
+
+	if (!(s = catcierge_arena_alloc(arena, len + 1)))
+	{
+		return NULL;
+	}
+
+	memcpy(s, str, len);
+	s[len] = '\0';
+
+	return s;
+}
+
+char *catcierge_arena_strdup(catcierge_arena_t *arena, const char *str)
+{
+	assert(str);
+	return catcierge_arena_strndup(arena, str, strlen(str));
+}
@@ -0,0 +1,61 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_ARENA_H__
+#define __CATCIERGE_ARENA_H__
+
+#include <stddef.h>
+
+#define CATCIERGE_ARENA_DEFAULT_BLOCK_SIZE 4096
+
+typedef struct catcierge_arena_block_s
+{
+	struct catcierge_arena_block_s *next;
+	size_t size;
+	size_t used;
+} catcierge_arena_block_t;
+
+//
+// Bump allocator for short lived allocations. Memory is handed out
+// from big blocks and is only given back all at once, either by
+// resetting the arena (keeping the memory for reuse) or destroying it.
+// A zeroed arena is valid and uses the default block size.
+//
+typedef struct catcierge_arena_s
+{
+	catcierge_arena_block_t *blocks; // The block currently allocated from first.
+	size_t block_size;
+	void *last;					// Latest allocation, can be grown in place.
+	size_t alloc_count;			// Allocations since the last reset.
+	size_t block_alloc_count;	// Blocks malloced since the last reset.
+} catcierge_arena_t;
+
+void catcierge_arena_init(catcierge_arena_t *arena, size_t block_size);
+void catcierge_arena_destroy(catcierge_arena_t *arena);
+
+// Frees all allocations but keeps the memory. If the arena grew to more
+// than one block they are replaced by a single block big enough for all.
+void catcierge_arena_reset(catcierge_arena_t *arena);
+
+void *catcierge_arena_alloc(catcierge_arena_t *arena, size_t size);
+void *catcierge_arena_realloc(catcierge_arena_t *arena, void *ptr,
+		size_t old_size, size_t new_size);
+char *catcierge_arena_strndup(catcierge_arena_t *arena, const char *str, size_t len);
+char *catcierge_arena_strdup(catcierge_arena_t *arena, const char *str);
+
+#endif // __CATCIERGE_ARENA_H__
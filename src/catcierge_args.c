@@ -122,6 +122,24 @@ static int add_gpio_options(cargo_t cargo, catcierge_args_t *args)
 			"to always be on, this is not needed.",
 			"b", &args->backlight_enable);
 
+	ret |= cargo_add_option(cargo, 0,
+			"<gpio> --gpio_backend",
+			"How the GPIO pins are written.\n"
+			"  sysfs - Keep the sysfs value files open (default).\n"
+			"  chardev - Request the lines from the GPIO character device "
+			"(see --gpio_chip). The pins are then numbered by line offset "
+			"and don't have to be exported.\n"
+			"  legacy - Open, write and close the sysfs value file for each write.",
+			"s", &args->gpio_backend);
+
+	ret |= cargo_add_option(cargo, 0,
+			"<gpio> --gpio_chip", NULL,
+			"s", &args->gpio_chip);
+	ret |= cargo_set_option_description(cargo, "--gpio_chip",
+			"The GPIO character device used by \"--gpio_backend chardev\". "
+			"Default: %s", CATCIERGE_GPIO_DEFAULT_CHIP);
+	ret |= cargo_set_metavar(cargo, "--gpio_chip", "PATH");
+
 	return ret;
 }
 #endif // PRI
@@ -285,6 +303,19 @@ static int add_matcher_options(cargo_t cargo, catcierge_args_t *args)
 			"Haar feature based matching algorithm (recommended).",
 			"b=", &args->matcher_type, MATCHER_HAAR);
 
+	ret |= cargo_add_option(cargo, 0,
+			"<!matcher_type, matcher> --chain_matcher --chain",
+			"Runs a cheap gate in front of another matcher, so that "
+			"frames without a cat skip the expensive matching.",
+			"b=", &args->matcher_type, MATCHER_CHAIN);
+
+	#ifdef WITH_DNN
+	ret |= cargo_add_option(cargo, 0,
+			"<!matcher_type, matcher> --dnn_matcher --dnn",
+			"CNN classifier based matching algorithm using the OpenCV dnn module.",
+			"b=", &args->matcher_type, MATCHER_DNN);
+	#endif
+
 	ret |= cargo_add_option(cargo, 0,
 			"<matcher> --ok_matches_needed", NULL,
 			"i", &args->ok_matches_needed);
@@ -305,6 +336,60 @@ static int add_matcher_options(cargo_t cargo, catcierge_args_t *args)
 			"setting. This flag turns this behavior off.",
 			"b", &args->no_final_decision);
 
+	ret |= cargo_add_option(cargo, 0,
+			"<matcher> --early_decision",
+			"Decide the lock status as soon as the outcome of the match "
+			"group is certain, instead of always waiting for all matches. "
+			"For example when \"--ok_matches_needed\" is already met, or "
+			"when too many matches have failed for it to be met.",
+			"b", &args->early_decision);
+
+	ret |= cargo_add_option(cargo, 0,
+			"<matcher> --burst", NULL,
+			"i", &args->burst);
+	ret |= cargo_set_option_description(cargo,
+			"--burst",
+			"Score each frame for sharpness and exposure, and only match "
+			"the best frame out of every burst of this many consecutive "
+			"frames. Motion blurred frames are skipped instead of "
+			"wasting a match on them. Default is 1 (match every frame).");
+	ret |= cargo_add_validation(cargo, 0,
+			"--burst",
+			cargo_validate_int_range(1, CATCIERGE_MAX_BURST));
+
+	ret |= cargo_add_option(cargo, 0,
+			"<matcher> --match_cache",
+			"Reuse the result of the last matched frame when the new frame "
+			"is nearly identical, for instance when a cat sits still in "
+			"front of the door. The value is the mean pixel difference "
+			"(0-255) of a downsampled gray scale version of the frames "
+			"that is still considered the same frame. 0 turns this off (default).",
+			"d", &args->match_cache);
+	ret |= cargo_set_metavar(cargo,
+			"--match_cache",
+			"DIFF");
+
+	ret |= cargo_add_option(cargo, 0,
+			"<matcher> --streaming",
+			"Instead of matching a fixed group of frames, keep matching "
+			"for as long as the frame is obstructed and decide on the "
+			"latest \"--stream_window\" matches. The door is locked as soon "
+			"as the window fails, otherwise the decision is made when the "
+			"frame clears. \"--ok_matches_needed\" successful matches are "
+			"needed even if the frame clears before the window is full.",
+			"b", &args->streaming);
+
+	ret |= cargo_add_option(cargo, 0,
+			"<matcher> --stream_window", NULL,
+			"i", &args->stream_window);
+	ret |= cargo_set_option_description(cargo,
+			"--stream_window",
+			"The number of latest matches to base the decision on "
+			"in streaming mode. Default %d.", DEFAULT_STREAM_WINDOW);
+	ret |= cargo_add_validation(cargo, 0,
+			"--stream_window",
+			cargo_validate_int_range(1, CATCIERGE_MAX_STREAM_WINDOW));
+
 	ret |= cargo_add_option(cargo, 0,
 			"<matcher> --matchtime", NULL,
 			"i", &args->match_time);
@@ -315,9 +400,161 @@ static int add_matcher_options(cargo_t cargo, catcierge_args_t *args)
 
 	ret |= catcierge_haar_matcher_add_options(cargo, &args->haar);
 	ret |= catcierge_template_matcher_add_options(cargo, &args->templ);
+	ret |= catcierge_chain_matcher_add_options(cargo, &args->chain);
+	#ifdef WITH_DNN
+	ret |= catcierge_dnn_matcher_add_options(cargo, &args->dnn);
+	#endif
 	return ret;
 }
 
+static int parse_image_format(cargo_t ctx, void *user, const char *optname,
+							int argc, char **argv)
+{
+	catcierge_image_format_t *format = (catcierge_image_format_t *)user;
+
+	if (argc < 1)
+	{
+		cargo_set_error(ctx, 0,
+			"Missing either \"png\", \"qoi\" or \"pgm\" for %s", optname);
+		return -1;
+	}
+
+	if (catcierge_image_format_parse(argv[0], format))
+	{
+		cargo_set_error(ctx, 0,
+			"Invalid image format \"%s\", must be \"png\", \"qoi\" "
+			"or \"pgm\".", argv[0]);
+		return -1;
+	}
+
+	return 1;
+}
+
+static int parse_retention_quotas(catcierge_args_t *args)
+{
+	size_t i;
+	catcierge_retention_class_t cls;
+	catcierge_retention_quota_t quota;
+
+	memset(args->retention_quotas, 0, sizeof(args->retention_quotas));
+
+	for (i = 0; i < args->retention_count; i++)
+	{
+		if (catcierge_retention_parse_quota(args->retention[i], &cls, &quota))
+		{
+			CATERR("Invalid --retention quota \"%s\", expected "
+				"CLASS:MAX_MB:MAX_DAYS where CLASS is match, steps, "
+				"obstruct or templates\n", args->retention[i]);
+			return -1;
+		}
+
+		args->retention_quotas[cls] = quota;
+	}
+
+	return 0;
+}
+
+static int parse_notify_settings(catcierge_args_t *args)
+{
+	size_t i;
+	int e;
+
+	if (args->notify_count > CATCIERGE_NOTIFY_MAX_TARGETS)
+	{
+		CATERR("At most %d --notify targets are supported\n",
+			CATCIERGE_NOTIFY_MAX_TARGETS);
+		return -1;
+	}
+
+	for (i = 0; i < args->notify_count; i++)
+	{
+		if (catcierge_notify_parse_target(args->notify[i], &args->notify_targets[i]))
+		{
+			CATERR("Invalid --notify target \"%s\", expected "
+				"smtp://HOST[:PORT]/RECIPIENT or http://HOST[:PORT]/PATH\n",
+				args->notify[i]);
+			return -1;
+		}
+	}
+
+	if (args->notify_events_count == 0)
+	{
+		args->notify_event_mask = CATCIERGE_EVENT_BIT(
+			catcierge_output_event_from_name(DEFAULT_NOTIFY_EVENTS));
+		return 0;
+	}
+
+	args->notify_event_mask = 0;
+
+	for (i = 0; i < args->notify_events_count; i++)
+	{
+		if (!strcmp(args->notify_events[i], "all"))
+		{
+			args->notify_event_mask = CATCIERGE_EVENT_ALL;
+		}
+		else if ((e = catcierge_output_event_from_name(args->notify_events[i])) >= 0)
+		{
+			args->notify_event_mask |= CATCIERGE_EVENT_BIT(e);
+		}
+		else
+		{
+			CATERR("Unknown --notify_events event \"%s\"\n", args->notify_events[i]);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+#ifdef WITH_ZMQ
+static int parse_zmq_images(cargo_t ctx, void *user, const char *optname,
+							int argc, char **argv)
+{
+	catcierge_zmq_images_t *images = (catcierge_zmq_images_t *)user;
+
+	if (argc < 1)
+	{
+		cargo_set_error(ctx, 0,
+			"Missing either \"none\", \"raw\", \"png\", \"qoi\" "
+			"or \"pgm\" for %s", optname);
+		return -1;
+	}
+
+	if (catcierge_zmq_images_parse(argv[0], images))
+	{
+		cargo_set_error(ctx, 0,
+			"Invalid image format \"%s\", must be \"none\", \"raw\", "
+			"\"png\", \"qoi\" or \"pgm\".", argv[0]);
+		return -1;
+	}
+
+	return 1;
+}
+#endif // WITH_ZMQ
+
+static int parse_fsync_policy(cargo_t ctx, void *user, const char *optname,
+							int argc, char **argv)
+{
+	catcierge_fsync_policy_t *policy = (catcierge_fsync_policy_t *)user;
+
+	if (argc < 1)
+	{
+		cargo_set_error(ctx, 0,
+			"Missing either \"never\", \"batch\" or \"file\" for %s", optname);
+		return -1;
+	}
+
+	if (catcierge_fsync_policy_parse(argv[0], policy))
+	{
+		cargo_set_error(ctx, 0,
+			"Invalid fsync policy \"%s\", must be \"never\", \"batch\" "
+			"or \"file\".", argv[0]);
+		return -1;
+	}
+
+	return 1;
+}
+
 static int add_output_options(cargo_t cargo, catcierge_args_t *args)
 {
 	int ret = 0;
@@ -353,6 +590,134 @@ static int add_output_options(cargo_t cargo, catcierge_args_t *args)
 			"(--save must also be turned on)",
 			"b", &args->save_steps);
 
+	ret |= cargo_add_option(cargo, 0,
+			"<output> --sync_save",
+			"Save the images on the matching thread, instead of handing "
+			"them over to a background writer. The matching is held up "
+			"until all images of a match group have been written.",
+			"b", &args->sync_save);
+
+	ret |= cargo_add_option(cargo, 0,
+			"<output> --image_queue_size", NULL,
+			"i", &args->image_queue_size);
+	ret |= cargo_set_option_description(cargo,
+			"--image_queue_size",
+			"The max number of images waiting to be written by the "
+			"background writer. Images saved when the queue is full "
+			"are dropped. Default %d.", DEFAULT_IMAGE_QUEUE_SIZE);
+	ret |= cargo_add_validation(cargo, 0,
+			"--image_queue_size",
+			cargo_validate_int_range(1, CATCIERGE_IMAGE_QUEUE_MAX_SIZE));
+
+	ret |= cargo_add_option(cargo, 0,
+			"<output> --image_format",
+			"The format used when saving match, step and obstruct images. "
+			"\"png\" (default), \"qoi\" which is lossless but a lot faster "
+			"to encode than png, or \"pgm\" which is uncompressed "
+			"(color images are saved as ppm). "
+			"Use catcierge_image_convert to turn them back into png.",
+			"c", parse_image_format, &args->image_format);
+
+	ret |= cargo_add_option(cargo, 0,
+			"<output> --png_compression", NULL,
+			"i", &args->png_compression);
+	ret |= cargo_set_option_description(cargo,
+			"--png_compression",
+			"The zlib compression level 0-9 used when saving png images. "
+			"Lower is faster but gives larger files. "
+			"Default %d which uses the OpenCV default.", DEFAULT_PNG_COMPRESSION);
+	ret |= cargo_add_validation(cargo, 0,
+			"--png_compression",
+			cargo_validate_int_range(-1, 9));
+
+	ret |= cargo_add_option(cargo, 0,
+			"<output> --staging",
+			"Keep saved images and generated templates in RAM and let a "
+			"background flusher write them to disk in batches. This turns "
+			"the many small writes of a match group into a few sequential "
+			"ones, which is a lot kinder to an SD card. The files only show "
+			"up on disk once flushed, so commands run on events should not "
+			"expect to find them right away. Archives (--archive) are "
+			"already written sequentially and are not staged.",
+			"b", &args->staging);
+
+	ret |= cargo_add_option(cargo, 0,
+			"<output> --staging_size", NULL,
+			"i", &args->staging_size);
+	ret |= cargo_set_option_description(cargo,
+			"--staging_size",
+			"The max size of the files staged in RAM. A flush is started "
+			"early when half of it is used, and when it is full files are "
+			"written directly instead. Default %d MB.", DEFAULT_STAGING_SIZE);
+	ret |= cargo_add_validation(cargo, 0,
+			"--staging_size",
+			cargo_validate_int_range(1, CATCIERGE_STAGING_MAX_SIZE));
+	ret |= cargo_set_metavar(cargo, "--staging_size", "MB");
+
+	ret |= cargo_add_option(cargo, 0,
+			"<output> --flush_interval", NULL,
+			"i", &args->flush_interval);
+	ret |= cargo_set_option_description(cargo,
+			"--flush_interval",
+			"How often the staged files are flushed to disk. "
+			"Default %d seconds.", DEFAULT_FLUSH_INTERVAL);
+	ret |= cargo_add_validation(cargo, 0,
+			"--flush_interval",
+			cargo_validate_int_range(1, CATCIERGE_MAX_FLUSH_INTERVAL));
+	ret |= cargo_set_metavar(cargo, "--flush_interval", "SECONDS");
+
+	ret |= cargo_add_option(cargo, 0,
+			"<output> --flush_fsync",
+			"When flushed files are synced to the card. \"never\" leaves "
+			"it to the OS, \"batch\" (default) syncs once after each "
+			"flush, and \"file\" syncs each file as it is written.",
+			"c", parse_fsync_policy, &args->flush_fsync);
+
+	ret |= cargo_add_option(cargo, 0,
+			"<output> --retention",
+			"Keep the saved files within a size and age quota. Takes one or "
+			"more CLASS:MAX_MB:MAX_DAYS where CLASS is \"match\", \"steps\", "
+			"\"obstruct\" or \"templates\", and 0 means no limit. The oldest "
+			"files of a class are removed by a low priority background thread "
+			"when it is over its quota. Only files named the way catcierge "
+			"names them (and the file names of the loaded templates) are "
+			"removed. The directories scanned are the output paths up to "
+			"their first variable.\n"
+			"Example: --retention match:2000:365 steps:500:7",
+			"[s]+", &args->retention, &args->retention_count);
+	ret |= cargo_set_metavar(cargo, "--retention", "CLASS:MAX_MB:MAX_DAYS");
+
+	ret |= cargo_add_option(cargo, 0,
+			"<output> --retention_interval", NULL,
+			"i", &args->retention_interval);
+	ret |= cargo_set_option_description(cargo,
+			"--retention_interval",
+			"How often the output directories are checked against the "
+			"--retention quotas. Default %d seconds.", DEFAULT_RETENTION_INTERVAL);
+	ret |= cargo_add_validation(cargo, 0,
+			"--retention_interval",
+			cargo_validate_int_range(10, 7 * 24 * 60 * 60));
+	ret |= cargo_set_metavar(cargo, "--retention_interval", "SECONDS");
+
+	ret |= cargo_add_option(cargo, 0,
+			"<output> --recompress_age",
+			"Recompress match, step and obstruct images saved in a fast "
+			"format (--image_format qoi or pgm) into png once they are this "
+			"many hours old. This is only done when no cat has been seen for "
+			"--idle_time seconds. Note that the paths already passed to "
+			"templates and commands then refer to the old file name.",
+			"i", &args->recompress_age);
+	ret |= cargo_set_metavar(cargo, "--recompress_age", "HOURS");
+
+	ret |= cargo_add_option(cargo, 0,
+			"<output> --idle_time", NULL,
+			"i", &args->idle_time);
+	ret |= cargo_set_option_description(cargo,
+			"--idle_time",
+			"Seconds since the last match before the system counts as "
+			"idle for --recompress_age. Default %d.", DEFAULT_RETENTION_IDLE_TIME);
+	ret |= cargo_set_metavar(cargo, "--idle_time", "SECONDS");
+
 	ret |= cargo_add_option(cargo, 0,
 			"<output> --input",
 			"Path to one or more template files generated on specified events. "
@@ -394,6 +759,76 @@ static int add_output_options(cargo_t cargo, catcierge_args_t *args)
 			"s", &args->obstruct_output_path);
 	ret |= cargo_set_metavar(cargo, "--obstruct_output_path", "PATH");
 
+	ret |= cargo_add_option(cargo, 0,
+			"<output> --archive",
+			"Instead of saving each image as a separate file, append each "
+			"match group as a single record to this archive (and its .idx "
+			"index). The record holds the match, step and obstruct images "
+			"together with the event JSON. The path can contain variables, "
+			"to start a new archive each month for instance.\n"
+			"Example: --archive %%output_path%%/%%time:@Y-@m%%.cca\n"
+			"The *_path variables of the images will then refer to the "
+			"file names inside the archive. Use catcierge_archive_tool to "
+			"list and extract them.",
+			"s", &args->archive_path);
+	ret |= cargo_set_metavar(cargo, "--archive", "PATH");
+
+	ret |= cargo_add_option(cargo, 0,
+			"<output> --journal",
+			"Append a small binary record of each match group (time, "
+			"decision, direction, match results and RFID state) to this "
+			"journal file. Use catcierge_query to count lockouts and "
+			"passes over a time range.",
+			"s", &args->journal_path);
+	ret |= cargo_set_metavar(cargo, "--journal", "PATH");
+
+	ret |= cargo_add_option(cargo, 0,
+			"<output> --mosaic",
+			"Compose a summary image of each match group from the frames "
+			"in memory: the match frames with their match rectangles, "
+			"the step images (with --save_steps) and captions. It is "
+			"written in the background and the mosaic_done event is "
+			"triggered once it is, with %%mosaic_path%% set to it. "
+			"The path can contain variables and its extension gives "
+			"the format.\n"
+			"Example: --mosaic %%output_path%%/mosaic_%%time:@Y-@m-@d_@H_@M_@S%%.jpg",
+			"s", &args->mosaic_path);
+	ret |= cargo_set_metavar(cargo, "--mosaic", "PATH");
+
+	ret |= cargo_add_option(cargo, 0,
+			"<output> --mosaic_width", NULL,
+			"i", &args->mosaic_width);
+	ret |= cargo_set_option_description(cargo,
+			"--mosaic_width",
+			"Width in pixels of each match in the mosaic. Default %d.",
+			DEFAULT_MOSAIC_WIDTH);
+	ret |= cargo_add_validation(cargo, 0,
+			"--mosaic_width",
+			cargo_validate_int_range(CATCIERGE_MOSAIC_MIN_WIDTH, CATCIERGE_MOSAIC_MAX_WIDTH));
+
+	ret |= cargo_add_option(cargo, 0,
+			"<output> --frame_ring",
+			"Copy each captured frame into a POSIX shared memory ring "
+			"with this name (such as /catcierge) that other local "
+			"processes can map read-only, see catcierge_frame_ring.h for "
+			"the layout and extra/catcierge-frame-ring.py for a reader. "
+			"Each frame has a sequence number and a capture time, and a "
+			"seqlock per slot tells readers when a frame was overwritten "
+			"while they read it.",
+			"s", &args->frame_ring);
+	ret |= cargo_set_metavar(cargo, "--frame_ring", "NAME");
+
+	ret |= cargo_add_option(cargo, 0,
+			"<output> --frame_ring_slots", NULL,
+			"i", &args->frame_ring_slots);
+	ret |= cargo_set_option_description(cargo,
+			"--frame_ring_slots",
+			"Number of frames kept in the --frame_ring. Default %d.",
+			DEFAULT_FRAME_RING_SLOTS);
+	ret |= cargo_add_validation(cargo, 0,
+			"--frame_ring_slots",
+			cargo_validate_int_range(2, CATCIERGE_FRAME_RING_MAX_SLOTS));
+
 	ret |= cargo_add_option(cargo, 0,
 			"<output> --template_output_path",
 			"Output path for templates (given by --template). "
@@ -435,6 +870,33 @@ static int add_output_options(cargo_t cargo, catcierge_args_t *args)
 			"The ZMQ transport to use. Default %s",
 			DEFAULT_ZMQ_TRANSPORT);
 
+	ret |= cargo_add_option(cargo, 0,
+			"<output> --zmq_hwm",
+			NULL,
+			"i", &args->zmq_hwm);
+	ret |= cargo_set_option_description(cargo,
+			"--zmq_hwm",
+			"The max number of messages waiting to be published. "
+			"Messages are sent from a separate thread, and new ones "
+			"are dropped when this many are waiting, either for the "
+			"thread or for a slow subscriber. Default %d.",
+			DEFAULT_ZMQ_HWM);
+	ret |= cargo_add_validation(cargo, 0,
+			"--zmq_hwm",
+			cargo_validate_int_range(1, CATCIERGE_ZMQ_MAX_HWM));
+
+	ret |= cargo_add_option(cargo, 0,
+			"<output> --zmq_images",
+			"Also publish the match images of each match group under the "
+			"topic \"" CATCIERGE_ZMQ_IMAGES_TOPIC "\". Either \"raw\" "
+			"pixels or encoded as \"png\", \"qoi\" or \"pgm\". The "
+			"message has the topic, the match group as JSON, a frame with "
+			"the format on the first line and \"width height channels "
+			"stride\" for each image on the following lines, and then "
+			"one frame per image. Default none.",
+			"c", parse_zmq_images, &args->zmq_images);
+	ret |= cargo_set_metavar(cargo, "--zmq_images", "FORMAT");
+
 	#endif // WITH_ZMQ
 
 	return ret;
@@ -486,6 +948,93 @@ int add_rfid_options(cargo_t cargo, catcierge_args_t *args)
 }
 #endif // WITH_RFID
 
+static int add_notify_options(cargo_t cargo, catcierge_args_t *args)
+{
+	int ret = 0;
+
+	ret |= cargo_add_group(cargo, 0,
+			"notify", "Notification settings",
+			"Sends notifications by mail or to a webhook from inside "
+			"catcierge, without starting a script for each event. "
+			"Events are collected over a window and sent as one message, "
+			"so a burst of visits only gives a single notification.");
+
+	ret |= cargo_add_option(cargo, 0,
+			"<notify> --notify",
+			"One or more places to send the notifications to. Either "
+			"smtp://HOST[:PORT]/RECIPIENT to send a mail through an SMTP "
+			"server that accepts it without authentication (such as a "
+			"local relay), or http://HOST[:PORT]/PATH to POST a JSON "
+			"object with the subject and the events to a webhook.\n"
+			"Example: --notify smtp://localhost/me@example.com",
+			"[s]+", &args->notify, &args->notify_count);
+	ret |= cargo_set_metavar(cargo, "--notify", "URL");
+
+	ret |= cargo_add_option(cargo, 0,
+			"<notify> --notify_events", NULL,
+			"[s]+", &args->notify_events, &args->notify_events_count);
+	ret |= cargo_set_option_description(cargo,
+			"--notify_events",
+			"The events to notify about, or \"all\". See --eventhelp for "
+			"the names. Default %s.", DEFAULT_NOTIFY_EVENTS);
+	ret |= cargo_set_metavar(cargo, "--notify_events", "EVENT");
+
+	ret |= cargo_add_option(cargo, 0,
+			"<notify> --notify_format", NULL,
+			"s", &args->notify_format);
+	ret |= cargo_set_option_description(cargo,
+			"--notify_format",
+			"The line added to the notification for each event. Can "
+			"contain the same variables as the commands, see --cmdhelp. "
+			"Default \"%s\".", DEFAULT_NOTIFY_FORMAT);
+	ret |= cargo_set_metavar(cargo, "--notify_format", "FORMAT");
+
+	ret |= cargo_add_option(cargo, 0,
+			"<notify> --notify_from", NULL,
+			"s", &args->notify_from);
+	ret |= cargo_set_option_description(cargo,
+			"--notify_from",
+			"Sender address of the notification mails. Default %s.",
+			DEFAULT_NOTIFY_FROM);
+	ret |= cargo_set_metavar(cargo, "--notify_from", "ADDRESS");
+
+	ret |= cargo_add_option(cargo, 0,
+			"<notify> --notify_subject", NULL,
+			"s", &args->notify_subject);
+	ret |= cargo_set_option_description(cargo,
+			"--notify_subject",
+			"Subject of the notifications, the number of events is "
+			"added when there is more than one. Default \"%s\".",
+			DEFAULT_NOTIFY_SUBJECT);
+
+	ret |= cargo_add_option(cargo, 0,
+			"<notify> --notify_window", NULL,
+			"i", &args->notify_window);
+	ret |= cargo_set_option_description(cargo,
+			"--notify_window",
+			"Seconds to collect events after the first one before "
+			"they are sent. Default %d.", DEFAULT_NOTIFY_WINDOW);
+	ret |= cargo_add_validation(cargo, 0,
+			"--notify_window",
+			cargo_validate_int_range(0, 24 * 60 * 60));
+	ret |= cargo_set_metavar(cargo, "--notify_window", "SECONDS");
+
+	ret |= cargo_add_option(cargo, 0,
+			"<notify> --notify_interval", NULL,
+			"i", &args->notify_interval);
+	ret |= cargo_set_option_description(cargo,
+			"--notify_interval",
+			"The least number of seconds between two notifications. "
+			"Events in between are sent together once it has passed. "
+			"Default %d.", DEFAULT_NOTIFY_INTERVAL);
+	ret |= cargo_add_validation(cargo, 0,
+			"--notify_interval",
+			cargo_validate_int_range(0, 24 * 60 * 60));
+	ret |= cargo_set_metavar(cargo, "--notify_interval", "SECONDS");
+
+	return ret;
+}
+
 static int add_command_options(cargo_t cargo, catcierge_args_t *args)
 {
 	int ret = 0;
@@ -510,8 +1059,8 @@ static int add_command_options(cargo_t cargo, catcierge_args_t *args)
 			"cmd_help", "Advanced command settings", 
 			"These are commands that will be executed when certain events "
 			"occur. You can specify multiple commands, they will be started "
-			"in the order they are added. Each process is forked and run in "
-			"parallel with the others. If you want them to run sequentially "
+			"in the order they are added. Each process is run in parallel "
+			"with the others (see --max_running_cmds). If you want them to run sequentially "
 			"you need to create a script and run that.\n"
 			"Variables can be passed to these commands such as:\n"
 			"  %%state%%, %%match_success%% and so on.\n"
@@ -539,6 +1088,56 @@ static int add_command_options(cargo_t cargo, catcierge_args_t *args)
 			"multiple places.",
 			"[s]+", &args->user_vars, &args->user_var_count);
 
+	ret |= cargo_add_option(cargo, 0,
+			"<cmd> --max_running_cmds", NULL,
+			"i", &args->max_running_cmds);
+	ret |= cargo_set_option_description(cargo,
+			"--max_running_cmds",
+			"The max number of commands running at the same time. Commands "
+			"triggered while this many are running are queued until one "
+			"of them exits. Default %d.", DEFAULT_MAX_RUNNING_CMDS);
+	ret |= cargo_add_validation(cargo, 0,
+			"--max_running_cmds",
+			cargo_validate_int_range(1, CATCIERGE_EXECUTOR_MAX_RUNNING));
+
+	ret |= cargo_add_option(cargo, 0,
+			"<cmd> --max_queued_cmds", NULL,
+			"i", &args->max_queued_cmds);
+	ret |= cargo_set_option_description(cargo,
+			"--max_queued_cmds",
+			"The max number of commands waiting to run. Commands "
+			"triggered when the queue is full are dropped. Default %d.",
+			DEFAULT_MAX_QUEUED_CMDS);
+
+	ret |= cargo_add_option(cargo, 0,
+			"<cmd> --async_events",
+			"Generate the output templates and run the commands for events "
+			"on a separate thread, so that the matching is not held up by "
+			"them. Each event sees the state as it was when it was triggered.",
+			"b", &args->async_events);
+
+	ret |= cargo_add_option(cargo, 0,
+			"<cmd> --event_queue_size", NULL,
+			"i", &args->event_queue_size);
+	ret |= cargo_set_option_description(cargo,
+			"--event_queue_size",
+			"The max number of events waiting to be processed when "
+			"using --async_events. Default %d.", DEFAULT_EVENT_QUEUE_SIZE);
+	ret |= cargo_add_validation(cargo, 0,
+			"--event_queue_size",
+			cargo_validate_int_range(1, CATCIERGE_EVENT_QUEUE_MAX_SIZE));
+
+	ret |= cargo_add_option(cargo, 0,
+			"<cmd> --event_queue_timeout", NULL,
+			"i", &args->event_queue_timeout);
+	ret |= cargo_set_option_description(cargo,
+			"--event_queue_timeout",
+			"Milliseconds to wait for room in the event queue when it is "
+			"full, before the event is dropped. Default %d.",
+			DEFAULT_EVENT_QUEUE_TIMEOUT);
+	ret |= cargo_set_metavar(cargo,
+			"--event_queue_timeout", "MILLISECONDS");
+
 	return ret;
 }
 
@@ -675,6 +1274,7 @@ static int add_options(cargo_t cargo, catcierge_args_t *args)
 	#ifdef WITH_RFID
 	ret |= add_rfid_options(cargo, args);
 	#endif
+	ret |= add_notify_options(cargo, args);
 	ret |= add_command_options(cargo, args);
 
 	return ret;
@@ -717,6 +1317,9 @@ static void print_event_help(cargo_t cargo, catcierge_args_t *args)
 		   " %%!nofile      Don't output any file for this template "
 		                  "(if you only want to publish it via ZMQ)\n"
 		   " %%!rootpath    Make all paths relative to this path.\n"
+		   " %%!format      json or msgpack. Output the event data using the "
+		                   "built in serializer instead of the template body. "
+		                   "The default is text.\n"
 		   "\n"
 		   "List of events:\n");
 
@@ -735,6 +1338,12 @@ static void print_cmd_help(cargo_t cargo, catcierge_args_t *args)
 	catcierge_template_output_print_usage();
 	printf("\n");
 	catcierge_haar_output_print_usage();
+	printf("\n");
+	catcierge_chain_output_print_usage();
+	#ifdef WITH_DNN
+	printf("\n");
+	catcierge_dnn_output_print_usage();
+	#endif
 }
 
 void catcierge_args_init_vars(catcierge_args_t *args)
@@ -743,6 +1352,10 @@ void catcierge_args_init_vars(catcierge_args_t *args)
 
 	catcierge_template_matcher_args_init(&args->templ);
 	catcierge_haar_matcher_args_init(&args->haar);
+	catcierge_chain_matcher_args_init(&args->chain);
+	#ifdef WITH_DNN
+	catcierge_dnn_matcher_args_init(&args->dnn);
+	#endif
 	args->config_path = strdup(CATCIERGE_CONF_PATH);
 	args->saveimg = 1;
 	args->save_obstruct_img = 0;
@@ -751,6 +1364,25 @@ void catcierge_args_init_vars(catcierge_args_t *args)
 	args->lockout_time = DEFAULT_LOCKOUT_TIME;
 	args->consecutive_lockout_delay = DEFAULT_CONSECUTIVE_LOCKOUT_DELAY;
 	args->ok_matches_needed = DEFAULT_OK_MATCHES_NEEDED;
+	args->stream_window = DEFAULT_STREAM_WINDOW;
+	args->burst = 1;
+	args->max_running_cmds = DEFAULT_MAX_RUNNING_CMDS;
+	args->max_queued_cmds = DEFAULT_MAX_QUEUED_CMDS;
+	args->event_queue_size = DEFAULT_EVENT_QUEUE_SIZE;
+	args->event_queue_timeout = DEFAULT_EVENT_QUEUE_TIMEOUT;
+	args->image_queue_size = DEFAULT_IMAGE_QUEUE_SIZE;
+	args->mosaic_width = DEFAULT_MOSAIC_WIDTH;
+	args->frame_ring_slots = DEFAULT_FRAME_RING_SLOTS;
+	args->image_format = CATCIERGE_IMAGE_PNG;
+	args->png_compression = DEFAULT_PNG_COMPRESSION;
+	args->staging_size = DEFAULT_STAGING_SIZE;
+	args->flush_interval = DEFAULT_FLUSH_INTERVAL;
+	args->flush_fsync = DEFAULT_FLUSH_FSYNC;
+	args->retention_interval = DEFAULT_RETENTION_INTERVAL;
+	args->idle_time = DEFAULT_RETENTION_IDLE_TIME;
+	args->notify_format = strdup(DEFAULT_NOTIFY_FORMAT);
+	args->notify_window = DEFAULT_NOTIFY_WINDOW;
+	args->notify_interval = DEFAULT_NOTIFY_INTERVAL;
 	args->output_path = strdup(".");
 	args->min_backlight = DEFAULT_MIN_BACKLIGHT;
 
@@ -777,6 +1409,7 @@ void catcierge_args_init_vars(catcierge_args_t *args)
 	args->zmq_port = DEFAULT_ZMQ_PORT;
 	args->zmq_iface = strdup(DEFAULT_ZMQ_IFACE);
 	args->zmq_transport = strdup(DEFAULT_ZMQ_TRANSPORT);
+	args->zmq_hwm = DEFAULT_ZMQ_HWM;
 	#endif
 }
 
@@ -790,6 +1423,10 @@ void catcierge_args_destroy_vars(catcierge_args_t *args)
 	catcierge_xfree(&args->match_output_path);
 	catcierge_xfree(&args->steps_output_path);
 	catcierge_xfree(&args->obstruct_output_path);
+	catcierge_xfree(&args->archive_path);
+	catcierge_xfree(&args->journal_path);
+	catcierge_xfree(&args->mosaic_path);
+	catcierge_xfree(&args->frame_ring);
 	catcierge_xfree(&args->template_output_path);
 
 	#ifdef WITH_ZMQ
@@ -805,8 +1442,18 @@ void catcierge_args_destroy_vars(catcierge_args_t *args)
 	args->input_count = 0;
 	catcierge_xfree(&args->inputs);
 
+	catcierge_xfree_list(&args->retention, &args->retention_count);
+	catcierge_xfree_list(&args->notify, &args->notify_count);
+	catcierge_xfree_list(&args->notify_events, &args->notify_events_count);
+	catcierge_xfree(&args->notify_format);
+	catcierge_xfree(&args->notify_from);
+	catcierge_xfree(&args->notify_subject);
+
 	catcierge_xfree(&args->log_path);
 
+	catcierge_xfree(&args->gpio_backend);
+	catcierge_xfree(&args->gpio_chip);
+
 	#define CATCIERGE_DEFINE_EVENT(ev_enum_name, ev_name, ev_description) 		\
 		catcierge_free_list(args->ev_name ## _cmd, args->ev_name ## _cmd_count);\
 		args->ev_name ## _cmd_count = 0;										\
@@ -837,6 +1484,10 @@ void catcierge_args_destroy_vars(catcierge_args_t *args)
 
 	catcierge_haar_matcher_args_destroy(&args->haar);
 	catcierge_template_matcher_args_destroy(&args->templ);
+	catcierge_chain_matcher_args_destroy(&args->chain);
+	#ifdef WITH_DNN
+	catcierge_dnn_matcher_args_destroy(&args->dnn);
+	#endif
 
 	catcierge_xfree_list(&args->user_vars, &args->user_var_count);
 }
@@ -954,6 +1605,33 @@ int catcierge_args_parse(catcierge_args_t *args, int argc, char **argv)
 		ret = -1; goto fail;
 	}
 
+	if (parse_retention_quotas(args))
+	{
+		ret = -1; goto fail;
+	}
+
+	if (parse_notify_settings(args))
+	{
+		ret = -1; goto fail;
+	}
+
+	// A shorter window could never have enough successful matches.
+	if (args->streaming && (args->stream_window < args->ok_matches_needed))
+	{
+		CATERR("--stream_window %d is smaller than --ok_matches_needed %d\n",
+			args->stream_window, args->ok_matches_needed);
+		ret = -1; goto fail;
+	}
+
+	#ifdef WITH_DNN
+	// Streaming needs a result for each frame as it is matched.
+	if (args->streaming && (args->matcher_type == MATCHER_DNN) && !args->dnn.no_batch)
+	{
+		CATLOG("DNN matcher: Batching turned off in streaming mode\n");
+		args->dnn.no_batch = 1;
+	}
+	#endif
+
 	if (args->show_cmd_help)
 	{
 		print_cmd_help(cargo, args);
@@ -984,9 +1662,7 @@ fail:
 
 void catcierge_print_settings(catcierge_args_t *args)
 {
-	#ifdef WITH_RFID
 	size_t i;
-	#endif
 
 	print_line(stdout, 80, "-");
 	printf("Settings:\n");
@@ -1003,8 +1679,43 @@ void catcierge_print_settings(catcierge_args_t *args)
 	printf("        Save matches: %d\n", args->saveimg);
 	printf("       Save obstruct: %d\n", args->save_obstruct_img);
 	printf("          Save steps: %d\n", args->save_steps);
+	printf("           Sync save: %d\n", args->sync_save);
+	if (!args->sync_save)
+	{
+	printf("    Image queue size: %d\n", args->image_queue_size);
+	}
+	printf("        Image format: %s\n", catcierge_image_format_str(args->image_format));
+	if (args->image_format == CATCIERGE_IMAGE_PNG)
+	{
+	printf("     PNG compression: %d\n", args->png_compression);
+	}
+	printf("             Staging: %d\n", args->staging);
+	if (args->staging)
+	{
+	printf("        Staging size: %d MB\n", args->staging_size);
+	printf("      Flush interval: %d seconds\n", args->flush_interval);
+	printf("         Flush fsync: %s\n", catcierge_fsync_policy_str(args->flush_fsync));
+	}
+	if (args->retention_count || args->recompress_age)
+	{
+	for (i = 0; i < CATCIERGE_RETAIN_CLASS_COUNT; i++)
+	{
+	printf("%10s retention: %d MB, %d days\n",
+		catcierge_retention_class_str((catcierge_retention_class_t)i),
+		(int)(args->retention_quotas[i].max_size / (1024 * 1024)),
+		args->retention_quotas[i].max_age);
+	}
+	printf("  Retention interval: %d seconds\n", args->retention_interval);
+	printf("      Recompress age: %d hours\n", args->recompress_age);
+	printf("           Idle time: %d seconds\n", args->idle_time);
+	}
 	printf("     Highlight match: %d\n", args->highlight_match);
 	printf("       Lockout dummy: %d\n", args->lockout_dummy);
+	#ifdef RPI
+	printf("        GPIO backend: %s\n", args->gpio_backend ? args->gpio_backend : "sysfs");
+	if (args->gpio_chip)
+	printf("           GPIO chip: %s\n", args->gpio_chip);
+	#endif // RPI
 	printf("      Lockout method: %d\n", args->lockout_method);
 	printf("           Lock time: %d seconds\n", args->lockout_time);
 	printf("       Lockout error: %d %s\n", args->max_consecutive_lockout_count,
@@ -1012,9 +1723,22 @@ void catcierge_print_settings(catcierge_args_t *args)
 	printf("   Lockout err delay: %0.1f\n", args->consecutive_lockout_delay);
 	printf("       Match timeout: %d seconds\n", args->match_time);
 	printf("            Log file: %s\n", args->log_path ? args->log_path : "-");
+	printf("    Max running cmds: %d\n", args->max_running_cmds);
+	printf("     Max queued cmds: %d\n", args->max_queued_cmds);
+	printf("        Async events: %d\n", args->async_events);
+	if (args->async_events)
+	{
+	printf("    Event queue size: %d\n", args->event_queue_size);
+	printf(" Event queue timeout: %d ms\n", args->event_queue_timeout);
+	}
 	printf("            No color: %d\n", args->nocolor);
 	printf("        No animation: %d\n", args->noanim);
 	printf("   Ok matches needed: %d\n", args->ok_matches_needed);
+	printf("      Early decision: %d\n", args->early_decision);
+	printf("               Burst: %d\n", args->burst);
+	printf("         Match cache: %0.2f\n", args->match_cache);
+	printf("           Streaming: %d\n", args->streaming);
+	printf("       Stream window: %d\n", args->stream_window);
 	printf("         Output path: %s\n", args->output_path);
 	if (args->match_output_path && strcmp(args->output_path, args->match_output_path))
 	printf("   Match output path: %s\n", args->match_output_path);
@@ -1024,11 +1748,25 @@ void catcierge_print_settings(catcierge_args_t *args)
 	printf("Obstruct output path: %s\n", args->obstruct_output_path);
 	if (args->template_output_path && strcmp(args->output_path, args->template_output_path))
 	printf("Template output path: %s\n", args->template_output_path);
+	if (args->archive_path)
+	printf("             Archive: %s\n", args->archive_path);
+	if (args->journal_path)
+	printf("             Journal: %s\n", args->journal_path);
+	if (args->mosaic_path)
+	printf("              Mosaic: %s (%d wide)\n", args->mosaic_path, args->mosaic_width);
+	if (args->frame_ring)
+	printf("          Frame ring: %s (%d slots)\n", args->frame_ring, args->frame_ring_slots);
+	for (i = 0; i < args->notify_count; i++)
+	printf("              Notify: %s\n", args->notify[i]);
+	if (args->notify_count)
+	printf("     Notify interval: %d s (window %d s)\n", args->notify_interval, args->notify_window);
 	#ifdef WITH_ZMQ
 	printf("       ZMQ publisher: %d\n", args->zmq);
 	printf("            ZMQ port: %d\n", args->zmq_port);
 	printf("       ZMQ interface: %s\n", args->zmq_iface);
 	printf("       ZMQ transport: %s\n", args->zmq_transport);
+	printf("             ZMQ HWM: %d\n", args->zmq_hwm);
+	printf("          ZMQ images: %s\n", catcierge_zmq_images_str(args->zmq_images));
 	#endif // WITH_ZMQ
 	printf("\n"); 
 	if (args->matcher_type == MATCHER_TEMPLATE)
@@ -1036,6 +1774,29 @@ void catcierge_print_settings(catcierge_args_t *args)
 		printf("        Matcher type: template\n");
 		catcierge_template_matcher_print_settings(&args->templ);
 	}
+	else if (args->matcher_type == MATCHER_CHAIN)
+	{
+		printf("        Matcher type: chain\n");
+		catcierge_chain_matcher_print_settings(&args->chain);
+
+		if ((args->chain.gate == CHAIN_GATE_TEMPLATE)
+		 || (args->chain.main_type == MATCHER_TEMPLATE))
+		{
+			catcierge_template_matcher_print_settings(&args->templ);
+		}
+
+		if (args->chain.main_type == MATCHER_HAAR)
+		{
+			catcierge_haar_matcher_print_settings(&args->haar);
+		}
+	}
+	#ifdef WITH_DNN
+	else if (args->matcher_type == MATCHER_DNN)
+	{
+		printf("        Matcher type: dnn\n");
+		catcierge_dnn_matcher_print_settings(&args->dnn);
+	}
+	#endif
 	else
 	{
 		printf("        Matcher type: haar\n");
@@ -1056,6 +1817,15 @@ void catcierge_print_settings(catcierge_args_t *args)
 	print_line(stdout, 80, "-");
 }
 
+static void catcierge_set_common_matcher_args(catcierge_args_t *args,
+											catcierge_matcher_args_t *margs)
+{
+	margs->roi = &args->roi;
+	margs->min_backlight = args->min_backlight;
+	margs->auto_roi_thr = args->auto_roi_thr;
+	margs->save_auto_roi_img = args->save_auto_roi_img;
+}
+
 catcierge_matcher_args_t *catcierge_get_matcher_args(catcierge_args_t *args)
 {
 	catcierge_matcher_args_t *margs = NULL;
@@ -1068,14 +1838,26 @@ catcierge_matcher_args_t *catcierge_get_matcher_args(catcierge_args_t *args)
 	{
 		margs = (catcierge_matcher_args_t *)&args->haar;
 	}
+	else if (args->matcher_type == MATCHER_CHAIN)
+	{
+		// The chain stages are inited from the ordinary matcher args.
+		args->chain.templ = &args->templ;
+		args->chain.haar = &args->haar;
+		catcierge_set_common_matcher_args(args, &args->templ.super);
+		catcierge_set_common_matcher_args(args, &args->haar.super);
+		margs = (catcierge_matcher_args_t *)&args->chain;
+	}
+	#ifdef WITH_DNN
+	else if (args->matcher_type == MATCHER_DNN)
+	{
+		margs = (catcierge_matcher_args_t *)&args->dnn;
+	}
+	#endif
 
 	// TODO: This is an ugly way to pass this on... But whatever for now.
 	if (margs)
 	{
-		margs->roi = &args->roi;
-		margs->min_backlight = args->min_backlight;
-		margs->auto_roi_thr = args->auto_roi_thr;
-		margs->save_auto_roi_img = args->save_auto_roi_img;
+		catcierge_set_common_matcher_args(args, margs);
 	}
 
 	return margs;
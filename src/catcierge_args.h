@@ -28,7 +28,23 @@
 #include "catcierge_matcher.h"
 #include "catcierge_template_matcher.h"
 #include "catcierge_haar_matcher.h"
+#include "catcierge_chain_matcher.h"
+#ifdef WITH_DNN
+#include "catcierge_dnn_matcher.h"
+#endif
 #include "catcierge_types.h"
+#include "catcierge_match_window.h"
+#include "catcierge_frame_quality.h"
+#include "catcierge_executor.h"
+#include "catcierge_event_bus.h"
+#include "catcierge_image_writer.h"
+#include "catcierge_image_format.h"
+#include "catcierge_staging.h"
+#include "catcierge_retention.h"
+#include "catcierge_mosaic.h"
+#include "catcierge_notify.h"
+#include "catcierge_publisher.h"
+#include "catcierge_frame_ring.h"
 #include "cargo.h"
 #include "cargo_ini.h"
 
@@ -37,6 +53,7 @@
 #define DEFAULT_CONSECUTIVE_LOCKOUT_DELAY 3.0 // The time in seconds between lockouts that is considered consecutive.
 #define MAX_TEMP_CONFIG_VALUES 128
 #define DEFAULT_OK_MATCHES_NEEDED 2
+#define DEFAULT_STREAM_WINDOW MATCH_MAX_COUNT
 #define MAX_INPUT_TEMPLATES 32
 #ifdef WITH_ZMQ
 #define DEFAULT_ZMQ_PORT 5556
@@ -69,14 +86,54 @@ typedef struct catcierge_args_s
 	char *match_output_path;
 	char *steps_output_path;
 	char *obstruct_output_path;
+	char *archive_path;
+	char *journal_path;
+	char *mosaic_path;
+	int mosaic_width;
+	char *frame_ring;
+	int frame_ring_slots;
 	char *template_output_path;
 	int ok_matches_needed;
 	int save_steps;
+	int sync_save;
+	int image_queue_size;
+	catcierge_image_format_t image_format;
+	int png_compression;
+	int staging;
+	int staging_size;
+	int flush_interval;
+	catcierge_fsync_policy_t flush_fsync;
+	char **retention;
+	size_t retention_count;
+	catcierge_retention_quota_t retention_quotas[CATCIERGE_RETAIN_CLASS_COUNT];
+	int retention_interval;
+	int recompress_age;
+	int idle_time;
+	char **notify;
+	size_t notify_count;
+	catcierge_notify_target_t notify_targets[CATCIERGE_NOTIFY_MAX_TARGETS];
+	char **notify_events;
+	size_t notify_events_count;
+	unsigned int notify_event_mask;
+	char *notify_format;
+	char *notify_from;
+	char *notify_subject;
+	int notify_window;
+	int notify_interval;
 	int no_final_decision;
+	int early_decision;
+	int burst;
+	double match_cache;
+	int streaming;
+	int stream_window;
 
 	catcierge_matcher_type_t matcher_type;
 	catcierge_template_matcher_args_t templ;
 	catcierge_haar_matcher_args_t haar;
+	catcierge_chain_matcher_args_t chain;
+	#ifdef WITH_DNN
+	catcierge_dnn_matcher_args_t dnn;
+	#endif
 
 	char *log_path; // TODO: Remove this.
 
@@ -121,6 +178,14 @@ typedef struct catcierge_args_s
 	int lockout_gpio_pin;
 	int backlight_gpio_pin;
 	int backlight_enable;
+	char *gpio_backend;
+	char *gpio_chip;
+
+	int max_running_cmds;
+	int max_queued_cmds;
+	int async_events;
+	int event_queue_size;
+	int event_queue_timeout;
 
 	#ifdef RPI
 	char *rpi_config_path;
@@ -133,6 +198,8 @@ typedef struct catcierge_args_s
 	int zmq_port;
 	char *zmq_iface;
 	char *zmq_transport;
+	int zmq_hwm;
+	catcierge_zmq_images_t zmq_images;
 	#endif // WITH_ZMQ
 } catcierge_args_t;
 
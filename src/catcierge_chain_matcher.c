@@ -0,0 +1,499 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <assert.h>
+#include "catcierge_chain_matcher.h"
+#include "catcierge_types.h"
+#include "catcierge_util.h"
+#include "catcierge_log.h"
+#include "cargo.h"
+
+//
+// The chain matcher runs a cheap gate in front of an expensive matcher.
+// Frames the gate rejects (nothing in the frame, or no snout found)
+// never reach the expensive stage, instead they get the result the
+// expensive stage would have given for a frame without a cat in it.
+//
+
+int catcierge_chain_matcher_init(catcierge_matcher_t **octx,
+		catcierge_matcher_args_t *oargs)
+{
+	catcierge_chain_matcher_t *ctx = NULL;
+	catcierge_chain_matcher_args_t *args = (catcierge_chain_matcher_args_t *)oargs;
+	catcierge_matcher_args_t *main_args = NULL;
+	catcierge_chain_stage_t *gate;
+	catcierge_chain_stage_t *mainst;
+	assert(args);
+	assert(octx);
+
+	if ((args->main_type != MATCHER_HAAR) && (args->main_type != MATCHER_TEMPLATE))
+	{
+		CATERR("Chain matcher: Invalid main matcher type\n");
+		return -1;
+	}
+
+	if ((args->gate == CHAIN_GATE_TEMPLATE) && (args->main_type == MATCHER_TEMPLATE))
+	{
+		CATERR("Chain matcher: The template gate can only be used "
+				"in front of the haar matcher\n");
+		return -1;
+	}
+
+	if (!args->templ || !args->haar)
+	{
+		CATERR("Chain matcher: Missing matcher settings\n");
+		return -1;
+	}
+
+	if (!(*octx = calloc(1, sizeof(catcierge_chain_matcher_t))))
+	{
+		CATERR("Out of memory!\n");
+		return -1;
+	}
+
+	ctx = (catcierge_chain_matcher_t *)*octx;
+
+	ctx->super.type = MATCHER_CHAIN;
+	ctx->super.name = "Chain";
+	ctx->super.short_name = "chain";
+	ctx->args = args;
+
+	gate = &ctx->stages[CHAIN_STAGE_GATE];
+	mainst = &ctx->stages[CHAIN_STAGE_MAIN];
+
+	gate->name = catcierge_chain_gate_str(args->gate);
+
+	if (args->gate == CHAIN_GATE_TEMPLATE)
+	{
+		if (catcierge_matcher_init(&gate->matcher,
+				(catcierge_matcher_args_t *)args->templ))
+		{
+			CATERR("Chain matcher: Failed to init template gate\n");
+			goto fail;
+		}
+	}
+
+	main_args = (args->main_type == MATCHER_HAAR)
+		? (catcierge_matcher_args_t *)args->haar
+		: (catcierge_matcher_args_t *)args->templ;
+
+	if (catcierge_matcher_init(&mainst->matcher, main_args))
+	{
+		CATERR("Chain matcher: Failed to init main matcher\n");
+		goto fail;
+	}
+
+	mainst->name = mainst->matcher->short_name;
+
+	ctx->super.debug = mainst->matcher->debug;
+	ctx->super.match = catcierge_chain_matcher_match;
+	ctx->super.decide = catcierge_chain_matcher_decide;
+	ctx->super.translate = catcierge_chain_matcher_translate;
+	ctx->super.var_name = catcierge_chain_matcher_var_name;
+
+	return 0;
+fail:
+	catcierge_chain_matcher_destroy(octx);
+	return -1;
+}
+
+void catcierge_chain_matcher_destroy(catcierge_matcher_t **octx)
+{
+	catcierge_chain_matcher_t *ctx;
+	size_t i;
+
+	if (!octx || !(*octx))
+		return;
+
+	ctx = (catcierge_chain_matcher_t *)*octx;
+
+	for (i = 0; i < CHAIN_STAGE_COUNT; i++)
+	{
+		catcierge_chain_stage_t *stage = &ctx->stages[i];
+
+		if (stage->name && (stage->hits || stage->skips))
+		{
+			CATLOG("Chain stage %d (%s): %lu hits, %lu skips\n",
+				(int)i, stage->name, stage->hits, stage->skips);
+		}
+
+		catcierge_matcher_destroy(&stage->matcher);
+	}
+
+	free(ctx);
+	*octx = NULL;
+}
+
+static void catcierge_chain_matcher_skip_result(catcierge_chain_matcher_t *ctx,
+		match_result_t *result)
+{
+	catcierge_chain_matcher_args_t *args = ctx->args;
+	const char *gate_name = ctx->stages[CHAIN_STAGE_GATE].name;
+
+	result->rect_count = 0;
+	result->step_img_count = 0;
+	result->direction = MATCH_DIR_UNKNOWN;
+
+	if (args->main_type == MATCHER_HAAR)
+	{
+		// Same outcome as when the haar matcher finds no cat head.
+		result->result = args->haar->no_match_is_fail
+			? HAAR_FAIL : HAAR_SUCCESS_NO_HEAD;
+
+		snprintf(result->description, sizeof(result->description) - 1,
+			"%sNo cat head detected (skipped by %s gate)",
+			args->haar->no_match_is_fail ? "Fail " : "", gate_name);
+	}
+	else
+	{
+		result->result = 0.0;
+
+		snprintf(result->description, sizeof(result->description) - 1,
+			"No snout detected (skipped by %s gate)", gate_name);
+	}
+
+	result->success = (result->result > 0.0);
+}
+
+double catcierge_chain_matcher_match(void *octx,
+		IplImage *img, match_result_t *result, int save_steps)
+{
+	catcierge_chain_matcher_t *ctx = (catcierge_chain_matcher_t *)octx;
+	catcierge_chain_stage_t *gate;
+	catcierge_chain_stage_t *mainst;
+	int pass = 0;
+	assert(ctx);
+	assert(ctx->args);
+	assert(img);
+	assert(result);
+
+	gate = &ctx->stages[CHAIN_STAGE_GATE];
+	mainst = &ctx->stages[CHAIN_STAGE_MAIN];
+
+	gate->hits++;
+
+	if (ctx->args->gate == CHAIN_GATE_OBSTRUCT)
+	{
+		pass = catcierge_is_frame_obstructed(&ctx->super, img);
+	}
+	else
+	{
+		// The gate result is overwritten by the main stage
+		// so there is no point in saving any step images for it.
+		pass = (gate->matcher->match(gate->matcher, img, result, 0)
+				>= ctx->args->gate_threshold);
+	}
+
+	if (ctx->super.debug) printf("Chain gate %s: %s\n", gate->name, pass ? "pass" : "skip");
+
+	if (!pass)
+	{
+		mainst->skips++;
+		catcierge_chain_matcher_skip_result(ctx, result);
+		return result->result;
+	}
+
+	mainst->hits++;
+
+	return mainst->matcher->match(mainst->matcher, img, result, save_steps);
+}
+
+int catcierge_chain_matcher_decide(void *octx, match_group_t *mg)
+{
+	catcierge_chain_matcher_t *ctx = (catcierge_chain_matcher_t *)octx;
+	catcierge_matcher_t *m;
+	assert(ctx);
+	assert(mg);
+
+	m = ctx->stages[CHAIN_STAGE_MAIN].matcher;
+
+	return m->decide(m, mg);
+}
+
+const char *catcierge_chain_gate_str(catcierge_chain_gate_t gate)
+{
+	switch (gate)
+	{
+		case CHAIN_GATE_OBSTRUCT: return "obstruct";
+		case CHAIN_GATE_TEMPLATE: return "template";
+		default: return "unknown";
+	}
+}
+
+static int parse_chain_gate(cargo_t ctx, void *user, const char *optname,
+							int argc, char **argv)
+{
+	catcierge_chain_gate_t *gate = (catcierge_chain_gate_t *)user;
+	char *d = NULL;
+
+	if (argc < 1)
+	{
+		cargo_set_error(ctx, 0,
+			"Missing either \"obstruct\" or \"template\" for %s", optname);
+		return -1;
+	}
+
+	d = argv[0];
+
+	if (!strcasecmp(d, "obstruct"))
+	{
+		*gate = CHAIN_GATE_OBSTRUCT;
+	}
+	else if (!strcasecmp(d, "template"))
+	{
+		*gate = CHAIN_GATE_TEMPLATE;
+	}
+	else
+	{
+		cargo_set_error(ctx, 0,
+			"Invalid chain gate \"%s\", must be \"obstruct\" "
+			"or \"template\".", d);
+		return -1;
+	}
+
+	return 1;
+}
+
+static int parse_chain_main(cargo_t ctx, void *user, const char *optname,
+							int argc, char **argv)
+{
+	catcierge_matcher_type_t *type = (catcierge_matcher_type_t *)user;
+	char *d = NULL;
+
+	if (argc < 1)
+	{
+		cargo_set_error(ctx, 0,
+			"Missing either \"haar\" or \"template\" for %s", optname);
+		return -1;
+	}
+
+	d = argv[0];
+
+	if (!strcasecmp(d, "haar"))
+	{
+		*type = MATCHER_HAAR;
+	}
+	else if (!strcasecmp(d, "template"))
+	{
+		*type = MATCHER_TEMPLATE;
+	}
+	else
+	{
+		cargo_set_error(ctx, 0,
+			"Invalid chain main matcher \"%s\", must be \"haar\" "
+			"or \"template\".", d);
+		return -1;
+	}
+
+	return 1;
+}
+
+int catcierge_chain_matcher_add_options(cargo_t cargo,
+										catcierge_chain_matcher_args_t *args)
+{
+	int ret = 0;
+	assert(cargo);
+	assert(args);
+
+	ret |= cargo_add_group(cargo, 0,
+			"chain", "Chain matcher settings",
+			"Settings for when --chain_matcher is used.\n"
+			"A cheap gate is run on each frame, and only frames that pass "
+			"it are given to the main matcher. The gate and main matcher "
+			"use the settings of their respective matcher group.");
+
+	ret |= cargo_add_option(cargo, 0,
+			"<chain> --chain_gate",
+			"The gate to run before the main matcher. \"obstruct\" skips "
+			"frames where nothing is blocking the back light. \"template\" "
+			"skips frames where the template matcher (see --snout) scores "
+			"below --chain_gate_threshold.",
+			"c", parse_chain_gate, &args->gate);
+	ret |= cargo_set_metavar(cargo,
+			"--chain_gate",
+			"OBSTRUCT|TEMPLATE");
+
+	ret |= cargo_add_option(cargo, 0,
+			"<chain> --chain_gate_threshold", NULL,
+			"d", &args->gate_threshold);
+	ret |= cargo_set_option_description(cargo,
+			"--chain_gate_threshold",
+			"The template match score a frame needs to pass the "
+			"template gate. Default %0.2f", DEFAULT_CHAIN_GATE_THRESH);
+
+	ret |= cargo_add_option(cargo, 0,
+			"<chain> --chain_main",
+			"The matcher to run on frames passing the gate.",
+			"c", parse_chain_main, &args->main_type);
+	ret |= cargo_set_metavar(cargo,
+			"--chain_main",
+			"HAAR|TEMPLATE");
+
+	return ret;
+}
+
+void catcierge_chain_matcher_args_init(catcierge_chain_matcher_args_t *args)
+{
+	assert(args);
+	memset(args, 0, sizeof(catcierge_chain_matcher_args_t));
+	args->super.type = MATCHER_CHAIN;
+	args->gate = CHAIN_GATE_OBSTRUCT;
+	args->gate_threshold = DEFAULT_CHAIN_GATE_THRESH;
+	args->main_type = MATCHER_HAAR;
+}
+
+int catcierge_chain_matcher_args_destroy(catcierge_chain_matcher_args_t *args)
+{
+	// The stage settings are owned by the individual matcher args.
+	args->templ = NULL;
+	args->haar = NULL;
+	return 0;
+}
+
+void catcierge_chain_matcher_print_settings(catcierge_chain_matcher_args_t *args)
+{
+	assert(args);
+	printf("Chain Matcher:\n");
+	printf("              Gate: %s\n", catcierge_chain_gate_str(args->gate));
+	if (args->gate == CHAIN_GATE_TEMPLATE)
+	printf("    Gate threshold: %0.2f\n", args->gate_threshold);
+	printf("      Main matcher: %s\n", (args->main_type == MATCHER_HAAR) ? "haar" : "template");
+	printf("\n");
+}
+
+catcierge_output_var_t chain_vars[] =
+{
+	{ "chain_gate", "The gate used by the chain matcher, same as --chain_gate." },
+	{ "chain_gate_threshold", "Value of --chain_gate_threshold." },
+	{ "chain_main", "The main matcher of the chain, same as --chain_main." },
+	{ "chain_gate_hits", "Number of frames the chain gate has been run on." },
+	{ "chain_main_hits", "Number of frames that passed the gate and were given to the main matcher." },
+	{ "chain_main_skips", "Number of frames the gate kept from the main matcher." },
+};
+
+void catcierge_chain_output_print_usage()
+{
+	size_t i;
+
+	fprintf(stderr, "Chain matcher output variables:\n");
+	fprintf(stderr, "-------------------------------\n");
+
+	for (i = 0; i < sizeof(chain_vars) / sizeof(chain_vars[0]); i++)
+	{
+		fprintf(stderr, "%30s   %s\n", chain_vars[i].name, chain_vars[i].description);
+	}
+
+	fprintf(stderr, "\nThe variables of the gate and main matcher are also available.\n");
+}
+
+const char *catcierge_chain_matcher_var_name(catcierge_matcher_t *octx, size_t idx,
+	char *buf, size_t bufsize)
+{
+	catcierge_chain_matcher_t *ctx = (catcierge_chain_matcher_t *)octx;
+	catcierge_matcher_t *m;
+	const char *name;
+	size_t count = sizeof(chain_vars) / sizeof(chain_vars[0]);
+	int stages[] = { CHAIN_STAGE_MAIN, CHAIN_STAGE_GATE };
+	int i;
+	assert(ctx);
+
+	if (idx < count)
+	{
+		return chain_vars[idx].name;
+	}
+
+	idx -= count;
+
+	// Followed by the variables of the stages, in the
+	// same order as they are looked up when translating.
+	for (i = 0; i < (int)(sizeof(stages) / sizeof(stages[0])); i++)
+	{
+		if (!(m = ctx->stages[stages[i]].matcher) || !m->var_name)
+			continue;
+
+		for (count = 0; (name = m->var_name(m, count, buf, bufsize)); count++)
+		{
+			if (count == idx)
+			{
+				return name;
+			}
+		}
+
+		idx -= count;
+	}
+
+	return NULL;
+}
+
+const char *catcierge_chain_matcher_translate(catcierge_matcher_t *octx, const char *var,
+	char *buf, size_t bufsize)
+{
+	catcierge_chain_matcher_t *ctx = (catcierge_chain_matcher_t *)octx;
+	catcierge_matcher_t *m;
+	const char *val;
+	assert(ctx);
+
+	if (!strcmp(var, "chain_gate"))
+	{
+		return catcierge_chain_gate_str(ctx->args->gate);
+	}
+
+	if (!strcmp(var, "chain_gate_threshold"))
+	{
+		snprintf(buf, bufsize - 1, "%f", ctx->args->gate_threshold);
+		return buf;
+	}
+
+	if (!strcmp(var, "chain_main"))
+	{
+		return ctx->stages[CHAIN_STAGE_MAIN].name;
+	}
+
+	if (!strcmp(var, "chain_gate_hits"))
+	{
+		snprintf(buf, bufsize - 1, "%lu", ctx->stages[CHAIN_STAGE_GATE].hits);
+		return buf;
+	}
+
+	if (!strcmp(var, "chain_main_hits"))
+	{
+		snprintf(buf, bufsize - 1, "%lu", ctx->stages[CHAIN_STAGE_MAIN].hits);
+		return buf;
+	}
+
+	if (!strcmp(var, "chain_main_skips"))
+	{
+		snprintf(buf, bufsize - 1, "%lu", ctx->stages[CHAIN_STAGE_MAIN].skips);
+		return buf;
+	}
+
+	// Fall back to the variables of the individual stages.
+	if ((m = ctx->stages[CHAIN_STAGE_MAIN].matcher)
+		&& (val = m->translate(m, var, buf, bufsize)))
+	{
+		return val;
+	}
+
+	if ((m = ctx->stages[CHAIN_STAGE_GATE].matcher)
+		&& (val = m->translate(m, var, buf, bufsize)))
+	{
+		return val;
+	}
+
+	return NULL;
+}
@@ -0,0 +1,87 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_CHAIN_MATCHER_H__
+#define __CATCIERGE_CHAIN_MATCHER_H__
+
+#include <opencv2/imgproc/imgproc_c.h>
+#include <stdio.h>
+#include "catcierge_types.h"
+#include "catcierge_matcher.h"
+#include "catcierge_template_matcher.h"
+#include "catcierge_haar_matcher.h"
+#include "cargo.h"
+
+#define DEFAULT_CHAIN_GATE_THRESH 0.5
+
+typedef enum catcierge_chain_gate_e
+{
+	CHAIN_GATE_OBSTRUCT,	// Silhouette check, skip frames that are clear.
+	CHAIN_GATE_TEMPLATE		// Cheap template match, skip frames with no snout.
+} catcierge_chain_gate_t;
+
+#define CHAIN_STAGE_GATE 0
+#define CHAIN_STAGE_MAIN 1
+#define CHAIN_STAGE_COUNT 2
+
+typedef struct catcierge_chain_matcher_args_s
+{
+	catcierge_matcher_args_t super;
+	catcierge_chain_gate_t gate;
+	double gate_threshold;
+	catcierge_matcher_type_t main_type;
+
+	// Set by catcierge_get_matcher_args, the chain reuses
+	// the settings given for the individual matchers.
+	catcierge_template_matcher_args_t *templ;
+	catcierge_haar_matcher_args_t *haar;
+} catcierge_chain_matcher_args_t;
+
+typedef struct catcierge_chain_stage_s
+{
+	const char *name;
+	catcierge_matcher_t *matcher;	// NULL for the obstruct gate.
+	unsigned long hits;				// Number of frames the stage ran on.
+	unsigned long skips;			// Number of frames the stage was skipped for.
+} catcierge_chain_stage_t;
+
+typedef struct catcierge_chain_matcher_s
+{
+	catcierge_matcher_t super;
+	catcierge_chain_stage_t stages[CHAIN_STAGE_COUNT];
+	catcierge_chain_matcher_args_t *args;
+} catcierge_chain_matcher_t;
+
+int catcierge_chain_matcher_init(catcierge_matcher_t **ctx, catcierge_matcher_args_t *args);
+void catcierge_chain_matcher_destroy(catcierge_matcher_t **ctx);
+double catcierge_chain_matcher_match(void *ctx, IplImage *img, match_result_t *result, int save_steps);
+int catcierge_chain_matcher_decide(void *ctx, match_group_t *mg);
+
+int catcierge_chain_matcher_add_options(cargo_t cargo,
+										catcierge_chain_matcher_args_t *args);
+void catcierge_chain_matcher_args_init(catcierge_chain_matcher_args_t *args);
+int catcierge_chain_matcher_args_destroy(catcierge_chain_matcher_args_t *args);
+void catcierge_chain_matcher_print_settings(catcierge_chain_matcher_args_t *args);
+const char *catcierge_chain_matcher_translate(catcierge_matcher_t *octx, const char *var,
+	char *buf, size_t bufsize);
+const char *catcierge_chain_matcher_var_name(catcierge_matcher_t *octx, size_t idx,
+	char *buf, size_t bufsize);
+void catcierge_chain_output_print_usage();
+const char *catcierge_chain_gate_str(catcierge_chain_gate_t gate);
+
+#endif // __CATCIERGE_CHAIN_MATCHER_H__
@@ -0,0 +1,744 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <assert.h>
+#include <math.h>
+#include "catcierge_dnn_matcher.h"
+#include "catcierge_dnn_wrapper.h"
+#include "catcierge_types.h"
+#include "catcierge_util.h"
+#include "catcierge_log.h"
+#include "cargo.h"
+
+//
+// CNN based head/prey classifier using the OpenCV dnn module.
+//
+// When batching (the default) each frame is only preprocessed when matched,
+// and the match result is left pending. Once the match group is complete
+// the FSM calls group_match, which runs one forward pass for all frames
+// and fills in the real results before the lock decision is made.
+//
+
+int catcierge_dnn_matcher_init(catcierge_matcher_t **octx,
+		catcierge_matcher_args_t *oargs)
+{
+	catcierge_dnn_matcher_t *ctx = NULL;
+	catcierge_dnn_matcher_args_t *args = (catcierge_dnn_matcher_args_t *)oargs;
+	int fp16;
+	assert(args);
+	assert(octx);
+
+	if (!(*octx = calloc(1, sizeof(catcierge_dnn_matcher_t))))
+	{
+		CATERR("Out of memory!\n");
+		return -1;
+	}
+
+	ctx = (catcierge_dnn_matcher_t *)*octx;
+
+	ctx->super.type = MATCHER_DNN;
+	ctx->super.name = "DNN";
+	ctx->super.short_name = "dnn";
+
+	if (!args->model)
+	{
+		CATERR("DNN matcher: No model specified. Use --dnn_model\n");
+		goto fail;
+	}
+
+	if ((args->channels != 1) && (args->channels != 3))
+	{
+		CATERR("DNN matcher: Input channels must be 1 or 3\n");
+		goto fail;
+	}
+
+	fp16 = (args->precision == DNN_PRECISION_FP16);
+
+	if (fp16 && !cv2DnnNet_has_fp16_target())
+	{
+		CATLOG("DNN matcher: This OpenCV version has no CPU fp16 target, "
+				"running the fp16 model in fp32\n");
+	}
+
+	// Int8 models are quantized in the model file itself, and are
+	// loaded as is by OpenCV, so no special target is needed for them.
+	if (!(ctx->net = cv2DnnNet_create(args->model, args->config, fp16, args->threads)))
+	{
+		CATERR("Failed to load DNN model: %s\n", args->model);
+		goto fail;
+	}
+
+	ctx->args = args;
+	ctx->super.debug = args->debug;
+	ctx->super.match = catcierge_dnn_matcher_match;
+	ctx->super.decide = catcierge_dnn_matcher_decide;
+	ctx->super.translate = catcierge_dnn_matcher_translate;
+	ctx->super.var_name = catcierge_dnn_matcher_var_name;
+
+	if (!args->no_batch)
+	{
+		ctx->super.group_match = catcierge_dnn_matcher_group_match;
+	}
+
+	return 0;
+fail:
+	catcierge_dnn_matcher_destroy(octx);
+	return -1;
+}
+
+static void catcierge_dnn_matcher_release_pending(catcierge_dnn_matcher_t *ctx)
+{
+	size_t i;
+
+	for (i = 0; i < ctx->pending_count; i++)
+	{
+		cvReleaseImage(&ctx->pending[i]);
+	}
+
+	ctx->pending_count = 0;
+}
+
+void catcierge_dnn_matcher_destroy(catcierge_matcher_t **octx)
+{
+	catcierge_dnn_matcher_t *ctx;
+
+	if (!octx || !(*octx))
+		return;
+
+	ctx = (catcierge_dnn_matcher_t *)*octx;
+
+	if (ctx->forward_count > 0)
+	{
+		CATLOG("DNN: %lu frames in %lu forward passes, %0.2f ms per frame\n",
+			ctx->frame_count, ctx->forward_count,
+			(ctx->total_forward_time * 1000.0) / ctx->frame_count);
+	}
+
+	catcierge_dnn_matcher_release_pending(ctx);
+
+	if (ctx->net)
+	{
+		cv2DnnNet_destroy(ctx->net);
+		ctx->net = NULL;
+	}
+
+	free(ctx);
+	*octx = NULL;
+}
+
+static IplImage *catcierge_dnn_matcher_preprocess(catcierge_dnn_matcher_t *ctx, IplImage *img)
+{
+	catcierge_dnn_matcher_args_t *args = ctx->args;
+	IplImage *tmp = NULL;
+	IplImage *src = img;
+	IplImage *out = NULL;
+
+	// Convert to the number of channels the model wants.
+	if ((img->nChannels == 3) && (args->channels == 1))
+	{
+		tmp = cvCreateImage(cvGetSize(img), 8, 1);
+		cvCvtColor(img, tmp, CV_BGR2GRAY);
+		src = tmp;
+	}
+	else if ((img->nChannels == 1) && (args->channels == 3))
+	{
+		tmp = cvCreateImage(cvGetSize(img), 8, 3);
+		cvCvtColor(img, tmp, CV_GRAY2BGR);
+		src = tmp;
+	}
+
+	out = cvCreateImage(cvSize(args->width, args->height), 8, args->channels);
+	cvResize(src, out, CV_INTER_AREA);
+
+	if (tmp)
+	{
+		cvReleaseImage(&tmp);
+	}
+
+	return out;
+}
+
+static void catcierge_dnn_softmax(float *scores, size_t count)
+{
+	size_t i;
+	float max = scores[0];
+	float sum = 0.0f;
+
+	for (i = 1; i < count; i++)
+	{
+		if (scores[i] > max)
+			max = scores[i];
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		scores[i] = expf(scores[i] - max);
+		sum += scores[i];
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		scores[i] /= sum;
+	}
+}
+
+static void catcierge_dnn_matcher_set_result(catcierge_dnn_matcher_t *ctx,
+		float *scores, match_result_t *result)
+{
+	catcierge_dnn_matcher_args_t *args = ctx->args;
+
+	if (args->softmax)
+	{
+		catcierge_dnn_softmax(scores, DNN_CLASS_COUNT);
+	}
+
+	if (ctx->super.debug)
+	{
+		printf("DNN scores: none %0.3f, cat %0.3f, prey %0.3f\n",
+			scores[DNN_CLASS_NONE], scores[DNN_CLASS_CAT], scores[DNN_CLASS_PREY]);
+	}
+
+	// The classifier only tells us what is in the frame, not the direction.
+	result->direction = MATCH_DIR_UNKNOWN;
+	result->rect_count = 0;
+
+	if (scores[DNN_CLASS_PREY] >= args->prey_threshold)
+	{
+		result->result = DNN_FAIL;
+		snprintf(result->description, sizeof(result->description) - 1,
+			"Prey detected (%0.2f)", scores[DNN_CLASS_PREY]);
+	}
+	else if ((scores[DNN_CLASS_CAT] + scores[DNN_CLASS_PREY]) >= args->head_threshold)
+	{
+		result->result = DNN_SUCCESS;
+		snprintf(result->description, sizeof(result->description) - 1,
+			"No prey detected (%0.2f)", scores[DNN_CLASS_PREY]);
+	}
+	else
+	{
+		result->result = args->no_match_is_fail ? DNN_FAIL : DNN_SUCCESS_NO_HEAD;
+		snprintf(result->description, sizeof(result->description) - 1,
+			"%sNo cat head detected (%0.2f)",
+			args->no_match_is_fail ? "Fail " : "", scores[DNN_CLASS_NONE]);
+	}
+
+	result->success = (result->result > 0.0);
+}
+
+static int catcierge_dnn_matcher_forward(catcierge_dnn_matcher_t *ctx,
+		IplImage **imgs, size_t count, float *scores)
+{
+	catcierge_timer_t t;
+	memset(&t, 0, sizeof(t));
+
+	catcierge_timer_start(&t);
+
+	if (cv2DnnNet_forward(ctx->net, imgs, count,
+			ctx->args->scale, ctx->args->mean, scores, DNN_CLASS_COUNT))
+	{
+		CATERR("DNN matcher: Forward pass failed\n");
+		return -1;
+	}
+
+	ctx->forward_time = catcierge_timer_get(&t);
+	ctx->total_forward_time += ctx->forward_time;
+	ctx->forward_count++;
+	ctx->frame_count += count;
+
+	if (ctx->super.debug)
+	{
+		printf("DNN forward pass of %d frames: %0.2f ms\n",
+			(int)count, ctx->forward_time * 1000.0);
+	}
+
+	return 0;
+}
+
+double catcierge_dnn_matcher_match(void *octx,
+		IplImage *img, match_result_t *result, int save_steps)
+{
+	catcierge_dnn_matcher_t *ctx = (catcierge_dnn_matcher_t *)octx;
+	IplImage *prep = NULL;
+	float scores[DNN_CLASS_COUNT];
+	assert(ctx);
+	assert(ctx->args);
+	assert(img);
+	assert(result);
+
+	result->step_img_count = 0;
+	result->rect_count = 0;
+	result->direction = MATCH_DIR_UNKNOWN;
+	result->description[0] = '\0';
+
+	if (!(prep = catcierge_dnn_matcher_preprocess(ctx, img)))
+	{
+		result->result = -1.0;
+		goto fail;
+	}
+
+	if (save_steps)
+	{
+		match_step_t *step = &result->steps[result->step_img_count++];
+
+		if (step->img)
+		{
+			cvReleaseImage(&step->img);
+		}
+
+		step->img = cvCloneImage(prep);
+		step->name = "dnn_input";
+		step->description = "DNN input image";
+	}
+
+	// Wait with the forward pass until the match group is complete.
+	if (ctx->super.group_match && (ctx->pending_count < MATCH_MAX_COUNT))
+	{
+		ctx->pending[ctx->pending_count++] = prep;
+		result->result = DNN_PENDING;
+		result->success = 0;
+		snprintf(result->description, sizeof(result->description) - 1,
+			"Pending batched inference");
+		return result->result;
+	}
+
+	if (catcierge_dnn_matcher_forward(ctx, &prep, 1, scores))
+	{
+		result->result = -1.0;
+		goto fail;
+	}
+
+	catcierge_dnn_matcher_set_result(ctx, scores, result);
+	cvReleaseImage(&prep);
+
+	return result->result;
+
+fail:
+	if (prep)
+	{
+		cvReleaseImage(&prep);
+	}
+
+	result->success = (result->result > 0.0);
+
+	return result->result;
+}
+
+int catcierge_dnn_matcher_group_match(void *octx, match_group_t *mg)
+{
+	catcierge_dnn_matcher_t *ctx = (catcierge_dnn_matcher_t *)octx;
+	float scores[MATCH_MAX_COUNT * DNN_CLASS_COUNT];
+	match_result_t *result;
+	size_t count;
+	size_t i;
+	int ret = 0;
+	assert(ctx);
+	assert(mg);
+
+	count = ctx->pending_count;
+
+	if (count != mg->match_count)
+	{
+		CATERR("DNN matcher: %d pending frames for %d matches\n",
+			(int)count, (int)mg->match_count);
+
+		if (count > mg->match_count)
+			count = mg->match_count;
+
+		// Frames without a pending image never got a result.
+		for (i = count; i < mg->match_count; i++)
+		{
+			result = &mg->matches[i].result;
+			result->result = -1.0;
+			result->success = 0;
+			snprintf(result->description, sizeof(result->description) - 1,
+				"No batched inference");
+		}
+	}
+
+	if (count == 0)
+	{
+		goto fail;
+	}
+
+	if (catcierge_dnn_matcher_forward(ctx, ctx->pending, count, scores))
+	{
+		for (i = 0; i < count; i++)
+		{
+			result = &mg->matches[i].result;
+			result->result = -1.0;
+			result->success = 0;
+			snprintf(result->description, sizeof(result->description) - 1,
+				"DNN inference failed");
+		}
+
+		ret = -1; goto fail;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		result = &mg->matches[i].result;
+		catcierge_dnn_matcher_set_result(ctx, &scores[i * DNN_CLASS_COUNT], result);
+	}
+
+fail:
+	catcierge_dnn_matcher_release_pending(ctx);
+	return ret;
+}
+
+int catcierge_dnn_matcher_decide(void *ctx, match_group_t *mg)
+{
+	size_t i;
+	size_t no_head_count = 0;
+	assert(mg);
+
+	// Same as the haar matcher, no cat found at all is a FAIL.
+	for (i = 0; i < mg->match_count; i++)
+	{
+		if (mg->matches[i].result.result == DNN_SUCCESS_NO_HEAD)
+		{
+			no_head_count++;
+		}
+	}
+
+	if (no_head_count == mg->match_count)
+	{
+		snprintf(mg->description, sizeof(mg->description),
+			"%s", "No head found in any image");
+
+		mg->final_decision = 1;
+		return 0;
+	}
+
+	return mg->success;
+}
+
+const char *catcierge_dnn_precision_str(catcierge_dnn_precision_t precision)
+{
+	switch (precision)
+	{
+		case DNN_PRECISION_FP32: return "fp32";
+		case DNN_PRECISION_FP16: return "fp16";
+		case DNN_PRECISION_INT8: return "int8";
+		default: return "unknown";
+	}
+}
+
+static int parse_precision(cargo_t ctx, void *user, const char *optname,
+							int argc, char **argv)
+{
+	catcierge_dnn_precision_t *p = (catcierge_dnn_precision_t *)user;
+	char *d = NULL;
+
+	if (argc < 1)
+	{
+		cargo_set_error(ctx, 0,
+			"Missing either \"fp32\", \"fp16\" or \"int8\" for %s", optname);
+		return -1;
+	}
+
+	d = argv[0];
+
+	if (!strcasecmp(d, "fp32"))
+	{
+		*p = DNN_PRECISION_FP32;
+	}
+	else if (!strcasecmp(d, "fp16"))
+	{
+		*p = DNN_PRECISION_FP16;
+	}
+	else if (!strcasecmp(d, "int8"))
+	{
+		*p = DNN_PRECISION_INT8;
+	}
+	else
+	{
+		cargo_set_error(ctx, 0,
+			"Invalid precision \"%s\", must be \"fp32\", \"fp16\" "
+			"or \"int8\".", d);
+		return -1;
+	}
+
+	return 1;
+}
+
+static int parse_input_size(cargo_t ctx, void *user, const char *optname,
+							int argc, char **argv)
+{
+	catcierge_dnn_matcher_args_t *args = (catcierge_dnn_matcher_args_t *)user;
+	int sret = 0;
+
+	if (argc < 1)
+	{
+		cargo_set_error(ctx, 0,
+			"%s requires 1 argument", optname);
+		return -1;
+	}
+
+	sret = sscanf(argv[0], "%dx%d", &args->width, &args->height);
+
+	if ((sret == EOF) || (sret != 2) || (args->width <= 0) || (args->height <= 0))
+	{
+		cargo_set_error(ctx, 0,
+			"Cannot parse %s value \"%s\" expected format: WxH\n", optname, argv[0]);
+		return -1;
+	}
+
+	return 1;
+}
+
+int catcierge_dnn_matcher_add_options(cargo_t cargo,
+										catcierge_dnn_matcher_args_t *args)
+{
+	int ret = 0;
+	assert(cargo);
+	assert(args);
+
+	ret |= cargo_add_group(cargo, 0,
+			"dnn", "DNN matcher settings",
+			"Settings for when --dnn_matcher is used.\n"
+			"The model is a classifier outputting 3 scores per image: "
+			"no cat, cat and cat with prey (in that order).");
+
+	ret |= cargo_add_option(cargo, 0,
+			"<dnn> --dnn_model",
+			"Path to the model file (ONNX, Caffe, TensorFlow and others "
+			"supported by OpenCV).",
+			"s", &args->model);
+	ret |= cargo_set_metavar(cargo, "--dnn_model", "PATH");
+
+	ret |= cargo_add_option(cargo, 0,
+			"<dnn> --dnn_config",
+			"Path to a separate network configuration if the model "
+			"format requires one.",
+			"s", &args->config);
+	ret |= cargo_set_metavar(cargo, "--dnn_config", "PATH");
+
+	ret |= cargo_add_option(cargo, 0,
+			"<dnn> --dnn_input_size", NULL,
+			"c", parse_input_size, args);
+	ret |= cargo_set_option_description(cargo,
+			"--dnn_input_size",
+			"The input size of the model. Default %dx%d",
+			DEFAULT_DNN_INPUT_WIDTH, DEFAULT_DNN_INPUT_HEIGHT);
+	ret |= cargo_set_metavar(cargo, "--dnn_input_size", "WxH");
+
+	ret |= cargo_add_option(cargo, 0,
+			"<dnn> --dnn_channels",
+			"The number of input channels of the model, 1 for grayscale "
+			"and 3 for color.",
+			"i", &args->channels);
+	ret |= cargo_add_validation(cargo, 0, "--dnn_channels",
+								cargo_validate_int_range(1, 3));
+
+	ret |= cargo_add_option(cargo, 0,
+			"<dnn> --dnn_scale",
+			"Scale factor applied to the input pixel values.",
+			"d", &args->scale);
+
+	ret |= cargo_add_option(cargo, 0,
+			"<dnn> --dnn_mean",
+			"Mean value subtracted from the input pixel values before scaling.",
+			"d", &args->mean);
+
+	ret |= cargo_add_option(cargo, 0,
+			"<dnn> --dnn_softmax",
+			"Apply softmax to the model output. Use this when the model "
+			"outputs raw scores instead of probabilities.",
+			"b", &args->softmax);
+
+	ret |= cargo_add_option(cargo, 0,
+			"<dnn> --dnn_precision",
+			"The precision of the model weights. fp16 uses the CPU fp16 "
+			"target when the OpenCV version supports it. int8 models are "
+			"quantized in the model file and run as is.",
+			"c", parse_precision, &args->precision);
+	ret |= cargo_set_metavar(cargo, "--dnn_precision", "FP32|FP16|INT8");
+
+	ret |= cargo_add_option(cargo, 0,
+			"<dnn> --dnn_threads",
+			"The number of threads OpenCV uses for inference. "
+			"0 leaves it at the OpenCV default.",
+			"i", &args->threads);
+
+	ret |= cargo_add_option(cargo, 0,
+			"<dnn> --dnn_no_batch",
+			"Run the model on each frame as it is matched, instead "
+			"of one batched forward pass for the whole match group.",
+			"b", &args->no_batch);
+
+	ret |= cargo_add_option(cargo, 0,
+			"<dnn> --dnn_prey_threshold", NULL,
+			"d", &args->prey_threshold);
+	ret |= cargo_set_option_description(cargo,
+			"--dnn_prey_threshold",
+			"The prey score above which a frame is a failure. Default %0.2f",
+			DEFAULT_DNN_PREY_THRESH);
+
+	ret |= cargo_add_option(cargo, 0,
+			"<dnn> --dnn_head_threshold", NULL,
+			"d", &args->head_threshold);
+	ret |= cargo_set_option_description(cargo,
+			"--dnn_head_threshold",
+			"The cat score above which a cat is considered to be in "
+			"the frame. Default %0.2f", DEFAULT_DNN_HEAD_THRESH);
+
+	ret |= cargo_add_option(cargo, 0,
+			"<dnn> --dnn_no_match_is_fail",
+			"If no cat is found in the picture, consider this a failure.",
+			"b", &args->no_match_is_fail);
+
+	return ret;
+}
+
+void catcierge_dnn_matcher_args_init(catcierge_dnn_matcher_args_t *args)
+{
+	assert(args);
+	memset(args, 0, sizeof(catcierge_dnn_matcher_args_t));
+	args->super.type = MATCHER_DNN;
+	args->width = DEFAULT_DNN_INPUT_WIDTH;
+	args->height = DEFAULT_DNN_INPUT_HEIGHT;
+	args->channels = 1;
+	args->scale = DEFAULT_DNN_SCALE;
+	args->mean = 0.0;
+	args->precision = DNN_PRECISION_FP32;
+	args->prey_threshold = DEFAULT_DNN_PREY_THRESH;
+	args->head_threshold = DEFAULT_DNN_HEAD_THRESH;
+}
+
+int catcierge_dnn_matcher_args_destroy(catcierge_dnn_matcher_args_t *args)
+{
+	catcierge_xfree(&args->model);
+	catcierge_xfree(&args->config);
+	return 0;
+}
+
+void catcierge_dnn_matcher_print_settings(catcierge_dnn_matcher_args_t *args)
+{
+	assert(args);
+	printf("DNN Matcher:\n");
+	printf("             Model: %s\n", args->model);
+	if (args->config)
+	printf("            Config: %s\n", args->config);
+	printf("        Input size: %dx%dx%d\n", args->width, args->height, args->channels);
+	printf("       Scale, mean: %f, %f\n", args->scale, args->mean);
+	printf("         Precision: %s\n", catcierge_dnn_precision_str(args->precision));
+	printf("           Threads: %d\n", args->threads);
+	printf("           Batched: %d\n", !args->no_batch);
+	printf("    Prey threshold: %0.2f\n", args->prey_threshold);
+	printf("    Head threshold: %0.2f\n", args->head_threshold);
+	printf("  No match is fail: %d\n", args->no_match_is_fail);
+	printf("\n");
+}
+
+catcierge_output_var_t dnn_vars[] =
+{
+	{ "dnn_model", "Model given via --dnn_model." },
+	{ "dnn_input_size", "Input size of the model in the format WxH." },
+	{ "dnn_precision", "Value of --dnn_precision." },
+	{ "dnn_threads", "Value of --dnn_threads." },
+	{ "dnn_batch", "1 if the match group is run as one batch." },
+	{ "dnn_prey_threshold", "Value of --dnn_prey_threshold." },
+	{ "dnn_head_threshold", "Value of --dnn_head_threshold." },
+	{ "dnn_forward_time", "Duration of the last forward pass in milliseconds." },
+	{ "dnn_forward_count", "Number of forward passes run." },
+};
+
+void catcierge_dnn_output_print_usage()
+{
+	size_t i;
+
+	fprintf(stderr, "DNN matcher output variables:\n");
+	fprintf(stderr, "-----------------------------\n");
+
+	for (i = 0; i < sizeof(dnn_vars) / sizeof(dnn_vars[0]); i++)
+	{
+		fprintf(stderr, "%30s   %s\n", dnn_vars[i].name, dnn_vars[i].description);
+	}
+}
+
+const char *catcierge_dnn_matcher_var_name(catcierge_matcher_t *octx, size_t idx,
+	char *buf, size_t bufsize)
+{
+	if (idx >= sizeof(dnn_vars) / sizeof(dnn_vars[0]))
+	{
+		return NULL;
+	}
+
+	return dnn_vars[idx].name;
+}
+
+const char *catcierge_dnn_matcher_translate(catcierge_matcher_t *octx, const char *var,
+	char *buf, size_t bufsize)
+{
+	catcierge_dnn_matcher_t *ctx = (catcierge_dnn_matcher_t *)octx;
+	assert(ctx);
+
+	if (!strcmp(var, "dnn_model"))
+	{
+		return ctx->args->model;
+	}
+
+	if (!strcmp(var, "dnn_input_size"))
+	{
+		snprintf(buf, bufsize - 1, "%dx%d", ctx->args->width, ctx->args->height);
+		return buf;
+	}
+
+	if (!strcmp(var, "dnn_precision"))
+	{
+		return catcierge_dnn_precision_str(ctx->args->precision);
+	}
+
+	if (!strcmp(var, "dnn_threads"))
+	{
+		snprintf(buf, bufsize - 1, "%d", ctx->args->threads);
+		return buf;
+	}
+
+	if (!strcmp(var, "dnn_batch"))
+	{
+		snprintf(buf, bufsize - 1, "%d", !ctx->args->no_batch);
+		return buf;
+	}
+
+	if (!strcmp(var, "dnn_prey_threshold"))
+	{
+		snprintf(buf, bufsize - 1, "%f", ctx->args->prey_threshold);
+		return buf;
+	}
+
+	if (!strcmp(var, "dnn_head_threshold"))
+	{
+		snprintf(buf, bufsize - 1, "%f", ctx->args->head_threshold);
+		return buf;
+	}
+
+	if (!strcmp(var, "dnn_forward_time"))
+	{
+		snprintf(buf, bufsize - 1, "%0.2f", ctx->forward_time * 1000.0);
+		return buf;
+	}
+
+	if (!strcmp(var, "dnn_forward_count"))
+	{
+		snprintf(buf, bufsize - 1, "%lu", ctx->forward_count);
+		return buf;
+	}
+
+	return NULL;
+}
@@ -0,0 +1,110 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_DNN_MATCHER_H__
+#define __CATCIERGE_DNN_MATCHER_H__
+
+#include <opencv2/imgproc/imgproc_c.h>
+#include <stdio.h>
+#include "catcierge_dnn_wrapper.h"
+#include "catcierge_types.h"
+#include "catcierge_matcher.h"
+#include "catcierge_timer.h"
+#include "cargo.h"
+
+// Same values as the haar matcher, so the results read the same.
+#define DNN_FAIL 0.0
+#define DNN_SUCCESS 1.0
+#define DNN_SUCCESS_NO_HEAD 2.0
+#define DNN_PENDING 4.0 // Frame waiting for the batched forward pass.
+
+// The classifier is expected to output one score per class, in this order.
+#define DNN_CLASS_NONE 0
+#define DNN_CLASS_CAT 1
+#define DNN_CLASS_PREY 2
+#define DNN_CLASS_COUNT 3
+
+#define DEFAULT_DNN_INPUT_WIDTH 96
+#define DEFAULT_DNN_INPUT_HEIGHT 96
+#define DEFAULT_DNN_SCALE (1.0 / 255.0)
+#define DEFAULT_DNN_PREY_THRESH 0.5
+#define DEFAULT_DNN_HEAD_THRESH 0.5
+
+typedef enum catcierge_dnn_precision_e
+{
+	DNN_PRECISION_FP32,
+	DNN_PRECISION_FP16,
+	DNN_PRECISION_INT8
+} catcierge_dnn_precision_t;
+
+typedef struct catcierge_dnn_matcher_args_s
+{
+	catcierge_matcher_args_t super;
+	char *model;
+	char *config;
+	int width;
+	int height;
+	int channels;
+	double scale;
+	double mean;
+	int softmax;
+	catcierge_dnn_precision_t precision;
+	int threads;
+	int no_batch;
+	double prey_threshold;
+	double head_threshold;
+	int no_match_is_fail;
+	int debug;
+} catcierge_dnn_matcher_args_t;
+
+typedef struct catcierge_dnn_matcher_s
+{
+	catcierge_matcher_t super;
+	cv2DnnNet *net;
+
+	// Preprocessed frames waiting for the batched forward pass.
+	IplImage *pending[MATCH_MAX_COUNT];
+	size_t pending_count;
+
+	unsigned long forward_count;
+	unsigned long frame_count;
+	double forward_time;		// Duration of the last forward pass.
+	double total_forward_time;
+
+	catcierge_dnn_matcher_args_t *args;
+} catcierge_dnn_matcher_t;
+
+int catcierge_dnn_matcher_init(catcierge_matcher_t **ctx, catcierge_matcher_args_t *args);
+void catcierge_dnn_matcher_destroy(catcierge_matcher_t **ctx);
+double catcierge_dnn_matcher_match(void *ctx, IplImage *img, match_result_t *result, int save_steps);
+int catcierge_dnn_matcher_group_match(void *ctx, match_group_t *mg);
+int catcierge_dnn_matcher_decide(void *ctx, match_group_t *mg);
+
+int catcierge_dnn_matcher_add_options(cargo_t cargo,
+										catcierge_dnn_matcher_args_t *args);
+void catcierge_dnn_matcher_args_init(catcierge_dnn_matcher_args_t *args);
+int catcierge_dnn_matcher_args_destroy(catcierge_dnn_matcher_args_t *args);
+void catcierge_dnn_matcher_print_settings(catcierge_dnn_matcher_args_t *args);
+const char *catcierge_dnn_matcher_translate(catcierge_matcher_t *octx, const char *var,
+	char *buf, size_t bufsize);
+const char *catcierge_dnn_matcher_var_name(catcierge_matcher_t *octx, size_t idx,
+	char *buf, size_t bufsize);
+void catcierge_dnn_output_print_usage();
+const char *catcierge_dnn_precision_str(catcierge_dnn_precision_t precision);
+
+#endif // __CATCIERGE_DNN_MATCHER_H__
@@ -0,0 +1,153 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "opencv2/core/core.hpp"
+#include "opencv2/dnn.hpp"
+
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+using namespace std;
+using namespace cv;
+
+#include "catcierge_dnn_wrapper.h"
+
+#if (CV_VERSION_MAJOR > 4) || ((CV_VERSION_MAJOR == 4) && (CV_VERSION_MINOR >= 9))
+#define CATCIERGE_DNN_HAVE_FP16_TARGET 1
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+int cv2DnnNet_has_fp16_target()
+{
+	#ifdef CATCIERGE_DNN_HAVE_FP16_TARGET
+	return 1;
+	#else
+	return 0;
+	#endif
+}
+
+cv2DnnNet *cv2DnnNet_create(const char *model, const char *config, int fp16, int threads)
+{
+	dnn::Net *net = NULL;
+	assert(model);
+
+	try
+	{
+		net = new dnn::Net(dnn::readNet(model, config ? config : ""));
+
+		if (net->empty())
+		{
+			delete net;
+			return NULL;
+		}
+
+		net->setPreferableBackend(dnn::DNN_BACKEND_OPENCV);
+
+		#ifdef CATCIERGE_DNN_HAVE_FP16_TARGET
+		net->setPreferableTarget(fp16 ? dnn::DNN_TARGET_CPU_FP16 : dnn::DNN_TARGET_CPU);
+		#else
+		net->setPreferableTarget(dnn::DNN_TARGET_CPU);
+		#endif
+
+		if (threads > 0)
+		{
+			setNumThreads(threads);
+		}
+	}
+	catch (cv::Exception &e)
+	{
+		fprintf(stderr, "%s\n", e.what());
+		delete net;
+		return NULL;
+	}
+
+	return (cv2DnnNet *)net;
+}
+
+void cv2DnnNet_destroy(cv2DnnNet *n)
+{
+	dnn::Net *net = (dnn::Net *)n;
+	delete net;
+}
+
+int cv2DnnNet_forward(cv2DnnNet *n, IplImage **imgs, size_t count,
+	double scale, double mean, float *scores, size_t class_count)
+{
+	dnn::Net *net = (dnn::Net *)n;
+	vector<Mat> mats;
+	Mat blob;
+	Mat out;
+	size_t i;
+	size_t j;
+	assert(net);
+	assert(imgs);
+	assert(scores);
+
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	try
+	{
+		for (i = 0; i < count; i++)
+		{
+			mats.push_back(cvarrToMat(imgs[i]));
+		}
+
+		// The images are already resized, so the size is taken from them.
+		blob = dnn::blobFromImages(mats, scale, Size(),
+				Scalar::all(mean), false, false);
+		net->setInput(blob);
+		out = net->forward();
+
+		if (out.total() != (count * class_count))
+		{
+			fprintf(stderr, "DNN: Unexpected output size %d, expected %d\n",
+				(int)out.total(), (int)(count * class_count));
+			return -1;
+		}
+
+		out = out.reshape(1, (int)count);
+
+		for (i = 0; i < count; i++)
+		{
+			for (j = 0; j < class_count; j++)
+			{
+				scores[i * class_count + j] = out.at<float>((int)i, (int)j);
+			}
+		}
+	}
+	catch (cv::Exception &e)
+	{
+		fprintf(stderr, "%s\n", e.what());
+		return -1;
+	}
+
+	return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
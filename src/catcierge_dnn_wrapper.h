@@ -0,0 +1,48 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_DNN_WRAPPER_H__
+#define __CATCIERGE_DNN_WRAPPER_H__
+
+#include <stddef.h>
+#include <opencv2/imgproc/imgproc_c.h>
+
+typedef void cv2DnnNet;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Returns non-zero if the OpenCV version supports a CPU fp16 target.
+int cv2DnnNet_has_fp16_target();
+
+cv2DnnNet *cv2DnnNet_create(const char *model, const char *config, int fp16, int threads);
+void cv2DnnNet_destroy(cv2DnnNet *n);
+
+// Runs a single forward pass over all images. The images must already
+// be of the input size of the network. The output is expected to have
+// class_count values per image, which are written in order to scores.
+int cv2DnnNet_forward(cv2DnnNet *n, IplImage **imgs, size_t count,
+	double scale, double mean, float *scores, size_t class_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __CATCIERGE_DNN_WRAPPER_H__
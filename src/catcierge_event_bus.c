@@ -0,0 +1,831 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#ifdef CATCIERGE_HAVE_PTHREAD_H
+#include <sys/time.h>
+#endif
+#include "catcierge_event_bus.h"
+#include "catcierge_fsm.h"
+#include "catcierge_output.h"
+#include "catcierge_log.h"
+
+#define EVENT_STRINGS_SIZE 4096
+
+// Strings are kept in one buffer per snapshot and
+// referred to by offset. Offset 0 is the empty string.
+typedef size_t catcierge_event_str_t;
+
+typedef struct catcierge_event_path_s
+{
+	catcierge_event_str_t full;
+	catcierge_event_str_t filename;
+	catcierge_event_str_t dir;
+} catcierge_event_path_t;
+
+typedef struct catcierge_event_step_s
+{
+	catcierge_event_path_t path;
+	catcierge_event_str_t name;
+	catcierge_event_str_t description;
+	int active;
+} catcierge_event_step_t;
+
+typedef struct catcierge_event_match_s
+{
+	catcierge_event_path_t path;
+	struct timeval tv;
+	time_t time;
+	SHA1Context sha;
+	double result;
+	int success;
+	int reused;
+	match_direction_t direction;
+	catcierge_event_str_t description;
+	size_t step_count;
+	catcierge_event_step_t steps[MAX_STEPS];
+} catcierge_event_match_t;
+
+typedef struct catcierge_event_snapshot_s
+{
+	catcierge_state_func_t state;
+	catcierge_state_func_t prev_state;
+
+	// Match group.
+	SHA1Context sha;
+	size_t match_count;
+	int success;
+	int success_count;
+	int final_decision;
+	int early_decision;
+	int skipped_frames;
+	catcierge_event_str_t description;
+	match_direction_t direction;
+	struct timeval start_tv;
+	time_t start_time;
+	struct timeval end_tv;
+	time_t end_time;
+	catcierge_event_path_t obstruct_path;
+	struct timeval obstruct_tv;
+	time_t obstruct_time;
+	catcierge_event_match_t matches[MATCH_MAX_COUNT];
+
+	// Statistics.
+	double actuation_latency;
+	size_t event_queue_length;
+	unsigned long event_dropped_count;
+	size_t image_queue_length;
+	unsigned long image_written_count;
+	unsigned long long image_bytes_written;
+	double image_total_latency;
+	unsigned long long disk_free;
+	catcierge_retention_usage_t usage[CATCIERGE_RETAIN_CLASS_COUNT];
+	catcierge_event_str_t mosaic_path;
+	double mosaic_latency;
+	size_t stream_total;
+	size_t stream_count;
+	int stream_success_count;
+
+	#ifdef WITH_RFID
+	match_direction_t rfid_direction;
+	rfid_match_t rfid_in_match;
+	rfid_match_t rfid_out_match;
+	catcierge_event_str_t rfid_in_time;
+	catcierge_event_str_t rfid_out_time;
+	#endif
+
+	// The matcher variables as "name\0value\0" pairs.
+	int has_matcher;
+	catcierge_event_str_t matcher_name;
+	catcierge_event_str_t matcher_vars;
+	size_t matcher_var_count;
+
+	char *strings;
+	size_t strings_len;
+	size_t strings_size;
+	int error;
+} catcierge_event_snapshot_t;
+
+// Stands in for the matcher when rendering, with the
+// variables rendered by the real one when posted.
+typedef struct catcierge_event_matcher_s
+{
+	catcierge_matcher_t super;
+	catcierge_event_snapshot_t *snapshot;
+} catcierge_event_matcher_t;
+
+typedef struct catcierge_event_view_s
+{
+	catcierge_grb_t grb;
+	catcierge_event_matcher_t matcher;
+} catcierge_event_view_t;
+
+// Only compared against NULL by the renderer, for "match#_step#_active".
+static IplImage catcierge_event_step_img;
+
+static catcierge_event_str_t catcierge_event_snapshot_add(
+		catcierge_event_snapshot_t *snap, const char *str)
+{
+	catcierge_event_str_t offset;
+	size_t len;
+	size_t size;
+	char *strings;
+
+	if (!str)
+	{
+		return 0;
+	}
+
+	len = strlen(str) + 1;
+
+	if ((snap->strings_len + len) > snap->strings_size)
+	{
+		size = snap->strings_size;
+
+		while ((snap->strings_len + len) > size)
+		{
+			size *= 2;
+		}
+
+		if (!(strings = realloc(snap->strings, size)))
+		{
+			CATERR("Out of memory\n");
+			snap->error = 1;
+			return 0;
+		}
+
+		snap->strings = strings;
+		snap->strings_size = size;
+	}
+
+	offset = snap->strings_len;
+	memcpy(&snap->strings[offset], str, len);
+	snap->strings_len += len;
+
+	return offset;
+}
+
+static void catcierge_event_snapshot_add_path(catcierge_event_snapshot_t *snap,
+		catcierge_event_path_t *to, const catcierge_path_t *path)
+{
+	to->full = catcierge_event_snapshot_add(snap, path->full);
+	to->filename = catcierge_event_snapshot_add(snap, path->filename);
+	to->dir = catcierge_event_snapshot_add(snap, path->dir);
+}
+
+static void catcierge_event_snapshot_add_matcher(catcierge_event_snapshot_t *snap,
+		catcierge_matcher_t *matcher)
+{
+	char name_buf[256];
+	char buf[4096];
+	const char *name;
+	const char *val;
+	size_t i;
+
+	snap->has_matcher = (matcher != NULL);
+	snap->matcher_name = 0;
+	snap->matcher_vars = snap->strings_len;
+	snap->matcher_var_count = 0;
+
+	if (!matcher)
+	{
+		return;
+	}
+
+	snap->matcher_name = catcierge_event_snapshot_add(snap, matcher->short_name);
+	snap->matcher_vars = snap->strings_len;
+
+	if (!matcher->var_name)
+	{
+		return;
+	}
+
+	for (i = 0; (name = matcher->var_name(matcher, i, name_buf, sizeof(name_buf))); i++)
+	{
+		if (!(val = matcher->translate(matcher, name, buf, sizeof(buf))))
+		{
+			continue;
+		}
+
+		// Always appended, so the pairs stay next to each other.
+		catcierge_event_snapshot_add(snap, name);
+		catcierge_event_snapshot_add(snap, val);
+		snap->matcher_var_count++;
+	}
+}
+
+static void catcierge_event_snapshot_take(catcierge_event_snapshot_t *snap,
+		catcierge_grb_t *grb)
+{
+	match_group_t *mg = &grb->match_group;
+	catcierge_image_writer_stats_t image_writer;
+	catcierge_retention_stats_t retention;
+	catcierge_event_match_t *em;
+	catcierge_event_step_t *es;
+	match_state_t *m;
+	match_step_t *step;
+	size_t i;
+	size_t j;
+
+	snap->strings_len = 1;
+	snap->error = 0;
+
+	snap->state = grb->state;
+	snap->prev_state = grb->prev_state;
+
+	snap->sha = mg->sha;
+	snap->match_count = mg->match_count;
+	snap->success = mg->success;
+	snap->success_count = mg->success_count;
+	snap->final_decision = mg->final_decision;
+	snap->early_decision = mg->early_decision;
+	snap->skipped_frames = mg->skipped_frames;
+	snap->description = catcierge_event_snapshot_add(snap, mg->description);
+	snap->direction = mg->direction;
+	snap->start_tv = mg->start_tv;
+	snap->start_time = mg->start_time;
+	snap->end_tv = mg->end_tv;
+	snap->end_time = mg->end_time;
+	catcierge_event_snapshot_add_path(snap, &snap->obstruct_path, &mg->obstruct_path);
+	snap->obstruct_tv = mg->obstruct_tv;
+	snap->obstruct_time = mg->obstruct_time;
+
+	// Templates can refer to any of the matches, not only the current ones.
+	for (i = 0; i < MATCH_MAX_COUNT; i++)
+	{
+		m = &mg->matches[i];
+		em = &snap->matches[i];
+
+		catcierge_event_snapshot_add_path(snap, &em->path, &m->path);
+		em->tv = m->tv;
+		em->time = m->time;
+		em->sha = m->sha;
+		em->result = m->result.result;
+		em->success = m->result.success;
+		em->reused = m->result.reused;
+		em->direction = m->result.direction;
+		em->description = catcierge_event_snapshot_add(snap, m->result.description);
+		em->step_count = m->result.step_img_count;
+
+		for (j = 0; (j < m->result.step_img_count) && (j < MAX_STEPS); j++)
+		{
+			step = &m->result.steps[j];
+			es = &em->steps[j];
+
+			catcierge_event_snapshot_add_path(snap, &es->path, &step->path);
+			es->name = catcierge_event_snapshot_add(snap, step->name);
+			es->description = catcierge_event_snapshot_add(snap, step->description);
+			es->active = (step->img != NULL);
+		}
+	}
+
+	snap->actuation_latency = grb->actuation_latency;
+
+	// Updated by other threads, copied under their locks.
+	catcierge_image_writer_stats(&grb->image_writer, &image_writer);
+	snap->image_queue_length = image_writer.count;
+	snap->image_written_count = image_writer.written_count;
+	snap->image_bytes_written = image_writer.bytes_written;
+	snap->image_total_latency = image_writer.total_latency;
+	catcierge_retention_stats(&grb->retention, &retention);
+	snap->disk_free = retention.disk_free;
+	memcpy(snap->usage, retention.usage, sizeof(snap->usage));
+	snap->mosaic_path = catcierge_event_snapshot_add(snap, grb->mosaic.path);
+	snap->mosaic_latency = grb->mosaic.last_latency;
+	snap->stream_total = grb->match_window.total;
+	snap->stream_count = grb->match_window.count;
+	snap->stream_success_count = grb->match_window.success_count;
+
+	#ifdef WITH_RFID
+	snap->rfid_direction = grb->rfid_direction;
+	snap->rfid_in_match = grb->rfid_in_match;
+	snap->rfid_out_match = grb->rfid_out_match;
+	snap->rfid_in_time = catcierge_event_snapshot_add(snap, grb->rfid_in_match.time_str);
+	snap->rfid_out_time = catcierge_event_snapshot_add(snap, grb->rfid_out_match.time_str);
+	#endif
+
+	catcierge_event_snapshot_add_matcher(snap, grb->matcher);
+}
+
+#ifdef CATCIERGE_HAVE_PTHREAD_H
+
+static void catcierge_event_bus_abstime(struct timespec *ts, int ms)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	ts->tv_sec = tv.tv_sec + (ms / 1000);
+	ts->tv_nsec = (tv.tv_usec * 1000) + ((ms % 1000) * 1000000L);
+
+	if (ts->tv_nsec >= 1000000000L)
+	{
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000L;
+	}
+}
+
+static const char *catcierge_event_matcher_translate(catcierge_matcher_t *octx,
+		const char *var, char *buf, size_t bufsize)
+{
+	catcierge_event_matcher_t *ctx = (catcierge_event_matcher_t *)octx;
+	catcierge_event_snapshot_t *snap = ctx->snapshot;
+	const char *name = &snap->strings[snap->matcher_vars];
+	const char *val;
+	size_t i;
+
+	for (i = 0; i < snap->matcher_var_count; i++)
+	{
+		val = name + strlen(name) + 1;
+
+		if (!strcmp(name, var))
+		{
+			return val;
+		}
+
+		name = val + strlen(val) + 1;
+	}
+
+	return NULL;
+}
+
+#define EVENT_STR(snap, offset) (&(snap)->strings[(offset)])
+
+static void catcierge_event_view_set_path(catcierge_path_t *path,
+		catcierge_event_snapshot_t *snap, const catcierge_event_path_t *from)
+{
+	snprintf(path->full, sizeof(path->full), "%s", EVENT_STR(snap, from->full));
+	snprintf(path->filename, sizeof(path->filename), "%s", EVENT_STR(snap, from->filename));
+	snprintf(path->dir, sizeof(path->dir), "%s", EVENT_STR(snap, from->dir));
+}
+
+//
+// Fills in the worker's view of the grabber from a snapshot.
+//
+static void catcierge_event_view_set(catcierge_event_view_t *view,
+		catcierge_event_snapshot_t *snap)
+{
+	catcierge_grb_t *grb = &view->grb;
+	match_group_t *mg = &grb->match_group;
+	catcierge_event_match_t *em;
+	catcierge_event_step_t *es;
+	match_state_t *m;
+	match_step_t *step;
+	size_t i;
+	size_t j;
+
+	grb->state = snap->state;
+	grb->prev_state = snap->prev_state;
+
+	mg->sha = snap->sha;
+	mg->match_count = snap->match_count;
+	mg->success = snap->success;
+	mg->success_count = snap->success_count;
+	mg->final_decision = snap->final_decision;
+	mg->early_decision = snap->early_decision;
+	mg->skipped_frames = snap->skipped_frames;
+	snprintf(mg->description, sizeof(mg->description), "%s",
+		EVENT_STR(snap, snap->description));
+	mg->direction = snap->direction;
+	mg->start_tv = snap->start_tv;
+	mg->start_time = snap->start_time;
+	mg->end_tv = snap->end_tv;
+	mg->end_time = snap->end_time;
+	catcierge_event_view_set_path(&mg->obstruct_path, snap, &snap->obstruct_path);
+	mg->obstruct_tv = snap->obstruct_tv;
+	mg->obstruct_time = snap->obstruct_time;
+
+	for (i = 0; i < MATCH_MAX_COUNT; i++)
+	{
+		m = &mg->matches[i];
+		em = &snap->matches[i];
+
+		catcierge_event_view_set_path(&m->path, snap, &em->path);
+		m->tv = em->tv;
+		m->time = em->time;
+		m->sha = em->sha;
+		m->result.result = em->result;
+		m->result.success = em->success;
+		m->result.reused = em->reused;
+		m->result.direction = em->direction;
+		snprintf(m->result.description, sizeof(m->result.description), "%s",
+			EVENT_STR(snap, em->description));
+		m->result.step_img_count = em->step_count;
+
+		for (j = 0; j < MAX_STEPS; j++)
+		{
+			step = &m->result.steps[j];
+
+			if (j >= em->step_count)
+			{
+				memset(step, 0, sizeof(*step));
+				continue;
+			}
+
+			es = &em->steps[j];
+			catcierge_event_view_set_path(&step->path, snap, &es->path);
+			step->name = EVENT_STR(snap, es->name);
+			step->description = EVENT_STR(snap, es->description);
+			step->img = es->active ? &catcierge_event_step_img : NULL;
+		}
+	}
+
+	grb->actuation_latency = snap->actuation_latency;
+	grb->event_bus.count = snap->event_queue_length;
+	grb->event_bus.dropped_count = snap->event_dropped_count;
+	grb->image_writer.count = snap->image_queue_length;
+	grb->image_writer.written_count = snap->image_written_count;
+	grb->image_writer.bytes_written = snap->image_bytes_written;
+	grb->image_writer.total_latency = snap->image_total_latency;
+	grb->retention.disk_free = snap->disk_free;
+	memcpy(grb->retention.usage, snap->usage, sizeof(grb->retention.usage));
+	snprintf(grb->mosaic.path, sizeof(grb->mosaic.path), "%s",
+		EVENT_STR(snap, snap->mosaic_path));
+	grb->mosaic.last_latency = snap->mosaic_latency;
+	grb->match_window.total = snap->stream_total;
+	grb->match_window.count = snap->stream_count;
+	grb->match_window.success_count = snap->stream_success_count;
+
+	#ifdef WITH_RFID
+	grb->rfid_direction = snap->rfid_direction;
+	grb->rfid_in_match = snap->rfid_in_match;
+	grb->rfid_out_match = snap->rfid_out_match;
+	grb->rfid_in_match.time_str = snap->rfid_in_time ? EVENT_STR(snap, snap->rfid_in_time) : NULL;
+	grb->rfid_out_match.time_str = snap->rfid_out_time ? EVENT_STR(snap, snap->rfid_out_time) : NULL;
+	#endif
+
+	view->matcher.snapshot = snap;
+	view->matcher.super.short_name = snap->matcher_name
+		? EVENT_STR(snap, snap->matcher_name) : NULL;
+	grb->matcher = snap->has_matcher ? &view->matcher.super : NULL;
+}
+
+static void catcierge_event_bus_process(catcierge_event_bus_t *bus,
+		catcierge_event_entry_t *entry)
+{
+	catcierge_event_view_set(bus->view, entry->snapshot);
+
+	catcierge_output_execute_list(&bus->view->grb, entry->event,
+		entry->commands, entry->command_count);
+}
+
+static void *catcierge_event_bus_worker(void *arg)
+{
+	catcierge_event_bus_t *bus = (catcierge_event_bus_t *)arg;
+	catcierge_event_entry_t *entry;
+	struct timespec ts;
+
+	pthread_mutex_lock(&bus->lock);
+
+	while (1)
+	{
+		while ((bus->count == 0) && bus->running)
+		{
+			// Wake up now and then to collect exited commands.
+			catcierge_event_bus_abstime(&ts, 100);
+
+			if (pthread_cond_timedwait(&bus->not_empty, &bus->lock, &ts) == ETIMEDOUT)
+			{
+				pthread_mutex_unlock(&bus->lock);
+				catcierge_executor_reap(&bus->view->grb.executor);
+				pthread_mutex_lock(&bus->lock);
+			}
+		}
+
+		// Drain the queue before stopping.
+		if (bus->count == 0)
+		{
+			break;
+		}
+
+		// The entry stays in the queue until it has been processed,
+		// so the FSM never writes a new snapshot to it meanwhile.
+		entry = &bus->entries[bus->head];
+		pthread_mutex_unlock(&bus->lock);
+
+		catcierge_event_bus_process(bus, entry);
+		catcierge_executor_reap(&bus->view->grb.executor);
+
+		pthread_mutex_lock(&bus->lock);
+		bus->head = (bus->head + 1) % bus->size;
+		bus->count--;
+		bus->processed_count++;
+		pthread_cond_signal(&bus->not_full);
+	}
+
+	pthread_mutex_unlock(&bus->lock);
+
+	return NULL;
+}
+
+static void catcierge_event_view_destroy(catcierge_event_bus_t *bus)
+{
+	catcierge_event_view_t *view = bus->view;
+	catcierge_args_t *args;
+
+	if (!view)
+	{
+		return;
+	}
+
+	args = &view->grb.args;
+
+	catcierge_executor_destroy(&view->grb.executor);
+	catcierge_output_destroy(&view->grb.output);
+	catcierge_xfree(&args->output_path);
+	catcierge_xfree(&args->match_output_path);
+	catcierge_xfree(&args->steps_output_path);
+	catcierge_xfree(&args->obstruct_output_path);
+	catcierge_xfree(&args->template_output_path);
+	catcierge_xfree(&bus->view);
+}
+
+static int catcierge_event_view_strdup(char **to, const char *path)
+{
+	if (path && !(*to = strdup(path)))
+	{
+		CATERR("Out of memory\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+//
+// The worker's view only gets the settings the templates can refer to.
+//
+static int catcierge_event_view_init(catcierge_event_bus_t *bus, catcierge_grb_t *grb)
+{
+	catcierge_event_view_t *view;
+	catcierge_args_t *args = &grb->args;
+	catcierge_args_t *vargs;
+
+	if (!(bus->view = calloc(1, sizeof(catcierge_event_view_t))))
+	{
+		CATERR("Out of memory\n");
+		return -1;
+	}
+
+	view = bus->view;
+	vargs = &view->grb.args;
+
+	vargs->ok_matches_needed = args->ok_matches_needed;
+	vargs->no_final_decision = args->no_final_decision;
+	vargs->match_time = args->match_time;
+	vargs->lockout_method = args->lockout_method;
+	vargs->lockout_time = args->lockout_time;
+	vargs->max_consecutive_lockout_count = args->max_consecutive_lockout_count;
+	vargs->consecutive_lockout_delay = args->consecutive_lockout_delay;
+	vargs->max_running_cmds = args->max_running_cmds;
+	vargs->max_queued_cmds = args->max_queued_cmds;
+	#ifdef WITH_ZMQ
+	vargs->zmq = args->zmq;
+	#endif
+
+	if (catcierge_event_view_strdup(&vargs->output_path, args->output_path)
+	 || catcierge_event_view_strdup(&vargs->match_output_path, args->match_output_path)
+	 || catcierge_event_view_strdup(&vargs->steps_output_path, args->steps_output_path)
+	 || catcierge_event_view_strdup(&vargs->obstruct_output_path, args->obstruct_output_path)
+	 || catcierge_event_view_strdup(&vargs->template_output_path, args->template_output_path))
+	{
+		goto fail;
+	}
+
+	view->matcher.super.name = "Event";
+	view->matcher.super.translate = catcierge_event_matcher_translate;
+
+	if (catcierge_output_init_copy(&view->grb.output, &grb->output,
+			args->inputs, args->input_count))
+	{
+		CATERR("Failed to init event output templates\n");
+		goto fail;
+	}
+
+	if (catcierge_executor_init(&view->grb.executor,
+			args->max_running_cmds, args->max_queued_cmds))
+	{
+		goto fail;
+	}
+
+	return 0;
+fail:
+	catcierge_event_view_destroy(bus);
+	return -1;
+}
+
+#endif // CATCIERGE_HAVE_PTHREAD_H
+
+static void catcierge_event_bus_free_entries(catcierge_event_bus_t *bus)
+{
+	size_t i;
+
+	if (!bus->entries)
+	{
+		return;
+	}
+
+	for (i = 0; i < bus->size; i++)
+	{
+		if (bus->entries[i].snapshot)
+		{
+			catcierge_xfree(&bus->entries[i].snapshot->strings);
+			catcierge_xfree(&bus->entries[i].snapshot);
+		}
+	}
+
+	catcierge_xfree(&bus->entries);
+}
+
+int catcierge_event_bus_init(catcierge_event_bus_t *bus,
+		catcierge_grb_t *grb, size_t size, int timeout)
+{
+	size_t i;
+	catcierge_event_snapshot_t *snap;
+	assert(bus);
+	assert(grb);
+
+	memset(bus, 0, sizeof(catcierge_event_bus_t));
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+
+	if ((size == 0) || (size > CATCIERGE_EVENT_QUEUE_MAX_SIZE))
+	{
+		CATERR("Invalid event queue size %d\n", (int)size);
+		return -1;
+	}
+
+	if (!(bus->entries = calloc(size, sizeof(catcierge_event_entry_t))))
+	{
+		CATERR("Out of memory\n");
+		return -1;
+	}
+
+	bus->size = size;
+
+	for (i = 0; i < size; i++)
+	{
+		if (!(snap = bus->entries[i].snapshot = calloc(1, sizeof(catcierge_event_snapshot_t)))
+		 || !(snap->strings = malloc(EVENT_STRINGS_SIZE)))
+		{
+			CATERR("Out of memory\n");
+			goto fail;
+		}
+
+		snap->strings[0] = '\0';
+		snap->strings_len = 1;
+		snap->strings_size = EVENT_STRINGS_SIZE;
+	}
+
+	if (catcierge_event_view_init(bus, grb))
+	{
+		goto fail;
+	}
+
+	bus->timeout = timeout;
+	bus->running = 1;
+	pthread_mutex_init(&bus->lock, NULL);
+	pthread_cond_init(&bus->not_empty, NULL);
+	pthread_cond_init(&bus->not_full, NULL);
+
+	if (pthread_create(&bus->thread, NULL, catcierge_event_bus_worker, bus))
+	{
+		CATERR("Failed to start event worker thread\n");
+		bus->running = 0;
+		pthread_mutex_destroy(&bus->lock);
+		pthread_cond_destroy(&bus->not_empty);
+		pthread_cond_destroy(&bus->not_full);
+		catcierge_event_view_destroy(bus);
+		goto fail;
+	}
+
+	CATLOG("Started event worker with a queue of %d events\n", (int)size);
+
+	return 0;
+fail:
+	catcierge_event_bus_free_entries(bus);
+	return -1;
+
+	#else // !CATCIERGE_HAVE_PTHREAD_H
+
+	CATERR("Asynchronous events are not supported on this platform\n");
+	return -1;
+
+	#endif // CATCIERGE_HAVE_PTHREAD_H
+}
+
+void catcierge_event_bus_destroy(catcierge_event_bus_t *bus)
+{
+	assert(bus);
+
+	if (!bus->running)
+	{
+		return;
+	}
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	pthread_mutex_lock(&bus->lock);
+	bus->running = 0;
+	pthread_cond_signal(&bus->not_empty);
+	pthread_mutex_unlock(&bus->lock);
+
+	pthread_join(bus->thread, NULL);
+
+	pthread_mutex_destroy(&bus->lock);
+	pthread_cond_destroy(&bus->not_empty);
+	pthread_cond_destroy(&bus->not_full);
+
+	CATLOG("Events: %lu posted, %lu processed, %lu dropped, max %d queued\n",
+		bus->posted_count, bus->processed_count,
+		bus->dropped_count, (int)bus->max_count);
+
+	catcierge_event_view_destroy(bus);
+	catcierge_event_bus_free_entries(bus);
+	#endif // CATCIERGE_HAVE_PTHREAD_H
+}
+
+int catcierge_event_bus_post(catcierge_event_bus_t *bus,
+		catcierge_grb_t *grb, catcierge_event_t event,
+		char **commands, size_t command_count)
+{
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	catcierge_event_entry_t *entry;
+	struct timespec ts;
+	int ret = 0;
+	assert(bus);
+	assert(grb);
+	assert(bus->running);
+
+	pthread_mutex_lock(&bus->lock);
+
+	if ((bus->count == bus->size) && (bus->timeout > 0))
+	{
+		// Backpressure, give the worker a chance to catch up.
+		catcierge_event_bus_abstime(&ts, bus->timeout);
+
+		while ((bus->count == bus->size)
+			&& (pthread_cond_timedwait(&bus->not_full, &bus->lock, &ts) != ETIMEDOUT));
+	}
+
+	if (bus->count == bus->size)
+	{
+		bus->dropped_count++;
+		CATERR("Event queue full, dropped %s event (%lu dropped)\n",
+			catcierge_output_event_name(event), bus->dropped_count);
+		ret = -1; goto fail;
+	}
+
+	entry = &bus->entries[(bus->head + bus->count) % bus->size];
+	entry->snapshot->event_queue_length = bus->count;
+	entry->snapshot->event_dropped_count = bus->dropped_count;
+	pthread_mutex_unlock(&bus->lock);
+
+	// Only this thread posts and the worker doesn't look at
+	// the entry until it is queued, so no need to hold the lock.
+	entry->event = event;
+	entry->commands = commands;
+	entry->command_count = command_count;
+	catcierge_event_snapshot_take(entry->snapshot, grb);
+
+	pthread_mutex_lock(&bus->lock);
+
+	if (entry->snapshot->error)
+	{
+		bus->dropped_count++;
+		CATERR("Failed to snapshot %s event (%lu dropped)\n",
+			catcierge_output_event_name(event), bus->dropped_count);
+		ret = -1; goto fail;
+	}
+
+	bus->posted_count++;
+	bus->count++;
+
+	if (bus->count > bus->max_count)
+	{
+		bus->max_count = bus->count;
+	}
+
+	pthread_cond_signal(&bus->not_empty);
+fail:
+	pthread_mutex_unlock(&bus->lock);
+	return ret;
+	#else
+	return -1;
+	#endif // CATCIERGE_HAVE_PTHREAD_H
+}
@@ -0,0 +1,92 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_EVENT_BUS_H__
+#define __CATCIERGE_EVENT_BUS_H__
+
+#include <stddef.h>
+#include <catcierge_config.h>
+#include "catcierge_types.h"
+
+#ifdef CATCIERGE_HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#define DEFAULT_EVENT_QUEUE_SIZE 8
+#define CATCIERGE_EVENT_QUEUE_MAX_SIZE 64
+#define DEFAULT_EVENT_QUEUE_TIMEOUT 100 // Milliseconds.
+
+struct catcierge_grb_s;
+struct catcierge_event_snapshot_s;
+struct catcierge_event_view_s;
+
+typedef struct catcierge_event_entry_s
+{
+	catcierge_event_t event;
+	char **commands;
+	size_t command_count;
+	struct catcierge_event_snapshot_s *snapshot; // What the templates can refer to when posted.
+} catcierge_event_entry_t;
+
+//
+// Renders the output templates and runs the commands for events on a
+// worker thread, instead of blocking the FSM. Each posted event gets a
+// snapshot of the values the templates can refer to, including the
+// matcher variables rendered at that time, so the worker never touches
+// anything the FSM thread uses. The worker renders into a private view
+// of the grabber with its own output context and executor, and only
+// publishes ZMQ messages through the publisher thread. When the queue
+// is full, posting waits at most timeout milliseconds for a free slot,
+// after that the event is dropped.
+//
+typedef struct catcierge_event_bus_s
+{
+	int running;
+	catcierge_event_entry_t *entries;
+	size_t size;			// Max number of events in the queue.
+	size_t count;			// Current number of events in the queue.
+	size_t head;			// Index of the oldest event.
+	size_t max_count;		// Highest number of events queued at once.
+	int timeout;
+
+	unsigned long posted_count;
+	unsigned long dropped_count;
+	unsigned long processed_count;
+
+	struct catcierge_event_view_s *view; // Only used by the worker.
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+	#endif
+} catcierge_event_bus_t;
+
+int catcierge_event_bus_init(catcierge_event_bus_t *bus,
+		struct catcierge_grb_s *grb, size_t size, int timeout);
+
+// Waits for the queued events to be processed and stops the worker.
+void catcierge_event_bus_destroy(catcierge_event_bus_t *bus);
+
+// Returns 0 if the event was queued, -1 if it was dropped.
+int catcierge_event_bus_post(catcierge_event_bus_t *bus,
+		struct catcierge_grb_s *grb, catcierge_event_t event,
+		char **commands, size_t command_count);
+
+#endif // __CATCIERGE_EVENT_BUS_H__
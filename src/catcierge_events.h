@@ -32,13 +32,21 @@ CATCIERGE_DEFINE_EVENT(CATCIERGE_STATE_CHANGE, state_change,
 	"State machine state changed.")
 
 CATCIERGE_DEFINE_EVENT(CATCIERGE_DO_LOCKOUT, do_lockout,
-	"Triggered right before a lockout is performed.")
+	"Triggered when a lockout is performed. The door is locked "
+	"before the templates for this event are generated.")
 
 CATCIERGE_DEFINE_EVENT(CATCIERGE_DO_UNLOCK, do_unlock,
-	"Triggered right before a unlock is performed.")
+	"Triggered when an unlock is performed. The door is unlocked "
+	"before the templates for this event are generated.")
 
 CATCIERGE_DEFINE_EVENT(CATCIERGE_SAVE_IMG, save_img,
-	"Event after all images for a match group have been saved to disk.")
+	"Event after all images for a match group have been saved to disk. "
+	"Unless --sync_save is used, the images are written in the background "
+	"and this is triggered once they have been written.")
+
+CATCIERGE_DEFINE_EVENT(CATCIERGE_MOSAIC_DONE, mosaic_done,
+	"Triggered when the mosaic of a match group has been written (--mosaic). "
+	"The mosaic_path variable is set to its path.")
 
 CATCIERGE_DEFINE_EVENT(CATCIERGE_MATCH_DONE, match_done,
 	"Triggered after each match in a match group.")
@@ -0,0 +1,335 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "catcierge_config.h"
+#include "catcierge_executor.h"
+#include "catcierge_util.h"
+#include "catcierge_log.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/wait.h>
+#ifdef CATCIERGE_HAVE_SPAWN_H
+#include <spawn.h>
+#endif
+
+extern char **environ;
+#endif // !_WIN32
+
+int catcierge_executor_init(catcierge_executor_t *e, int max_running, int max_queued)
+{
+	assert(e);
+	memset(e, 0, sizeof(catcierge_executor_t));
+
+	if ((max_running < 1) || (max_running > CATCIERGE_EXECUTOR_MAX_RUNNING))
+	{
+		CATERR("Invalid max number of running commands %d\n", max_running);
+		return -1;
+	}
+
+	e->max_running = max_running;
+	e->max_queued = (max_queued < 0) ? 0 : max_queued;
+
+	return 0;
+}
+
+static void catcierge_exec_job_free(catcierge_exec_job_t *job)
+{
+	catcierge_xfree(&job->command);
+	free(job);
+}
+
+void catcierge_executor_destroy(catcierge_executor_t *e)
+{
+	catcierge_exec_job_t *job;
+	catcierge_exec_job_t *next;
+	catcierge_exec_stats_t *s;
+	catcierge_exec_stats_t *tmp;
+	assert(e);
+
+	catcierge_executor_reap(e);
+
+	if (e->running_count > 0)
+	{
+		CATLOG("%d commands are still running\n", e->running_count);
+	}
+
+	// Any children still running will be reaped by init when we exit.
+	for (job = e->running; job; job = next)
+	{
+		next = job->next;
+		catcierge_exec_job_free(job);
+	}
+
+	for (job = e->queue_head; job; job = next)
+	{
+		next = job->next;
+		catcierge_exec_job_free(job);
+	}
+
+	HASH_ITER(hh, e->stats, s, tmp)
+	{
+		CATLOG("%s commands: %lu runs, %lu failed, %0.1f ms average, %0.1f ms max\n",
+			s->event, s->runs, s->failures,
+			(s->total_runtime * 1000.0) / s->runs, s->max_runtime * 1000.0);
+		HASH_DEL(e->stats, s);
+		free(s);
+	}
+
+	e->running = NULL;
+	e->running_count = 0;
+	e->queue_head = NULL;
+	e->queue_tail = NULL;
+	e->queued_count = 0;
+}
+
+catcierge_exec_stats_t *catcierge_executor_get_stats(catcierge_executor_t *e, const char *event)
+{
+	catcierge_exec_stats_t *s = NULL;
+	assert(e);
+	assert(event);
+
+	HASH_FIND_STR(e->stats, event, s);
+
+	return s;
+}
+
+static void catcierge_executor_record(catcierge_executor_t *e,
+	catcierge_exec_job_t *job, int exit_status)
+{
+	catcierge_exec_stats_t *s = NULL;
+	double runtime = catcierge_timer_get(&job->timer);
+
+	if (!(s = catcierge_executor_get_stats(e, job->event)))
+	{
+		if (!(s = calloc(1, sizeof(catcierge_exec_stats_t))))
+		{
+			CATERR("Out of memory\n");
+			return;
+		}
+
+		snprintf(s->event, sizeof(s->event), "%s", job->event);
+		HASH_ADD_STR(e->stats, event, s);
+	}
+
+	s->runs++;
+	s->failures += (exit_status != 0);
+	s->last_exit_status = exit_status;
+	s->last_runtime = runtime;
+	s->total_runtime += runtime;
+
+	if (runtime > s->max_runtime)
+		s->max_runtime = runtime;
+
+	if (exit_status != 0)
+	{
+		CATERR("Command for %s exited with %d after %0.1f ms: \"%s\"\n",
+			job->event, exit_status, runtime * 1000.0, job->command);
+	}
+}
+
+static int catcierge_executor_spawn(catcierge_executor_t *e, catcierge_exec_job_t *job)
+{
+	#ifndef _WIN32
+	char *argv[4];
+	int err;
+	argv[0] = "/bin/sh";
+	argv[1] = "-c";
+	argv[2] = job->command;
+	argv[3] = NULL;
+
+	#ifdef CATCIERGE_HAVE_SPAWN_H
+	// posix_spawn doesn't copy the page tables of the whole process
+	// the way fork does (it uses vfork or clone on Linux).
+	if ((err = posix_spawn(&job->pid, argv[0], NULL, NULL, argv, environ)))
+	{
+		CATERR("Failed to run \"%s\": %d, %s\n", job->command, err, strerror(err));
+		return -1;
+	}
+	#else
+	if ((job->pid = fork()) < 0)
+	{
+		err = errno;
+		CATERR("Forking child process failed: %d, %s\n", err, strerror(err));
+		return -1;
+	}
+	else if (job->pid == 0)
+	{
+		execv(argv[0], argv);
+		_exit(127);
+	}
+	#endif // CATCIERGE_HAVE_SPAWN_H
+
+	catcierge_timer_reset(&job->timer);
+	catcierge_timer_start(&job->timer);
+
+	job->next = e->running;
+	e->running = job;
+	e->running_count++;
+
+	CATLOG("Called program \"%s\"\n", job->command);
+
+	return 0;
+	#else // _WIN32
+	catcierge_run(job->command);
+	catcierge_exec_job_free(job);
+	return 0;
+	#endif // _WIN32
+}
+
+int catcierge_executor_run(catcierge_executor_t *e, const char *event,
+	const char *command, int flags)
+{
+	catcierge_exec_job_t *job = NULL;
+	assert(e);
+	assert(command);
+
+	if (!(job = calloc(1, sizeof(catcierge_exec_job_t)))
+	 || !(job->command = strdup(command)))
+	{
+		CATERR("Out of memory\n");
+		if (job) free(job);
+		return -1;
+	}
+
+	snprintf(job->event, sizeof(job->event), "%s", event ? event : "");
+
+	if ((e->running_count < e->max_running)
+		|| (flags & CATCIERGE_EXEC_IMMEDIATE))
+	{
+		if (catcierge_executor_spawn(e, job))
+		{
+			catcierge_exec_job_free(job);
+			return -1;
+		}
+
+		return 0;
+	}
+
+	if (e->queued_count >= e->max_queued)
+	{
+		CATERR("Too many commands queued (%d), dropping \"%s\"\n",
+			e->queued_count, job->command);
+		e->dropped_count++;
+		catcierge_exec_job_free(job);
+		return -1;
+	}
+
+	if (e->queue_tail)
+		e->queue_tail->next = job;
+	else
+		e->queue_head = job;
+
+	e->queue_tail = job;
+	e->queued_count++;
+
+	return 0;
+}
+
+int catcierge_executor_reap(catcierge_executor_t *e)
+{
+	int reaped = 0;
+	#ifndef _WIN32
+	catcierge_exec_job_t **it;
+	catcierge_exec_job_t *job;
+	int status;
+	pid_t ret;
+	assert(e);
+
+	it = &e->running;
+
+	while ((job = *it))
+	{
+		if ((ret = waitpid(job->pid, &status, WNOHANG)) == 0)
+		{
+			// Still running.
+			it = &job->next;
+			continue;
+		}
+
+		if (ret < 0)
+		{
+			CATERR("Failed to wait for \"%s\": %d, %s\n",
+				job->command, errno, strerror(errno));
+			status = -1;
+		}
+		else
+		{
+			status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+		}
+
+		catcierge_executor_record(e, job, status);
+
+		*it = job->next;
+		e->running_count--;
+		catcierge_exec_job_free(job);
+		reaped++;
+	}
+
+	// Start queued commands now that there might be room.
+	while (e->queue_head && (e->running_count < e->max_running))
+	{
+		job = e->queue_head;
+		e->queue_head = job->next;
+
+		if (!e->queue_head)
+			e->queue_tail = NULL;
+
+		e->queued_count--;
+		job->next = NULL;
+
+		if (catcierge_executor_spawn(e, job))
+		{
+			catcierge_exec_job_free(job);
+		}
+	}
+	#endif // !_WIN32
+
+	return reaped;
+}
+
+int catcierge_executor_wait(catcierge_executor_t *e, double timeout)
+{
+	catcierge_timer_t t;
+	assert(e);
+
+	catcierge_timer_reset(&t);
+	catcierge_timer_start(&t);
+
+	catcierge_executor_reap(e);
+
+	while ((e->running_count > 0) || (e->queued_count > 0))
+	{
+		if (catcierge_timer_get(&t) >= timeout)
+		{
+			return -1;
+		}
+
+		#ifndef _WIN32
+		usleep(1000);
+		#endif
+		catcierge_executor_reap(e);
+	}
+
+	return 0;
+}
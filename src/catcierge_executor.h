@@ -0,0 +1,99 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_EXECUTOR_H__
+#define __CATCIERGE_EXECUTOR_H__
+
+#include <stddef.h>
+#include "uthash.h"
+#include "catcierge_timer.h"
+
+#ifndef _WIN32
+#include <sys/types.h>
+#endif
+
+#define DEFAULT_MAX_RUNNING_CMDS 4
+#define DEFAULT_MAX_QUEUED_CMDS 32
+#define CATCIERGE_EXECUTOR_MAX_RUNNING 64
+#define CATCIERGE_EXECUTOR_MAX_EVENT_LENGTH 64
+
+// Start the command even if max_running commands are already running.
+#define CATCIERGE_EXEC_IMMEDIATE (1 << 0)
+
+typedef struct catcierge_exec_job_s
+{
+	char event[CATCIERGE_EXECUTOR_MAX_EVENT_LENGTH];
+	char *command;
+	#ifndef _WIN32
+	pid_t pid;
+	#endif
+	catcierge_timer_t timer;
+	struct catcierge_exec_job_s *next;
+} catcierge_exec_job_t;
+
+// Exit status and runtime of the commands for an event.
+typedef struct catcierge_exec_stats_s
+{
+	char event[CATCIERGE_EXECUTOR_MAX_EVENT_LENGTH];
+	unsigned long runs;
+	unsigned long failures;
+	int last_exit_status;
+	double last_runtime;
+	double max_runtime;
+	double total_runtime;
+	UT_hash_handle hh;
+} catcierge_exec_stats_t;
+
+//
+// Runs event commands without blocking the FSM. The commands are
+// started with posix_spawn instead of forking the whole process, at
+// most max_running at a time. The rest are queued until a running
+// command exits. Exited children are reaped by catcierge_executor_reap
+// which is called every frame.
+//
+typedef struct catcierge_executor_s
+{
+	int max_running;
+	int max_queued;
+	catcierge_exec_job_t *running;
+	int running_count;
+	catcierge_exec_job_t *queue_head;
+	catcierge_exec_job_t *queue_tail;
+	int queued_count;
+	unsigned long dropped_count;
+	catcierge_exec_stats_t *stats;
+} catcierge_executor_t;
+
+int catcierge_executor_init(catcierge_executor_t *e, int max_running, int max_queued);
+void catcierge_executor_destroy(catcierge_executor_t *e);
+
+// Runs the command right away, or queues it if too many are running.
+int catcierge_executor_run(catcierge_executor_t *e, const char *event,
+	const char *command, int flags);
+
+// Reaps any exited children and starts queued commands.
+// Returns the number of children reaped.
+int catcierge_executor_reap(catcierge_executor_t *e);
+
+// Waits until all running and queued commands are done,
+// or the timeout (seconds) expires. Returns 0 if all are done.
+int catcierge_executor_wait(catcierge_executor_t *e, double timeout);
+
+catcierge_exec_stats_t *catcierge_executor_get_stats(catcierge_executor_t *e, const char *event);
+
+#endif // __CATCIERGE_EXECUTOR_H__
@@ -0,0 +1,152 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include "catcierge_frame_quality.h"
+#include "catcierge_log.h"
+
+static int catcierge_frame_burst_alloc(catcierge_frame_burst_t *b, const IplImage *img)
+{
+	CvSize size = cvGetSize(img);
+
+	if (b->gray
+		&& (b->gray->width == size.width)
+		&& (b->gray->height == size.height)
+		&& (b->best->nChannels == img->nChannels))
+	{
+		return 0;
+	}
+
+	catcierge_frame_burst_destroy(b);
+
+	if (!(b->gray = cvCreateImage(size, IPL_DEPTH_8U, 1))
+	 || !(b->laplace = cvCreateImage(size, IPL_DEPTH_16S, 1))
+	 || !(b->best = cvCreateImage(size, img->depth, img->nChannels)))
+	{
+		CATERR("Out of memory!\n");
+		catcierge_frame_burst_destroy(b);
+		return -1;
+	}
+
+	return 0;
+}
+
+int catcierge_frame_quality_score(catcierge_frame_burst_t *b,
+	const IplImage *img, catcierge_frame_score_t *score)
+{
+	CvScalar mean;
+	CvScalar sdv;
+	assert(b);
+	assert(img);
+	assert(score);
+
+	if (catcierge_frame_burst_alloc(b, img))
+	{
+		return -1;
+	}
+
+	if (img->nChannels != 1)
+	{
+		cvCvtColor(img, b->gray, CV_BGR2GRAY);
+	}
+	else
+	{
+		cvCopy(img, b->gray, NULL);
+	}
+
+	// Exposure, how far the mean is from mid gray.
+	cvAvgSdv(b->gray, &mean, &sdv, NULL);
+	score->exposure = 1.0 - (fabs(mean.val[0] - 127.5) / 127.5);
+
+	// Sharpness, a blurry image has few strong edges.
+	cvLaplace(b->gray, b->laplace, 3);
+	cvAvgSdv(b->laplace, &mean, &sdv, NULL);
+	score->sharpness = sdv.val[0] * sdv.val[0];
+
+	score->score = score->sharpness * score->exposure;
+
+	return 0;
+}
+
+int catcierge_frame_burst_init(catcierge_frame_burst_t *b, int size)
+{
+	assert(b);
+	memset(b, 0, sizeof(catcierge_frame_burst_t));
+
+	if ((size < 1) || (size > CATCIERGE_MAX_BURST))
+	{
+		CATERR("Invalid burst size %d\n", size);
+		return -1;
+	}
+
+	b->size = size;
+
+	return 0;
+}
+
+void catcierge_frame_burst_destroy(catcierge_frame_burst_t *b)
+{
+	assert(b);
+
+	if (b->gray)
+		cvReleaseImage(&b->gray);
+
+	if (b->laplace)
+		cvReleaseImage(&b->laplace);
+
+	if (b->best)
+		cvReleaseImage(&b->best);
+}
+
+void catcierge_frame_burst_reset(catcierge_frame_burst_t *b)
+{
+	assert(b);
+	b->count = 0;
+	b->best_index = 0;
+	memset(&b->best_score, 0, sizeof(b->best_score));
+}
+
+int catcierge_frame_burst_add(catcierge_frame_burst_t *b, const IplImage *img)
+{
+	catcierge_frame_score_t score;
+	assert(b);
+	assert(img);
+
+	if (catcierge_frame_quality_score(b, img, &score))
+	{
+		return -1;
+	}
+
+	if ((b->count == 0) || (score.score > b->best_score.score))
+	{
+		cvCopy(img, b->best, NULL);
+		b->best_score = score;
+		b->best_index = b->count;
+	}
+
+	b->count++;
+
+	if (b->count < b->size)
+	{
+		return 0;
+	}
+
+	return 1;
+}
@@ -0,0 +1,60 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_FRAME_QUALITY_H__
+#define __CATCIERGE_FRAME_QUALITY_H__
+
+#include <opencv2/imgproc/imgproc_c.h>
+
+#define CATCIERGE_MAX_BURST 16
+
+typedef struct catcierge_frame_score_s
+{
+	double sharpness;		// Variance of the laplacian, motion blur gives low values.
+	double exposure;		// 1.0 for a mid gray mean, 0.0 for all black or white.
+	double score;			// sharpness * exposure.
+} catcierge_frame_score_t;
+
+//
+// Picks the best frame out of a burst of consecutive frames, so that
+// only that one is passed on to the matcher. The gray scale and
+// laplacian buffers are reused between frames.
+//
+typedef struct catcierge_frame_burst_s
+{
+	IplImage *gray;
+	IplImage *laplace;
+	IplImage *best;			// Copy of the best frame in the current burst.
+	catcierge_frame_score_t best_score;
+	int best_index;
+	int size;				// Number of frames in a burst.
+	int count;				// Number of frames seen in the current burst.
+} catcierge_frame_burst_t;
+
+int catcierge_frame_quality_score(catcierge_frame_burst_t *b,
+	const IplImage *img, catcierge_frame_score_t *score);
+
+int catcierge_frame_burst_init(catcierge_frame_burst_t *b, int size);
+void catcierge_frame_burst_destroy(catcierge_frame_burst_t *b);
+void catcierge_frame_burst_reset(catcierge_frame_burst_t *b);
+
+// Returns 1 when the burst is complete and b->best holds the best frame,
+// 0 if more frames are needed and -1 on error.
+int catcierge_frame_burst_add(catcierge_frame_burst_t *b, const IplImage *img);
+
+#endif // __CATCIERGE_FRAME_QUALITY_H__
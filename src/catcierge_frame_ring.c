@@ -0,0 +1,369 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <catcierge_config.h>
+#include "catcierge_frame_ring.h"
+#include "catcierge_util.h"
+#include "catcierge_log.h"
+
+#ifdef CATCIERGE_HAVE_FRAME_RING
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define CATCIERGE_FRAME_RING_ALIGN 64
+
+// Full barrier, keeps the seqlock ordered against the frame data.
+#define CATCIERGE_FRAME_RING_BARRIER() __sync_synchronize()
+
+static catcierge_frame_ring_slot_t *catcierge_frame_ring_slot(
+		catcierge_frame_ring_t *r, uint64_t frame_seq)
+{
+	catcierge_frame_ring_header_t *h = r->header;
+
+	return (catcierge_frame_ring_slot_t *)(r->map + h->header_size
+			+ ((frame_seq - 1) % h->slot_count) * h->slot_size);
+}
+
+int catcierge_frame_ring_init(catcierge_frame_ring_t *r,
+		const char *name, size_t slot_count)
+{
+	assert(r);
+	assert(name);
+	memset(r, 0, sizeof(catcierge_frame_ring_t));
+
+	#ifdef CATCIERGE_HAVE_FRAME_RING
+	if ((name[0] != '/') || strchr(name + 1, '/')
+		|| (strlen(name) >= sizeof(r->name)))
+	{
+		CATERR("Invalid frame ring name \"%s\", expected a name like /catcierge\n", name);
+		return -1;
+	}
+
+	if ((slot_count < 2) || (slot_count > CATCIERGE_FRAME_RING_MAX_SLOTS))
+	{
+		CATERR("Invalid frame ring slot count %d\n", (int)slot_count);
+		return -1;
+	}
+
+	strcpy(r->name, name);
+	r->slot_count = slot_count;
+	r->writer = 1;
+	r->running = 1;
+
+	return 0;
+	#else
+	CATERR("Shared memory frame rings are not supported on this platform\n");
+	return -1;
+	#endif
+}
+
+void catcierge_frame_ring_destroy(catcierge_frame_ring_t *r)
+{
+	assert(r);
+
+	#ifdef CATCIERGE_HAVE_FRAME_RING
+	if (r->map)
+	{
+		munmap(r->map, r->size);
+		r->map = NULL;
+		r->header = NULL;
+
+		// Readers that have it mapped keep their mapping.
+		if (r->writer)
+		{
+			shm_unlink(r->name);
+			CATLOG("Frame ring %s: %llu frames, %lu skipped\n",
+				r->name, (unsigned long long)r->frame_seq, r->skipped_count);
+		}
+	}
+	#endif
+
+	r->running = 0;
+}
+
+#ifdef CATCIERGE_HAVE_FRAME_RING
+static int catcierge_frame_ring_create(catcierge_frame_ring_t *r, const IplImage *img)
+{
+	catcierge_frame_ring_header_t *h;
+	size_t slot_size;
+	int fd;
+
+	slot_size = sizeof(catcierge_frame_ring_slot_t) + img->imageSize;
+	slot_size = (slot_size + CATCIERGE_FRAME_RING_ALIGN - 1) & ~(size_t)(CATCIERGE_FRAME_RING_ALIGN - 1);
+	r->size = sizeof(catcierge_frame_ring_header_t) + r->slot_count * slot_size;
+
+	// Start over if a previous run did not clean up.
+	shm_unlink(r->name);
+
+	if ((fd = shm_open(r->name, O_RDWR | O_CREAT | O_EXCL, 0644)) < 0)
+	{
+		CATERR("Failed to create frame ring %s: %s\n", r->name, strerror(errno));
+		return -1;
+	}
+
+	if (ftruncate(fd, r->size))
+	{
+		CATERR("Failed to size frame ring %s: %s\n", r->name, strerror(errno));
+		goto fail;
+	}
+
+	if ((r->map = mmap(NULL, r->size, PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0)) == MAP_FAILED)
+	{
+		CATERR("Failed to map frame ring %s: %s\n", r->name, strerror(errno));
+		r->map = NULL;
+		goto fail;
+	}
+
+	close(fd);
+
+	h = r->header = (catcierge_frame_ring_header_t *)r->map;
+	h->version = CATCIERGE_FRAME_RING_VERSION;
+	h->slot_count = (uint32_t)r->slot_count;
+	h->header_size = sizeof(catcierge_frame_ring_header_t);
+	h->slot_size = slot_size;
+	h->frame_seq = 0;
+	h->writer_pid = (uint32_t)getpid();
+
+	// Readers check the magic last.
+	CATCIERGE_FRAME_RING_BARRIER();
+	h->magic = CATCIERGE_FRAME_RING_MAGIC;
+
+	CATLOG("Frame ring %s: %d slots of %d bytes\n",
+		r->name, (int)r->slot_count, (int)slot_size);
+
+	return 0;
+
+fail:
+	close(fd);
+	shm_unlink(r->name);
+	return -1;
+}
+#endif // CATCIERGE_HAVE_FRAME_RING
+
+int catcierge_frame_ring_write(catcierge_frame_ring_t *r,
+		const IplImage *img, const struct timeval *tv)
+{
+	#ifdef CATCIERGE_HAVE_FRAME_RING
+	catcierge_frame_ring_slot_t *slot;
+	uint64_t frame_seq;
+	assert(r);
+	assert(img);
+	assert(tv);
+
+	if (!r->running || !r->writer)
+	{
+		return -1;
+	}
+
+	if (!r->map && catcierge_frame_ring_create(r, img))
+	{
+		// Don't try again for every frame.
+		r->running = 0;
+		return -1;
+	}
+
+	if (sizeof(catcierge_frame_ring_slot_t) + img->imageSize > r->header->slot_size)
+	{
+		r->skipped_count++;
+		return -1;
+	}
+
+	frame_seq = r->frame_seq + 1;
+	slot = catcierge_frame_ring_slot(r, frame_seq);
+
+	slot->lock++;
+	CATCIERGE_FRAME_RING_BARRIER();
+
+	slot->frame_seq = frame_seq;
+	slot->tv_sec = tv->tv_sec;
+	slot->tv_usec = tv->tv_usec;
+	slot->width = img->width;
+	slot->height = img->height;
+	slot->channels = img->nChannels;
+	slot->stride = img->widthStep;
+	slot->size = img->imageSize;
+	memcpy((unsigned char *)slot + sizeof(catcierge_frame_ring_slot_t),
+		img->imageData, img->imageSize);
+
+	CATCIERGE_FRAME_RING_BARRIER();
+	slot->lock++;
+
+	r->header->frame_seq = frame_seq;
+	r->frame_seq = frame_seq;
+
+	return 0;
+	#else
+	return -1;
+	#endif
+}
+
+int catcierge_frame_ring_open(catcierge_frame_ring_t *r, const char *name)
+{
+	#ifdef CATCIERGE_HAVE_FRAME_RING
+	catcierge_frame_ring_header_t *h;
+	struct stat st;
+	int fd;
+	assert(r);
+	assert(name);
+	memset(r, 0, sizeof(catcierge_frame_ring_t));
+
+	if (strlen(name) >= sizeof(r->name))
+	{
+		return -1;
+	}
+
+	strcpy(r->name, name);
+
+	if ((fd = shm_open(name, O_RDONLY, 0)) < 0)
+	{
+		CATERR("Failed to open frame ring %s: %s\n", name, strerror(errno));
+		return -1;
+	}
+
+	if (fstat(fd, &st) || (st.st_size < (off_t)sizeof(catcierge_frame_ring_header_t)))
+	{
+		CATERR("Frame ring %s is not ready\n", name);
+		close(fd);
+		return -1;
+	}
+
+	r->size = st.st_size;
+
+	if ((r->map = mmap(NULL, r->size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+	{
+		CATERR("Failed to map frame ring %s: %s\n", name, strerror(errno));
+		r->map = NULL;
+		close(fd);
+		return -1;
+	}
+
+	close(fd);
+	h = r->header = (catcierge_frame_ring_header_t *)r->map;
+
+	if ((h->magic != CATCIERGE_FRAME_RING_MAGIC)
+		|| (h->version != CATCIERGE_FRAME_RING_VERSION)
+		|| (h->slot_count == 0)
+		|| (h->slot_size < sizeof(catcierge_frame_ring_slot_t))
+		|| (h->header_size + (uint64_t)h->slot_count * h->slot_size > r->size))
+	{
+		CATERR("Frame ring %s is not ready or has an unknown format\n", name);
+		catcierge_frame_ring_destroy(r);
+		return -1;
+	}
+
+	CATCIERGE_FRAME_RING_BARRIER();
+	r->slot_count = h->slot_count;
+	r->running = 1;
+
+	return 0;
+	#else
+	CATERR("Shared memory frame rings are not supported on this platform\n");
+	return -1;
+	#endif
+}
+
+uint64_t catcierge_frame_ring_latest(catcierge_frame_ring_t *r)
+{
+	assert(r);
+
+	if (!r->header)
+	{
+		return 0;
+	}
+
+	return r->header->frame_seq;
+}
+
+int catcierge_frame_ring_read(catcierge_frame_ring_t *r, uint64_t frame_seq,
+		void *buf, size_t bufsize, catcierge_frame_info_t *info)
+{
+	catcierge_frame_ring_slot_t *slot;
+	catcierge_frame_info_t tmp;
+	uint64_t lock;
+	assert(r);
+	assert(buf);
+	assert(info);
+
+	if (!r->header)
+	{
+		return -1;
+	}
+
+	if ((frame_seq == 0) || (frame_seq > r->header->frame_seq))
+	{
+		return 1;
+	}
+
+	slot = catcierge_frame_ring_slot(r, frame_seq);
+	lock = slot->lock;
+	CATCIERGE_FRAME_RING_BARRIER();
+
+	if (lock & 1)
+	{
+		return 1;
+	}
+
+	tmp.frame_seq = slot->frame_seq;
+	tmp.tv.tv_sec = (time_t)slot->tv_sec;
+	tmp.tv.tv_usec = (long)slot->tv_usec;
+	tmp.width = slot->width;
+	tmp.height = slot->height;
+	tmp.channels = slot->channels;
+	tmp.stride = slot->stride;
+	tmp.size = slot->size;
+
+	if (tmp.frame_seq != frame_seq)
+	{
+		return 1;
+	}
+
+	// A torn size is caught by the lock check below.
+	if (tmp.size > r->header->slot_size - sizeof(catcierge_frame_ring_slot_t))
+	{
+		tmp.size = 0;
+	}
+
+	if (tmp.size > bufsize)
+	{
+		CATERR("Frame of %d bytes does not fit in the buffer\n", (int)tmp.size);
+		return -1;
+	}
+
+	memcpy(buf, (unsigned char *)slot + sizeof(catcierge_frame_ring_slot_t), tmp.size);
+
+	CATCIERGE_FRAME_RING_BARRIER();
+
+	if (slot->lock != lock)
+	{
+		return 1;
+	}
+
+	*info = tmp;
+
+	return 0;
+}
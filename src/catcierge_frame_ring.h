@@ -0,0 +1,125 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_FRAME_RING_H__
+#define __CATCIERGE_FRAME_RING_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <catcierge_config.h>
+#include "catcierge_types.h"
+
+#if defined(CATCIERGE_HAVE_SYS_MMAN_H) && defined(CATCIERGE_HAVE_FCNTL_H) \
+	&& defined(CATCIERGE_HAVE_UNISTD_H)
+#define CATCIERGE_HAVE_FRAME_RING
+#endif
+
+#define DEFAULT_FRAME_RING_SLOTS 8
+#define CATCIERGE_FRAME_RING_MAX_SLOTS 64
+#define CATCIERGE_FRAME_RING_MAGIC 0x47524643 // "CFRG"
+#define CATCIERGE_FRAME_RING_VERSION 1
+
+//
+// Shared memory layout. All fields are in native byte order. The header
+// is followed by slot_count slots of slot_size bytes each, and each slot
+// starts with a slot header followed by the pixels. Frame N (counting
+// from 1) is written to slot (N - 1) % slot_count.
+//
+typedef struct catcierge_frame_ring_header_s
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slot_count;
+	uint32_t header_size;			// Offset of the first slot.
+	uint64_t slot_size;				// Including the slot header.
+	volatile uint64_t frame_seq;	// Latest complete frame, 0 if none yet.
+	uint32_t writer_pid;
+	uint32_t reserved[7];
+} catcierge_frame_ring_header_t;	// 64 bytes.
+
+// The lock is a seqlock. It is odd while the slot is being written, so
+// a reader copies the frame and then checks that the lock is still even
+// and unchanged, otherwise the frame was overwritten while it was read.
+typedef struct catcierge_frame_ring_slot_s
+{
+	volatile uint64_t lock;
+	uint64_t frame_seq;
+	int64_t tv_sec;					// Capture time.
+	int64_t tv_usec;
+	uint32_t width;
+	uint32_t height;
+	uint32_t channels;
+	uint32_t stride;				// Bytes per row.
+	uint32_t size;					// Bytes of pixels following the slot header.
+	uint32_t reserved[3];
+} catcierge_frame_ring_slot_t;		// 64 bytes.
+
+typedef struct catcierge_frame_info_s
+{
+	uint64_t frame_seq;
+	struct timeval tv;
+	int width;
+	int height;
+	int channels;
+	int stride;
+	size_t size;
+} catcierge_frame_info_t;
+
+//
+// Publishes the captured frames into a POSIX shared memory ring that
+// other local processes (a recorder, a debug viewer, analysis scripts)
+// can map read-only. Writing a frame is a memcpy, much cheaper than
+// saving it or showing it in a window. The ring is sized after the
+// first frame, frames that do not fit a slot after that are skipped.
+//
+typedef struct catcierge_frame_ring_s
+{
+	int running;
+	int writer;
+	char name[256];
+	size_t slot_count;
+	size_t size;					// Of the whole mapping.
+	unsigned char *map;
+	catcierge_frame_ring_header_t *header;
+	uint64_t frame_seq;				// Latest frame written.
+	unsigned long skipped_count;	// Frames that did not fit.
+} catcierge_frame_ring_t;
+
+// The name is a POSIX shared memory name such as "/catcierge".
+int catcierge_frame_ring_init(catcierge_frame_ring_t *r,
+		const char *name, size_t slot_count);
+
+// Unmaps the ring, and removes it if we are the writer.
+void catcierge_frame_ring_destroy(catcierge_frame_ring_t *r);
+
+// Copies the frame into the next slot, creating the ring on the first frame.
+int catcierge_frame_ring_write(catcierge_frame_ring_t *r,
+		const IplImage *img, const struct timeval *tv);
+
+// Maps an existing ring read-only.
+int catcierge_frame_ring_open(catcierge_frame_ring_t *r, const char *name);
+
+// Latest frame written to the ring, 0 if there is none yet.
+uint64_t catcierge_frame_ring_latest(catcierge_frame_ring_t *r);
+
+// Copies frame_seq into buf. Returns 0 on success, 1 if the frame was
+// overwritten or is being written (or does not exist yet), -1 on error.
+int catcierge_frame_ring_read(catcierge_frame_ring_t *r, uint64_t frame_seq,
+		void *buf, size_t bufsize, catcierge_frame_info_t *info);
+
+#endif // __CATCIERGE_FRAME_RING_H__
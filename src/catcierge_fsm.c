@@ -56,7 +56,51 @@
 #include "catcierge_fsm.h"
 #include "catcierge_output.h"
 
-void catcierge_trigger_event(catcierge_grb_t *grb, catcierge_event_t e, int execute)
+static void catcierge_notify_event(catcierge_grb_t *grb, catcierge_event_t e)
+{
+	char *line;
+
+	if (!(grb->args.notify_event_mask & CATCIERGE_EVENT_BIT(e)))
+	{
+		return;
+	}
+
+	// Rendered now, so the line describes the state when it happened.
+	if (!(line = catcierge_output_generate(&grb->output, grb, grb->args.notify_format)))
+	{
+		CATERR("Failed to generate notification from: \"%s\"\n", grb->args.notify_format);
+		return;
+	}
+
+	catcierge_notify_push(&grb->notify, line);
+}
+
+static void catcierge_dispatch_event(catcierge_grb_t *grb, catcierge_event_t e,
+		char **cmd, size_t count, int async)
+{
+	if (grb->notify.running)
+	{
+		catcierge_notify_event(grb, e);
+	}
+
+	// Nothing subscribed to the event, skip the snapshot and rendering.
+	if ((count == 0) && !catcierge_output_has_event(&grb->output, e))
+	{
+		return;
+	}
+
+	if (async && grb->event_bus.running)
+	{
+		// Dropped events are counted by the event bus.
+		catcierge_event_bus_post(&grb->event_bus, grb, e, cmd, count);
+		return;
+	}
+
+	catcierge_output_execute_list(grb, e, cmd, count);
+}
+
+static void catcierge_trigger_event_ex(catcierge_grb_t *grb,
+		catcierge_event_t e, int execute, int async)
 {
 	catcierge_args_t *args = &grb->args;
 
@@ -68,19 +112,45 @@ void catcierge_trigger_event(catcierge_grb_t *grb, catcierge_event_t e, int exec
 		if (e == ev_enum_name)												\
 		{																	\
 			char **cmd = NULL;												\
-			size_t count = args->ev_name ## _cmd_count;						\
-			if (execute) cmd = args->ev_name ## _cmd;						\
-			catcierge_output_execute_list(grb, #ev_name, cmd, count);		\
+			size_t count = 0;												\
+			if (execute)													\
+			{																\
+				cmd = args->ev_name ## _cmd;								\
+				count = args->ev_name ## _cmd_count;						\
+			}																\
+			catcierge_dispatch_event(grb, e, cmd, count, async);			\
 			return;															\
 		}
 	#include "catcierge_events.h"
 }
 
+void catcierge_trigger_event(catcierge_grb_t *grb, catcierge_event_t e, int execute)
+{
+	catcierge_trigger_event_ex(grb, e, execute, 1);
+}
+
 void catcierge_run_state(catcierge_grb_t *grb)
 {
+	size_t saved;
 	assert(grb);
 	assert(grb->state);
 
+	// Collect any event commands that have finished.
+	catcierge_executor_reap(&grb->executor);
+
+	// The background writer has finished writing these matches.
+	saved = catcierge_image_writer_poll(&grb->image_writer);
+
+	while (saved-- > 0)
+	{
+		catcierge_trigger_event(grb, CATCIERGE_SAVE_IMG, 1);
+	}
+
+	while (catcierge_mosaic_poll(&grb->mosaic))
+	{
+		catcierge_trigger_event(grb, CATCIERGE_MOSAIC_DONE, 1);
+	}
+
 	if (grb->running)
 	{
 		grb->state(grb);
@@ -241,60 +311,110 @@ void catcierge_init_rfid_readers(catcierge_grb_t *grb)
 }
 #endif // WITH_RFID
 
-void catcierge_do_lockout(catcierge_grb_t *grb)
+// Commands that refer to generated templates have to wait for the
+// templates of the event to be generated, so they can't be run up front.
+static int catcierge_lock_cmds_need_templates(char **cmds, size_t count)
 {
-	catcierge_args_t *args;
-	assert(grb);
-	args = &grb->args;
+	size_t i;
 
-	if (args->lockout_dummy)
+	for (i = 0; i < count; i++)
 	{
-		CATLOGFPS("!LOCKOUT DUMMY!\n");
-		return;
+		if (cmds[i] && strstr(cmds[i], "template_path"))
+		{
+			return 1;
+		}
 	}
 
-	if (args->do_lockout_cmd)
+	return 0;
+}
+
+// Locks or unlocks the door before anything else is done, template
+// generation, logging and notifications are done afterwards by
+// catcierge_lock_event. Returns 1 if the actuation had to be deferred
+// to the event.
+static int catcierge_actuate_lock(catcierge_grb_t *grb, int lock)
+{
+	catcierge_args_t *args = &grb->args;
+	char **cmds = lock ? args->do_lockout_cmd : args->do_unlock_cmd;
+	size_t count = lock ? args->do_lockout_cmd_count : args->do_unlock_cmd_count;
+	const char *event = lock ? "do_lockout" : "do_unlock";
+	size_t i;
+
+	// Measure from the lock decision when there is one.
+	if (!catcierge_timer_isactive(&grb->actuation_timer))
 	{
-		catcierge_trigger_event(grb, CATCIERGE_DO_LOCKOUT, 1);
+		catcierge_timer_start(&grb->actuation_timer);
 	}
-	else
+
+	if (cmds)
 	{
-		catcierge_trigger_event(grb, CATCIERGE_DO_LOCKOUT, 0);
+		if (catcierge_lock_cmds_need_templates(cmds, count))
+		{
+			return 1;
+		}
 
+		for (i = 0; i < count; i++)
+		{
+			catcierge_output_execute(grb, event, cmds[i], CATCIERGE_EXEC_IMMEDIATE);
+		}
+	}
+	else
+	{
 		#ifdef RPI
-		gpio_write(CATCIERGE_LOCKOUT_GPIO, 1);
+		gpio_line_write(&grb->lockout_line, lock);
 
 		if (args->backlight_enable)
 		{
-			gpio_write(CATCIERGE_BACKLIGHT_GPIO, 1);
+			gpio_line_write(&grb->backlight_line, 1);
 		}
 		#endif // RPI
 	}
+
+	grb->actuation_latency = catcierge_timer_get(&grb->actuation_timer);
+	catcierge_timer_reset(&grb->actuation_timer);
+
+	return 0;
 }
 
-void catcierge_do_unlock(catcierge_grb_t *grb)
+// The non time critical part of locking or unlocking.
+static void catcierge_lock_event(catcierge_grb_t *grb, int lock, int deferred)
+{
+	// A deferred lock command needs the templates right away,
+	// so it can't wait in the event queue.
+	catcierge_trigger_event_ex(grb,
+		lock ? CATCIERGE_DO_LOCKOUT : CATCIERGE_DO_UNLOCK, deferred, !deferred);
+
+	if (deferred)
+	{
+		grb->actuation_latency = catcierge_timer_get(&grb->actuation_timer);
+		catcierge_timer_reset(&grb->actuation_timer);
+	}
+
+	CATLOG("%s actuated %0.2f ms after decision%s\n",
+		lock ? "Lockout" : "Unlock",
+		grb->actuation_latency * 1000.0,
+		deferred ? " (command waited for templates)" : "");
+}
+
+void catcierge_do_lockout(catcierge_grb_t *grb)
 {
 	catcierge_args_t *args;
 	assert(grb);
 	args = &grb->args;
 
-	if (args->do_unlock_cmd)
+	if (args->lockout_dummy)
 	{
-		catcierge_trigger_event(grb, CATCIERGE_DO_UNLOCK, 1);
+		CATLOGFPS("!LOCKOUT DUMMY!\n");
+		return;
 	}
-	else
-	{
-		catcierge_trigger_event(grb, CATCIERGE_DO_UNLOCK, 0);
 
-		#ifdef RPI
-		gpio_write(CATCIERGE_LOCKOUT_GPIO, 0);
-		
-		if (args->backlight_enable)
-		{
-			gpio_write(CATCIERGE_BACKLIGHT_GPIO, 1);
-		}
-		#endif // RPI
-	}
+	catcierge_lock_event(grb, 1, catcierge_actuate_lock(grb, 1));
+}
+
+void catcierge_do_unlock(catcierge_grb_t *grb)
+{
+	assert(grb);
+	catcierge_lock_event(grb, 0, catcierge_actuate_lock(grb, 0));
 }
 
 static void catcierge_path_reset(catcierge_path_t *path)
@@ -413,6 +533,7 @@ int catcierge_drop_root_privileges(const char *user)
 int catcierge_setup_gpio(catcierge_grb_t *grb)
 {
 	catcierge_args_t *args = &grb->args;
+	catcierge_gpio_backend_t backend = GPIO_BACKEND_SYSFS;
 	int ret = 0;
 
 	if (args->do_lockout_cmd)
@@ -422,27 +543,48 @@ int catcierge_setup_gpio(catcierge_grb_t *grb)
 		return 0;
 	}
 
-	// Set export for pins.
-	if (gpio_export(CATCIERGE_LOCKOUT_GPIO)
-	 || gpio_set_direction(CATCIERGE_LOCKOUT_GPIO, OUT))
+	if (args->gpio_backend && gpio_backend_parse(args->gpio_backend, &backend))
+	{
+		CATERR("Invalid GPIO backend \"%s\"\n", args->gpio_backend);
+		return -1;
+	}
+
+	CATLOG("GPIO backend: %s\n", gpio_backend_str(backend));
+
+	// Set export for pins (not used by the character device).
+	if ((backend != GPIO_BACKEND_CHARDEV)
+	 && (gpio_export(args->lockout_gpio_pin)
+	  || gpio_set_direction(args->lockout_gpio_pin, OUT)))
 	{
 		CATERR("Failed to export and set direction for door pin\n");
 		ret = -1; goto fail;
 	}
 
 	// Start with the door open and light on.
-	gpio_write(CATCIERGE_LOCKOUT_GPIO, 0);
+	// The lines are kept open so that locking is a single write.
+	if (gpio_line_open(&grb->lockout_line, backend,
+			args->gpio_chip, args->lockout_gpio_pin, 0))
+	{
+		CATERR("Failed to open door pin\n");
+		ret = -1; goto fail;
+	}
 
 	if (args->backlight_enable)
 	{
-		if (gpio_export(CATCIERGE_BACKLIGHT_GPIO)
-		 || gpio_set_direction(CATCIERGE_BACKLIGHT_GPIO, OUT))
+		if ((backend != GPIO_BACKEND_CHARDEV)
+		 && (gpio_export(args->backlight_gpio_pin)
+		  || gpio_set_direction(args->backlight_gpio_pin, OUT)))
 		{
 			CATERR("Failed to export and set direction for backlight pin\n");
 			ret = -1; goto fail;
 		}
-	
-		gpio_write(CATCIERGE_BACKLIGHT_GPIO, 1);
+
+		if (gpio_line_open(&grb->backlight_line, backend,
+				args->gpio_chip, args->backlight_gpio_pin, 1))
+		{
+			CATERR("Failed to open backlight pin\n");
+			ret = -1; goto fail;
+		}
 	}
 
 fail:
@@ -472,13 +614,23 @@ fail:
 
 IplImage *catcierge_get_frame(catcierge_grb_t *grb)
 {
+	IplImage *img;
+	struct timeval tv;
 	assert(grb);
 
 	#ifdef RPI
-	return raspiCamCvQueryFrame(grb->capture);
+	img = raspiCamCvQueryFrame(grb->capture);
 	#else
-	return cvQueryFrame(grb->capture);
-	#endif	
+	img = cvQueryFrame(grb->capture);
+	#endif
+
+	if (img && grb->frame_ring.running)
+	{
+		gettimeofday(&tv, NULL);
+		catcierge_frame_ring_write(&grb->frame_ring, img, &tv);
+	}
+
+	return img;
 }
 
 static int catcierge_calculate_match_id(IplImage *img, match_state_t *m)
@@ -521,46 +673,63 @@ static int catcierge_calculate_matchgroup_id(match_group_t *mg, IplImage *img)
 	return 0;
 }
 
-static void catcierge_process_match_result(catcierge_grb_t *grb, IplImage *img)
+// Match frames that are not saved are still needed in memory by these.
+static int catcierge_keep_match_frames(catcierge_grb_t *grb)
+{
+	#ifdef WITH_ZMQ
+	if (grb->args.zmq_images && grb->publisher.running)
+	{
+		return 1;
+	}
+	#endif
+
+	return (grb->args.mosaic_path != NULL);
+}
+
+// Releases the match frames, when they were only kept for something that failed.
+static void catcierge_release_match_frames(match_group_t *mg)
+{
+	size_t i;
+
+	for (i = 0; i < MATCH_MAX_COUNT; i++)
+	{
+		if (mg->matches[i].img)
+		{
+			cvReleaseImage(&mg->matches[i].img);
+		}
+	}
+}
+
+//
+// Logs the result of the latest match and names its image files.
+// The file names include the outcome, so for batched matchers this
+// waits until the group has been matched.
+//
+static void catcierge_finish_match_result(catcierge_grb_t *grb)
 {
 	size_t j;
 	catcierge_args_t *args = NULL;
 	match_result_t *res = NULL;
  	match_state_t *m = NULL;
 	assert(grb);
-	assert(img);
 	assert(grb->match_group.match_count <= MATCH_MAX_COUNT);
 	args = &grb->args;
 
 	m = &grb->match_group.matches[grb->match_group.match_count - 1];
 	res = &m->result;
 
-	// Get time of match and format.
-	m->img = NULL;
-	m->time = time(NULL); // TODO: Get rid of this and use tv.tv_sec instead, same thing.
-	gettimeofday(&m->tv, NULL);
-	get_time_str_fmt(m->time, &m->tv, m->time_str,
-		sizeof(m->time_str), FILENAME_TIME_FORMAT);
-
-	// Calculate match id from time + image data.
-	if (catcierge_calculate_match_id(img, m))
-	{
-		CATERR("Failed to calculate match id!\n");
-	}
-
 	log_printc(stdout, (res->success ? COLOR_GREEN : COLOR_RED),
-		"%sMatch %s - %s (%x%x%x%x%x)\n",
+		"%sMatch %s - %s%s (%x%x%x%x%x)\n",
 		res->success ? "" : "No ",
 		catcierge_get_direction_str(res->direction),
 		res->description,
+		res->reused ? " (reused)" : "",
 		m->sha.Message_Digest[0],
 		m->sha.Message_Digest[1],
 		m->sha.Message_Digest[2],
 		m->sha.Message_Digest[3],
 		m->sha.Message_Digest[4]);
 
-	catcierge_path_reset(&m->path);
-
 	// Save match image.
 	// (We don't write to disk yet, that will slow down the matching).
 	if (args->saveimg)
@@ -591,7 +760,9 @@ static void catcierge_process_match_result(catcierge_grb_t *grb, IplImage *img)
 			(int)grb->match_group.match_count);
 
 		snprintf(m->path.dir, sizeof(m->path.dir) - 1, "%s", match_gen_output_path);
-		snprintf(m->path.filename, sizeof(m->path.filename) - 1, "%s.png", base_path);
+		snprintf(m->path.filename, sizeof(m->path.filename) - 1, "%s.%s", base_path,
+				 catcierge_image_format_ext(args->image_format,
+					m->img ? m->img->nChannels : 1));
 		snprintf(m->path.full, sizeof(m->path.full) - 1, "%s%s%s",
 				 m->path.dir, catcierge_path_sep(), m->path.filename);
 
@@ -600,7 +771,6 @@ static void catcierge_process_match_result(catcierge_grb_t *grb, IplImage *img)
 			free(match_gen_output_path);
 		}
 
-		m->img = cvCloneImage(img);
 		// TODO: Add option to save the image right away also.
 
 		if (args->save_steps)
@@ -629,10 +799,12 @@ static void catcierge_process_match_result(catcierge_grb_t *grb, IplImage *img)
 					"%s", step_gen_output_path);
 
 				snprintf(step->path.filename, sizeof(step->path.filename) - 1,
-					"%s_%02d_%s.png",
+					"%s_%02d_%s.%s",
 					base_path,
 					(int)j,
-					step->name);
+					step->name,
+					catcierge_image_format_ext(args->image_format,
+						step->img ? step->img->nChannels : 1));
 
 				snprintf(step->path.full, sizeof(step->path.full) - 1, "%s%s%s",
 					step->path.dir, catcierge_path_sep(), step->path.filename);
@@ -647,92 +819,486 @@ static void catcierge_process_match_result(catcierge_grb_t *grb, IplImage *img)
 	}
 }
 
-static void catcierge_save_images(catcierge_grb_t *grb, match_direction_t direction)
+//
+// Records the time, id and frame of the latest match.
+//
+static void catcierge_record_match_result(catcierge_grb_t *grb, IplImage *img)
 {
-	match_group_t *mg = &grb->match_group;
-	match_state_t *m;
-	match_result_t *res;
-	int i;
-	size_t j;
-	catcierge_args_t *args;
-	match_step_t *step = NULL;
+	catcierge_args_t *args = NULL;
+ 	match_state_t *m = NULL;
 	assert(grb);
+	assert(img);
+	assert(grb->match_group.match_count <= MATCH_MAX_COUNT);
 	args = &grb->args;
 
-	if (args->save_obstruct_img)
+	m = &grb->match_group.matches[grb->match_group.match_count - 1];
+
+	// Get time of match and format.
+	m->img = NULL;
+	catcierge_path_reset(&m->path);
+	m->time = time(NULL); // TODO: Get rid of this and use tv.tv_sec instead, same thing.
+	gettimeofday(&m->tv, NULL);
+	get_time_str_fmt(m->time, &m->tv, m->time_str,
+		sizeof(m->time_str), FILENAME_TIME_FORMAT);
+
+	// Calculate match id from time + image data.
+	if (catcierge_calculate_match_id(img, m))
 	{
-		CATLOG("Saving obstruct image: %s\n", mg->obstruct_path.full);
-		catcierge_make_path(mg->obstruct_path.dir);
-		cvSaveImage(mg->obstruct_path.full, mg->obstruct_img, 0);
-		// TODO: Save obstruct step images as well?
-		// TODO: Add execute event for this?
+		CATERR("Failed to calculate match id!\n");
+	}
 
-		cvReleaseImage(&mg->obstruct_img);
+	// The image is written to disk later, and the mosaic and the
+	// published images are made from the frame in memory.
+	if (args->saveimg || catcierge_keep_match_frames(grb))
+	{
+		m->img = cvCloneImage(img);
 	}
+}
 
-	for (i = 0; i < MATCH_MAX_COUNT; i++)
+// Hands the images over to the background writer. The match and obstruct
+// images are not used after this, the step images are copied since they
+// stay around until the next match.
+static void catcierge_queue_images(catcierge_grb_t *grb)
+{
+	match_group_t *mg = &grb->match_group;
+	catcierge_image_writer_t *w = &grb->image_writer;
+	catcierge_args_t *args = &grb->args;
+	match_state_t *m;
+	match_step_t *step = NULL;
+	IplImage *img;
+	int last_step;
+	int i;
+	int j;
+
+	if (args->save_obstruct_img && mg->obstruct_img)
 	{
-		m = &grb->match_group.matches[i];
-		res = &m->result;
+		CATLOG("Queue obstruct image: %s\n", mg->obstruct_path.full);
+		catcierge_image_writer_push(w, mg->obstruct_img,
+			mg->obstruct_path.dir, mg->obstruct_path.full, 0);
+		mg->obstruct_img = NULL;
+	}
 
-		CATLOG("Saving image %s\n", m->path.full);
-		catcierge_make_path(m->path.dir);
-		cvSaveImage(m->path.full, m->img, 0);
+	for (i = 0; i < (int)mg->match_count; i++)
+	{
+		m = &mg->matches[i];
+		last_step = -1;
 
 		if (args->save_steps)
 		{
-			for (j = 0; j < m->result.step_img_count; j++)
+			for (j = 0; j < (int)m->result.step_img_count; j++)
 			{
-				step = &m->result.steps[j];
-				CATLOG("  %02d %-34s  %s\n", (int)j, step->description, step->path.full);
-
-				if (step->img)
-				{
-					catcierge_make_path(step->path.dir);
-					cvSaveImage(step->path.full, step->img, NULL);
-				}
+				if (m->result.steps[j].img)
+					last_step = j;
 			}
 		}
 
-		catcierge_trigger_event(grb, CATCIERGE_SAVE_IMG, 1);
+		// The save_img event is triggered when the last image of the match is written.
+		if (m->img)
+		{
+			CATLOG("Queue image %s\n", m->path.full);
+			catcierge_image_writer_push(w, m->img,
+				m->path.dir, m->path.full, (last_step < 0));
+			m->img = NULL;
+		}
 
-		cvReleaseImage(&m->img);
+		for (j = 0; j <= last_step; j++)
+		{
+			step = &m->result.steps[j];
+			CATLOG("  %02d %-34s  %s\n", j, step->description, step->path.full);
+
+			if (step->img && (img = cvCloneImage(step->img)))
+			{
+				catcierge_image_writer_push(w, img,
+					step->path.dir, step->path.full, (j == last_step));
+			}
+		}
 	}
 }
 
-static int catcierge_check_max_consecutive_lockouts(catcierge_grb_t *grb)
+#ifdef WITH_ZMQ
+static void catcierge_publish_match_group(catcierge_grb_t *grb)
 {
-	catcierge_args_t *args;
-	assert(grb);
-	args = &grb->args;
+	catcierge_args_t *args = &grb->args;
+	match_group_t *mg = &grb->match_group;
+	catcierge_publisher_msg_t *msg;
+	catcierge_serializer_t *s = &grb->output.serializer;
+	match_state_t *m;
+	IplImage *img;
+	size_t i;
 
-	// Check how long ago we perform the last lockout.
-	// If there are too many lockouts in a row, there
-	// might be an error. Such as the backlight failing.
-	if (args->max_consecutive_lockout_count)
+	if (catcierge_output_serialize_event(&grb->output, grb,
+			catcierge_output_event_name(CATCIERGE_MATCH_GROUP_DONE),
+			CATCIERGE_FORMAT_JSON))
 	{
-		double lockout_timer_val = catcierge_timer_get(&grb->lockout_timer);
+		CATERR("Failed to serialize match group for publishing\n");
+		goto fail;
+	}
 
-		if ((lockout_timer_val
-			<= (args->lockout_time + args->consecutive_lockout_delay)))
+	if (!(msg = catcierge_publisher_msg_create(CATCIERGE_ZMQ_IMAGES_TOPIC,
+			NULL, s->buf, s->len)))
+	{
+		goto fail;
+	}
+
+	for (i = 0; i < mg->match_count; i++)
+	{
+		m = &mg->matches[i];
+
+		if (!m->img)
+			continue;
+
+		// Take over the frames when nothing else needs them.
+		if (!args->saveimg && !args->mosaic_path)
 		{
-			grb->consecutive_lockout_count++;
-			if (grb->consecutive_lockout_count > 1)
-			{
-				CATLOG("Consecutive lockout! %d out of %d before quiting. "
-					   "(%0.2f sec <= %0.2f sec)\n",
-						grb->consecutive_lockout_count,
-						args->max_consecutive_lockout_count,
-						lockout_timer_val,
-						(args->lockout_time + args->consecutive_lockout_delay));
-				CATLOG("  (Lockout Time %0.2f + Consecutive lockout delay %0.2f = %0.2f)\n",
-						args->consecutive_lockout_delay,
-						args->lockout_time, args->consecutive_lockout_delay);
-			}
+			img = m->img;
+			m->img = NULL;
 		}
-		else
+		else if (!(img = cvCloneImage(m->img)))
 		{
-			grb->consecutive_lockout_count = 0;
+			continue;
+		}
+
+		catcierge_publisher_msg_add_image(msg, img);
+	}
+
+	if (catcierge_publisher_push(&grb->publisher, msg))
+	{
+		CATERR("ZMQ publish queue full, dropped the match group images\n");
+	}
+
+	return;
+fail:
+	// Nothing else would release the frames that were only kept for publishing.
+	if (!args->saveimg && !args->mosaic_path)
+	{
+		catcierge_release_match_frames(mg);
+	}
+}
+#endif // WITH_ZMQ
+
+static void catcierge_mosaic_match_group(catcierge_grb_t *grb)
+{
+	catcierge_args_t *args = &grb->args;
+	catcierge_mosaic_job_t *job;
+	char *path;
+
+	if (!(path = catcierge_output_generate(&grb->output, grb, args->mosaic_path)))
+	{
+		CATERR("Failed to generate mosaic path from: \"%s\"\n", args->mosaic_path);
+		goto fail;
+	}
+
+	// Unless they are saved, the match frames were only kept for the mosaic.
+	if (!(job = catcierge_mosaic_job_create(&grb->match_group, path, !args->saveimg)))
+	{
+		goto fail;
+	}
+
+	if (grb->mosaic.running)
+	{
+		catcierge_mosaic_push(&grb->mosaic, job);
+	}
+	else
+	{
+		if (!catcierge_mosaic_write(job, args->mosaic_width))
+		{
+			snprintf(grb->mosaic.path, sizeof(grb->mosaic.path), "%s", path);
+			catcierge_trigger_event(grb, CATCIERGE_MOSAIC_DONE, 1);
+		}
+
+		catcierge_mosaic_job_free(job);
+	}
+
+	free(path);
+	return;
+fail:
+	if (!args->saveimg)
+	{
+		catcierge_release_match_frames(&grb->match_group);
+	}
+
+	free(path);
+}
+
+static void catcierge_journal_match_group(catcierge_grb_t *grb)
+{
+	match_group_t *mg = &grb->match_group;
+	catcierge_journal_event_t e;
+	match_result_t *res;
+	size_t i;
+
+	memset(&e, 0, sizeof(e));
+	e.time_us = ((uint64_t)mg->start_tv.tv_sec * 1000000) + mg->start_tv.tv_usec;
+	e.duration_ms = (uint32_t)(((mg->end_tv.tv_sec - mg->start_tv.tv_sec) * 1000)
+				+ ((mg->end_tv.tv_usec - mg->start_tv.tv_usec) / 1000));
+	e.success = mg->success;
+	e.direction = mg->direction;
+	e.success_count = mg->success_count;
+	e.flags = (mg->final_decision ? CATCIERGE_JOURNAL_FINAL_DECISION : 0)
+			| (mg->early_decision ? CATCIERGE_JOURNAL_EARLY_DECISION : 0);
+	e.rfid_direction = MATCH_DIR_UNKNOWN;
+
+	for (i = 0; i < 5; i++)
+	{
+		e.id[i] = mg->sha.Message_Digest[i];
+	}
+
+	e.match_count = (mg->match_count > CATCIERGE_JOURNAL_MAX_MATCHES)
+				? CATCIERGE_JOURNAL_MAX_MATCHES : mg->match_count;
+
+	for (i = 0; i < e.match_count; i++)
+	{
+		res = &mg->matches[i].result;
+		e.matches[i].result = (float)res->result;
+		e.matches[i].success = res->success;
+		e.matches[i].direction = res->direction;
+		e.matches[i].reused = res->reused;
+	}
+
+	#ifdef WITH_RFID
+	e.rfid_direction = grb->rfid_direction;
+	e.flags |= (grb->rfid_in_match.triggered ? CATCIERGE_JOURNAL_RFID_IN : 0)
+			| (grb->rfid_in_match.is_allowed ? CATCIERGE_JOURNAL_RFID_IN_ALLOWED : 0)
+			| (grb->rfid_out_match.triggered ? CATCIERGE_JOURNAL_RFID_OUT : 0)
+			| (grb->rfid_out_match.is_allowed ? CATCIERGE_JOURNAL_RFID_OUT_ALLOWED : 0);
+	#endif
+
+	catcierge_journal_append(&grb->journal, &e);
+}
+
+static void catcierge_archive_images(catcierge_grb_t *grb)
+{
+	match_group_t *mg = &grb->match_group;
+	catcierge_args_t *args = &grb->args;
+	catcierge_serializer_t *s = &grb->output.serializer;
+	catcierge_archive_record_t *r = NULL;
+	match_state_t *m;
+	match_step_t *step;
+	IplImage *img;
+	unsigned char *meta;
+	char *path = NULL;
+	char id[64];
+	int i;
+	int j;
+
+	if (!(path = catcierge_output_generate(&grb->output, grb, args->archive_path)))
+	{
+		CATERR("Failed to generate archive path from: \"%s\"\n", args->archive_path);
+		return;
+	}
+
+	if (!(r = malloc(sizeof(catcierge_archive_record_t))))
+	{
+		CATERR("Out of memory\n");
+		goto fail;
+	}
+
+	catcierge_archive_record_init(r);
+	r->time_us = ((uint64_t)mg->start_tv.tv_sec * 1000000) + mg->start_tv.tv_usec;
+	r->success = mg->success;
+	r->direction = mg->direction;
+	r->match_count = (int)mg->match_count;
+	if (catcierge_output_translate(grb, id, sizeof(id), "match_group_id"))
+	{
+		snprintf(r->id, sizeof(r->id), "%s", id);
+	}
+
+	if (!catcierge_output_serialize_event(&grb->output, grb,
+			catcierge_output_event_name(CATCIERGE_MATCH_GROUP_DONE),
+			CATCIERGE_FORMAT_JSON)
+		&& (meta = malloc(s->len)))
+	{
+		memcpy(meta, s->buf, s->len);
+		catcierge_archive_record_add_data(r, CATCIERGE_ARCHIVE_META,
+			"event.json", meta, s->len);
+	}
+
+	if (args->save_obstruct_img && mg->obstruct_img)
+	{
+		catcierge_archive_record_add_image(r, CATCIERGE_ARCHIVE_OBSTRUCT,
+			mg->obstruct_path.filename, mg->obstruct_img, 0, 0);
+		mg->obstruct_img = NULL;
+	}
+
+	for (i = 0; i < (int)mg->match_count; i++)
+	{
+		m = &mg->matches[i];
+
+		if (m->img)
+		{
+			catcierge_archive_record_add_image(r, CATCIERGE_ARCHIVE_MATCH,
+				m->path.filename, m->img, i, 0);
+			m->img = NULL;
+		}
+
+		for (j = 0; args->save_steps && (j < (int)m->result.step_img_count); j++)
+		{
+			step = &m->result.steps[j];
+
+			if (step->img && (img = cvCloneImage(step->img)))
+			{
+				catcierge_archive_record_add_image(r, CATCIERGE_ARCHIVE_STEP,
+					step->path.filename, img, i, j);
+			}
+		}
+	}
+
+	CATLOG("Archive match group %s in %s\n", r->id, path);
+
+	// The save_img event is triggered for each match once the record is written.
+	if (grb->image_writer.running)
+	{
+		catcierge_image_writer_push_record(&grb->image_writer, &grb->archive,
+			r, path, (int)mg->match_count);
+		r = NULL;
+	}
+	else
+	{
+		catcierge_archive_record_encode(r, args->image_format, args->png_compression);
+
+		if (catcierge_archive_switch(&grb->archive, path)
+			|| catcierge_archive_append(&grb->archive, r))
+		{
+			CATERR("Failed to append match group to archive %s\n", path);
+		}
+
+		for (i = 0; i < (int)mg->match_count; i++)
+		{
+			catcierge_trigger_event(grb, CATCIERGE_SAVE_IMG, 1);
+		}
+	}
+
+fail:
+	if (r)
+	{
+		catcierge_archive_record_free(r);
+		free(r);
+	}
+
+	free(path);
+}
+
+// Stages the encoded image when --staging is on, otherwise saves it right away.
+static int catcierge_save_image(catcierge_grb_t *grb,
+		const char *dir, const char *path, const IplImage *img)
+{
+	catcierge_args_t *args = &grb->args;
+	unsigned char *data = NULL;
+	size_t len = 0;
+
+	if (grb->staging.running)
+	{
+		if (!(data = catcierge_image_encode(img, args->image_format,
+				args->png_compression, &len)))
+		{
+			CATERR("Failed to encode image %s\n", path);
+			return -1;
+		}
+
+		return catcierge_staging_add(&grb->staging, path, (char *)data, len);
+	}
+
+	catcierge_make_path("%s", dir);
+	return catcierge_image_save(path, img, args->image_format, args->png_compression);
+}
+
+static void catcierge_save_images(catcierge_grb_t *grb, match_direction_t direction)
+{
+	match_group_t *mg = &grb->match_group;
+	match_state_t *m;
+	match_result_t *res;
+	int i;
+	size_t j;
+	catcierge_args_t *args;
+	match_step_t *step = NULL;
+	assert(grb);
+	args = &grb->args;
+
+	if (args->archive_path)
+	{
+		catcierge_archive_images(grb);
+		return;
+	}
+
+	if (grb->image_writer.running)
+	{
+		catcierge_queue_images(grb);
+		return;
+	}
+
+	if (args->save_obstruct_img)
+	{
+		CATLOG("Saving obstruct image: %s\n", mg->obstruct_path.full);
+		catcierge_save_image(grb, mg->obstruct_path.dir,
+			mg->obstruct_path.full, mg->obstruct_img);
+		// TODO: Save obstruct step images as well?
+		// TODO: Add execute event for this?
+
+		cvReleaseImage(&mg->obstruct_img);
+	}
+
+	for (i = 0; i < (int)mg->match_count; i++)
+	{
+		m = &grb->match_group.matches[i];
+		res = &m->result;
+
+		CATLOG("Saving image %s\n", m->path.full);
+		catcierge_save_image(grb, m->path.dir, m->path.full, m->img);
+
+		if (args->save_steps)
+		{
+			for (j = 0; j < m->result.step_img_count; j++)
+			{
+				step = &m->result.steps[j];
+				CATLOG("  %02d %-34s  %s\n", (int)j, step->description, step->path.full);
+
+				if (step->img)
+				{
+					catcierge_save_image(grb, step->path.dir,
+						step->path.full, step->img);
+				}
+			}
+		}
+
+		catcierge_trigger_event(grb, CATCIERGE_SAVE_IMG, 1);
+
+		cvReleaseImage(&m->img);
+	}
+}
+
+static int catcierge_check_max_consecutive_lockouts(catcierge_grb_t *grb)
+{
+	catcierge_args_t *args;
+	assert(grb);
+	args = &grb->args;
+
+	// Check how long ago we perform the last lockout.
+	// If there are too many lockouts in a row, there
+	// might be an error. Such as the backlight failing.
+	if (args->max_consecutive_lockout_count)
+	{
+		double lockout_timer_val = catcierge_timer_get(&grb->lockout_timer);
+
+		if ((lockout_timer_val
+			<= (args->lockout_time + args->consecutive_lockout_delay)))
+		{
+			grb->consecutive_lockout_count++;
+			if (grb->consecutive_lockout_count > 1)
+			{
+				CATLOG("Consecutive lockout! %d out of %d before quiting. "
+					   "(%0.2f sec <= %0.2f sec)\n",
+						grb->consecutive_lockout_count,
+						args->max_consecutive_lockout_count,
+						lockout_timer_val,
+						(args->lockout_time + args->consecutive_lockout_delay));
+				CATLOG("  (Lockout Time %0.2f + Consecutive lockout delay %0.2f = %0.2f)\n",
+						args->consecutive_lockout_delay,
+						args->lockout_time, args->consecutive_lockout_delay);
+			}
+		}
+		else
+		{
+			grb->consecutive_lockout_count = 0;
 
 			CATLOG("Consecutive lockout count reset. "
 					"%0.2f seconds between lockouts "
@@ -885,13 +1451,15 @@ static void catcierge_show_image(catcierge_grb_t *grb)
 	}
 }
 
-double catcierge_do_match(catcierge_grb_t *grb)
+double catcierge_do_match(catcierge_grb_t *grb, IplImage *img)
 {
 	double match_res = 0.0;
 	catcierge_args_t *args;
 	match_group_t *mg = &grb->match_group;
 	match_result_t *result;
 	match_state_t *match;
+	int use_cache;
+	int cache_hit = 0;
 	assert(grb);
 	assert(mg->match_count <= MATCH_MAX_COUNT);
 	args = &grb->args;
@@ -902,27 +1470,59 @@ double catcierge_do_match(catcierge_grb_t *grb)
 	catcierge_cleanup_match_steps(grb, result);
 	memset(result, 0, sizeof(match_result_t));
 
-	if ((match_res = grb->matcher->match(grb->matcher, grb->img, result, args->save_steps)) < 0.0)
+	// Batched matchers only have their results after the group is done.
+	use_cache = (args->match_cache > 0.0) && !grb->matcher->group_match;
+
+	if (use_cache)
+	{
+		if (!grb->match_cache.sig && catcierge_match_cache_init(&grb->match_cache))
+		{
+			return -1;
+		}
+
+		if ((cache_hit = catcierge_match_cache_lookup(&grb->match_cache,
+				img, args->match_cache, result)) > 0)
+		{
+			CATLOG("Frame differs %0.2f from the last matched frame, reusing its result\n",
+				grb->match_cache.diff_mean);
+			return result->result;
+		}
+	}
+
+	if ((match_res = grb->matcher->match(grb->matcher, img, result, args->save_steps)) < 0.0)
 	{
 		CATERR("%s matcher: Error when matching frame!\n", grb->matcher->name);
 	}
+	else if (use_cache && (cache_hit == 0))
+	{
+		catcierge_match_cache_store(&grb->match_cache, result);
+	}
 
 	return match_res;
 }
 
+// The template matcher direction is taken from the successful
+// matches, for the others the direction counts decide.
+static int catcierge_uses_success_direction(catcierge_args_t *args)
+{
+	return (args->matcher_type == MATCHER_TEMPLATE)
+		|| ((args->matcher_type == MATCHER_CHAIN)
+		 && (args->chain.main_type == MATCHER_TEMPLATE));
+}
+
 static match_direction_t catcierge_guess_overall_direction(catcierge_grb_t *grb)
 {
 	int i;
 	match_direction_t direction = MATCH_DIR_UNKNOWN;
 	assert(grb);
 
-	if (grb->args.matcher_type == MATCHER_TEMPLATE)
+	if (catcierge_uses_success_direction(&grb->args))
 	{
 		// Get any successful direction.
 		// (It is very uncommon for 2 successful matches to give different
 		// direction with the template matcher, so we can be pretty sure
 		// this is correct).
-		for (i = 0; i < MATCH_MAX_COUNT; i++)
+		for (i = 0; i < (int)grb->match_group.match_count; i++)
 		{
 			if (grb->match_group.matches[i].result.success)
 			{
@@ -937,7 +1537,7 @@ static match_direction_t catcierge_guess_overall_direction(catcierge_grb_t *grb)
 		int out_count = 0;
 		int unknown_count = 0;
 
-		for (i = 0; i < MATCH_MAX_COUNT; i++)
+		for (i = 0; i < (int)grb->match_group.match_count; i++)
 		{
 			switch (grb->match_group.matches[i].result.direction)
 			{
@@ -978,6 +1578,8 @@ void catcierge_match_group_start(match_group_t *mg, IplImage *img)
 	catcierge_path_reset(&mg->obstruct_path);
 	mg->match_count = 0;
 	mg->final_decision = 0;
+	mg->early_decision = 0;
+	mg->skipped_frames = 0;
 
 	// We base the matchgroup id on the obstruct image + timestamp.
 	catcierge_calculate_matchgroup_id(mg, img);
@@ -1001,8 +1603,87 @@ void catcierge_match_group_end(match_group_t *mg)
 {
 	assert(mg);
 
-	gettimeofday(&mg->end_tv, NULL);
-	mg->end_time = time(NULL);
+	gettimeofday(&mg->end_tv, NULL);
+	mg->end_time = time(NULL);
+}
+
+//
+// Checks if the outcome of the match group is already certain,
+// no matter what the remaining matches would give.
+//
+static int catcierge_match_group_is_decided(catcierge_grb_t *grb)
+{
+	match_group_t *mg = &grb->match_group;
+	catcierge_args_t *args = &grb->args;
+	int remaining = MATCH_MAX_COUNT - (int)mg->match_count;
+	int success_count = 0;
+	int in_count = 0;
+	int out_count = 0;
+	int unknown_count = 0;
+	int out_possible;
+	int i;
+
+	// Batched matchers don't have any results until the group is complete.
+	if (grb->matcher->group_match)
+		return 0;
+
+	if (remaining <= 0)
+		return 1;
+
+	for (i = 0; i < (int)mg->match_count; i++)
+	{
+		success_count += !!mg->matches[i].result.success;
+
+		switch (mg->matches[i].result.direction)
+		{
+			case MATCH_DIR_IN: in_count++; break;
+			case MATCH_DIR_OUT: out_count++; break;
+			case MATCH_DIR_UNKNOWN: unknown_count++; break;
+		}
+	}
+
+	// Going out is always a success, so see if the remaining
+	// matches could still make the overall direction out.
+	// (Same rules as in catcierge_guess_overall_direction).
+	if (catcierge_uses_success_direction(args))
+	{
+		// Any successful match going out is enough.
+		out_possible = 1;
+	}
+	else
+	{
+		out_count += remaining;
+		out_possible = !((in_count > out_count) && (in_count > unknown_count))
+					&& (out_count > unknown_count);
+	}
+
+	// Success is impossible.
+	if (!out_possible && ((success_count + remaining) < args->ok_matches_needed))
+	{
+		return 1;
+	}
+
+	// Success is certain, unless the matcher can still veto it.
+	if (success_count >= args->ok_matches_needed)
+	{
+		int vetoed;
+
+		if (args->no_final_decision)
+			return 1;
+
+		// The matcher vetoes are based on something missing in all
+		// of the matches (no cat head found at all). So if the matches
+		// so far pass, the complete match group will too.
+		mg->success = 1;
+		vetoed = !grb->matcher->decide(grb->matcher, mg);
+		mg->success = 0;
+		mg->final_decision = 0;
+		mg->description[0] = '\0';
+
+		return !vetoed;
+	}
+
+	return 0;
 }
 
 void catcierge_decide_lock_status(catcierge_grb_t *grb)
@@ -1011,17 +1692,64 @@ void catcierge_decide_lock_status(catcierge_grb_t *grb)
 	catcierge_args_t *args = &grb->args;
 	assert(grb);
 	int i;
+	int match_count = (int)mg->match_count;
+	int ok_matches_needed = args->ok_matches_needed;
+
+	// The lock actuation latency is measured from here.
+	catcierge_timer_reset(&grb->actuation_timer);
+	catcierge_timer_start(&grb->actuation_timer);
 
 	mg->success = 0;
 	mg->success_count = 0;
 
-	for (i = 0; i < MATCH_MAX_COUNT; i++)
+	// Let matchers that work on the group as a whole
+	// finish the match results before we count them.
+	if (grb->matcher->group_match)
+	{
+		if (grb->matcher->group_match(grb->matcher, mg))
+		{
+			CATERR("%s matcher: Error when matching group!\n", grb->matcher->name);
+		}
+
+		// Now that the results are known, name the images
+		// and send the events for each match in order.
+		for (i = 0; i < match_count; i++)
+		{
+			mg->match_count = i + 1;
+			catcierge_finish_match_result(grb);
+			catcierge_trigger_event(grb, CATCIERGE_MATCH_DONE, 1);
+		}
+
+		mg->match_count = match_count;
+	}
+
+	if (mg->skipped_frames > 0)
+	{
+		CATLOG("Skipped %d lower quality frames (bursts of %d)\n",
+			mg->skipped_frames, args->burst);
+	}
+
+	if (args->streaming)
 	{
-		mg->success_count += !!mg->matches[i].result.success;
+		// Decide on the most recent results only.
+		catcierge_match_window_t *w = &grb->match_window;
+
+		match_count = (int)w->count;
+		mg->success_count = w->success_count;
+		mg->direction = catcierge_uses_success_direction(args)
+			? catcierge_match_window_success_direction(w)
+			: catcierge_match_window_direction(w);
 	}
+	else
+	{
+		for (i = 0; i < (int)mg->match_count; i++)
+		{
+			mg->success_count += !!mg->matches[i].result.success;
+		}
 
-	// Guess the direction.
-	mg->direction = catcierge_guess_overall_direction(grb);
+		// Guess the direction.
+		mg->direction = catcierge_guess_overall_direction(grb);
+	}
 
 	// When going out, if only 1 image is a succesful match
 	// we still count it as overall succesful so we don't get
@@ -1034,13 +1762,24 @@ void catcierge_decide_lock_status(catcierge_grb_t *grb)
 	else
 	{
 		// Otherwise if enough matches (default 2) are ok.
-		mg->success = (mg->success_count >= args->ok_matches_needed);
+		mg->success = (mg->success_count >= ok_matches_needed);
 
 		if (!mg->success)
 		{
-			snprintf(mg->description, sizeof(mg->description) - 1,
-				"Lockout %d of %d matches failed",
-				(MATCH_MAX_COUNT - mg->success_count), MATCH_MAX_COUNT);
+			// When streaming the frame might clear before
+			// enough matches have been made.
+			if (match_count < ok_matches_needed)
+			{
+				snprintf(mg->description, sizeof(mg->description) - 1,
+					"Lockout only %d of %d needed matches made",
+					match_count, ok_matches_needed);
+			}
+			else
+			{
+				snprintf(mg->description, sizeof(mg->description) - 1,
+					"Lockout %d of %d matches failed",
+					(match_count - mg->success_count), match_count);
+			}
 		}
 
 		// Let the matcher veto if the match group was successful.
@@ -1058,10 +1797,13 @@ void catcierge_decide_lock_status(catcierge_grb_t *grb)
 
 	if (mg->success)
 	{
+		// Make sure the door is open.
+		catcierge_do_unlock(grb);
+
 		snprintf(mg->description, sizeof(mg->description) - 1, "Everything OK!");
 
 		CATLOG("Everything OK! (%d out of %d matches succeeded)"
-				" Door kept open...\n", mg->success_count, MATCH_MAX_COUNT);
+				" Door kept open...\n", mg->success_count, match_count);
 
 		if (grb->consecutive_lockout_count > 0)
 		{
@@ -1071,9 +1813,6 @@ void catcierge_decide_lock_status(catcierge_grb_t *grb)
 			grb->consecutive_lockout_count = 0;
 		}
 
-		// Make sure the door is open.
-		catcierge_do_unlock(grb);
-
 		#ifdef WITH_RFID
 		// We only want to check for RFID lock once
 		// during each match timeout period.
@@ -1085,10 +1824,6 @@ void catcierge_decide_lock_status(catcierge_grb_t *grb)
 	}
 	else
 	{
-		CATLOG("Lockout! %d out of %d matches failed (for %d seconds).\n",
-				(MATCH_MAX_COUNT - mg->success_count), MATCH_MAX_COUNT,
-				args->lockout_time);
-
 		// Only do the lockout if something isn't wrong.
 		if (catcierge_check_max_consecutive_lockouts(grb))
 		{
@@ -1098,10 +1833,32 @@ void catcierge_decide_lock_status(catcierge_grb_t *grb)
 		{
 			catcierge_state_transition_lockout(grb);
 		}
+
+		CATLOG("Lockout! %d out of %d matches failed (for %d seconds).\n",
+				(match_count - mg->success_count), match_count,
+				args->lockout_time);
 	}
 
 	catcierge_match_group_end(mg);
 
+	if (grb->journal.f)
+	{
+		catcierge_journal_match_group(grb);
+	}
+
+	#ifdef WITH_ZMQ
+	// Before the mosaic, which can take over the frames.
+	if (args->zmq_images && grb->publisher.running)
+	{
+		catcierge_publish_match_group(grb);
+	}
+	#endif
+
+	if (args->mosaic_path)
+	{
+		catcierge_mosaic_match_group(grb);
+	}
+
 	// Now we can save the images that we cached earlier 
 	// without slowing down the matching FPS.
 	if (args->saveimg)
@@ -1111,6 +1868,9 @@ void catcierge_decide_lock_status(catcierge_grb_t *grb)
 
 	catcierge_trigger_event(grb, CATCIERGE_MATCH_GROUP_DONE, 1);
 
+	// In case there was no actuation.
+	catcierge_timer_reset(&grb->actuation_timer);
+
 	assert(mg->match_count <= MATCH_MAX_COUNT);
 }
 
@@ -1152,7 +1912,8 @@ void catcierge_save_obstruct_image(catcierge_grb_t *grb)
 
 		snprintf(mg->obstruct_path.dir, sizeof(mg->obstruct_path.dir) - 1, "%s", gen_output_path);
 		snprintf(mg->obstruct_path.filename, sizeof(mg->obstruct_path.filename) - 1,
-			"match_obstruct_%s.png", time_str);
+			"match_obstruct_%s.%s", time_str,
+			catcierge_image_format_ext(args->image_format, mg->obstruct_img->nChannels));
 
 		snprintf(mg->obstruct_path.full, sizeof(mg->obstruct_path.full) - 1, "%s%s%s",
 				 mg->obstruct_path.dir, catcierge_path_sep(), mg->obstruct_path.filename);
@@ -1164,6 +1925,103 @@ void catcierge_save_obstruct_image(catcierge_grb_t *grb)
 	}
 }
 
+static int catcierge_start_retention(catcierge_grb_t *grb)
+{
+	catcierge_args_t *args = &grb->args;
+	catcierge_retention_settings_t settings;
+	catcierge_output_template_t *t;
+	char *pattern;
+	const char *paths[CATCIERGE_RETAIN_CLASS_COUNT];
+	size_t i;
+	int ret = 0;
+
+	memset(&settings, 0, sizeof(settings));
+	settings.interval = args->retention_interval;
+	settings.recompress_age = args->recompress_age;
+	settings.idle_time = args->idle_time;
+	memcpy(settings.quotas, args->retention_quotas, sizeof(settings.quotas));
+
+	paths[CATCIERGE_RETAIN_MATCH] = args->match_output_path;
+	paths[CATCIERGE_RETAIN_STEPS] = args->steps_output_path;
+	paths[CATCIERGE_RETAIN_OBSTRUCT] = args->obstruct_output_path;
+	paths[CATCIERGE_RETAIN_TEMPLATES] = args->template_output_path;
+
+	for (i = 0; i < CATCIERGE_RETAIN_CLASS_COUNT; i++)
+	{
+		if (!(settings.roots[i] = catcierge_retention_root(
+				paths[i] ? paths[i] : args->output_path, args->output_path)))
+		{
+			ret = -1; goto fail;
+		}
+	}
+
+	for (i = 0; i < grb->output.template_count; i++)
+	{
+		t = &grb->output.templates[i];
+
+		if (t->settings.nofile
+			|| (settings.template_pattern_count == CATCIERGE_RETENTION_MAX_PATTERNS))
+		{
+			continue;
+		}
+
+		if (!(pattern = catcierge_retention_pattern(t->settings.filename)))
+		{
+			CATERR("Template file name \"%s\" is too generic for --retention, "
+				"its files are never removed\n", t->settings.filename);
+			continue;
+		}
+
+		settings.template_patterns[settings.template_pattern_count++] = pattern;
+	}
+
+	if (catcierge_retention_init(&grb->retention, &settings)
+		|| catcierge_retention_start(&grb->retention))
+	{
+		catcierge_retention_destroy(&grb->retention);
+		ret = -1; goto fail;
+	}
+
+fail:
+	catcierge_retention_settings_free(&settings);
+	return ret;
+}
+
+static int catcierge_start_notify(catcierge_grb_t *grb)
+{
+	catcierge_args_t *args = &grb->args;
+	catcierge_notify_settings_t settings;
+
+	// The strings are copied by catcierge_notify_init.
+	memset(&settings, 0, sizeof(settings));
+	settings.window = args->notify_window;
+	settings.interval = args->notify_interval;
+	settings.timeout = DEFAULT_NOTIFY_TIMEOUT;
+	settings.from = args->notify_from;
+	settings.subject = args->notify_subject;
+	settings.target_count = args->notify_count;
+	memcpy(settings.targets, args->notify_targets,
+		args->notify_count * sizeof(catcierge_notify_target_t));
+
+	return catcierge_notify_init(&grb->notify, &settings);
+}
+
+static int catcierge_start_event_bus(catcierge_grb_t *grb)
+{
+	#ifdef WITH_ZMQ
+	// The worker can only publish through the publisher thread,
+	// the ZMQ socket itself belongs to the FSM thread.
+	if (grb->args.zmq && !grb->publisher.running)
+	{
+		CATERR("ZMQ publisher thread is not running\n");
+		return -1;
+	}
+	#endif
+
+	return catcierge_event_bus_init(&grb->event_bus, grb,
+			grb->args.event_queue_size, grb->args.event_queue_timeout);
+}
+
 void catcierge_fsm_start(catcierge_grb_t *grb)
 {
 	grb->running = 1;
@@ -1171,12 +2029,68 @@ void catcierge_fsm_start(catcierge_grb_t *grb)
 	catcierge_timer_set(&grb->frame_timer, 1.0);
 	catcierge_timer_set(&grb->startup_timer, grb->args.startup_delay);
 	catcierge_timer_start(&grb->startup_timer);
+
+	if (grb->args.async_events && catcierge_start_event_bus(grb))
+	{
+		CATERR("Failed to start event worker, running events synchronously\n");
+	}
+
+	if (grb->args.staging
+		&& catcierge_staging_init(&grb->staging,
+			(size_t)grb->args.staging_size * 1024 * 1024,
+			grb->args.flush_interval, grb->args.flush_fsync))
+	{
+		CATERR("Failed to start staging flusher, writing files directly\n");
+	}
+
+	if (grb->args.saveimg && !grb->args.sync_save
+		&& catcierge_image_writer_init(&grb->image_writer, grb->args.image_queue_size,
+			grb->args.image_format, grb->args.png_compression))
+	{
+		CATERR("Failed to start image writer, saving images synchronously\n");
+	}
+
+	// Set before any image is queued.
+	grb->image_writer.staging = &grb->staging;
+
+	if ((grb->args.retention_count || grb->args.recompress_age)
+		&& catcierge_start_retention(grb))
+	{
+		CATERR("Failed to start retention, the output directories will not be cleaned up\n");
+	}
+
+	if (grb->args.journal_path
+		&& catcierge_journal_open(&grb->journal, grb->args.journal_path))
+	{
+		CATERR("Failed to open journal, match groups will not be recorded\n");
+	}
+
+	if (grb->args.mosaic_path
+		&& catcierge_mosaic_init(&grb->mosaic, grb->args.mosaic_width))
+	{
+		CATERR("Failed to start mosaic thread, composing mosaics synchronously\n");
+	}
+
+	if (grb->args.frame_ring
+		&& catcierge_frame_ring_init(&grb->frame_ring,
+			grb->args.frame_ring, grb->args.frame_ring_slots))
+	{
+		CATERR("Failed to set up the frame ring, frames will not be shared\n");
+	}
+
+	if (grb->args.notify_count && catcierge_start_notify(grb))
+	{
+		CATERR("Failed to start notifications, none will be sent\n");
+	}
 }
 
 #ifdef WITH_ZMQ
 
 void catcierge_zmq_destroy(catcierge_grb_t *grb)
 {
+	// Sends what is queued before the socket goes away.
+	catcierge_publisher_destroy(&grb->publisher);
+
 	if (grb->zmq_ctx && grb->zmq_pub)
 	{
 		zsocket_destroy(grb->zmq_ctx, grb->zmq_pub);
@@ -1212,6 +2126,9 @@ int catcierge_zmq_init(catcierge_grb_t *grb)
 		goto fail;
 	}
 
+	// Only applies to subscribers connecting after it is set.
+	zmq_setsockopt(grb->zmq_pub, ZMQ_SNDHWM, &args->zmq_hwm, sizeof(args->zmq_hwm));
+
 	if (zsocket_bind(grb->zmq_pub, "%s://%s:%d",
 		args->zmq_transport, args->zmq_iface, args->zmq_port) < 0)
 	{
@@ -1223,6 +2140,13 @@ int catcierge_zmq_init(catcierge_grb_t *grb)
 	CATLOG("ZMQ publish to %s://%s:%d\n",
 			args->zmq_transport, args->zmq_iface, args->zmq_port);
 
+	if (catcierge_publisher_init(&grb->publisher, grb->zmq_pub,
+			args->zmq_hwm, args->zmq_images))
+	{
+		CATERR("Failed to start ZMQ publisher thread, publishing synchronously "
+			"without images\n");
+	}
+
 	return 0;
 
 fail:
@@ -1352,8 +2276,16 @@ int catcierge_state_lockout(catcierge_grb_t *grb)
 void catcierge_state_transition_lockout(catcierge_grb_t *grb)
 {
 	catcierge_args_t *args;
+	int deferred = 0;
 	assert(grb);
 	args = &grb->args;
+
+	// Lock the door first, everything else can wait.
+	if (!args->lockout_dummy)
+	{
+		deferred = catcierge_actuate_lock(grb, 1);
+	}
+
 	catcierge_timer_reset(&grb->lockout_timer);
 	assert((args->lockout_method >= TIMER_ONLY_1) && (args->lockout_method <= OBSTRUCT_OR_TIMER_3));
 
@@ -1376,40 +2308,248 @@ void catcierge_state_transition_lockout(catcierge_grb_t *grb)
 	}
 
 	catcierge_set_state(grb, catcierge_state_lockout);
-	catcierge_do_lockout(grb);
+
+	if (args->lockout_dummy)
+	{
+		CATLOGFPS("!LOCKOUT DUMMY!\n");
+	}
+	else
+	{
+		catcierge_lock_event(grb, 1, deferred);
+	}
+}
+
+// Collects a burst of frames and picks the best one to match.
+// Returns 1 and sets img when there is a frame to match, 0 when
+// more frames are needed.
+static int catcierge_burst_select(catcierge_grb_t *grb, IplImage **img)
+{
+	catcierge_args_t *args = &grb->args;
+	catcierge_frame_burst_t *b = &grb->burst;
+	int ret;
+
+	*img = grb->img;
+
+	if (args->burst <= 1)
+	{
+		return 1;
+	}
+
+	if (b->size != args->burst)
+	{
+		catcierge_frame_burst_destroy(b);
+
+		if (catcierge_frame_burst_init(b, args->burst))
+		{
+			return -1;
+		}
+	}
+
+	if ((ret = catcierge_frame_burst_add(b, grb->img)) < 0)
+	{
+		CATERR("Failed to score frame quality\n");
+		return -1;
+	}
+
+	if (ret == 0)
+	{
+		return 0;
+	}
+
+	CATLOG("Picked frame %d of %d (sharpness %0.1f, exposure %0.2f)\n",
+		b->best_index + 1, b->count, b->best_score.sharpness, b->best_score.exposure);
+
+	grb->match_group.skipped_frames += (b->count - 1);
+	catcierge_frame_burst_reset(b);
+	*img = b->best;
+
+	return 1;
+}
+
+// Makes room for a new match by dropping the oldest one.
+// Only the latest MATCH_MAX_COUNT matches are kept around for
+// saving and output, the decision is based on the match window.
+static void catcierge_match_group_drop_oldest(catcierge_grb_t *grb)
+{
+	match_group_t *mg = &grb->match_group;
+	match_state_t *last;
+	int j;
+
+	if (mg->matches[0].img)
+	{
+		cvReleaseImage(&mg->matches[0].img);
+	}
+
+	catcierge_cleanup_match_steps(grb, &mg->matches[0].result);
+
+	memmove(&mg->matches[0], &mg->matches[1],
+		(MATCH_MAX_COUNT - 1) * sizeof(match_state_t));
+
+	// The images are now owned by the previous slot.
+	last = &mg->matches[MATCH_MAX_COUNT - 1];
+	last->img = NULL;
+
+	for (j = 0; j < MAX_STEPS; j++)
+	{
+		last->result.steps[j].img = NULL;
+	}
+
+	last->result.step_img_count = 0;
+	mg->match_count--;
+}
+
+static int catcierge_state_matching_streaming(catcierge_grb_t *grb)
+{
+	catcierge_args_t *args = &grb->args;
+	match_group_t *mg = &grb->match_group;
+	catcierge_match_window_t *w = &grb->match_window;
+	IplImage *img = NULL;
+	int frame_obstructed;
+	int ret;
+
+	if ((frame_obstructed = grb->matcher->is_obstructed(grb->matcher, grb->img)) < 0)
+	{
+		CATERR("Failed to run check for obstructed frame\n");
+		return -1;
+	}
+
+	// The cat has passed, decide based on what we last saw.
+	if (!frame_obstructed && (w->count > 0))
+	{
+		CATLOG("Frame is clear, deciding on the last %d of %d matches\n",
+			(int)w->count, (int)w->total);
+		catcierge_decide_lock_status(grb);
+		return 0;
+	}
+
+	if ((ret = catcierge_burst_select(grb, &img)) <= 0)
+	{
+		return ret;
+	}
+
+	if (mg->match_count == MATCH_MAX_COUNT)
+	{
+		catcierge_match_group_drop_oldest(grb);
+	}
+
+	mg->match_count++;
+
+	if (catcierge_do_match(grb, img) < 0)
+	{
+		CATERR("Error when matching frame!\n"); return -1;
+	}
+
+	catcierge_record_match_result(grb, img);
+	catcierge_finish_match_result(grb);
+
+	catcierge_match_window_push(w, &mg->matches[mg->match_count - 1].result);
+
+	catcierge_trigger_event(grb, CATCIERGE_MATCH_DONE, 1);
+
+	catcierge_show_image(grb);
+
+	// Lock as soon as the latest matches fail, no need to wait
+	// for the cat to pass. A window that still looks successful
+	// is decided once the frame clears.
+	if (catcierge_match_window_is_full(w)
+		&& (w->success_count < args->ok_matches_needed))
+	{
+		match_direction_t dir = catcierge_uses_success_direction(args)
+			? catcierge_match_window_success_direction(w)
+			: catcierge_match_window_direction(w);
+
+		if (dir != MATCH_DIR_OUT)
+		{
+			catcierge_decide_lock_status(grb);
+		}
+	}
+
+	return 0;
 }
 
 int catcierge_state_matching(catcierge_grb_t *grb)
 {
 	catcierge_args_t *args;
 	match_group_t *mg = &grb->match_group;
+	IplImage *img = NULL;
+	int ret;
 	assert(grb);
 	args = &grb->args;
 
+	if (args->streaming)
+	{
+		return catcierge_state_matching_streaming(grb);
+	}
+
+	if ((ret = catcierge_burst_select(grb, &img)) <= 0)
+	{
+		return ret;
+	}
+
 	grb->match_group.match_count++;
 
 	// We have something to match against.
-	if (catcierge_do_match(grb) < 0)
+	if (catcierge_do_match(grb, img) < 0)
 	{
 		CATERR("Error when matching frame!\n"); return -1;
 	}
 
-	catcierge_process_match_result(grb, grb->img);
+	catcierge_record_match_result(grb, img);
 
-	catcierge_trigger_event(grb, CATCIERGE_MATCH_DONE, 1);
+	// Batched results are finished when the group is decided.
+	if (!grb->matcher->group_match)
+	{
+		catcierge_finish_match_result(grb);
+		catcierge_trigger_event(grb, CATCIERGE_MATCH_DONE, 1);
+	}
 
 	catcierge_show_image(grb);
 
 	if (mg->match_count < MATCH_MAX_COUNT)
 	{
-		// Continue until we have enough matches for a decision.
-		return 0;
+		if (!args->early_decision || !catcierge_match_group_is_decided(grb))
+		{
+			// Continue until we have enough matches for a decision.
+			return 0;
+		}
+
+		mg->early_decision = 1;
+		CATLOG("Early decision after %d of %d matches\n",
+			(int)mg->match_count, MATCH_MAX_COUNT);
 	}
-	else
+
+	catcierge_decide_lock_status(grb);
+
+	return 0;
+}
+
+static int catcierge_stream_start(catcierge_grb_t *grb)
+{
+	catcierge_args_t *args = &grb->args;
+	catcierge_match_window_t *w = &grb->match_window;
+
+	// Streaming needs a result for each frame as it is matched,
+	// batching is turned off when the arguments are parsed.
+	if (grb->matcher->group_match)
 	{
-		catcierge_decide_lock_status(grb);
+		CATERR("%s matcher: Cannot batch matches in streaming mode\n",
+			grb->matcher->name);
+		return -1;
+	}
+
+	if (w->size != (size_t)args->stream_window)
+	{
+		catcierge_match_window_destroy(w);
+
+		if (catcierge_match_window_init(w, args->stream_window))
+		{
+			CATERR("Failed to create match window\n");
+			return -1;
+		}
 	}
 
+	catcierge_match_window_reset(w);
+
 	return 0;
 }
 
@@ -1463,12 +2603,20 @@ int catcierge_state_waiting(catcierge_grb_t *grb)
 		CATLOG("Something in frame! Start matching...\n");
 
 		catcierge_match_group_start(mg, grb->img);
+		catcierge_frame_burst_reset(&grb->burst);
+		catcierge_match_cache_reset(&grb->match_cache);
+
+		if (args->streaming && catcierge_stream_start(grb))
+		{
+			grb->running = 0; return -1;
+		}
 
 		// Save the obstruct image.
 		catcierge_save_obstruct_image(grb);
 
 		catcierge_trigger_event(grb, CATCIERGE_FRAME_OBSTRUCTED, 1);
 
+		catcierge_retention_activity(&grb->retention);
 		catcierge_set_state(grb, catcierge_state_matching);
 	}
 
@@ -1549,5 +2697,23 @@ void catcierge_grabber_destroy(catcierge_grb_t *grb)
 	// Always make sure we unlock.
 	catcierge_do_unlock(grb);
 	catcierge_cleanup_imgs(grb);
+	catcierge_match_window_destroy(&grb->match_window);
+	catcierge_frame_burst_destroy(&grb->burst);
+	catcierge_match_cache_destroy(&grb->match_cache);
+	catcierge_image_writer_destroy(&grb->image_writer);
+	catcierge_mosaic_destroy(&grb->mosaic);
+	catcierge_notify_destroy(&grb->notify);
+	catcierge_frame_ring_destroy(&grb->frame_ring);
+	catcierge_archive_close(&grb->archive);
+	catcierge_retention_destroy(&grb->retention);
+	catcierge_journal_close(&grb->journal);
+	catcierge_event_bus_destroy(&grb->event_bus);
+	catcierge_staging_destroy(&grb->staging);
+	catcierge_executor_destroy(&grb->executor);
 	cvDestroyAllWindows();
+
+	#ifdef RPI
+	gpio_line_close(&grb->lockout_line);
+	gpio_line_close(&grb->backlight_line);
+	#endif
 }
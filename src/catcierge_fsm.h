@@ -29,6 +29,17 @@
 #include "catcierge_timer.h"
 #include "catcierge_args.h"
 #include "catcierge_types.h"
+#include "catcierge_match_window.h"
+#include "catcierge_frame_quality.h"
+#include "catcierge_match_cache.h"
+#include "catcierge_executor.h"
+#include "catcierge_event_bus.h"
+#include "catcierge_image_writer.h"
+#include "catcierge_journal.h"
+#include "catcierge_mosaic.h"
+#include "catcierge_notify.h"
+#include "catcierge_publisher.h"
+#include "catcierge_frame_ring.h"
 #include "catcierge_output_types.h"
 
 #ifdef RPI
@@ -58,8 +69,6 @@ typedef struct rfid_match_s
 #define CATLOGFPS(fmt, ...) CATLOG(fmt, ##__VA_ARGS__)
 #define CATERRFPS(fmt, ...) CATLOG(fmt, ##__VA_ARGS__)
 
-#define MATCH_MAX_COUNT 4 // The number of matches to perform before deciding the lock state.
-
 #define FILENAME_TIME_FORMAT "%Y-%m-%d_%H_%M_%S.%f"
 
 struct catcierge_grb_s;
@@ -76,6 +85,8 @@ typedef struct catcierge_grb_s
 
 	#ifdef RPI
 	RaspiCamCvCapture *capture;
+	catcierge_gpio_line_t lockout_line;
+	catcierge_gpio_line_t backlight_line;
 	#else
 	CvCapture *capture;
 	#endif
@@ -89,6 +100,52 @@ typedef struct catcierge_grb_s
 	// Consecutive matches decides lockout status.
 	match_group_t match_group;
 
+	// The latest match results when in streaming mode.
+	catcierge_match_window_t match_window;
+
+	// Picks the best frame to match out of each burst (--burst).
+	catcierge_frame_burst_t burst;
+
+	// Result of the last matched frame, reused for near identical frames.
+	catcierge_match_cache_t match_cache;
+
+	// Time from the lock decision until the door was locked/unlocked.
+	catcierge_timer_t actuation_timer;
+	double actuation_latency;
+
+	// Runs the event commands.
+	catcierge_executor_t executor;
+
+	// Renders templates and runs commands for events off the FSM thread (--async_events).
+	catcierge_event_bus_t event_bus;
+
+	// Writes the match images off the FSM thread (unless --sync_save).
+	catcierge_image_writer_t image_writer;
+
+	// Match groups saved as single records (--archive). Only used
+	// by the image writer thread while it is running.
+	catcierge_archive_t archive;
+
+	// Saved images and templates are kept in RAM and flushed
+	// to disk in batches (--staging). The output contexts refer
+	// to it by pointer, so the event worker shares it.
+	catcierge_staging_t staging;
+
+	// Keeps the output directories within their quotas (--retention).
+	catcierge_retention_t retention;
+
+	// A record of each match group decision (--journal).
+	catcierge_journal_t journal;
+
+	// Composes the match group summary image off the FSM thread (--mosaic).
+	catcierge_mosaic_t mosaic;
+
+	// Batches events into notifications sent by a worker thread (--notify).
+	catcierge_notify_t notify;
+
+	// Captured frames shared with local processes (--frame_ring).
+	catcierge_frame_ring_t frame_ring;
+
 	catcierge_timer_t rematch_timer;
 	catcierge_timer_t lockout_timer;
 	catcierge_timer_t frame_timer;
@@ -117,6 +174,10 @@ typedef struct catcierge_grb_s
 	#ifdef WITH_ZMQ
 	zctx_t *zmq_ctx;
 	void *zmq_pub;	// ZMQ publisher.
+
+	// Owns zmq_pub while running (--zmq_hwm, --zmq_images). The output
+	// contexts refer to it by pointer, so the event worker publishes through it.
+	catcierge_publisher_t publisher;
 	#endif // WITH_ZMQ
 } catcierge_grb_t;
 
@@ -29,9 +29,22 @@
 #include <fcntl.h>
 #endif
 
+#ifdef CATCIERGE_HAVE_LINUX_GPIO_H
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+#endif
+
 #include <string.h>
 #include "catcierge_util.h"
 #include "catcierge_log.h"
+#include "catcierge_gpio.h"
+
+static const char *gpio_sysfs_root = CATCIERGE_GPIO_SYSFS_ROOT;
+
+void gpio_set_sysfs_root(const char *root)
+{
+	gpio_sysfs_root = root ? root : CATCIERGE_GPIO_SYSFS_ROOT;
+}
 
 static int write_num_to_file(const char *path, int num)
 {
@@ -60,7 +73,10 @@ static int write_num_to_file(const char *path, int num)
 
 int gpio_export(int pin)
 {
-	if (write_num_to_file("/sys/class/gpio/export", pin))
+	char path[256];
+	snprintf(path, sizeof(path), "%s/export", gpio_sysfs_root);
+
+	if (write_num_to_file(path, pin))
 	{
 		CATERR("Failed to open GPIO export for writing\n");
 		return -1;
@@ -75,7 +91,7 @@ int gpio_set_direction(int pin, int direction)
 	int fd;
 	char *str;
 	char path[256];
-	snprintf(path, sizeof(path), "/sys/class/gpio/gpio%d/direction", pin);
+	snprintf(path, sizeof(path), "%s/gpio%d/direction", gpio_sysfs_root, pin);
 
 	if ((fd = open(path, O_WRONLY)) < 0)
 	{
@@ -100,7 +116,7 @@ int gpio_write(int pin, int val)
 {
 	char path[256];
 
-	snprintf(path, sizeof(path), "/sys/class/gpio/gpio%d/value", pin);
+	snprintf(path, sizeof(path), "%s/gpio%d/value", gpio_sysfs_root, pin);
 
 	if (write_num_to_file(path, val))
 	{
@@ -111,3 +127,180 @@ int gpio_write(int pin, int val)
 	return 0;
 }
 
+
+const char *gpio_backend_str(catcierge_gpio_backend_t backend)
+{
+	switch (backend)
+	{
+		case GPIO_BACKEND_LEGACY: return "legacy";
+		case GPIO_BACKEND_SYSFS: return "sysfs";
+		case GPIO_BACKEND_CHARDEV: return "chardev";
+		case GPIO_BACKEND_FAKE: return "fake";
+	}
+
+	return "unknown";
+}
+
+int gpio_backend_parse(const char *str, catcierge_gpio_backend_t *backend)
+{
+	if (!strcmp(str, "legacy")) *backend = GPIO_BACKEND_LEGACY;
+	else if (!strcmp(str, "sysfs")) *backend = GPIO_BACKEND_SYSFS;
+	else if (!strcmp(str, "chardev")) *backend = GPIO_BACKEND_CHARDEV;
+	else if (!strcmp(str, "fake")) *backend = GPIO_BACKEND_FAKE;
+	else return -1;
+
+	return 0;
+}
+
+static int gpio_line_open_sysfs(catcierge_gpio_line_t *line)
+{
+	char path[256];
+
+	snprintf(path, sizeof(path), "%s/gpio%d/value", gpio_sysfs_root, line->pin);
+
+	if ((line->fd = open(path, O_WRONLY)) < 0)
+	{
+		CATERR("Failed to open \"%s\"\n", path);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int gpio_line_open_chardev(catcierge_gpio_line_t *line, const char *chip)
+{
+	#ifdef CATCIERGE_HAVE_LINUX_GPIO_H
+	int chip_fd;
+	struct gpiohandle_request req;
+
+	if (!chip)
+		chip = CATCIERGE_GPIO_DEFAULT_CHIP;
+
+	if ((chip_fd = open(chip, O_RDONLY)) < 0)
+	{
+		CATERR("Failed to open GPIO chip \"%s\"\n", chip);
+		return -1;
+	}
+
+	memset(&req, 0, sizeof(req));
+	req.lineoffsets[0] = line->pin;
+	req.flags = GPIOHANDLE_REQUEST_OUTPUT;
+	req.default_values[0] = line->value;
+	req.lines = 1;
+	snprintf(req.consumer_label, sizeof(req.consumer_label), "catcierge");
+
+	if (ioctl(chip_fd, GPIO_GET_LINEHANDLE_IOCTL, &req) < 0)
+	{
+		CATERR("Failed to request GPIO line %d on \"%s\"\n", line->pin, chip);
+		close(chip_fd);
+		return -1;
+	}
+
+	// The line handle stays valid after the chip is closed.
+	close(chip_fd);
+	line->fd = req.fd;
+
+	return 0;
+	#else
+	CATERR("GPIO character device support not compiled\n");
+	return -1;
+	#endif
+}
+
+int gpio_line_open(catcierge_gpio_line_t *line, catcierge_gpio_backend_t backend,
+					const char *chip, int pin, int value)
+{
+	int ret = 0;
+
+	memset(line, 0, sizeof(catcierge_gpio_line_t));
+	line->backend = backend;
+	line->pin = pin;
+	line->fd = -1;
+	line->value = !!value;
+
+	switch (backend)
+	{
+		case GPIO_BACKEND_LEGACY:
+		case GPIO_BACKEND_FAKE:
+			break;
+		case GPIO_BACKEND_SYSFS:
+			ret = gpio_line_open_sysfs(line);
+			break;
+		case GPIO_BACKEND_CHARDEV:
+			// The initial value is set when requesting the line.
+			return gpio_line_open_chardev(line, chip);
+	}
+
+	if (ret)
+	{
+		return ret;
+	}
+
+	// Make the initial value the same for all backends.
+	if (gpio_line_write(line, line->value))
+	{
+		gpio_line_close(line);
+		return -1;
+	}
+
+	return 0;
+}
+
+int gpio_line_write(catcierge_gpio_line_t *line, int val)
+{
+	val = !!val;
+
+	switch (line->backend)
+	{
+		case GPIO_BACKEND_LEGACY:
+		{
+			if (gpio_write(line->pin, val))
+				return -1;
+			break;
+		}
+		case GPIO_BACKEND_SYSFS:
+		{
+			// A single syscall, sysfs always reads the value from offset 0.
+			if (pwrite(line->fd, val ? "1" : "0", 1, 0) != 1)
+			{
+				CATERR("Failed to write %d to GPIO %d\n", val, line->pin);
+				return -1;
+			}
+			break;
+		}
+		case GPIO_BACKEND_CHARDEV:
+		{
+			#ifdef CATCIERGE_HAVE_LINUX_GPIO_H
+			struct gpiohandle_data data;
+			memset(&data, 0, sizeof(data));
+			data.values[0] = val;
+
+			if (ioctl(line->fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data) < 0)
+			{
+				CATERR("Failed to write %d to GPIO %d\n", val, line->pin);
+				return -1;
+			}
+			#endif
+			break;
+		}
+		case GPIO_BACKEND_FAKE:
+			break;
+	}
+
+	line->value = val;
+	line->write_count++;
+
+	return 0;
+}
+
+void gpio_line_close(catcierge_gpio_line_t *line)
+{
+	if (((line->backend == GPIO_BACKEND_SYSFS)
+	  || (line->backend == GPIO_BACKEND_CHARDEV))
+	  && (line->fd >= 0))
+	{
+		close(line->fd);
+		line->fd = -1;
+	}
+}
+
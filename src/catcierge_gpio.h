@@ -22,8 +22,47 @@
 #define IN 1
 #define OUT 0
 
+#define CATCIERGE_GPIO_SYSFS_ROOT "/sys/class/gpio"
+#define CATCIERGE_GPIO_DEFAULT_CHIP "/dev/gpiochip0"
+
+// Only changed for tests and benchmarks, where a directory
+// with gpioN/value files stands in for the real GPIO chip.
+void gpio_set_sysfs_root(const char *root);
+
 int gpio_export(int pin);
 int gpio_set_direction(int pin, int direction);
 int gpio_write(int pin, int val);
 
+typedef enum catcierge_gpio_backend_e
+{
+	GPIO_BACKEND_LEGACY,	// Open, write and close the sysfs value file for each write.
+	GPIO_BACKEND_SYSFS,		// Keep the sysfs value file open.
+	GPIO_BACKEND_CHARDEV,	// Line handle requested from /dev/gpiochipN.
+	GPIO_BACKEND_FAKE		// Only keeps the value in memory (for tests).
+} catcierge_gpio_backend_t;
+
+//
+// A GPIO line that is requested once at startup, so that each
+// write after that is a single syscall.
+//
+typedef struct catcierge_gpio_line_s
+{
+	catcierge_gpio_backend_t backend;
+	int pin;
+	int fd;
+	int value;
+	unsigned long write_count;
+} catcierge_gpio_line_t;
+
+// For GPIO_BACKEND_SYSFS the pin must already be exported.
+// For GPIO_BACKEND_CHARDEV chip is the gpiochip device (NULL for the
+// default) and pin is the line offset on that chip.
+int gpio_line_open(catcierge_gpio_line_t *line, catcierge_gpio_backend_t backend,
+					const char *chip, int pin, int value);
+int gpio_line_write(catcierge_gpio_line_t *line, int val);
+void gpio_line_close(catcierge_gpio_line_t *line);
+
+const char *gpio_backend_str(catcierge_gpio_backend_t backend);
+int gpio_backend_parse(const char *str, catcierge_gpio_backend_t *backend);
+
 #endif // __CATCIERGE_GPIO_H__
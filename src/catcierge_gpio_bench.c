@@ -0,0 +1,185 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "catcierge_config.h"
+#include "catcierge_gpio.h"
+#include "catcierge_timer.h"
+#include "catcierge_log.h"
+#include "cargo.h"
+
+//
+// Measures the time it takes to toggle a GPIO pin with the different
+// GPIO backends. By default a fake GPIO directory is created in /tmp,
+// so this can be run without root. Use --real to benchmark the real
+// GPIO pins on a Raspberry Pi.
+//
+
+typedef struct gpio_bench_ctx_s
+{
+	int pin;
+	int iterations;
+	int real;
+	char *chip;
+	char fake_root[64];
+} gpio_bench_ctx_t;
+
+static int create_fake_chip(gpio_bench_ctx_t *ctx)
+{
+	char path[512];
+	FILE *f;
+
+	snprintf(ctx->fake_root, sizeof(ctx->fake_root), "/tmp/catcierge_gpio_XXXXXX");
+
+	if (!mkdtemp(ctx->fake_root))
+		return -1;
+
+	snprintf(path, sizeof(path), "%s/gpio%d", ctx->fake_root, ctx->pin);
+	if (mkdir(path, 0700))
+		return -1;
+
+	snprintf(path, sizeof(path), "%s/gpio%d/value", ctx->fake_root, ctx->pin);
+	if (!(f = fopen(path, "w")))
+		return -1;
+	fclose(f);
+
+	gpio_set_sysfs_root(ctx->fake_root);
+
+	return 0;
+}
+
+static void destroy_fake_chip(gpio_bench_ctx_t *ctx)
+{
+	char path[512];
+
+	snprintf(path, sizeof(path), "%s/gpio%d/value", ctx->fake_root, ctx->pin);
+	remove(path);
+	snprintf(path, sizeof(path), "%s/gpio%d", ctx->fake_root, ctx->pin);
+	remove(path);
+	remove(ctx->fake_root);
+}
+
+static int run_bench(gpio_bench_ctx_t *ctx, catcierge_gpio_backend_t backend)
+{
+	int i;
+	double total;
+	catcierge_gpio_line_t line;
+	catcierge_timer_t t;
+
+	if (gpio_line_open(&line, backend, ctx->chip, ctx->pin, 0))
+	{
+		fprintf(stderr, "%-8s: Failed to open GPIO %d\n", gpio_backend_str(backend), ctx->pin);
+		return -1;
+	}
+
+	catcierge_timer_reset(&t);
+	catcierge_timer_start(&t);
+
+	for (i = 0; i < ctx->iterations; i++)
+	{
+		if (gpio_line_write(&line, i & 1))
+		{
+			gpio_line_close(&line);
+			return -1;
+		}
+	}
+
+	total = catcierge_timer_get(&t);
+	gpio_line_close(&line);
+
+	printf("%-8s: %d writes in %0.3f ms, %0.3f us per write\n",
+		gpio_backend_str(backend), ctx->iterations, total * 1000.0,
+		(total * 1000000.0) / ctx->iterations);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int ret = 0;
+	cargo_t cargo;
+	gpio_bench_ctx_t ctx;
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.pin = CATCIERGE_LOCKOUT_GPIO;
+	ctx.iterations = 1000;
+
+	if (cargo_init(&cargo, 0, "%s", argv[0]))
+	{
+		fprintf(stderr, "Failed to init command line parsing\n");
+		return -1;
+	}
+
+	cargo_set_description(cargo,
+		"Benchmarks the GPIO write latency for the different GPIO backends.");
+
+	ret |= cargo_add_option(cargo, 0, "--pin", "GPIO pin (line offset for chardev).",
+			"i", &ctx.pin);
+	ret |= cargo_add_option(cargo, 0, "--iterations", "Number of writes per backend.",
+			"i", &ctx.iterations);
+	ret |= cargo_add_option(cargo, 0, "--real",
+			"Use the real GPIO pins instead of a fake GPIO directory. "
+			"The pin must be exported for the sysfs backends.",
+			"b", &ctx.real);
+	ret |= cargo_add_option(cargo, 0, "--chip",
+			"GPIO character device to benchmark (only with --real).",
+			"s", &ctx.chip);
+	ret |= cargo_add_validation(cargo, 0, "--iterations",
+			cargo_validate_int_range(1, 10000000));
+
+	if (ret)
+	{
+		fprintf(stderr, "Failed to add command line options\n");
+		ret = -1; goto fail;
+	}
+
+	if (cargo_parse(cargo, 0, 1, argc, argv))
+	{
+		ret = -1; goto fail;
+	}
+
+	if (!ctx.real && create_fake_chip(&ctx))
+	{
+		fprintf(stderr, "Failed to create fake GPIO directory\n");
+		ret = -1; goto fail;
+	}
+
+	ret |= run_bench(&ctx, GPIO_BACKEND_LEGACY);
+	ret |= run_bench(&ctx, GPIO_BACKEND_SYSFS);
+
+	if (ctx.real)
+	{
+		ret |= run_bench(&ctx, GPIO_BACKEND_CHARDEV);
+	}
+	else
+	{
+		destroy_fake_chip(&ctx);
+	}
+
+fail:
+	if (ctx.chip)
+		free(ctx.chip);
+
+	cargo_destroy(&cargo);
+
+	return ret;
+}
@@ -247,7 +247,9 @@ int main(int argc, char **argv)
 	#endif // RPI
 
 	assert((args->matcher_type == MATCHER_TEMPLATE)
-		|| (args->matcher_type == MATCHER_HAAR));
+		|| (args->matcher_type == MATCHER_HAAR)
+		|| (args->matcher_type == MATCHER_CHAIN)
+		|| (args->matcher_type == MATCHER_DNN));
 
 	if (catcierge_matcher_init(&grb.matcher, catcierge_get_matcher_args(args)))
 	{
@@ -314,6 +316,10 @@ int main(int argc, char **argv)
 		#endif
 		);
 
+	// Let the queued images and events finish while
+	// the matcher and ZMQ publisher are still around.
+	catcierge_image_writer_destroy(&grb.image_writer);
+	catcierge_event_bus_destroy(&grb.event_bus);
 	catcierge_matcher_destroy(&grb.matcher);
 	catcierge_output_destroy(&grb.output);
 	catcierge_destroy_camera(&grb);
@@ -89,6 +89,7 @@ int catcierge_haar_matcher_init(catcierge_matcher_t **octx,
 	ctx->super.match = catcierge_haar_matcher_match;
 	ctx->super.decide = catcierge_haar_matcher_decide;
 	ctx->super.translate = catcierge_haar_matcher_translate;
+	ctx->super.var_name = catcierge_haar_matcher_var_name;
 
 	return 0;
 opencv_error:
@@ -858,6 +859,17 @@ const char *catcierge_haar_matcher_prey_method_str(catcierge_haar_prey_method_t
 	}
 }
 
+const char *catcierge_haar_matcher_var_name(catcierge_matcher_t *octx, size_t idx,
+	char *buf, size_t bufsize)
+{
+	if (idx >= sizeof(haar_vars) / sizeof(haar_vars[0]))
+	{
+		return NULL;
+	}
+
+	return haar_vars[idx].name;
+}
+
 const char *catcierge_haar_matcher_translate(catcierge_matcher_t *octx, const char *var,
 	char *buf, size_t bufsize)
 {
@@ -0,0 +1,194 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "catcierge_config.h"
+#include "catcierge_image_format.h"
+#include "catcierge_util.h"
+#include "cargo.h"
+
+//
+// Converts images saved with --image_format qoi or pgm back into png
+// (or between any of the supported formats). The converted image is
+// written next to the original, or to --output, with the extension
+// of the new format.
+//
+
+typedef struct image_convert_ctx_s
+{
+	char **img_paths;
+	size_t img_count;
+	char *format_name;
+	catcierge_image_format_t format;
+	int png_compression;
+	char *output_path;
+	int remove;
+} image_convert_ctx_t;
+
+static int get_output_path(image_convert_ctx_t *ctx, const char *path,
+		int channels, char *buf, size_t bufsize)
+{
+	const char *filename = strrchr(path, '/');
+	const char *ext;
+	size_t dir_len;
+	size_t base_len;
+
+	#ifdef _WIN32
+	if (strrchr(path, '\\') > filename)
+		filename = strrchr(path, '\\');
+	#endif
+
+	filename = filename ? filename + 1 : path;
+	dir_len = filename - path;
+	ext = strrchr(filename, '.');
+	base_len = ext ? (size_t)(ext - filename) : strlen(filename);
+
+	if (ctx->output_path)
+	{
+		return (snprintf(buf, bufsize, "%s%s%.*s.%s",
+			ctx->output_path, catcierge_path_sep(), (int)base_len, filename,
+			catcierge_image_format_ext(ctx->format, channels)) >= (int)bufsize);
+	}
+
+	return (snprintf(buf, bufsize, "%.*s%.*s.%s",
+		(int)dir_len, path, (int)base_len, filename,
+		catcierge_image_format_ext(ctx->format, channels)) >= (int)bufsize);
+}
+
+static int convert_image(image_convert_ctx_t *ctx, const char *path)
+{
+	int ret = 0;
+	IplImage *img = NULL;
+	char out_path[4096];
+
+	if (!(img = catcierge_image_load(path)))
+	{
+		fprintf(stderr, "Failed to load image: %s\n", path);
+		return -1;
+	}
+
+	if (get_output_path(ctx, path, img->nChannels, out_path, sizeof(out_path)))
+	{
+		fprintf(stderr, "Output path too long for: %s\n", path);
+		ret = -1; goto fail;
+	}
+
+	if (!strcmp(out_path, path))
+	{
+		fprintf(stderr, "Skipping %s, already %s\n",
+			path, catcierge_image_format_str(ctx->format));
+		goto fail;
+	}
+
+	if (catcierge_image_save(out_path, img, ctx->format, ctx->png_compression))
+	{
+		fprintf(stderr, "Failed to save image: %s\n", out_path);
+		ret = -1; goto fail;
+	}
+
+	printf("%s -> %s\n", path, out_path);
+
+	if (ctx->remove && remove(path))
+	{
+		fprintf(stderr, "Failed to remove %s\n", path);
+		ret = -1;
+	}
+
+fail:
+	cvReleaseImage(&img);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	int ret = 0;
+	size_t i;
+	cargo_t cargo;
+	image_convert_ctx_t ctx;
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.format = CATCIERGE_IMAGE_PNG;
+	ctx.png_compression = DEFAULT_PNG_COMPRESSION;
+
+	if (cargo_init(&cargo, 0, "%s", argv[0]))
+	{
+		fprintf(stderr, "Failed to init command line parsing\n");
+		return -1;
+	}
+
+	cargo_set_description(cargo,
+		"Converts images saved by catcierge_grabber between the "
+		"png, qoi and pgm image formats.");
+
+	ret |= cargo_add_option(cargo, 0, "images", "Images to convert.",
+			"[s]+", &ctx.img_paths, &ctx.img_count);
+	ret |= cargo_add_option(cargo, 0, "--format",
+			"Format to convert to, \"png\" (default), \"qoi\" or \"pgm\".",
+			"s", &ctx.format_name);
+	ret |= cargo_add_option(cargo, 0, "--png_compression",
+			"The zlib compression level 0-9 for png images.",
+			"i", &ctx.png_compression);
+	ret |= cargo_add_validation(cargo, 0, "--png_compression",
+			cargo_validate_int_range(-1, 9));
+	ret |= cargo_add_option(cargo, 0, "--output",
+			"Directory to write the converted images to, "
+			"instead of next to the original.",
+			"s", &ctx.output_path);
+	ret |= cargo_add_option(cargo, 0, "--remove",
+			"Remove the original image once it has been converted.",
+			"b", &ctx.remove);
+
+	if (ret)
+	{
+		fprintf(stderr, "Failed to add command line options\n");
+		ret = -1; goto fail;
+	}
+
+	if (cargo_parse(cargo, 0, 1, argc, argv))
+	{
+		ret = -1; goto fail;
+	}
+
+	if (ctx.format_name && catcierge_image_format_parse(ctx.format_name, &ctx.format))
+	{
+		fprintf(stderr, "Invalid image format \"%s\", must be \"png\", \"qoi\" or \"pgm\"\n",
+			ctx.format_name);
+		ret = -1; goto fail;
+	}
+
+	if (ctx.output_path && catcierge_make_path("%s", ctx.output_path))
+	{
+		fprintf(stderr, "Failed to create output directory %s\n", ctx.output_path);
+		ret = -1; goto fail;
+	}
+
+	for (i = 0; i < ctx.img_count; i++)
+	{
+		ret |= convert_image(&ctx, ctx.img_paths[i]);
+	}
+
+fail:
+	catcierge_free_list(ctx.img_paths, ctx.img_count);
+	catcierge_xfree(&ctx.format_name);
+	catcierge_xfree(&ctx.output_path);
+	cargo_destroy(&cargo);
+
+	return ret;
+}
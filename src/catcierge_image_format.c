@@ -0,0 +1,659 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "catcierge_image_format.h"
+#include "catcierge_log.h"
+
+#define QOI_OP_INDEX	0x00
+#define QOI_OP_DIFF		0x40
+#define QOI_OP_LUMA		0x80
+#define QOI_OP_RUN		0xc0
+#define QOI_OP_RGB		0xfe
+#define QOI_OP_RGBA		0xff
+#define QOI_MASK_2		0xc0
+#define QOI_HEADER_SIZE	14
+#define QOI_PADDING_SIZE 8
+#define QOI_MAX_PIXELS	400000000
+
+static const unsigned char qoi_padding[QOI_PADDING_SIZE] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+typedef union catcierge_qoi_px_u
+{
+	struct { unsigned char r, g, b, a; } rgba;
+	unsigned int v;
+} catcierge_qoi_px_t;
+
+#define QOI_HASH(px) (((px).rgba.r * 3 + (px).rgba.g * 5 + (px).rgba.b * 7 + (px).rgba.a * 11) % 64)
+
+int catcierge_image_format_parse(const char *name, catcierge_image_format_t *format)
+{
+	assert(name);
+	assert(format);
+
+	if (!strcmp(name, "png"))
+	{
+		*format = CATCIERGE_IMAGE_PNG;
+	}
+	else if (!strcmp(name, "qoi"))
+	{
+		*format = CATCIERGE_IMAGE_QOI;
+	}
+	else if (!strcmp(name, "pgm"))
+	{
+		*format = CATCIERGE_IMAGE_PGM;
+	}
+	else
+	{
+		return -1;
+	}
+
+	return 0;
+}
+
+const char *catcierge_image_format_str(catcierge_image_format_t format)
+{
+	switch (format)
+	{
+		case CATCIERGE_IMAGE_PNG: return "png";
+		case CATCIERGE_IMAGE_QOI: return "qoi";
+		case CATCIERGE_IMAGE_PGM: return "pgm";
+	}
+
+	return "unknown";
+}
+
+const char *catcierge_image_format_ext(catcierge_image_format_t format, int channels)
+{
+	if ((format == CATCIERGE_IMAGE_PGM) && (channels != 1))
+	{
+		return "ppm";
+	}
+
+	return catcierge_image_format_str(format);
+}
+
+static void catcierge_qoi_write_32(unsigned char *bytes, size_t *p, unsigned int v)
+{
+	bytes[(*p)++] = (unsigned char)(v >> 24);
+	bytes[(*p)++] = (unsigned char)(v >> 16);
+	bytes[(*p)++] = (unsigned char)(v >> 8);
+	bytes[(*p)++] = (unsigned char)v;
+}
+
+static unsigned int catcierge_qoi_read_32(const unsigned char *bytes)
+{
+	return ((unsigned int)bytes[0] << 24) | ((unsigned int)bytes[1] << 16)
+		 | ((unsigned int)bytes[2] << 8) | (unsigned int)bytes[3];
+}
+
+unsigned char *catcierge_qoi_encode(const IplImage *img, size_t *len)
+{
+	catcierge_qoi_px_t index[64];
+	catcierge_qoi_px_t px;
+	catcierge_qoi_px_t prev;
+	const unsigned char *row;
+	unsigned char *bytes = NULL;
+	size_t p = 0;
+	size_t max_size;
+	int channels;
+	int run = 0;
+	int x;
+	int y;
+	assert(img);
+	assert(len);
+
+	if ((img->depth != IPL_DEPTH_8U)
+		|| ((img->nChannels != 1) && (img->nChannels != 3) && (img->nChannels != 4)))
+	{
+		CATERR("QOI: Only 8-bit grayscale, BGR or BGRA images are supported\n");
+		return NULL;
+	}
+
+	channels = (img->nChannels == 4) ? 4 : 3;
+	max_size = (size_t)img->width * img->height * (channels + 1)
+			 + QOI_HEADER_SIZE + QOI_PADDING_SIZE;
+
+	if (!(bytes = malloc(max_size)))
+	{
+		CATERR("Out of memory!\n");
+		return NULL;
+	}
+
+	memcpy(bytes, "qoif", 4);
+	p = 4;
+	catcierge_qoi_write_32(bytes, &p, img->width);
+	catcierge_qoi_write_32(bytes, &p, img->height);
+	bytes[p++] = (unsigned char)channels;
+	bytes[p++] = 0; // sRGB with linear alpha.
+
+	memset(index, 0, sizeof(index));
+	prev.v = 0;
+	prev.rgba.a = 255;
+
+	for (y = 0; y < img->height; y++)
+	{
+		row = (const unsigned char *)img->imageData + (y * img->widthStep);
+
+		for (x = 0; x < img->width; x++)
+		{
+			// OpenCV stores the channels as BGR(A).
+			if (img->nChannels == 1)
+			{
+				px.rgba.r = px.rgba.g = px.rgba.b = row[x];
+				px.rgba.a = 255;
+			}
+			else
+			{
+				const unsigned char *c = &row[x * img->nChannels];
+				px.rgba.r = c[2];
+				px.rgba.g = c[1];
+				px.rgba.b = c[0];
+				px.rgba.a = (img->nChannels == 4) ? c[3] : 255;
+			}
+
+			if (px.v == prev.v)
+			{
+				run++;
+
+				if ((run == 62) || ((y == img->height - 1) && (x == img->width - 1)))
+				{
+					bytes[p++] = QOI_OP_RUN | (run - 1);
+					run = 0;
+				}
+
+				continue;
+			}
+
+			if (run > 0)
+			{
+				bytes[p++] = QOI_OP_RUN | (run - 1);
+				run = 0;
+			}
+
+			{
+				int h = QOI_HASH(px);
+
+				if (index[h].v == px.v)
+				{
+					bytes[p++] = QOI_OP_INDEX | h;
+				}
+				else
+				{
+					index[h] = px;
+
+					if (px.rgba.a == prev.rgba.a)
+					{
+						signed char vr = px.rgba.r - prev.rgba.r;
+						signed char vg = px.rgba.g - prev.rgba.g;
+						signed char vb = px.rgba.b - prev.rgba.b;
+						signed char vg_r = vr - vg;
+						signed char vg_b = vb - vg;
+
+						if ((vr > -3) && (vr < 2) && (vg > -3) && (vg < 2) && (vb > -3) && (vb < 2))
+						{
+							bytes[p++] = QOI_OP_DIFF | ((vr + 2) << 4) | ((vg + 2) << 2) | (vb + 2);
+						}
+						else if ((vg_r > -9) && (vg_r < 8) && (vg > -33) && (vg < 32)
+								&& (vg_b > -9) && (vg_b < 8))
+						{
+							bytes[p++] = QOI_OP_LUMA | (vg + 32);
+							bytes[p++] = ((vg_r + 8) << 4) | (vg_b + 8);
+						}
+						else
+						{
+							bytes[p++] = QOI_OP_RGB;
+							bytes[p++] = px.rgba.r;
+							bytes[p++] = px.rgba.g;
+							bytes[p++] = px.rgba.b;
+						}
+					}
+					else
+					{
+						bytes[p++] = QOI_OP_RGBA;
+						bytes[p++] = px.rgba.r;
+						bytes[p++] = px.rgba.g;
+						bytes[p++] = px.rgba.b;
+						bytes[p++] = px.rgba.a;
+					}
+				}
+			}
+
+			prev = px;
+		}
+	}
+
+	memcpy(&bytes[p], qoi_padding, QOI_PADDING_SIZE);
+	p += QOI_PADDING_SIZE;
+	*len = p;
+
+	return bytes;
+}
+
+IplImage *catcierge_qoi_decode(const unsigned char *data, size_t len)
+{
+	catcierge_qoi_px_t index[64];
+	catcierge_qoi_px_t px;
+	IplImage *img = NULL;
+	unsigned char *row;
+	unsigned int width;
+	unsigned int height;
+	int channels;
+	size_t p = QOI_HEADER_SIZE;
+	size_t chunks_len;
+	int run = 0;
+	unsigned int x;
+	unsigned int y;
+	assert(data);
+
+	if ((len < (QOI_HEADER_SIZE + QOI_PADDING_SIZE)) || memcmp(data, "qoif", 4))
+	{
+		CATERR("QOI: Not a QOI image\n");
+		return NULL;
+	}
+
+	width = catcierge_qoi_read_32(&data[4]);
+	height = catcierge_qoi_read_32(&data[8]);
+	channels = data[12];
+
+	if ((width == 0) || (height == 0) || ((channels != 3) && (channels != 4))
+		|| (height >= (QOI_MAX_PIXELS / width)))
+	{
+		CATERR("QOI: Invalid header\n");
+		return NULL;
+	}
+
+	if (!(img = cvCreateImage(cvSize(width, height), IPL_DEPTH_8U, channels)))
+	{
+		CATERR("Out of memory!\n");
+		return NULL;
+	}
+
+	memset(index, 0, sizeof(index));
+	px.v = 0;
+	px.rgba.a = 255;
+	chunks_len = len - QOI_PADDING_SIZE;
+
+	for (y = 0; y < height; y++)
+	{
+		row = (unsigned char *)img->imageData + (y * img->widthStep);
+
+		for (x = 0; x < width; x++)
+		{
+			if (run > 0)
+			{
+				run--;
+			}
+			else if (p < chunks_len)
+			{
+				int b1 = data[p++];
+
+				if (b1 == QOI_OP_RGB)
+				{
+					px.rgba.r = data[p++];
+					px.rgba.g = data[p++];
+					px.rgba.b = data[p++];
+				}
+				else if (b1 == QOI_OP_RGBA)
+				{
+					px.rgba.r = data[p++];
+					px.rgba.g = data[p++];
+					px.rgba.b = data[p++];
+					px.rgba.a = data[p++];
+				}
+				else if ((b1 & QOI_MASK_2) == QOI_OP_INDEX)
+				{
+					px = index[b1];
+				}
+				else if ((b1 & QOI_MASK_2) == QOI_OP_DIFF)
+				{
+					px.rgba.r += ((b1 >> 4) & 0x03) - 2;
+					px.rgba.g += ((b1 >> 2) & 0x03) - 2;
+					px.rgba.b += (b1 & 0x03) - 2;
+				}
+				else if ((b1 & QOI_MASK_2) == QOI_OP_LUMA)
+				{
+					int b2 = data[p++];
+					int vg = (b1 & 0x3f) - 32;
+					px.rgba.r += vg - 8 + ((b2 >> 4) & 0x0f);
+					px.rgba.g += vg;
+					px.rgba.b += vg - 8 + (b2 & 0x0f);
+				}
+				else if ((b1 & QOI_MASK_2) == QOI_OP_RUN)
+				{
+					run = (b1 & 0x3f);
+				}
+
+				index[QOI_HASH(px)] = px;
+			}
+
+			row[x * channels] = px.rgba.b;
+			row[x * channels + 1] = px.rgba.g;
+			row[x * channels + 2] = px.rgba.r;
+
+			if (channels == 4)
+			{
+				row[x * channels + 3] = px.rgba.a;
+			}
+		}
+	}
+
+	return img;
+}
+
+static unsigned char *catcierge_pnm_encode(const IplImage *img, size_t *len)
+{
+	unsigned char *bytes = NULL;
+	unsigned char *out;
+	const unsigned char *row;
+	int gray = (img->nChannels == 1);
+	int header_len;
+	char header[64];
+	size_t row_len;
+	int x;
+	int y;
+
+	if ((img->depth != IPL_DEPTH_8U)
+		|| ((img->nChannels != 1) && (img->nChannels != 3) && (img->nChannels != 4)))
+	{
+		CATERR("PGM: Only 8-bit grayscale, BGR or BGRA images are supported\n");
+		return NULL;
+	}
+
+	header_len = snprintf(header, sizeof(header), "P%c\n%d %d\n255\n",
+		gray ? '5' : '6', img->width, img->height);
+	row_len = img->width * (gray ? 1 : 3);
+
+	if (!(bytes = malloc(header_len + (row_len * img->height))))
+	{
+		CATERR("Out of memory!\n");
+		return NULL;
+	}
+
+	memcpy(bytes, header, header_len);
+	out = bytes + header_len;
+
+	for (y = 0; y < img->height; y++)
+	{
+		row = (const unsigned char *)img->imageData + (y * img->widthStep);
+
+		if (gray)
+		{
+			memcpy(out, row, row_len);
+			out += row_len;
+			continue;
+		}
+
+		// PPM is RGB, the alpha channel is dropped.
+		for (x = 0; x < img->width; x++)
+		{
+			*out++ = row[x * img->nChannels + 2];
+			*out++ = row[x * img->nChannels + 1];
+			*out++ = row[x * img->nChannels];
+		}
+	}
+
+	*len = out - bytes;
+	return bytes;
+}
+
+static int catcierge_pnm_read_int(const unsigned char *data, size_t len, size_t *p, int *val)
+{
+	int c = -1;
+
+	// Skip whitespace and comments.
+	while (*p < len)
+	{
+		c = data[(*p)++];
+
+		if (c == '#')
+		{
+			while ((*p < len) && (data[*p] != '\n'))
+				(*p)++;
+		}
+		else if ((c != ' ') && (c != '\t') && (c != '\r') && (c != '\n'))
+		{
+			break;
+		}
+	}
+
+	if ((c < '0') || (c > '9'))
+	{
+		return -1;
+	}
+
+	*val = 0;
+
+	while ((c >= '0') && (c <= '9'))
+	{
+		if (*val > (QOI_MAX_PIXELS / 10))
+			return -1;
+
+		*val = (*val * 10) + (c - '0');
+		c = (*p < len) ? data[(*p)++] : -1;
+	}
+
+	// A single whitespace character ends the value.
+	return 0;
+}
+
+static IplImage *catcierge_pnm_decode(const unsigned char *data, size_t len)
+{
+	IplImage *img = NULL;
+	unsigned char *row;
+	unsigned char tmp;
+	size_t p = 2; // The header continues after the 2 character magic.
+	int channels = (data[1] == '5') ? 1 : 3;
+	int width;
+	int height;
+	int maxval;
+	int x;
+	int y;
+
+	if (catcierge_pnm_read_int(data, len, &p, &width)
+		|| catcierge_pnm_read_int(data, len, &p, &height)
+		|| catcierge_pnm_read_int(data, len, &p, &maxval)
+		|| (width <= 0) || (height <= 0) || (maxval != 255)
+		|| (height >= (QOI_MAX_PIXELS / width)))
+	{
+		CATERR("PGM: Invalid or unsupported header\n");
+		return NULL;
+	}
+
+	if ((len - p) < ((size_t)width * height * channels))
+	{
+		CATERR("PGM: Truncated image data\n");
+		return NULL;
+	}
+
+	if (!(img = cvCreateImage(cvSize(width, height), IPL_DEPTH_8U, channels)))
+	{
+		CATERR("Out of memory!\n");
+		return NULL;
+	}
+
+	for (y = 0; y < height; y++)
+	{
+		row = (unsigned char *)img->imageData + (y * img->widthStep);
+		memcpy(row, data + p, width * channels);
+		p += width * channels;
+
+		// RGB to BGR.
+		for (x = 0; (channels == 3) && (x < width); x++)
+		{
+			tmp = row[x * 3];
+			row[x * 3] = row[x * 3 + 2];
+			row[x * 3 + 2] = tmp;
+		}
+	}
+
+	return img;
+}
+
+static unsigned char *catcierge_png_encode(const IplImage *img, int png_compression, size_t *len)
+{
+	int params[] = { CV_IMWRITE_PNG_COMPRESSION, png_compression, 0 };
+	unsigned char *bytes = NULL;
+	CvMat *mat;
+
+	if (!(mat = cvEncodeImage(".png", img, (png_compression >= 0) ? params : NULL)))
+	{
+		CATERR("PNG: Failed to encode image\n");
+		return NULL;
+	}
+
+	*len = mat->rows * mat->cols;
+
+	if (!(bytes = malloc(*len)))
+	{
+		CATERR("Out of memory!\n");
+	}
+	else
+	{
+		memcpy(bytes, mat->data.ptr, *len);
+	}
+
+	cvReleaseMat(&mat);
+	return bytes;
+}
+
+unsigned char *catcierge_image_encode(const IplImage *img,
+		catcierge_image_format_t format, int png_compression, size_t *len)
+{
+	assert(img);
+	assert(len);
+	*len = 0;
+
+	switch (format)
+	{
+		case CATCIERGE_IMAGE_QOI: return catcierge_qoi_encode(img, len);
+		case CATCIERGE_IMAGE_PGM: return catcierge_pnm_encode(img, len);
+		case CATCIERGE_IMAGE_PNG:
+		default: return catcierge_png_encode(img, png_compression, len);
+	}
+}
+
+IplImage *catcierge_image_decode(const unsigned char *data, size_t len)
+{
+	CvMat mat;
+	assert(data);
+
+	if ((len >= 4) && !memcmp(data, "qoif", 4))
+	{
+		return catcierge_qoi_decode(data, len);
+	}
+	else if ((len >= 2) && (data[0] == 'P') && ((data[1] == '5') || (data[1] == '6')))
+	{
+		return catcierge_pnm_decode(data, len);
+	}
+
+	mat = cvMat(1, (int)len, CV_8UC1, (void *)data);
+	return cvDecodeImage(&mat, CV_LOAD_IMAGE_UNCHANGED);
+}
+
+int catcierge_image_save(const char *path, const IplImage *img,
+		catcierge_image_format_t format, int png_compression)
+{
+	unsigned char *bytes = NULL;
+	size_t len = 0;
+	size_t written;
+	FILE *f = NULL;
+	assert(path);
+	assert(img);
+
+	if (format == CATCIERGE_IMAGE_PNG)
+	{
+		int params[] = { CV_IMWRITE_PNG_COMPRESSION, png_compression, 0 };
+		return cvSaveImage(path, img, (png_compression >= 0) ? params : NULL) ? 0 : -1;
+	}
+
+	if (!(bytes = catcierge_image_encode(img, format, png_compression, &len)))
+	{
+		return -1;
+	}
+
+	if (!(f = fopen(path, "wb")))
+	{
+		CATERR("Failed to open \"%s\" for writing\n", path);
+		free(bytes);
+		return -1;
+	}
+
+	written = fwrite(bytes, 1, len, f);
+	fclose(f);
+	free(bytes);
+
+	return (written == len) ? 0 : -1;
+}
+
+IplImage *catcierge_image_load(const char *path)
+{
+	unsigned char magic[4];
+	unsigned char *data = NULL;
+	IplImage *img = NULL;
+	long size;
+	FILE *f = NULL;
+	assert(path);
+
+	if (!(f = fopen(path, "rb")))
+	{
+		CATERR("Failed to open image \"%s\"\n", path);
+		return NULL;
+	}
+
+	if (fread(magic, 1, sizeof(magic), f) != sizeof(magic))
+	{
+		magic[0] = '\0';
+	}
+
+	// Let OpenCV handle anything that is not our own formats.
+	if (memcmp(magic, "qoif", 4)
+		&& ((magic[0] != 'P') || ((magic[1] != '5') && (magic[1] != '6'))))
+	{
+		fclose(f);
+		return cvLoadImage(path, CV_LOAD_IMAGE_UNCHANGED);
+	}
+
+	if (fseek(f, 0, SEEK_END) || ((size = ftell(f)) < 0))
+	{
+		CATERR("Failed to get the size of \"%s\"\n", path);
+		goto fail;
+	}
+
+	rewind(f);
+
+	if (!(data = malloc(size)))
+	{
+		CATERR("Out of memory!\n");
+		goto fail;
+	}
+
+	if (fread(data, 1, size, f) == (size_t)size)
+	{
+		img = catcierge_image_decode(data, size);
+	}
+
+	free(data);
+
+fail:
+	fclose(f);
+	return img;
+}
@@ -0,0 +1,60 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_IMAGE_FORMAT_H__
+#define __CATCIERGE_IMAGE_FORMAT_H__
+
+#include <stddef.h>
+#include <opencv2/imgproc/imgproc_c.h>
+#include <opencv2/highgui/highgui_c.h>
+
+#define DEFAULT_PNG_COMPRESSION -1 // Use the OpenCV default.
+
+typedef enum catcierge_image_format_e
+{
+	CATCIERGE_IMAGE_PNG,
+	CATCIERGE_IMAGE_QOI,	// Fast lossless, see https://qoiformat.org
+	CATCIERGE_IMAGE_PGM		// Uncompressed binary PGM/PPM.
+} catcierge_image_format_t;
+
+int catcierge_image_format_parse(const char *name, catcierge_image_format_t *format);
+const char *catcierge_image_format_str(catcierge_image_format_t format);
+
+// File extension for an image with the given number of channels.
+// (PGM is only for grayscale images, color images are saved as PPM).
+const char *catcierge_image_format_ext(catcierge_image_format_t format, int channels);
+
+// Saves an 8-bit image. A png_compression of 0-9 overrides the
+// OpenCV default. Returns 0 on success.
+int catcierge_image_save(const char *path, const IplImage *img,
+		catcierge_image_format_t format, int png_compression);
+
+// Loads any of the formats above, based on the file contents.
+IplImage *catcierge_image_load(const char *path);
+
+// Same as above but in memory. The returned buffer is malloced.
+unsigned char *catcierge_image_encode(const IplImage *img,
+		catcierge_image_format_t format, int png_compression, size_t *len);
+IplImage *catcierge_image_decode(const unsigned char *data, size_t len);
+
+// QOI encoding in memory. Grayscale images are stored as RGB since
+// QOI only has 3 and 4 channel images. The returned buffer is malloced.
+unsigned char *catcierge_qoi_encode(const IplImage *img, size_t *len);
+IplImage *catcierge_qoi_decode(const unsigned char *data, size_t len);
+
+#endif // __CATCIERGE_IMAGE_FORMAT_H__
@@ -0,0 +1,409 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <catcierge_config.h>
+#ifdef CATCIERGE_HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef CATCIERGE_HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#include "catcierge_image_writer.h"
+#include "catcierge_util.h"
+#include "catcierge_log.h"
+
+#ifdef CATCIERGE_HAVE_PTHREAD_H
+
+static double catcierge_image_writer_elapsed(struct timeval *start)
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return (now.tv_sec - start->tv_sec) + ((now.tv_usec - start->tv_usec) / 1000000.0);
+}
+
+static int catcierge_image_writer_append(catcierge_image_writer_t *w,
+		catcierge_image_job_t *job, unsigned long long *bytes)
+{
+	uint64_t size;
+	int ret = 0;
+
+	catcierge_archive_record_encode(job->record, w->format, w->png_compression);
+
+	if (catcierge_archive_switch(job->archive, job->path))
+	{
+		ret = -1; goto fail;
+	}
+
+	size = job->archive->size;
+
+	if (catcierge_archive_append(job->archive, job->record))
+	{
+		ret = -1; goto fail;
+	}
+
+	*bytes = job->archive->size - size;
+
+fail:
+	catcierge_archive_record_free(job->record);
+	catcierge_xfree(&job->record);
+	return ret;
+}
+
+static void catcierge_image_writer_write(catcierge_image_writer_t *w,
+		catcierge_image_job_t *job)
+{
+	int ok;
+	double latency;
+	unsigned long long bytes = 0;
+	unsigned char *data = NULL;
+	size_t len = 0;
+	#ifdef CATCIERGE_HAVE_SYS_STAT_H
+	struct stat st;
+	#endif
+
+	if (job->record)
+	{
+		if (!(ok = !catcierge_image_writer_append(w, job, &bytes)))
+		{
+			CATERR("Failed to append match group to archive %s\n", job->path);
+		}
+	}
+	else if (w->staging && w->staging->running)
+	{
+		// The staging flusher creates the directory later.
+		if ((data = catcierge_image_encode(job->img, w->format, w->png_compression, &len))
+			&& !catcierge_staging_add(w->staging, job->path, (char *)data, len))
+		{
+			ok = 1;
+			bytes = len;
+		}
+		else
+		{
+			ok = 0;
+			CATERR("Failed to stage image %s\n", job->path);
+		}
+	}
+	else
+	{
+		catcierge_dir_cache_make_path(&w->dir_cache, job->dir);
+
+		if ((ok = !catcierge_image_save(job->path, job->img, w->format, w->png_compression)))
+		{
+			#ifdef CATCIERGE_HAVE_SYS_STAT_H
+			if (!stat(job->path, &st))
+			{
+				bytes = (unsigned long long)st.st_size;
+			}
+			#endif
+		}
+		else
+		{
+			CATERR("Failed to save image %s\n", job->path);
+		}
+	}
+
+	latency = catcierge_image_writer_elapsed(&job->queued_tv);
+
+	cvReleaseImage(&job->img);
+	catcierge_xfree(&job->path);
+
+	pthread_mutex_lock(&w->lock);
+	if (ok)
+	{
+		w->written_count++;
+		w->bytes_written += bytes;
+		w->last_latency = latency;
+		w->total_latency += latency;
+	}
+	else
+	{
+		w->failed_count++;
+	}
+	w->done_batches += job->notify;
+	pthread_mutex_unlock(&w->lock);
+}
+
+static void *catcierge_image_writer_worker(void *arg)
+{
+	catcierge_image_writer_t *w = (catcierge_image_writer_t *)arg;
+	catcierge_image_job_t job;
+
+	pthread_mutex_lock(&w->lock);
+
+	while (1)
+	{
+		while ((w->count == 0) && w->running)
+		{
+			pthread_cond_wait(&w->not_empty, &w->lock);
+		}
+
+		// Write everything queued before stopping.
+		if (w->count == 0)
+		{
+			break;
+		}
+
+		job = w->jobs[w->head];
+		memset(&w->jobs[w->head], 0, sizeof(catcierge_image_job_t));
+		w->head = (w->head + 1) % w->size;
+		w->count--;
+		pthread_mutex_unlock(&w->lock);
+
+		catcierge_image_writer_write(w, &job);
+
+		pthread_mutex_lock(&w->lock);
+	}
+
+	pthread_mutex_unlock(&w->lock);
+
+	return NULL;
+}
+
+#endif // CATCIERGE_HAVE_PTHREAD_H
+
+int catcierge_image_writer_init(catcierge_image_writer_t *w, size_t size,
+		catcierge_image_format_t format, int png_compression)
+{
+	assert(w);
+	memset(w, 0, sizeof(catcierge_image_writer_t));
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+
+	if ((size == 0) || (size > CATCIERGE_IMAGE_QUEUE_MAX_SIZE))
+	{
+		CATERR("Invalid image queue size %d\n", (int)size);
+		return -1;
+	}
+
+	if (!(w->jobs = calloc(size, sizeof(catcierge_image_job_t))))
+	{
+		CATERR("Out of memory\n");
+		return -1;
+	}
+
+	w->size = size;
+	w->format = format;
+	w->png_compression = png_compression;
+	w->running = 1;
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_cond_init(&w->not_empty, NULL);
+
+	if (pthread_create(&w->thread, NULL, catcierge_image_writer_worker, w))
+	{
+		CATERR("Failed to start image writer thread\n");
+		w->running = 0;
+		pthread_mutex_destroy(&w->lock);
+		pthread_cond_destroy(&w->not_empty);
+		catcierge_xfree(&w->jobs);
+		return -1;
+	}
+
+	CATLOG("Started image writer with a queue of %d images\n", (int)size);
+
+	return 0;
+
+	#else // !CATCIERGE_HAVE_PTHREAD_H
+
+	CATERR("Saving images in the background is not supported on this platform\n");
+	return -1;
+
+	#endif // CATCIERGE_HAVE_PTHREAD_H
+}
+
+void catcierge_image_writer_destroy(catcierge_image_writer_t *w)
+{
+	assert(w);
+
+	if (!w->running)
+	{
+		return;
+	}
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	pthread_mutex_lock(&w->lock);
+	w->running = 0;
+	pthread_cond_signal(&w->not_empty);
+	pthread_mutex_unlock(&w->lock);
+
+	pthread_join(w->thread, NULL);
+
+	pthread_mutex_destroy(&w->lock);
+	pthread_cond_destroy(&w->not_empty);
+
+	CATLOG("Images: %lu written (%llu bytes), %lu failed, %lu dropped, max %d queued, %0.2f ms average\n",
+		w->written_count, w->bytes_written, w->failed_count, w->dropped_count,
+		(int)w->max_count, w->written_count
+			? (w->total_latency / w->written_count) * 1000.0 : 0.0);
+
+	catcierge_dir_cache_destroy(&w->dir_cache);
+
+	catcierge_xfree(&w->jobs);
+	#endif // CATCIERGE_HAVE_PTHREAD_H
+}
+
+#ifdef CATCIERGE_HAVE_PTHREAD_H
+static int catcierge_image_writer_enqueue(catcierge_image_writer_t *w,
+		IplImage *img, catcierge_archive_record_t *record, catcierge_archive_t *archive,
+		const char *dir, const char *path, int notify)
+{
+	catcierge_image_job_t *job;
+	size_t dir_len;
+	size_t path_len;
+	char *buf = NULL;
+	int ret = 0;
+	assert(w->running);
+
+	// Allocate outside of the lock, the worker might be waiting for it.
+	dir_len = strlen(dir);
+	path_len = strlen(path);
+
+	if ((buf = malloc(path_len + dir_len + 2)))
+	{
+		memcpy(buf, path, path_len + 1);
+		memcpy(buf + path_len + 1, dir, dir_len + 1);
+	}
+
+	pthread_mutex_lock(&w->lock);
+
+	if (!buf || (w->count == w->size))
+	{
+		w->dropped_count++;
+		CATERR("Image queue full, dropped %s (%lu dropped)\n", path, w->dropped_count);
+
+		// Let the batch complete with the last queued image instead.
+		if (notify)
+		{
+			if (w->count > 0)
+				w->jobs[(w->head + w->count - 1) % w->size].notify += notify;
+			else
+				w->done_batches += notify;
+		}
+
+		catcierge_xfree(&buf);
+		ret = -1; goto fail;
+	}
+
+	job = &w->jobs[(w->head + w->count) % w->size];
+	job->img = img;
+	job->record = record;
+	job->archive = archive;
+	job->path = buf;
+	job->dir = buf + path_len + 1;
+	job->notify = notify;
+	gettimeofday(&job->queued_tv, NULL);
+
+	w->queued_count++;
+	w->count++;
+
+	if (w->count > w->max_count)
+	{
+		w->max_count = w->count;
+	}
+
+	pthread_cond_signal(&w->not_empty);
+fail:
+	pthread_mutex_unlock(&w->lock);
+	return ret;
+}
+#endif // CATCIERGE_HAVE_PTHREAD_H
+
+int catcierge_image_writer_push(catcierge_image_writer_t *w,
+		IplImage *img, const char *dir, const char *path, int notify)
+{
+	assert(w);
+	assert(img);
+	assert(dir);
+	assert(path);
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	if (!catcierge_image_writer_enqueue(w, img, NULL, NULL, dir, path, notify))
+	{
+		return 0;
+	}
+	#endif
+
+	cvReleaseImage(&img);
+	return -1;
+}
+
+int catcierge_image_writer_push_record(catcierge_image_writer_t *w,
+		catcierge_archive_t *archive, catcierge_archive_record_t *record,
+		const char *path, int notify)
+{
+	assert(w);
+	assert(archive);
+	assert(record);
+	assert(path);
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	if (!catcierge_image_writer_enqueue(w, NULL, record, archive, "", path, notify))
+	{
+		return 0;
+	}
+	#endif
+
+	catcierge_archive_record_free(record);
+	free(record);
+	return -1;
+}
+
+size_t catcierge_image_writer_poll(catcierge_image_writer_t *w)
+{
+	size_t done = 0;
+	assert(w);
+
+	if (!w->running)
+	{
+		return 0;
+	}
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	pthread_mutex_lock(&w->lock);
+	done = w->done_batches;
+	w->done_batches = 0;
+	pthread_mutex_unlock(&w->lock);
+	#endif
+
+	return done;
+}
+
+void catcierge_image_writer_stats(catcierge_image_writer_t *w,
+		catcierge_image_writer_stats_t *stats)
+{
+	assert(w);
+	assert(stats);
+
+	// The lock only exists while running, until then nothing else writes these.
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	if (w->running)
+		pthread_mutex_lock(&w->lock);
+	#endif
+
+	stats->count = w->count;
+	stats->written_count = w->written_count;
+	stats->bytes_written = w->bytes_written;
+	stats->total_latency = w->total_latency;
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	if (w->running)
+		pthread_mutex_unlock(&w->lock);
+	#endif
+}
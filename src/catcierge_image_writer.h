@@ -0,0 +1,120 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_IMAGE_WRITER_H__
+#define __CATCIERGE_IMAGE_WRITER_H__
+
+#include <stddef.h>
+#include <catcierge_config.h>
+#include "catcierge_types.h"
+#include "catcierge_image_format.h"
+#include "catcierge_archive.h"
+#include "catcierge_staging.h"
+
+#ifdef CATCIERGE_HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#define DEFAULT_IMAGE_QUEUE_SIZE 128
+#define CATCIERGE_IMAGE_QUEUE_MAX_SIZE 1024
+
+typedef struct catcierge_image_job_s
+{
+	IplImage *img;			// Owned by the job, released once written.
+	char *path;				// Full path.
+	char *dir;				// Same allocation as path.
+	int notify;				// Last image of a batch, report when written.
+	catcierge_archive_record_t *record;	// Instead of img, appended to archive at path.
+	catcierge_archive_t *archive;
+	struct timeval queued_tv;
+} catcierge_image_job_t;
+
+typedef struct catcierge_image_writer_stats_s
+{
+	size_t count;			// Images in the queue.
+	unsigned long written_count;
+	unsigned long long bytes_written;
+	double total_latency;
+} catcierge_image_writer_stats_t;
+
+//
+// Saves images on a worker thread so that the encoding and disk
+// writes never hold up the matching. The images are handed over to the
+// writer, which releases them once written. When the queue is full the
+// image is dropped right away instead of waiting for room.
+//
+// The FSM polls the writer for batches that have been written, so it
+// can trigger the save_img event for them on its own thread.
+//
+typedef struct catcierge_image_writer_s
+{
+	int running;
+	catcierge_image_job_t *jobs;
+	size_t size;			// Max number of images in the queue.
+	size_t count;			// Current number of images in the queue.
+	size_t head;			// Index of the oldest image.
+	size_t max_count;		// Highest number of images queued at once.
+	catcierge_image_format_t format;
+	int png_compression;
+	catcierge_staging_t *staging;	// Encoded images are staged here instead, if running.
+
+	unsigned long queued_count;
+	unsigned long dropped_count;
+	unsigned long written_count;
+	unsigned long failed_count;
+	unsigned long long bytes_written;
+	double last_latency;	// Seconds from queued until written, for the latest image.
+	double total_latency;
+	size_t done_batches;	// Written batches not yet polled.
+
+	catcierge_dir_cache_t dir_cache;	// Only used by the worker thread.
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	#endif
+} catcierge_image_writer_t;
+
+int catcierge_image_writer_init(catcierge_image_writer_t *w, size_t size,
+		catcierge_image_format_t format, int png_compression);
+
+// Writes the queued images and stops the worker.
+void catcierge_image_writer_destroy(catcierge_image_writer_t *w);
+
+// Takes ownership of img. Returns 0 if it was queued,
+// -1 if it was dropped (the image is released either way).
+int catcierge_image_writer_push(catcierge_image_writer_t *w,
+		IplImage *img, const char *dir, const char *path, int notify);
+
+// Encodes the images of the record and appends it to the archive at
+// path. Takes ownership of the record, and notify counts as that many
+// batches once written. The archive must only be used by the writer
+// until it is destroyed.
+int catcierge_image_writer_push_record(catcierge_image_writer_t *w,
+		catcierge_archive_t *archive, catcierge_archive_record_t *record,
+		const char *path, int notify);
+
+// Returns the number of batches written since the last poll.
+size_t catcierge_image_writer_poll(catcierge_image_writer_t *w);
+
+// Copies the statistics, which the worker updates.
+void catcierge_image_writer_stats(catcierge_image_writer_t *w,
+		catcierge_image_writer_stats_t *stats);
+
+#endif // __CATCIERGE_IMAGE_WRITER_H__
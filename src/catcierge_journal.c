@@ -0,0 +1,767 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#define _FILE_OFFSET_BITS 64 // Journals can grow past 2GB.
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "catcierge_config.h"
+#include "catcierge_journal.h"
+#include "catcierge_util.h"
+#include "catcierge_log.h"
+
+#ifdef _WIN32
+#include <io.h>
+#define catcierge_fseek _fseeki64
+#define catcierge_ftell _ftelli64
+#define catcierge_ftruncate(f, size) _chsize_s(_fileno(f), size)
+#else
+#include <unistd.h>
+#define catcierge_fseek fseeko
+#define catcierge_ftell ftello
+#define catcierge_ftruncate(f, size) ftruncate(fileno(f), size)
+#endif
+
+#ifdef CATCIERGE_HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#define CATCIERGE_JOURNAL_MAGIC "CCJL"
+#define CATCIERGE_JOURNAL_EVENT_MAGIC "CCJE"
+#define CATCIERGE_JOURNAL_INDEX_MAGIC "CCJI"
+
+//
+// File header:
+//  0  "CCJL"
+//  4  u32 version
+//  8  u32 events per index block
+//  12 u32 reserved
+//
+// Record header, the CRC covers everything after it:
+//  0  magic ("CCJE" event or "CCJI" index block)
+//  4  u16 record size
+//  6  u8  record version
+//  7  u8  reserved
+//  8  u32 CRC-32
+//
+// Event:
+//  12 u64 start time (us)
+//  20 u32 duration (ms)
+//  24 u8  success, direction + 1, match count, success count
+//  28 u8  flags, RFID direction + 1, u16 reserved
+//  32 u32 * 5 match group id (SHA1)
+//  52 per match: f32 result, u8 success, direction + 1, reused, reserved
+//
+// Index block, summary of the events since the previous index block:
+//  12 u64 offset of the previous index block (0 if none)
+//  20 u64 offset of the first event
+//  28 u64 first time (us)
+//  36 u64 last time (us)
+//  44 u32 count, success, in, out, unknown, matches
+//
+
+static int catcierge_journal_check_record(const unsigned char *data, uint64_t size,
+		uint64_t off, char *type, uint32_t *len)
+{
+	const unsigned char *b = data + off;
+	uint32_t n;
+
+	if ((off + CATCIERGE_JOURNAL_RECORD_HEADER_SIZE) > size)
+		return -1;
+
+	n = catcierge_get_u16(b + 4);
+
+	if (!memcmp(b, CATCIERGE_JOURNAL_EVENT_MAGIC, 4))
+	{
+		if ((n < CATCIERGE_JOURNAL_EVENT_SIZE)
+			|| (n > (CATCIERGE_JOURNAL_EVENT_SIZE
+				+ CATCIERGE_JOURNAL_MAX_MATCHES * CATCIERGE_JOURNAL_MATCH_SIZE))
+			|| ((n - CATCIERGE_JOURNAL_EVENT_SIZE) % CATCIERGE_JOURNAL_MATCH_SIZE))
+		{
+			return -1;
+		}
+
+		*type = 'E';
+	}
+	else if (!memcmp(b, CATCIERGE_JOURNAL_INDEX_MAGIC, 4))
+	{
+		if (n != CATCIERGE_JOURNAL_INDEX_SIZE)
+			return -1;
+
+		*type = 'I';
+	}
+	else
+	{
+		return -1;
+	}
+
+	if (((off + n) > size)
+		|| (catcierge_get_u32(b + 8) != catcierge_crc32(b + CATCIERGE_JOURNAL_RECORD_HEADER_SIZE,
+				n - CATCIERGE_JOURNAL_RECORD_HEADER_SIZE)))
+	{
+		return -1;
+	}
+
+	*len = n;
+
+	return 0;
+}
+
+static void catcierge_journal_finish_record(unsigned char *b, const char *magic, size_t len)
+{
+	memcpy(b, magic, 4);
+	catcierge_put_u16(b + 4, (uint16_t)len);
+	b[6] = CATCIERGE_JOURNAL_VERSION;
+	b[7] = 0;
+	catcierge_put_u32(b + 8, catcierge_crc32(b + CATCIERGE_JOURNAL_RECORD_HEADER_SIZE,
+		len - CATCIERGE_JOURNAL_RECORD_HEADER_SIZE));
+}
+
+static size_t catcierge_journal_encode_event(unsigned char *b, const catcierge_journal_event_t *e)
+{
+	size_t i;
+	size_t count = (e->match_count > CATCIERGE_JOURNAL_MAX_MATCHES)
+				? CATCIERGE_JOURNAL_MAX_MATCHES : e->match_count;
+	size_t len = CATCIERGE_JOURNAL_EVENT_SIZE + count * CATCIERGE_JOURNAL_MATCH_SIZE;
+	unsigned char *m;
+	uint32_t result;
+
+	memset(b, 0, len);
+	catcierge_put_u64(b + 12, e->time_us);
+	catcierge_put_u32(b + 20, e->duration_ms);
+	b[24] = (unsigned char)!!e->success;
+	b[25] = (unsigned char)(e->direction + 1);
+	b[26] = (unsigned char)count;
+	b[27] = (unsigned char)e->success_count;
+	b[28] = (unsigned char)e->flags;
+	b[29] = (unsigned char)(e->rfid_direction + 1);
+
+	for (i = 0; i < 5; i++)
+	{
+		catcierge_put_u32(b + 32 + i * 4, e->id[i]);
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		m = b + CATCIERGE_JOURNAL_EVENT_SIZE + i * CATCIERGE_JOURNAL_MATCH_SIZE;
+		memcpy(&result, &e->matches[i].result, sizeof(result));
+		catcierge_put_u32(m, result);
+		m[4] = (unsigned char)!!e->matches[i].success;
+		m[5] = (unsigned char)(e->matches[i].direction + 1);
+		m[6] = (unsigned char)!!e->matches[i].reused;
+	}
+
+	catcierge_journal_finish_record(b, CATCIERGE_JOURNAL_EVENT_MAGIC, len);
+
+	return len;
+}
+
+static void catcierge_journal_decode_event(const unsigned char *b, uint32_t len,
+		catcierge_journal_event_t *e)
+{
+	size_t i;
+	const unsigned char *m;
+	uint32_t result;
+
+	memset(e, 0, sizeof(*e));
+	e->time_us = catcierge_get_u64(b + 12);
+	e->duration_ms = catcierge_get_u32(b + 20);
+	e->success = b[24];
+	e->direction = (match_direction_t)(b[25] - 1);
+	e->success_count = b[27];
+	e->flags = b[28];
+	e->rfid_direction = (match_direction_t)(b[29] - 1);
+
+	for (i = 0; i < 5; i++)
+	{
+		e->id[i] = catcierge_get_u32(b + 32 + i * 4);
+	}
+
+	// The size is what counts, it has been checked against the CRC.
+	e->match_count = (len - CATCIERGE_JOURNAL_EVENT_SIZE) / CATCIERGE_JOURNAL_MATCH_SIZE;
+
+	for (i = 0; i < e->match_count; i++)
+	{
+		m = b + CATCIERGE_JOURNAL_EVENT_SIZE + i * CATCIERGE_JOURNAL_MATCH_SIZE;
+		result = catcierge_get_u32(m);
+		memcpy(&e->matches[i].result, &result, sizeof(result));
+		e->matches[i].success = m[4];
+		e->matches[i].direction = (match_direction_t)(m[5] - 1);
+		e->matches[i].reused = m[6];
+	}
+}
+
+static void catcierge_journal_encode_index(unsigned char *b,
+		uint64_t prev, const catcierge_journal_block_t *block)
+{
+	const catcierge_journal_stats_t *s = &block->stats;
+
+	memset(b, 0, CATCIERGE_JOURNAL_INDEX_SIZE);
+	catcierge_put_u64(b + 12, prev);
+	catcierge_put_u64(b + 20, block->offset);
+	catcierge_put_u64(b + 28, s->first_us);
+	catcierge_put_u64(b + 36, s->last_us);
+	catcierge_put_u32(b + 44, (uint32_t)s->count);
+	catcierge_put_u32(b + 48, (uint32_t)s->success_count);
+	catcierge_put_u32(b + 52, (uint32_t)s->in_count);
+	catcierge_put_u32(b + 56, (uint32_t)s->out_count);
+	catcierge_put_u32(b + 60, (uint32_t)s->unknown_count);
+	catcierge_put_u32(b + 64, (uint32_t)s->match_count);
+	catcierge_journal_finish_record(b, CATCIERGE_JOURNAL_INDEX_MAGIC, CATCIERGE_JOURNAL_INDEX_SIZE);
+}
+
+static void catcierge_journal_decode_index(const unsigned char *b, uint64_t off,
+		uint64_t *prev, catcierge_journal_block_t *block)
+{
+	catcierge_journal_stats_t *s = &block->stats;
+
+	*prev = catcierge_get_u64(b + 12);
+	block->offset = catcierge_get_u64(b + 20);
+	block->end = off;
+	s->first_us = catcierge_get_u64(b + 28);
+	s->last_us = catcierge_get_u64(b + 36);
+	s->count = catcierge_get_u32(b + 44);
+	s->success_count = catcierge_get_u32(b + 48);
+	s->in_count = catcierge_get_u32(b + 52);
+	s->out_count = catcierge_get_u32(b + 56);
+	s->unknown_count = catcierge_get_u32(b + 60);
+	s->match_count = catcierge_get_u32(b + 64);
+}
+
+void catcierge_journal_stats_add(catcierge_journal_stats_t *stats,
+		const catcierge_journal_event_t *e)
+{
+	assert(stats);
+	assert(e);
+
+	if ((stats->count == 0) || (e->time_us < stats->first_us))
+		stats->first_us = e->time_us;
+
+	if ((stats->count == 0) || (e->time_us > stats->last_us))
+		stats->last_us = e->time_us;
+
+	stats->count++;
+	stats->success_count += e->success ? 1 : 0;
+	stats->match_count += (unsigned long)e->match_count;
+
+	switch (e->direction)
+	{
+		case MATCH_DIR_IN: stats->in_count++; break;
+		case MATCH_DIR_OUT: stats->out_count++; break;
+		default: stats->unknown_count++; break;
+	}
+}
+
+static void catcierge_journal_stats_merge(catcierge_journal_stats_t *stats,
+		const catcierge_journal_stats_t *s)
+{
+	if (s->count == 0)
+		return;
+
+	if ((stats->count == 0) || (s->first_us < stats->first_us))
+		stats->first_us = s->first_us;
+
+	if ((stats->count == 0) || (s->last_us > stats->last_us))
+		stats->last_us = s->last_us;
+
+	stats->count += s->count;
+	stats->success_count += s->success_count;
+	stats->in_count += s->in_count;
+	stats->out_count += s->out_count;
+	stats->unknown_count += s->unknown_count;
+	stats->match_count += s->match_count;
+}
+
+static int catcierge_journal_reader_add_block(catcierge_journal_reader_t *rd,
+		const catcierge_journal_block_t *block)
+{
+	catcierge_journal_block_t *blocks;
+
+	if (!(blocks = realloc(rd->blocks, (rd->block_count + 1) * sizeof(*blocks))))
+	{
+		CATERR("Out of memory!\n");
+		return -1;
+	}
+
+	rd->blocks = blocks;
+	rd->blocks[rd->block_count++] = *block;
+	catcierge_journal_stats_merge(&rd->stats, &block->stats);
+
+	return 0;
+}
+
+static uint64_t catcierge_journal_find_last_index(const catcierge_journal_reader_t *rd)
+{
+	uint64_t off;
+	uint32_t len;
+	char type;
+
+	if (rd->size < (CATCIERGE_JOURNAL_HEADER_SIZE + CATCIERGE_JOURNAL_INDEX_SIZE))
+		return 0;
+
+	// At most one block of events after the last index block,
+	// unless the writer crashed before it got to write it.
+	for (off = rd->size - CATCIERGE_JOURNAL_INDEX_SIZE;
+		off >= CATCIERGE_JOURNAL_HEADER_SIZE; off--)
+	{
+		if (!memcmp(rd->data + off, CATCIERGE_JOURNAL_INDEX_MAGIC, 4)
+			&& !catcierge_journal_check_record(rd->data, rd->size, off, &type, &len))
+		{
+			return off;
+		}
+	}
+
+	return 0;
+}
+
+static int catcierge_journal_reader_load_index(catcierge_journal_reader_t *rd)
+{
+	uint64_t off = catcierge_journal_find_last_index(rd);
+	uint64_t prev;
+	uint32_t len;
+	char type;
+	catcierge_journal_block_t block;
+	catcierge_journal_block_t *blocks = NULL;
+	catcierge_journal_block_t *tmp;
+	size_t count = 0;
+	size_t i;
+
+	rd->last_index = off;
+
+	// Walk back through the index blocks.
+	while (off)
+	{
+		if (catcierge_journal_check_record(rd->data, rd->size, off, &type, &len)
+			|| (type != 'I'))
+		{
+			break;
+		}
+
+		memset(&block, 0, sizeof(block));
+		catcierge_journal_decode_index(rd->data + off, off, &prev, &block);
+
+		if ((block.offset < CATCIERGE_JOURNAL_HEADER_SIZE) || (block.offset > off)
+			|| (prev >= off) || (prev && (prev + CATCIERGE_JOURNAL_INDEX_SIZE != block.offset)))
+		{
+			break;
+		}
+
+		if (!(tmp = realloc(blocks, (count + 1) * sizeof(*blocks))))
+		{
+			CATERR("Out of memory!\n");
+			free(blocks);
+			return -1;
+		}
+
+		blocks = tmp;
+		blocks[count++] = block;
+		off = prev;
+	}
+
+	if (off)
+	{
+		// A broken link, the events are scanned instead.
+		CATERR("Invalid journal index block at %llu, scanning the journal\n",
+			(unsigned long long)off);
+		free(blocks);
+		rd->last_index = 0;
+		return 0;
+	}
+
+	for (i = count; i > 0; i--)
+	{
+		if (catcierge_journal_reader_add_block(rd, &blocks[i - 1]))
+		{
+			free(blocks);
+			return -1;
+		}
+	}
+
+	free(blocks);
+
+	return 0;
+}
+
+int catcierge_journal_reader_open(catcierge_journal_reader_t *rd, const char *path)
+{
+	FILE *f = NULL;
+	int64_t size;
+	uint64_t off;
+	uint32_t len;
+	char type;
+	catcierge_journal_event_t e;
+	catcierge_journal_block_t tail;
+	assert(rd);
+	assert(path);
+	memset(rd, 0, sizeof(*rd));
+
+	if (!(f = fopen(path, "rb"))
+		|| catcierge_fseek(f, 0, SEEK_END)
+		|| ((size = catcierge_ftell(f)) < CATCIERGE_JOURNAL_HEADER_SIZE))
+	{
+		CATERR("Failed to open journal %s\n", path);
+		goto fail;
+	}
+
+	rd->size = (uint64_t)size;
+
+	#ifdef CATCIERGE_HAVE_SYS_MMAN_H
+	if ((rd->data = mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, fileno(f), 0)) != MAP_FAILED)
+	{
+		rd->mapped = 1;
+	}
+	else
+	{
+		rd->data = NULL;
+	}
+	#endif
+
+	if (!rd->mapped)
+	{
+		if (!(rd->data = malloc((size_t)size))
+			|| catcierge_fseek(f, 0, SEEK_SET)
+			|| (fread(rd->data, 1, (size_t)size, f) != (size_t)size))
+		{
+			CATERR("Failed to read journal %s\n", path);
+			goto fail;
+		}
+	}
+
+	fclose(f);
+	f = NULL;
+
+	if (memcmp(rd->data, CATCIERGE_JOURNAL_MAGIC, 4))
+	{
+		CATERR("%s is not a catcierge journal\n", path);
+		goto fail;
+	}
+
+	if (catcierge_get_u32(rd->data + 4) > CATCIERGE_JOURNAL_VERSION)
+	{
+		CATERR("Journal version %u is newer than the supported version %d\n",
+			catcierge_get_u32(rd->data + 4), CATCIERGE_JOURNAL_VERSION);
+		goto fail;
+	}
+
+	if (catcierge_journal_reader_load_index(rd))
+	{
+		goto fail;
+	}
+
+	// Events after the latest index block.
+	memset(&tail, 0, sizeof(tail));
+	tail.offset = rd->last_index
+		? (rd->last_index + CATCIERGE_JOURNAL_INDEX_SIZE)
+		: CATCIERGE_JOURNAL_HEADER_SIZE;
+	off = tail.offset;
+
+	while (!catcierge_journal_check_record(rd->data, rd->size, off, &type, &len))
+	{
+		// Index blocks are only passed here if the index is broken.
+		if (type == 'E')
+		{
+			catcierge_journal_decode_event(rd->data + off, len, &e);
+			catcierge_journal_stats_add(&tail.stats, &e);
+		}
+
+		off += len;
+	}
+
+	tail.end = off;
+	rd->end = off;
+
+	if (catcierge_journal_reader_add_block(rd, &tail))
+	{
+		goto fail;
+	}
+
+	return 0;
+
+fail:
+	if (f) fclose(f);
+	catcierge_journal_reader_close(rd);
+	return -1;
+}
+
+void catcierge_journal_reader_close(catcierge_journal_reader_t *rd)
+{
+	assert(rd);
+
+	#ifdef CATCIERGE_HAVE_SYS_MMAN_H
+	if (rd->mapped)
+	{
+		munmap(rd->data, (size_t)rd->size);
+		rd->data = NULL;
+	}
+	#endif
+
+	catcierge_xfree(&rd->data);
+	catcierge_xfree(&rd->blocks);
+	memset(rd, 0, sizeof(*rd));
+}
+
+static int catcierge_journal_block_scan(const catcierge_journal_reader_t *rd,
+		const catcierge_journal_block_t *block, uint64_t from_us, uint64_t to_us,
+		catcierge_journal_event_cb cb, void *user)
+{
+	uint64_t off = block->offset;
+	uint32_t len;
+	char type;
+	catcierge_journal_event_t e;
+	int ret;
+
+	while ((off < block->end)
+		&& !catcierge_journal_check_record(rd->data, rd->size, off, &type, &len))
+	{
+		if (type == 'E')
+		{
+			catcierge_journal_decode_event(rd->data + off, len, &e);
+
+			if ((e.time_us >= from_us) && (e.time_us <= to_us)
+				&& (ret = cb(&e, user)))
+			{
+				return ret;
+			}
+		}
+
+		off += len;
+	}
+
+	return 0;
+}
+
+int catcierge_journal_reader_foreach(const catcierge_journal_reader_t *rd,
+		uint64_t from_us, uint64_t to_us, catcierge_journal_event_cb cb, void *user)
+{
+	size_t i;
+	const catcierge_journal_block_t *b;
+	int ret;
+	assert(rd);
+	assert(cb);
+
+	for (i = 0; i < rd->block_count; i++)
+	{
+		b = &rd->blocks[i];
+
+		if ((b->stats.count == 0)
+			|| (b->stats.last_us < from_us) || (b->stats.first_us > to_us))
+		{
+			continue;
+		}
+
+		if ((ret = catcierge_journal_block_scan(rd, b, from_us, to_us, cb, user)))
+		{
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+static int catcierge_journal_stats_cb(const catcierge_journal_event_t *e, void *user)
+{
+	catcierge_journal_stats_add((catcierge_journal_stats_t *)user, e);
+	return 0;
+}
+
+void catcierge_journal_reader_stats(const catcierge_journal_reader_t *rd,
+		uint64_t from_us, uint64_t to_us, catcierge_journal_stats_t *stats)
+{
+	size_t i;
+	const catcierge_journal_block_t *b;
+	assert(rd);
+	assert(stats);
+	memset(stats, 0, sizeof(*stats));
+
+	for (i = 0; i < rd->block_count; i++)
+	{
+		b = &rd->blocks[i];
+
+		if ((b->stats.count == 0)
+			|| (b->stats.last_us < from_us) || (b->stats.first_us > to_us))
+		{
+			continue;
+		}
+
+		// Only the blocks on the edges of the range are read.
+		if ((b->stats.first_us >= from_us) && (b->stats.last_us <= to_us))
+		{
+			catcierge_journal_stats_merge(stats, &b->stats);
+		}
+		else
+		{
+			catcierge_journal_block_scan(rd, b, from_us, to_us,
+				catcierge_journal_stats_cb, stats);
+		}
+	}
+}
+
+static int catcierge_journal_write_index(catcierge_journal_t *j)
+{
+	unsigned char b[CATCIERGE_JOURNAL_INDEX_SIZE];
+
+	catcierge_journal_encode_index(b, j->last_index, &j->pending);
+
+	if ((fwrite(b, 1, sizeof(b), j->f) != sizeof(b)) || fflush(j->f))
+	{
+		CATERR("Failed to write journal index block to %s\n", j->path);
+		return -1;
+	}
+
+	j->last_index = j->size;
+	j->size += sizeof(b);
+	memset(&j->pending, 0, sizeof(j->pending));
+	j->pending.offset = j->size;
+	j->pending.end = j->size;
+
+	return 0;
+}
+
+static int catcierge_journal_create(catcierge_journal_t *j)
+{
+	unsigned char b[CATCIERGE_JOURNAL_HEADER_SIZE];
+
+	memset(b, 0, sizeof(b));
+	memcpy(b, CATCIERGE_JOURNAL_MAGIC, 4);
+	catcierge_put_u32(b + 4, CATCIERGE_JOURNAL_VERSION);
+	catcierge_put_u32(b + 8, CATCIERGE_JOURNAL_BLOCK_EVENTS);
+
+	if (!(j->f = fopen(j->path, "w+b"))
+		|| (fwrite(b, 1, sizeof(b), j->f) != sizeof(b))
+		|| fflush(j->f))
+	{
+		CATERR("Failed to create journal %s\n", j->path);
+		return -1;
+	}
+
+	j->size = sizeof(b);
+	j->last_index = 0;
+	j->pending.offset = j->size;
+	j->pending.end = j->size;
+
+	return 0;
+}
+
+int catcierge_journal_open(catcierge_journal_t *j, const char *path)
+{
+	FILE *f;
+	catcierge_journal_reader_t rd;
+	assert(j);
+	assert(path);
+	memset(j, 0, sizeof(*j));
+
+	if (!(j->path = strdup(path)))
+	{
+		CATERR("Out of memory!\n");
+		return -1;
+	}
+
+	if (!(f = fopen(path, "rb")))
+	{
+		if (catcierge_journal_create(j))
+			goto fail;
+
+		return 0;
+	}
+
+	fclose(f);
+
+	if (catcierge_journal_reader_open(&rd, path))
+	{
+		goto fail;
+	}
+
+	j->size = rd.end;
+	j->last_index = rd.last_index;
+	j->pending = rd.blocks[rd.block_count - 1];
+
+	if (rd.end < rd.size)
+	{
+		CATLOG("Journal %s has %llu bytes of broken records at the end, truncating\n",
+			path, (unsigned long long)(rd.size - rd.end));
+	}
+
+	catcierge_journal_reader_close(&rd);
+
+	if (!(j->f = fopen(path, "r+b"))
+		|| fflush(j->f) || catcierge_ftruncate(j->f, (int64_t)j->size)
+		|| catcierge_fseek(j->f, (int64_t)j->size, SEEK_SET))
+	{
+		CATERR("Failed to open journal %s for writing\n", path);
+		goto fail;
+	}
+
+	if ((j->pending.stats.count >= CATCIERGE_JOURNAL_BLOCK_EVENTS)
+		&& catcierge_journal_write_index(j))
+	{
+		goto fail;
+	}
+
+	return 0;
+
+fail:
+	catcierge_journal_close(j);
+	return -1;
+}
+
+void catcierge_journal_close(catcierge_journal_t *j)
+{
+	assert(j);
+
+	if (j->f)
+	{
+		fclose(j->f);
+		j->f = NULL;
+	}
+
+	catcierge_xfree(&j->path);
+}
+
+int catcierge_journal_append(catcierge_journal_t *j, const catcierge_journal_event_t *e)
+{
+	unsigned char b[CATCIERGE_JOURNAL_EVENT_SIZE
+		+ CATCIERGE_JOURNAL_MAX_MATCHES * CATCIERGE_JOURNAL_MATCH_SIZE];
+	size_t len;
+	assert(j);
+	assert(e);
+
+	if (!j->f)
+		return -1;
+
+	len = catcierge_journal_encode_event(b, e);
+
+	// Flushed record by record, so a crash loses at most the one being written.
+	if ((fwrite(b, 1, len, j->f) != len) || fflush(j->f))
+	{
+		CATERR("Failed to write journal record to %s\n", j->path);
+		return -1;
+	}
+
+	j->size += len;
+	j->pending.end = j->size;
+	catcierge_journal_stats_add(&j->pending.stats, e);
+
+	if (j->pending.stats.count >= CATCIERGE_JOURNAL_BLOCK_EVENTS)
+	{
+		return catcierge_journal_write_index(j);
+	}
+
+	return 0;
+}
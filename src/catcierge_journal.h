@@ -0,0 +1,141 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_JOURNAL_H__
+#define __CATCIERGE_JOURNAL_H__
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "catcierge_types.h"
+
+#define CATCIERGE_JOURNAL_VERSION 1
+#define CATCIERGE_JOURNAL_HEADER_SIZE 16
+#define CATCIERGE_JOURNAL_RECORD_HEADER_SIZE 12
+#define CATCIERGE_JOURNAL_EVENT_SIZE 52	// Without the matches.
+#define CATCIERGE_JOURNAL_MATCH_SIZE 8
+#define CATCIERGE_JOURNAL_INDEX_SIZE 68
+#define CATCIERGE_JOURNAL_MAX_MATCHES 32
+#define CATCIERGE_JOURNAL_BLOCK_EVENTS 256	// Events between index blocks.
+#define CATCIERGE_JOURNAL_TIME_MAX UINT64_MAX
+
+// Event flags.
+#define CATCIERGE_JOURNAL_FINAL_DECISION	(1 << 0)
+#define CATCIERGE_JOURNAL_EARLY_DECISION	(1 << 1)
+#define CATCIERGE_JOURNAL_RFID_IN			(1 << 2)	// Inner reader triggered.
+#define CATCIERGE_JOURNAL_RFID_IN_ALLOWED	(1 << 3)
+#define CATCIERGE_JOURNAL_RFID_OUT			(1 << 4)	// Outer reader triggered.
+#define CATCIERGE_JOURNAL_RFID_OUT_ALLOWED	(1 << 5)
+
+typedef struct catcierge_journal_match_s
+{
+	float result;
+	int success;
+	match_direction_t direction;
+	int reused;
+} catcierge_journal_match_t;
+
+// A match group.
+typedef struct catcierge_journal_event_s
+{
+	uint64_t time_us;		// Start of the match group.
+	uint32_t duration_ms;
+	int success;
+	match_direction_t direction;
+	match_direction_t rfid_direction;
+	int success_count;
+	int flags;
+	uint32_t id[5];			// SHA1 of the match group.
+	size_t match_count;
+	catcierge_journal_match_t matches[CATCIERGE_JOURNAL_MAX_MATCHES];
+} catcierge_journal_event_t;
+
+// Counts over a number of events. A failed match group is a lockout.
+typedef struct catcierge_journal_stats_s
+{
+	uint64_t first_us;
+	uint64_t last_us;
+	unsigned long count;
+	unsigned long success_count;
+	unsigned long in_count;
+	unsigned long out_count;
+	unsigned long unknown_count;
+	unsigned long match_count;
+} catcierge_journal_stats_t;
+
+// The events between two index blocks.
+typedef struct catcierge_journal_block_s
+{
+	uint64_t offset;		// First event.
+	uint64_t end;			// End of the last event.
+	catcierge_journal_stats_t stats;
+} catcierge_journal_block_t;
+
+//
+// Append-only journal with a small binary record per match group.
+// Every CATCIERGE_JOURNAL_BLOCK_EVENTS events an index block with the
+// time range and counts of the events before it is appended, which
+// links back to the previous index block. Readers walk the index
+// blocks back from the end of the file, so aggregates over a time
+// range only read the events of the blocks partly in the range.
+//
+// Each record has a CRC, and a half written record at the end after
+// a crash is cut off when the journal is opened again.
+//
+typedef struct catcierge_journal_s
+{
+	char *path;
+	FILE *f;
+	uint64_t size;
+	uint64_t last_index;	// Offset of the latest index block, 0 if none.
+	catcierge_journal_block_t pending; // Events since the latest index block.
+} catcierge_journal_t;
+
+typedef struct catcierge_journal_reader_s
+{
+	unsigned char *data;
+	uint64_t size;
+	int mapped;
+	uint64_t end;			// End of the last valid record.
+	uint64_t last_index;	// Offset of the latest index block, 0 if none.
+	catcierge_journal_block_t *blocks; // The last one holds the events after the latest index block.
+	size_t block_count;
+	catcierge_journal_stats_t stats; // All events.
+} catcierge_journal_reader_t;
+
+typedef int (*catcierge_journal_event_cb)(const catcierge_journal_event_t *e, void *user);
+
+int catcierge_journal_open(catcierge_journal_t *j, const char *path);
+void catcierge_journal_close(catcierge_journal_t *j);
+int catcierge_journal_append(catcierge_journal_t *j, const catcierge_journal_event_t *e);
+
+int catcierge_journal_reader_open(catcierge_journal_reader_t *rd, const char *path);
+void catcierge_journal_reader_close(catcierge_journal_reader_t *rd);
+
+// Counts the events in [from_us, to_us].
+void catcierge_journal_reader_stats(const catcierge_journal_reader_t *rd,
+		uint64_t from_us, uint64_t to_us, catcierge_journal_stats_t *stats);
+
+// Calls cb for each event in [from_us, to_us] until it returns non-zero.
+int catcierge_journal_reader_foreach(const catcierge_journal_reader_t *rd,
+		uint64_t from_us, uint64_t to_us, catcierge_journal_event_cb cb, void *user);
+
+void catcierge_journal_stats_add(catcierge_journal_stats_t *stats,
+		const catcierge_journal_event_t *e);
+
+#endif // __CATCIERGE_JOURNAL_H__
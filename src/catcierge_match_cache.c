@@ -0,0 +1,161 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "catcierge_match_cache.h"
+#include "catcierge_log.h"
+
+int catcierge_match_cache_init(catcierge_match_cache_t *c)
+{
+	CvSize sig_size = cvSize(CATCIERGE_MATCH_CACHE_SIG_WIDTH,
+							CATCIERGE_MATCH_CACHE_SIG_HEIGHT);
+	assert(c);
+	memset(c, 0, sizeof(catcierge_match_cache_t));
+
+	if (!(c->sig = cvCreateImage(sig_size, IPL_DEPTH_8U, 1))
+	 || !(c->last_sig = cvCreateImage(sig_size, IPL_DEPTH_8U, 1))
+	 || !(c->diff = cvCreateImage(sig_size, IPL_DEPTH_8U, 1)))
+	{
+		CATERR("Out of memory!\n");
+		catcierge_match_cache_destroy(c);
+		return -1;
+	}
+
+	return 0;
+}
+
+void catcierge_match_cache_destroy(catcierge_match_cache_t *c)
+{
+	assert(c);
+
+	if (c->gray)
+		cvReleaseImage(&c->gray);
+
+	if (c->sig)
+		cvReleaseImage(&c->sig);
+
+	if (c->last_sig)
+		cvReleaseImage(&c->last_sig);
+
+	if (c->diff)
+		cvReleaseImage(&c->diff);
+
+	c->has_result = 0;
+}
+
+void catcierge_match_cache_reset(catcierge_match_cache_t *c)
+{
+	assert(c);
+	c->has_result = 0;
+	c->diff_mean = 0.0;
+}
+
+static int catcierge_match_cache_signature(catcierge_match_cache_t *c, const IplImage *img)
+{
+	const IplImage *gray = img;
+
+	if (img->nChannels != 1)
+	{
+		if (!c->gray
+			|| (c->gray->width != img->width)
+			|| (c->gray->height != img->height))
+		{
+			if (c->gray)
+				cvReleaseImage(&c->gray);
+
+			if (!(c->gray = cvCreateImage(cvGetSize(img), IPL_DEPTH_8U, 1)))
+			{
+				CATERR("Out of memory!\n");
+				return -1;
+			}
+		}
+
+		cvCvtColor(img, c->gray, CV_BGR2GRAY);
+		gray = c->gray;
+	}
+
+	// Averaging over the area also gets rid of most of the sensor noise.
+	cvResize(gray, c->sig, CV_INTER_AREA);
+
+	return 0;
+}
+
+int catcierge_match_cache_lookup(catcierge_match_cache_t *c,
+	const IplImage *img, double threshold, match_result_t *result)
+{
+	assert(c);
+	assert(c->sig);
+	assert(img);
+	assert(result);
+
+	if (catcierge_match_cache_signature(c, img))
+	{
+		return -1;
+	}
+
+	if (!c->has_result)
+	{
+		c->misses++;
+		return 0;
+	}
+
+	cvAbsDiff(c->sig, c->last_sig, c->diff);
+	c->diff_mean = cvAvg(c->diff, NULL).val[0];
+
+	if (c->diff_mean >= threshold)
+	{
+		c->misses++;
+		return 0;
+	}
+
+	result->result = c->result.result;
+	result->success = c->result.success;
+	result->direction = c->result.direction;
+	result->rect_count = c->result.rect_count;
+	memcpy(result->match_rects, c->result.match_rects, sizeof(result->match_rects));
+	snprintf(result->description, sizeof(result->description) - 1,
+		"%s", c->result.description);
+	result->step_img_count = 0;
+	result->reused = 1;
+	c->hits++;
+
+	return 1;
+}
+
+void catcierge_match_cache_store(catcierge_match_cache_t *c, const match_result_t *result)
+{
+	IplImage *tmp;
+	assert(c);
+	assert(result);
+
+	// The signature of the frame becomes the reference for the next one.
+	tmp = c->last_sig;
+	c->last_sig = c->sig;
+	c->sig = tmp;
+
+	c->result.result = result->result;
+	c->result.success = result->success;
+	c->result.direction = result->direction;
+	c->result.rect_count = result->rect_count;
+	memcpy(c->result.match_rects, result->match_rects, sizeof(c->result.match_rects));
+	snprintf(c->result.description, sizeof(c->result.description) - 1,
+		"%s", result->description);
+	c->has_result = 1;
+}
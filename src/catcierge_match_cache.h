@@ -0,0 +1,61 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_MATCH_CACHE_H__
+#define __CATCIERGE_MATCH_CACHE_H__
+
+#include <opencv2/imgproc/imgproc_c.h>
+#include "catcierge_types.h"
+
+// Size of the downsampled frame signature.
+#define CATCIERGE_MATCH_CACHE_SIG_WIDTH 32
+#define CATCIERGE_MATCH_CACHE_SIG_HEIGHT 24
+
+//
+// Keeps a tiny signature of the last matched frame together with its
+// match result. When a new frame is close enough to the last one
+// (a cat sitting still in front of the door) the cached result can
+// be reused instead of running the matcher again.
+//
+typedef struct catcierge_match_cache_s
+{
+	IplImage *gray;
+	IplImage *sig;			// Signature of the current frame.
+	IplImage *last_sig;		// Signature of the last matched frame.
+	IplImage *diff;
+	int has_result;
+	double diff_mean;		// Mean pixel difference of the last lookup.
+	match_result_t result;	// Cached result, without any step images.
+	unsigned long hits;
+	unsigned long misses;
+} catcierge_match_cache_t;
+
+int catcierge_match_cache_init(catcierge_match_cache_t *c);
+void catcierge_match_cache_destroy(catcierge_match_cache_t *c);
+void catcierge_match_cache_reset(catcierge_match_cache_t *c);
+
+// Returns 1 and fills in result if the frame differs less than
+// threshold (mean pixel difference 0-255) from the last stored frame.
+// Returns 0 on a miss, and -1 on error.
+int catcierge_match_cache_lookup(catcierge_match_cache_t *c,
+	const IplImage *img, double threshold, match_result_t *result);
+
+// Store the result of the frame passed to the last lookup.
+void catcierge_match_cache_store(catcierge_match_cache_t *c, const match_result_t *result);
+
+#endif // __CATCIERGE_MATCH_CACHE_H__
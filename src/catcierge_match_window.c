@@ -0,0 +1,153 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "catcierge_match_window.h"
+#include "catcierge_log.h"
+
+int catcierge_match_window_init(catcierge_match_window_t *w, size_t size)
+{
+	assert(w);
+	memset(w, 0, sizeof(catcierge_match_window_t));
+
+	if ((size == 0) || (size > CATCIERGE_MAX_STREAM_WINDOW))
+	{
+		CATERR("Invalid match window size %d\n", (int)size);
+		return -1;
+	}
+
+	if (!(w->entries = calloc(size, sizeof(catcierge_match_window_entry_t))))
+	{
+		CATERR("Out of memory!\n");
+		return -1;
+	}
+
+	w->size = size;
+	catcierge_match_window_reset(w);
+
+	return 0;
+}
+
+void catcierge_match_window_destroy(catcierge_match_window_t *w)
+{
+	assert(w);
+
+	if (w->entries)
+	{
+		free(w->entries);
+		w->entries = NULL;
+	}
+
+	w->size = 0;
+	catcierge_match_window_reset(w);
+}
+
+void catcierge_match_window_reset(catcierge_match_window_t *w)
+{
+	assert(w);
+	w->count = 0;
+	w->head = 0;
+	w->total = 0;
+	w->success_count = 0;
+	w->in_count = 0;
+	w->out_count = 0;
+	w->unknown_count = 0;
+	w->last_success = 0;
+	w->last_success_direction = MATCH_DIR_UNKNOWN;
+}
+
+static void catcierge_match_window_count(catcierge_match_window_t *w,
+		const catcierge_match_window_entry_t *e, int add)
+{
+	w->success_count += e->success ? add : 0;
+
+	switch (e->direction)
+	{
+		case MATCH_DIR_IN: w->in_count += add; break;
+		case MATCH_DIR_OUT: w->out_count += add; break;
+		case MATCH_DIR_UNKNOWN: w->unknown_count += add; break;
+	}
+}
+
+void catcierge_match_window_push(catcierge_match_window_t *w, const match_result_t *res)
+{
+	catcierge_match_window_entry_t *e;
+	assert(w);
+	assert(w->entries);
+	assert(res);
+
+	if (w->count == w->size)
+	{
+		// Drop the oldest result.
+		e = &w->entries[w->head];
+		catcierge_match_window_count(w, e, -1);
+		w->head = (w->head + 1) % w->size;
+		w->count--;
+	}
+
+	e = &w->entries[(w->head + w->count) % w->size];
+	e->success = !!res->success;
+	e->direction = res->direction;
+	catcierge_match_window_count(w, e, 1);
+	w->count++;
+	w->total++;
+
+	if (e->success)
+	{
+		w->last_success = w->total;
+		w->last_success_direction = e->direction;
+	}
+}
+
+int catcierge_match_window_is_full(const catcierge_match_window_t *w)
+{
+	assert(w);
+	return (w->size > 0) && (w->count == w->size);
+}
+
+match_direction_t catcierge_match_window_direction(const catcierge_match_window_t *w)
+{
+	assert(w);
+
+	if ((w->in_count > w->out_count) && (w->in_count > w->unknown_count))
+	{
+		return MATCH_DIR_IN;
+	}
+	else if (w->out_count > w->unknown_count)
+	{
+		return MATCH_DIR_OUT;
+	}
+
+	return MATCH_DIR_UNKNOWN;
+}
+
+match_direction_t catcierge_match_window_success_direction(const catcierge_match_window_t *w)
+{
+	assert(w);
+
+	// The latest success has fallen out of the window,
+	// which means there are no successes left in it.
+	if ((w->last_success == 0) || (w->last_success <= (w->total - w->count)))
+	{
+		return MATCH_DIR_UNKNOWN;
+	}
+
+	return w->last_success_direction;
+}
@@ -0,0 +1,67 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_MATCH_WINDOW_H__
+#define __CATCIERGE_MATCH_WINDOW_H__
+
+#include <stddef.h>
+#include "catcierge_types.h"
+
+#define CATCIERGE_MAX_STREAM_WINDOW 64
+
+typedef struct catcierge_match_window_entry_s
+{
+	int success;
+	match_direction_t direction;
+} catcierge_match_window_entry_t;
+
+//
+// Sliding window over the last N match results. The counters are
+// updated as results are pushed and fall out of the window, so
+// adding a new result is O(1) no matter the size of the window.
+//
+typedef struct catcierge_match_window_s
+{
+	catcierge_match_window_entry_t *entries;
+	size_t size;			// Max number of results in the window.
+	size_t count;			// Current number of results in the window.
+	size_t head;			// Index of the oldest result.
+	size_t total;			// Total number of results pushed since reset.
+
+	int success_count;
+	int in_count;
+	int out_count;
+	int unknown_count;
+
+	size_t last_success;	// Sequence number (1-based) of the latest success, 0 if none.
+	match_direction_t last_success_direction;
+} catcierge_match_window_t;
+
+int catcierge_match_window_init(catcierge_match_window_t *w, size_t size);
+void catcierge_match_window_destroy(catcierge_match_window_t *w);
+void catcierge_match_window_reset(catcierge_match_window_t *w);
+void catcierge_match_window_push(catcierge_match_window_t *w, const match_result_t *res);
+int catcierge_match_window_is_full(const catcierge_match_window_t *w);
+
+// Overall direction based on the direction counts (haar style).
+match_direction_t catcierge_match_window_direction(const catcierge_match_window_t *w);
+
+// Direction of the latest successful match in the window (template style).
+match_direction_t catcierge_match_window_success_direction(const catcierge_match_window_t *w);
+
+#endif // __CATCIERGE_MATCH_WINDOW_H__
@@ -31,6 +31,10 @@
 #include "catcierge_matcher.h"
 #include "catcierge_template_matcher.h"
 #include "catcierge_haar_matcher.h"
+#include "catcierge_chain_matcher.h"
+#ifdef WITH_DNN
+#include "catcierge_dnn_matcher.h"
+#endif
 #include "catcierge_log.h"
 
 int catcierge_matcher_init(catcierge_matcher_t **ctx, catcierge_matcher_args_t *args)
@@ -51,6 +55,22 @@ int catcierge_matcher_init(catcierge_matcher_t **ctx, catcierge_matcher_args_t *
 			return -1;
 		}
 	}
+	else if (args->type == MATCHER_CHAIN)
+	{
+		if (catcierge_chain_matcher_init(ctx, args))
+		{
+			return -1;
+		}
+	}
+	#ifdef WITH_DNN
+	else if (args->type == MATCHER_DNN)
+	{
+		if (catcierge_dnn_matcher_init(ctx, args))
+		{
+			return -1;
+		}
+	}
+	#endif // WITH_DNN
 	else
 	{
 		CATERR("Failed to init matcher. Invalid matcher type given\n");
@@ -81,6 +101,16 @@ void catcierge_matcher_destroy(catcierge_matcher_t **ctx)
 		{
 			catcierge_haar_matcher_destroy(ctx);
 		}
+		else if (c->type == MATCHER_CHAIN)
+		{
+			catcierge_chain_matcher_destroy(ctx);
+		}
+		#ifdef WITH_DNN
+		else if (c->type == MATCHER_DNN)
+		{
+			catcierge_dnn_matcher_destroy(ctx);
+		}
+		#endif // WITH_DNN
 	}
 
 	*ctx = NULL;
@@ -34,9 +34,18 @@ typedef double (*catcierge_match_func_t)(void *ctx,
 
 typedef int (*catcierge_decide_func_t)(void *ctx, match_group_t *mg);
 
+// Optional, called when all matches of a group are made, before the
+// lock decision. Lets a matcher evaluate all frames of the group at once.
+typedef int (*catcierge_group_match_func_t)(void *ctx, match_group_t *mg);
+
 typedef const char *(*catcierge_matcher_translate_func_t)(struct catcierge_matcher_s *octx, const char *var,
 														  char *buf, size_t bufsize);
 
+// Returns the name of the idx:th variable the matcher can translate,
+// or NULL when there are no more. Lets all of them be rendered up front.
+typedef const char *(*catcierge_matcher_var_name_func_t)(struct catcierge_matcher_s *octx, size_t idx,
+														 char *buf, size_t bufsize);
+
 typedef int (*catcierge_is_obstruct_func_t)(struct catcierge_matcher_s *ctx, const IplImage *img);
 
 typedef struct catcierge_matcher_args_s
@@ -56,7 +65,9 @@ typedef struct catcierge_matcher_s
 	int debug;
 	catcierge_match_func_t match;
 	catcierge_decide_func_t decide;
+	catcierge_group_match_func_t group_match;
 	catcierge_matcher_translate_func_t translate;
+	catcierge_matcher_var_name_func_t var_name;
 	catcierge_is_obstruct_func_t is_obstructed;
 	catcierge_matcher_args_t *args;
 } catcierge_matcher_t;
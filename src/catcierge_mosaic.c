@@ -0,0 +1,563 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <catcierge_config.h>
+#include "catcierge_mosaic.h"
+#include "catcierge_util.h"
+#include "catcierge_log.h"
+
+#define CATCIERGE_MOSAIC_PAD 8
+#define CATCIERGE_MOSAIC_HEADER 52
+#define CATCIERGE_MOSAIC_CAPTION 24
+#define CATCIERGE_MOSAIC_THUMB_GAP 4
+#define CATCIERGE_MOSAIC_THUMB_CAPTION 14
+#define CATCIERGE_MOSAIC_BG CV_RGB(0x8a, 0x96, 0x8e)	// Same as catcierge-compose.py
+#define CATCIERGE_MOSAIC_OK CV_RGB(0, 160, 0)
+#define CATCIERGE_MOSAIC_FAIL CV_RGB(200, 0, 0)
+#define CATCIERGE_MOSAIC_TEXT CV_RGB(255, 255, 255)
+
+catcierge_mosaic_job_t *catcierge_mosaic_job_create(match_group_t *mg,
+		const char *path, int take_images)
+{
+	catcierge_mosaic_job_t *job = NULL;
+	catcierge_mosaic_match_t *jm;
+	match_state_t *m;
+	match_step_t *step;
+	struct tm *tm;
+	char time_str[64];
+	size_t i;
+	size_t j;
+	assert(mg);
+	assert(path);
+
+	if (!(job = calloc(1, sizeof(catcierge_mosaic_job_t)))
+		|| !(job->path = strdup(path)))
+	{
+		CATERR("Out of memory!\n");
+		catcierge_xfree(&job);
+		return NULL;
+	}
+
+	gettimeofday(&job->queued_tv, NULL);
+	job->success = mg->success;
+	job->match_count = (mg->match_count > MATCH_MAX_COUNT) ? MATCH_MAX_COUNT : mg->match_count;
+
+	if (!(tm = localtime(&mg->start_time))
+		|| !strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm))
+	{
+		time_str[0] = '\0';
+	}
+
+	snprintf(job->caption, sizeof(job->caption), "%s  %s  %s  %d/%d",
+		time_str, mg->success ? "OK" : "LOCKOUT",
+		catcierge_get_direction_str(mg->direction),
+		mg->success_count, (int)mg->match_count);
+	snprintf(job->description, sizeof(job->description), "%s", mg->description);
+
+	for (i = 0; i < job->match_count; i++)
+	{
+		m = &mg->matches[i];
+		jm = &job->matches[i];
+
+		if (take_images)
+		{
+			jm->img = m->img;
+			m->img = NULL;
+		}
+		else if (m->img)
+		{
+			jm->img = cvCloneImage(m->img);
+		}
+
+		jm->rect_count = (m->result.rect_count > MAX_MATCH_RECTS)
+						? MAX_MATCH_RECTS : m->result.rect_count;
+		memcpy(jm->rects, m->result.match_rects, jm->rect_count * sizeof(CvRect));
+		jm->success = m->result.success;
+		jm->direction = m->result.direction;
+		jm->result = m->result.result;
+
+		for (j = 0; j < m->result.step_img_count && j < MAX_STEPS; j++)
+		{
+			step = &m->result.steps[j];
+
+			if (!step->img || !(jm->steps[jm->step_count] = cvCloneImage(step->img)))
+				continue;
+
+			snprintf(jm->step_names[jm->step_count], sizeof(jm->step_names[0]),
+				"%s", step->name ? step->name : "");
+			jm->step_count++;
+		}
+	}
+
+	return job;
+}
+
+void catcierge_mosaic_job_free(catcierge_mosaic_job_t *job)
+{
+	size_t i;
+	size_t j;
+
+	if (!job)
+		return;
+
+	for (i = 0; i < job->match_count; i++)
+	{
+		if (job->matches[i].img)
+			cvReleaseImage(&job->matches[i].img);
+
+		for (j = 0; j < job->matches[i].step_count; j++)
+		{
+			cvReleaseImage(&job->matches[i].steps[j]);
+		}
+	}
+
+	catcierge_xfree(&job->path);
+	free(job);
+}
+
+static int catcierge_mosaic_scaled_height(const IplImage *img, int width)
+{
+	int h;
+
+	if (!img || (img->width <= 0))
+		return 0;
+
+	h = (img->height * width) / img->width;
+
+	return (h > 0) ? h : 1;
+}
+
+// Grayscale images are converted, the mosaic is always in color.
+static void catcierge_mosaic_blit(IplImage *dst, const IplImage *src, CvRect r)
+{
+	IplImage *color = NULL;
+
+	if (!src || (r.width <= 0) || (r.height <= 0) || (src->depth != IPL_DEPTH_8U))
+		return;
+
+	if (src->nChannels == 1)
+	{
+		if (!(color = cvCreateImage(cvGetSize(src), IPL_DEPTH_8U, 3)))
+			return;
+
+		cvCvtColor(src, color, CV_GRAY2BGR);
+		src = color;
+	}
+	else if (src->nChannels != 3)
+	{
+		return;
+	}
+
+	cvSetImageROI(dst, r);
+	cvResize(src, dst, CV_INTER_AREA);
+	cvResetImageROI(dst);
+
+	if (color)
+		cvReleaseImage(&color);
+}
+
+static int catcierge_mosaic_steps_height(const catcierge_mosaic_match_t *jm, int thumb_w)
+{
+	size_t i;
+	int h = 0;
+	int row_h = 0;
+
+	for (i = 0; i < jm->step_count; i++)
+	{
+		int th = catcierge_mosaic_scaled_height(jm->steps[i], thumb_w);
+
+		if (th > row_h)
+			row_h = th;
+
+		if (((i % CATCIERGE_MOSAIC_THUMBS) == (CATCIERGE_MOSAIC_THUMBS - 1))
+			|| (i == (jm->step_count - 1)))
+		{
+			h += row_h + CATCIERGE_MOSAIC_THUMB_CAPTION + CATCIERGE_MOSAIC_THUMB_GAP;
+			row_h = 0;
+		}
+	}
+
+	return h;
+}
+
+static void catcierge_mosaic_draw_match(IplImage *mosaic, const catcierge_mosaic_match_t *jm,
+		int n, int x, int y, int width, CvFont *font, CvFont *small_font)
+{
+	int thumb_w = (width - (CATCIERGE_MOSAIC_THUMBS - 1) * CATCIERGE_MOSAIC_THUMB_GAP)
+				/ CATCIERGE_MOSAIC_THUMBS;
+	int frame_h = catcierge_mosaic_scaled_height(jm->img, width);
+	CvScalar color = jm->success ? CATCIERGE_MOSAIC_OK : CATCIERGE_MOSAIC_FAIL;
+	CvRect r;
+	char caption[128];
+	size_t i;
+	size_t j;
+	int row_h = 0;
+	int tx;
+
+	snprintf(caption, sizeof(caption), "Match %d  %s  %s  %0.2f", n,
+		jm->success ? "OK" : "FAIL",
+		catcierge_get_direction_str(jm->direction), jm->result);
+	cvPutText(mosaic, caption, cvPoint(x, y + CATCIERGE_MOSAIC_CAPTION - 7), font, color);
+	y += CATCIERGE_MOSAIC_CAPTION;
+
+	if (jm->img)
+	{
+		catcierge_mosaic_blit(mosaic, jm->img, cvRect(x, y, width, frame_h));
+
+		for (i = 0; i < jm->rect_count; i++)
+		{
+			r = jm->rects[i];
+			r.x = x + (r.x * width) / jm->img->width;
+			r.y = y + (r.y * width) / jm->img->width;
+			r.width = (r.width * width) / jm->img->width;
+			r.height = (r.height * width) / jm->img->width;
+			cvRectangleR(mosaic, r, color, 2, 8, 0);
+		}
+
+		y += frame_h + CATCIERGE_MOSAIC_PAD;
+	}
+
+	for (i = 0; i < jm->step_count; i += CATCIERGE_MOSAIC_THUMBS)
+	{
+		row_h = 0;
+
+		for (j = i; (j < jm->step_count) && (j < (i + CATCIERGE_MOSAIC_THUMBS)); j++)
+		{
+			int th = catcierge_mosaic_scaled_height(jm->steps[j], thumb_w);
+			tx = x + (int)(j - i) * (thumb_w + CATCIERGE_MOSAIC_THUMB_GAP);
+			catcierge_mosaic_blit(mosaic, jm->steps[j], cvRect(tx, y, thumb_w, th));
+
+			if (th > row_h)
+				row_h = th;
+		}
+
+		for (j = i; (j < jm->step_count) && (j < (i + CATCIERGE_MOSAIC_THUMBS)); j++)
+		{
+			tx = x + (int)(j - i) * (thumb_w + CATCIERGE_MOSAIC_THUMB_GAP);
+			cvPutText(mosaic, jm->step_names[j],
+				cvPoint(tx, y + row_h + CATCIERGE_MOSAIC_THUMB_CAPTION - 3),
+				small_font, CATCIERGE_MOSAIC_TEXT);
+		}
+
+		y += row_h + CATCIERGE_MOSAIC_THUMB_CAPTION + CATCIERGE_MOSAIC_THUMB_GAP;
+	}
+}
+
+IplImage *catcierge_mosaic_compose(const catcierge_mosaic_job_t *job, int width)
+{
+	IplImage *mosaic = NULL;
+	const catcierge_mosaic_match_t *jm;
+	CvFont font;
+	CvFont small_font;
+	int thumb_w = (width - (CATCIERGE_MOSAIC_THUMBS - 1) * CATCIERGE_MOSAIC_THUMB_GAP)
+				/ CATCIERGE_MOSAIC_THUMBS;
+	int columns = (job->match_count > 0) ? (int)job->match_count : 1;
+	int col_h;
+	int max_h = 0;
+	size_t i;
+	assert(job);
+
+	// Size the mosaic after the tallest match.
+	for (i = 0; i < job->match_count; i++)
+	{
+		jm = &job->matches[i];
+		col_h = CATCIERGE_MOSAIC_CAPTION + catcierge_mosaic_steps_height(jm, thumb_w);
+
+		if (jm->img)
+			col_h += catcierge_mosaic_scaled_height(jm->img, width) + CATCIERGE_MOSAIC_PAD;
+
+		if (col_h > max_h)
+			max_h = col_h;
+	}
+
+	if (!(mosaic = cvCreateImage(
+			cvSize(columns * width + (columns + 1) * CATCIERGE_MOSAIC_PAD,
+				CATCIERGE_MOSAIC_HEADER + max_h + CATCIERGE_MOSAIC_PAD),
+			IPL_DEPTH_8U, 3)))
+	{
+		CATERR("Failed to create mosaic image\n");
+		return NULL;
+	}
+
+	cvSet(mosaic, CATCIERGE_MOSAIC_BG, NULL);
+	cvInitFont(&font, CV_FONT_HERSHEY_SIMPLEX, 0.5, 0.5, 0, 1, CV_AA);
+	cvInitFont(&small_font, CV_FONT_HERSHEY_SIMPLEX, 0.35, 0.35, 0, 1, CV_AA);
+
+	cvPutText(mosaic, job->caption, cvPoint(CATCIERGE_MOSAIC_PAD, 20), &font,
+		job->success ? CATCIERGE_MOSAIC_OK : CATCIERGE_MOSAIC_FAIL);
+	cvPutText(mosaic, job->description, cvPoint(CATCIERGE_MOSAIC_PAD, 42), &small_font,
+		CATCIERGE_MOSAIC_TEXT);
+
+	for (i = 0; i < job->match_count; i++)
+	{
+		catcierge_mosaic_draw_match(mosaic, &job->matches[i], (int)i + 1,
+			CATCIERGE_MOSAIC_PAD + (int)i * (width + CATCIERGE_MOSAIC_PAD),
+			CATCIERGE_MOSAIC_HEADER, width, &font, &small_font);
+	}
+
+	return mosaic;
+}
+
+int catcierge_mosaic_write(catcierge_mosaic_job_t *job, int width)
+{
+	IplImage *mosaic = NULL;
+	char *dir = NULL;
+	char *sep;
+	int ret = 0;
+	assert(job);
+
+	if (!(mosaic = catcierge_mosaic_compose(job, width)))
+	{
+		ret = -1; goto fail;
+	}
+
+	if ((dir = strdup(job->path))
+		&& ((sep = strrchr(dir, '/'))
+		#ifdef _WIN32
+		|| (sep = strrchr(dir, '\\'))
+		#endif
+		))
+	{
+		*sep = '\0';
+
+		if (*dir && catcierge_make_path("%s", dir))
+		{
+			CATERR("Failed to create mosaic directory %s\n", dir);
+		}
+	}
+
+	// The format is given by the extension, .jpg is the smallest for notifications.
+	if (!cvSaveImage(job->path, mosaic, NULL))
+	{
+		CATERR("Failed to save mosaic %s\n", job->path);
+		ret = -1; goto fail;
+	}
+
+fail:
+	job->failed = (ret != 0);
+	catcierge_xfree(&dir);
+	if (mosaic) cvReleaseImage(&mosaic);
+	return ret;
+}
+
+#ifdef CATCIERGE_HAVE_PTHREAD_H
+
+static double catcierge_mosaic_elapsed(struct timeval *start)
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return (now.tv_sec - start->tv_sec) + ((now.tv_usec - start->tv_usec) / 1000000.0);
+}
+
+static void *catcierge_mosaic_worker(void *arg)
+{
+	catcierge_mosaic_t *m = (catcierge_mosaic_t *)arg;
+	catcierge_mosaic_job_t *job;
+
+	pthread_mutex_lock(&m->lock);
+
+	while (1)
+	{
+		while ((m->done == m->count) && m->running)
+		{
+			pthread_cond_wait(&m->not_empty, &m->lock);
+		}
+
+		// Write everything queued before stopping.
+		if (m->done == m->count)
+		{
+			break;
+		}
+
+		// The job stays in the queue until it is polled.
+		job = m->jobs[(m->head + m->done) % CATCIERGE_MOSAIC_QUEUE_SIZE];
+		pthread_mutex_unlock(&m->lock);
+
+		catcierge_mosaic_write(job, m->width);
+
+		pthread_mutex_lock(&m->lock);
+		m->done++;
+
+		if (job->failed)
+			m->failed_count++;
+		else
+			m->written_count++;
+	}
+
+	pthread_mutex_unlock(&m->lock);
+
+	return NULL;
+}
+
+#endif // CATCIERGE_HAVE_PTHREAD_H
+
+int catcierge_mosaic_init(catcierge_mosaic_t *m, int width)
+{
+	assert(m);
+	memset(m, 0, sizeof(catcierge_mosaic_t));
+
+	if ((width < CATCIERGE_MOSAIC_MIN_WIDTH) || (width > CATCIERGE_MOSAIC_MAX_WIDTH))
+	{
+		CATERR("Invalid mosaic width %d\n", width);
+		return -1;
+	}
+
+	m->width = width;
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	m->running = 1;
+	pthread_mutex_init(&m->lock, NULL);
+	pthread_cond_init(&m->not_empty, NULL);
+
+	if (pthread_create(&m->thread, NULL, catcierge_mosaic_worker, m))
+	{
+		CATERR("Failed to start mosaic thread\n");
+		m->running = 0;
+		pthread_mutex_destroy(&m->lock);
+		pthread_cond_destroy(&m->not_empty);
+		return -1;
+	}
+
+	return 0;
+
+	#else // !CATCIERGE_HAVE_PTHREAD_H
+
+	CATERR("Composing mosaics in the background is not supported on this platform\n");
+	return -1;
+
+	#endif // CATCIERGE_HAVE_PTHREAD_H
+}
+
+void catcierge_mosaic_destroy(catcierge_mosaic_t *m)
+{
+	assert(m);
+
+	if (!m->running)
+	{
+		return;
+	}
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	pthread_mutex_lock(&m->lock);
+	m->running = 0;
+	pthread_cond_signal(&m->not_empty);
+	pthread_mutex_unlock(&m->lock);
+
+	pthread_join(m->thread, NULL);
+
+	pthread_mutex_destroy(&m->lock);
+	pthread_cond_destroy(&m->not_empty);
+
+	CATLOG("Mosaics: %lu written, %lu failed, %lu dropped\n",
+		m->written_count, m->failed_count, m->dropped_count);
+
+	// Written but never polled.
+	while (m->count > 0)
+	{
+		catcierge_mosaic_job_free(m->jobs[m->head]);
+		m->jobs[m->head] = NULL;
+		m->head = (m->head + 1) % CATCIERGE_MOSAIC_QUEUE_SIZE;
+		m->count--;
+	}
+
+	m->done = 0;
+	#endif // CATCIERGE_HAVE_PTHREAD_H
+}
+
+int catcierge_mosaic_push(catcierge_mosaic_t *m, catcierge_mosaic_job_t *job)
+{
+	int ret = -1;
+	assert(m);
+	assert(job);
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	if (m->running)
+	{
+		pthread_mutex_lock(&m->lock);
+
+		if (m->count < CATCIERGE_MOSAIC_QUEUE_SIZE)
+		{
+			m->jobs[(m->head + m->count) % CATCIERGE_MOSAIC_QUEUE_SIZE] = job;
+			m->count++;
+			pthread_cond_signal(&m->not_empty);
+			job = NULL;
+			ret = 0;
+		}
+		else
+		{
+			m->dropped_count++;
+			CATERR("Mosaic queue full, dropped %s\n", job->path);
+		}
+
+		pthread_mutex_unlock(&m->lock);
+	}
+	#endif
+
+	catcierge_mosaic_job_free(job);
+
+	return ret;
+}
+
+int catcierge_mosaic_poll(catcierge_mosaic_t *m)
+{
+	catcierge_mosaic_job_t *job = NULL;
+	int ret = 0;
+	assert(m);
+
+	if (!m->running)
+	{
+		return 0;
+	}
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	while (!ret)
+	{
+		pthread_mutex_lock(&m->lock);
+
+		if (m->done == 0)
+		{
+			pthread_mutex_unlock(&m->lock);
+			break;
+		}
+
+		job = m->jobs[m->head];
+		m->jobs[m->head] = NULL;
+		m->head = (m->head + 1) % CATCIERGE_MOSAIC_QUEUE_SIZE;
+		m->count--;
+		m->done--;
+		pthread_mutex_unlock(&m->lock);
+
+		// Failed mosaics have no event.
+		if (!job->failed)
+		{
+			snprintf(m->path, sizeof(m->path), "%s", job->path);
+			m->last_latency = catcierge_mosaic_elapsed(&job->queued_tv);
+			ret = 1;
+		}
+
+		catcierge_mosaic_job_free(job);
+	}
+	#endif
+
+	return ret;
+}
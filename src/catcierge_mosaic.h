@@ -0,0 +1,118 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_MOSAIC_H__
+#define __CATCIERGE_MOSAIC_H__
+
+#include <stddef.h>
+#include <catcierge_config.h>
+#include "catcierge_types.h"
+
+#ifdef CATCIERGE_HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#define DEFAULT_MOSAIC_WIDTH 320	// Width of each match in the mosaic.
+#define CATCIERGE_MOSAIC_MIN_WIDTH 120
+#define CATCIERGE_MOSAIC_MAX_WIDTH 1920
+#define CATCIERGE_MOSAIC_QUEUE_SIZE 4
+#define CATCIERGE_MOSAIC_THUMBS 3	// Step thumbnails per row.
+
+typedef struct catcierge_mosaic_match_s
+{
+	IplImage *img;
+	CvRect rects[MAX_MATCH_RECTS];
+	size_t rect_count;
+	int success;
+	match_direction_t direction;
+	double result;
+	IplImage *steps[MAX_STEPS];
+	char step_names[MAX_STEPS][32];
+	size_t step_count;
+} catcierge_mosaic_match_t;
+
+// Copies of the match group frames, owned by the job.
+typedef struct catcierge_mosaic_job_s
+{
+	char *path;
+	char caption[128];
+	char description[512];
+	int success;
+	catcierge_mosaic_match_t matches[MATCH_MAX_COUNT];
+	size_t match_count;
+	int failed;
+	struct timeval queued_tv;
+} catcierge_mosaic_job_t;
+
+//
+// Builds a summary image of a match group (each match frame with its
+// match rectangles, the step images as thumbnails and captions) from
+// the frames still in memory, so the notification scripts do not have
+// to load and compose the saved images themselves.
+//
+// The mosaics are composed and written on a worker thread. The FSM
+// polls for written mosaics so it can trigger the mosaic_done event
+// for them on its own thread, with path set to the written mosaic.
+//
+typedef struct catcierge_mosaic_s
+{
+	int running;
+	int width;
+	catcierge_mosaic_job_t *jobs[CATCIERGE_MOSAIC_QUEUE_SIZE];
+	size_t count;			// Jobs in the queue.
+	size_t head;			// Index of the oldest job.
+	size_t done;			// Jobs from head that have been written (or failed).
+
+	char path[2048];		// Latest polled mosaic.
+	double last_latency;	// Seconds from the decision until it was polled.
+
+	unsigned long written_count;
+	unsigned long failed_count;
+	unsigned long dropped_count;
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	#endif
+} catcierge_mosaic_t;
+
+int catcierge_mosaic_init(catcierge_mosaic_t *m, int width);
+
+// Writes the queued mosaics and stops the worker.
+void catcierge_mosaic_destroy(catcierge_mosaic_t *m);
+
+// Copies the match frames and step images of the match group. If
+// take_images is set the match frames are taken over instead.
+catcierge_mosaic_job_t *catcierge_mosaic_job_create(match_group_t *mg,
+		const char *path, int take_images);
+void catcierge_mosaic_job_free(catcierge_mosaic_job_t *job);
+
+IplImage *catcierge_mosaic_compose(const catcierge_mosaic_job_t *job, int width);
+
+// Composes and writes the mosaic right away.
+int catcierge_mosaic_write(catcierge_mosaic_job_t *job, int width);
+
+// Takes ownership of the job. Returns -1 if it was dropped.
+int catcierge_mosaic_push(catcierge_mosaic_t *m, catcierge_mosaic_job_t *job);
+
+// Returns 1 and sets path and last_latency if another
+// mosaic has been written since the last poll.
+int catcierge_mosaic_poll(catcierge_mosaic_t *m);
+
+#endif // __CATCIERGE_MOSAIC_H__
@@ -0,0 +1,804 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <assert.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <catcierge_config.h>
+#include "catcierge_notify.h"
+#include "catcierge_util.h"
+#include "catcierge_log.h"
+
+#ifdef CATCIERGE_HAVE_NOTIFY
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#ifdef CATCIERGE_HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#endif // CATCIERGE_HAVE_NOTIFY
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define CATCIERGE_NOTIFY_REPLY_SIZE 1024
+
+int catcierge_notify_parse_target(const char *url,
+		catcierge_notify_target_t *target)
+{
+	const char *host;
+	const char *host_end;
+	const char *port = NULL;
+	const char *path;
+	size_t len;
+	assert(url);
+	assert(target);
+	memset(target, 0, sizeof(catcierge_notify_target_t));
+
+	if (!strncmp(url, "smtp://", 7))
+	{
+		target->proto = CATCIERGE_NOTIFY_SMTP;
+		strcpy(target->port, "25");
+		host = url + 7;
+	}
+	else if (!strncmp(url, "http://", 7))
+	{
+		target->proto = CATCIERGE_NOTIFY_HTTP;
+		strcpy(target->port, "80");
+		host = url + 7;
+	}
+	else
+	{
+		return -1;
+	}
+
+	if (!(path = strchr(host, '/')))
+	{
+		path = host + strlen(host);
+	}
+
+	if (*host == '[')
+	{
+		// IPv6 address.
+		host++;
+
+		if (!(host_end = strchr(host, ']')) || (host_end > path))
+		{
+			return -1;
+		}
+
+		if (host_end[1] == ':')
+			port = host_end + 2;
+		else if (host_end + 1 != path)
+			return -1;
+	}
+	else
+	{
+		host_end = path;
+
+		if ((port = memchr(host, ':', path - host)))
+		{
+			host_end = port++;
+		}
+	}
+
+	len = host_end - host;
+
+	if ((len == 0) || (len >= sizeof(target->host)))
+	{
+		return -1;
+	}
+
+	memcpy(target->host, host, len);
+
+	if (port)
+	{
+		len = path - port;
+
+		if ((len == 0) || (len >= sizeof(target->port))
+			|| (strspn(port, "0123456789") < len))
+		{
+			return -1;
+		}
+
+		memcpy(target->port, port, len);
+		target->port[len] = '\0';
+	}
+
+	if (target->proto == CATCIERGE_NOTIFY_SMTP)
+	{
+		// The recipient.
+		if (!*path || !strchr(path + 1, '@')
+			|| strpbrk(path + 1, "<>\r\n /"))
+		{
+			return -1;
+		}
+
+		path++;
+	}
+	else if (!*path)
+	{
+		path = "/";
+	}
+
+	if (strlen(path) >= sizeof(target->path)
+		|| strpbrk(path, "\r\n "))
+	{
+		return -1;
+	}
+
+	strcpy(target->path, path);
+
+	return 0;
+}
+
+void catcierge_notify_batch_free(catcierge_notify_batch_t *batch)
+{
+	size_t i;
+	assert(batch);
+
+	for (i = 0; i < batch->count; i++)
+	{
+		catcierge_xfree(&batch->lines[i]);
+	}
+
+	batch->count = 0;
+	batch->overflow = 0;
+}
+
+void catcierge_notify_settings_free(catcierge_notify_settings_t *settings)
+{
+	assert(settings);
+	catcierge_xfree(&settings->from);
+	catcierge_xfree(&settings->subject);
+}
+
+#ifdef CATCIERGE_HAVE_NOTIFY
+
+static double catcierge_notify_now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static int catcierge_notify_connect(const catcierge_notify_target_t *target,
+		int timeout)
+{
+	struct addrinfo hints;
+	struct addrinfo *res = NULL;
+	struct addrinfo *ai;
+	struct timeval tv;
+	int err;
+	int fd = -1;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	if ((err = getaddrinfo(target->host, target->port, &hints, &res)))
+	{
+		CATERR("Notify: Failed to resolve %s: %s\n", target->host, gai_strerror(err));
+		return -1;
+	}
+
+	tv.tv_sec = timeout;
+	tv.tv_usec = 0;
+
+	for (ai = res; ai; ai = ai->ai_next)
+	{
+		if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0)
+		{
+			continue;
+		}
+
+		// The send timeout also limits connect on Linux.
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+		setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+		if (!connect(fd, ai->ai_addr, ai->ai_addrlen))
+		{
+			break;
+		}
+
+		close(fd);
+		fd = -1;
+	}
+
+	freeaddrinfo(res);
+
+	if (fd < 0)
+	{
+		CATERR("Notify: Failed to connect to %s:%s: %s\n",
+			target->host, target->port, strerror(errno));
+	}
+
+	return fd;
+}
+
+static int catcierge_notify_write(int fd, const char *data, size_t len)
+{
+	ssize_t n;
+
+	while (len > 0)
+	{
+		if ((n = send(fd, data, len, MSG_NOSIGNAL)) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			CATERR("Notify: Failed to send: %s\n", strerror(errno));
+			return -1;
+		}
+
+		data += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static int catcierge_notify_printf(int fd, const char *fmt, ...)
+{
+	char buf[1024];
+	va_list ap;
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+
+	if ((len < 0) || (len >= (int)sizeof(buf)))
+	{
+		return -1;
+	}
+
+	return catcierge_notify_write(fd, buf, len);
+}
+
+// Reads a reply and returns its status code. Multi-line SMTP replies
+// have a '-' after the code on all but the last line.
+static int catcierge_notify_read_reply(int fd, int smtp)
+{
+	char buf[CATCIERGE_NOTIFY_REPLY_SIZE];
+	size_t len = 0;
+	char *line = buf;
+	char *end;
+	ssize_t n;
+
+	while (len < sizeof(buf) - 1)
+	{
+		if ((n = recv(fd, buf + len, sizeof(buf) - 1 - len, 0)) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			CATERR("Notify: Failed to read reply: %s\n", strerror(errno));
+			return -1;
+		}
+
+		if (n == 0)
+		{
+			break;
+		}
+
+		len += n;
+		buf[len] = '\0';
+
+		while ((end = strchr(line, '\n')))
+		{
+			if (!smtp)
+			{
+				// HTTP/1.x NNN
+				if (strncmp(line, "HTTP/", 5) || !(line = strchr(line, ' ')))
+				{
+					return -1;
+				}
+
+				return atoi(line + 1);
+			}
+
+			if ((end - line >= 3) && (line[3] != '-'))
+			{
+				return atoi(line);
+			}
+
+			line = end + 1;
+		}
+
+		// Keep room for the rest of a long multi-line reply.
+		if (line != buf)
+		{
+			len -= line - buf;
+			memmove(buf, line, len + 1);
+			line = buf;
+		}
+	}
+
+	CATERR("Notify: Invalid or missing reply\n");
+	return -1;
+}
+
+static int catcierge_notify_expect(int fd, int code)
+{
+	int reply = catcierge_notify_read_reply(fd, 1);
+
+	if (reply / 100 != code / 100)
+	{
+		if (reply >= 0)
+			CATERR("Notify: Unexpected SMTP reply %d\n", reply);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void catcierge_notify_get_subject(const catcierge_notify_settings_t *settings,
+		const catcierge_notify_batch_t *batch, char *buf, size_t bufsize)
+{
+	unsigned long total = batch->count + batch->overflow;
+
+	if (total == 1)
+		snprintf(buf, bufsize, "%s", settings->subject);
+	else
+		snprintf(buf, bufsize, "%s (%lu events)", settings->subject, total);
+}
+
+static int catcierge_notify_send_smtp(int fd,
+		const catcierge_notify_settings_t *settings,
+		const catcierge_notify_target_t *target,
+		const catcierge_notify_batch_t *batch)
+{
+	char subject[256];
+	char date[64];
+	char hostname[256];
+	const char *s;
+	time_t now = time(NULL);
+	size_t i;
+
+	if (gethostname(hostname, sizeof(hostname)))
+	{
+		strcpy(hostname, "catcierge");
+	}
+
+	hostname[sizeof(hostname) - 1] = '\0';
+	catcierge_notify_get_subject(settings, batch, subject, sizeof(subject));
+	strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S %z", localtime(&now));
+
+	if (catcierge_notify_expect(fd, 220)
+		|| catcierge_notify_printf(fd, "EHLO %s\r\n", hostname)
+		|| catcierge_notify_expect(fd, 250)
+		|| catcierge_notify_printf(fd, "MAIL FROM:<%s>\r\n", settings->from)
+		|| catcierge_notify_expect(fd, 250)
+		|| catcierge_notify_printf(fd, "RCPT TO:<%s>\r\n", target->path)
+		|| catcierge_notify_expect(fd, 250)
+		|| catcierge_notify_printf(fd, "DATA\r\n")
+		|| catcierge_notify_expect(fd, 354)
+		|| catcierge_notify_printf(fd,
+				"From: <%s>\r\n"
+				"To: <%s>\r\n"
+				"Subject: %s\r\n"
+				"Date: %s\r\n"
+				"Content-Type: text/plain; charset=utf-8\r\n"
+				"\r\n",
+				settings->from, target->path, subject, date))
+	{
+		return -1;
+	}
+
+	for (i = 0; i < batch->count; i++)
+	{
+		s = batch->lines[i];
+
+		// Lines starting with a dot are escaped by doubling it,
+		// and a line never ends inside the message.
+		if (((*s == '.') && catcierge_notify_write(fd, ".", 1))
+			|| catcierge_notify_write(fd, s, strcspn(s, "\r\n"))
+			|| catcierge_notify_write(fd, "\r\n", 2))
+		{
+			return -1;
+		}
+	}
+
+	if ((batch->overflow
+		&& catcierge_notify_printf(fd, "... and %lu more\r\n", batch->overflow))
+		|| catcierge_notify_printf(fd, ".\r\n")
+		|| catcierge_notify_expect(fd, 250))
+	{
+		return -1;
+	}
+
+	catcierge_notify_printf(fd, "QUIT\r\n");
+
+	return 0;
+}
+
+// Appends a JSON string, returns the new length or the length that
+// would have been needed if it does not fit.
+static size_t catcierge_notify_json_str(char *buf, size_t bufsize,
+		size_t len, const char *s)
+{
+	char esc[8];
+	size_t n;
+
+	#define JSON_APPEND(str, slen)							\
+		do {												\
+			if (len + (slen) < bufsize)						\
+				memcpy(buf + len, (str), (slen));			\
+			len += (slen);									\
+		} while (0)
+
+	JSON_APPEND("\"", 1);
+
+	for (; *s; s++)
+	{
+		unsigned char c = (unsigned char)*s;
+
+		if ((c == '"') || (c == '\\'))
+		{
+			esc[0] = '\\';
+			esc[1] = c;
+			JSON_APPEND(esc, 2);
+		}
+		else if (c < 0x20)
+		{
+			n = snprintf(esc, sizeof(esc), "\\u%04x", c);
+			JSON_APPEND(esc, n);
+		}
+		else
+		{
+			JSON_APPEND(s, 1);
+		}
+	}
+
+	JSON_APPEND("\"", 1);
+
+	#undef JSON_APPEND
+
+	return len;
+}
+
+static char *catcierge_notify_json(const catcierge_notify_settings_t *settings,
+		const catcierge_notify_batch_t *batch, size_t *json_len)
+{
+	char subject[256];
+	char num[64];
+	char *buf = NULL;
+	size_t bufsize = 0;
+	size_t len;
+	size_t i;
+	int pass;
+
+	catcierge_notify_get_subject(settings, batch, subject, sizeof(subject));
+
+	// First pass gets the size.
+	for (pass = 0; pass < 2; pass++)
+	{
+		len = 0;
+		#define JSON_LITERAL(str)								\
+			do {												\
+				size_t slen = strlen(str);						\
+				if (len + slen < bufsize)						\
+					memcpy(buf + len, (str), slen);				\
+				len += slen;									\
+			} while (0)
+
+		JSON_LITERAL("{\"subject\":");
+		len = catcierge_notify_json_str(buf, bufsize, len, subject);
+		snprintf(num, sizeof(num), ",\"count\":%lu,\"dropped\":%lu,\"events\":[",
+			(unsigned long)(batch->count + batch->overflow), batch->overflow);
+		JSON_LITERAL(num);
+
+		for (i = 0; i < batch->count; i++)
+		{
+			if (i > 0)
+				JSON_LITERAL(",");
+			len = catcierge_notify_json_str(buf, bufsize, len, batch->lines[i]);
+		}
+
+		JSON_LITERAL("]}");
+		#undef JSON_LITERAL
+
+		if (pass == 0)
+		{
+			bufsize = len + 1;
+
+			if (!(buf = malloc(bufsize)))
+			{
+				CATERR("Out of memory\n");
+				return NULL;
+			}
+		}
+	}
+
+	buf[len] = '\0';
+	*json_len = len;
+
+	return buf;
+}
+
+static int catcierge_notify_send_http(int fd,
+		const catcierge_notify_settings_t *settings,
+		const catcierge_notify_target_t *target,
+		const catcierge_notify_batch_t *batch)
+{
+	char *json;
+	size_t json_len = 0;
+	int ret = -1;
+	int status;
+
+	if (!(json = catcierge_notify_json(settings, batch, &json_len)))
+	{
+		return -1;
+	}
+
+	if (catcierge_notify_printf(fd,
+			"POST %s HTTP/1.0\r\n"
+			"Host: %s:%s\r\n"
+			"User-Agent: catcierge/" CATCIERGE_VERSION_STR "\r\n"
+			"Content-Type: application/json\r\n"
+			"Content-Length: %lu\r\n"
+			"Connection: close\r\n"
+			"\r\n",
+			target->path, target->host, target->port, (unsigned long)json_len)
+		|| catcierge_notify_write(fd, json, json_len))
+	{
+		goto fail;
+	}
+
+	if ((status = catcierge_notify_read_reply(fd, 0)) / 100 != 2)
+	{
+		if (status >= 0)
+			CATERR("Notify: HTTP status %d from %s\n", status, target->host);
+		goto fail;
+	}
+
+	ret = 0;
+fail:
+	catcierge_xfree(&json);
+	return ret;
+}
+
+#endif // CATCIERGE_HAVE_NOTIFY
+
+int catcierge_notify_send(const catcierge_notify_settings_t *settings,
+		const catcierge_notify_target_t *target,
+		const catcierge_notify_batch_t *batch)
+{
+	#ifdef CATCIERGE_HAVE_NOTIFY
+	int fd;
+	int ret;
+	assert(settings);
+	assert(target);
+	assert(batch);
+
+	if ((fd = catcierge_notify_connect(target, settings->timeout)) < 0)
+	{
+		return -1;
+	}
+
+	if (target->proto == CATCIERGE_NOTIFY_SMTP)
+		ret = catcierge_notify_send_smtp(fd, settings, target, batch);
+	else
+		ret = catcierge_notify_send_http(fd, settings, target, batch);
+
+	close(fd);
+
+	return ret;
+	#else
+	return -1;
+	#endif
+}
+
+#ifdef CATCIERGE_HAVE_NOTIFY
+
+static void *catcierge_notify_worker(void *arg)
+{
+	catcierge_notify_t *n = (catcierge_notify_t *)arg;
+	catcierge_notify_batch_t batch;
+	struct timespec ts;
+	double due;
+	double now;
+	size_t i;
+	int ok;
+
+	pthread_mutex_lock(&n->lock);
+
+	while (n->running || (n->pending.count + n->pending.overflow))
+	{
+		if (!(n->pending.count + n->pending.overflow))
+		{
+			pthread_cond_wait(&n->wakeup, &n->lock);
+			continue;
+		}
+
+		due = n->first_time + n->settings.window;
+
+		if (n->last_sent && (due < n->last_sent + n->settings.interval))
+		{
+			due = n->last_sent + n->settings.interval;
+		}
+
+		now = catcierge_notify_now();
+
+		// Whatever is left is sent when stopping.
+		if (n->running && (now < due))
+		{
+			ts.tv_sec = (time_t)due;
+			ts.tv_nsec = (long)((due - ts.tv_sec) * 1000000000.0);
+			pthread_cond_timedwait(&n->wakeup, &n->lock, &ts);
+			continue;
+		}
+
+		batch = n->pending;
+		memset(&n->pending, 0, sizeof(n->pending));
+		n->last_sent = now;
+		pthread_mutex_unlock(&n->lock);
+
+		for (i = 0; i < n->settings.target_count; i++)
+		{
+			ok = !catcierge_notify_send(&n->settings, &n->settings.targets[i], &batch);
+
+			pthread_mutex_lock(&n->lock);
+			if (ok)
+				n->sent_count++;
+			else
+				n->failed_count++;
+			pthread_mutex_unlock(&n->lock);
+		}
+
+		catcierge_notify_batch_free(&batch);
+
+		pthread_mutex_lock(&n->lock);
+	}
+
+	pthread_mutex_unlock(&n->lock);
+
+	return NULL;
+}
+
+#endif // CATCIERGE_HAVE_NOTIFY
+
+int catcierge_notify_init(catcierge_notify_t *n,
+		const catcierge_notify_settings_t *settings)
+{
+	assert(n);
+	assert(settings);
+	memset(n, 0, sizeof(catcierge_notify_t));
+
+	#ifdef CATCIERGE_HAVE_NOTIFY
+
+	if ((settings->target_count == 0)
+		|| (settings->target_count > CATCIERGE_NOTIFY_MAX_TARGETS))
+	{
+		CATERR("Invalid number of notify targets %lu\n",
+			(unsigned long)settings->target_count);
+		return -1;
+	}
+
+	n->settings = *settings;
+	n->settings.from = NULL;
+	n->settings.subject = NULL;
+
+	if (!(n->settings.from = strdup(settings->from ? settings->from : DEFAULT_NOTIFY_FROM))
+		|| !(n->settings.subject = strdup(settings->subject ? settings->subject : DEFAULT_NOTIFY_SUBJECT)))
+	{
+		CATERR("Out of memory\n");
+		catcierge_notify_settings_free(&n->settings);
+		return -1;
+	}
+
+	if (n->settings.timeout <= 0)
+	{
+		n->settings.timeout = DEFAULT_NOTIFY_TIMEOUT;
+	}
+
+	n->running = 1;
+	pthread_mutex_init(&n->lock, NULL);
+	pthread_cond_init(&n->wakeup, NULL);
+
+	if (pthread_create(&n->thread, NULL, catcierge_notify_worker, n))
+	{
+		CATERR("Failed to start notify thread\n");
+		n->running = 0;
+		pthread_mutex_destroy(&n->lock);
+		pthread_cond_destroy(&n->wakeup);
+		catcierge_notify_settings_free(&n->settings);
+		return -1;
+	}
+
+	return 0;
+
+	#else // !CATCIERGE_HAVE_NOTIFY
+
+	CATERR("Notifications are not supported on this platform\n");
+	return -1;
+
+	#endif // CATCIERGE_HAVE_NOTIFY
+}
+
+void catcierge_notify_destroy(catcierge_notify_t *n)
+{
+	assert(n);
+
+	if (!n->running)
+	{
+		return;
+	}
+
+	#ifdef CATCIERGE_HAVE_NOTIFY
+	pthread_mutex_lock(&n->lock);
+	n->running = 0;
+	pthread_cond_signal(&n->wakeup);
+	pthread_mutex_unlock(&n->lock);
+
+	pthread_join(n->thread, NULL);
+
+	pthread_mutex_destroy(&n->lock);
+	pthread_cond_destroy(&n->wakeup);
+
+	CATLOG("Notifications: %lu events, %lu messages sent, %lu failed\n",
+		n->event_count, n->sent_count, n->failed_count);
+
+	catcierge_notify_settings_free(&n->settings);
+	#endif // CATCIERGE_HAVE_NOTIFY
+}
+
+int catcierge_notify_push(catcierge_notify_t *n, char *line)
+{
+	int ret = -1;
+	assert(n);
+	assert(line);
+
+	#ifdef CATCIERGE_HAVE_NOTIFY
+	if (n->running)
+	{
+		pthread_mutex_lock(&n->lock);
+
+		if (!(n->pending.count + n->pending.overflow))
+		{
+			n->first_time = catcierge_notify_now();
+		}
+
+		if (n->pending.count < CATCIERGE_NOTIFY_MAX_LINES)
+		{
+			n->pending.lines[n->pending.count++] = line;
+			line = NULL;
+		}
+		else
+		{
+			n->pending.overflow++;
+		}
+
+		n->event_count++;
+		pthread_cond_signal(&n->wakeup);
+		pthread_mutex_unlock(&n->lock);
+		ret = 0;
+	}
+	#endif
+
+	catcierge_xfree(&line);
+
+	return ret;
+}
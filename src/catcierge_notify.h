@@ -0,0 +1,131 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_NOTIFY_H__
+#define __CATCIERGE_NOTIFY_H__
+
+#include <stddef.h>
+#include <catcierge_config.h>
+
+#ifdef CATCIERGE_HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#if defined(CATCIERGE_HAVE_PTHREAD_H) && defined(CATCIERGE_HAVE_SYS_SOCKET_H) \
+	&& defined(CATCIERGE_HAVE_NETDB_H)
+#define CATCIERGE_HAVE_NOTIFY
+#endif
+
+#define DEFAULT_NOTIFY_WINDOW 30		// Seconds.
+#define DEFAULT_NOTIFY_INTERVAL 300		// Seconds.
+#define DEFAULT_NOTIFY_TIMEOUT 10		// Seconds.
+#define DEFAULT_NOTIFY_EVENTS "match_group_done"
+#define DEFAULT_NOTIFY_FORMAT "%time% %match_group_success_str% " \
+	"%match_group_direction% (%match_group_id%)"
+#define DEFAULT_NOTIFY_FROM "catcierge@localhost"
+#define DEFAULT_NOTIFY_SUBJECT "Catcierge"
+#define CATCIERGE_NOTIFY_MAX_TARGETS 8
+#define CATCIERGE_NOTIFY_MAX_LINES 64	// Lines in a batch, more are only counted.
+
+typedef enum catcierge_notify_proto_e
+{
+	CATCIERGE_NOTIFY_SMTP,
+	CATCIERGE_NOTIFY_HTTP
+} catcierge_notify_proto_t;
+
+// Parsed from smtp://host[:port]/recipient@domain
+// or http://host[:port]/path
+typedef struct catcierge_notify_target_s
+{
+	catcierge_notify_proto_t proto;
+	char host[256];
+	char port[8];
+	char path[512];		// Recipient for SMTP.
+} catcierge_notify_target_t;
+
+typedef struct catcierge_notify_settings_s
+{
+	double window;		// Seconds to collect events before sending.
+	double interval;	// Min seconds between two messages.
+	int timeout;		// Seconds before a server is given up on.
+	char *from;
+	char *subject;
+	catcierge_notify_target_t targets[CATCIERGE_NOTIFY_MAX_TARGETS];
+	size_t target_count;
+} catcierge_notify_settings_t;
+
+typedef struct catcierge_notify_batch_s
+{
+	char *lines[CATCIERGE_NOTIFY_MAX_LINES];
+	size_t count;
+	unsigned long overflow;	// Events that did not fit in lines.
+} catcierge_notify_batch_t;
+
+//
+// Sends notifications about events from inside the grabber, instead
+// of starting a script for each event.
+//
+// The FSM pushes one rendered line per event. The first line opens a
+// window during which more events are collected, after which the whole
+// batch is sent as one message to each target from a worker thread.
+// Messages are never sent closer than the interval apart, events
+// arriving in between are added to the next batch. So a burst of
+// visits gives a single mail or webhook call.
+//
+typedef struct catcierge_notify_s
+{
+	int running;
+	catcierge_notify_settings_t settings;
+	catcierge_notify_batch_t pending;
+	double first_time;		// When the first pending line was pushed.
+	double last_sent;		// When the latest message was sent.
+
+	unsigned long sent_count;		// Messages delivered, per target.
+	unsigned long failed_count;		// Messages that failed, per target.
+	unsigned long event_count;		// Lines pushed.
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t wakeup;
+	#endif
+} catcierge_notify_t;
+
+// Copies the settings and starts the worker thread.
+int catcierge_notify_init(catcierge_notify_t *n,
+		const catcierge_notify_settings_t *settings);
+
+// Sends anything still pending before stopping.
+void catcierge_notify_destroy(catcierge_notify_t *n);
+
+// Adds a line to the pending batch, takes ownership of it.
+int catcierge_notify_push(catcierge_notify_t *n, char *line);
+
+// Sends a batch to a single target right away.
+int catcierge_notify_send(const catcierge_notify_settings_t *settings,
+		const catcierge_notify_target_t *target,
+		const catcierge_notify_batch_t *batch);
+
+int catcierge_notify_parse_target(const char *url,
+		catcierge_notify_target_t *target);
+
+void catcierge_notify_batch_free(catcierge_notify_batch_t *batch);
+
+void catcierge_notify_settings_free(catcierge_notify_settings_t *settings);
+
+#endif // __CATCIERGE_NOTIFY_H__
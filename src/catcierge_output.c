@@ -71,6 +71,23 @@ catcierge_output_var_t vars[] =
 	{ "match_group_success_str", "Match group success status, as a string 'success' or 'fail'."},
 	{ "match_group_success_count", "Match group success count."},
 	{ "match_group_final_decision", "Did the match group veto the final decision?"},
+	{ "match_group_early_decision", "Was the decision made before all matches were done? (--early_decision)"},
+	{ "actuation_latency", "Time in milliseconds from the last lock decision until the door was locked or unlocked."},
+	{ "event_queue_length", "Number of events waiting in the queue when the event was triggered (--async_events)."},
+	{ "event_dropped_count", "Number of events dropped because the event queue was full (--async_events)."},
+	{ "render_alloc_count", "Number of memory allocations made when the previous template was rendered."},
+	{ "image_queue_length", "Number of images waiting to be written by the background image writer."},
+	{ "image_bytes_written", "Number of bytes of images written by the background image writer."},
+	{ "image_write_latency", "Average time in milliseconds from an image being queued until it was written."},
+	{ "disk_free", "Bytes free on the disk of the match output path, as of the latest retention check (--retention)."},
+	{ "disk_usage", "Bytes used by the saved images and templates, as of the latest retention check (--retention)."},
+	{ "retention_removed_count", "Number of files removed to stay within the --retention quotas."},
+	{ "mosaic_path", "Path of the latest mosaic written (--mosaic)."},
+	{ "mosaic_latency", "Time in milliseconds from the decision until the latest mosaic was written (--mosaic)."},
+	{ "match_group_skipped_frames", "Number of frames skipped in favour of a better frame in the same burst (--burst)."},
+	{ "stream_total", "Number of matches made in the current match group in streaming mode (--streaming)."},
+	{ "stream_window_count", "Number of matches in the streaming window."},
+	{ "stream_window_success_count", "Number of successful matches in the streaming window."},
 	{ "match_group_desc", "Match group description."},
 	{ "match_group_direction", "The match group direction (based on all match directions)."},
 	{ "match_group_count", "Match group count o matches so far."},
@@ -86,6 +103,7 @@ catcierge_output_var_t vars[] =
 	{ "match#_direction", "Direction for match #." },
 	{ "match#_description", "Description of match #." },
 	{ "match#_result", "Result for match #." },
+	{ "match#_reused", "1 if the result of match # was reused from a near identical earlier frame (--match_cache)." },
 	{ "match#_time", "Time of match #." },
 	{ "match#_step#_filename", "Image filename for match step # for match #."},
 	{ "match#_step#_path", "Image path for match step # for match # (excluding filename)."},
@@ -157,11 +175,8 @@ fail:
 	return NULL;
 }
 
-int catcierge_output_init(catcierge_grb_t *grb, catcierge_output_t *ctx)
+static int catcierge_output_alloc(catcierge_output_t *ctx)
 {
-	size_t i;
-	catcierge_output_invar_t *var_it = NULL;
-	catcierge_args_t *args = &grb->args;
 	assert(ctx);
 	memset(ctx, 0, sizeof(catcierge_output_t));
 	ctx->template_max_count = 10;
@@ -173,6 +188,21 @@ int catcierge_output_init(catcierge_grb_t *grb, catcierge_output_t *ctx)
 		CATERR("Out of memory\n"); return -1;
 	}
 
+	return 0;
+}
+
+int catcierge_output_init(catcierge_grb_t *grb, catcierge_output_t *ctx)
+{
+	size_t i;
+	catcierge_output_invar_t *var_it = NULL;
+	catcierge_args_t *args = &grb->args;
+	assert(ctx);
+
+	if (catcierge_output_alloc(ctx))
+	{
+		return -1;
+	}
+
 	for (i = 0; i < args->user_var_count; i++)
 	{
 		char *name = args->user_vars[i];
@@ -196,8 +226,49 @@ int catcierge_output_init(catcierge_grb_t *grb, catcierge_output_t *ctx)
 		}
 	}
 
+	ctx->staging = &grb->staging;
+	#ifdef WITH_ZMQ
+	ctx->publisher = &grb->publisher;
+	#endif
+
+	return 0;
+fail:
+	return -1;
+}
+
+int catcierge_output_init_copy(catcierge_output_t *ctx, catcierge_output_t *src,
+		char **inputs, size_t input_count)
+{
+	catcierge_output_invar_t *var_it = NULL;
+	catcierge_output_invar_t *tmp = NULL;
+	assert(ctx);
+	assert(src);
+
+	if (catcierge_output_alloc(ctx))
+	{
+		return -1;
+	}
+
+	HASH_ITER(hh, src->vars, var_it, tmp)
+	{
+		if (!catcierge_output_add_user_variable(ctx, var_it->name, var_it->value))
+		{
+			CATERR("Failed to copy variable '%s'\n", var_it->name);
+			goto fail;
+		}
+	}
+
+	if (catcierge_output_load_templates(ctx, inputs, input_count))
+	{
+		goto fail;
+	}
+
+	ctx->staging = src->staging;
+	ctx->publisher = src->publisher;
+
 	return 0;
 fail:
+	catcierge_output_destroy(ctx);
 	return -1;
 }
 
@@ -220,6 +291,7 @@ void catcierge_output_free_template(catcierge_output_template_t *t)
 	if (!t)
 		return;
 
+	catcierge_output_free_compiled(&t->compiled);
 	catcierge_xfree(&t->tmpl);
 	catcierge_xfree(&t->name);
 	catcierge_xfree(&t->generated_path);
@@ -250,6 +322,10 @@ void catcierge_output_destroy(catcierge_output_t *ctx)
 
 	ctx->template_count = 0;
 	ctx->template_max_count = 0;
+	ctx->event_mask = 0;
+
+	catcierge_arena_destroy(&ctx->arena);
+	catcierge_serializer_destroy(&ctx->serializer);
 
 	HASH_ITER(hh, ctx->vars, var_it, tmp)
 	{
@@ -275,6 +351,51 @@ int catcierge_output_read_event_setting(catcierge_output_settings_t *settings, c
 	return 0;
 }
 
+const char *catcierge_output_event_name(catcierge_event_t e)
+{
+	#define CATCIERGE_DEFINE_EVENT(ev_enum_name, ev_name, ev_description)	\
+		if (e == ev_enum_name) return #ev_name;
+	#include "catcierge_events.h"
+
+	return NULL;
+}
+
+int catcierge_output_event_from_name(const char *name)
+{
+	assert(name);
+
+	#define CATCIERGE_DEFINE_EVENT(ev_enum_name, ev_name, ev_description)	\
+		if (!strcmp(name, #ev_name)) return ev_enum_name;
+	#include "catcierge_events.h"
+
+	return -1;
+}
+
+static unsigned int catcierge_output_event_filter_mask(catcierge_output_settings_t *settings)
+{
+	size_t i;
+	int e;
+	unsigned int mask = 0;
+	assert(settings);
+
+	for (i = 0; i < settings->event_filter_count; i++)
+	{
+		if (!strcmp(settings->event_filter[i], "all")
+		 || !strcmp(settings->event_filter[i], "*"))
+		{
+			return CATCIERGE_EVENT_ALL;
+		}
+
+		// Names that aren't events are left to the string matching.
+		if ((e = catcierge_output_event_from_name(settings->event_filter[i])) >= 0)
+		{
+			mask |= CATCIERGE_EVENT_BIT(e);
+		}
+	}
+
+	return mask;
+}
+
 int catcierge_output_read_required_setting(catcierge_output_settings_t *settings, const char *required)
 {
 	assert(settings);
@@ -450,6 +571,22 @@ const char *catcierge_output_read_template_settings(catcierge_output_settings_t
 			it = row_end;
 			continue;
 		}
+		else if (!strncmp(it, "format", 6))
+		{
+			// Serialize the event data directly instead of rendering the template.
+			it += 6;
+			it = catcierge_skip_whitespace_alt(it);
+			it[strcspn(it, " \t\r")] = '\0';
+
+			if (catcierge_serialize_format_from_name(it, &settings->format))
+			{
+				CATERR("Unknown template format \"%s\", expected text, json or msgpack\n", it);
+				goto fail;
+			}
+
+			it = row_end;
+			continue;
+		}
 		else if (!strncmp(it, "required", 8))
 		{
 			// Required variables needed to generate the template.
@@ -595,6 +732,14 @@ int catcierge_output_add_template(catcierge_output_t *ctx,
 		goto out_of_memory;
 	}
 
+	// Parse the template once, so generating it for each event
+	// only has to look up the variable values.
+	if (catcierge_output_compile(&t->compiled, t->tmpl))
+	{
+		CATERR("Failed to parse template \"%s\"\n", t->name);
+		goto fail;
+	}
+
 	for (i = 0; i < t->settings.required_var_count; i++)
 	{
 		HASH_FIND_STR(ctx->vars, t->settings.required_vars[i], it);
@@ -607,6 +752,8 @@ int catcierge_output_add_template(catcierge_output_t *ctx,
 		}
 	}
 
+	t->event_mask = catcierge_output_event_filter_mask(&t->settings);
+	ctx->event_mask |= t->event_mask;
 	ctx->template_count++;
 
 	CATLOG(" %s (%s)\n", t->name, t->settings.filename);
@@ -748,6 +895,30 @@ static char *catcierge_get_short_id(const char *subvar, char *buf, size_t bufsiz
 	return buf;
 }
 
+// Directory + filename, assembled the first time it is needed.
+static const char *catcierge_get_full_path(catcierge_path_t *path)
+{
+	if (!(*path->full))
+	{
+		char *dir_end = path->dir + strlen(path->dir) - 1;
+
+		if (*path->filename)
+		{
+			snprintf(path->full, sizeof(path->full) - 1, "%s%s%s",
+				*path->dir ? path->dir : "",
+				((*dir_end == '/') || (*dir_end == catcierge_path_sep()[0])) ? "" : "/",
+				path->filename);
+		}
+		else
+		{
+			snprintf(path->full, sizeof(path->full) - 1, "%s",
+				*path->dir ? path->dir : "");
+		}
+	}
+
+	return path->full;
+}
+
 static char *catcierge_get_path(catcierge_grb_t *grb, const char *var,
 								catcierge_path_t *path,
 								char *buf, size_t bufsize)
@@ -786,23 +957,7 @@ static char *catcierge_get_path(catcierge_grb_t *grb, const char *var,
 		template = &ctx->templates[ctx->template_idx];
 	}
 
-	if (!(*path->full))
-	{
-		char *dir_end = path->dir + strlen(path->dir) - 1;
-
-		if (*path->filename)
-		{
-			snprintf(path->full, sizeof(path->full) - 1, "%s%s%s",
-				*path->dir ? path->dir : "",
-				((*dir_end == '/') || (*dir_end == catcierge_path_sep()[0])) ? "" : "/",
-				path->filename);
-		}
-		else
-		{
-			snprintf(path->full, sizeof(path->full) - 1, "%s",
-				*path->dir ? path->dir : "");
-		}
-	}
+	catcierge_get_full_path(path);
 
 	// Get any path operations if any.
 	if (path_ops)
@@ -1023,352 +1178,549 @@ static char *catcierge_output_realloc_if_needed(char *str, size_t new_size, size
 	return str;
 }
 
-const char *_catcierge_output_translate(catcierge_grb_t *grb,
-	char *buf, size_t bufsize, const char *var)
+typedef enum catcierge_output_var_id_e
 {
-	const char *matcher_val;
-	match_group_t *mg = &grb->match_group;
-
-	if (!strncmp(var, "template_path", 13))
-	{
-		char *template_path = catcierge_get_template_path(grb, var);
-		return catcierge_create_and_get_path(grb, var,
-					template_path, 0, buf, bufsize);
-	}
-
-	// Current time.
-	if (!strncmp(var, "time", 4))
-	{
-		struct timeval tv;
-		gettimeofday(&tv, NULL);
-		return catcierge_get_time_var_format(var, buf, bufsize,
-			"%Y-%m-%d %H:%M:%S.%f", time(NULL), &tv);
-	}
-
-	if (!strcmp(var, "state"))
-	{
-		return catcierge_get_state_string(grb->state);
-	}
-
-	if (!strcmp(var, "prev_state"))
-	{
-		return catcierge_get_state_string(grb->prev_state);
-	}
-
-	if (!strcmp(var, "git_commit") || !strcmp(var, "git_hash"))
-	{
-		return CATCIERGE_GIT_HASH;
-	}
-
-	if (!strcmp(var, "git_commit_short") || !strcmp(var, "git_hash_short"))
-	{
-		return CATCIERGE_GIT_HASH_SHORT;
-	}
-
-	if (!strcmp(var, "git_tainted"))
-	{
-		snprintf(buf, bufsize - 1, "%d", CATCIERGE_GIT_TAINTED);
-		return buf;
-	}
-
-	if (!strcmp(var, "version"))
-	{
-		return CATCIERGE_VERSION_STR;
-	}
+	CATCIERGE_VAR_UNKNOWN = 0, // Matcher or user defined variable.
+	CATCIERGE_VAR_TEMPLATE_PATH,
+	CATCIERGE_VAR_TIME,
+	CATCIERGE_VAR_STATE,
+	CATCIERGE_VAR_PREV_STATE,
+	CATCIERGE_VAR_GIT_HASH,
+	CATCIERGE_VAR_GIT_HASH_SHORT,
+	CATCIERGE_VAR_GIT_TAINTED,
+	CATCIERGE_VAR_VERSION,
+	CATCIERGE_VAR_CWD,
+	CATCIERGE_VAR_OUTPUT_PATH,
+	CATCIERGE_VAR_MATCH_OUTPUT_PATH,
+	CATCIERGE_VAR_STEPS_OUTPUT_PATH,
+	CATCIERGE_VAR_OBSTRUCT_OUTPUT_PATH,
+	CATCIERGE_VAR_TEMPLATE_OUTPUT_PATH,
+	CATCIERGE_VAR_MATCHER,
+	CATCIERGE_VAR_OK_MATCHES_NEEDED,
+	CATCIERGE_VAR_NO_FINAL_DECISION,
+	CATCIERGE_VAR_MATCHTIME,
+	CATCIERGE_VAR_LOCKOUT_METHOD,
+	CATCIERGE_VAR_LOCKOUT_ERROR,
+	CATCIERGE_VAR_LOCKOUT_ERROR_DELAY,
+	CATCIERGE_VAR_LOCKOUT_TIME,
+	CATCIERGE_VAR_MATCH_GROUP_ID,
+	CATCIERGE_VAR_MATCH_GROUP_START_TIME,
+	CATCIERGE_VAR_MATCH_GROUP_END_TIME,
+	CATCIERGE_VAR_MATCH_GROUP_SUCCESS,
+	CATCIERGE_VAR_MATCH_GROUP_SUCCESS_COUNT,
+	CATCIERGE_VAR_MATCH_GROUP_FINAL_DECISION,
+	CATCIERGE_VAR_MATCH_GROUP_EARLY_DECISION,
+	CATCIERGE_VAR_ACTUATION_LATENCY,
+	CATCIERGE_VAR_EVENT_QUEUE_LENGTH,
+	CATCIERGE_VAR_EVENT_DROPPED_COUNT,
+	CATCIERGE_VAR_RENDER_ALLOC_COUNT,
+	CATCIERGE_VAR_IMAGE_QUEUE_LENGTH,
+	CATCIERGE_VAR_IMAGE_BYTES_WRITTEN,
+	CATCIERGE_VAR_IMAGE_WRITE_LATENCY,
+	CATCIERGE_VAR_DISK_FREE,
+	CATCIERGE_VAR_DISK_USAGE,
+	CATCIERGE_VAR_RETENTION_REMOVED_COUNT,
+	CATCIERGE_VAR_MOSAIC_PATH,
+	CATCIERGE_VAR_MOSAIC_LATENCY,
+	CATCIERGE_VAR_MATCH_GROUP_SKIPPED_FRAMES,
+	CATCIERGE_VAR_STREAM_TOTAL,
+	CATCIERGE_VAR_STREAM_WINDOW_COUNT,
+	CATCIERGE_VAR_STREAM_WINDOW_SUCCESS_COUNT,
+	CATCIERGE_VAR_MATCH_GROUP_DIRECTION,
+	CATCIERGE_VAR_MATCH_GROUP_DESCRIPTION,
+	CATCIERGE_VAR_MATCH_GROUP_COUNT,
+	CATCIERGE_VAR_MATCH_GROUP_MAX_COUNT,
+	CATCIERGE_VAR_OBSTRUCT_FILENAME,
+	CATCIERGE_VAR_OBSTRUCT_PATH,
+	CATCIERGE_VAR_OBSTRUCT_TIME,
+	CATCIERGE_VAR_MATCH_INVALID, // match#_ where # isn't a number.
+	CATCIERGE_VAR_MATCH_OTHER, // Unknown match#_ subvariable.
+	CATCIERGE_VAR_MATCH_PATH,
+	CATCIERGE_VAR_MATCH_FILENAME,
+	CATCIERGE_VAR_MATCH_IDX,
+	CATCIERGE_VAR_MATCH_ID,
+	CATCIERGE_VAR_MATCH_SUCCESS,
+	CATCIERGE_VAR_MATCH_SUCCESS_STR,
+	CATCIERGE_VAR_MATCH_DIRECTION,
+	CATCIERGE_VAR_MATCH_DESC,
+	CATCIERGE_VAR_MATCH_RESULT,
+	CATCIERGE_VAR_MATCH_REUSED,
+	CATCIERGE_VAR_MATCH_TIME,
+	CATCIERGE_VAR_MATCH_STEP_COUNT,
+	CATCIERGE_VAR_STEP_OTHER, // Unknown match#_step#_ subvariable.
+	CATCIERGE_VAR_STEP_PATH,
+	CATCIERGE_VAR_STEP_FILENAME,
+	CATCIERGE_VAR_STEP_NAME,
+	CATCIERGE_VAR_STEP_DESC,
+	CATCIERGE_VAR_STEP_ACTIVE
+} catcierge_output_var_id_t;
+
+static void catcierge_output_resolve_match_var(const char *var,
+		catcierge_output_var_ref_t *ref)
+{
+	const char *subvar = NULL;
+	int idx = -1;
 
-	if (!strcmp(var, "cwd"))
+	if (!strncmp(var, "matchcur", 8))
 	{
-		if (!getcwd(buf, bufsize - 1))
+		if (strlen(var) < strlen("matchcur_"))
 		{
-			CATERR("Failed to get cwd\n"); return NULL;
-		}
-
-		return buf;
-	}
-
-	#define CHECK_OUTPUT_PATH_VAR(name, _output) \
-		if (!strcmp(name, #_output)) \
-		{ \
-			return catcierge_create_and_get_path(grb, var, \
-						grb->args._output, DIR_ONLY, buf, bufsize); \
+			ref->id = CATCIERGE_VAR_MATCH_OTHER;
+			return;
 		}
 
-	CHECK_OUTPUT_PATH_VAR(var, output_path);
-	CHECK_OUTPUT_PATH_VAR(var, match_output_path);
-	CHECK_OUTPUT_PATH_VAR(var, steps_output_path);
-	CHECK_OUTPUT_PATH_VAR(var, obstruct_output_path);
-	CHECK_OUTPUT_PATH_VAR(var, template_output_path);
-
-	if (!strcmp(var, "matcher"))
-	{
-		return grb->matcher->short_name;
-	}
-
-	if (grb->matcher && (matcher_val = grb->matcher->translate(grb->matcher, var, buf, bufsize)))
-	{
-		return matcher_val;
-	}
-
-	if (!strcmp(var, "ok_matches_needed"))
-	{
-		snprintf(buf, bufsize - 1, "%d", grb->args.ok_matches_needed);
-		return buf;
-	}
-
-	if (!strcmp(var, "no_final_decision"))
-	{
-		snprintf(buf, bufsize - 1, "%d", grb->args.no_final_decision);
-		return buf;
-	}
-
-	if (!strcmp(var, "matchtime"))
-	{
-		snprintf(buf, bufsize - 1, "%d", grb->args.match_time);
-		return buf;
-	}
-
-	if (!strcmp(var, "lockout_method"))
-	{
-		snprintf(buf, bufsize - 1, "%d", (int)grb->args.lockout_method);
-		return buf;
+		ref->cur = 1;
+		subvar = var + strlen("matchcur_");
 	}
-
-	if (!strcmp(var, "lockout_error"))
+	else
 	{
-		snprintf(buf, bufsize - 1, "%d", grb->args.max_consecutive_lockout_count);
-		return buf;
-	}
+		subvar = var + strlen("match#_");
 
-	if (!strcmp(var, "lockout_error_delay"))
-	{
-		snprintf(buf, bufsize - 1, "%0.2f", grb->args.consecutive_lockout_delay);
-		return buf;
-	}
+		if (sscanf(var, "match%d_", &idx) != 1)
+		{
+			ref->id = CATCIERGE_VAR_MATCH_INVALID;
+			return;
+		}
 
-	if (!strcmp(var, "lockout_time"))
-	{
-		snprintf(buf, bufsize - 1, "%d", grb->args.lockout_time);
-		return buf;
+		ref->idx = idx - 1; // Convert to 0-based index.
 	}
 
-	if (!strncmp(var, "match_group_id", 14))
+	if (!strncmp(subvar, "path", 4)) ref->id = CATCIERGE_VAR_MATCH_PATH;
+	else if (!strcmp(subvar, "filename")) ref->id = CATCIERGE_VAR_MATCH_FILENAME;
+	else if (!strncmp(subvar, "idx", 3)) ref->id = CATCIERGE_VAR_MATCH_IDX;
+	else if (!strncmp(subvar, "id", 2)) ref->id = CATCIERGE_VAR_MATCH_ID;
+	else if (!strcmp(subvar, "success")) ref->id = CATCIERGE_VAR_MATCH_SUCCESS;
+	else if (!strcmp(subvar, "success_str")) ref->id = CATCIERGE_VAR_MATCH_SUCCESS_STR;
+	else if (!strcmp(subvar, "direction")) ref->id = CATCIERGE_VAR_MATCH_DIRECTION;
+	else if (!strncmp(subvar, "desc", 4)) ref->id = CATCIERGE_VAR_MATCH_DESC;
+	else if (!strcmp(subvar, "result")) ref->id = CATCIERGE_VAR_MATCH_RESULT;
+	else if (!strcmp(subvar, "reused")) ref->id = CATCIERGE_VAR_MATCH_REUSED;
+	else if (!strncmp(subvar, "time", 4)) ref->id = CATCIERGE_VAR_MATCH_TIME;
+	else if (!strcmp(subvar, "step_count")) ref->id = CATCIERGE_VAR_MATCH_STEP_COUNT;
+	else if (!strncmp(subvar, "step", 4))
 	{
-		const char *subvar = var + 14;
-		return catcierge_get_short_id(subvar, buf, bufsize, &mg->sha);
-	}
+		// Match step images / descriptions.
+		int stepidx = -1;
+		const char *stepvar = subvar + strlen("step#_");
 
-	if (!strncmp(var, "match_group_start_time", 22))
-	{
-		var += strlen("match_group_start_");
-		return catcierge_get_time_var_format(var, buf, bufsize,
-					"%Y-%m-%d %H:%M:%S.%f", mg->start_time, &mg->start_tv);
-	}
+		sscanf(subvar, "step%d_", &stepidx);
 
-	if (!strncmp(var, "match_group_end_time", 20))
-	{
-		var += strlen("match_group_end_");
-		return catcierge_get_time_var_format(var, buf, bufsize,
-					"%Y-%m-%d %H:%M:%S.%f", mg->end_time, &mg->end_tv);
-	}
+		// "step##_" instead of just "step#_"
+		if (stepidx >= 10)
+			stepvar++;
 
-	if (!strcmp(var, "match_group_success")
-	 || !strcmp(var, "match_success"))
-	{
-		snprintf(buf, bufsize - 1, "%d", grb->match_group.success);
-		return buf;
-	}
+		ref->step = stepidx - 1; // Convert to 0-based index.
 
-	if (!strcmp(var, "match_group_success_count"))
-	{
-		snprintf(buf, bufsize - 1, "%d", grb->match_group.success_count);
-		return buf;
+		if (!strcmp(stepvar, "path")) ref->id = CATCIERGE_VAR_STEP_PATH;
+		else if (!strcmp(stepvar, "filename")) ref->id = CATCIERGE_VAR_STEP_FILENAME;
+		else if (!strcmp(stepvar, "name")) ref->id = CATCIERGE_VAR_STEP_NAME;
+		else if (!strncmp(stepvar, "desc", 4)) ref->id = CATCIERGE_VAR_STEP_DESC;
+		else if (!strcmp(stepvar, "active")) ref->id = CATCIERGE_VAR_STEP_ACTIVE;
+		else ref->id = CATCIERGE_VAR_STEP_OTHER;
 	}
-
-	if (!strcmp(var, "match_group_final_decision"))
+	else
 	{
-		snprintf(buf, bufsize - 1, "%d", grb->match_group.final_decision);
-		return buf;
+		ref->id = CATCIERGE_VAR_MATCH_OTHER;
 	}
+}
 
-	if (!strcmp(var, "match_group_direction"))
-	{
-		return catcierge_get_direction_str(grb->match_group.direction);
-	}
+//
+// Finds out which variable a name refers to. This is done once when a
+// template is compiled, so rendering it can skip straight to the value.
+// Matcher specific and user defined variables are looked up when rendering.
+//
+static void catcierge_output_resolve_var(const char *var,
+		catcierge_output_var_ref_t *ref)
+{
+	assert(var);
+	assert(ref);
+
+	memset(ref, 0, sizeof(*ref));
+	ref->id = CATCIERGE_VAR_UNKNOWN;
+
+	#define RESOLVE_VAR(name, _id) \
+		if (!strcmp(var, name)) { ref->id = _id; return; }
+
+	#define RESOLVE_VAR_PREFIX(prefix, _id) \
+		if (!strncmp(var, prefix, sizeof(prefix) - 1)) { ref->id = _id; return; }
+
+	RESOLVE_VAR_PREFIX("template_path", CATCIERGE_VAR_TEMPLATE_PATH);
+	RESOLVE_VAR_PREFIX("time", CATCIERGE_VAR_TIME);
+	RESOLVE_VAR("state", CATCIERGE_VAR_STATE);
+	RESOLVE_VAR("prev_state", CATCIERGE_VAR_PREV_STATE);
+	RESOLVE_VAR("git_commit", CATCIERGE_VAR_GIT_HASH);
+	RESOLVE_VAR("git_hash", CATCIERGE_VAR_GIT_HASH);
+	RESOLVE_VAR("git_commit_short", CATCIERGE_VAR_GIT_HASH_SHORT);
+	RESOLVE_VAR("git_hash_short", CATCIERGE_VAR_GIT_HASH_SHORT);
+	RESOLVE_VAR("git_tainted", CATCIERGE_VAR_GIT_TAINTED);
+	RESOLVE_VAR("version", CATCIERGE_VAR_VERSION);
+	RESOLVE_VAR("cwd", CATCIERGE_VAR_CWD);
+	RESOLVE_VAR("output_path", CATCIERGE_VAR_OUTPUT_PATH);
+	RESOLVE_VAR("match_output_path", CATCIERGE_VAR_MATCH_OUTPUT_PATH);
+	RESOLVE_VAR("steps_output_path", CATCIERGE_VAR_STEPS_OUTPUT_PATH);
+	RESOLVE_VAR("obstruct_output_path", CATCIERGE_VAR_OBSTRUCT_OUTPUT_PATH);
+	RESOLVE_VAR("template_output_path", CATCIERGE_VAR_TEMPLATE_OUTPUT_PATH);
+	RESOLVE_VAR("matcher", CATCIERGE_VAR_MATCHER);
+	RESOLVE_VAR("ok_matches_needed", CATCIERGE_VAR_OK_MATCHES_NEEDED);
+	RESOLVE_VAR("no_final_decision", CATCIERGE_VAR_NO_FINAL_DECISION);
+	RESOLVE_VAR("matchtime", CATCIERGE_VAR_MATCHTIME);
+	RESOLVE_VAR("lockout_method", CATCIERGE_VAR_LOCKOUT_METHOD);
+	RESOLVE_VAR("lockout_error", CATCIERGE_VAR_LOCKOUT_ERROR);
+	RESOLVE_VAR("lockout_error_delay", CATCIERGE_VAR_LOCKOUT_ERROR_DELAY);
+	RESOLVE_VAR("lockout_time", CATCIERGE_VAR_LOCKOUT_TIME);
+	RESOLVE_VAR_PREFIX("match_group_id", CATCIERGE_VAR_MATCH_GROUP_ID);
+	RESOLVE_VAR_PREFIX("match_group_start_time", CATCIERGE_VAR_MATCH_GROUP_START_TIME);
+	RESOLVE_VAR_PREFIX("match_group_end_time", CATCIERGE_VAR_MATCH_GROUP_END_TIME);
+	RESOLVE_VAR("match_group_success", CATCIERGE_VAR_MATCH_GROUP_SUCCESS);
+	RESOLVE_VAR("match_success", CATCIERGE_VAR_MATCH_GROUP_SUCCESS);
+	RESOLVE_VAR("match_group_success_count", CATCIERGE_VAR_MATCH_GROUP_SUCCESS_COUNT);
+	RESOLVE_VAR("match_group_final_decision", CATCIERGE_VAR_MATCH_GROUP_FINAL_DECISION);
+	RESOLVE_VAR("match_group_early_decision", CATCIERGE_VAR_MATCH_GROUP_EARLY_DECISION);
+	RESOLVE_VAR("actuation_latency", CATCIERGE_VAR_ACTUATION_LATENCY);
+	RESOLVE_VAR("event_queue_length", CATCIERGE_VAR_EVENT_QUEUE_LENGTH);
+	RESOLVE_VAR("event_dropped_count", CATCIERGE_VAR_EVENT_DROPPED_COUNT);
+	RESOLVE_VAR("render_alloc_count", CATCIERGE_VAR_RENDER_ALLOC_COUNT);
+	RESOLVE_VAR("image_queue_length", CATCIERGE_VAR_IMAGE_QUEUE_LENGTH);
+	RESOLVE_VAR("image_bytes_written", CATCIERGE_VAR_IMAGE_BYTES_WRITTEN);
+	RESOLVE_VAR("image_write_latency", CATCIERGE_VAR_IMAGE_WRITE_LATENCY);
+	RESOLVE_VAR("disk_free", CATCIERGE_VAR_DISK_FREE);
+	RESOLVE_VAR("disk_usage", CATCIERGE_VAR_DISK_USAGE);
+	RESOLVE_VAR("retention_removed_count", CATCIERGE_VAR_RETENTION_REMOVED_COUNT);
+	RESOLVE_VAR_PREFIX("mosaic_path", CATCIERGE_VAR_MOSAIC_PATH);
+	RESOLVE_VAR("mosaic_latency", CATCIERGE_VAR_MOSAIC_LATENCY);
+	RESOLVE_VAR("match_group_skipped_frames", CATCIERGE_VAR_MATCH_GROUP_SKIPPED_FRAMES);
+	RESOLVE_VAR("stream_total", CATCIERGE_VAR_STREAM_TOTAL);
+	RESOLVE_VAR("stream_window_count", CATCIERGE_VAR_STREAM_WINDOW_COUNT);
+	RESOLVE_VAR("stream_window_success_count", CATCIERGE_VAR_STREAM_WINDOW_SUCCESS_COUNT);
+	RESOLVE_VAR("match_group_direction", CATCIERGE_VAR_MATCH_GROUP_DIRECTION);
+	RESOLVE_VAR("match_group_description", CATCIERGE_VAR_MATCH_GROUP_DESCRIPTION);
+	RESOLVE_VAR("match_group_desc", CATCIERGE_VAR_MATCH_GROUP_DESCRIPTION);
+	RESOLVE_VAR("match_group_count", CATCIERGE_VAR_MATCH_GROUP_COUNT);
+	RESOLVE_VAR("match_count", CATCIERGE_VAR_MATCH_GROUP_COUNT);
+	RESOLVE_VAR("match_group_max_count", CATCIERGE_VAR_MATCH_GROUP_MAX_COUNT);
+	RESOLVE_VAR("obstruct_filename", CATCIERGE_VAR_OBSTRUCT_FILENAME);
+	RESOLVE_VAR_PREFIX("obstruct_path", CATCIERGE_VAR_OBSTRUCT_PATH);
+	RESOLVE_VAR_PREFIX("obstruct_time", CATCIERGE_VAR_OBSTRUCT_TIME);
+
+	#undef RESOLVE_VAR
+	#undef RESOLVE_VAR_PREFIX
 
-	if (!strcmp(var, "match_group_description")
-	 || !strcmp(var, "match_group_desc"))
+	if (!strncmp(var, "match", 5))
 	{
-		return grb->match_group.description;
+		catcierge_output_resolve_match_var(var, ref);
 	}
+}
 
-	if (!strcmp(var, "match_group_count")
-	 || !strcmp(var, "match_count"))
-	{
-		snprintf(buf, bufsize - 1, "%d", (int)grb->match_group.match_count);
-		return buf;
-	}
+static const char *catcierge_output_translate_match(catcierge_grb_t *grb,
+	char *buf, size_t bufsize, const char *var, const catcierge_output_var_ref_t *ref)
+{
+	int idx = ref->idx;
+	match_state_t *m = NULL;
+	match_step_t *step = NULL;
+	const char *subvar = var + (ref->cur ? strlen("matchcur_") : strlen("match#_"));
 
-	if (!strcmp(var, "match_group_max_count"))
+	if (ref->cur)
 	{
-		snprintf(buf, bufsize - 1, "%d", MATCH_MAX_COUNT);
-		return buf;
+		idx = (int)grb->match_group.match_count - 1;
 	}
 
-	if (!strcmp(var, "obstruct_filename"))
+	// TODO: fix better error messages.
+	if ((idx < 0) || (idx >= MATCH_MAX_COUNT))
 	{
-		return mg->obstruct_path.filename;
+		CATERR("Output: %s out of range. (%lu > %lu)\n", var, idx, grb->match_group.match_count); return NULL;
 	}
 
-	if (!strncmp(var, "obstruct_path", 13))
-	{
-		return catcierge_get_path(grb, var, &mg->obstruct_path, buf, bufsize);
-	}
+	m = &grb->match_group.matches[idx];
 
-	if (!strncmp(var, "obstruct_time", strlen("obstruct_time")))
+	if ((size_t)idx > grb->match_group.match_count)
 	{
-		const char *subvar = var + strlen("obstruct_");
-		return catcierge_get_time_var_format(subvar, buf, bufsize,
-					"%Y-%m-%d %H:%M:%S.%f", mg->obstruct_time, &mg->obstruct_tv);
+		CATERR("Output: %s out of range. (%lu > %lu)\n", var, idx, grb->match_group.match_count);
+		return "";
 	}
 
-	if (!strncmp(var, "match", 5))
+	if (ref->id >= CATCIERGE_VAR_STEP_OTHER)
 	{
-		int idx = -1;
-		match_state_t *m = NULL;
-		const char *subvar = NULL;
-
-		if (!strncmp(var, "matchcur", 8))
-		{
-			idx = grb->match_group.match_count;
-			subvar = var + strlen("matchcur_");
-			idx--;
-		}
-		else
-		{
-			subvar = var + strlen("match#_");
-
-			if (sscanf(var, "match%d_", &idx) == EOF)
-			{
-				CATERR("Output: Failed to parse %s\n", var); return NULL;
-			}
-
-			idx--; // Convert to 0-based index.
-		}
-
-		// TODO: fix better error messages.
-		if ((idx < 0) || (idx >= MATCH_MAX_COUNT))
+		if ((ref->step < 0) || (ref->step >= MAX_STEPS))
 		{
-			CATERR("Output: %s out of range. (%lu > %lu)\n", var, idx, grb->match_group.match_count); return NULL;
+			CATERR("Step index out of range %d\n", ref->step);
+			return NULL;
 		}
 
-		m = &grb->match_group.matches[idx];
-
-		if ((size_t)idx > grb->match_group.match_count)
-		{
-			CATERR("Output: %s out of range. (%lu > %lu)\n", var, idx, grb->match_group.match_count);
-			return "";
-		}
+		step = &m->result.steps[ref->step];
+	}
 
-		if (!strncmp(subvar, "path", 4))
-		{
+	switch (ref->id)
+	{
+		case CATCIERGE_VAR_MATCH_PATH:
 			return catcierge_get_path(grb, var, &m->path, buf, bufsize);
-		}
-		else if (!strcmp(subvar, "filename"))
-		{
+		case CATCIERGE_VAR_MATCH_FILENAME:
 			return m->path.filename;
-		}
-		else if (!strncmp(subvar, "idx", 3))
-		{
+		case CATCIERGE_VAR_MATCH_IDX:
 			snprintf(buf, bufsize - 1, "%d", idx + 1);
 			return buf;
-		}
-		else if (!strncmp(subvar, "id", 2))
-		{
-			const char *subsubvar = subvar + 2;
-			return catcierge_get_short_id(subsubvar, buf, bufsize, &m->sha);
-		}
-		else if (!strcmp(subvar, "success"))
-		{
+		case CATCIERGE_VAR_MATCH_ID:
+			return catcierge_get_short_id(subvar + 2, buf, bufsize, &m->sha);
+		case CATCIERGE_VAR_MATCH_SUCCESS:
 			snprintf(buf, bufsize - 1, "%d", m->result.success);
 			return buf;
-		}
-		else if (!strcmp(subvar, "success_str"))
-		{
+		case CATCIERGE_VAR_MATCH_SUCCESS_STR:
 			snprintf(buf, bufsize - 1, "%s", m->result.success ? "success": "fail");
 			return buf;
-		}
-		else if (!strcmp(subvar, "direction"))
-		{
+		case CATCIERGE_VAR_MATCH_DIRECTION:
 			return catcierge_get_direction_str(m->result.direction);
-		}
-		else if (!strncmp(subvar, "desc", 4))
-		{
+		case CATCIERGE_VAR_MATCH_DESC:
 			return m->result.description;
-		}
-		else if (!strcmp(subvar, "result"))
-		{
+		case CATCIERGE_VAR_MATCH_RESULT:
 			snprintf(buf, bufsize - 1, "%f", m->result.result);
 			return buf;
-		}
-		else if (!strncmp(subvar, "time", 4))
-		{
+		case CATCIERGE_VAR_MATCH_REUSED:
+			snprintf(buf, bufsize - 1, "%d", m->result.reused);
+			return buf;
+		case CATCIERGE_VAR_MATCH_TIME:
 			return catcierge_get_time_var_format(subvar, buf, bufsize,
 					"%Y-%m-%d %H:%M:%S.%f", m->time, &m->tv);
-		}
-		else if (!strcmp(subvar, "step_count"))
-		{
+		case CATCIERGE_VAR_MATCH_STEP_COUNT:
 			snprintf(buf, bufsize - 1, "%d", (int)m->result.step_img_count);
 			return buf;
-		}
-		else if (!strncmp(subvar, "step", 4))
-		{
-			// Match step images / descriptions.
-			int stepidx = -1;
-			match_step_t *step = NULL;
+		case CATCIERGE_VAR_STEP_PATH:
+			return catcierge_get_path(grb, var, &step->path, buf, bufsize);
+		case CATCIERGE_VAR_STEP_FILENAME:
+			return step->path.filename;
+		case CATCIERGE_VAR_STEP_NAME:
+			return step->name ? step->name : "";
+		case CATCIERGE_VAR_STEP_DESC:
+			return step->description ? step->description : "";
+		case CATCIERGE_VAR_STEP_ACTIVE:
+			snprintf(buf, bufsize - 1, "%d", step->img != NULL);
+			return buf;
+	}
 
-			const char *stepvar = subvar + strlen("step#_");
+	// Unknown subvariable, might be a user defined variable.
+	return NULL;
+}
 
-			if (sscanf(subvar, "step%d_", &stepidx) == EOF)
-			{
-				CATERR("Failed to parse step#_\n");
-				return NULL;
-			}
-
-			// "step##_" instead of just "step#_"
-			if (stepidx >= 10)
-				stepvar++;
+static const char *catcierge_output_translate_ref_uncached(catcierge_grb_t *grb,
+	char *buf, size_t bufsize, const char *var, const catcierge_output_var_ref_t *ref)
+{
+	const char *matcher_val;
+	match_group_t *mg = &grb->match_group;
 
-			stepidx--; // Convert to 0-based index.
+	switch (ref->id)
+	{
+		case CATCIERGE_VAR_TEMPLATE_PATH:
+		{
+			char *template_path = catcierge_get_template_path(grb, var);
+			return catcierge_create_and_get_path(grb, var,
+						template_path, 0, buf, bufsize);
+		}
+		case CATCIERGE_VAR_TIME:
+		{
+			// Current time. While rendering, the time the render
+			// started, so all the output for an event gets the same time.
+			struct timeval tv = grb->output.render_tv;
 
-			if ((stepidx < 0) || (stepidx >= MAX_STEPS))
+			if (grb->output.render_depth == 0)
 			{
-				CATERR("Step index out of range %d\n", stepidx);
-				return NULL;
+				gettimeofday(&tv, NULL);
 			}
 
-			step = &m->result.steps[stepidx];
-
-			if (!strcmp(stepvar, "path"))
+			return catcierge_get_time_var_format(var, buf, bufsize,
+				"%Y-%m-%d %H:%M:%S.%f", tv.tv_sec, &tv);
+		}
+		case CATCIERGE_VAR_STATE:
+			return catcierge_get_state_string(grb->state);
+		case CATCIERGE_VAR_PREV_STATE:
+			return catcierge_get_state_string(grb->prev_state);
+		case CATCIERGE_VAR_GIT_HASH:
+			return CATCIERGE_GIT_HASH;
+		case CATCIERGE_VAR_GIT_HASH_SHORT:
+			return CATCIERGE_GIT_HASH_SHORT;
+		case CATCIERGE_VAR_GIT_TAINTED:
+			snprintf(buf, bufsize - 1, "%d", CATCIERGE_GIT_TAINTED);
+			return buf;
+		case CATCIERGE_VAR_VERSION:
+			return CATCIERGE_VERSION_STR;
+		case CATCIERGE_VAR_CWD:
+			if (!getcwd(buf, bufsize - 1))
 			{
-				return catcierge_get_path(grb, var, &step->path, buf, bufsize);
+				CATERR("Failed to get cwd\n"); return NULL;
 			}
-			else if (!strcmp(stepvar, "filename"))
+			return buf;
+
+		#define OUTPUT_PATH_VAR(_id, _output) \
+		case _id: \
+			return catcierge_create_and_get_path(grb, var, \
+						grb->args._output, DIR_ONLY, buf, bufsize);
+
+		OUTPUT_PATH_VAR(CATCIERGE_VAR_OUTPUT_PATH, output_path);
+		OUTPUT_PATH_VAR(CATCIERGE_VAR_MATCH_OUTPUT_PATH, match_output_path);
+		OUTPUT_PATH_VAR(CATCIERGE_VAR_STEPS_OUTPUT_PATH, steps_output_path);
+		OUTPUT_PATH_VAR(CATCIERGE_VAR_OBSTRUCT_OUTPUT_PATH, obstruct_output_path);
+		OUTPUT_PATH_VAR(CATCIERGE_VAR_TEMPLATE_OUTPUT_PATH, template_output_path);
+		#undef OUTPUT_PATH_VAR
+
+		case CATCIERGE_VAR_MATCHER:
+			return grb->matcher->short_name;
+		case CATCIERGE_VAR_OK_MATCHES_NEEDED:
+			snprintf(buf, bufsize - 1, "%d", grb->args.ok_matches_needed);
+			return buf;
+		case CATCIERGE_VAR_NO_FINAL_DECISION:
+			snprintf(buf, bufsize - 1, "%d", grb->args.no_final_decision);
+			return buf;
+		case CATCIERGE_VAR_MATCHTIME:
+			snprintf(buf, bufsize - 1, "%d", grb->args.match_time);
+			return buf;
+		case CATCIERGE_VAR_LOCKOUT_METHOD:
+			snprintf(buf, bufsize - 1, "%d", (int)grb->args.lockout_method);
+			return buf;
+		case CATCIERGE_VAR_LOCKOUT_ERROR:
+			snprintf(buf, bufsize - 1, "%d", grb->args.max_consecutive_lockout_count);
+			return buf;
+		case CATCIERGE_VAR_LOCKOUT_ERROR_DELAY:
+			snprintf(buf, bufsize - 1, "%0.2f", grb->args.consecutive_lockout_delay);
+			return buf;
+		case CATCIERGE_VAR_LOCKOUT_TIME:
+			snprintf(buf, bufsize - 1, "%d", grb->args.lockout_time);
+			return buf;
+		case CATCIERGE_VAR_MATCH_GROUP_ID:
+			return catcierge_get_short_id(var + strlen("match_group_id"), buf, bufsize, &mg->sha);
+		case CATCIERGE_VAR_MATCH_GROUP_START_TIME:
+			return catcierge_get_time_var_format(var + strlen("match_group_start_"), buf, bufsize,
+						"%Y-%m-%d %H:%M:%S.%f", mg->start_time, &mg->start_tv);
+		case CATCIERGE_VAR_MATCH_GROUP_END_TIME:
+			return catcierge_get_time_var_format(var + strlen("match_group_end_"), buf, bufsize,
+						"%Y-%m-%d %H:%M:%S.%f", mg->end_time, &mg->end_tv);
+		case CATCIERGE_VAR_MATCH_GROUP_SUCCESS:
+			snprintf(buf, bufsize - 1, "%d", mg->success);
+			return buf;
+		case CATCIERGE_VAR_MATCH_GROUP_SUCCESS_COUNT:
+			snprintf(buf, bufsize - 1, "%d", mg->success_count);
+			return buf;
+		case CATCIERGE_VAR_MATCH_GROUP_FINAL_DECISION:
+			snprintf(buf, bufsize - 1, "%d", mg->final_decision);
+			return buf;
+		case CATCIERGE_VAR_MATCH_GROUP_EARLY_DECISION:
+			snprintf(buf, bufsize - 1, "%d", mg->early_decision);
+			return buf;
+		case CATCIERGE_VAR_ACTUATION_LATENCY:
+			snprintf(buf, bufsize - 1, "%0.3f", grb->actuation_latency * 1000.0);
+			return buf;
+		// With --async_events the worker renders from a snapshot
+		// taken when the event was posted, including these counters.
+		case CATCIERGE_VAR_EVENT_QUEUE_LENGTH:
+			snprintf(buf, bufsize - 1, "%d", (int)grb->event_bus.count);
+			return buf;
+		case CATCIERGE_VAR_EVENT_DROPPED_COUNT:
+			snprintf(buf, bufsize - 1, "%lu", grb->event_bus.dropped_count);
+			return buf;
+		case CATCIERGE_VAR_RENDER_ALLOC_COUNT:
+			snprintf(buf, bufsize - 1, "%d", (int)grb->output.last_render_alloc_count);
+			return buf;
+		case CATCIERGE_VAR_IMAGE_QUEUE_LENGTH:
+		case CATCIERGE_VAR_IMAGE_BYTES_WRITTEN:
+		case CATCIERGE_VAR_IMAGE_WRITE_LATENCY:
+		{
+			catcierge_image_writer_stats_t stats;
+			catcierge_image_writer_stats(&grb->image_writer, &stats);
+
+			if (ref->id == CATCIERGE_VAR_IMAGE_QUEUE_LENGTH)
+				snprintf(buf, bufsize - 1, "%d", (int)stats.count);
+			else if (ref->id == CATCIERGE_VAR_IMAGE_BYTES_WRITTEN)
+				snprintf(buf, bufsize - 1, "%llu", stats.bytes_written);
+			else
+				snprintf(buf, bufsize - 1, "%0.3f", stats.written_count
+					? (stats.total_latency / stats.written_count) * 1000.0 : 0.0);
+			return buf;
+		}
+		case CATCIERGE_VAR_DISK_FREE:
+		{
+			catcierge_retention_stats_t stats;
+			catcierge_retention_stats(&grb->retention, &stats);
+			snprintf(buf, bufsize - 1, "%llu", stats.disk_free);
+			return buf;
+		}
+		case CATCIERGE_VAR_DISK_USAGE:
+		case CATCIERGE_VAR_RETENTION_REMOVED_COUNT:
+		{
+			catcierge_retention_stats_t stats;
+			unsigned long long total = 0;
+			int i;
+			catcierge_retention_stats(&grb->retention, &stats);
+			for (i = 0; i < CATCIERGE_RETAIN_CLASS_COUNT; i++)
 			{
-				return step->path.filename;
+				total += (ref->id == CATCIERGE_VAR_DISK_USAGE)
+					? stats.usage[i].bytes
+					: stats.usage[i].deleted_count;
 			}
-			else if (!strcmp(stepvar, "name"))
+			snprintf(buf, bufsize - 1, "%llu", total);
+			return buf;
+		}
+		case CATCIERGE_VAR_MOSAIC_PATH:
+			if (!*grb->mosaic.path)
+				return "";
+			return catcierge_create_and_get_path(grb, var, grb->mosaic.path, 0, buf, bufsize);
+		case CATCIERGE_VAR_MOSAIC_LATENCY:
+			snprintf(buf, bufsize - 1, "%0.3f", grb->mosaic.last_latency * 1000.0);
+			return buf;
+		case CATCIERGE_VAR_MATCH_GROUP_SKIPPED_FRAMES:
+			snprintf(buf, bufsize - 1, "%d", mg->skipped_frames);
+			return buf;
+		case CATCIERGE_VAR_STREAM_TOTAL:
+			snprintf(buf, bufsize - 1, "%d", (int)grb->match_window.total);
+			return buf;
+		case CATCIERGE_VAR_STREAM_WINDOW_COUNT:
+			snprintf(buf, bufsize - 1, "%d", (int)grb->match_window.count);
+			return buf;
+		case CATCIERGE_VAR_STREAM_WINDOW_SUCCESS_COUNT:
+			snprintf(buf, bufsize - 1, "%d", grb->match_window.success_count);
+			return buf;
+		case CATCIERGE_VAR_MATCH_GROUP_DIRECTION:
+			return catcierge_get_direction_str(mg->direction);
+		case CATCIERGE_VAR_MATCH_GROUP_DESCRIPTION:
+			return mg->description;
+		case CATCIERGE_VAR_MATCH_GROUP_COUNT:
+			snprintf(buf, bufsize - 1, "%d", (int)mg->match_count);
+			return buf;
+		case CATCIERGE_VAR_MATCH_GROUP_MAX_COUNT:
+			snprintf(buf, bufsize - 1, "%d", MATCH_MAX_COUNT);
+			return buf;
+		case CATCIERGE_VAR_OBSTRUCT_FILENAME:
+			return mg->obstruct_path.filename;
+		case CATCIERGE_VAR_OBSTRUCT_PATH:
+			return catcierge_get_path(grb, var, &mg->obstruct_path, buf, bufsize);
+		case CATCIERGE_VAR_OBSTRUCT_TIME:
+			return catcierge_get_time_var_format(var + strlen("obstruct_"), buf, bufsize,
+						"%Y-%m-%d %H:%M:%S.%f", mg->obstruct_time, &mg->obstruct_tv);
+		case CATCIERGE_VAR_MATCH_INVALID:
+			// The matchers can have variables starting with "match" as well.
+			if (grb->matcher && (matcher_val = grb->matcher->translate(grb->matcher, var, buf, bufsize)))
 			{
-				return step->name ? step->name : "";
+				return matcher_val;
 			}
-			else if (!strncmp(stepvar, "desc", 4))
+
+			CATERR("Output: %s out of range. (%lu > %lu)\n", var, -2, grb->match_group.match_count);
+			return NULL;
+		case CATCIERGE_VAR_UNKNOWN:
+			if (grb->matcher && (matcher_val = grb->matcher->translate(grb->matcher, var, buf, bufsize)))
 			{
-				return step->description ? step->description : "";
+				return matcher_val;
 			}
-			else if (!strcmp(stepvar, "active"))
+			break;
+		default:
+		{
+			const char *res = NULL;
+
+			if (ref->id > CATCIERGE_VAR_MATCH_INVALID)
 			{
-				snprintf(buf, bufsize - 1, "%d", step->img != NULL);
-				return buf;
+				int other = (ref->id == CATCIERGE_VAR_MATCH_OTHER)
+						 || (ref->id == CATCIERGE_VAR_STEP_OTHER);
+
+				if ((res = catcierge_output_translate_match(grb, buf, bufsize, var, ref)) || !other)
+				{
+					return res;
+				}
 			}
+			break;
 		}
 	}
 
@@ -1387,42 +1739,114 @@ const char *_catcierge_output_translate(catcierge_grb_t *grb,
 	return NULL;
 }
 
-char *catcierge_translate_inner_vars(catcierge_grb_t *grb, const char *var)
+static int catcierge_output_var_is_memoizable(int id)
 {
-	char *it = NULL;
-	char *output = NULL;
-	const char *innervar = NULL;
-	char *end = NULL;
-	size_t orig_len = 0;
-	size_t out_len = 0;
-	size_t reslen = 0;
-	size_t len = 0;
-	char buf[4096];
-	char *tmpvar = NULL;
+	switch (id)
+	{
+		case CATCIERGE_VAR_TEMPLATE_PATH:
+		case CATCIERGE_VAR_TIME:
+		case CATCIERGE_VAR_CWD:
+		case CATCIERGE_VAR_OUTPUT_PATH:
+		case CATCIERGE_VAR_MATCH_OUTPUT_PATH:
+		case CATCIERGE_VAR_STEPS_OUTPUT_PATH:
+		case CATCIERGE_VAR_OBSTRUCT_OUTPUT_PATH:
+		case CATCIERGE_VAR_TEMPLATE_OUTPUT_PATH:
+		case CATCIERGE_VAR_OBSTRUCT_PATH:
+		case CATCIERGE_VAR_MATCH_PATH:
+		case CATCIERGE_VAR_STEP_PATH:
+			return 1;
+	}
 
-	orig_len = strlen(var);
-	out_len = (2 * orig_len + 1);
+	return 0;
+}
 
-	if (!(output = malloc(out_len)))
+//
+// Paths, the current directory and the time don't change during a
+// render, but can be expensive to get (creating directories and
+// calculating relative paths). So we keep their values until the
+// outermost render is done.
+//
+static const char *catcierge_output_translate_ref(catcierge_grb_t *grb,
+	char *buf, size_t bufsize, const char *var, const catcierge_output_var_ref_t *ref)
+{
+	size_t i;
+	const char *res = NULL;
+	catcierge_output_t *ctx = &grb->output;
+	catcierge_output_memo_t *memo = NULL;
+
+	if ((ctx->render_depth == 0) || !catcierge_output_var_is_memoizable(ref->id))
 	{
-		CATERR("Out of memory\n"); return NULL;
+		return catcierge_output_translate_ref_uncached(grb, buf, bufsize, var, ref);
 	}
 
-	if (!(tmpvar = strdup(var)))
+	for (i = 0; i < ctx->memo_count; i++)
 	{
-		CATERR("Out of memory\n"); goto fail;
+		memo = &ctx->memo[i];
+
+		if ((memo->template_idx == ctx->template_idx) && !strcmp(memo->var, var))
+		{
+			return memo->value;
+		}
 	}
 
-	it = tmpvar;
+	if (!(res = catcierge_output_translate_ref_uncached(grb, buf, bufsize, var, ref)))
+	{
+		return NULL;
+	}
+
+	// The template paths are generated one at a time, so
+	// they're remembered once they exist. If we run out
+	// of room we simply don't remember any more values.
+	if (ctx->memo_count < CATCIERGE_OUTPUT_MAX_MEMO)
+	{
+		memo = &ctx->memo[ctx->memo_count];
+
+		if ((memo->var = catcierge_arena_strdup(&ctx->arena, var))
+		 && (memo->value = catcierge_arena_strdup(&ctx->arena, res)))
+		{
+			memo->template_idx = ctx->template_idx;
+			ctx->memo_count++;
+		}
+	}
+
+	return res;
+}
+
+const char *_catcierge_output_translate(catcierge_grb_t *grb,
+	char *buf, size_t bufsize, const char *var)
+{
+	catcierge_output_var_ref_t ref;
+	catcierge_output_resolve_var(var, &ref);
+	return catcierge_output_translate_ref(grb, buf, bufsize, var, &ref);
+}
+
+//
+// Expands any $inner$ variables inside of a variable name.
+// The result is allocated from the given arena.
+//
+char *catcierge_translate_inner_vars(catcierge_grb_t *grb,
+		catcierge_arena_t *arena, const char *var)
+{
+	const char *it = var;
+	const char *innervar = NULL;
+	const char *res = NULL;
+	char *innervartmp = NULL;
+	char *output = NULL;
+	size_t out_len = 2 * strlen(var) + 1;
+	size_t len = 0;
+	size_t reslen = 0;
+	char buf[4096];
+
+	if (!(output = catcierge_arena_alloc(arena, out_len)))
+	{
+		CATERR("Out of memory\n"); return NULL;
+	}
 
 	while (*it)
 	{
 		if (*it == '$')
 		{
-			const char *res = NULL;
-			char *innervartmp = NULL;
 			it++;
-
 			innervar = it;
 
 			while (*it && (*it != '$'))
@@ -1433,15 +1857,13 @@ char *catcierge_translate_inner_vars(catcierge_grb_t *grb, const char *var)
 			// Either we found it or the end of string.
 			if (*it != '$')
 			{
-				*it = '\0';
 				CATERR("Inner variable \"$...$\" not terminated inside of \"%s\"\n", var);
-				goto fail;
+				return NULL;
 			}
 
-			if (!(innervartmp = strndup(innervar, (it - innervar))))
+			if (!(innervartmp = catcierge_arena_strndup(arena, innervar, (it - innervar))))
 			{
-				CATERR("Out of memory\n");
-				goto fail;
+				CATERR("Out of memory\n"); return NULL;
 			}
 
 			it++;
@@ -1449,45 +1871,36 @@ char *catcierge_translate_inner_vars(catcierge_grb_t *grb, const char *var)
 			if (!(res = _catcierge_output_translate(grb, buf, sizeof(buf), innervartmp)))
 			{
 				CATERR("Unknown template inner variable \"%s\"\n", innervartmp);
-				catcierge_xfree(&innervartmp);
-				goto fail;
+				return NULL;
 			}
 
-			catcierge_xfree(&innervartmp);
 			reslen = strlen(res);
-
-			if (!(output = catcierge_output_realloc_if_needed(output, (len + reslen + 1), &out_len)))
-			{
-				CATERR("Out of memory\n");
-				goto fail;
-			}
-
-			while (*res)
-			{
-				output[len] = *res++;
-				len++;
-			}
 		}
 		else
 		{
-			if (!(output = catcierge_output_realloc_if_needed(output, (len + 1), &out_len)))
+			res = it++;
+			reslen = 1;
+		}
+
+		if ((len + reslen + 1) > out_len)
+		{
+			size_t new_len = 2 * (len + reslen + 1);
+
+			if (!(output = catcierge_arena_realloc(arena, output, out_len, new_len)))
 			{
-				goto fail;
+				CATERR("Out of memory\n"); return NULL;
 			}
 
-			output[len] = *it++;
-			len++;
+			out_len = new_len;
 		}
+
+		memcpy(&output[len], res, reslen);
+		len += reslen;
 	}
 
-	catcierge_xfree(&tmpvar);
 	output[len] = '\0';
 
 	return output;
-fail:
-	catcierge_xfree(&tmpvar);
-	catcierge_xfree(&output);
-	return NULL;
 }
 
 const char *catcierge_output_translate(catcierge_grb_t *grb,
@@ -1495,20 +1908,33 @@ const char *catcierge_output_translate(catcierge_grb_t *grb,
 {
 	const char *ret = NULL;
 	char *varexp = NULL;
+	catcierge_output_t *ctx = &grb->output;
+
+	if (!strchr(var, '$'))
+	{
+		return _catcierge_output_translate(grb, buf, bufsize, var);
+	}
 
 	// Expand variables inside of other variables.
-	if (!(varexp = catcierge_translate_inner_vars(grb, var)))
+	if ((varexp = catcierge_translate_inner_vars(grb, &ctx->arena, var)))
+	{
+		ret = _catcierge_output_translate(grb, buf, bufsize, varexp);
+	}
+	else
 	{
 		CATERR("Invalid inner variable '%s'\n", var);
-		return NULL;
 	}
 
-	ret = _catcierge_output_translate(grb, buf, bufsize, varexp);
-	catcierge_xfree(&varexp);
+	// Outside of a render nothing else is using the scratch memory.
+	if (ctx->render_depth == 0)
+	{
+		catcierge_arena_reset(&ctx->arena);
+	}
+
 	return ret;
 }
 
-char **catcierge_output_parse_for_loop_expr(catcierge_grb_t *grb,
+char **catcierge_output_parse_for_loop_expr(catcierge_grb_t *grb, catcierge_arena_t *arena,
 		const char *forexpr, char **for_expr_var_ret, size_t *for_expr_vals_count,
 		size_t *linenum)
 {
@@ -1560,7 +1986,7 @@ char **catcierge_output_parse_for_loop_expr(catcierge_grb_t *grb,
 
 		*for_expr_vals_count = range[1] - range[0] + 1;
 
-		if (!(for_expr_vals = calloc(*for_expr_vals_count, sizeof(char *))))
+		if (!(for_expr_vals = catcierge_arena_alloc(arena, *for_expr_vals_count * sizeof(char *))))
 		{
 			CATERR("Out of memory\n"); return NULL;
 		}
@@ -1569,16 +1995,17 @@ char **catcierge_output_parse_for_loop_expr(catcierge_grb_t *grb,
 		{
 			snprintf(valbuf, sizeof(valbuf) - 1, "%ld", j);
 
-			if (!(for_expr_vals[i] = strdup(valbuf)))
+			if (!(for_expr_vals[i] = catcierge_arena_strdup(arena, valbuf)))
 			{
-				catcierge_xfree_list(&for_expr_vals, for_expr_vals_count);
-				return NULL;
+				CATERR("Out of memory\n"); return NULL;
 			}
 		}
 	}
 	else if (*for_expr_valstr == '[')
 	{
 		char *range_str_end = NULL;
+		char *list = NULL;
+		char *s = NULL;
 
 		if (!(range_str_end = strchr(&for_expr_valstr[1], ']')))
 		{
@@ -1588,10 +2015,32 @@ char **catcierge_output_parse_for_loop_expr(catcierge_grb_t *grb,
 		*range_str_end = '\0';
 
 		// Split comma delimeted list into strings.
-		if (catcierge_split(&for_expr_valstr[1], ',', &for_expr_vals, for_expr_vals_count))
+		if (!(list = catcierge_arena_strdup(arena, &for_expr_valstr[1])))
 		{
-			CATERR("Failed to parse argument list in loop: '%s'\n", forexpr);
-			return NULL;
+			CATERR("Out of memory\n"); return NULL;
+		}
+
+		*for_expr_vals_count = 1;
+
+		for (s = list; *s; s++)
+		{
+			if (*s == ',')
+				(*for_expr_vals_count)++;
+		}
+
+		if (!(for_expr_vals = catcierge_arena_alloc(arena, *for_expr_vals_count * sizeof(char *))))
+		{
+			CATERR("Out of memory\n"); return NULL;
+		}
+
+		for (i = 0; i < *for_expr_vals_count; i++)
+		{
+			for_expr_vals[i] = list;
+
+			if ((list = strchr(list, ',')))
+			{
+				*list++ = '\0';
+			}
 		}
 	}
 	else
@@ -1600,265 +2049,289 @@ char **catcierge_output_parse_for_loop_expr(catcierge_grb_t *grb,
 		return NULL;
 	}
 
-	if (for_expr_vals)
+	if (!(*for_expr_var_ret = catcierge_arena_strdup(arena, for_expr_var)))
 	{
-		*for_expr_var_ret = strdup(for_expr_var);
+		CATERR("Out of memory\n"); return NULL;
 	}
 
 	return for_expr_vals;
 }
 
-char *catcierge_parse_body(const char *forexpr, char **template_str,
-									size_t start_linenum, size_t *linenum,
-									const char* start_tag, const char *end_tag,
-									int newline_after_tag)
+static catcierge_output_node_t *catcierge_output_add_node(catcierge_output_compiled_t *c,
+		catcierge_output_node_type_t type, const char *str, size_t len, size_t linenum)
 {
-	char *start = *template_str;
-	char *end = NULL;
-	char *var = NULL;
-	char *body = NULL;
-	char *it = NULL;
-	int inner_body = 0;
+	catcierge_output_node_t *n;
+	assert(c->count < c->max_count);
 
-	if (newline_after_tag)
+	n = &c->nodes[c->count];
+	memset(n, 0, sizeof(*n));
+
+	if (!(n->str = catcierge_arena_strndup(&c->arena, str, len)))
 	{
-		if (*start != '\n')
-		{
-			CATERR("Expected newline after '%s', line %d\n", forexpr, start_linenum);
-			goto fail;
-		}
+		CATERR("Out of memory\n"); return NULL;
+	}
+
+	n->type = type;
+	n->len = len;
+	n->linenum = linenum;
+	n->inner = (strchr(n->str, '$') != NULL);
+	c->count++;
+
+	return n;
+}
+
+static int catcierge_output_add_text_node(catcierge_output_compiled_t *c,
+		char *text, size_t *text_len, size_t linenum)
+{
+	if (*text_len == 0)
+		return 0;
 
-		start++; // Skip newline after for loop expression.
+	if (!catcierge_output_add_node(c, CATCIERGE_OUTPUT_NODE_TEXT, text, *text_len, linenum))
+		return -1;
+
+	c->nodes[c->count - 1].inner = 0;
+	c->text_len += *text_len;
+	*text_len = 0;
+
+	return 0;
+}
+
+void catcierge_output_free_compiled(catcierge_output_compiled_t *c)
+{
+	if (!c)
+		return;
+
+	catcierge_arena_destroy(&c->arena);
+	memset(c, 0, sizeof(*c));
+}
+
+int catcierge_output_compile(catcierge_output_compiled_t *c, const char *template_str)
+{
+	const char *it = template_str;
+	const char *var = NULL;
+	char *text = NULL;
+	size_t text_len = 0;
+	size_t linenum = 0;
+	size_t var_len = 0;
+	size_t open[CATCIERGE_OUTPUT_MAX_RECURSION];
+	size_t open_count = 0;
+	size_t tmpl_len = 0;
+	catcierge_output_node_t *n = NULL;
+	assert(c);
+	assert(template_str);
+
+	memset(c, 0, sizeof(*c));
+
+	// Every node except the last text node ends at a %, so this
+	// is enough nodes for the entire template.
+	c->max_count = 1;
+
+	for (it = template_str; *it; it++)
+	{
+		if (*it == '%')
+			c->max_count++;
+	}
+
+	tmpl_len = it - template_str;
+	it = template_str;
+
+	// Room for the nodes, their strings and the text scratch
+	// buffer, so that all of it fits in a single allocation.
+	catcierge_arena_init(&c->arena, (c->max_count * (sizeof(catcierge_output_node_t) + 16))
+							+ (2 * tmpl_len) + 64);
+
+	if (!(c->nodes = catcierge_arena_alloc(&c->arena,
+			c->max_count * sizeof(catcierge_output_node_t))))
+	{
+		CATERR("Out of memory\n"); goto fail;
+	}
+
+	// Text is never longer than the template itself.
+	if (!(text = catcierge_arena_alloc(&c->arena, tmpl_len + 1)))
+	{
+		CATERR("Out of memory\n"); goto fail;
 	}
-	it = start;
-	end = NULL;
 
 	while (*it)
 	{
 		if (*it == '\n')
 		{
-			(*linenum)++;
+			linenum++;
 		}
 
+		if (*it != '%')
+		{
+			text[text_len++] = *it++;
+			continue;
+		}
+
+		it++;
+
+		// %% means a literal %
 		if (*it == '%')
+		{
+			text[text_len++] = *it++;
+			continue;
+		}
+
+		// Save position at beginning of var name.
+		var = it;
+
+		// Look for the ending %
+		while (*it && (*it != '%') && (*it != '\n'))
 		{
 			it++;
+		}
+
+		var_len = it - var;
+
+		// Either we found it or the end of string.
+		if (*it != '%')
+		{
+			CATERR("Variable \"%.*s\" not terminated in output template line %d\n",
+				(int)var_len, var, (int)linenum);
+			goto fail;
+		}
 
-			// %% means a literal %
-			if (*it && (*it == '%'))
+		it++; // Skip ending %
+
+		if (catcierge_output_add_text_node(c, text, &text_len, linenum))
+			goto fail;
+
+		if (((var_len == strlen("endfor")) && !strncmp(var, "endfor", var_len))
+		 || ((var_len == strlen("endif")) && !strncmp(var, "endif", var_len)))
+		{
+			catcierge_output_node_type_t type = (var[3] == 'f')
+				? CATCIERGE_OUTPUT_NODE_FOR : CATCIERGE_OUTPUT_NODE_IF;
+
+			if ((open_count == 0) || (c->nodes[open[open_count - 1]].type != type))
 			{
-				it++;
-				continue;
+				CATERR("Unexpected '%%%.*s%%' in output template line %d\n",
+					(int)var_len, var, (int)linenum);
+				goto fail;
 			}
 
-			// Save position at beginning of var name.
-			var = it;
+			open_count--;
+			n = &c->nodes[open[open_count]];
+			n->body_count = c->count - open[open_count] - 1;
 
-			// Look for the ending %
-			while (*it && (*it != '%') && (*it != '\n'))
+			if (type == CATCIERGE_OUTPUT_NODE_FOR)
 			{
+				if (*it != '\n')
+				{
+					CATERR("Expected newline after 'endfor' got '%c', line %d\n",
+							*it, (int)linenum);
+					goto fail;
+				}
+
 				it++;
+				linenum++;
 			}
 
-			// Either we found it or the end of string.
-			if (*it != '%')
+			continue;
+		}
+
+		if (!strncmp(var, "for", 3) || !strncmp(var, "if", 2))
+		{
+			int is_for = (var[0] == 'f');
+
+			if (open_count >= CATCIERGE_OUTPUT_MAX_RECURSION)
 			{
-				*it = '\0';
-				CATERR("Variable \"%s\" not terminated. Line %d\n",
-						var, (int)*linenum);
+				CATERR("Max output template recursion level reached (%d)!\n",
+					CATCIERGE_OUTPUT_MAX_RECURSION);
 				goto fail;
 			}
 
-			if (!(var = strndup(var, (it - var))))
+			if (!(n = catcierge_output_add_node(c, is_for ? CATCIERGE_OUTPUT_NODE_FOR
+					: CATCIERGE_OUTPUT_NODE_IF, var, var_len, linenum)))
 			{
-				CATERR("Out of memory\n"); goto fail;
+				goto fail;
 			}
 
-			it++; // Skip ending %
+			open[open_count++] = c->count - 1;
 
-			if (!strncmp(var, start_tag, strlen(start_tag)))
-			{
-				inner_body++;
-			}
-			else if (!strcmp(var, end_tag))
+			if (is_for)
 			{
-				if (inner_body == 0)
-				{
-					// Found end of body.
-					end = it - (strlen(end_tag) + 2 + 1);
-					catcierge_xfree(&var);
-
-					if (newline_after_tag)
-					{
-						if (*it != '\n')
-						{
-							CATERR("Expected newline after '%s' got '%c', line %d\n",
-									end_tag, *it, *linenum);
-							goto fail;
-						}
-						it++;
-					}
-
-					break;
-				}
-				else
+				if (*it != '\n')
 				{
-					inner_body--;
+					CATERR("Expected newline after '%s', line %d\n", n->str, (int)linenum);
+					goto fail;
 				}
+
+				it++; // Skip newline after for loop expression.
+				linenum++;
 			}
 
-			catcierge_xfree(&var);
+			continue;
 		}
-		else
+
+		if (!(n = catcierge_output_add_node(c, CATCIERGE_OUTPUT_NODE_VAR,
+				var, var_len, linenum)))
 		{
-			it++;
+			goto fail;
+		}
+
+		// Variables that don't depend on any other
+		// variable can be looked up once and for all.
+		if (!n->inner)
+		{
+			catcierge_output_resolve_var(n->str, &n->ref);
 		}
 	}
 
-	if (end == NULL)
+	if (open_count > 0)
 	{
+		n = &c->nodes[open[open_count - 1]];
 		CATERR("Missing closing '%s' for '%s' at line %d\n",
-				end_tag, forexpr, start_linenum);
+			(n->type == CATCIERGE_OUTPUT_NODE_FOR) ? "endfor" : "endif",
+			n->str, (int)n->linenum);
 		goto fail;
 	}
 
-	// Copy the body.
-	if (!(body = strndup(start, (end - start) + 1)))
-	{
+	if (catcierge_output_add_text_node(c, text, &text_len, linenum))
 		goto fail;
-	}
-
-	// Pass our iterator back to the caller (after the for loop).
-	*template_str = it;
 
+	return 0;
 fail:
-
-	return body;
+	catcierge_output_free_compiled(c);
+	return -1;
 }
 
-char *catcierge_parse_for_loop(catcierge_grb_t *grb, char **template_str,
-		const char *forexpr, size_t *linenum)
+// The output of a render, nested loops and ifs append to the same buffer.
+typedef struct catcierge_output_buf_s
 {
-	char *it = NULL;
-	char *for_expr_var = NULL;
-	char **for_expr_vals = NULL;
-	size_t for_expr_vals_count = 0;
-	char *for_body = NULL;
-	size_t start_linenum = *linenum;
-	catcierge_output_t *ctx = &grb->output;
-	assert(grb);
-
-	forexpr += sizeof("for");
-
-	// Parse the for loop expression.
-	if (!(for_expr_vals = catcierge_output_parse_for_loop_expr(grb, forexpr,
-							&for_expr_var, &for_expr_vals_count, linenum)))
-	{
-		return NULL;
-	}
-
-	// Find end of the for loop body.
-	if (!(for_body = catcierge_parse_body(forexpr, template_str,
-						start_linenum, linenum, "for", "endfor", 1)))
-	{
-		goto fail;
-	}
+	char *str;
+	size_t len;
+	size_t size;
+} catcierge_output_buf_t;
 
-	// Now generate based on the loop body.
+static int catcierge_output_append(catcierge_output_t *ctx,
+		catcierge_output_buf_t *out, const char *str, size_t len)
+{
+	// Make sure we have enough room.
+	if ((out->len + len + 1) > out->size)
 	{
-		char *res = NULL;
-		char *resit = NULL;
-		size_t reslen = 0;
-		char *output = NULL;
-		size_t orig_len = 0;
-		size_t out_len = 0;
-		size_t len = 0;
-		catcierge_output_invar_t *var_it = NULL;
-		size_t i;
-
-		orig_len = strlen(for_body);
-		out_len = (2 * orig_len + 1) * for_expr_vals_count;
-
-		if (!(output = malloc(out_len)))
-		{
-			CATERR("Out of memory\n"); goto fail;
-		}
-
-		if (!(var_it = catcierge_output_add_user_variable(&grb->output, for_expr_var, NULL)))
-		{
-			CATERR("Failed to add variable '%s'\n", for_expr_var);
-			catcierge_xfree(&output);
-			goto fail_gen;
-		}
-
-		for (i = 0; i < for_expr_vals_count; i++)
-		{
-			// Set loop var value.
-			catcierge_xfree(&var_it->value);
-
-			if (!(var_it->value = strdup(for_expr_vals[i])))
-			{
-				CATERR("Out of memory\n");
-				catcierge_xfree(&output);
-				goto fail_gen;
-			}
-
-			if (!(res = catcierge_output_generate(&grb->output, grb, for_body)))
-			{	
-				CATERR("Failed to generate loop at iteration %d\n", i);
-				catcierge_xfree(&output);
-				goto fail_gen;
-			}
-
-			reslen = strlen(res);
-
-			if (!(output = catcierge_output_realloc_if_needed(output, (len + reslen + 1), &out_len)))
-			{
-				CATERR("Out of memory\n"); goto fail_gen;
-			}
-
-			resit = res;
-			while (*resit)
-			{
-				output[len] = *resit++;
-				len++;
-			}
-
-			catcierge_xfree(&res);
-		}
-
-		output[len] = '\0';
-
-	fail_gen:
-		if (var_it)
+		if (!(out->str = catcierge_output_realloc_if_needed(out->str,
+				(out->len + len + 1), &out->size)))
 		{
-			HASH_DEL(grb->output.vars, var_it);
-			catcierge_xfree(&var_it->value);
-			catcierge_xfree(&var_it);
+			return -1;
 		}
 
-		catcierge_xfree_list(&for_expr_vals, &for_expr_vals_count);
-		catcierge_xfree(&for_expr_var);
-		catcierge_xfree(&for_body);
-		catcierge_xfree(&res);
-
-		return output;
+		ctx->render_alloc_count++;
 	}
 
-fail:
-	catcierge_xfree_list(&for_expr_vals, &for_expr_vals_count);
-	catcierge_xfree(&for_expr_var);
-	catcierge_xfree(&for_body);
-	return NULL;
+	memcpy(&out->str[out->len], str, len);
+	out->len += len;
+	out->str[out->len] = '\0';
+
+	return 0;
 }
 
-char *catcierge_parse_if(catcierge_grb_t *grb, char **template_str,
-		const char *ifexpr, size_t *linenum)
+static int catcierge_output_eval_if(catcierge_grb_t *grb,
+		const char *ifexpr, size_t linenum)
 {
-	char *output = NULL;
 	const char *res = NULL;
 	const char *varval = NULL;
-	size_t start_linenum = *linenum;
 	char valstrs[2][128];
 	char *end = NULL;
 	long vals[2];
@@ -1871,8 +2344,8 @@ char *catcierge_parse_if(catcierge_grb_t *grb, char **template_str,
 
 	if (sscanf(ifexpr, "%127s %127s %127s", valstrs[0], operator, valstrs[1]) != 3)
 	{
-		CATERR("Failed to parse if expression '%s' on line %d\n", ifexpr, *linenum);
-		return NULL;
+		CATERR("Failed to parse if expression '%s' on line %d\n", ifexpr, (int)linenum);
+		return -1;
 	}
 
 	// TODO: Add string support.
@@ -1883,14 +2356,14 @@ char *catcierge_parse_if(catcierge_grb_t *grb, char **template_str,
 
 		if ((varval = catcierge_output_translate(grb, buf, sizeof(buf), res)))
 		{
-			res = varval; 
+			res = varval;
 		}
 
 		vals[i] = strtol(res, &end, 10);
 		if (end == res)
 		{
 			CATERR("Failed to parse '%s' as an integer\n", res);
-			goto fail;
+			return -1;
 		}
 	}
 
@@ -1901,216 +2374,271 @@ char *catcierge_parse_if(catcierge_grb_t *grb, char **template_str,
 	else if (!strcmp(operator, ">")) if_val = (vals[0] > vals[1]);
 	else if (!strcmp(operator, "<")) if_val = (vals[0] < vals[1]);
 
-	if (!(output = catcierge_parse_body(ifexpr, template_str,
-						start_linenum, linenum, "if", "endif", 0)))
+	return if_val;
+}
+
+static int catcierge_output_render_nodes(catcierge_output_t *ctx, catcierge_grb_t *grb,
+		const catcierge_output_node_t *nodes, size_t count, catcierge_output_buf_t *out);
+
+static int catcierge_output_render_for(catcierge_output_t *ctx, catcierge_grb_t *grb,
+		const catcierge_output_node_t *n, const char *forexpr, catcierge_output_buf_t *out)
+{
+	size_t i;
+	int ret = -1;
+	size_t linenum = n->linenum;
+	char *for_expr_var = NULL;
+	char **for_expr_vals = NULL;
+	size_t for_expr_vals_count = 0;
+	catcierge_output_invar_t *var_it = NULL;
+
+	// Parse the for loop expression.
+	if (!(for_expr_vals = catcierge_output_parse_for_loop_expr(grb, &ctx->arena,
+							forexpr + sizeof("for"), &for_expr_var,
+							&for_expr_vals_count, &linenum)))
 	{
-		goto fail;
+		return -1;
 	}
 
-	if (!if_val)
+	// The loop variable lives in the render arena, so unlike
+	// catcierge_output_add_user_variable() nothing is malloced.
+	HASH_FIND_STR(grb->output.vars, for_expr_var, var_it);
+
+	if (var_it)
 	{
-		output[0] = '\0';
+		CATERR("Variable '%s' already defined\n", for_expr_var);
+		return -1;
 	}
 
-	return output;
+	if (!(var_it = catcierge_arena_alloc(&ctx->arena, sizeof(*var_it))))
+	{
+		CATERR("Out of memory\n"); return -1;
+	}
+
+	memset(var_it, 0, sizeof(*var_it));
+	strncpy(var_it->name, for_expr_var, sizeof(var_it->name) - 1);
+	HASH_ADD_STR(grb->output.vars, name, var_it);
+
+	for (i = 0; i < for_expr_vals_count; i++)
+	{
+		// Set loop var value.
+		var_it->value = for_expr_vals[i];
+
+		if (catcierge_output_render_nodes(ctx, grb, n + 1, n->body_count, out))
+		{
+			CATERR("Failed to generate loop at iteration %d\n", i);
+			goto fail;
+		}
+	}
+
+	ret = 0;
+
 fail:
-	return NULL;
+	HASH_DEL(grb->output.vars, var_it);
+	var_it->value = NULL;
+
+	return ret;
 }
 
-char *catcierge_output_generate(catcierge_output_t *ctx,
-		catcierge_grb_t *grb, const char *template_str)
+static int catcierge_output_render_nodes(catcierge_output_t *ctx, catcierge_grb_t *grb,
+		const catcierge_output_node_t *nodes, size_t count, catcierge_output_buf_t *out)
 {
+	size_t i;
 	char buf[4096];
-	char *var;
-	char *it;
-	char *output = NULL;
-	char *tmp = NULL;
-	size_t orig_len = 0;
-	size_t out_len = 0;
-	size_t len;
-	size_t linenum;
-	size_t reslen;
-	assert(ctx);
-	assert(grb);
-
-	if (!template_str)
-		return NULL;
+	const catcierge_output_node_t *n;
 
 	if (ctx->recursion >= CATCIERGE_OUTPUT_MAX_RECURSION)
 	{
 		CATERR("Max output template recursion level reached (%d)!\n",
 			CATCIERGE_OUTPUT_MAX_RECURSION);
 		ctx->recursion_error = 1;
-		return NULL;
+		return -1;
 	}
 
-	orig_len = strlen(template_str);
-	out_len = 2 * orig_len + 1;
-
-	if (!(output = malloc(out_len)))
+	for (i = 0; i < count; i++)
 	{
-		return NULL;
-	}
+		const char *res = NULL;
+		char *expr = NULL;
+		int ret = 0;
+		n = &nodes[i];
 
-	if (!(tmp = strdup(template_str)))
-	{
-		free(output);
-		return NULL;
-	}
+		if (n->type == CATCIERGE_OUTPUT_NODE_TEXT)
+		{
+			if (catcierge_output_append(ctx, out, n->str, n->len))
+				return -1;
 
-	len = 0;
-	linenum = 0;
-	it = tmp;
+			continue;
+		}
 
-	while (*it)
-	{
-		if (*it == '\n')
+		// Expand variables inside of the variable name.
+		if (n->inner && !(expr = catcierge_translate_inner_vars(grb, &ctx->arena, n->str)))
 		{
-			linenum++;
+			if (n->type == CATCIERGE_OUTPUT_NODE_VAR)
+				CATERR("Invalid inner variable '%s'\n", n->str);
+			return -1;
 		}
 
-		// Replace any variables signified by %varname%
-		if (*it == '%')
-		{
-			const char *res = NULL; // TODO: Cannot be const for all cases, refactor this.
-			const char *resit = NULL;
-			int res_is_alloc = 0;
-			it++;
+		// Some variables can nest other variables, make sure
+		// we don't end up in an infinite recursion.
+		ctx->recursion++;
 
-			// %% means a literal %
-			if (*it && (*it == '%'))
+		switch (n->type)
+		{
+			case CATCIERGE_OUTPUT_NODE_VAR:
 			{
-				output[len] = *it++;
-				len++;
-				continue;
-			}
+				catcierge_output_var_ref_t ref;
+
+				if (expr)
+				{
+					catcierge_output_resolve_var(expr, &ref);
+				}
 
-			// Save position at beginning of var name.
-			var = it;
+				// Find the value of the variable and append it to the output.
+				if (!(res = catcierge_output_translate_ref(grb, buf, sizeof(buf),
+						expr ? expr : n->str, expr ? &ref : &n->ref)))
+				{
+					if (ctx->recursion_error)
+					{
+						CATERR(" %*s\"%s\"\n", (CATCIERGE_OUTPUT_MAX_RECURSION - ctx->recursion), "", n->str);
+					}
+					else
+					{
+						CATERR("Unknown template variable \"%s\"\n", n->str);
+					}
 
-			// Look for the ending %
-			while (*it && (*it != '%') && (*it != '\n'))
+					ret = -1;
+				}
+				else
+				{
+					ret = catcierge_output_append(ctx, out, res, strlen(res));
+				}
+				break;
+			}
+			case CATCIERGE_OUTPUT_NODE_FOR:
 			{
-				it++;
+				ret = catcierge_output_render_for(ctx, grb, n,
+						expr ? expr : n->str, out);
+				break;
 			}
-
-			// Either we found it or the end of string.
-			if (*it != '%')
+			case CATCIERGE_OUTPUT_NODE_IF:
 			{
-				*it = '\0';
-				CATERR("Variable \"%s\" not terminated in output template line %d\n",
-					var, (int)linenum);
-				catcierge_xfree(&output);
-				goto fail;
+				if ((ret = catcierge_output_eval_if(grb, expr ? expr : n->str, n->linenum)) > 0)
+				{
+					ret = catcierge_output_render_nodes(ctx, grb, n + 1, n->body_count, out);
+				}
+				break;
 			}
+		}
 
-			// Terminate so we get the var name in a nice comparable string.
-			*it++ = '\0';
+		ctx->recursion--;
 
-			// Some variables can nest other variables, make sure
-			// we don't end up in an infinite recursion.
-			ctx->recursion++;
+		if (ret < 0)
+		{
+			if (ctx->recursion == 0)
+				ctx->recursion_error = 0;
 
-			// TODO: Refactor
-			if (!strncmp(var, "for", 3))
-			{
-				res_is_alloc = 1;
+			return -1;
+		}
 
-				if (!(var = catcierge_translate_inner_vars(grb, var)))
-				{
-					catcierge_xfree(&output);
-					goto fail;
-				}
+		// Skip the for/if body.
+		i += n->body_count;
+	}
 
-				if (!(res = catcierge_parse_for_loop(grb, &it, var, &linenum)))
-				{
-					catcierge_xfree(&var);
-					catcierge_xfree(&output);
-					goto fail;
-				}
+	return 0;
+}
 
-				catcierge_xfree(&var);
-			}
-			else if (!strncmp(var, "if", 2))
-			{
-				res_is_alloc = 1;
+void catcierge_output_render_begin(catcierge_output_t *ctx)
+{
+	assert(ctx);
 
-				if (!(var = catcierge_translate_inner_vars(grb, var)))
-				{
-					catcierge_xfree(&output);
-					goto fail;
-				}
+	if (ctx->render_depth++ == 0)
+	{
+		ctx->render_alloc_count = 0;
+		ctx->memo_count = 0;
+		gettimeofday(&ctx->render_tv, NULL);
+	}
+}
 
-				if (!(res = catcierge_parse_if(grb, &it, var, &linenum)))
-				{
-					catcierge_xfree(&var);
-					catcierge_xfree(&output);
-					goto fail;
-				}
+void catcierge_output_render_end(catcierge_output_t *ctx)
+{
+	assert(ctx);
+	assert(ctx->render_depth > 0);
 
-				catcierge_xfree(&var);				
-			}
-			// Find the value of the variable and append it to the output.
-			else if (!(res = catcierge_output_translate(grb, buf, sizeof(buf), var)))
-			{
-				if (ctx->recursion_error)
-				{
-					CATERR(" %*s\"%s\"\n", (CATCIERGE_OUTPUT_MAX_RECURSION - ctx->recursion), "", var);
-					ctx->recursion--;
+	// Everything allocated while rendering is freed in one go
+	// when the outermost render is done.
+	if (--ctx->render_depth == 0)
+	{
+		ctx->render_alloc_count += ctx->arena.block_alloc_count;
+		ctx->last_render_alloc_count = ctx->render_alloc_count;
+		ctx->memo_count = 0;
+		catcierge_arena_reset(&ctx->arena);
+	}
+}
 
-					if (ctx->recursion == 0)
-						ctx->recursion_error = 0;
-				}
-				else
-				{
-					CATERR("Unknown template variable \"%s\"\n", var);
-				}
+char *catcierge_output_render(catcierge_output_t *ctx,
+		catcierge_grb_t *grb, catcierge_output_compiled_t *c)
+{
+	catcierge_output_buf_t out;
+	assert(ctx);
+	assert(grb);
+	assert(c);
 
-				catcierge_xfree(&output);
-				goto fail;
-			}
+	// Start out with the size of the last output, so
+	// the buffer usually only has to be allocated once.
+	out.len = 0;
+	out.size = c->size_hint ? c->size_hint : (2 * c->text_len + 1);
 
-			ctx->recursion--;
+	if (!(out.str = malloc(out.size)))
+	{
+		CATERR("Out of memory\n"); return NULL;
+	}
 
-			reslen = strlen(res);
+	catcierge_output_render_begin(ctx);
+	ctx->render_alloc_count++;
+	*out.str = '\0';
 
-			// Make sure we have enough room.
-			if (!(output = catcierge_output_realloc_if_needed(output, (len + reslen + 1), &out_len)))
-			{
-				goto fail;
-			}
+	if (catcierge_output_render_nodes(ctx, grb, c->nodes, c->count, &out))
+	{
+		catcierge_xfree(&out.str);
+	}
+	else if (out.len >= c->size_hint)
+	{
+		c->size_hint = out.len + 1;
+	}
 
-			// Append the variable to the output.
-			resit = res;
-			while (*resit)
-			{
-				output[len] = *resit++;
-				len++;
-			}
+	catcierge_output_render_end(ctx);
 
-			if (res_is_alloc)
-			{
-				catcierge_xfree(&res);
-			}
-		}
-		else
-		{
-			// Make sure we have enough room.
-			if (!(output = catcierge_output_realloc_if_needed(output, (len + 1), &out_len)))
-			{
-				goto fail;
-			}
+	return out.str;
+}
 
-			output[len] = *it++;
-			len++;
-		}
+char *catcierge_output_generate(catcierge_output_t *ctx,
+		catcierge_grb_t *grb, const char *template_str)
+{
+	char *output = NULL;
+	catcierge_output_compiled_t c;
+	assert(ctx);
+	assert(grb);
+
+	if (!template_str)
+		return NULL;
+
+	if (ctx->recursion >= CATCIERGE_OUTPUT_MAX_RECURSION)
+	{
+		CATERR("Max output template recursion level reached (%d)!\n",
+			CATCIERGE_OUTPUT_MAX_RECURSION);
+		ctx->recursion_error = 1;
+		return NULL;
 	}
 
-	output[len] = '\0';
+	catcierge_output_render_begin(ctx);
 
-fail:
-	if (tmp)
-		free(tmp);
+	if (!catcierge_output_compile(&c, template_str))
+	{
+		ctx->render_alloc_count += c.arena.block_alloc_count;
+		output = catcierge_output_render(ctx, grb, &c);
+		catcierge_output_free_compiled(&c);
+	}
+
+	catcierge_output_render_end(ctx);
 
 	return output;
 }
@@ -2201,8 +2729,177 @@ int catcierge_output_template_registered_to_event(catcierge_output_template_t *t
 	return 0;
 }
 
-int catcierge_output_generate_templates(catcierge_output_t *ctx,
-	catcierge_grb_t *grb, const char *event)
+static int catcierge_output_same_rootpath(const char *a, const char *b)
+{
+	if (!a || !b)
+		return (a == b);
+
+	return !strcmp(a, b);
+}
+
+static const char *catcierge_serialize_time(char *buf, size_t bufsize,
+	const char *fmt, time_t t, struct timeval *tv)
+{
+	if (!catcierge_strftime(buf, bufsize - 1, fmt, localtime(&t), tv))
+	{
+		return NULL;
+	}
+
+	return buf;
+}
+
+#ifdef WITH_RFID
+static void catcierge_serialize_rfid_match(catcierge_serializer_t *s, rfid_match_t *m)
+{
+	catcierge_serialize_map_begin(s, 5);
+	catcierge_serialize_kv_int(s, "triggered", m->triggered);
+	catcierge_serialize_key(s, "data");
+	catcierge_serialize_strn(s, m->data, strnlen(m->data, sizeof(m->data)));
+	catcierge_serialize_kv_int(s, "complete", m->complete);
+	catcierge_serialize_kv_str(s, "time", m->time_str);
+	catcierge_serialize_kv_int(s, "is_allowed", m->is_allowed);
+	catcierge_serialize_map_end(s);
+}
+#endif // WITH_RFID
+
+int catcierge_output_serialize_event(catcierge_output_t *ctx, catcierge_grb_t *grb,
+	const char *event, catcierge_serialize_format_t format)
+{
+	catcierge_serializer_t *s = &ctx->serializer;
+	catcierge_args_t *args = &grb->args;
+	match_group_t *mg = &grb->match_group;
+	match_state_t *m = NULL;
+	match_step_t *step = NULL;
+	struct timeval tv = ctx->render_tv;
+	char buf[256];
+	size_t field_count = 24;
+	size_t i;
+	size_t j;
+	assert(ctx);
+	assert(grb);
+
+	#ifdef WITH_RFID
+	field_count++;
+	#endif
+
+	if (ctx->render_depth == 0)
+	{
+		gettimeofday(&tv, NULL);
+	}
+
+	catcierge_serializer_reset(s, format);
+
+	// Same fields as the extra/templates/event.json template, flags
+	// are kept as 0/1 numbers so existing consumers can switch over.
+	catcierge_serialize_map_begin(s, field_count);
+	catcierge_serialize_kv_str(s, "event_json_version", "1.0");
+	catcierge_serialize_kv_str(s, "id", catcierge_get_short_id("", buf, sizeof(buf), &mg->sha));
+	catcierge_serialize_kv_str(s, "catcierge_type", event);
+	catcierge_serialize_kv_str(s, "start", catcierge_serialize_time(buf, sizeof(buf),
+		"%Y-%m-%dT%H:%M:%S.%f%z", mg->start_time, &mg->start_tv));
+	catcierge_serialize_kv_str(s, "end", catcierge_serialize_time(buf, sizeof(buf),
+		"%Y-%m-%dT%H:%M:%S.%f%z", mg->end_time, &mg->end_tv));
+	catcierge_serialize_kv_str(s, "time_generated", catcierge_serialize_time(buf, sizeof(buf),
+		"%Y-%m-%d %H:%M:%S.%f", tv.tv_sec, &tv));
+	catcierge_serialize_kv_str(s, "timezone", catcierge_serialize_time(buf, sizeof(buf),
+		"%Z", tv.tv_sec, &tv));
+	catcierge_serialize_kv_str(s, "timezone_utc_offset", catcierge_serialize_time(buf, sizeof(buf),
+		"%z", tv.tv_sec, &tv));
+	catcierge_serialize_kv_str(s, "git_hash", CATCIERGE_GIT_HASH);
+	catcierge_serialize_kv_str(s, "git_hash_short", CATCIERGE_GIT_HASH_SHORT);
+	catcierge_serialize_kv_int(s, "git_tainted", CATCIERGE_GIT_TAINTED);
+	catcierge_serialize_kv_str(s, "version", CATCIERGE_VERSION_STR);
+	catcierge_serialize_kv_str(s, "state", catcierge_get_state_string(grb->state));
+	catcierge_serialize_kv_str(s, "prev_state", catcierge_get_state_string(grb->prev_state));
+
+	catcierge_serialize_key(s, "settings");
+	catcierge_serialize_map_begin(s, 8);
+	catcierge_serialize_kv_str(s, "matcher", grb->matcher ? grb->matcher->short_name : NULL);
+	catcierge_serialize_kv_int(s, "matchtime", args->match_time);
+	catcierge_serialize_kv_int(s, "ok_matches_needed", args->ok_matches_needed);
+	catcierge_serialize_kv_int(s, "no_final_decision", args->no_final_decision);
+	catcierge_serialize_kv_int(s, "lockout_method", (int)args->lockout_method);
+	catcierge_serialize_kv_int(s, "lockout_time", args->lockout_time);
+	catcierge_serialize_kv_int(s, "lockout_error", args->max_consecutive_lockout_count);
+	catcierge_serialize_kv_double(s, "lockout_error_delay", args->consecutive_lockout_delay);
+	catcierge_serialize_map_end(s);
+
+	catcierge_serialize_kv_int(s, "match_group_success", mg->success);
+	catcierge_serialize_kv_int(s, "match_group_success_count", mg->success_count);
+	catcierge_serialize_kv_int(s, "match_group_final_decision", mg->final_decision);
+	catcierge_serialize_kv_int(s, "match_group_early_decision", mg->early_decision);
+	catcierge_serialize_kv_int(s, "match_group_count", (int)mg->match_count);
+	catcierge_serialize_kv_int(s, "match_group_max_count", MATCH_MAX_COUNT);
+	catcierge_serialize_kv_str(s, "match_group_direction", catcierge_get_direction_str(mg->direction));
+	catcierge_serialize_kv_str(s, "description", mg->description);
+
+	catcierge_serialize_key(s, "matches");
+	catcierge_serialize_array_begin(s, mg->match_count);
+
+	for (i = 0; (i < mg->match_count) && (i < MATCH_MAX_COUNT); i++)
+	{
+		m = &mg->matches[i];
+
+		catcierge_serialize_map_begin(s, 11);
+		catcierge_serialize_kv_str(s, "id", catcierge_get_short_id("", buf, sizeof(buf), &m->sha));
+		catcierge_serialize_kv_str(s, "filename", m->path.filename);
+		catcierge_serialize_kv_str(s, "path", catcierge_get_full_path(&m->path));
+		catcierge_serialize_kv_int(s, "success", m->result.success);
+		catcierge_serialize_kv_double(s, "result", m->result.result);
+		catcierge_serialize_kv_str(s, "time", catcierge_serialize_time(buf, sizeof(buf),
+			"%Y-%m-%d %H:%M:%S.%f", m->time, &m->tv));
+		catcierge_serialize_kv_str(s, "description", m->result.description);
+		catcierge_serialize_kv_str(s, "direction", catcierge_get_direction_str(m->result.direction));
+		catcierge_serialize_kv_int(s, "reused", m->result.reused);
+		catcierge_serialize_kv_int(s, "step_count", (int)m->result.step_img_count);
+
+		catcierge_serialize_key(s, "steps");
+		catcierge_serialize_array_begin(s, m->result.step_img_count);
+
+		for (j = 0; (j < m->result.step_img_count) && (j < MAX_STEPS); j++)
+		{
+			step = &m->result.steps[j];
+
+			catcierge_serialize_map_begin(s, 5);
+			catcierge_serialize_kv_int(s, "active", step->img != NULL);
+			catcierge_serialize_kv_str(s, "name", step->name ? step->name : "");
+			catcierge_serialize_kv_str(s, "filename", step->path.filename);
+			catcierge_serialize_kv_str(s, "path", catcierge_get_full_path(&step->path));
+			catcierge_serialize_kv_str(s, "description", step->description ? step->description : "");
+			catcierge_serialize_map_end(s);
+		}
+
+		catcierge_serialize_array_end(s);
+		catcierge_serialize_map_end(s);
+	}
+
+	catcierge_serialize_array_end(s);
+
+	#ifdef WITH_RFID
+	catcierge_serialize_key(s, "rfid");
+	catcierge_serialize_map_begin(s, 3);
+	catcierge_serialize_kv_str(s, "direction", catcierge_get_direction_str(grb->rfid_direction));
+	catcierge_serialize_key(s, "inner");
+	catcierge_serialize_rfid_match(s, &grb->rfid_in_match);
+	catcierge_serialize_key(s, "outer");
+	catcierge_serialize_rfid_match(s, &grb->rfid_out_match);
+	catcierge_serialize_map_end(s);
+	#endif // WITH_RFID
+
+	catcierge_serialize_map_end(s);
+
+	if (s->error)
+	{
+		CATERR("Failed to serialize event \"%s\" as %s\n",
+			event, catcierge_serialize_format_name(format));
+		return -1;
+	}
+
+	return 0;
+}
+
+static int catcierge_output_generate_templates_ex(catcierge_output_t *ctx,
+	catcierge_grb_t *grb, const char *event, int e)
 {
 	catcierge_output_template_t *t = NULL;
 	catcierge_args_t *args = &grb->args;
@@ -2211,6 +2908,10 @@ int catcierge_output_generate_templates(catcierge_output_t *ctx,
 	char full_path[4096];
 	char *dir = NULL;
 	char *gen_output_path = NULL;
+	const char *rootpath = NULL;
+	const char *data = NULL;
+	size_t data_len = 0;
+	catcierge_serialize_format_t serialized = CATCIERGE_FORMAT_TEXT;
 	size_t i;
 	int ret = 0;
 	FILE *f = NULL;
@@ -2228,13 +2929,23 @@ int catcierge_output_generate_templates(catcierge_output_t *ctx,
 
 	catcierge_output_free_generated_paths(ctx);
 
+	if ((e >= 0) && !(ctx->event_mask & CATCIERGE_EVENT_BIT(e)))
+	{
+		return 0;
+	}
+
+	// All templates for the event are rendered in the same
+	// scope, so they share the same time and remembered paths.
+	catcierge_output_render_begin(ctx);
+
 	for (i = 0; i < ctx->template_count; i++)
 	{
 		ctx->template_idx = i;
 		t = &ctx->templates[i];
 
 		// Filter out any events that don't have the current "event" in their list.
-		if (!catcierge_output_template_registered_to_event(t, event))
+		if ((e >= 0) ? !(t->event_mask & CATCIERGE_EVENT_BIT(e))
+					: !catcierge_output_template_registered_to_event(t, event))
 		{
 			//CATLOG("  Skip template %s because event %s not registered for it\n", t->name, event);
 			continue;
@@ -2246,17 +2957,26 @@ int catcierge_output_generate_templates(catcierge_output_t *ctx,
 		// want to be able to pass the path to an external program).
 		if (args->template_output_path)
 		{
-			// Generate the output path.
-			if (!(gen_output_path = catcierge_output_generate(&grb->output,
-					grb, args->template_output_path)))
+			// The output path only differs between templates
+			// if they have different root paths.
+			if (!gen_output_path || !catcierge_output_same_rootpath(rootpath, t->settings.rootpath))
 			{
-				CATERR("Failed to generate output path from: \"%s\"\n", args->template_output_path);
-				ret = -1; goto fail_template;
-			}
+				catcierge_xfree(&gen_output_path);
 
-			if (catcierge_make_path(gen_output_path))
-			{
-				CATERR("Failed to create directory %s\n", gen_output_path);
+				// Generate the output path.
+				if (!(gen_output_path = catcierge_output_generate(&grb->output,
+						grb, args->template_output_path)))
+				{
+					CATERR("Failed to generate output path from: \"%s\"\n", args->template_output_path);
+					ret = -1; goto fail_template;
+				}
+
+				if (catcierge_make_path(gen_output_path))
+				{
+					CATERR("Failed to create directory %s\n", gen_output_path);
+				}
+
+				rootpath = t->settings.rootpath;
 			}
 
 			// Generate the filename.
@@ -2283,18 +3003,70 @@ int catcierge_output_generate_templates(catcierge_output_t *ctx,
 		}
 
 		// And then generate the template contents.
-		if (!(output = catcierge_output_generate(ctx, grb, t->tmpl)))
+		if (t->settings.format != CATCIERGE_FORMAT_TEXT)
+		{
+			// Templates with the same format share the serialized event.
+			if ((serialized != t->settings.format)
+				&& catcierge_output_serialize_event(ctx, grb, event, t->settings.format))
+			{
+				ret = -1; goto fail_template;
+			}
+
+			serialized = t->settings.format;
+			data = ctx->serializer.buf;
+			data_len = ctx->serializer.len;
+		}
+		else
 		{
-			CATERR("Failed to generate output for template \"%s\"\n", t->settings.filename);
-			ret = -1; goto fail_template;
+			if (!(output = catcierge_output_render(ctx, grb, &t->compiled)))
+			{
+				CATERR("Failed to generate output for template \"%s\"\n", t->settings.filename);
+				ret = -1; goto fail_template;
+			}
+
+			data = output;
+			data_len = strlen(output);
 		}
 
 		#ifdef WITH_ZMQ
-		if (grb->args.zmq && grb->zmq_pub && !t->settings.nozmq)
+		if (grb->args.zmq && ctx->publisher && ctx->publisher->running
+			&& !t->settings.nozmq)
+		{
+			catcierge_publisher_msg_t *msg;
+			CATLOG("ZMQ Publish topic %s, %d bytes\n", t->settings.topic, (int)data_len);
+
+			// Hand over the rendered output when it is not needed
+			// for the file, otherwise ZMQ gets its own copy.
+			if ((data == output) && t->settings.nofile)
+			{
+				msg = catcierge_publisher_msg_create(t->settings.topic, output, NULL, data_len);
+				output = NULL;
+			}
+			else
+			{
+				msg = catcierge_publisher_msg_create(t->settings.topic, NULL, data, data_len);
+			}
+
+			if (msg && catcierge_publisher_push(ctx->publisher, msg))
+			{
+				CATERR("ZMQ publish queue full, dropped topic %s\n", t->settings.topic);
+			}
+		}
+		else if (grb->args.zmq && grb->zmq_pub && !t->settings.nozmq)
 		{
-			CATLOG("ZMQ Publish topic %s, %d bytes\n", t->settings.topic, strlen(output));
+			CATLOG("ZMQ Publish topic %s, %d bytes\n", t->settings.topic, (int)data_len);
 			zstr_sendfm(grb->zmq_pub, t->settings.topic);
-			zstr_send(grb->zmq_pub, output);
+
+			if (t->settings.format == CATCIERGE_FORMAT_TEXT)
+			{
+				zstr_send(grb->zmq_pub, output);
+			}
+			else
+			{
+				// MessagePack is binary so it can't be sent as a string.
+				zframe_t *frame = zframe_new(data, data_len);
+				zframe_send(&frame, grb->zmq_pub, 0);
+			}
 		}
 		#endif // WITH_ZMQ
 
@@ -2302,15 +3074,30 @@ int catcierge_output_generate_templates(catcierge_output_t *ctx,
 		{
 			CATLOG("Generate template: %s\n", full_path);
 
-			if (!(f = fopen(full_path, "w")))
+			if (ctx->staging && ctx->staging->running)
+			{
+				// Hand over the rendered output instead of copying it.
+				if (data == output)
+				{
+					if (catcierge_staging_add(ctx->staging, full_path, output, data_len))
+						ret = -1;
+					output = NULL;
+				}
+				else
+				{
+					if (catcierge_staging_write(ctx->staging, full_path, data, data_len))
+						ret = -1;
+				}
+			}
+			else if (!(f = fopen(full_path,
+				(t->settings.format == CATCIERGE_FORMAT_TEXT) ? "w" : "wb")))
 			{
 				CATERR("Failed to open template output file \"%s\" for writing\n", full_path);
 				ret = -1; goto fail_template;
 			}
 			else
 			{
-				size_t len = strlen(output);
-				size_t written = fwrite(output, sizeof(char), len, f);
+				size_t written = fwrite(data, sizeof(char), data_len, f);
 				fclose(f);
 			}
 		}
@@ -2327,19 +3114,36 @@ fail_template:
 			free(path);
 			path = NULL;
 		}
-
-		if (gen_output_path)
-		{
-			free(gen_output_path);
-			gen_output_path = NULL;
-		}
 	}
 
+	catcierge_xfree(&gen_output_path);
+	catcierge_output_render_end(ctx);
 	ctx->template_idx = -1;
 
 	return ret;
 }
 
+int catcierge_output_generate_templates(catcierge_output_t *ctx,
+	catcierge_grb_t *grb, const char *event)
+{
+	assert(event);
+	return catcierge_output_generate_templates_ex(ctx, grb, event,
+		catcierge_output_event_from_name(event));
+}
+
+int catcierge_output_generate_event_templates(catcierge_output_t *ctx,
+	catcierge_grb_t *grb, catcierge_event_t e)
+{
+	return catcierge_output_generate_templates_ex(ctx, grb,
+		catcierge_output_event_name(e), e);
+}
+
+int catcierge_output_has_event(catcierge_output_t *ctx, catcierge_event_t e)
+{
+	assert(ctx);
+	return !!(ctx->event_mask & CATCIERGE_EVENT_BIT(e));
+}
+
 int catcierge_output_load_template(catcierge_output_t *ctx, char *path)
 {
 	int ret = 0;
@@ -2436,24 +3240,31 @@ int catcierge_output_load_templates(catcierge_output_t *ctx,
 }
 
 void catcierge_output_execute_list(catcierge_grb_t *grb,
-		const char *event, char **commands, size_t command_count)
+		catcierge_event_t e, char **commands, size_t command_count)
 {
 	size_t i;
+	const char *event = catcierge_output_event_name(e);
+
+	// Templates and commands for the event see the same time.
+	catcierge_output_render_begin(&grb->output);
 
-	if (catcierge_output_generate_templates(&grb->output, grb, event))
+	if (catcierge_output_generate_event_templates(&grb->output, grb, e))
 	{
 		CATERR("Failed to generate templates on execute!\n");
-		return;
+		goto done;
 	}
 
 	for (i = 0; i < command_count; i++)
 	{
-		catcierge_output_execute(grb, event, commands[i]);
+		catcierge_output_execute(grb, event, commands[i], 0);
 	}
+
+done:
+	catcierge_output_render_end(&grb->output);
 }
 
 void catcierge_output_execute(catcierge_grb_t *grb,
-		const char *event, const char *command)
+		const char *event, const char *command, int flags)
 {
 	char *generated_cmd = NULL;
 
@@ -2468,7 +3279,16 @@ void catcierge_output_execute(catcierge_grb_t *grb,
 		return;
 	}
 
-	catcierge_run(generated_cmd);
+	if (!grb->executor.max_running
+		&& catcierge_executor_init(&grb->executor,
+			grb->args.max_running_cmds, grb->args.max_queued_cmds))
+	{
+		CATERR("Failed to init command executor\n");
+		free(generated_cmd);
+		return;
+	}
+
+	catcierge_executor_run(&grb->executor, event, generated_cmd, flags);
 
 	free(generated_cmd);
 }
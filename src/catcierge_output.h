@@ -31,15 +31,53 @@ void catcierge_output_print_usage();
 int catcierge_output_init(catcierge_grb_t *grb, catcierge_output_t *ctx);
 void catcierge_output_destroy(catcierge_output_t *ctx);
 
+// Creates a separate context with the same user variables as src and
+// the given templates loaded, so it can be used from another thread.
+int catcierge_output_init_copy(catcierge_output_t *ctx, catcierge_output_t *src,
+		char **inputs, size_t input_count);
+
 int catcierge_output_add_template(catcierge_output_t *ctx,
 		const char *template_str, const char *filename);
 
 char *catcierge_output_generate(catcierge_output_t *ctx, catcierge_grb_t *grb,
 		const char *template_str);
 
+// Parses a template into a list of nodes that can be rendered
+// over and over without parsing the template text again.
+int catcierge_output_compile(catcierge_output_compiled_t *c, const char *template_str);
+void catcierge_output_free_compiled(catcierge_output_compiled_t *c);
+
+// Renders done between begin and end share the same time, scratch
+// memory and remembered values of expensive variables (paths, cwd).
+void catcierge_output_render_begin(catcierge_output_t *ctx);
+void catcierge_output_render_end(catcierge_output_t *ctx);
+char *catcierge_output_render(catcierge_output_t *ctx, catcierge_grb_t *grb,
+		catcierge_output_compiled_t *c);
+
+// Writes the match group, matches, steps, settings and RFID state
+// straight into ctx->serializer without going through a template.
+int catcierge_output_serialize_event(catcierge_output_t *ctx, catcierge_grb_t *grb,
+		const char *event, catcierge_serialize_format_t format);
+
 int catcierge_output_generate_templates(catcierge_output_t *ctx,
 		catcierge_grb_t *grb, const char *event);
 
+// Same as above but uses the event subscription mask
+// instead of comparing the event filters of each template.
+int catcierge_output_generate_event_templates(catcierge_output_t *ctx,
+		catcierge_grb_t *grb, catcierge_event_t e);
+
+int catcierge_output_template_registered_to_event(catcierge_output_template_t *t,
+		const char *event);
+
+// Is any template registered to the event?
+int catcierge_output_has_event(catcierge_output_t *ctx, catcierge_event_t e);
+
+const char *catcierge_output_event_name(catcierge_event_t e);
+
+// Returns -1 if the name isn't a known event.
+int catcierge_output_event_from_name(const char *name);
+
 int catcierge_output_load_template(catcierge_output_t *ctx, char *path);
 
 int catcierge_output_load_templates(catcierge_output_t *ctx,
@@ -49,10 +87,10 @@ const char *catcierge_output_translate(catcierge_grb_t *grb,
 	char *buf, size_t bufsize, const char *var);
 
 void catcierge_output_execute_list(catcierge_grb_t *grb,
-		const char *event, char **commands, size_t command_count);
+		catcierge_event_t e, char **commands, size_t command_count);
 
 void catcierge_output_execute(catcierge_grb_t *grb,
-		const char *event, const char *command);
+		const char *event, const char *command, int flags);
 
 catcierge_output_invar_t *catcierge_output_add_user_variable(catcierge_output_t *ctx,
 		const char *name, const char *value);
@@ -21,10 +21,15 @@
 
 #include <stdio.h>
 #include "catcierge_types.h"
+#include "catcierge_arena.h"
+#include "catcierge_serialize.h"
+#include "catcierge_staging.h"
+#include "catcierge_publisher.h"
 #include "uthash.h"
 
 #define CATCIERGE_OUTPUT_MAX_RECURSION 20
 #define CATCIERGE_OUTPUT_MAX_VAR_LENGTH 32
+#define CATCIERGE_OUTPUT_MAX_MEMO 32
 
 typedef struct catcierge_output_settings_s
 {
@@ -36,20 +41,73 @@ typedef struct catcierge_output_settings_s
 	char *rootpath; // Path all templates are relative to. Default is cwd.
 	char **required_vars;
 	size_t required_var_count;
+	catcierge_serialize_format_t format; // Built in serializer used instead of the template body.
 	#ifdef WITH_ZMQ
 	char *topic; // ZMQ topic name, defaults to template name.
 	int nozmq;
 	#endif
 } catcierge_output_settings_t;
 
+// A variable name resolved when the template is compiled.
+typedef struct catcierge_output_var_ref_s
+{
+	int id;					// Which variable (catcierge_output_var_id_t).
+	int cur;				// matchcur_ instead of match#_
+	int idx;				// 0-based index for match#_ variables.
+	int step;				// 0-based index for match#_step#_ variables.
+} catcierge_output_var_ref_t;
+
+typedef enum catcierge_output_node_type_e
+{
+	CATCIERGE_OUTPUT_NODE_TEXT,
+	CATCIERGE_OUTPUT_NODE_VAR,
+	CATCIERGE_OUTPUT_NODE_FOR,
+	CATCIERGE_OUTPUT_NODE_IF
+} catcierge_output_node_type_t;
+
+typedef struct catcierge_output_node_s
+{
+	catcierge_output_node_type_t type;
+	char *str;				// Text, variable name or for/if expression.
+	size_t len;
+	int inner;				// Has $inner$ variables that are expanded when rendering.
+	catcierge_output_var_ref_t ref;
+	size_t body_count;		// Number of nodes in a for/if body, they follow right after.
+	size_t linenum;
+} catcierge_output_node_t;
+
+//
+// A template parsed into a flat list of nodes, so that
+// rendering it doesn't have to parse the text again.
+//
+typedef struct catcierge_output_compiled_s
+{
+	catcierge_output_node_t *nodes;
+	size_t count;
+	size_t max_count;
+	size_t text_len;		// Length of all text nodes.
+	size_t size_hint;		// Size of the last rendered output.
+	catcierge_arena_t arena; // Owns the nodes and their strings.
+} catcierge_output_compiled_t;
+
 typedef struct catcierge_output_template_s
 {
 	char *tmpl;
+	catcierge_output_compiled_t compiled;
 	char *generated_path;	// The last generated path.
 	char *name;
+	unsigned int event_mask; // CATCIERGE_EVENT_BIT of the events in the event filter.
 	catcierge_output_settings_t settings;
 } catcierge_output_template_t;
 
+// Value of an expensive variable, kept for the rest of the render.
+typedef struct catcierge_output_memo_s
+{
+	const char *var;
+	int template_idx;		// Paths can be relative to the template rootpath.
+	const char *value;
+} catcierge_output_memo_t;
+
 typedef struct catcierge_output_invar_s
 {
 	char name[CATCIERGE_OUTPUT_MAX_VAR_LENGTH];
@@ -70,6 +128,17 @@ typedef struct catcierge_output_s
 						  // running catcierge_output_generate when generating
 						  // relative paths :)
 	catcierge_output_invar_t *vars; // Hash table.
+	unsigned int event_mask; // Events that at least one template is registered to.
+	catcierge_arena_t arena; // Scratch memory while rendering, freed after each render.
+	int render_depth;
+	size_t render_alloc_count; // Memory allocations made by the current render.
+	size_t last_render_alloc_count;
+	struct timeval render_tv; // Time used for %time% during the render.
+	catcierge_output_memo_t memo[CATCIERGE_OUTPUT_MAX_MEMO];
+	size_t memo_count;
+	catcierge_serializer_t serializer; // Reused by templates with a format setting.
+	catcierge_staging_t *staging; // Template files are staged here instead, if running.
+	catcierge_publisher_t *publisher; // Publishes over ZMQ on its own thread, if running.
 } catcierge_output_t;
 
 #endif // __CATCIERGE_OUTPUT_TYPES_H__
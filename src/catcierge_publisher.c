@@ -0,0 +1,456 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <catcierge_config.h>
+#include "catcierge_publisher.h"
+#include "catcierge_util.h"
+#include "catcierge_log.h"
+
+#ifdef WITH_ZMQ
+#include <czmq.h>
+#endif
+
+int catcierge_zmq_images_parse(const char *str, catcierge_zmq_images_t *images)
+{
+	assert(str);
+	assert(images);
+
+	if (!strcmp(str, "none"))
+		*images = CATCIERGE_ZMQ_IMAGES_NONE;
+	else if (!strcmp(str, "raw"))
+		*images = CATCIERGE_ZMQ_IMAGES_RAW;
+	else if (!strcmp(str, "png"))
+		*images = CATCIERGE_ZMQ_IMAGES_PNG;
+	else if (!strcmp(str, "qoi"))
+		*images = CATCIERGE_ZMQ_IMAGES_QOI;
+	else if (!strcmp(str, "pgm"))
+		*images = CATCIERGE_ZMQ_IMAGES_PGM;
+	else
+		return -1;
+
+	return 0;
+}
+
+const char *catcierge_zmq_images_str(catcierge_zmq_images_t images)
+{
+	switch (images)
+	{
+		case CATCIERGE_ZMQ_IMAGES_NONE: return "none";
+		case CATCIERGE_ZMQ_IMAGES_RAW: return "raw";
+		case CATCIERGE_ZMQ_IMAGES_PNG: return "png";
+		case CATCIERGE_ZMQ_IMAGES_QOI: return "qoi";
+		case CATCIERGE_ZMQ_IMAGES_PGM: return "pgm";
+		default: break;
+	}
+
+	return "unknown";
+}
+
+catcierge_publisher_msg_t *catcierge_publisher_msg_create(const char *topic,
+		char *data, const void *copy_data, size_t len)
+{
+	catcierge_publisher_msg_t *msg = NULL;
+	assert(topic);
+	assert(data || copy_data || (len == 0));
+
+	if (!(msg = calloc(1, sizeof(catcierge_publisher_msg_t))))
+	{
+		goto fail;
+	}
+
+	snprintf(msg->topic, sizeof(msg->topic), "%s", topic);
+	msg->len = len;
+
+	if (data)
+	{
+		msg->data = data;
+		data = NULL;
+	}
+	else
+	{
+		if (!(msg->data = malloc(len + 1)))
+		{
+			goto fail;
+		}
+
+		if (len)
+		{
+			memcpy(msg->data, copy_data, len);
+		}
+
+		msg->data[len] = '\0';
+	}
+
+	return msg;
+
+fail:
+	CATERR("Out of memory\n");
+	catcierge_xfree(&data);
+	catcierge_xfree(&msg);
+	return NULL;
+}
+
+int catcierge_publisher_msg_add_image(catcierge_publisher_msg_t *msg, IplImage *img)
+{
+	assert(msg);
+
+	if (!img)
+	{
+		return -1;
+	}
+
+	if (msg->image_count >= MATCH_MAX_COUNT)
+	{
+		cvReleaseImage(&img);
+		return -1;
+	}
+
+	msg->images[msg->image_count++] = img;
+
+	return 0;
+}
+
+void catcierge_publisher_msg_free(catcierge_publisher_msg_t *msg)
+{
+	size_t i;
+
+	if (!msg)
+	{
+		return;
+	}
+
+	for (i = 0; i < msg->image_count; i++)
+	{
+		if (msg->images[i])
+		{
+			cvReleaseImage(&msg->images[i]);
+		}
+	}
+
+	catcierge_xfree(&msg->data);
+	free(msg);
+}
+
+#ifdef WITH_ZMQ
+
+// Called by ZMQ once it is done with a frame, possibly from its own I/O threads.
+static void catcierge_publisher_free_data(void *data, void *hint)
+{
+	free(data);
+}
+
+static void catcierge_publisher_free_image(void *data, void *hint)
+{
+	IplImage *img = (IplImage *)hint;
+	cvReleaseImage(&img);
+}
+
+// The frame is always freed, also when it fails.
+static int catcierge_publisher_send_frame(void *socket, void *data, size_t len,
+		zmq_free_fn *free_fn, void *hint, int more)
+{
+	zmq_msg_t frame;
+
+	if (zmq_msg_init_data(&frame, data, len, free_fn, hint))
+	{
+		free_fn(data, hint);
+		return -1;
+	}
+
+	if (zmq_msg_send(&frame, socket, more ? ZMQ_SNDMORE : 0) < 0)
+	{
+		zmq_msg_close(&frame);
+		return -1;
+	}
+
+	return 0;
+}
+
+static catcierge_image_format_t catcierge_publisher_image_format(catcierge_zmq_images_t images)
+{
+	switch (images)
+	{
+		case CATCIERGE_ZMQ_IMAGES_QOI: return CATCIERGE_IMAGE_QOI;
+		case CATCIERGE_ZMQ_IMAGES_PGM: return CATCIERGE_IMAGE_PGM;
+		default: break;
+	}
+
+	return CATCIERGE_IMAGE_PNG;
+}
+
+#endif // WITH_ZMQ
+
+int catcierge_publisher_send(void *socket, catcierge_publisher_msg_t *msg,
+		catcierge_zmq_images_t images)
+{
+	#ifdef WITH_ZMQ
+	unsigned char *encoded[MATCH_MAX_COUNT];
+	size_t encoded_len[MATCH_MAX_COUNT];
+	char desc[64 + MATCH_MAX_COUNT * 64];
+	size_t desc_len;
+	size_t count = 0;
+	size_t i;
+	IplImage *img;
+	int ret = 0;
+	assert(socket);
+	assert(msg);
+
+	// Encode everything before sending, so a failed image does
+	// not leave a message half sent. Failed images are left out.
+	for (i = 0; i < msg->image_count; i++)
+	{
+		img = msg->images[i];
+		msg->images[i] = NULL;
+
+		if (images == CATCIERGE_ZMQ_IMAGES_NONE)
+		{
+			cvReleaseImage(&img);
+			continue;
+		}
+
+		if (images != CATCIERGE_ZMQ_IMAGES_RAW)
+		{
+			if (!(encoded[count] = catcierge_image_encode(img,
+				catcierge_publisher_image_format(images),
+				DEFAULT_PNG_COMPRESSION, &encoded_len[count])))
+			{
+				CATERR("Failed to encode image for publishing\n");
+				cvReleaseImage(&img);
+				continue;
+			}
+		}
+
+		msg->images[count++] = img;
+	}
+
+	msg->image_count = count;
+
+	// Topic and data.
+	ret |= (zmq_send(socket, msg->topic, strlen(msg->topic), ZMQ_SNDMORE) < 0);
+	ret |= catcierge_publisher_send_frame(socket, msg->data, msg->len,
+			catcierge_publisher_free_data, NULL, (msg->image_count > 0));
+	msg->data = NULL;
+
+	if (msg->image_count > 0)
+	{
+		// Describes the image frames that follow, one line per image:
+		// "width height channels stride" where stride is the row
+		// size in bytes of raw images.
+		desc_len = snprintf(desc, sizeof(desc), "%s\n", catcierge_zmq_images_str(images));
+
+		for (i = 0; i < msg->image_count; i++)
+		{
+			img = msg->images[i];
+			desc_len += snprintf(desc + desc_len, sizeof(desc) - desc_len,
+				"%d %d %d %d\n", img->width, img->height, img->nChannels,
+				(images == CATCIERGE_ZMQ_IMAGES_RAW) ? img->widthStep : 0);
+		}
+
+		ret |= (zmq_send(socket, desc, desc_len, ZMQ_SNDMORE) < 0);
+
+		for (i = 0; i < msg->image_count; i++)
+		{
+			img = msg->images[i];
+			msg->images[i] = NULL;
+
+			if (images == CATCIERGE_ZMQ_IMAGES_RAW)
+			{
+				ret |= catcierge_publisher_send_frame(socket,
+					img->imageData, img->imageSize,
+					catcierge_publisher_free_image, img,
+					(i + 1 < msg->image_count));
+			}
+			else
+			{
+				cvReleaseImage(&img);
+				ret |= catcierge_publisher_send_frame(socket,
+					encoded[i], encoded_len[i],
+					catcierge_publisher_free_data, NULL,
+					(i + 1 < msg->image_count));
+			}
+		}
+
+		msg->image_count = 0;
+	}
+
+	catcierge_publisher_msg_free(msg);
+
+	return ret ? -1 : 0;
+	#else
+	catcierge_publisher_msg_free(msg);
+	return -1;
+	#endif
+}
+
+#if defined(WITH_ZMQ) && defined(CATCIERGE_HAVE_PTHREAD_H)
+
+static void *catcierge_publisher_worker(void *arg)
+{
+	catcierge_publisher_t *p = (catcierge_publisher_t *)arg;
+	catcierge_publisher_msg_t *msg;
+	int ok;
+
+	pthread_mutex_lock(&p->lock);
+
+	while (1)
+	{
+		while (!p->head && p->running)
+		{
+			pthread_cond_wait(&p->not_empty, &p->lock);
+		}
+
+		// Send everything queued before stopping.
+		if (!p->head)
+		{
+			break;
+		}
+
+		msg = p->head;
+		p->head = msg->next;
+		msg->next = NULL;
+		p->count--;
+
+		if (!p->head)
+		{
+			p->tail = NULL;
+		}
+
+		pthread_mutex_unlock(&p->lock);
+
+		ok = !catcierge_publisher_send(p->socket, msg, p->images);
+
+		pthread_mutex_lock(&p->lock);
+
+		if (ok)
+			p->sent_count++;
+		else
+			p->failed_count++;
+	}
+
+	pthread_mutex_unlock(&p->lock);
+
+	return NULL;
+}
+
+#endif // WITH_ZMQ && CATCIERGE_HAVE_PTHREAD_H
+
+int catcierge_publisher_init(catcierge_publisher_t *p, void *socket,
+		size_t hwm, catcierge_zmq_images_t images)
+{
+	assert(p);
+	memset(p, 0, sizeof(catcierge_publisher_t));
+
+	#if defined(WITH_ZMQ) && defined(CATCIERGE_HAVE_PTHREAD_H)
+	if (!socket || (hwm == 0))
+	{
+		CATERR("Invalid ZMQ publisher settings\n");
+		return -1;
+	}
+
+	p->socket = socket;
+	p->hwm = hwm;
+	p->images = images;
+	p->running = 1;
+	pthread_mutex_init(&p->lock, NULL);
+	pthread_cond_init(&p->not_empty, NULL);
+
+	if (pthread_create(&p->thread, NULL, catcierge_publisher_worker, p))
+	{
+		CATERR("Failed to start ZMQ publisher thread\n");
+		p->running = 0;
+		pthread_mutex_destroy(&p->lock);
+		pthread_cond_destroy(&p->not_empty);
+		return -1;
+	}
+
+	return 0;
+
+	#else
+
+	CATERR("Publishing on a separate thread is not supported on this platform\n");
+	return -1;
+
+	#endif
+}
+
+void catcierge_publisher_destroy(catcierge_publisher_t *p)
+{
+	assert(p);
+
+	if (!p->running)
+	{
+		return;
+	}
+
+	#if defined(WITH_ZMQ) && defined(CATCIERGE_HAVE_PTHREAD_H)
+	pthread_mutex_lock(&p->lock);
+	p->running = 0;
+	pthread_cond_signal(&p->not_empty);
+	pthread_mutex_unlock(&p->lock);
+
+	pthread_join(p->thread, NULL);
+
+	pthread_mutex_destroy(&p->lock);
+	pthread_cond_destroy(&p->not_empty);
+
+	CATLOG("ZMQ publisher: %lu sent, %lu failed, %lu dropped\n",
+		p->sent_count, p->failed_count, p->dropped_count);
+	#endif
+}
+
+int catcierge_publisher_push(catcierge_publisher_t *p, catcierge_publisher_msg_t *msg)
+{
+	int ret = -1;
+	assert(p);
+	assert(msg);
+
+	#if defined(WITH_ZMQ) && defined(CATCIERGE_HAVE_PTHREAD_H)
+	if (p->running)
+	{
+		pthread_mutex_lock(&p->lock);
+
+		if (p->count < p->hwm)
+		{
+			if (p->tail)
+				p->tail->next = msg;
+			else
+				p->head = msg;
+
+			p->tail = msg;
+			p->count++;
+			pthread_cond_signal(&p->not_empty);
+			msg = NULL;
+			ret = 0;
+		}
+		else
+		{
+			p->dropped_count++;
+		}
+
+		pthread_mutex_unlock(&p->lock);
+	}
+	#endif
+
+	catcierge_publisher_msg_free(msg);
+
+	return ret;
+}
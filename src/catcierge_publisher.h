@@ -0,0 +1,117 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_PUBLISHER_H__
+#define __CATCIERGE_PUBLISHER_H__
+
+#include <stddef.h>
+#include <catcierge_config.h>
+#include "catcierge_types.h"
+#include "catcierge_image_format.h"
+
+#ifdef CATCIERGE_HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#define DEFAULT_ZMQ_HWM 32	// Messages.
+#define CATCIERGE_ZMQ_MAX_HWM 1024
+#define CATCIERGE_ZMQ_IMAGES_TOPIC "match_group_images"
+
+typedef enum catcierge_zmq_images_e
+{
+	CATCIERGE_ZMQ_IMAGES_NONE,
+	CATCIERGE_ZMQ_IMAGES_RAW,	// The pixels as they are in memory.
+	CATCIERGE_ZMQ_IMAGES_PNG,
+	CATCIERGE_ZMQ_IMAGES_QOI,
+	CATCIERGE_ZMQ_IMAGES_PGM
+} catcierge_zmq_images_t;
+
+// A multipart message: the topic, the data and optionally a frame
+// describing the images followed by one frame per image. The data
+// and the images are owned by the message and handed to ZMQ without
+// copying them, they are freed once ZMQ is done sending them.
+typedef struct catcierge_publisher_msg_s
+{
+	char topic[256];
+	char *data;
+	size_t len;
+	IplImage *images[MATCH_MAX_COUNT];
+	size_t image_count;
+	struct catcierge_publisher_msg_s *next;
+} catcierge_publisher_msg_t;
+
+//
+// Publishes the output templates and the match images over ZMQ from
+// a dedicated I/O thread, which is the only thread using the socket
+// once it has started. Messages are queued up to the high-water mark,
+// after that new messages are dropped. The socket itself is given the
+// same high-water mark before it is bound.
+//
+// Images are encoded (if not sent raw) on the I/O thread, so that
+// subscribers on the LAN get the images without sharing a filesystem
+// and without slowing down the matching.
+//
+typedef struct catcierge_publisher_s
+{
+	int running;
+	void *socket;
+	size_t hwm;
+	catcierge_zmq_images_t images;
+	catcierge_publisher_msg_t *head;
+	catcierge_publisher_msg_t *tail;
+	size_t count;
+
+	unsigned long sent_count;
+	unsigned long dropped_count;
+	unsigned long failed_count;
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	#endif
+} catcierge_publisher_t;
+
+// Starts the I/O thread, which takes over the (bound) socket.
+int catcierge_publisher_init(catcierge_publisher_t *p, void *socket,
+		size_t hwm, catcierge_zmq_images_t images);
+
+// Sends what is queued and stops the I/O thread. Does not close the socket.
+void catcierge_publisher_destroy(catcierge_publisher_t *p);
+
+// Takes ownership of data (malloced). If data is NULL a copy of
+// copy_data is made instead.
+catcierge_publisher_msg_t *catcierge_publisher_msg_create(const char *topic,
+		char *data, const void *copy_data, size_t len);
+
+// Takes ownership of the image.
+int catcierge_publisher_msg_add_image(catcierge_publisher_msg_t *msg, IplImage *img);
+
+void catcierge_publisher_msg_free(catcierge_publisher_msg_t *msg);
+
+// Queues the message, takes ownership of it. Returns -1 if it was dropped.
+int catcierge_publisher_push(catcierge_publisher_t *p, catcierge_publisher_msg_t *msg);
+
+// Sends a message on a socket right away, used by the I/O thread.
+int catcierge_publisher_send(void *socket, catcierge_publisher_msg_t *msg,
+		catcierge_zmq_images_t images);
+
+int catcierge_zmq_images_parse(const char *str, catcierge_zmq_images_t *images);
+const char *catcierge_zmq_images_str(catcierge_zmq_images_t images);
+
+#endif // __CATCIERGE_PUBLISHER_H__
@@ -0,0 +1,266 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "catcierge_config.h"
+#include "catcierge_journal.h"
+#include "catcierge_util.h"
+#include "cargo.h"
+
+//
+// Answers questions like "how many lockouts last month" from journals
+// written by catcierge_grabber --journal. Totals over a time range are
+// taken from the index blocks of the journal, so only the events at
+// the start and end of the range are read.
+//
+
+typedef struct query_ctx_s
+{
+	char **journal_paths;
+	size_t journal_count;
+	char *from_str;
+	char *to_str;
+	uint64_t from;
+	uint64_t to;
+	int list;
+	char *by;
+	const char *by_fmt;
+
+	// Current --by group.
+	char group[64];
+	catcierge_journal_stats_t group_stats;
+} query_ctx_t;
+
+static const char *get_time_str(uint64_t time_us, const char *fmt, char *buf, size_t bufsize)
+{
+	time_t t = (time_t)(time_us / 1000000);
+	struct tm *tm = localtime(&t);
+
+	if (!tm || !strftime(buf, bufsize, fmt, tm))
+	{
+		snprintf(buf, bufsize, "%llu", (unsigned long long)time_us);
+	}
+
+	return buf;
+}
+
+static void print_stats(const catcierge_journal_stats_t *s)
+{
+	char time_str[64];
+
+	printf("     Events: %lu\n", s->count);
+	printf("    Success: %lu\n", s->success_count);
+	printf("   Lockouts: %lu\n", s->count - s->success_count);
+	printf("         In: %lu\n", s->in_count);
+	printf("        Out: %lu\n", s->out_count);
+	printf("    Unknown: %lu\n", s->unknown_count);
+	printf("    Matches: %lu\n", s->match_count);
+
+	if (s->count == 0)
+		return;
+
+	printf("      First: %s\n", get_time_str(s->first_us, "%Y-%m-%d %H:%M:%S",
+			time_str, sizeof(time_str)));
+	printf("       Last: %s\n", get_time_str(s->last_us, "%Y-%m-%d %H:%M:%S",
+			time_str, sizeof(time_str)));
+}
+
+static void print_group(query_ctx_t *ctx)
+{
+	catcierge_journal_stats_t *s = &ctx->group_stats;
+
+	if (s->count == 0)
+		return;
+
+	printf("%-16s  %6lu events  %6lu success  %6lu lockouts  %6lu in  %6lu out\n",
+		ctx->group, s->count, s->success_count, s->count - s->success_count,
+		s->in_count, s->out_count);
+
+	memset(s, 0, sizeof(*s));
+}
+
+static int list_cb(const catcierge_journal_event_t *e, void *user)
+{
+	char time_str[64];
+	size_t i;
+
+	printf("%s.%06d  %08x%08x  %-7s  %-7s  %u ms ",
+		get_time_str(e->time_us, "%Y-%m-%d %H:%M:%S", time_str, sizeof(time_str)),
+		(int)(e->time_us % 1000000), e->id[0], e->id[1],
+		e->success ? "success" : "lockout",
+		catcierge_get_direction_str(e->direction), e->duration_ms);
+
+	for (i = 0; i < e->match_count; i++)
+	{
+		printf(" %c%.2f", e->matches[i].success ? '+' : '-', e->matches[i].result);
+	}
+
+	if (e->flags & (CATCIERGE_JOURNAL_RFID_IN | CATCIERGE_JOURNAL_RFID_OUT))
+	{
+		printf("  rfid %s", catcierge_get_direction_str(e->rfid_direction));
+	}
+
+	printf("\n");
+
+	return 0;
+}
+
+static int group_cb(const catcierge_journal_event_t *e, void *user)
+{
+	query_ctx_t *ctx = (query_ctx_t *)user;
+	char group[64];
+
+	get_time_str(e->time_us, ctx->by_fmt, group, sizeof(group));
+
+	if (strcmp(group, ctx->group))
+	{
+		print_group(ctx);
+		snprintf(ctx->group, sizeof(ctx->group), "%s", group);
+	}
+
+	catcierge_journal_stats_add(&ctx->group_stats, e);
+
+	return 0;
+}
+
+static int query_journal(query_ctx_t *ctx, const char *path)
+{
+	catcierge_journal_reader_t rd;
+	catcierge_journal_stats_t s;
+	clock_t start = clock();
+
+	if (catcierge_journal_reader_open(&rd, path))
+	{
+		return -1;
+	}
+
+	if (ctx->list)
+	{
+		catcierge_journal_reader_foreach(&rd, ctx->from, ctx->to, list_cb, ctx);
+	}
+	else if (ctx->by_fmt)
+	{
+		ctx->group[0] = '\0';
+		memset(&ctx->group_stats, 0, sizeof(ctx->group_stats));
+		catcierge_journal_reader_foreach(&rd, ctx->from, ctx->to, group_cb, ctx);
+		print_group(ctx);
+	}
+	else
+	{
+		catcierge_journal_reader_stats(&rd, ctx->from, ctx->to, &s);
+		print_stats(&s);
+		printf("       Time: %.3f ms\n",
+			(double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC);
+	}
+
+	catcierge_journal_reader_close(&rd);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int ret = 0;
+	size_t i;
+	cargo_t cargo;
+	query_ctx_t ctx;
+
+	memset(&ctx, 0, sizeof(ctx));
+
+	if (cargo_init(&cargo, 0, "%s", argv[0]))
+	{
+		fprintf(stderr, "Failed to init command line parsing\n");
+		return -1;
+	}
+
+	cargo_set_description(cargo,
+		"Counts and lists the match groups in journals "
+		"written by catcierge_grabber --journal.");
+
+	ret |= cargo_add_option(cargo, 0, "journals", "Journals to read.",
+			"[s]+", &ctx.journal_paths, &ctx.journal_count);
+	ret |= cargo_add_option(cargo, 0, "--from",
+			"Only match groups at or after this time. "
+			"\"YYYY-MM-DD\" or \"YYYY-MM-DD HH:MM:SS\" in local time.",
+			"s", &ctx.from_str);
+	ret |= cargo_add_option(cargo, 0, "--to",
+			"Only match groups before this time.",
+			"s", &ctx.to_str);
+	ret |= cargo_add_option(cargo, 0, "--list",
+			"List each match group instead of the totals.",
+			"b", &ctx.list);
+	ret |= cargo_add_option(cargo, 0, "--by",
+			"Totals per hour, day or month instead of for the whole range.",
+			"s", &ctx.by);
+
+	if (ret)
+	{
+		fprintf(stderr, "Failed to add command line options\n");
+		ret = -1; goto fail;
+	}
+
+	if (cargo_parse(cargo, 0, 1, argc, argv))
+	{
+		ret = -1; goto fail;
+	}
+
+	if ((ctx.from_str && catcierge_parse_time(ctx.from_str, &ctx.from))
+		|| (ctx.to_str && catcierge_parse_time(ctx.to_str, &ctx.to)))
+	{
+		fprintf(stderr, "Invalid time, expected \"YYYY-MM-DD\" or \"YYYY-MM-DD HH:MM:SS\"\n");
+		ret = -1; goto fail;
+	}
+
+	// The journal ranges include the end.
+	ctx.to = ctx.to_str ? (ctx.to - 1) : CATCIERGE_JOURNAL_TIME_MAX;
+
+	if (ctx.by)
+	{
+		if (!strcmp(ctx.by, "hour"))
+			ctx.by_fmt = "%Y-%m-%d %H:00";
+		else if (!strcmp(ctx.by, "day"))
+			ctx.by_fmt = "%Y-%m-%d";
+		else if (!strcmp(ctx.by, "month"))
+			ctx.by_fmt = "%Y-%m";
+		else
+		{
+			fprintf(stderr, "Invalid --by \"%s\", expected hour, day or month\n", ctx.by);
+			ret = -1; goto fail;
+		}
+	}
+
+	for (i = 0; i < ctx.journal_count; i++)
+	{
+		if (ctx.journal_count > 1)
+			printf("%s:\n", ctx.journal_paths[i]);
+
+		ret |= query_journal(&ctx, ctx.journal_paths[i]);
+	}
+
+fail:
+	catcierge_free_list(ctx.journal_paths, ctx.journal_count);
+	catcierge_xfree(&ctx.from_str);
+	catcierge_xfree(&ctx.to_str);
+	catcierge_xfree(&ctx.by);
+	cargo_destroy(&cargo);
+
+	return ret;
+}
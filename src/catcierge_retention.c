@@ -0,0 +1,910 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <catcierge_config.h>
+#include "catcierge_retention.h"
+#include "catcierge_image_format.h"
+#include "catcierge_util.h"
+#include "catcierge_log.h"
+
+#ifdef CATCIERGE_HAVE_RETENTION
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <utime.h>
+#ifdef CATCIERGE_HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef CATCIERGE_HAVE_SYS_STATVFS_H
+#include <sys/statvfs.h>
+#endif
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+#endif // CATCIERGE_HAVE_RETENTION
+
+#define SECONDS_PER_DAY (24 * 60 * 60)
+
+const char *catcierge_retention_class_str(catcierge_retention_class_t cls)
+{
+	switch (cls)
+	{
+		case CATCIERGE_RETAIN_MATCH: return "match";
+		case CATCIERGE_RETAIN_STEPS: return "steps";
+		case CATCIERGE_RETAIN_OBSTRUCT: return "obstruct";
+		case CATCIERGE_RETAIN_TEMPLATES: return "templates";
+		default: break;
+	}
+
+	return "unknown";
+}
+
+int catcierge_retention_parse_quota(const char *str,
+		catcierge_retention_class_t *cls, catcierge_retention_quota_t *quota)
+{
+	int i;
+	size_t len;
+	const char *it;
+	char *end = NULL;
+	long max_mb;
+	long max_days;
+	assert(str);
+	assert(cls);
+	assert(quota);
+
+	if (!(it = strchr(str, ':')))
+	{
+		return -1;
+	}
+
+	len = (size_t)(it - str);
+
+	for (i = 0; i < CATCIERGE_RETAIN_CLASS_COUNT; i++)
+	{
+		const char *name = catcierge_retention_class_str((catcierge_retention_class_t)i);
+
+		if ((strlen(name) == len) && !strncmp(str, name, len))
+		{
+			break;
+		}
+	}
+
+	if (i == CATCIERGE_RETAIN_CLASS_COUNT)
+	{
+		return -1;
+	}
+
+	max_mb = strtol(it + 1, &end, 10);
+
+	if ((end == it + 1) || (*end != ':') || (max_mb < 0))
+	{
+		return -1;
+	}
+
+	it = end + 1;
+	max_days = strtol(it, &end, 10);
+
+	if ((end == it) || (*end != '\0') || (max_days < 0))
+	{
+		return -1;
+	}
+
+	*cls = (catcierge_retention_class_t)i;
+	quota->max_size = (unsigned long long)max_mb * 1024 * 1024;
+	quota->max_age = (int)max_days;
+
+	return 0;
+}
+
+char *catcierge_retention_root(const char *path, const char *fallback)
+{
+	const char *var;
+	size_t len;
+	assert(path);
+
+	if (!(var = strchr(path, '%')))
+	{
+		return strdup(path);
+	}
+
+	// Cut at the last full directory name before the variable.
+	len = (size_t)(var - path);
+
+	while ((len > 0) && (path[len - 1] != '/') && (path[len - 1] != '\\'))
+	{
+		len--;
+	}
+
+	while ((len > 1) && ((path[len - 1] == '/') || (path[len - 1] == '\\')))
+	{
+		len--;
+	}
+
+	if (len == 0)
+	{
+		return fallback ? catcierge_retention_root(fallback, NULL) : strdup(".");
+	}
+
+	return catcierge_strndup(path, len);
+}
+
+char *catcierge_retention_pattern(const char *filename)
+{
+	const char *it;
+	const char *base = filename;
+	char *pattern;
+	char *out;
+	int literal = 0;
+	assert(filename);
+
+	// Templates can create sub directories, only the name is matched.
+	for (it = filename; *it; it++)
+	{
+		if ((*it == '/') || (*it == '\\'))
+			base = it + 1;
+	}
+
+	if (!(pattern = malloc(strlen(base) + 1)))
+	{
+		return NULL;
+	}
+
+	out = pattern;
+	it = base;
+
+	while (*it)
+	{
+		const char *end;
+
+		if ((*it == '%') && (end = strchr(it + 1, '%')))
+		{
+			if ((out == pattern) || (out[-1] != '*'))
+				*out++ = '*';
+			it = end + 1;
+			continue;
+		}
+
+		// The whitespace is replaced when the file is generated.
+		*out++ = ((*it == ' ') || (*it == ':')) ? '?' : *it;
+
+		if ((*it != '.') && (*it != '*'))
+			literal = 1;
+
+		it++;
+	}
+
+	*out = '\0';
+
+	// A pattern like "*.*" would match any file in the directory.
+	if (!literal)
+	{
+		free(pattern);
+		return NULL;
+	}
+
+	return pattern;
+}
+
+static int catcierge_retention_is_image_ext(const char *ext)
+{
+	return !strcmp(ext, "png") || !strcmp(ext, "qoi")
+		|| !strcmp(ext, "pgm") || !strcmp(ext, "ppm");
+}
+
+int catcierge_retention_classify(const catcierge_retention_settings_t *settings,
+		const char *filename)
+{
+	const char *ext;
+	const char *it;
+	const char *num;
+	size_t i;
+	assert(settings);
+	assert(filename);
+
+	// Match images are named match_[fail]_<time>__<n>.<ext>, the
+	// steps add _<step>_<name> and obstruct images are named
+	// match_obstruct_<time>.<ext>. See catcierge_process_match_result.
+	if (!strncmp(filename, "match_", 6)
+		&& (ext = strrchr(filename, '.'))
+		&& catcierge_retention_is_image_ext(ext + 1))
+	{
+		if (!strncmp(filename, "match_obstruct_", 15))
+		{
+			return CATCIERGE_RETAIN_OBSTRUCT;
+		}
+
+		// The last "__" is the one before the match number.
+		for (it = filename, num = NULL; (it = strstr(it, "__")); it++)
+		{
+			num = it + 2;
+		}
+
+		if (num && (*num >= '0') && (*num <= '9'))
+		{
+			for (it = num; (*it >= '0') && (*it <= '9'); it++);
+
+			if (*it == '.')
+				return CATCIERGE_RETAIN_MATCH;
+			else if (*it == '_')
+				return CATCIERGE_RETAIN_STEPS;
+		}
+	}
+
+	#ifdef CATCIERGE_HAVE_RETENTION
+	for (i = 0; i < settings->template_pattern_count; i++)
+	{
+		if (!fnmatch(settings->template_patterns[i], filename, 0))
+		{
+			return CATCIERGE_RETAIN_TEMPLATES;
+		}
+	}
+	#endif
+
+	return -1;
+}
+
+void catcierge_retention_settings_free(catcierge_retention_settings_t *settings)
+{
+	size_t i;
+	assert(settings);
+
+	for (i = 0; i < CATCIERGE_RETAIN_CLASS_COUNT; i++)
+	{
+		catcierge_xfree(&settings->roots[i]);
+	}
+
+	for (i = 0; i < settings->template_pattern_count; i++)
+	{
+		catcierge_xfree(&settings->template_patterns[i]);
+	}
+
+	settings->template_pattern_count = 0;
+}
+
+#ifdef CATCIERGE_HAVE_RETENTION
+
+static int catcierge_retention_stopping(catcierge_retention_t *r)
+{
+	int running;
+	pthread_mutex_lock(&r->lock);
+	running = r->running;
+	pthread_mutex_unlock(&r->lock);
+	return !running;
+}
+
+static int catcierge_retention_is_idle(catcierge_retention_t *r)
+{
+	time_t last;
+	pthread_mutex_lock(&r->lock);
+	last = r->last_activity;
+	pthread_mutex_unlock(&r->lock);
+	return (time(NULL) - last) >= r->settings.idle_time;
+}
+
+static int catcierge_retention_add_file(catcierge_retention_t *r,
+		const char *path, struct stat *st, catcierge_retention_class_t cls)
+{
+	catcierge_retention_file_t *files;
+	catcierge_retention_file_t *f;
+
+	if (r->file_count == r->file_max_count)
+	{
+		size_t new_count = r->file_max_count ? (r->file_max_count * 2) : 256;
+
+		if (!(files = realloc(r->files, new_count * sizeof(catcierge_retention_file_t))))
+		{
+			CATERR("Out of memory\n");
+			return -1;
+		}
+
+		r->files = files;
+		r->file_max_count = new_count;
+	}
+
+	f = &r->files[r->file_count];
+
+	if (!(f->path = strdup(path)))
+	{
+		CATERR("Out of memory\n");
+		return -1;
+	}
+
+	f->size = (unsigned long long)st->st_size;
+	f->mtime = st->st_mtime;
+	f->cls = cls;
+	r->file_count++;
+
+	return 0;
+}
+
+static int catcierge_retention_under(const char *path, const char *root)
+{
+	size_t len = strlen(root);
+
+	return !strncmp(path, root, len)
+		&& ((path[len] == '/') || (path[len] == '\\') || (path[len] == '\0'));
+}
+
+static void catcierge_retention_scan(catcierge_retention_t *r,
+		const char *dir, int depth)
+{
+	DIR *d;
+	struct dirent *ent;
+	struct stat st;
+	char path[4096];
+	int cls;
+
+	if ((depth > CATCIERGE_RETENTION_MAX_DEPTH) || !(d = opendir(dir)))
+	{
+		return;
+	}
+
+	while ((ent = readdir(d)) && !catcierge_retention_stopping(r))
+	{
+		if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, ".."))
+		{
+			continue;
+		}
+
+		snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+
+		// Never follow symlinks out of the output directories.
+		if (lstat(path, &st))
+		{
+			continue;
+		}
+
+		if (S_ISDIR(st.st_mode))
+		{
+			catcierge_retention_scan(r, path, depth + 1);
+		}
+		else if (S_ISREG(st.st_mode)
+			&& ((cls = catcierge_retention_classify(&r->settings, ent->d_name)) >= 0)
+			&& r->settings.roots[cls]
+			&& catcierge_retention_under(path, r->settings.roots[cls]))
+		{
+			catcierge_retention_add_file(r, path, &st, (catcierge_retention_class_t)cls);
+		}
+	}
+
+	closedir(d);
+}
+
+static int catcierge_retention_compare(const void *a, const void *b)
+{
+	const catcierge_retention_file_t *fa = (const catcierge_retention_file_t *)a;
+	const catcierge_retention_file_t *fb = (const catcierge_retention_file_t *)b;
+
+	if (fa->cls != fb->cls)
+		return (fa->cls < fb->cls) ? -1 : 1;
+
+	if (fa->mtime != fb->mtime)
+		return (fa->mtime < fb->mtime) ? -1 : 1;
+
+	return strcmp(fa->path, fb->path);
+}
+
+static void catcierge_retention_remove(catcierge_retention_t *r,
+		catcierge_retention_usage_t *usage, catcierge_retention_file_t *f, const char *root)
+{
+	char *sep;
+
+	if (remove(f->path))
+	{
+		CATERR("Failed to remove %s\n", f->path);
+		return;
+	}
+
+	usage[f->cls].deleted_count++;
+	usage[f->cls].deleted_bytes += f->size;
+
+	// Remove the directory as well if that was the last file in it.
+	if ((sep = strrchr(f->path, '/')))
+	{
+		*sep = '\0';
+
+		if (strcmp(f->path, root) && catcierge_retention_under(f->path, root))
+		{
+			rmdir(f->path);
+		}
+	}
+
+	catcierge_xfree(&f->path);
+}
+
+// Deletes the oldest files of each class until it is within its quota.
+static void catcierge_retention_enforce(catcierge_retention_t *r,
+		catcierge_retention_usage_t *usage, time_t now)
+{
+	size_t i;
+	size_t start;
+	unsigned long long total;
+	catcierge_retention_file_t *f;
+	catcierge_retention_quota_t *q;
+	catcierge_retention_class_t cls;
+
+	for (start = 0; start < r->file_count; start = i)
+	{
+		cls = r->files[start].cls;
+		q = &r->settings.quotas[cls];
+		total = 0;
+
+		for (i = start; (i < r->file_count) && (r->files[i].cls == cls); i++)
+		{
+			total += r->files[i].size;
+		}
+
+		// Sorted oldest first.
+		for (i = start; (i < r->file_count) && (r->files[i].cls == cls); i++)
+		{
+			f = &r->files[i];
+
+			if (!(q->max_size && (total > q->max_size))
+				&& !(q->max_age && ((now - f->mtime) > ((time_t)q->max_age * SECONDS_PER_DAY))))
+			{
+				break;
+			}
+
+			total -= f->size;
+			catcierge_retention_remove(r, usage, f, r->settings.roots[cls]);
+		}
+
+		for (; (i < r->file_count) && (r->files[i].cls == cls); i++);
+
+		usage[cls].bytes = total;
+	}
+}
+
+static int catcierge_retention_recompress(catcierge_retention_t *r,
+		catcierge_retention_usage_t *usage, catcierge_retention_file_t *f)
+{
+	IplImage *img = NULL;
+	char *png_path = NULL;
+	char *ext;
+	struct stat st;
+	struct utimbuf times;
+	int ret = -1;
+
+	if (!(png_path = malloc(strlen(f->path) + 5)))
+	{
+		return -1;
+	}
+
+	strcpy(png_path, f->path);
+	ext = strrchr(png_path, '.');
+	strcpy(ext, ".png");
+
+	if (!lstat(png_path, &st) || !(img = catcierge_image_load(f->path)))
+	{
+		goto fail;
+	}
+
+	// Spend the time on the best compression, nothing else is going on.
+	if (catcierge_image_save(png_path, img, CATCIERGE_IMAGE_PNG, 9)
+		|| stat(png_path, &st))
+	{
+		remove(png_path);
+		goto fail;
+	}
+
+	if ((unsigned long long)st.st_size >= f->size)
+	{
+		remove(png_path);
+		goto fail;
+	}
+
+	// Keep the time of the original so the age quotas still apply.
+	times.actime = f->mtime;
+	times.modtime = f->mtime;
+	utime(png_path, &times);
+
+	if (remove(f->path))
+	{
+		remove(png_path);
+		goto fail;
+	}
+
+	usage[f->cls].recompressed_count++;
+	usage[f->cls].recompressed_saved += f->size - (unsigned long long)st.st_size;
+	usage[f->cls].bytes -= f->size - (unsigned long long)st.st_size;
+	free(f->path);
+	f->path = png_path;
+	png_path = NULL;
+	f->size = (unsigned long long)st.st_size;
+	ret = 0;
+
+fail:
+	if (img)
+	{
+		cvReleaseImage(&img);
+	}
+
+	free(png_path);
+	return ret;
+}
+
+// Recompresses old images in a fast format, oldest first, for as long as
+// the system stays idle.
+static void catcierge_retention_recompress_old(catcierge_retention_t *r,
+		catcierge_retention_usage_t *usage, time_t now)
+{
+	size_t i;
+	const char *ext;
+	catcierge_retention_file_t *f;
+	time_t max_age = (time_t)r->settings.recompress_age * 60 * 60;
+
+	for (i = 0; i < r->file_count; i++)
+	{
+		f = &r->files[i];
+
+		if (!f->path || (f->cls == CATCIERGE_RETAIN_TEMPLATES)
+			|| ((now - f->mtime) < max_age)
+			|| !(ext = strrchr(f->path, '.')) || !strcmp(ext, ".png"))
+		{
+			continue;
+		}
+
+		if (catcierge_retention_stopping(r) || !catcierge_retention_is_idle(r))
+		{
+			break;
+		}
+
+		catcierge_retention_recompress(r, usage, f);
+	}
+}
+
+static void catcierge_retention_free_files(catcierge_retention_t *r)
+{
+	size_t i;
+
+	for (i = 0; i < r->file_count; i++)
+	{
+		catcierge_xfree(&r->files[i].path);
+	}
+
+	r->file_count = 0;
+}
+
+static void catcierge_retention_disk_usage(catcierge_retention_t *r,
+		unsigned long long *disk_free, unsigned long long *disk_total)
+{
+	#ifdef CATCIERGE_HAVE_SYS_STATVFS_H
+	struct statvfs vfs;
+
+	if (r->settings.roots[0] && !statvfs(r->settings.roots[0], &vfs))
+	{
+		*disk_free = (unsigned long long)vfs.f_bavail * vfs.f_frsize;
+		*disk_total = (unsigned long long)vfs.f_blocks * vfs.f_frsize;
+	}
+	#endif
+}
+
+#endif // CATCIERGE_HAVE_RETENTION
+
+int catcierge_retention_pass(catcierge_retention_t *r)
+{
+	#ifdef CATCIERGE_HAVE_RETENTION
+	size_t i;
+	size_t j;
+	time_t now = time(NULL);
+	unsigned long deleted = 0;
+	unsigned long long disk_free;
+	unsigned long long disk_total;
+	catcierge_retention_usage_t usage[CATCIERGE_RETAIN_CLASS_COUNT];
+	assert(r);
+
+	// The totals are built up here and published when the pass is
+	// done, so the readers never see them half way through a scan.
+	pthread_mutex_lock(&r->lock);
+	memcpy(usage, r->usage, sizeof(usage));
+	disk_free = r->disk_free;
+	disk_total = r->disk_total;
+	pthread_mutex_unlock(&r->lock);
+
+	// Only the files removed by this pass are logged.
+	for (i = 0; i < CATCIERGE_RETAIN_CLASS_COUNT; i++)
+	{
+		deleted -= usage[i].deleted_count;
+		usage[i].files = 0;
+		usage[i].bytes = 0;
+	}
+
+	// Classes often share a directory, scan each one once.
+	// Nested roots are covered by the directory they are in.
+	for (i = 0; i < CATCIERGE_RETAIN_CLASS_COUNT; i++)
+	{
+		const char *root = r->settings.roots[i];
+
+		if (!root)
+			continue;
+
+		for (j = 0; j < CATCIERGE_RETAIN_CLASS_COUNT; j++)
+		{
+			const char *other = r->settings.roots[j];
+
+			if (other && (j != i) && catcierge_retention_under(root, other)
+				&& (strcmp(root, other) || (j < i)))
+			{
+				break;
+			}
+		}
+
+		if (j == CATCIERGE_RETAIN_CLASS_COUNT)
+		{
+			catcierge_retention_scan(r, root, 0);
+		}
+	}
+
+	qsort(r->files, r->file_count, sizeof(catcierge_retention_file_t),
+		catcierge_retention_compare);
+
+	catcierge_retention_enforce(r, usage, now);
+
+	if (r->settings.recompress_age > 0)
+	{
+		catcierge_retention_recompress_old(r, usage, now);
+	}
+
+	for (i = 0; i < r->file_count; i++)
+	{
+		if (r->files[i].path)
+			usage[r->files[i].cls].files++;
+	}
+
+	catcierge_retention_free_files(r);
+	catcierge_retention_disk_usage(r, &disk_free, &disk_total);
+
+	pthread_mutex_lock(&r->lock);
+	memcpy(r->usage, usage, sizeof(r->usage));
+	r->disk_free = disk_free;
+	r->disk_total = disk_total;
+	r->pass_count++;
+	pthread_mutex_unlock(&r->lock);
+
+	for (i = 0; i < CATCIERGE_RETAIN_CLASS_COUNT; i++)
+	{
+		deleted += usage[i].deleted_count;
+	}
+
+	if (deleted)
+	{
+		CATLOG("Retention removed %lu files to stay within the quotas\n", deleted);
+	}
+
+	return 0;
+	#else
+	return -1;
+	#endif
+}
+
+#ifdef CATCIERGE_HAVE_RETENTION
+static void *catcierge_retention_worker(void *arg)
+{
+	catcierge_retention_t *r = (catcierge_retention_t *)arg;
+	struct timespec ts;
+	struct timeval tv;
+
+	#ifdef __linux__
+	// The nice value and I/O priority are per thread on Linux, so
+	// this only makes the janitor yield to the matching.
+	setpriority(PRIO_PROCESS, 0, 19);
+	#ifdef SYS_ioprio_set
+	syscall(SYS_ioprio_set, 1, 0, (3 << 13)); // IOPRIO_CLASS_IDLE
+	#endif
+	#endif // __linux__
+
+	while (1)
+	{
+		catcierge_retention_pass(r);
+
+		gettimeofday(&tv, NULL);
+		ts.tv_sec = tv.tv_sec + r->settings.interval;
+		ts.tv_nsec = tv.tv_usec * 1000;
+
+		pthread_mutex_lock(&r->lock);
+
+		while (r->running)
+		{
+			if (pthread_cond_timedwait(&r->wakeup, &r->lock, &ts) == ETIMEDOUT)
+			{
+				break;
+			}
+		}
+
+		if (!r->running)
+		{
+			pthread_mutex_unlock(&r->lock);
+			break;
+		}
+
+		pthread_mutex_unlock(&r->lock);
+	}
+
+	return NULL;
+}
+#endif // CATCIERGE_HAVE_RETENTION
+
+int catcierge_retention_init(catcierge_retention_t *r,
+		const catcierge_retention_settings_t *settings)
+{
+	size_t i;
+	assert(r);
+	assert(settings);
+	memset(r, 0, sizeof(catcierge_retention_t));
+
+	#ifdef CATCIERGE_HAVE_RETENTION
+
+	if (settings->interval <= 0)
+	{
+		CATERR("Invalid retention interval %d\n", settings->interval);
+		return -1;
+	}
+
+	r->settings = *settings;
+	memset(r->settings.roots, 0, sizeof(r->settings.roots));
+	memset(r->settings.template_patterns, 0, sizeof(r->settings.template_patterns));
+
+	for (i = 0; i < CATCIERGE_RETAIN_CLASS_COUNT; i++)
+	{
+		if (settings->roots[i] && !(r->settings.roots[i] = strdup(settings->roots[i])))
+		{
+			goto fail;
+		}
+	}
+
+	for (i = 0; i < settings->template_pattern_count; i++)
+	{
+		if (!(r->settings.template_patterns[i] = strdup(settings->template_patterns[i])))
+		{
+			goto fail;
+		}
+	}
+
+	r->last_activity = time(NULL);
+	r->running = 1;
+	pthread_mutex_init(&r->lock, NULL);
+	pthread_cond_init(&r->wakeup, NULL);
+
+	return 0;
+fail:
+	CATERR("Out of memory\n");
+	r->settings.template_pattern_count = i;
+	catcierge_retention_settings_free(&r->settings);
+	return -1;
+
+	#else // !CATCIERGE_HAVE_RETENTION
+
+	CATERR("Retention is not supported on this platform\n");
+	return -1;
+
+	#endif // CATCIERGE_HAVE_RETENTION
+}
+
+int catcierge_retention_start(catcierge_retention_t *r)
+{
+	assert(r);
+
+	if (!r->running)
+	{
+		return -1;
+	}
+
+	#ifdef CATCIERGE_HAVE_RETENTION
+	if (pthread_create(&r->thread, NULL, catcierge_retention_worker, r))
+	{
+		CATERR("Failed to start retention thread\n");
+		return -1;
+	}
+
+	r->started = 1;
+
+	CATLOG("Started retention, checking every %d seconds\n", r->settings.interval);
+	#endif
+
+	return 0;
+}
+
+void catcierge_retention_destroy(catcierge_retention_t *r)
+{
+	size_t i;
+	assert(r);
+
+	if (!r->running)
+	{
+		return;
+	}
+
+	#ifdef CATCIERGE_HAVE_RETENTION
+	pthread_mutex_lock(&r->lock);
+	r->running = 0;
+	pthread_cond_signal(&r->wakeup);
+	pthread_mutex_unlock(&r->lock);
+
+	if (r->started)
+	{
+		pthread_join(r->thread, NULL);
+		r->started = 0;
+	}
+
+	pthread_mutex_destroy(&r->lock);
+	pthread_cond_destroy(&r->wakeup);
+
+	for (i = 0; i < CATCIERGE_RETAIN_CLASS_COUNT; i++)
+	{
+		if (!r->usage[i].deleted_count && !r->usage[i].recompressed_count)
+			continue;
+
+		CATLOG("Retention %s: %lu removed (%llu bytes), %lu recompressed (%llu bytes saved)\n",
+			catcierge_retention_class_str((catcierge_retention_class_t)i),
+			r->usage[i].deleted_count, r->usage[i].deleted_bytes,
+			r->usage[i].recompressed_count, r->usage[i].recompressed_saved);
+	}
+
+	catcierge_retention_free_files(r);
+	catcierge_xfree(&r->files);
+	r->file_max_count = 0;
+	catcierge_retention_settings_free(&r->settings);
+	#endif // CATCIERGE_HAVE_RETENTION
+}
+
+void catcierge_retention_stats(catcierge_retention_t *r, catcierge_retention_stats_t *stats)
+{
+	assert(r);
+	assert(stats);
+
+	// The lock only exists while running, until then nothing else writes these.
+	#ifdef CATCIERGE_HAVE_RETENTION
+	if (r->running)
+		pthread_mutex_lock(&r->lock);
+	#endif
+
+	memcpy(stats->usage, r->usage, sizeof(stats->usage));
+	stats->disk_free = r->disk_free;
+	stats->disk_total = r->disk_total;
+	stats->pass_count = r->pass_count;
+
+	#ifdef CATCIERGE_HAVE_RETENTION
+	if (r->running)
+		pthread_mutex_unlock(&r->lock);
+	#endif
+}
+
+void catcierge_retention_activity(catcierge_retention_t *r)
+{
+	assert(r);
+
+	if (!r->running)
+	{
+		return;
+	}
+
+	#ifdef CATCIERGE_HAVE_RETENTION
+	pthread_mutex_lock(&r->lock);
+	r->last_activity = time(NULL);
+	pthread_mutex_unlock(&r->lock);
+	#endif
+}
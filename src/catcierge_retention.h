@@ -0,0 +1,160 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_RETENTION_H__
+#define __CATCIERGE_RETENTION_H__
+
+#include <stddef.h>
+#include <time.h>
+#include <catcierge_config.h>
+
+#ifdef CATCIERGE_HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#if defined(CATCIERGE_HAVE_PTHREAD_H) && defined(CATCIERGE_HAVE_DIRENT_H) \
+	&& defined(CATCIERGE_HAVE_FNMATCH_H) && defined(CATCIERGE_HAVE_SYS_STAT_H)
+#define CATCIERGE_HAVE_RETENTION
+#endif
+
+#define DEFAULT_RETENTION_INTERVAL 600 // Seconds
+#define DEFAULT_RETENTION_IDLE_TIME 120 // Seconds
+#define CATCIERGE_RETENTION_MAX_DEPTH 16
+#define CATCIERGE_RETENTION_MAX_PATTERNS 32
+
+typedef enum catcierge_retention_class_e
+{
+	CATCIERGE_RETAIN_MATCH,
+	CATCIERGE_RETAIN_STEPS,
+	CATCIERGE_RETAIN_OBSTRUCT,
+	CATCIERGE_RETAIN_TEMPLATES,
+	CATCIERGE_RETAIN_CLASS_COUNT
+} catcierge_retention_class_t;
+
+typedef struct catcierge_retention_quota_s
+{
+	unsigned long long max_size;	// Bytes, 0 for no limit.
+	int max_age;					// Days, 0 for no limit.
+} catcierge_retention_quota_t;
+
+typedef struct catcierge_retention_usage_s
+{
+	unsigned long long bytes;		// Found by the latest pass.
+	unsigned long files;
+	unsigned long deleted_count;	// Since start.
+	unsigned long long deleted_bytes;
+	unsigned long recompressed_count;
+	unsigned long long recompressed_saved; // Bytes saved by recompressing.
+} catcierge_retention_usage_t;
+
+typedef struct catcierge_retention_stats_s
+{
+	catcierge_retention_usage_t usage[CATCIERGE_RETAIN_CLASS_COUNT];
+	unsigned long long disk_free;
+	unsigned long long disk_total;
+	unsigned long pass_count;
+} catcierge_retention_stats_t;
+
+typedef struct catcierge_retention_settings_s
+{
+	int interval;				// Seconds between passes.
+	int recompress_age;			// Hours before an image is recompressed to png, 0 for never.
+	int idle_time;				// Seconds without activity before recompressing.
+	char *roots[CATCIERGE_RETAIN_CLASS_COUNT]; // Directory scanned for each class.
+	char *template_patterns[CATCIERGE_RETENTION_MAX_PATTERNS]; // File name globs.
+	size_t template_pattern_count;
+	catcierge_retention_quota_t quotas[CATCIERGE_RETAIN_CLASS_COUNT];
+} catcierge_retention_settings_t;
+
+typedef struct catcierge_retention_file_s
+{
+	char *path;
+	unsigned long long size;
+	time_t mtime;
+	catcierge_retention_class_t cls;
+} catcierge_retention_file_t;
+
+//
+// Keeps the output directories within size and age quotas for each
+// kind of file (match, step and obstruct images and templates), so
+// that a unit can run for years without the disk filling up.
+//
+// A low priority thread scans the directories now and then, deletes
+// the oldest files of a class that is over its quota, and when the
+// cat door has been idle for a while recompresses old images saved
+// in a fast format (qoi, pgm) into a denser one. Only files named the
+// way catcierge names them are ever touched.
+//
+typedef struct catcierge_retention_s
+{
+	int running;
+	catcierge_retention_settings_t settings;
+	catcierge_retention_usage_t usage[CATCIERGE_RETAIN_CLASS_COUNT]; // Updated once per pass, under lock.
+	unsigned long long disk_free;	// Bytes free on the filesystem of the first root.
+	unsigned long long disk_total;
+	unsigned long pass_count;
+	time_t last_activity;
+
+	catcierge_retention_file_t *files; // Used during a pass.
+	size_t file_count;
+	size_t file_max_count;
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	int started;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t wakeup;
+	#endif
+} catcierge_retention_t;
+
+// Copies the settings. Call catcierge_retention_start to run the
+// passes in the background, or catcierge_retention_pass directly.
+int catcierge_retention_init(catcierge_retention_t *r,
+		const catcierge_retention_settings_t *settings);
+int catcierge_retention_start(catcierge_retention_t *r);
+void catcierge_retention_destroy(catcierge_retention_t *r);
+
+// Scans the directories and enforces the quotas once.
+int catcierge_retention_pass(catcierge_retention_t *r);
+
+// Copies the usage and disk statistics of the latest pass.
+void catcierge_retention_stats(catcierge_retention_t *r, catcierge_retention_stats_t *stats);
+
+// Marks the system as busy, postponing any recompression.
+void catcierge_retention_activity(catcierge_retention_t *r);
+
+// Which class a file name belongs to, -1 if none.
+int catcierge_retention_classify(const catcierge_retention_settings_t *settings,
+		const char *filename);
+
+// Returns the part of an output path before its first variable, up
+// to the last full directory name, or fallback if there is none.
+char *catcierge_retention_root(const char *path, const char *fallback);
+
+// Turns a template file name into a glob by replacing the %variables%.
+char *catcierge_retention_pattern(const char *filename);
+
+// Parses "class:max_mb:max_days" where 0 means no limit.
+int catcierge_retention_parse_quota(const char *str,
+		catcierge_retention_class_t *cls, catcierge_retention_quota_t *quota);
+
+const char *catcierge_retention_class_str(catcierge_retention_class_t cls);
+
+void catcierge_retention_settings_free(catcierge_retention_settings_t *settings);
+
+#endif // __CATCIERGE_RETENTION_H__
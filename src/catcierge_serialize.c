@@ -0,0 +1,521 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "catcierge_serialize.h"
+#include "catcierge_log.h"
+
+#define CATCIERGE_SERIALIZE_INITIAL_SIZE 1024
+
+void catcierge_serializer_init(catcierge_serializer_t *s, catcierge_serialize_format_t format)
+{
+	assert(s);
+	memset(s, 0, sizeof(catcierge_serializer_t));
+	s->format = format;
+}
+
+void catcierge_serializer_destroy(catcierge_serializer_t *s)
+{
+	assert(s);
+
+	if (s->buf)
+	{
+		free(s->buf);
+	}
+
+	memset(s, 0, sizeof(catcierge_serializer_t));
+}
+
+void catcierge_serializer_reset(catcierge_serializer_t *s, catcierge_serialize_format_t format)
+{
+	assert(s);
+	s->format = format;
+	s->len = 0;
+	s->error = 0;
+	s->depth = 0;
+	s->count[0] = 0;
+	s->after_key = 0;
+
+	if (s->buf)
+	{
+		s->buf[0] = '\0';
+	}
+}
+
+static void catcierge_serialize_error(catcierge_serializer_t *s, const char *msg)
+{
+	if (!s->error)
+	{
+		CATERR("Serialize: %s\n", msg);
+	}
+
+	s->error = 1;
+}
+
+// Makes room for len more bytes plus a NULL character, so
+// the JSON output can be used as a string directly.
+static int catcierge_serialize_reserve(catcierge_serializer_t *s, size_t len)
+{
+	char *buf;
+	size_t size;
+
+	if (s->error)
+		return -1;
+
+	if ((s->len + len + 1) <= s->size)
+		return 0;
+
+	size = s->size ? s->size : CATCIERGE_SERIALIZE_INITIAL_SIZE;
+
+	while (size < (s->len + len + 1))
+	{
+		size *= 2;
+	}
+
+	if (!(buf = realloc(s->buf, size)))
+	{
+		catcierge_serialize_error(s, "Out of memory!");
+		return -1;
+	}
+
+	s->buf = buf;
+	s->size = size;
+
+	return 0;
+}
+
+static void catcierge_serialize_put(catcierge_serializer_t *s, const void *data, size_t len)
+{
+	if (catcierge_serialize_reserve(s, len))
+		return;
+
+	memcpy(&s->buf[s->len], data, len);
+	s->len += len;
+	s->buf[s->len] = '\0';
+}
+
+static void catcierge_serialize_putc(catcierge_serializer_t *s, char c)
+{
+	if (catcierge_serialize_reserve(s, 1))
+		return;
+
+	s->buf[s->len++] = c;
+	s->buf[s->len] = '\0';
+}
+
+// MessagePack type byte followed by a big endian integer of size bytes.
+static void catcierge_serialize_put_be(catcierge_serializer_t *s,
+		unsigned char type, unsigned long long val, size_t size)
+{
+	unsigned char tmp[9];
+	size_t i;
+
+	tmp[0] = type;
+
+	for (i = 0; i < size; i++)
+	{
+		tmp[size - i] = (unsigned char)(val >> (8 * i));
+	}
+
+	catcierge_serialize_put(s, tmp, size + 1);
+}
+
+// Takes care of separators and key/value pairing before a value.
+static void catcierge_serialize_value_begin(catcierge_serializer_t *s)
+{
+	if (s->depth == 0)
+	{
+		if (s->len > 0)
+		{
+			catcierge_serialize_error(s, "Only one top level value allowed");
+		}
+		return;
+	}
+
+	if (s->is_map[s->depth])
+	{
+		if (!s->after_key)
+		{
+			catcierge_serialize_error(s, "Map value without a key");
+		}
+
+		s->after_key = 0;
+		return;
+	}
+
+	if ((s->format == CATCIERGE_FORMAT_JSON) && (s->count[s->depth] > 0))
+	{
+		catcierge_serialize_putc(s, ',');
+	}
+
+	s->count[s->depth]++;
+}
+
+static void catcierge_serialize_container_begin(catcierge_serializer_t *s,
+		size_t count, int is_map)
+{
+	catcierge_serialize_value_begin(s);
+
+	if (s->depth >= (CATCIERGE_SERIALIZE_MAX_DEPTH - 1))
+	{
+		catcierge_serialize_error(s, "Nested too deep");
+		return;
+	}
+
+	s->depth++;
+	s->count[s->depth] = 0;
+	s->expected[s->depth] = count;
+	s->is_map[s->depth] = is_map;
+
+	if (s->format == CATCIERGE_FORMAT_JSON)
+	{
+		catcierge_serialize_putc(s, is_map ? '{' : '[');
+	}
+	else if (count < 16)
+	{
+		catcierge_serialize_putc(s, (char)((is_map ? 0x80 : 0x90) | count));
+	}
+	else if (count <= 0xffff)
+	{
+		catcierge_serialize_put_be(s, is_map ? 0xde : 0xdc, count, 2);
+	}
+	else
+	{
+		catcierge_serialize_put_be(s, is_map ? 0xdf : 0xdd, count, 4);
+	}
+}
+
+static void catcierge_serialize_container_end(catcierge_serializer_t *s, int is_map)
+{
+	if ((s->depth == 0) || (s->is_map[s->depth] != is_map) || s->after_key)
+	{
+		catcierge_serialize_error(s, "Unbalanced map or array");
+		return;
+	}
+
+	if ((s->format == CATCIERGE_FORMAT_MSGPACK)
+		&& (s->count[s->depth] != s->expected[s->depth]))
+	{
+		catcierge_serialize_error(s, "Map or array count mismatch");
+	}
+
+	if (s->format == CATCIERGE_FORMAT_JSON)
+	{
+		catcierge_serialize_putc(s, is_map ? '}' : ']');
+	}
+
+	s->depth--;
+}
+
+void catcierge_serialize_map_begin(catcierge_serializer_t *s, size_t count)
+{
+	assert(s);
+	catcierge_serialize_container_begin(s, count, 1);
+}
+
+void catcierge_serialize_map_end(catcierge_serializer_t *s)
+{
+	assert(s);
+	catcierge_serialize_container_end(s, 1);
+}
+
+void catcierge_serialize_array_begin(catcierge_serializer_t *s, size_t count)
+{
+	assert(s);
+	catcierge_serialize_container_begin(s, count, 0);
+}
+
+void catcierge_serialize_array_end(catcierge_serializer_t *s)
+{
+	assert(s);
+	catcierge_serialize_container_end(s, 0);
+}
+
+static void catcierge_serialize_json_str(catcierge_serializer_t *s, const char *str, size_t len)
+{
+	const unsigned char *it = (const unsigned char *)str;
+	const unsigned char *end = it + len;
+	const unsigned char *run = it;
+	char esc[8];
+
+	catcierge_serialize_putc(s, '"');
+
+	while (it < end)
+	{
+		if ((*it >= 0x20) && (*it != '"') && (*it != '\\'))
+		{
+			it++;
+			continue;
+		}
+
+		// Write everything up to the character that needs escaping.
+		catcierge_serialize_put(s, run, it - run);
+
+		switch (*it)
+		{
+			case '"': catcierge_serialize_put(s, "\\\"", 2); break;
+			case '\\': catcierge_serialize_put(s, "\\\\", 2); break;
+			case '\n': catcierge_serialize_put(s, "\\n", 2); break;
+			case '\r': catcierge_serialize_put(s, "\\r", 2); break;
+			case '\t': catcierge_serialize_put(s, "\\t", 2); break;
+			case '\b': catcierge_serialize_put(s, "\\b", 2); break;
+			case '\f': catcierge_serialize_put(s, "\\f", 2); break;
+			default:
+				snprintf(esc, sizeof(esc), "\\u%04x", *it);
+				catcierge_serialize_put(s, esc, 6);
+				break;
+		}
+
+		run = ++it;
+	}
+
+	catcierge_serialize_put(s, run, it - run);
+	catcierge_serialize_putc(s, '"');
+}
+
+static void catcierge_serialize_msgpack_str(catcierge_serializer_t *s, const char *str, size_t len)
+{
+	if (len < 32)
+	{
+		catcierge_serialize_putc(s, (char)(0xa0 | len));
+	}
+	else if (len <= 0xff)
+	{
+		catcierge_serialize_put_be(s, 0xd9, len, 1);
+	}
+	else if (len <= 0xffff)
+	{
+		catcierge_serialize_put_be(s, 0xda, len, 2);
+	}
+	else
+	{
+		catcierge_serialize_put_be(s, 0xdb, len, 4);
+	}
+
+	catcierge_serialize_put(s, str, len);
+}
+
+void catcierge_serialize_key(catcierge_serializer_t *s, const char *key)
+{
+	assert(s);
+	assert(key);
+
+	if ((s->depth == 0) || !s->is_map[s->depth] || s->after_key)
+	{
+		catcierge_serialize_error(s, "Key outside of a map");
+		return;
+	}
+
+	if (s->format == CATCIERGE_FORMAT_JSON)
+	{
+		if (s->count[s->depth] > 0)
+		{
+			catcierge_serialize_putc(s, ',');
+		}
+
+		catcierge_serialize_json_str(s, key, strlen(key));
+		catcierge_serialize_putc(s, ':');
+	}
+	else
+	{
+		catcierge_serialize_msgpack_str(s, key, strlen(key));
+	}
+
+	s->count[s->depth]++;
+	s->after_key = 1;
+}
+
+void catcierge_serialize_strn(catcierge_serializer_t *s, const char *str, size_t len)
+{
+	assert(s);
+	catcierge_serialize_value_begin(s);
+
+	if (s->format == CATCIERGE_FORMAT_JSON)
+	{
+		catcierge_serialize_json_str(s, str, len);
+	}
+	else
+	{
+		catcierge_serialize_msgpack_str(s, str, len);
+	}
+}
+
+void catcierge_serialize_str(catcierge_serializer_t *s, const char *str)
+{
+	if (!str)
+	{
+		catcierge_serialize_nil(s);
+		return;
+	}
+
+	catcierge_serialize_strn(s, str, strlen(str));
+}
+
+void catcierge_serialize_int(catcierge_serializer_t *s, long long val)
+{
+	char tmp[32];
+	assert(s);
+	catcierge_serialize_value_begin(s);
+
+	if (s->format == CATCIERGE_FORMAT_JSON)
+	{
+		int len = snprintf(tmp, sizeof(tmp), "%lld", val);
+		catcierge_serialize_put(s, tmp, len);
+	}
+	else if (val >= 0)
+	{
+		if (val < 128) catcierge_serialize_putc(s, (char)val);
+		else if (val <= 0xff) catcierge_serialize_put_be(s, 0xcc, val, 1);
+		else if (val <= 0xffff) catcierge_serialize_put_be(s, 0xcd, val, 2);
+		else if (val <= 0xffffffffLL) catcierge_serialize_put_be(s, 0xce, val, 4);
+		else catcierge_serialize_put_be(s, 0xcf, val, 8);
+	}
+	else
+	{
+		if (val >= -32) catcierge_serialize_putc(s, (char)val);
+		else if (val >= -128) catcierge_serialize_put_be(s, 0xd0, val, 1);
+		else if (val >= -32768) catcierge_serialize_put_be(s, 0xd1, val, 2);
+		else if (val >= -2147483647LL - 1) catcierge_serialize_put_be(s, 0xd2, val, 4);
+		else catcierge_serialize_put_be(s, 0xd3, val, 8);
+	}
+}
+
+void catcierge_serialize_double(catcierge_serializer_t *s, double val)
+{
+	char tmp[64];
+	assert(s);
+
+	if (s->format == CATCIERGE_FORMAT_JSON)
+	{
+		int len;
+
+		// JSON has no representation for these.
+		if (isnan(val) || isinf(val))
+		{
+			catcierge_serialize_nil(s);
+			return;
+		}
+
+		catcierge_serialize_value_begin(s);
+		len = snprintf(tmp, sizeof(tmp), "%f", val);
+		catcierge_serialize_put(s, tmp, len);
+	}
+	else
+	{
+		unsigned long long bits;
+		catcierge_serialize_value_begin(s);
+		memcpy(&bits, &val, sizeof(bits));
+		catcierge_serialize_put_be(s, 0xcb, bits, 8);
+	}
+}
+
+void catcierge_serialize_bool(catcierge_serializer_t *s, int val)
+{
+	assert(s);
+	catcierge_serialize_value_begin(s);
+
+	if (s->format == CATCIERGE_FORMAT_JSON)
+	{
+		if (val) catcierge_serialize_put(s, "true", 4);
+		else catcierge_serialize_put(s, "false", 5);
+	}
+	else
+	{
+		catcierge_serialize_putc(s, (char)(val ? 0xc3 : 0xc2));
+	}
+}
+
+void catcierge_serialize_nil(catcierge_serializer_t *s)
+{
+	assert(s);
+	catcierge_serialize_value_begin(s);
+
+	if (s->format == CATCIERGE_FORMAT_JSON)
+	{
+		catcierge_serialize_put(s, "null", 4);
+	}
+	else
+	{
+		catcierge_serialize_putc(s, (char)0xc0);
+	}
+}
+
+void catcierge_serialize_kv_str(catcierge_serializer_t *s, const char *key, const char *str)
+{
+	catcierge_serialize_key(s, key);
+	catcierge_serialize_str(s, str);
+}
+
+void catcierge_serialize_kv_int(catcierge_serializer_t *s, const char *key, long long val)
+{
+	catcierge_serialize_key(s, key);
+	catcierge_serialize_int(s, val);
+}
+
+void catcierge_serialize_kv_double(catcierge_serializer_t *s, const char *key, double val)
+{
+	catcierge_serialize_key(s, key);
+	catcierge_serialize_double(s, val);
+}
+
+void catcierge_serialize_kv_bool(catcierge_serializer_t *s, const char *key, int val)
+{
+	catcierge_serialize_key(s, key);
+	catcierge_serialize_bool(s, val);
+}
+
+int catcierge_serialize_format_from_name(const char *name, catcierge_serialize_format_t *format)
+{
+	assert(name);
+	assert(format);
+
+	if (!strcmp(name, "text"))
+	{
+		*format = CATCIERGE_FORMAT_TEXT;
+	}
+	else if (!strcmp(name, "json"))
+	{
+		*format = CATCIERGE_FORMAT_JSON;
+	}
+	else if (!strcmp(name, "msgpack"))
+	{
+		*format = CATCIERGE_FORMAT_MSGPACK;
+	}
+	else
+	{
+		return -1;
+	}
+
+	return 0;
+}
+
+const char *catcierge_serialize_format_name(catcierge_serialize_format_t format)
+{
+	switch (format)
+	{
+		case CATCIERGE_FORMAT_TEXT: return "text";
+		case CATCIERGE_FORMAT_JSON: return "json";
+		case CATCIERGE_FORMAT_MSGPACK: return "msgpack";
+	}
+
+	return "unknown";
+}
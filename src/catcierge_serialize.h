@@ -0,0 +1,86 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_SERIALIZE_H__
+#define __CATCIERGE_SERIALIZE_H__
+
+#include <stddef.h>
+
+#define CATCIERGE_SERIALIZE_MAX_DEPTH 16
+
+typedef enum catcierge_serialize_format_e
+{
+	CATCIERGE_FORMAT_TEXT,		// Rendered through the template engine.
+	CATCIERGE_FORMAT_JSON,
+	CATCIERGE_FORMAT_MSGPACK
+} catcierge_serialize_format_t;
+
+//
+// Writes JSON or MessagePack into a buffer that is kept between
+// uses, so serializing an event does not need any allocations once
+// the buffer has grown big enough.
+//
+// MessagePack stores the number of entries in a map or array before
+// the entries themselves, so the count given when starting one must
+// match the number of values written to it. JSON ignores the count.
+//
+// Errors are sticky, check the error flag once everything is written.
+//
+typedef struct catcierge_serializer_s
+{
+	catcierge_serialize_format_t format;
+	char *buf;
+	size_t len;
+	size_t size;
+	int error;
+
+	int depth;
+	size_t count[CATCIERGE_SERIALIZE_MAX_DEPTH];	// Values written at each level.
+	size_t expected[CATCIERGE_SERIALIZE_MAX_DEPTH];	// Count given at begin.
+	int is_map[CATCIERGE_SERIALIZE_MAX_DEPTH];
+	int after_key;
+} catcierge_serializer_t;
+
+void catcierge_serializer_init(catcierge_serializer_t *s, catcierge_serialize_format_t format);
+void catcierge_serializer_destroy(catcierge_serializer_t *s);
+
+// Empties the buffer but keeps the memory.
+void catcierge_serializer_reset(catcierge_serializer_t *s, catcierge_serialize_format_t format);
+
+void catcierge_serialize_map_begin(catcierge_serializer_t *s, size_t count);
+void catcierge_serialize_map_end(catcierge_serializer_t *s);
+void catcierge_serialize_array_begin(catcierge_serializer_t *s, size_t count);
+void catcierge_serialize_array_end(catcierge_serializer_t *s);
+void catcierge_serialize_key(catcierge_serializer_t *s, const char *key);
+void catcierge_serialize_str(catcierge_serializer_t *s, const char *str);
+void catcierge_serialize_strn(catcierge_serializer_t *s, const char *str, size_t len);
+void catcierge_serialize_int(catcierge_serializer_t *s, long long val);
+void catcierge_serialize_double(catcierge_serializer_t *s, double val);
+void catcierge_serialize_bool(catcierge_serializer_t *s, int val);
+void catcierge_serialize_nil(catcierge_serializer_t *s);
+
+// Key + value in one go.
+void catcierge_serialize_kv_str(catcierge_serializer_t *s, const char *key, const char *str);
+void catcierge_serialize_kv_int(catcierge_serializer_t *s, const char *key, long long val);
+void catcierge_serialize_kv_double(catcierge_serializer_t *s, const char *key, double val);
+void catcierge_serialize_kv_bool(catcierge_serializer_t *s, const char *key, int val);
+
+int catcierge_serialize_format_from_name(const char *name, catcierge_serialize_format_t *format);
+const char *catcierge_serialize_format_name(catcierge_serialize_format_t format);
+
+#endif // __CATCIERGE_SERIALIZE_H__
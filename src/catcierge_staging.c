@@ -0,0 +1,484 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <catcierge_config.h>
+#ifdef CATCIERGE_HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef _WIN32
+#include <io.h>
+#endif
+#ifdef CATCIERGE_HAVE_PTHREAD_H
+#include <sys/time.h>
+#endif
+#include "catcierge_staging.h"
+#include "catcierge_util.h"
+#include "catcierge_log.h"
+
+const char *catcierge_fsync_policy_str(catcierge_fsync_policy_t policy)
+{
+	switch (policy)
+	{
+		case CATCIERGE_FSYNC_NEVER: return "never";
+		case CATCIERGE_FSYNC_BATCH: return "batch";
+		case CATCIERGE_FSYNC_FILE: return "file";
+	}
+
+	return "unknown";
+}
+
+int catcierge_fsync_policy_parse(const char *str, catcierge_fsync_policy_t *policy)
+{
+	assert(str);
+	assert(policy);
+
+	if (!strcmp(str, "never"))
+		*policy = CATCIERGE_FSYNC_NEVER;
+	else if (!strcmp(str, "batch"))
+		*policy = CATCIERGE_FSYNC_BATCH;
+	else if (!strcmp(str, "file"))
+		*policy = CATCIERGE_FSYNC_FILE;
+	else
+		return -1;
+
+	return 0;
+}
+
+static int catcierge_staging_sync_file(FILE *f)
+{
+	if (fflush(f))
+	{
+		return -1;
+	}
+
+	#ifdef _WIN32
+	return _commit(_fileno(f));
+	#elif defined(CATCIERGE_HAVE_UNISTD_H)
+	return fsync(fileno(f));
+	#else
+	return 0;
+	#endif
+}
+
+static void catcierge_staging_sync_all()
+{
+	#if !defined(_WIN32) && defined(CATCIERGE_HAVE_UNISTD_H)
+	sync();
+	#endif
+}
+
+static int catcierge_staging_write_file(const char *path,
+		const char *data, size_t len, int sync_file)
+{
+	FILE *f = NULL;
+	int ret = 0;
+
+	if (!(f = fopen(path, "wb")))
+	{
+		CATERR("Failed to open \"%s\" for writing\n", path);
+		return -1;
+	}
+
+	if (fwrite(data, 1, len, f) != len)
+	{
+		CATERR("Failed to write %d bytes to \"%s\"\n", (int)len, path);
+		ret = -1;
+	}
+
+	if (!ret && sync_file && catcierge_staging_sync_file(f))
+	{
+		CATERR("Failed to sync \"%s\"\n", path);
+		ret = -1;
+	}
+
+	if (fclose(f))
+	{
+		ret = -1;
+	}
+
+	return ret;
+}
+
+// Returns a copy of path followed by its directory in the same allocation.
+static char *catcierge_staging_split_path(const char *path, char **dir)
+{
+	size_t len = strlen(path);
+	size_t dir_len = len;
+	char *buf;
+
+	while ((dir_len > 0) && (path[dir_len - 1] != '/') && (path[dir_len - 1] != '\\'))
+	{
+		dir_len--;
+	}
+
+	if (!(buf = malloc((len + 1) + (dir_len + 1))))
+	{
+		return NULL;
+	}
+
+	memcpy(buf, path, len + 1);
+	*dir = buf + len + 1;
+	memcpy(*dir, path, dir_len);
+	(*dir)[dir_len] = '\0';
+
+	return buf;
+}
+
+static int catcierge_staging_write_direct(catcierge_staging_t *st,
+		const char *path, const char *data, size_t len)
+{
+	char *dir = NULL;
+	char *buf = NULL;
+	int ret = 0;
+
+	if (!(buf = catcierge_staging_split_path(path, &dir)))
+	{
+		CATERR("Out of memory\n");
+		return -1;
+	}
+
+	if (*dir && catcierge_make_path("%s", dir))
+	{
+		CATERR("Failed to create directory %s\n", dir);
+	}
+
+	ret = catcierge_staging_write_file(path, data, len,
+			(st->fsync_policy != CATCIERGE_FSYNC_NEVER));
+
+	free(buf);
+	return ret;
+}
+
+#ifdef CATCIERGE_HAVE_PTHREAD_H
+
+static void catcierge_staging_abstime(struct timespec *ts, int ms)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	ts->tv_sec = tv.tv_sec + (ms / 1000);
+	ts->tv_nsec = (tv.tv_usec * 1000) + ((ms % 1000) * 1000000L);
+
+	if (ts->tv_nsec >= 1000000000L)
+	{
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000L;
+	}
+}
+
+// Writes the files of the batch one after the other, in the order
+// they were staged, and frees them.
+static void catcierge_staging_flush_batch(catcierge_staging_t *st,
+		catcierge_staged_file_t *batch)
+{
+	catcierge_staged_file_t *next;
+	unsigned long flushed = 0;
+	unsigned long failed = 0;
+	unsigned long long bytes = 0;
+	size_t size = 0;
+
+	while (batch)
+	{
+		next = batch->next;
+
+		catcierge_dir_cache_make_path(&st->dir_cache, batch->dir);
+
+		if (catcierge_staging_write_file(batch->path, batch->data, batch->len,
+				(st->fsync_policy == CATCIERGE_FSYNC_FILE)))
+		{
+			CATERR("Failed to flush %s\n", batch->path);
+			failed++;
+		}
+		else
+		{
+			flushed++;
+			bytes += batch->len;
+		}
+
+		size += batch->len;
+		free(batch->data);
+		free(batch->path);
+		free(batch);
+		batch = next;
+	}
+
+	if ((st->fsync_policy == CATCIERGE_FSYNC_BATCH) && flushed)
+	{
+		catcierge_staging_sync_all();
+	}
+
+	pthread_mutex_lock(&st->lock);
+	st->size -= size;
+	st->flushed_count += flushed;
+	st->failed_count += failed;
+	st->bytes_flushed += bytes;
+	st->batch_count++;
+	pthread_mutex_unlock(&st->lock);
+}
+
+static void *catcierge_staging_flusher(void *arg)
+{
+	catcierge_staging_t *st = (catcierge_staging_t *)arg;
+	catcierge_staged_file_t *batch;
+	struct timespec ts;
+
+	pthread_mutex_lock(&st->lock);
+
+	while (1)
+	{
+		catcierge_staging_abstime(&ts, st->flush_interval * 1000);
+
+		while (!st->flush_now && st->running)
+		{
+			if (pthread_cond_timedwait(&st->wakeup, &st->lock, &ts) == ETIMEDOUT)
+			{
+				break;
+			}
+		}
+
+		st->flush_now = 0;
+
+		// Flush everything staged before stopping.
+		if (!st->head && !st->running)
+		{
+			break;
+		}
+
+		if (!st->head)
+		{
+			continue;
+		}
+
+		// Take the whole list, so that new files can
+		// be staged while this batch is written.
+		batch = st->head;
+		st->head = NULL;
+		st->tail = NULL;
+		pthread_mutex_unlock(&st->lock);
+
+		catcierge_staging_flush_batch(st, batch);
+
+		pthread_mutex_lock(&st->lock);
+	}
+
+	pthread_mutex_unlock(&st->lock);
+
+	return NULL;
+}
+
+#endif // CATCIERGE_HAVE_PTHREAD_H
+
+int catcierge_staging_init(catcierge_staging_t *st, size_t max_size,
+		int flush_interval, catcierge_fsync_policy_t fsync_policy)
+{
+	assert(st);
+	memset(st, 0, sizeof(catcierge_staging_t));
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+
+	if (max_size == 0)
+	{
+		CATERR("Invalid staging size %d\n", (int)max_size);
+		return -1;
+	}
+
+	if ((flush_interval <= 0) || (flush_interval > CATCIERGE_MAX_FLUSH_INTERVAL))
+	{
+		CATERR("Invalid flush interval %d\n", flush_interval);
+		return -1;
+	}
+
+	st->max_size = max_size;
+	st->flush_interval = flush_interval;
+	st->fsync_policy = fsync_policy;
+	st->running = 1;
+	pthread_mutex_init(&st->lock, NULL);
+	pthread_cond_init(&st->wakeup, NULL);
+
+	if (pthread_create(&st->thread, NULL, catcierge_staging_flusher, st))
+	{
+		CATERR("Failed to start staging flusher thread\n");
+		st->running = 0;
+		pthread_mutex_destroy(&st->lock);
+		pthread_cond_destroy(&st->wakeup);
+		return -1;
+	}
+
+	CATLOG("Staging up to %d kB in RAM, flushed every %d seconds (fsync %s)\n",
+		(int)(max_size / 1024), flush_interval,
+		catcierge_fsync_policy_str(fsync_policy));
+
+	return 0;
+
+	#else // !CATCIERGE_HAVE_PTHREAD_H
+
+	CATERR("Staging files in RAM is not supported on this platform\n");
+	return -1;
+
+	#endif // CATCIERGE_HAVE_PTHREAD_H
+}
+
+void catcierge_staging_destroy(catcierge_staging_t *st)
+{
+	assert(st);
+
+	if (!st->running)
+	{
+		return;
+	}
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	pthread_mutex_lock(&st->lock);
+	st->running = 0;
+	pthread_cond_signal(&st->wakeup);
+	pthread_mutex_unlock(&st->lock);
+
+	pthread_join(st->thread, NULL);
+
+	pthread_mutex_destroy(&st->lock);
+	pthread_cond_destroy(&st->wakeup);
+
+	CATLOG("Staging: %lu flushed (%llu bytes) in %lu batches, %lu failed, "
+		"%lu written directly, max %d kB staged\n",
+		st->flushed_count, st->bytes_flushed, st->batch_count,
+		st->failed_count, st->bypassed_count, (int)(st->max_staged / 1024));
+
+	catcierge_dir_cache_destroy(&st->dir_cache);
+	#endif // CATCIERGE_HAVE_PTHREAD_H
+}
+
+int catcierge_staging_add(catcierge_staging_t *st,
+		const char *path, char *data, size_t len)
+{
+	int ret = 0;
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	catcierge_staged_file_t *file = NULL;
+	#endif
+	assert(st);
+	assert(path);
+	assert(data || !len);
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	if (st->running)
+	{
+		// Allocate outside of the lock, the flusher might be waiting for it.
+		if ((file = calloc(1, sizeof(catcierge_staged_file_t)))
+			&& !(file->path = catcierge_staging_split_path(path, &file->dir)))
+		{
+			catcierge_xfree(&file);
+		}
+
+		pthread_mutex_lock(&st->lock);
+
+		if (file && ((st->size + len) <= st->max_size))
+		{
+			file->data = data;
+			file->len = len;
+
+			if (st->tail)
+				st->tail->next = file;
+			else
+				st->head = file;
+
+			st->tail = file;
+			st->size += len;
+			st->staged_count++;
+
+			if (st->size > st->max_staged)
+			{
+				st->max_staged = st->size;
+			}
+
+			// Flush early instead of running out of room.
+			if (st->size >= (st->max_size / 2))
+			{
+				st->flush_now = 1;
+				pthread_cond_signal(&st->wakeup);
+			}
+
+			pthread_mutex_unlock(&st->lock);
+			return 0;
+		}
+
+		st->bypassed_count++;
+		st->flush_now = 1;
+		pthread_cond_signal(&st->wakeup);
+		pthread_mutex_unlock(&st->lock);
+
+		if (file)
+		{
+			free(file->path);
+			free(file);
+		}
+	}
+	#endif // CATCIERGE_HAVE_PTHREAD_H
+
+	// Not staging, or no room left, write it right away.
+	ret = catcierge_staging_write_direct(st, path, data, len);
+	free(data);
+
+	return ret;
+}
+
+int catcierge_staging_write(catcierge_staging_t *st,
+		const char *path, const char *data, size_t len)
+{
+	char *copy = NULL;
+	assert(st);
+	assert(path);
+
+	if (!st->running)
+	{
+		return catcierge_staging_write_direct(st, path, data, len);
+	}
+
+	if (!(copy = malloc(len ? len : 1)))
+	{
+		CATERR("Out of memory\n");
+		return catcierge_staging_write_direct(st, path, data, len);
+	}
+
+	if (len)
+	{
+		memcpy(copy, data, len);
+	}
+
+	return catcierge_staging_add(st, path, copy, len);
+}
+
+void catcierge_staging_flush(catcierge_staging_t *st)
+{
+	assert(st);
+
+	if (!st->running)
+	{
+		return;
+	}
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	pthread_mutex_lock(&st->lock);
+	st->flush_now = 1;
+	pthread_cond_signal(&st->wakeup);
+	pthread_mutex_unlock(&st->lock);
+	#endif
+}
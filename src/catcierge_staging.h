@@ -0,0 +1,118 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2015
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_STAGING_H__
+#define __CATCIERGE_STAGING_H__
+
+#include <stddef.h>
+#include <catcierge_config.h>
+#include "catcierge_util.h"
+
+#ifdef CATCIERGE_HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#define DEFAULT_STAGING_SIZE 16 // MB
+#define CATCIERGE_STAGING_MAX_SIZE 1024 // MB
+#define DEFAULT_FLUSH_INTERVAL 30 // Seconds
+#define CATCIERGE_MAX_FLUSH_INTERVAL 3600
+
+typedef enum catcierge_fsync_policy_e
+{
+	CATCIERGE_FSYNC_NEVER,	// Leave it to the OS to write back the page cache.
+	CATCIERGE_FSYNC_BATCH,	// Sync once after each flushed batch.
+	CATCIERGE_FSYNC_FILE	// Sync each file as it is flushed.
+} catcierge_fsync_policy_t;
+
+#define DEFAULT_FLUSH_FSYNC CATCIERGE_FSYNC_BATCH
+
+typedef struct catcierge_staged_file_s
+{
+	char *path;
+	char *dir;				// Same allocation as path.
+	char *data;
+	size_t len;
+	struct catcierge_staged_file_s *next;
+} catcierge_staged_file_t;
+
+//
+// Keeps the files that are written during a match group in RAM, and
+// lets a flusher thread write them out in one go every flush interval.
+// On an SD card a burst of small writes (images and templates) spread
+// out in time is a lot slower and wears it more than one sequential
+// batch, and the match loop never waits for the card.
+//
+// The staged bytes are capped. When the cap is reached the file is
+// written straight away by the caller instead, and the flusher is
+// woken early once half of the cap is in use.
+//
+// Files only show up at their paths once flushed. Everything still
+// staged is flushed when the staging area is destroyed.
+//
+typedef struct catcierge_staging_s
+{
+	int running;
+	size_t max_size;		// Max number of staged bytes.
+	int flush_interval;		// Seconds between flushes.
+	catcierge_fsync_policy_t fsync_policy;
+
+	catcierge_staged_file_t *head;	// Oldest staged file.
+	catcierge_staged_file_t *tail;
+	size_t size;			// Staged bytes, including the batch being flushed.
+	size_t max_staged;		// Highest number of bytes staged at once.
+	int flush_now;
+
+	unsigned long staged_count;
+	unsigned long bypassed_count;	// Written directly since the cap was reached.
+	unsigned long flushed_count;
+	unsigned long failed_count;
+	unsigned long batch_count;
+	unsigned long long bytes_flushed;
+
+	catcierge_dir_cache_t dir_cache;	// Only used by the flusher thread.
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t wakeup;
+	#endif
+} catcierge_staging_t;
+
+int catcierge_staging_init(catcierge_staging_t *st, size_t max_size,
+		int flush_interval, catcierge_fsync_policy_t fsync_policy);
+
+// Flushes all staged files and stops the flusher.
+void catcierge_staging_destroy(catcierge_staging_t *st);
+
+// Takes ownership of the malloced data. The directory of the path is
+// created when the file is flushed. Returns 0 if the file was staged
+// or written, -1 if writing it failed (the data is freed either way).
+int catcierge_staging_add(catcierge_staging_t *st,
+		const char *path, char *data, size_t len);
+
+// Same as above but stages a copy of the data.
+int catcierge_staging_write(catcierge_staging_t *st,
+		const char *path, const char *data, size_t len);
+
+// Wakes up the flusher to flush what is staged right away.
+void catcierge_staging_flush(catcierge_staging_t *st);
+
+const char *catcierge_fsync_policy_str(catcierge_fsync_policy_t policy);
+int catcierge_fsync_policy_parse(const char *str, catcierge_fsync_policy_t *policy);
+
+#endif // __CATCIERGE_STAGING_H__
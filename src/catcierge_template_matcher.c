@@ -198,6 +198,7 @@ int catcierge_template_matcher_init(catcierge_matcher_t **octx,
 	ctx->super.match = catcierge_template_matcher_match;
 	ctx->super.decide = caticerge_template_matcher_decide;
 	ctx->super.translate = catcierge_template_matcher_translate;
+	ctx->super.var_name = catcierge_template_matcher_var_name;
 
 	return 0;
 }
@@ -468,6 +469,38 @@ void catcierge_template_output_print_usage()
 	}
 }
 
+const char *catcierge_template_matcher_var_name(catcierge_matcher_t *octx, size_t idx,
+	char *buf, size_t bufsize)
+{
+	catcierge_template_matcher_t *ctx = (catcierge_template_matcher_t *)octx;
+	size_t snout_count;
+	assert(ctx);
+
+	snout_count = ctx->args->snout_count;
+
+	if (idx == 0)
+	{
+		return templ_vars[0].name;
+	}
+
+	// "snout#" is one variable per snout.
+	if (idx <= snout_count)
+	{
+		snprintf(buf, bufsize - 1, "snout%d", (int)idx);
+		return buf;
+	}
+
+	// Skip past "snout#".
+	idx = idx - snout_count + 1;
+
+	if (idx >= sizeof(templ_vars) / sizeof(templ_vars[0]))
+	{
+		return NULL;
+	}
+
+	return templ_vars[idx].name;
+}
+
 const char *catcierge_template_matcher_translate(catcierge_matcher_t *octx, const char *var,
 	char *buf, size_t bufsize)
 {
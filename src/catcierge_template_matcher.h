@@ -88,6 +88,8 @@ void catcierge_template_matcher_args_init(catcierge_template_matcher_args_t *arg
 
 const char *catcierge_template_matcher_translate(catcierge_matcher_t *octx, const char *var,
 	char *buf, size_t bufsize);
+const char *catcierge_template_matcher_var_name(catcierge_matcher_t *octx, size_t idx,
+	char *buf, size_t bufsize);
 void catcierge_template_output_print_usage();
 
 #endif // __CATCIERGE_TEMPLATE_MATCHER_H__
@@ -26,6 +26,7 @@
 #include "catcierge_util.h"
 #include "catcierge_types.h"
 #include "catcierge_args.h"
+#include "catcierge_timer.h"
 #ifdef _WIN32
 #include <process.h>
 #else
@@ -46,6 +47,11 @@ typedef struct tester_ctx_s
 	int test_matchable;
 	int debug;
 	int preload;
+	int bench_repeat;
+
+	// Used for matchers that evaluate a whole match group at once.
+	match_group_t mg;
+	char *group_paths[MATCH_MAX_COUNT];
 } tester_ctx_t;
 
 tester_ctx_t ctx;
@@ -97,6 +103,16 @@ static int add_options(catcierge_args_t *args)
 			"so the speed is not affected by disk IO at the time of the matching.",
 			"b", &ctx.preload);
 
+	ctx.bench_repeat = 1;
+	ret |= cargo_add_option(cargo, 0,
+			"<test> --bench_repeat",
+			"Match each image this many times when timing the matcher. "
+			"Use together with --preload to benchmark different matchers "
+			"against each other.",
+			"i", &ctx.bench_repeat);
+	ret |= cargo_add_validation(cargo, 0, "--bench_repeat",
+								cargo_validate_int_range(1, 100000));
+
 	return ret;
 }
 
@@ -116,9 +132,13 @@ int main(int argc, char **argv)
 
 	clock_t start;
 	clock_t end;
+	catcierge_timer_t match_timer;
+	double match_time = 0.0;
+	int match_frames = 0;
 	catcierge_args_t args;
 	memset(&args, 0, sizeof(args));
 	memset(&result, 0, sizeof(result));
+	memset(&match_timer, 0, sizeof(match_timer));
 
 	fprintf(stderr, "Catcierge Image match Tester (C) Joakim Soderberg 2013-2016\n");
 
@@ -230,13 +250,61 @@ int main(int argc, char **argv)
 			printf("  Image size: %dx%d\n", img_size.width, img_size.height);
 
 
-			if ((match_res = matcher->match(matcher, img, &result, 0)) < 0)
+			if (matcher->group_match)
 			{
-				fprintf(stderr, "Something went wrong when matching image: %s\n", ctx.img_paths[i]);
-				catcierge_matcher_destroy(&matcher);
-				return -1;
+				// Batched matchers only give the result once
+				// the group is complete, see below.
+				match_result_t *gres = &ctx.mg.matches[ctx.mg.match_count].result;
+				ctx.group_paths[ctx.mg.match_count] = ctx.img_paths[i];
+				ctx.mg.match_count++;
+
+				catcierge_timer_start(&match_timer);
+				match_res = matcher->match(matcher, img, gres, 0);
+				match_time += catcierge_timer_get(&match_timer);
+
+				cvReleaseImage(&img);
+
+				if ((ctx.mg.match_count == MATCH_MAX_COUNT)
+					|| (i == ((int)ctx.img_count - 1)))
+				{
+					catcierge_timer_start(&match_timer);
+					if (matcher->group_match(matcher, &ctx.mg))
+					{
+						fprintf(stderr, "Something went wrong when matching group\n");
+					}
+					match_time += catcierge_timer_get(&match_timer);
+					match_frames += (int)ctx.mg.match_count;
+
+					for (j = 0; j < (int)ctx.mg.match_count; j++)
+					{
+						gres = &ctx.mg.matches[j].result;
+						printf("  %s: %s %f (%s)\n", ctx.group_paths[j],
+							gres->success ? "Match!" : "No match!",
+							gres->result, gres->description);
+						success_count += !!gres->success;
+					}
+
+					ctx.mg.match_count = 0;
+				}
+
+				continue;
 			}
 
+			catcierge_timer_start(&match_timer);
+
+			for (j = 0; j < ctx.bench_repeat; j++)
+			{
+				if ((match_res = matcher->match(matcher, img, &result, 0)) < 0)
+				{
+					fprintf(stderr, "Something went wrong when matching image: %s\n", ctx.img_paths[i]);
+					catcierge_matcher_destroy(&matcher);
+					return -1;
+				}
+			}
+
+			match_time += catcierge_timer_get(&match_timer);
+			match_frames += ctx.bench_repeat;
+
 			match_success = (match_res >= args.templ.match_threshold);
 
 			if (match_success)
@@ -312,6 +380,14 @@ int main(int argc, char **argv)
 		}
 		printf("%d of %d successful! (%f seconds)\n",
 			success_count, (int)ctx.img_count, (float)(end - start) / CLOCKS_PER_SEC);
+
+		// Wall clock time, the CPU time above counts all inference threads.
+		if (match_frames > 0)
+		{
+			printf("%s matcher: %d frames matched in %0.2f ms, %0.3f ms per frame\n",
+				matcher->name, match_frames, match_time * 1000.0,
+				(match_time * 1000.0) / match_frames);
+		}
 	}
 
 fail:
@@ -28,6 +28,7 @@
 #include "sha1.h"
 
 #define MATCH_MAX_COUNT 4 // The number of matches to perform before deciding the lock state.
+						  // (In streaming mode, the number of matches kept for output).
 
 #define CATCIERGE_DEFINE_EVENT(ev_enum_name, ev_name, ev_description)	\
 	ev_enum_name,
@@ -35,8 +36,12 @@
 typedef enum catcierge_event_e
 {
 	#include "catcierge_events.h"
+	CATCIERGE_EVENT_COUNT
 } catcierge_event_t;
 
+#define CATCIERGE_EVENT_BIT(e) (1u << (e))
+#define CATCIERGE_EVENT_ALL ((1u << CATCIERGE_EVENT_COUNT) - 1)
+
 typedef struct catcierge_output_var_s
 {
 	char *name;
@@ -59,7 +64,9 @@ typedef enum direction_e
 typedef enum catcierge_matcher_type_e
 {
 	MATCHER_TEMPLATE,
-	MATCHER_HAAR
+	MATCHER_HAAR,
+	MATCHER_CHAIN,
+	MATCHER_DNN
 } catcierge_matcher_type_t;
 
 typedef enum catcierge_lockout_method_s
@@ -99,6 +106,7 @@ typedef struct match_result_s
 	match_direction_t direction;
 	match_step_t steps[MAX_STEPS];	// Step by step images+description for the matching algorithm.
 	size_t step_img_count;			// The number of step images.
+	int reused;						// Result copied from an earlier, near identical frame.
 } match_result_t;
 
 // The state of a single match.
@@ -123,6 +131,8 @@ typedef struct match_group_s
 	int success;
 	int success_count;
 	int final_decision;				// Was the match decision overriden by the matcher?
+	int early_decision;				// Was the decision made before MATCH_MAX_COUNT matches?
+	int skipped_frames;				// Frames not matched because a better one was in the burst.
 	char description[512];
 	match_direction_t direction;
 	
@@ -193,6 +193,52 @@ fail:
 	return ret;
 }
 
+int catcierge_dir_cache_make_path(catcierge_dir_cache_t *cache, const char *dir)
+{
+	size_t i;
+	assert(cache);
+	assert(dir);
+
+	if (!*dir)
+	{
+		return 0;
+	}
+
+	for (i = 0; i < CATCIERGE_DIR_CACHE_SIZE; i++)
+	{
+		if (cache->dirs[i] && !strcmp(cache->dirs[i], dir))
+		{
+			return 0;
+		}
+	}
+
+	if (catcierge_make_path("%s", dir))
+	{
+		CATERR("Failed to create directory %s\n", dir);
+		return -1;
+	}
+
+	// Replace the oldest cached directory.
+	catcierge_xfree(&cache->dirs[cache->next]);
+	cache->dirs[cache->next] = strdup(dir);
+	cache->next = (cache->next + 1) % CATCIERGE_DIR_CACHE_SIZE;
+
+	return 0;
+}
+
+void catcierge_dir_cache_destroy(catcierge_dir_cache_t *cache)
+{
+	size_t i;
+	assert(cache);
+
+	for (i = 0; i < CATCIERGE_DIR_CACHE_SIZE; i++)
+	{
+		catcierge_xfree(&cache->dirs[i]);
+	}
+
+	cache->next = 0;
+}
+
 const char *catcierge_get_direction_str(match_direction_t dir)
 {
 	switch (dir)
@@ -772,3 +818,90 @@ char *catcierge_strndup(const char *s, size_t n)
 	return (char *)memcpy(result, s, len);
 }
 
+int catcierge_parse_time(const char *str, uint64_t *time_us)
+{
+	struct tm tm;
+	time_t t;
+	int n;
+	assert(str);
+	assert(time_us);
+
+	memset(&tm, 0, sizeof(tm));
+
+	n = sscanf(str, "%d-%d-%d%*c%d:%d:%d",
+		&tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+		&tm.tm_hour, &tm.tm_min, &tm.tm_sec);
+
+	if ((n != 3) && (n != 6))
+	{
+		return -1;
+	}
+
+	tm.tm_year -= 1900;
+	tm.tm_mon -= 1;
+	tm.tm_isdst = -1;
+
+	if ((t = mktime(&tm)) == (time_t)-1)
+	{
+		return -1;
+	}
+
+	*time_us = (uint64_t)t * 1000000;
+
+	return 0;
+}
+
+static const uint32_t crc32_nibble_table[16] =
+{
+	0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+	0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+	0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+	0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+uint32_t catcierge_crc32(const unsigned char *data, size_t len)
+{
+	uint32_t crc = 0xffffffff;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+	{
+		crc = (crc >> 4) ^ crc32_nibble_table[(crc ^ data[i]) & 0x0f];
+		crc = (crc >> 4) ^ crc32_nibble_table[(crc ^ (data[i] >> 4)) & 0x0f];
+	}
+
+	return crc ^ 0xffffffff;
+}
+
+void catcierge_put_u16(unsigned char *b, uint16_t v)
+{
+	b[0] = v & 0xff;
+	b[1] = (v >> 8) & 0xff;
+}
+
+void catcierge_put_u32(unsigned char *b, uint32_t v)
+{
+	catcierge_put_u16(b, v & 0xffff);
+	catcierge_put_u16(b + 2, v >> 16);
+}
+
+void catcierge_put_u64(unsigned char *b, uint64_t v)
+{
+	catcierge_put_u32(b, (uint32_t)(v & 0xffffffff));
+	catcierge_put_u32(b + 4, (uint32_t)(v >> 32));
+}
+
+uint16_t catcierge_get_u16(const unsigned char *b)
+{
+	return (uint16_t)(b[0] | (b[1] << 8));
+}
+
+uint32_t catcierge_get_u32(const unsigned char *b)
+{
+	return catcierge_get_u16(b) | ((uint32_t)catcierge_get_u16(b + 2) << 16);
+}
+
+uint64_t catcierge_get_u64(const unsigned char *b)
+{
+	return catcierge_get_u32(b) | ((uint64_t)catcierge_get_u32(b + 4) << 32);
+}
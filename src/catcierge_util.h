@@ -21,6 +21,7 @@
 
 #include "catcierge_types.h"
 #include <time.h>
+#include <stdint.h>
 #include "catcierge_platform.h"
 #include <stdio.h>
 
@@ -29,6 +30,19 @@ void catcierge_reset_cursor_position();
 
 int catcierge_make_path(const char *pathname, ...);
 
+#define CATCIERGE_DIR_CACHE_SIZE 16
+
+// Directories already created, so they are not
+// created again for each file written to them.
+typedef struct catcierge_dir_cache_s
+{
+	char *dirs[CATCIERGE_DIR_CACHE_SIZE];
+	size_t next;
+} catcierge_dir_cache_t;
+
+int catcierge_dir_cache_make_path(catcierge_dir_cache_t *cache, const char *dir);
+void catcierge_dir_cache_destroy(catcierge_dir_cache_t *cache);
+
 const char *catcierge_get_direction_str(match_direction_t dir);
 const char *catcierge_get_left_right_str(direction_t dir);
 
@@ -54,4 +68,18 @@ int catcierge_split(char *str, char delim, char ***array, size_t *length);
 
 char *catcierge_strndup(const char *s, size_t n);
 
+// Accepts "YYYY-MM-DD", "YYYY-MM-DD HH:MM:SS" (or with a T) in local time.
+int catcierge_parse_time(const char *str, uint64_t *time_us);
+
+// CRC-32 as used by zlib.
+uint32_t catcierge_crc32(const unsigned char *data, size_t len);
+
+// Little-endian integers for the binary file formats.
+void catcierge_put_u16(unsigned char *b, uint16_t v);
+void catcierge_put_u32(unsigned char *b, uint32_t v);
+void catcierge_put_u64(unsigned char *b, uint64_t v);
+uint16_t catcierge_get_u16(const unsigned char *b);
+uint32_t catcierge_get_u32(const unsigned char *b);
+uint64_t catcierge_get_u64(const unsigned char *b);
+
 #endif // __CATCIERGE_UTIL_H__
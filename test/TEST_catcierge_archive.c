@@ -0,0 +1,181 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+#include "catcierge_archive.h"
+
+#define TEST_ARCHIVE "test_archive.cca"
+#define TEST_ARCHIVE_INDEX TEST_ARCHIVE ".idx"
+
+static void remove_archive()
+{
+	remove(TEST_ARCHIVE);
+	remove(TEST_ARCHIVE_INDEX);
+}
+
+static int add_record(catcierge_archive_t *a, int n)
+{
+	catcierge_archive_record_t r;
+	IplImage *img;
+	char name[64];
+	char *meta;
+	int ret;
+
+	catcierge_archive_record_init(&r);
+	r.time_us = 1000000ULL * (1000 + n * 10);
+	r.success = n & 1;
+	r.direction = MATCH_DIR_OUT;
+	r.match_count = 1;
+	snprintf(r.id, sizeof(r.id), "%08xabcdef", n);
+
+	snprintf(name, sizeof(name), "{\"n\": %d}", n);
+	meta = strdup(name);
+	ret = catcierge_archive_record_add_data(&r, CATCIERGE_ARCHIVE_META,
+			"event.json", (unsigned char *)meta, strlen(meta));
+
+	img = cvCreateImage(cvSize(16, 8), IPL_DEPTH_8U, 1);
+	memset(img->imageData, n, img->widthStep * img->height);
+	snprintf(name, sizeof(name), "match__%d.qoi", n);
+	ret |= catcierge_archive_record_add_image(&r, CATCIERGE_ARCHIVE_MATCH, name, img, 0, 0);
+	ret |= catcierge_archive_record_encode(&r, CATCIERGE_IMAGE_QOI, DEFAULT_PNG_COMPRESSION);
+	ret |= catcierge_archive_append(a, &r);
+	catcierge_archive_record_free(&r);
+
+	return ret;
+}
+
+static char *run_write_read_test()
+{
+	catcierge_archive_t a;
+	catcierge_archive_reader_t rd;
+	catcierge_archive_record_t r;
+	catcierge_archive_index_entry_t e;
+	IplImage *img;
+	int i;
+
+	remove_archive();
+
+	mu_assert("Expected archive open to succeed", !catcierge_archive_open(&a, TEST_ARCHIVE));
+
+	for (i = 0; i < 5; i++)
+	{
+		mu_assert("Expected append to succeed", !add_record(&a, i));
+	}
+
+	mu_assert("Expected 5 records", a.record_count == 5);
+	catcierge_archive_close(&a);
+
+	// Appending to an existing archive.
+	mu_assert("Expected archive reopen to succeed", !catcierge_archive_open(&a, TEST_ARCHIVE));
+	mu_assert("Expected 5 records after reopen", a.record_count == 5);
+	mu_assert("Expected append to succeed", !add_record(&a, 5));
+	catcierge_archive_close(&a);
+
+	mu_assert("Expected reader open to succeed", !catcierge_archive_reader_open(&rd, TEST_ARCHIVE));
+	mu_assert("Expected 6 records", rd.count == 6);
+
+	catcierge_archive_reader_get(&rd, 3, &e);
+	catcierge_test_STATUS("Record 3: time %llu offset %llu size %u id %s",
+		(unsigned long long)e.time_us, (unsigned long long)e.offset, e.size, e.id);
+	mu_assert("Expected record 3 time", e.time_us == 1030000000ULL);
+	mu_assert("Expected record 3 success", e.success == 1);
+	mu_assert("Expected record 3 direction", e.direction == MATCH_DIR_OUT);
+
+	mu_assert("Expected time lookup of exact time",
+		catcierge_archive_reader_find_time(&rd, 1020000000ULL) == 2);
+	mu_assert("Expected time lookup between records",
+		catcierge_archive_reader_find_time(&rd, 1020000001ULL) == 3);
+	mu_assert("Expected time lookup after the last record",
+		catcierge_archive_reader_find_time(&rd, 2000000000ULL) == 6);
+	mu_assert("Expected id lookup",
+		catcierge_archive_reader_find_id(&rd, "00000004") == 4);
+	mu_assert("Expected id lookup to fail",
+		catcierge_archive_reader_find_id(&rd, "ffff") == -1);
+
+	mu_assert("Expected read to succeed", !catcierge_archive_reader_read(&rd, 4, &r));
+	mu_assert("Expected 2 entries", r.entry_count == 2);
+	mu_assert("Expected meta entry", (r.entries[0].type == CATCIERGE_ARCHIVE_META)
+		&& !strncmp((char *)r.entries[0].data, "{\"n\": 4}", r.entries[0].data_len));
+	mu_assert("Expected match entry", (r.entries[1].type == CATCIERGE_ARCHIVE_MATCH)
+		&& !strcmp(r.entries[1].name, "match__4.qoi")
+		&& (r.entries[1].format == CATCIERGE_IMAGE_QOI));
+
+	img = catcierge_image_decode(r.entries[1].data, r.entries[1].data_len);
+	mu_assert("Expected image to decode", img && (img->width == 16) && (img->height == 8));
+	mu_assert("Expected image contents", (unsigned char)img->imageData[0] == 4);
+	cvReleaseImage(&img);
+
+	catcierge_archive_record_free(&r);
+	catcierge_archive_reader_close(&rd);
+
+	return NULL;
+}
+
+static char *run_repair_test()
+{
+	catcierge_archive_t a;
+	catcierge_archive_reader_t rd;
+	FILE *f;
+	long size;
+
+	// A record that was only partly written.
+	f = fopen(TEST_ARCHIVE, "ab");
+	mu_assert("Expected to open archive", f);
+	fwrite("CCRG\xff\x00\x00\x00garbage", 1, 15, f);
+	fclose(f);
+
+	// Readers ignore it.
+	mu_assert("Expected reader open to succeed", !catcierge_archive_reader_open(&rd, TEST_ARCHIVE));
+	mu_assert("Expected 6 records", rd.count == 6);
+	catcierge_archive_reader_close(&rd);
+
+	// The writer cuts it off.
+	mu_assert("Expected archive open to succeed", !catcierge_archive_open(&a, TEST_ARCHIVE));
+	mu_assert("Expected 6 records", a.record_count == 6);
+	mu_assert("Expected append to succeed", !add_record(&a, 6));
+	catcierge_archive_close(&a);
+
+	// Lose the index, and the index entry of the last record.
+	remove(TEST_ARCHIVE_INDEX);
+	mu_assert("Expected reader open without index to succeed",
+		!catcierge_archive_reader_open(&rd, TEST_ARCHIVE));
+	mu_assert("Expected 7 records scanned", rd.count == 7);
+	catcierge_archive_reader_close(&rd);
+
+	mu_assert("Expected index rebuild to succeed", !catcierge_archive_rebuild_index(TEST_ARCHIVE));
+	f = fopen(TEST_ARCHIVE_INDEX, "rb");
+	mu_assert("Expected index to exist", f);
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fclose(f);
+	mu_assert("Expected index with 7 entries", size == (CATCIERGE_ARCHIVE_INDEX_HEADER_SIZE
+		+ 7 * CATCIERGE_ARCHIVE_INDEX_ENTRY_SIZE));
+
+	// Not an archive.
+	f = fopen(TEST_ARCHIVE, "wb");
+	fwrite("nope", 1, 4, f);
+	fclose(f);
+	mu_assert("Expected archive open to fail", catcierge_archive_open(&a, TEST_ARCHIVE));
+	mu_assert("Expected reader open to fail", catcierge_archive_reader_open(&rd, TEST_ARCHIVE));
+
+	remove_archive();
+
+	return NULL;
+}
+
+int TEST_catcierge_archive(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_write_read_test()),
+		"Archive write and read",
+		"", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_repair_test()),
+		"Archive repair",
+		"", &ret);
+
+	return ret;
+}
@@ -0,0 +1,91 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "catcierge_arena.h"
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+
+static char *run_arena_alloc_tests()
+{
+	catcierge_arena_t arena;
+	char *a = NULL;
+	char *b = NULL;
+	char *s = NULL;
+
+	catcierge_arena_init(&arena, 64);
+
+	mu_assert("Expected allocation to succeed", (a = catcierge_arena_alloc(&arena, 10)));
+	mu_assert("Expected allocation to succeed", (b = catcierge_arena_alloc(&arena, 10)));
+	mu_assert("Expected aligned allocations", (((size_t)a & 15) == 0) && (((size_t)b & 15) == 0));
+	mu_assert("Expected allocations to not overlap", (b - a) >= 10);
+	mu_assert("Expected 1 block", arena.block_alloc_count == 1);
+
+	// Bigger than the block size.
+	mu_assert("Expected big allocation to succeed", catcierge_arena_alloc(&arena, 1000));
+	mu_assert("Expected 2 blocks", arena.block_alloc_count == 2);
+	mu_assert("Expected 3 allocations", arena.alloc_count == 3);
+
+	mu_assert("Expected strndup to succeed", (s = catcierge_arena_strndup(&arena, "abcdef", 3)));
+	mu_assert("Expected 'abc'", !strcmp(s, "abc"));
+	mu_assert("Expected strdup to succeed", (s = catcierge_arena_strdup(&arena, "hello")));
+	mu_assert("Expected 'hello'", !strcmp(s, "hello"));
+
+	// The blocks are merged into one on reset.
+	catcierge_arena_reset(&arena);
+	catcierge_test_STATUS("Block size after reset: %d", (int)arena.blocks->size);
+	mu_assert("Expected a single block after reset", arena.blocks && !arena.blocks->next);
+	mu_assert("Expected merged block", arena.blocks->size >= 1064);
+	mu_assert("Expected 0 allocations after reset", arena.alloc_count == 0);
+
+	mu_assert("Expected allocation to succeed", catcierge_arena_alloc(&arena, 1000));
+	mu_assert("Expected no new blocks after reset", arena.block_alloc_count == 0);
+
+	catcierge_arena_destroy(&arena);
+	mu_assert("Expected no blocks after destroy", arena.blocks == NULL);
+
+	return NULL;
+}
+
+static char *run_arena_realloc_tests()
+{
+	catcierge_arena_t arena;
+	char *a = NULL;
+	char *b = NULL;
+
+	// Zeroed arena uses the default block size.
+	memset(&arena, 0, sizeof(arena));
+
+	mu_assert("Expected allocation to succeed", (a = catcierge_arena_alloc(&arena, 4)));
+	strcpy(a, "abc");
+
+	// The latest allocation grows in place.
+	mu_assert("Expected realloc to succeed", (b = catcierge_arena_realloc(&arena, a, 4, 100)));
+	mu_assert("Expected in place realloc", a == b);
+
+	mu_assert("Expected allocation to succeed", catcierge_arena_alloc(&arena, 4));
+
+	// Not the latest allocation so it has to move.
+	mu_assert("Expected realloc to succeed", (b = catcierge_arena_realloc(&arena, a, 100, 200)));
+	mu_assert("Expected moved realloc", a != b);
+	mu_assert("Expected contents to be copied", !strcmp(b, "abc"));
+
+	catcierge_arena_destroy(&arena);
+
+	return NULL;
+}
+
+int TEST_catcierge_arena(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_arena_alloc_tests()),
+		"Arena allocations",
+		"", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_arena_realloc_tests()),
+		"Arena realloc",
+		"", &ret);
+
+	return ret;
+}
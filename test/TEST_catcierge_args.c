@@ -231,6 +231,14 @@ static char *run_catcierge_parse_test()
 	mu_assert("Expected zmq_transport == inproc",
 		args.zmq_transport && !strcmp(args.zmq_transport, "inproc"));
 	PARSE_ARGV_END();
+
+	PARSE_ARGV_START(0, &args, "catcierge", "--haar", "--zmq_hwm", "4");
+	mu_assert("Expected zmq_hwm == 4", args.zmq_hwm == 4);
+	PARSE_ARGV_END();
+
+	PARSE_ARGV_START(0, &args, "catcierge", "--haar", "--zmq_images", "png");
+	mu_assert("Expected zmq_images == png", args.zmq_images == CATCIERGE_ZMQ_IMAGES_PNG);
+	PARSE_ARGV_END();
 	#endif // WITH_ZMQ
 
 	PARSE_ARGV_START(0, &args, "catcierge", "--haar", "--lockout", "5");
@@ -500,6 +508,71 @@ static char *run_catcierge_parse_test()
 		PARSE_ARGV_END();
 	}
 
+	PARSE_ARGV_START(0, &args, "catcierge", "--haar", "--streaming", "--stream_window", "2");
+	mu_assert("Expected stream_window == 2",
+		args.streaming && (args.stream_window == 2));
+	PARSE_ARGV_END();
+	PARSE_ARGV_START(1, &args, "catcierge", "--haar", "--streaming",
+		"--stream_window", "1", "--ok_matches_needed", "2");
+	PARSE_ARGV_END();
+
+	#ifdef WITH_DNN
+	{
+		PARSE_ARGV_START(0, &args, "catcierge", "--dnn", "--dnn_model", "/some/model.onnx");
+		mu_assert("Expected dnn matcher", args.matcher_type == MATCHER_DNN);
+		mu_assert("Expected dnn_model == /some/model.onnx",
+			args.dnn.model && !strcmp(args.dnn.model, "/some/model.onnx"));
+		mu_assert("Expected batching by default", args.dnn.no_batch == 0);
+		PARSE_ARGV_END();
+
+		PARSE_ARGV_START(0, &args, "catcierge", "--dnn", "--dnn_input_size", "64x48");
+		mu_assert("Expected valid input size",
+			(args.dnn.width == 64) && (args.dnn.height == 48));
+		PARSE_ARGV_END();
+		PARSE_ARGV_START(1, &args, "catcierge", "--dnn", "--dnn_input_size", "64");
+		PARSE_ARGV_END();
+		PARSE_ARGV_START(1, &args, "catcierge", "--dnn", "--dnn_input_size", "0x48");
+		PARSE_ARGV_END();
+		PARSE_ARGV_START(1, &args, "catcierge", "--dnn", "--dnn_input_size");
+		PARSE_ARGV_END();
+
+		PARSE_ARGV_START(0, &args, "catcierge", "--dnn", "--dnn_channels", "3");
+		mu_assert("Expected dnn_channels == 3", args.dnn.channels == 3);
+		PARSE_ARGV_END();
+		PARSE_ARGV_START(1, &args, "catcierge", "--dnn", "--dnn_channels", "4");
+		PARSE_ARGV_END();
+
+		PARSE_ARGV_START(0, &args, "catcierge", "--dnn", "--dnn_precision", "FP16");
+		mu_assert("Expected dnn_precision == FP16",
+			args.dnn.precision == DNN_PRECISION_FP16);
+		PARSE_ARGV_END();
+		PARSE_ARGV_START(0, &args, "catcierge", "--dnn", "--dnn_precision", "int8");
+		mu_assert("Expected dnn_precision == INT8",
+			args.dnn.precision == DNN_PRECISION_INT8);
+		PARSE_ARGV_END();
+		PARSE_ARGV_START(1, &args, "catcierge", "--dnn", "--dnn_precision", "fp64");
+		PARSE_ARGV_END();
+
+		PARSE_ARGV_START(0, &args, "catcierge", "--dnn",
+			"--dnn_prey_threshold", "0.25", "--dnn_head_threshold", "0.75");
+		mu_assert("Expected dnn_prey_threshold == 0.25", args.dnn.prey_threshold == 0.25);
+		mu_assert("Expected dnn_head_threshold == 0.75", args.dnn.head_threshold == 0.75);
+		PARSE_ARGV_END();
+
+		PARSE_ARGV_START(0, &args, "catcierge", "--dnn", "--dnn_no_batch");
+		mu_assert("Expected dnn_no_batch == 1", args.dnn.no_batch == 1);
+		PARSE_ARGV_END();
+
+		// Streaming needs every result right away.
+		PARSE_ARGV_START(0, &args, "catcierge", "--dnn", "--streaming");
+		mu_assert("Expected batching to be turned off when streaming",
+			args.dnn.no_batch == 1);
+		PARSE_ARGV_END();
+	}
+	#else
+	catcierge_test_SKIPPED("Skipping DNN args (not compiled)");
+	#endif // WITH_DNN
+
 	PARSE_ARGV_START(1, &args, "catcierge", "--cmdhelp");
 	PARSE_ARGV_END();
 
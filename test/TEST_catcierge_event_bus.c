@@ -0,0 +1,233 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+#include "catcierge_args.h"
+#include "catcierge_fsm.h"
+#include "catcierge_output.h"
+#include "catcierge_event_bus.h"
+
+#define TEST_TEMPLATE_PATH "event_bus_template"
+#define TEST_OUTPUT_PATH "event_bus_output.txt"
+
+//
+// A matcher with a single variable, to check that the worker
+// gets the value it had when the event was posted.
+//
+typedef struct stub_matcher_s
+{
+	catcierge_matcher_t super;
+	int value;
+} stub_matcher_t;
+
+static const char *stub_var_name(catcierge_matcher_t *octx,
+		size_t idx, char *buf, size_t bufsize)
+{
+	return (idx == 0) ? "stub_value" : NULL;
+}
+
+static const char *stub_translate(catcierge_matcher_t *octx,
+		const char *var, char *buf, size_t bufsize)
+{
+	stub_matcher_t *ctx = (stub_matcher_t *)octx;
+
+	if (strcmp(var, "stub_value"))
+		return NULL;
+
+	snprintf(buf, bufsize - 1, "%d", ctx->value);
+	return buf;
+}
+
+static int setup_grabber_template(catcierge_grb_t *grb, const char *template)
+{
+	catcierge_args_t *args = &grb->args;
+	FILE *f;
+
+	catcierge_grabber_init(grb);
+
+	if (catcierge_args_init(args, "catcierge"))
+		return -1;
+
+	if (!(f = fopen(TEST_TEMPLATE_PATH, "w")))
+		return -1;
+
+	fprintf(f, "%%!event *\n"
+		"%%!filename " TEST_OUTPUT_PATH "\n"
+		"%s", template);
+	fclose(f);
+
+	args->inputs = calloc(1, sizeof(char *));
+	args->inputs[0] = strdup(TEST_TEMPLATE_PATH);
+	args->input_count = 1;
+
+	if (catcierge_output_init(grb, &grb->output))
+		return -1;
+
+	if (catcierge_output_load_templates(&grb->output,
+			args->inputs, args->input_count))
+		return -1;
+
+	return 0;
+}
+
+static int setup_grabber(catcierge_grb_t *grb)
+{
+	return setup_grabber_template(grb, "%state%");
+}
+
+static void destroy_grabber(catcierge_grb_t *grb)
+{
+	catcierge_event_bus_destroy(&grb->event_bus);
+	catcierge_output_destroy(&grb->output);
+	catcierge_args_destroy(&grb->args);
+	remove(TEST_TEMPLATE_PATH);
+	remove(TEST_OUTPUT_PATH);
+}
+
+static char *run_snapshot_test()
+{
+	catcierge_grb_t grb;
+	char contents[256];
+	size_t len;
+	FILE *f;
+
+	mu_assert("Failed to setup grabber", !setup_grabber(&grb));
+	mu_assert("Expected event bus init to succeed",
+		!catcierge_event_bus_init(&grb.event_bus, &grb, 4, 100));
+
+	// The event should be rendered with the state it had when it was posted.
+	grb.state = catcierge_state_waiting;
+	mu_assert("Expected post to succeed",
+		!catcierge_event_bus_post(&grb.event_bus, &grb, CATCIERGE_STATE_CHANGE, NULL, 0));
+	grb.state = catcierge_state_lockout;
+
+	// Drains the queue.
+	catcierge_event_bus_destroy(&grb.event_bus);
+	mu_assert("Expected 1 processed event", grb.event_bus.processed_count == 1);
+	mu_assert("Expected the generated path to be unset in the FSM context",
+		grb.output.templates[0].generated_path == NULL);
+
+	mu_assert("Expected output file", (f = fopen(TEST_OUTPUT_PATH, "r")));
+	len = fread(contents, 1, sizeof(contents) - 1, f);
+	contents[len] = '\0';
+	fclose(f);
+
+	catcierge_test_STATUS("Output: \"%s\"", contents);
+	mu_assert("Expected the snapshot state", !strcmp(contents, "Waiting"));
+
+	destroy_grabber(&grb);
+
+	return NULL;
+}
+
+static char *run_matcher_snapshot_test()
+{
+	catcierge_grb_t grb;
+	stub_matcher_t ctx;
+	char contents[256];
+	size_t len;
+	FILE *f;
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.super.name = "Stub";
+	ctx.super.short_name = "stub";
+	ctx.super.translate = stub_translate;
+	ctx.super.var_name = stub_var_name;
+
+	mu_assert("Failed to setup grabber",
+		!setup_grabber_template(&grb, "%matcher% %stub_value%"));
+	grb.matcher = &ctx.super;
+
+	mu_assert("Expected event bus init to succeed",
+		!catcierge_event_bus_init(&grb.event_bus, &grb, 4, 100));
+
+	// The worker must not call the matcher, it may be in the middle of a match.
+	ctx.value = 1;
+	mu_assert("Expected post to succeed",
+		!catcierge_event_bus_post(&grb.event_bus, &grb, CATCIERGE_MATCH_DONE, NULL, 0));
+	ctx.value = 2;
+	ctx.super.translate = NULL;
+
+	catcierge_event_bus_destroy(&grb.event_bus);
+	mu_assert("Expected 1 processed event", grb.event_bus.processed_count == 1);
+
+	mu_assert("Expected output file", (f = fopen(TEST_OUTPUT_PATH, "r")));
+	len = fread(contents, 1, sizeof(contents) - 1, f);
+	contents[len] = '\0';
+	fclose(f);
+
+	catcierge_test_STATUS("Output: \"%s\"", contents);
+	mu_assert("Expected the snapshot matcher variables", !strcmp(contents, "stub 1"));
+
+	// The stub matcher lives on the stack.
+	grb.matcher = NULL;
+	destroy_grabber(&grb);
+
+	return NULL;
+}
+
+static char *run_drop_test()
+{
+	catcierge_grb_t grb;
+	catcierge_event_bus_t *bus = &grb.event_bus;
+	int i;
+	int dropped = 0;
+
+	mu_assert("Failed to setup grabber", !setup_grabber(&grb));
+
+	mu_assert("Expected zero sized queue to fail",
+		catcierge_event_bus_init(bus, &grb, 0, 0));
+	mu_assert("Expected too large queue to fail",
+		catcierge_event_bus_init(bus, &grb, CATCIERGE_EVENT_QUEUE_MAX_SIZE + 1, 0));
+
+	// No waiting for room, so anything that doesn't fit is dropped.
+	mu_assert("Expected event bus init to succeed",
+		!catcierge_event_bus_init(bus, &grb, 1, 0));
+
+	for (i = 0; i < 20; i++)
+	{
+		if (catcierge_event_bus_post(bus, &grb, CATCIERGE_FRAME_OBSTRUCTED, NULL, 0))
+			dropped++;
+	}
+
+	catcierge_event_bus_destroy(bus);
+
+	catcierge_test_STATUS("%lu posted, %lu dropped, %lu processed",
+		bus->posted_count, bus->dropped_count, bus->processed_count);
+	mu_assert("Expected all events to be accounted for",
+		(bus->posted_count + bus->dropped_count) == 20);
+	mu_assert("Expected the dropped count to match",
+		bus->dropped_count == (unsigned long)dropped);
+	mu_assert("Expected all posted events to be processed",
+		bus->processed_count == bus->posted_count);
+	mu_assert("Expected at most 1 queued event", bus->max_count <= 1);
+
+	destroy_grabber(&grb);
+
+	return NULL;
+}
+
+int TEST_catcierge_event_bus(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	CATCIERGE_RUN_TEST((e = run_snapshot_test()),
+		"Event bus snapshot",
+		"", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_matcher_snapshot_test()),
+		"Event bus matcher snapshot",
+		"", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_drop_test()),
+		"Event bus drops",
+		"", &ret);
+	#else
+	catcierge_test_SKIPPED("Event bus needs pthreads, skipping tests");
+	#endif
+
+	return ret;
+}
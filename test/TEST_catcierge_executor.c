@@ -0,0 +1,91 @@
+#include <catcierge_config.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "catcierge_executor.h"
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+
+#ifndef _WIN32
+static char *run_exit_status_tests()
+{
+	catcierge_executor_t e;
+	catcierge_exec_stats_t *s;
+
+	mu_assert("Expected invalid max running to fail", catcierge_executor_init(&e, 0, 0));
+	mu_assert("Expected executor init to succeed", !catcierge_executor_init(&e, 2, 2));
+
+	mu_assert("Expected run to succeed", !catcierge_executor_run(&e, "ok", "exit 0", 0));
+	mu_assert("Expected run to succeed", !catcierge_executor_run(&e, "fail", "exit 3", 0));
+	mu_assert("Expected commands to finish", !catcierge_executor_wait(&e, 5.0));
+
+	mu_assert("Expected stats for ok", (s = catcierge_executor_get_stats(&e, "ok")));
+	mu_assert("Expected 1 successful run", (s->runs == 1) && (s->failures == 0));
+	mu_assert("Expected exit status 0", s->last_exit_status == 0);
+
+	mu_assert("Expected stats for fail", (s = catcierge_executor_get_stats(&e, "fail")));
+	mu_assert("Expected 1 failed run", (s->runs == 1) && (s->failures == 1));
+	mu_assert("Expected exit status 3", s->last_exit_status == 3);
+	mu_assert("Expected a runtime", s->last_runtime >= 0.0);
+
+	mu_assert("Expected no stats for unknown event", !catcierge_executor_get_stats(&e, "abc"));
+
+	catcierge_executor_destroy(&e);
+
+	return NULL;
+}
+
+static char *run_queue_tests()
+{
+	catcierge_executor_t e;
+	catcierge_exec_stats_t *s;
+
+	mu_assert("Expected executor init to succeed", !catcierge_executor_init(&e, 1, 2));
+
+	mu_assert("Expected run to succeed", !catcierge_executor_run(&e, "q", "sleep 0.2", 0));
+	mu_assert("Expected run to be queued", !catcierge_executor_run(&e, "q", "sleep 0.1", 0));
+	mu_assert("Expected run to be queued", !catcierge_executor_run(&e, "q", "exit 0", 0));
+	catcierge_test_STATUS("Running %d, queued %d", e.running_count, e.queued_count);
+	mu_assert("Expected 1 running", e.running_count == 1);
+	mu_assert("Expected 2 queued", e.queued_count == 2);
+
+	// The queue is full.
+	mu_assert("Expected run to be dropped", catcierge_executor_run(&e, "q", "exit 0", 0));
+	mu_assert("Expected 1 dropped", e.dropped_count == 1);
+
+	// Immediate commands are not queued.
+	mu_assert("Expected immediate run to succeed",
+		!catcierge_executor_run(&e, "now", "exit 0", CATCIERGE_EXEC_IMMEDIATE));
+	mu_assert("Expected 2 running", e.running_count == 2);
+
+	mu_assert("Expected commands to finish", !catcierge_executor_wait(&e, 5.0));
+	mu_assert("Expected nothing running", (e.running_count == 0) && (e.queued_count == 0));
+
+	mu_assert("Expected stats", (s = catcierge_executor_get_stats(&e, "q")));
+	mu_assert("Expected 3 runs", s->runs == 3);
+
+	catcierge_executor_destroy(&e);
+
+	return NULL;
+}
+#endif // !_WIN32
+
+int TEST_catcierge_executor(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	#ifndef _WIN32
+	CATCIERGE_RUN_TEST((e = run_exit_status_tests()),
+		"Executor exit status",
+		"", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_queue_tests()),
+		"Executor queue",
+		"", &ret);
+	#else
+	catcierge_test_SKIPPED("Executor tests not supported on Windows!\n");
+	#endif
+
+	return ret;
+}
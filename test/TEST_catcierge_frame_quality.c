@@ -0,0 +1,80 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "catcierge_frame_quality.h"
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+
+// Checkerboard with sharp edges.
+static IplImage *create_sharp_image(int brightness)
+{
+	int x;
+	int y;
+	IplImage *img = cvCreateImage(cvSize(320, 240), IPL_DEPTH_8U, 3);
+	cvSet(img, CV_RGB(0, 0, 0), NULL);
+
+	for (y = 0; y < img->height; y += 20)
+	{
+		for (x = ((y / 20) % 2) * 20; x < img->width; x += 40)
+		{
+			cvRectangle(img, cvPoint(x, y), cvPoint(x + 19, y + 19),
+				CV_RGB(brightness, brightness, brightness), CV_FILLED, 8, 0);
+		}
+	}
+
+	return img;
+}
+
+static char *run_score_tests()
+{
+	catcierge_frame_burst_t b;
+	catcierge_frame_score_t sharp;
+	catcierge_frame_score_t blurry;
+	catcierge_frame_score_t dark;
+	IplImage *sharp_img = create_sharp_image(255);
+	IplImage *blurry_img = cvCloneImage(sharp_img);
+	IplImage *dark_img = create_sharp_image(20);
+
+	cvSmooth(sharp_img, blurry_img, CV_BLUR, 15, 15, 0, 0);
+
+	mu_assert("Expected burst init to succeed", !catcierge_frame_burst_init(&b, 3));
+	mu_assert("Expected scoring to succeed", !catcierge_frame_quality_score(&b, sharp_img, &sharp));
+	mu_assert("Expected scoring to succeed", !catcierge_frame_quality_score(&b, blurry_img, &blurry));
+	mu_assert("Expected scoring to succeed", !catcierge_frame_quality_score(&b, dark_img, &dark));
+
+	catcierge_test_STATUS("Sharp: %f (%f, %f)", sharp.score, sharp.sharpness, sharp.exposure);
+	catcierge_test_STATUS("Blurry: %f (%f, %f)", blurry.score, blurry.sharpness, blurry.exposure);
+	catcierge_test_STATUS("Dark: %f (%f, %f)", dark.score, dark.sharpness, dark.exposure);
+
+	mu_assert("Expected blurry image to be less sharp", blurry.sharpness < sharp.sharpness);
+	mu_assert("Expected dark image to be less exposed", dark.exposure < sharp.exposure);
+	mu_assert("Expected sharp image to score best",
+		(sharp.score > blurry.score) && (sharp.score > dark.score));
+
+	// The sharp frame in the middle of the burst should be picked.
+	catcierge_frame_burst_reset(&b);
+	mu_assert("Expected more frames needed", catcierge_frame_burst_add(&b, blurry_img) == 0);
+	mu_assert("Expected more frames needed", catcierge_frame_burst_add(&b, sharp_img) == 0);
+	mu_assert("Expected burst to be done", catcierge_frame_burst_add(&b, dark_img) == 1);
+	mu_assert("Expected second frame to be picked", b.best_index == 1);
+	mu_assert("Expected best score to be the sharp frame", b.best_score.score == sharp.score);
+
+	catcierge_frame_burst_destroy(&b);
+	cvReleaseImage(&sharp_img);
+	cvReleaseImage(&blurry_img);
+	cvReleaseImage(&dark_img);
+
+	return NULL;
+}
+
+int TEST_catcierge_frame_quality(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_score_tests()),
+		"Frame quality scoring",
+		"", &ret);
+
+	return ret;
+}
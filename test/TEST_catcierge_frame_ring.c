@@ -0,0 +1,137 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+#include "catcierge_frame_ring.h"
+#include "catcierge_util.h"
+#ifdef CATCIERGE_HAVE_FRAME_RING
+#include <unistd.h>
+#endif
+
+static char *run_settings_tests()
+{
+	catcierge_frame_ring_t r;
+
+	#ifdef CATCIERGE_HAVE_FRAME_RING
+	mu_assert("Expected struct sizes to match the documented layout",
+		(sizeof(catcierge_frame_ring_header_t) == 64)
+		&& (sizeof(catcierge_frame_ring_slot_t) == 64));
+	#endif
+
+	mu_assert("Expected name without slash to fail",
+		catcierge_frame_ring_init(&r, "catcierge", DEFAULT_FRAME_RING_SLOTS));
+	mu_assert("Expected name with two slashes to fail",
+		catcierge_frame_ring_init(&r, "/cat/cierge", DEFAULT_FRAME_RING_SLOTS));
+	mu_assert("Expected 1 slot to fail",
+		catcierge_frame_ring_init(&r, "/catcierge", 1));
+
+	return NULL;
+}
+
+#ifdef CATCIERGE_HAVE_FRAME_RING
+
+static char *run_ring_test()
+{
+	catcierge_frame_ring_t w;
+	catcierge_frame_ring_t r;
+	catcierge_frame_info_t info;
+	catcierge_frame_ring_slot_t *slot;
+	IplImage *img = catcierge_test_create_image(40, 30, 1, 0);
+	IplImage *big = catcierge_test_create_image(80, 60, 1, 0);
+	unsigned char buf[40 * 30];
+	char name[64];
+	struct timeval tv;
+	int i;
+
+	snprintf(name, sizeof(name), "/catcierge_test_%d", (int)getpid());
+
+	mu_assert("Expected writer to init", !catcierge_frame_ring_init(&w, name, 4));
+	mu_assert("Expected no ring before the first frame",
+		catcierge_frame_ring_open(&r, name));
+
+	for (i = 1; i <= 6; i++)
+	{
+		cvSet(img, cvScalarAll(i), NULL);
+		tv.tv_sec = 1000 + i;
+		tv.tv_usec = i;
+		mu_assert("Expected frame to be written",
+			!catcierge_frame_ring_write(&w, img, &tv));
+	}
+
+	mu_assert("Expected reader to open", !catcierge_frame_ring_open(&r, name));
+	mu_assert("Expected 4 slots", r.slot_count == 4);
+	mu_assert("Expected latest frame 6", catcierge_frame_ring_latest(&r) == 6);
+
+	mu_assert("Expected latest frame to be read",
+		!catcierge_frame_ring_read(&r, 6, buf, sizeof(buf), &info));
+	catcierge_test_STATUS("Frame %d: %dx%dx%d stride %d, %d bytes",
+		(int)info.frame_seq, info.width, info.height, info.channels,
+		info.stride, (int)info.size);
+	mu_assert("Expected frame info", (info.frame_seq == 6)
+		&& (info.width == 40) && (info.height == 30) && (info.channels == 1)
+		&& (info.stride == img->widthStep) && (info.size == (size_t)img->imageSize));
+	mu_assert("Expected capture time", (info.tv.tv_sec == 1006) && (info.tv.tv_usec == 6));
+	mu_assert("Expected pixels", (buf[0] == 6) && (buf[sizeof(buf) - 1] == 6));
+
+	mu_assert("Expected frame 3 to be read",
+		!catcierge_frame_ring_read(&r, 3, buf, sizeof(buf), &info));
+	mu_assert("Expected frame 3 pixels", buf[0] == 3);
+
+	mu_assert("Expected overwritten frame 2 to be detected",
+		catcierge_frame_ring_read(&r, 2, buf, sizeof(buf), &info) == 1);
+	mu_assert("Expected future frame to be missing",
+		catcierge_frame_ring_read(&r, 7, buf, sizeof(buf), &info) == 1);
+	mu_assert("Expected too small buffer to fail",
+		catcierge_frame_ring_read(&r, 6, buf, 10, &info) == -1);
+
+	// A frame being written is not read.
+	slot = (catcierge_frame_ring_slot_t *)(w.map + w.header->header_size
+			+ ((6 - 1) % 4) * w.header->slot_size);
+	slot->lock++;
+	mu_assert("Expected frame being written to be detected",
+		catcierge_frame_ring_read(&r, 6, buf, sizeof(buf), &info) == 1);
+	slot->lock++;
+
+	// Frames larger than the slots are skipped.
+	mu_assert("Expected too large frame to be skipped",
+		catcierge_frame_ring_write(&w, big, &tv));
+	mu_assert("Expected 1 skipped", w.skipped_count == 1);
+	mu_assert("Expected latest frame still 6", catcierge_frame_ring_latest(&r) == 6);
+
+	catcierge_frame_ring_destroy(&w);
+
+	// The reader keeps its mapping after the writer is gone.
+	mu_assert("Expected frame to still be readable",
+		!catcierge_frame_ring_read(&r, 6, buf, sizeof(buf), &info));
+	catcierge_frame_ring_destroy(&r);
+
+	mu_assert("Expected ring to be removed", catcierge_frame_ring_open(&r, name));
+
+	cvReleaseImage(&img);
+	cvReleaseImage(&big);
+
+	return NULL;
+}
+
+#endif // CATCIERGE_HAVE_FRAME_RING
+
+int TEST_catcierge_frame_ring(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_settings_tests()),
+		"Frame ring settings",
+		"", &ret);
+
+	#ifdef CATCIERGE_HAVE_FRAME_RING
+	CATCIERGE_RUN_TEST((e = run_ring_test()),
+		"Frame ring write and read",
+		"", &ret);
+	#else
+	catcierge_test_SKIPPED("Shared memory frame rings are not supported on this platform, skipping tests");
+	#endif
+
+	return ret;
+}
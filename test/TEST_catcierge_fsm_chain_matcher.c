@@ -0,0 +1,182 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "catcierge_config.h"
+#include "catcierge_fsm.h"
+#include "minunit.h"
+#include "catcierge_test_config.h"
+#include "catcierge_test_helpers.h"
+#include "catcierge_args.h"
+#include "catcierge_types.h"
+#include <opencv2/imgproc/imgproc_c.h>
+#include <opencv2/highgui/highgui_c.h>
+#include "catcierge_test_common.h"
+
+static char *init_chain_grabber(catcierge_grb_t *grb, catcierge_chain_gate_t gate)
+{
+	catcierge_args_t *args = &grb->args;
+
+	catcierge_grabber_init(grb);
+	catcierge_args_init_vars(args);
+
+	args->saveimg = 0;
+	args->matcher_type = MATCHER_CHAIN;
+	args->chain.gate = gate;
+	args->chain.main_type = MATCHER_HAAR;
+	args->haar.cascade = strdup(CATCIERGE_CASCADE);
+	mu_assert("Out of memory", args->haar.cascade);
+
+	if (gate == CHAIN_GATE_TEMPLATE)
+	{
+		args->templ.snout_count = 1;
+		args->templ.snout_paths = calloc(1, sizeof(char *));
+		mu_assert("Out of memory", args->templ.snout_paths);
+		args->templ.snout_paths[0] = strdup(CATCIERGE_SNOUT1_PATH);
+		mu_assert("Out of memory", args->templ.snout_paths[0]);
+		args->chain.gate_threshold = 0.0;
+	}
+
+	if (catcierge_matcher_init(&grb->matcher, catcierge_get_matcher_args(args)))
+	{
+		return "Failed to init catcierge lib!\n";
+	}
+
+	catcierge_chain_matcher_print_settings(&args->chain);
+
+	grb->running = 1;
+	catcierge_set_state(grb, catcierge_state_waiting);
+
+	return NULL;
+}
+
+static char *run_series_tests(catcierge_chain_gate_t gate)
+{
+	int i;
+	int j;
+	char *e = NULL;
+	catcierge_grb_t grb;
+	catcierge_args_t *args = &grb.args;
+
+	if ((e = init_chain_grabber(&grb, gate)))
+		return e;
+
+	args->lockout_method = OBSTRUCT_OR_TIMER_3;
+
+	for (j = 6; j <= 14; j++)
+	{
+		catcierge_test_STATUS("Test series %d", j);
+
+		// Same settings as the plain haar matcher tests.
+		args->ok_matches_needed = (j <= 9) ? DEFAULT_OK_MATCHES_NEEDED : 3;
+
+		load_test_image_and_run(&grb, j, 1);
+		mu_assert("Expected MATCHING state", (grb.state == catcierge_state_matching));
+
+		for (i = 1; i <= 4; i++)
+		{
+			load_test_image_and_run(&grb, j, i);
+		}
+
+		// Series 6-9 are cats without prey, 10-14 cats with prey.
+		if (j <= 9)
+		{
+			mu_assert("Expected KEEP OPEN state", (grb.state == catcierge_state_keepopen));
+		}
+		else
+		{
+			mu_assert("Expected LOCKOUT state", (grb.state == catcierge_state_lockout));
+		}
+
+		load_test_image_and_run(&grb, 1, 5);
+		mu_assert("Expected WAITING state", (grb.state == catcierge_state_waiting));
+	}
+
+	catcierge_matcher_destroy(&grb.matcher);
+	catcierge_args_destroy_vars(args);
+	catcierge_grabber_destroy(&grb);
+
+	return NULL;
+}
+
+static char *run_gate_skip_tests()
+{
+	int i;
+	char *e = NULL;
+	char buf[256];
+	const char *val;
+	catcierge_grb_t grb;
+	catcierge_args_t *args = &grb.args;
+	catcierge_chain_matcher_t *ctx;
+
+	if ((e = init_chain_grabber(&grb, CHAIN_GATE_OBSTRUCT)))
+		return e;
+
+	ctx = (catcierge_chain_matcher_t *)grb.matcher;
+
+	// Obstruct to start matching, then only clear frames
+	// which the gate should keep from the haar matcher.
+	load_test_image_and_run(&grb, 6, 1);
+	mu_assert("Expected MATCHING state", (grb.state == catcierge_state_matching));
+
+	for (i = 0; i < MATCH_MAX_COUNT; i++)
+	{
+		load_test_image_and_run(&grb, 1, 5);
+		mu_assert("Expected no head result",
+			grb.match_group.matches[i].result.result == HAAR_SUCCESS_NO_HEAD);
+	}
+
+	catcierge_test_STATUS("Gate hits %lu, main hits %lu, main skips %lu",
+		ctx->stages[CHAIN_STAGE_GATE].hits,
+		ctx->stages[CHAIN_STAGE_MAIN].hits,
+		ctx->stages[CHAIN_STAGE_MAIN].skips);
+
+	mu_assert("Expected gate to run on all frames",
+		ctx->stages[CHAIN_STAGE_GATE].hits == MATCH_MAX_COUNT);
+	mu_assert("Expected main matcher to be skipped",
+		ctx->stages[CHAIN_STAGE_MAIN].skips == MATCH_MAX_COUNT);
+	mu_assert("Expected main matcher to never run",
+		ctx->stages[CHAIN_STAGE_MAIN].hits == 0);
+
+	// No head in any image is still a lockout for the haar matcher.
+	mu_assert("Expected LOCKOUT state", (grb.state == catcierge_state_lockout));
+
+	val = grb.matcher->translate(grb.matcher, "chain_main_skips", buf, sizeof(buf));
+	mu_assert("Expected chain_main_skips", val && !strcmp(val, "4"));
+
+	val = grb.matcher->translate(grb.matcher, "cascade", buf, sizeof(buf));
+	mu_assert("Expected main matcher variable", val && !strcmp(val, CATCIERGE_CASCADE));
+
+	catcierge_matcher_destroy(&grb.matcher);
+	catcierge_args_destroy_vars(args);
+	catcierge_grabber_destroy(&grb);
+
+	return NULL;
+}
+
+int TEST_catcierge_fsm_chain_matcher(int argc, char **argv)
+{
+	char *e = NULL;
+	int ret = 0;
+	catcierge_test_HEADLINE("TEST_catcierge_fsm_chain_matcher");
+
+	catcierge_chain_output_print_usage();
+
+	CATCIERGE_RUN_TEST((e = run_series_tests(CHAIN_GATE_OBSTRUCT)),
+		"Run series tests. Obstruct gate",
+		"Series tests with obstruct gate", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_series_tests(CHAIN_GATE_TEMPLATE)),
+		"Run series tests. Template gate",
+		"Series tests with template gate", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_gate_skip_tests()),
+		"Run gate skip tests",
+		"Gate skip tests", &ret);
+
+	if (ret)
+	{
+		catcierge_test_FAILURE("One or more tests failed");
+	}
+
+	return ret;
+}
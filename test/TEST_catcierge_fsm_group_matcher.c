@@ -0,0 +1,388 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "catcierge_config.h"
+#include "catcierge_fsm.h"
+#include "minunit.h"
+#include "catcierge_test_config.h"
+#include "catcierge_test_helpers.h"
+#include "catcierge_args.h"
+#include "catcierge_types.h"
+#include "catcierge_util.h"
+#include <opencv2/imgproc/imgproc_c.h>
+#include <opencv2/highgui/highgui_c.h>
+#include "catcierge_test_common.h"
+
+#define STUB_PENDING 4.0
+
+//
+// A matcher that leaves its results pending until group_match,
+// like the batched DNN matcher, without needing a model.
+//
+typedef struct stub_matcher_s
+{
+	catcierge_matcher_t super;
+	int obstructed;
+	int success;
+	int pending[MATCH_MAX_COUNT];
+	size_t pending_count;
+	int group_match_count;
+	int mismatch_count;
+} stub_matcher_t;
+
+static double stub_match(void *octx, IplImage *img,
+		match_result_t *result, int save_steps)
+{
+	stub_matcher_t *ctx = (stub_matcher_t *)octx;
+
+	result->direction = MATCH_DIR_IN;
+
+	if (ctx->super.group_match && (ctx->pending_count < MATCH_MAX_COUNT))
+	{
+		ctx->pending[ctx->pending_count++] = ctx->success;
+		result->result = STUB_PENDING;
+		result->success = 0;
+		return result->result;
+	}
+
+	result->result = ctx->success ? 1.0 : 0.0;
+	result->success = ctx->success;
+
+	return result->result;
+}
+
+static int stub_group_match(void *octx, match_group_t *mg)
+{
+	stub_matcher_t *ctx = (stub_matcher_t *)octx;
+	match_result_t *result;
+	size_t i;
+
+	ctx->group_match_count++;
+
+	if (ctx->pending_count != mg->match_count)
+	{
+		ctx->mismatch_count++;
+	}
+
+	for (i = 0; (i < ctx->pending_count) && (i < mg->match_count); i++)
+	{
+		result = &mg->matches[i].result;
+		result->result = ctx->pending[i] ? 1.0 : 0.0;
+		result->success = ctx->pending[i];
+	}
+
+	ctx->pending_count = 0;
+
+	return 0;
+}
+
+static int stub_decide(void *octx, match_group_t *mg)
+{
+	return mg->success;
+}
+
+static const char *stub_translate(catcierge_matcher_t *octx,
+		const char *var, char *buf, size_t bufsize)
+{
+	return NULL;
+}
+
+static int stub_is_obstructed(catcierge_matcher_t *octx, const IplImage *img)
+{
+	return ((stub_matcher_t *)octx)->obstructed;
+}
+
+static void stub_matcher_init(stub_matcher_t *ctx, int batched)
+{
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->super.type = MATCHER_HAAR;
+	ctx->super.name = "Stub";
+	ctx->super.short_name = "stub";
+	ctx->super.match = stub_match;
+	ctx->super.decide = stub_decide;
+	ctx->super.group_match = batched ? stub_group_match : NULL;
+	ctx->super.translate = stub_translate;
+	ctx->super.is_obstructed = stub_is_obstructed;
+}
+
+static int run_frame(catcierge_grb_t *grb, stub_matcher_t *ctx,
+		int obstructed, int success)
+{
+	if (!(grb->img = create_clear_image()))
+	{
+		return -1;
+	}
+
+	ctx->obstructed = obstructed;
+	ctx->success = success;
+
+	catcierge_run_state(grb);
+	free_test_image(grb);
+
+	return 0;
+}
+
+static void stub_grabber_init(catcierge_grb_t *grb, stub_matcher_t *ctx, int batched)
+{
+	catcierge_args_t *args = &grb->args;
+
+	catcierge_grabber_init(grb);
+	catcierge_args_init_vars(args);
+
+	args->saveimg = 0;
+	args->matcher_type = MATCHER_HAAR;
+	args->lockout_method = OBSTRUCT_OR_TIMER_3;
+	args->match_time = 0;
+
+	stub_matcher_init(ctx, batched);
+	grb->matcher = &ctx->super;
+
+	grb->running = 1;
+	catcierge_set_state(grb, catcierge_state_waiting);
+}
+
+static void stub_grabber_destroy(catcierge_grb_t *grb)
+{
+	// The stub matcher lives on the stack.
+	grb->matcher = NULL;
+	catcierge_args_destroy_vars(&grb->args);
+	catcierge_grabber_destroy(grb);
+}
+
+static char *run_batched_tests(int success)
+{
+	int i;
+	int j;
+	catcierge_grb_t grb;
+	catcierge_args_t *args = &grb.args;
+	stub_matcher_t ctx;
+	match_state_t *m;
+
+	stub_grabber_init(&grb, &ctx, 1);
+
+	args->saveimg = 1;
+	free(args->output_path);
+	args->output_path = strdup("./test_group_matcher");
+	mu_assert("Out of memory", args->output_path);
+	catcierge_make_path(args->output_path);
+
+	// Run two groups to make sure nothing is left pending in between.
+	for (j = 0; j < 2; j++)
+	{
+		catcierge_test_STATUS("Match group %d", j + 1);
+
+		run_frame(&grb, &ctx, 1, success);
+		mu_assert("Expected MATCHING state", (grb.state == catcierge_state_matching));
+
+		for (i = 0; i < MATCH_MAX_COUNT - 1; i++)
+		{
+			run_frame(&grb, &ctx, 1, success);
+
+			m = &grb.match_group.matches[i];
+			mu_assert("Expected pending result to not be a success", !m->result.success);
+			mu_assert("Expected match image to not be named while pending",
+				m->path.filename[0] == '\0');
+		}
+
+		mu_assert("Expected no group match before the group is complete",
+			ctx.group_match_count == j);
+		mu_assert("Expected a pending frame for each match",
+			ctx.pending_count == (MATCH_MAX_COUNT - 1));
+
+		// The last match completes the group.
+		run_frame(&grb, &ctx, 1, success);
+
+		mu_assert("Expected one group match per group", ctx.group_match_count == (j + 1));
+		mu_assert("Expected as many pending frames as matches", ctx.mismatch_count == 0);
+		mu_assert("Expected pending frames to be released", ctx.pending_count == 0);
+		mu_assert("Expected match count to be restored",
+			grb.match_group.match_count == MATCH_MAX_COUNT);
+
+		for (i = 0; i < MATCH_MAX_COUNT; i++)
+		{
+			m = &grb.match_group.matches[i];
+			catcierge_test_STATUS("%s", m->path.filename);
+
+			mu_assert("Expected the batched result",
+				!!m->result.success == !!success);
+			mu_assert("Expected match image to be named", m->path.filename[0] != '\0');
+			mu_assert("Expected match image name to have the batched result",
+				!strstr(m->path.filename, "match_fail_") == !!success);
+		}
+
+		if (success)
+		{
+			mu_assert("Expected KEEP OPEN state", (grb.state == catcierge_state_keepopen));
+		}
+		else
+		{
+			mu_assert("Expected LOCKOUT state", (grb.state == catcierge_state_lockout));
+		}
+
+		// The frame clears.
+		run_frame(&grb, &ctx, 0, 0);
+		mu_assert("Expected WAITING state", (grb.state == catcierge_state_waiting));
+	}
+
+	stub_grabber_destroy(&grb);
+
+	return NULL;
+}
+
+static char *run_not_batched_tests()
+{
+	catcierge_grb_t grb;
+	catcierge_args_t *args = &grb.args;
+	stub_matcher_t ctx;
+	match_state_t *m;
+
+	stub_grabber_init(&grb, &ctx, 0);
+
+	args->saveimg = 1;
+	args->early_decision = 1;
+	free(args->output_path);
+	args->output_path = strdup("./test_group_matcher");
+	mu_assert("Out of memory", args->output_path);
+	catcierge_make_path(args->output_path);
+
+	run_frame(&grb, &ctx, 1, 1);
+	mu_assert("Expected MATCHING state", (grb.state == catcierge_state_matching));
+
+	// Results are final right away.
+	run_frame(&grb, &ctx, 1, 1);
+	m = &grb.match_group.matches[0];
+	mu_assert("Expected a successful result", m->result.success);
+	mu_assert("Expected match image to be named", m->path.filename[0] != '\0');
+	mu_assert("Expected a successful match image name", !strstr(m->path.filename, "match_fail_"));
+
+	// Two successes out of at most four decides early.
+	run_frame(&grb, &ctx, 1, 1);
+	mu_assert("Expected an early decision", grb.match_group.early_decision);
+	mu_assert("Expected KEEP OPEN state", (grb.state == catcierge_state_keepopen));
+	mu_assert("Expected no group match", ctx.group_match_count == 0);
+
+	stub_grabber_destroy(&grb);
+
+	return NULL;
+}
+
+static char *run_stream_start_tests()
+{
+	catcierge_grb_t grb;
+	catcierge_args_t *args = &grb.args;
+	stub_matcher_t ctx;
+
+	catcierge_test_STATUS("Batching matcher");
+	stub_grabber_init(&grb, &ctx, 1);
+	args->streaming = 1;
+	args->stream_window = MATCH_MAX_COUNT;
+
+	// Streaming can't wait for the group, so this is refused
+	// instead of changing how the matcher works behind its back.
+	run_frame(&grb, &ctx, 1, 1);
+	mu_assert("Expected streaming a batching matcher to stop the grabber", !grb.running);
+	mu_assert("Expected the matcher to be left untouched",
+		ctx.super.group_match == stub_group_match);
+
+	stub_grabber_destroy(&grb);
+
+	catcierge_test_STATUS("Non-batching matcher");
+	stub_grabber_init(&grb, &ctx, 0);
+	args->streaming = 1;
+	args->stream_window = MATCH_MAX_COUNT;
+
+	run_frame(&grb, &ctx, 1, 1);
+	mu_assert("Expected MATCHING state", (grb.state == catcierge_state_matching));
+	mu_assert("Expected the match window to be created",
+		grb.match_window.size == MATCH_MAX_COUNT);
+
+	run_frame(&grb, &ctx, 1, 1);
+	mu_assert("Expected the result in the window right away",
+		(grb.match_window.count == 1) && (grb.match_window.success_count == 1));
+
+	stub_grabber_destroy(&grb);
+
+	return NULL;
+}
+
+static char *run_short_window_tests(int success_count)
+{
+	int i;
+	catcierge_grb_t grb;
+	catcierge_args_t *args = &grb.args;
+	stub_matcher_t ctx;
+
+	stub_grabber_init(&grb, &ctx, 0);
+	args->streaming = 1;
+	args->stream_window = MATCH_MAX_COUNT;
+	args->ok_matches_needed = 2;
+
+	run_frame(&grb, &ctx, 1, 1);
+	mu_assert("Expected MATCHING state", (grb.state == catcierge_state_matching));
+
+	for (i = 0; i < success_count; i++)
+	{
+		run_frame(&grb, &ctx, 1, 1);
+	}
+
+	// The frame clears before the window is full.
+	run_frame(&grb, &ctx, 0, 0);
+	catcierge_test_STATUS("%d of %d in window: %s",
+		(int)grb.match_window.count, (int)grb.match_window.size,
+		grb.match_group.description);
+
+	mu_assert("Expected a window that is not full",
+		grb.match_window.count < grb.match_window.size);
+
+	if (success_count >= args->ok_matches_needed)
+	{
+		mu_assert("Expected KEEP OPEN state", (grb.state == catcierge_state_keepopen));
+	}
+	else
+	{
+		// The threshold must not shrink with the window.
+		mu_assert("Expected LOCKOUT state", (grb.state == catcierge_state_lockout));
+	}
+
+	stub_grabber_destroy(&grb);
+
+	return NULL;
+}
+
+int TEST_catcierge_fsm_group_matcher(int argc, char **argv)
+{
+	char *e = NULL;
+	int ret = 0;
+	catcierge_test_HEADLINE("TEST_catcierge_fsm_group_matcher");
+
+	CATCIERGE_RUN_TEST((e = run_batched_tests(1)),
+		"Run batched success tests",
+		"Batched success tests", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_batched_tests(0)),
+		"Run batched failure tests",
+		"Batched failure tests", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_not_batched_tests()),
+		"Run not batched tests",
+		"Not batched tests", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_stream_start_tests()),
+		"Run stream start tests",
+		"Stream start tests", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_short_window_tests(1)),
+		"Run short window tests. Too few matches",
+		"Short window with too few matches", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_short_window_tests(2)),
+		"Run short window tests. Enough matches",
+		"Short window with enough matches", &ret);
+
+	if (ret)
+	{
+		catcierge_test_FAILURE("One or more tests failed");
+	}
+
+	return ret;
+}
@@ -129,6 +129,153 @@ static char *run_failure_tests(catcierge_haar_prey_method_t prey_method)
 	return NULL;
 }
 
+static char *run_early_decision_tests()
+{
+	int i;
+	int j;
+	int early_count = 0;
+	catcierge_grb_t grb;
+	catcierge_args_t *args = &grb.args;
+
+	catcierge_grabber_init(&grb);
+	catcierge_args_init_vars(args);
+
+	catcierge_haar_matcher_args_init(&args->haar);
+	args->saveimg = 0;
+	args->matcher_type = MATCHER_HAAR;
+	args->lockout_method = OBSTRUCT_OR_TIMER_3;
+	args->early_decision = 1;
+	args->haar.cascade = strdup(CATCIERGE_CASCADE);
+
+	if (catcierge_matcher_init(&grb.matcher, (catcierge_matcher_args_t *)&args->haar))
+	{
+		return "Failed to init catcierge lib!\n";
+	}
+
+	grb.running = 1;
+	catcierge_set_state(&grb, catcierge_state_waiting);
+
+	for (j = 6; j <= 14; j++)
+	{
+		catcierge_test_STATUS("Test series %d", j);
+
+		// Same settings as the success and failure tests above.
+		args->ok_matches_needed = (j <= 9) ? DEFAULT_OK_MATCHES_NEEDED : 3;
+
+		load_test_image_and_run(&grb, j, 1);
+		mu_assert("Expected MATCHING state", (grb.state == catcierge_state_matching));
+
+		// Stop feeding frames as soon as a decision has been made.
+		for (i = 1; (i <= 4) && (grb.state == catcierge_state_matching); i++)
+		{
+			load_test_image_and_run(&grb, j, i);
+		}
+
+		catcierge_test_STATUS("Decided after %d matches (early %d)",
+			(int)grb.match_group.match_count, grb.match_group.early_decision);
+
+		// The outcome must be the same as without early decisions.
+		if (j <= 9)
+		{
+			mu_assert("Expected KEEP OPEN state", (grb.state == catcierge_state_keepopen));
+		}
+		else
+		{
+			mu_assert("Expected LOCKOUT state", (grb.state == catcierge_state_lockout));
+		}
+
+		mu_assert("Expected early decision to be set when fewer matches were made",
+			grb.match_group.early_decision ==
+			(grb.match_group.match_count < MATCH_MAX_COUNT));
+
+		early_count += grb.match_group.early_decision;
+
+		load_test_image_and_run(&grb, 1, 5);
+		mu_assert("Expected WAITING state", (grb.state == catcierge_state_waiting));
+	}
+
+	catcierge_test_STATUS("%d of 9 match groups decided early", early_count);
+
+	catcierge_matcher_destroy(&grb.matcher);
+	catcierge_args_destroy_vars(args);
+	catcierge_grabber_destroy(&grb);
+
+	return NULL;
+}
+
+static char *run_streaming_tests()
+{
+	int i;
+	int j;
+	catcierge_grb_t grb;
+	catcierge_args_t *args = &grb.args;
+
+	catcierge_grabber_init(&grb);
+	catcierge_args_init_vars(args);
+
+	catcierge_haar_matcher_args_init(&args->haar);
+	args->saveimg = 0;
+	args->matcher_type = MATCHER_HAAR;
+	args->lockout_method = OBSTRUCT_OR_TIMER_3;
+	args->streaming = 1;
+	args->stream_window = MATCH_MAX_COUNT;
+	args->haar.cascade = strdup(CATCIERGE_CASCADE);
+
+	if (catcierge_matcher_init(&grb.matcher, (catcierge_matcher_args_t *)&args->haar))
+	{
+		return "Failed to init catcierge lib!\n";
+	}
+
+	grb.running = 1;
+	catcierge_set_state(&grb, catcierge_state_waiting);
+
+	for (j = 6; j <= 14; j++)
+	{
+		catcierge_test_STATUS("Test series %d", j);
+
+		args->ok_matches_needed = (j <= 9) ? DEFAULT_OK_MATCHES_NEEDED : 3;
+
+		load_test_image_and_run(&grb, j, 1);
+		mu_assert("Expected MATCHING state", (grb.state == catcierge_state_matching));
+
+		// Feed the series twice so that old matches are dropped.
+		for (i = 0; (i < 2 * MATCH_MAX_COUNT) && (grb.state == catcierge_state_matching); i++)
+		{
+			load_test_image_and_run(&grb, j, (i % MATCH_MAX_COUNT) + 1);
+		}
+
+		mu_assert("Expected no more than MATCH_MAX_COUNT matches to be kept",
+			grb.match_group.match_count <= MATCH_MAX_COUNT);
+
+		// The frame clears.
+		if (grb.state == catcierge_state_matching)
+		{
+			load_test_image_and_run(&grb, 1, 5);
+		}
+
+		catcierge_test_STATUS("Decided after %d matches, %d in window",
+			(int)grb.match_window.total, (int)grb.match_window.count);
+
+		if (j <= 9)
+		{
+			mu_assert("Expected KEEP OPEN state", (grb.state == catcierge_state_keepopen));
+		}
+		else
+		{
+			mu_assert("Expected LOCKOUT state", (grb.state == catcierge_state_lockout));
+		}
+
+		load_test_image_and_run(&grb, 1, 5);
+		mu_assert("Expected WAITING state", (grb.state == catcierge_state_waiting));
+	}
+
+	catcierge_matcher_destroy(&grb.matcher);
+	catcierge_args_destroy_vars(args);
+	catcierge_grabber_destroy(&grb);
+
+	return NULL;
+}
+
 static char *run_save_steps_test()
 {
 	catcierge_grb_t grb;
@@ -213,6 +360,14 @@ int TEST_catcierge_fsm_haar_matcher(int argc, char **argv)
 		"Run failure tests. Adaptive prey matching",
 		"Failure tests with Adaptive prey matching", &ret);
 
+	CATCIERGE_RUN_TEST((e = run_early_decision_tests()),
+		"Run early decision tests",
+		"Early decision tests", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_streaming_tests()),
+		"Run streaming tests",
+		"Streaming tests", &ret);
+
 	CATCIERGE_RUN_TEST((e = run_save_steps_test()),
 		"Run save steps tests. Adaptive prey matching",
 		"Save steps tests", &ret);
@@ -64,6 +64,9 @@ static char *run_tests()
 	args->do_unlock_cmd[0] = strdup("");
 	catcierge_do_lockout(&grb);
 	catcierge_do_unlock(&grb);
+	mu_assert("Expected actuation timer to be stopped after unlock",
+		!catcierge_timer_isactive(&grb.actuation_timer));
+	mu_assert("Expected a valid actuation latency", grb.actuation_latency >= 0.0);
 
 	catcierge_do_lockout(&grb);
 	catcierge_do_unlock(&grb);
@@ -0,0 +1,177 @@
+#include <catcierge_config.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/stat.h>
+#include "catcierge_gpio.h"
+
+#define TEST_PIN 17
+
+static char fake_root[] = "/tmp/catcierge_gpio_XXXXXX";
+
+// Creates a directory that looks like /sys/class/gpio with one pin.
+static int create_fake_chip()
+{
+	char path[512];
+	FILE *f;
+
+	if (!mkdtemp(fake_root))
+		return -1;
+
+	snprintf(path, sizeof(path), "%s/gpio%d", fake_root, TEST_PIN);
+	if (mkdir(path, 0700))
+		return -1;
+
+	snprintf(path, sizeof(path), "%s/export", fake_root);
+	if (!(f = fopen(path, "w"))) return -1;
+	fclose(f);
+
+	snprintf(path, sizeof(path), "%s/gpio%d/direction", fake_root, TEST_PIN);
+	if (!(f = fopen(path, "w"))) return -1;
+	fclose(f);
+
+	snprintf(path, sizeof(path), "%s/gpio%d/value", fake_root, TEST_PIN);
+	if (!(f = fopen(path, "w"))) return -1;
+	fclose(f);
+
+	gpio_set_sysfs_root(fake_root);
+
+	return 0;
+}
+
+static void destroy_fake_chip()
+{
+	char path[512];
+
+	snprintf(path, sizeof(path), "%s/gpio%d/value", fake_root, TEST_PIN);
+	remove(path);
+	snprintf(path, sizeof(path), "%s/gpio%d/direction", fake_root, TEST_PIN);
+	remove(path);
+	snprintf(path, sizeof(path), "%s/gpio%d", fake_root, TEST_PIN);
+	remove(path);
+	snprintf(path, sizeof(path), "%s/export", fake_root);
+	remove(path);
+	remove(fake_root);
+
+	gpio_set_sysfs_root(NULL);
+}
+
+static int read_fake_value()
+{
+	char path[512];
+	char buf[16];
+	FILE *f;
+	snprintf(path, sizeof(path), "%s/gpio%d/value", fake_root, TEST_PIN);
+
+	if (!(f = fopen(path, "r")))
+		return -1;
+
+	memset(buf, 0, sizeof(buf));
+	fread(buf, 1, sizeof(buf) - 1, f);
+	fclose(f);
+
+	return atoi(buf);
+}
+
+static char *run_legacy_tests()
+{
+	mu_assert("Expected export to succeed", !gpio_export(TEST_PIN));
+	mu_assert("Expected set direction to succeed", !gpio_set_direction(TEST_PIN, OUT));
+
+	mu_assert("Expected write to succeed", !gpio_write(TEST_PIN, 1));
+	mu_assert("Expected value 1", read_fake_value() == 1);
+
+	mu_assert("Expected write to succeed", !gpio_write(TEST_PIN, 0));
+	mu_assert("Expected value 0", read_fake_value() == 0);
+
+	return NULL;
+}
+
+static char *run_line_tests(catcierge_gpio_backend_t backend)
+{
+	catcierge_gpio_line_t line;
+
+	catcierge_test_STATUS("Backend %s", gpio_backend_str(backend));
+
+	mu_assert("Expected line open to succeed",
+		!gpio_line_open(&line, backend, NULL, TEST_PIN, 1));
+	mu_assert("Expected initial value 1", read_fake_value() == 1);
+
+	mu_assert("Expected write to succeed", !gpio_line_write(&line, 0));
+	mu_assert("Expected value 0", read_fake_value() == 0);
+	mu_assert("Expected line value 0", line.value == 0);
+
+	mu_assert("Expected write to succeed", !gpio_line_write(&line, 5));
+	mu_assert("Expected value 1", read_fake_value() == 1);
+	mu_assert("Expected 3 writes", line.write_count == 3);
+
+	gpio_line_close(&line);
+	gpio_line_close(&line);
+
+	return NULL;
+}
+
+static char *run_fake_backend_tests()
+{
+	catcierge_gpio_line_t line;
+	catcierge_gpio_backend_t backend;
+
+	mu_assert("Expected fake line open to succeed",
+		!gpio_line_open(&line, GPIO_BACKEND_FAKE, NULL, TEST_PIN, 0));
+	mu_assert("Expected write to succeed", !gpio_line_write(&line, 1));
+	mu_assert("Expected line value 1", line.value == 1);
+	gpio_line_close(&line);
+
+	mu_assert("Expected chardev open to fail on a missing chip",
+		gpio_line_open(&line, GPIO_BACKEND_CHARDEV, "/dev/catcierge_no_such_chip", TEST_PIN, 0));
+
+	mu_assert("Expected to parse sysfs",
+		!gpio_backend_parse("sysfs", &backend) && (backend == GPIO_BACKEND_SYSFS));
+	mu_assert("Expected to parse chardev",
+		!gpio_backend_parse("chardev", &backend) && (backend == GPIO_BACKEND_CHARDEV));
+	mu_assert("Expected invalid backend to fail", gpio_backend_parse("abc", &backend));
+
+	return NULL;
+}
+#endif // !_WIN32
+
+int TEST_catcierge_gpio(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	#ifndef _WIN32
+	if (create_fake_chip())
+	{
+		catcierge_test_SKIPPED("Failed to create fake GPIO chip\n");
+		return 0;
+	}
+
+	CATCIERGE_RUN_TEST((e = run_legacy_tests()),
+		"Legacy sysfs GPIO writes",
+		"", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_line_tests(GPIO_BACKEND_LEGACY)),
+		"Legacy GPIO line",
+		"", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_line_tests(GPIO_BACKEND_SYSFS)),
+		"Persistent sysfs GPIO line",
+		"", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_fake_backend_tests()),
+		"Fake GPIO backend",
+		"", &ret);
+
+	destroy_fake_chip();
+	#else
+	catcierge_test_SKIPPED("GPIO not supported on Windows!\n");
+	#endif
+
+	return ret;
+}
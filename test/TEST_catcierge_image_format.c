@@ -0,0 +1,164 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+#include "catcierge_image_format.h"
+
+static IplImage *create_pattern_image(int channels)
+{
+	int x;
+	int y;
+	int c;
+	unsigned char *row;
+	IplImage *img = catcierge_test_create_image(67, 31, channels, 0);
+
+	// Runs, small and large differences, so all QOI chunk types are used.
+	for (y = 0; y < img->height; y++)
+	{
+		row = (unsigned char *)img->imageData + (y * img->widthStep);
+
+		for (x = 0; x < img->width; x++)
+		{
+			for (c = 0; c < channels; c++)
+			{
+				row[x * channels + c] = (x < 10) ? 50 : (unsigned char)((x * (c + 1) * 7) + (y * 13) + ((x * y) % 5));
+			}
+		}
+	}
+
+	return img;
+}
+
+static int images_equal(IplImage *a, IplImage *b)
+{
+	int y;
+
+	if ((a->width != b->width) || (a->height != b->height) || (a->nChannels != b->nChannels))
+		return 0;
+
+	for (y = 0; y < a->height; y++)
+	{
+		if (memcmp(a->imageData + (y * a->widthStep),
+					b->imageData + (y * b->widthStep),
+					a->width * a->nChannels))
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static char *run_qoi_tests()
+{
+	IplImage *img = NULL;
+	IplImage *gray = NULL;
+	IplImage *decoded = NULL;
+	unsigned char *data = NULL;
+	size_t len = 0;
+
+	img = create_pattern_image(3);
+	mu_assert("Expected QOI encode to succeed", (data = catcierge_qoi_encode(img, &len)));
+	catcierge_test_STATUS("Encoded %dx%d image to %d bytes", img->width, img->height, (int)len);
+	mu_assert("Expected QOI magic", !memcmp(data, "qoif", 4));
+	mu_assert("Expected QOI decode to succeed", (decoded = catcierge_qoi_decode(data, len)));
+	mu_assert("Expected decoded image to be identical", images_equal(img, decoded));
+	cvReleaseImage(&decoded);
+
+	mu_assert("Expected truncated header to fail", !catcierge_qoi_decode(data, 10));
+	free(data);
+
+	// Grayscale is stored as RGB.
+	gray = create_pattern_image(1);
+	mu_assert("Expected QOI encode to succeed", (data = catcierge_qoi_encode(gray, &len)));
+	mu_assert("Expected QOI decode to succeed", (decoded = catcierge_qoi_decode(data, len)));
+	mu_assert("Expected 3 channels", decoded->nChannels == 3);
+	mu_assert("Expected gray values",
+		((unsigned char)decoded->imageData[decoded->widthStep + 60 * 3]
+			== (unsigned char)gray->imageData[gray->widthStep + 60])
+		&& ((unsigned char)decoded->imageData[decoded->widthStep + 60 * 3 + 2]
+			== (unsigned char)gray->imageData[gray->widthStep + 60]));
+	free(data);
+
+	cvReleaseImage(&decoded);
+	cvReleaseImage(&gray);
+	cvReleaseImage(&img);
+
+	return NULL;
+}
+
+static char *run_save_load_tests()
+{
+	IplImage *img = NULL;
+	IplImage *loaded = NULL;
+	int channels[] = { 1, 3 };
+	catcierge_image_format_t formats[] = { CATCIERGE_IMAGE_QOI, CATCIERGE_IMAGE_PGM };
+	char path[64];
+	size_t i;
+	size_t j;
+
+	for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+	{
+		for (j = 0; j < sizeof(channels) / sizeof(channels[0]); j++)
+		{
+			img = create_pattern_image(channels[j]);
+			snprintf(path, sizeof(path), "image_format_test.%s",
+				catcierge_image_format_ext(formats[i], channels[j]));
+
+			catcierge_test_STATUS("Save and load %s", path);
+			mu_assert("Expected save to succeed",
+				!catcierge_image_save(path, img, formats[i], DEFAULT_PNG_COMPRESSION));
+			mu_assert("Expected load to succeed", (loaded = catcierge_image_load(path)));
+
+			// QOI has no grayscale.
+			if ((formats[i] == CATCIERGE_IMAGE_PGM) || (channels[j] == 3))
+			{
+				mu_assert("Expected loaded image to be identical", images_equal(img, loaded));
+			}
+
+			remove(path);
+			cvReleaseImage(&loaded);
+			cvReleaseImage(&img);
+		}
+	}
+
+	return NULL;
+}
+
+static char *run_format_name_tests()
+{
+	catcierge_image_format_t format = CATCIERGE_IMAGE_PNG;
+
+	mu_assert("Expected qoi", !catcierge_image_format_parse("qoi", &format)
+								&& (format == CATCIERGE_IMAGE_QOI));
+	mu_assert("Expected unknown format to fail", catcierge_image_format_parse("gif", &format));
+	mu_assert("Expected pgm extension for grayscale",
+		!strcmp(catcierge_image_format_ext(CATCIERGE_IMAGE_PGM, 1), "pgm"));
+	mu_assert("Expected ppm extension for color",
+		!strcmp(catcierge_image_format_ext(CATCIERGE_IMAGE_PGM, 3), "ppm"));
+	mu_assert("Expected png extension",
+		!strcmp(catcierge_image_format_ext(CATCIERGE_IMAGE_PNG, 3), "png"));
+
+	return NULL;
+}
+
+int TEST_catcierge_image_format(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_qoi_tests()),
+		"QOI encode and decode",
+		"", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_save_load_tests()),
+		"Save and load images",
+		"", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_format_name_tests()),
+		"Image format names",
+		"", &ret);
+
+	return ret;
+}
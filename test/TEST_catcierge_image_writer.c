@@ -0,0 +1,167 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+#include "catcierge_image_writer.h"
+
+#define TEST_IMAGE_DIR "image_writer_output"
+
+static char *run_write_test()
+{
+	catcierge_image_writer_t w;
+	catcierge_image_writer_stats_t stats;
+	char path[256];
+	FILE *f;
+	int i;
+
+	mu_assert("Expected zero sized queue to fail",
+		catcierge_image_writer_init(&w, 0, CATCIERGE_IMAGE_PNG, DEFAULT_PNG_COMPRESSION));
+	mu_assert("Expected too large queue to fail",
+		catcierge_image_writer_init(&w, CATCIERGE_IMAGE_QUEUE_MAX_SIZE + 1,
+			CATCIERGE_IMAGE_PNG, DEFAULT_PNG_COMPRESSION));
+	mu_assert("Expected image writer init to succeed",
+		!catcierge_image_writer_init(&w, 8, CATCIERGE_IMAGE_PNG, DEFAULT_PNG_COMPRESSION));
+
+	// Two batches of 3 images each.
+	for (i = 0; i < 6; i++)
+	{
+		snprintf(path, sizeof(path), TEST_IMAGE_DIR "/img%d.png", i);
+		mu_assert("Expected push to succeed",
+			!catcierge_image_writer_push(&w, catcierge_test_create_image(32, 32, 1, 128),
+				TEST_IMAGE_DIR, path, ((i % 3) == 2)));
+	}
+
+	// Writes everything queued.
+	catcierge_image_writer_destroy(&w);
+
+	catcierge_test_STATUS("%lu written, %llu bytes, %lu failed",
+		w.written_count, w.bytes_written, w.failed_count);
+	mu_assert("Expected 6 written images", w.written_count == 6);
+	mu_assert("Expected bytes to be counted", w.bytes_written > 0);
+	mu_assert("Expected 2 written batches", w.done_batches == 2);
+
+	catcierge_image_writer_stats(&w, &stats);
+	mu_assert("Expected the stats to match", (stats.count == 0)
+		&& (stats.written_count == 6) && (stats.bytes_written == w.bytes_written));
+
+	for (i = 0; i < 6; i++)
+	{
+		snprintf(path, sizeof(path), TEST_IMAGE_DIR "/img%d.png", i);
+		mu_assert("Expected image file", (f = fopen(path, "rb")));
+		fclose(f);
+		remove(path);
+	}
+
+	return NULL;
+}
+
+static char *run_drop_test()
+{
+	catcierge_image_writer_t w;
+	char path[256];
+	int dropped = 0;
+	int i;
+
+	// Images that don't fit are dropped right away, the
+	// batch is still completed by the last queued image.
+	mu_assert("Expected image writer init to succeed",
+		!catcierge_image_writer_init(&w, 1, CATCIERGE_IMAGE_PNG, DEFAULT_PNG_COMPRESSION));
+
+	for (i = 0; i < 10; i++)
+	{
+		snprintf(path, sizeof(path), TEST_IMAGE_DIR "/drop%d.png", i);
+		if (catcierge_image_writer_push(&w, catcierge_test_create_image(32, 32, 1, 128),
+				TEST_IMAGE_DIR, path, (i == 9)))
+			dropped++;
+	}
+
+	catcierge_image_writer_destroy(&w);
+
+	catcierge_test_STATUS("%lu queued, %lu dropped, %lu written",
+		w.queued_count, w.dropped_count, w.written_count);
+	mu_assert("Expected all images to be accounted for",
+		(w.queued_count + w.dropped_count) == 10);
+	mu_assert("Expected the dropped count to match", w.dropped_count == (unsigned long)dropped);
+	mu_assert("Expected all queued images to be written", w.written_count == w.queued_count);
+	mu_assert("Expected the batch to complete", w.done_batches == 1);
+
+	for (i = 0; i < 10; i++)
+	{
+		snprintf(path, sizeof(path), TEST_IMAGE_DIR "/drop%d.png", i);
+		remove(path);
+	}
+
+	return NULL;
+}
+
+static char *run_archive_test()
+{
+	catcierge_image_writer_t w;
+	catcierge_archive_t archive;
+	catcierge_archive_reader_t rd;
+	catcierge_archive_record_t *r;
+	int i;
+
+	memset(&archive, 0, sizeof(archive));
+	remove(TEST_IMAGE_DIR "/test.cca");
+	remove(TEST_IMAGE_DIR "/test.cca.idx");
+
+	mu_assert("Expected image writer init to succeed",
+		!catcierge_image_writer_init(&w, 4, CATCIERGE_IMAGE_QOI, DEFAULT_PNG_COMPRESSION));
+
+	for (i = 0; i < 2; i++)
+	{
+		r = malloc(sizeof(catcierge_archive_record_t));
+		catcierge_archive_record_init(r);
+		r->time_us = i;
+		catcierge_archive_record_add_image(r, CATCIERGE_ARCHIVE_MATCH,
+			"match.qoi", catcierge_test_create_image(32, 32, 1, 128), 0, 0);
+		catcierge_archive_record_add_image(r, CATCIERGE_ARCHIVE_MATCH,
+			"match2.qoi", catcierge_test_create_image(32, 32, 1, 128), 1, 0);
+		mu_assert("Expected record push to succeed",
+			!catcierge_image_writer_push_record(&w, &archive, r,
+				TEST_IMAGE_DIR "/test.cca", 2));
+	}
+
+	catcierge_image_writer_destroy(&w);
+	catcierge_archive_close(&archive);
+
+	catcierge_test_STATUS("%lu written, %llu bytes", w.written_count, w.bytes_written);
+	mu_assert("Expected both records to be written", w.written_count == 2);
+	mu_assert("Expected a batch for each match", w.done_batches == 4);
+
+	mu_assert("Expected reader open to succeed",
+		!catcierge_archive_reader_open(&rd, TEST_IMAGE_DIR "/test.cca"));
+	mu_assert("Expected 2 records", rd.count == 2);
+	catcierge_archive_reader_close(&rd);
+
+	remove(TEST_IMAGE_DIR "/test.cca");
+	remove(TEST_IMAGE_DIR "/test.cca.idx");
+
+	return NULL;
+}
+
+int TEST_catcierge_image_writer(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	CATCIERGE_RUN_TEST((e = run_write_test()),
+		"Image writer",
+		"", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_drop_test()),
+		"Image writer drops",
+		"", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_archive_test()),
+		"Image writer archive records",
+		"", &ret);
+	#else
+	catcierge_test_SKIPPED("Image writer needs pthreads, skipping tests");
+	#endif
+
+	return ret;
+}
@@ -0,0 +1,167 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+#include "catcierge_journal.h"
+
+#define TEST_JOURNAL "test_journal.ccj"
+#define TEST_EVENTS (CATCIERGE_JOURNAL_BLOCK_EVENTS * 2 + 10)
+
+static int add_event(catcierge_journal_t *j, int n)
+{
+	catcierge_journal_event_t e;
+	int i;
+
+	memset(&e, 0, sizeof(e));
+	e.time_us = 1000000ULL * (1000 + n * 10);
+	e.duration_ms = 500 + n;
+	e.success = !(n % 3);
+	e.direction = (n & 1) ? MATCH_DIR_OUT : MATCH_DIR_IN;
+	e.rfid_direction = MATCH_DIR_UNKNOWN;
+	e.flags = CATCIERGE_JOURNAL_FINAL_DECISION;
+	e.id[0] = 0xabcdef00 + n;
+	e.match_count = 1 + (n % 4);
+
+	for (i = 0; i < (int)e.match_count; i++)
+	{
+		e.matches[i].result = 0.5f + i * 0.1f;
+		e.matches[i].success = (i == 0);
+		e.matches[i].direction = e.direction;
+	}
+
+	return catcierge_journal_append(j, &e);
+}
+
+static int count_cb(const catcierge_journal_event_t *e, void *user)
+{
+	int *count = (int *)user;
+
+	if ((e->id[0] - 0xabcdef00) == 24)
+	{
+		if ((e->match_count != 1) || (e->matches[0].result != 0.5f)
+			|| (e->direction != MATCH_DIR_IN) || !e->success
+			|| (e->rfid_direction != MATCH_DIR_UNKNOWN))
+		{
+			return -1;
+		}
+	}
+
+	(*count)++;
+	return 0;
+}
+
+static char *run_write_read_test()
+{
+	catcierge_journal_t j;
+	catcierge_journal_reader_t rd;
+	catcierge_journal_stats_t s;
+	int i;
+	int count = 0;
+
+	remove(TEST_JOURNAL);
+
+	mu_assert("Expected journal open to succeed", !catcierge_journal_open(&j, TEST_JOURNAL));
+
+	for (i = 0; i < TEST_EVENTS - 5; i++)
+	{
+		mu_assert("Expected append to succeed", !add_event(&j, i));
+	}
+
+	catcierge_journal_close(&j);
+
+	// Appending to an existing journal.
+	mu_assert("Expected journal reopen to succeed", !catcierge_journal_open(&j, TEST_JOURNAL));
+
+	for (; i < TEST_EVENTS; i++)
+	{
+		mu_assert("Expected append to succeed", !add_event(&j, i));
+	}
+
+	catcierge_journal_close(&j);
+
+	mu_assert("Expected reader open to succeed", !catcierge_journal_reader_open(&rd, TEST_JOURNAL));
+	catcierge_test_STATUS("%d blocks, %lu events, %lu success",
+		(int)rd.block_count, rd.stats.count, rd.stats.success_count);
+	mu_assert("Expected 2 index blocks and a tail", rd.block_count == 3);
+	mu_assert("Expected all events", rd.stats.count == TEST_EVENTS);
+	mu_assert("Expected every third a success", rd.stats.success_count == ((TEST_EVENTS + 2) / 3));
+	mu_assert("Expected half in", rd.stats.in_count == (TEST_EVENTS / 2));
+
+	// Partly covers the first two blocks.
+	catcierge_journal_reader_stats(&rd, 1000000ULL * (1000 + 10 * 10),
+		1000000ULL * (1000 + 300 * 10), &s);
+	mu_assert("Expected 291 events in range", s.count == 291);
+	mu_assert("Expected range times", (s.first_us == 1000000ULL * 1100)
+		&& (s.last_us == 1000000ULL * 4000));
+
+	catcierge_journal_reader_stats(&rd, 0, CATCIERGE_JOURNAL_TIME_MAX, &s);
+	mu_assert("Expected all events in full range", s.count == TEST_EVENTS);
+
+	catcierge_journal_reader_stats(&rd, 0, 1000, &s);
+	mu_assert("Expected no events before start", s.count == 0);
+
+	mu_assert("Expected foreach to succeed",
+		!catcierge_journal_reader_foreach(&rd, 0, CATCIERGE_JOURNAL_TIME_MAX, count_cb, &count));
+	mu_assert("Expected foreach over all events", count == TEST_EVENTS);
+
+	catcierge_journal_reader_close(&rd);
+
+	return NULL;
+}
+
+static char *run_repair_test()
+{
+	catcierge_journal_t j;
+	catcierge_journal_reader_t rd;
+	FILE *f;
+
+	// A record that was only partly written.
+	f = fopen(TEST_JOURNAL, "ab");
+	mu_assert("Expected to open journal", f);
+	fwrite("CCJE\x60\x00\x01\x00garbage", 1, 15, f);
+	fclose(f);
+
+	// Readers ignore it.
+	mu_assert("Expected reader open to succeed", !catcierge_journal_reader_open(&rd, TEST_JOURNAL));
+	mu_assert("Expected all events", rd.stats.count == TEST_EVENTS);
+	mu_assert("Expected broken tail", rd.end < rd.size);
+	catcierge_journal_reader_close(&rd);
+
+	// The writer cuts it off.
+	mu_assert("Expected journal open to succeed", !catcierge_journal_open(&j, TEST_JOURNAL));
+	mu_assert("Expected append to succeed", !add_event(&j, TEST_EVENTS));
+	catcierge_journal_close(&j);
+
+	mu_assert("Expected reader open to succeed", !catcierge_journal_reader_open(&rd, TEST_JOURNAL));
+	mu_assert("Expected one more event", rd.stats.count == (TEST_EVENTS + 1));
+	mu_assert("Expected no broken tail", rd.end == rd.size);
+	catcierge_journal_reader_close(&rd);
+
+	// Not a journal.
+	f = fopen(TEST_JOURNAL, "wb");
+	fwrite("nope, not a journal", 1, 19, f);
+	fclose(f);
+	mu_assert("Expected journal open to fail", catcierge_journal_open(&j, TEST_JOURNAL));
+	mu_assert("Expected reader open to fail", catcierge_journal_reader_open(&rd, TEST_JOURNAL));
+
+	remove(TEST_JOURNAL);
+
+	return NULL;
+}
+
+int TEST_catcierge_journal(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_write_read_test()),
+		"Journal write and read",
+		"", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_repair_test()),
+		"Journal repair",
+		"", &ret);
+
+	return ret;
+}
@@ -0,0 +1,83 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "catcierge_match_cache.h"
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+
+static char *run_cache_tests()
+{
+	catcierge_match_cache_t c;
+	match_result_t res;
+	match_result_t cached;
+	IplImage *img = cvCreateImage(cvSize(320, 240), IPL_DEPTH_8U, 3);
+	IplImage *noisy = cvCreateImage(cvSize(320, 240), IPL_DEPTH_8U, 3);
+	IplImage *moved = cvCreateImage(cvSize(320, 240), IPL_DEPTH_8U, 3);
+
+	cvSet(img, CV_RGB(20, 20, 20), NULL);
+	cvRectangle(img, cvPoint(40, 40), cvPoint(120, 120), CV_RGB(200, 200, 200), CV_FILLED, 8, 0);
+
+	// A slightly brighter version of the same frame.
+	cvAddS(img, cvScalarAll(2), noisy, NULL);
+
+	cvSet(moved, CV_RGB(20, 20, 20), NULL);
+	cvRectangle(moved, cvPoint(180, 100), cvPoint(260, 180), CV_RGB(200, 200, 200), CV_FILLED, 8, 0);
+
+	mu_assert("Expected cache init to succeed", !catcierge_match_cache_init(&c));
+
+	memset(&cached, 0, sizeof(cached));
+	mu_assert("Expected miss on empty cache",
+		catcierge_match_cache_lookup(&c, img, 5.0, &cached) == 0);
+
+	memset(&res, 0, sizeof(res));
+	res.result = 1.0;
+	res.success = 1;
+	res.direction = MATCH_DIR_IN;
+	res.rect_count = 1;
+	res.match_rects[0] = cvRect(40, 40, 80, 80);
+	snprintf(res.description, sizeof(res.description) - 1, "In");
+	catcierge_match_cache_store(&c, &res);
+
+	memset(&cached, 0, sizeof(cached));
+	mu_assert("Expected hit for near identical frame",
+		catcierge_match_cache_lookup(&c, noisy, 5.0, &cached) == 1);
+	catcierge_test_STATUS("Difference %f", c.diff_mean);
+	mu_assert("Expected reused result", cached.reused);
+	mu_assert("Expected same success", cached.success == res.success);
+	mu_assert("Expected same direction", cached.direction == res.direction);
+	mu_assert("Expected same rects", (cached.rect_count == 1)
+		&& (cached.match_rects[0].x == 40) && (cached.match_rects[0].width == 80));
+	mu_assert("Expected same description", !strcmp(cached.description, "In"));
+	mu_assert("Expected no step images", cached.step_img_count == 0);
+
+	memset(&cached, 0, sizeof(cached));
+	mu_assert("Expected miss for a different frame",
+		catcierge_match_cache_lookup(&c, moved, 5.0, &cached) == 0);
+	catcierge_test_STATUS("Difference %f", c.diff_mean);
+	mu_assert("Expected result to not be reused", !cached.reused);
+
+	mu_assert("Expected 1 hit and 2 misses", (c.hits == 1) && (c.misses == 2));
+
+	catcierge_match_cache_reset(&c);
+	mu_assert("Expected miss after reset",
+		catcierge_match_cache_lookup(&c, img, 5.0, &cached) == 0);
+
+	catcierge_match_cache_destroy(&c);
+	cvReleaseImage(&img);
+	cvReleaseImage(&noisy);
+	cvReleaseImage(&moved);
+
+	return NULL;
+}
+
+int TEST_catcierge_match_cache(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_cache_tests()),
+		"Match result cache",
+		"", &ret);
+
+	return ret;
+}
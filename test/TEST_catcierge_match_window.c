@@ -0,0 +1,118 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "catcierge_match_window.h"
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+
+static void push_result(catcierge_match_window_t *w, int success, match_direction_t dir)
+{
+	match_result_t res;
+	memset(&res, 0, sizeof(res));
+	res.success = success;
+	res.direction = dir;
+	catcierge_match_window_push(w, &res);
+}
+
+static char *run_window_counter_tests()
+{
+	catcierge_match_window_t w;
+
+	mu_assert("Expected zero sized window to fail", catcierge_match_window_init(&w, 0));
+	mu_assert("Expected too large window to fail",
+		catcierge_match_window_init(&w, CATCIERGE_MAX_STREAM_WINDOW + 1));
+	mu_assert("Expected window init to succeed", !catcierge_match_window_init(&w, 3));
+
+	push_result(&w, 1, MATCH_DIR_IN);
+	push_result(&w, 0, MATCH_DIR_UNKNOWN);
+	mu_assert("Expected window to not be full", !catcierge_match_window_is_full(&w));
+	mu_assert("Expected 2 results", w.count == 2);
+	mu_assert("Expected 1 success", w.success_count == 1);
+
+	push_result(&w, 1, MATCH_DIR_IN);
+	mu_assert("Expected window to be full", catcierge_match_window_is_full(&w));
+	mu_assert("Expected 2 successes", w.success_count == 2);
+	mu_assert("Expected 2 in", w.in_count == 2);
+
+	// Drops the oldest result (success, in).
+	push_result(&w, 0, MATCH_DIR_OUT);
+	catcierge_test_STATUS("count: %d total: %d success: %d in: %d out: %d unknown: %d",
+		(int)w.count, (int)w.total, w.success_count,
+		w.in_count, w.out_count, w.unknown_count);
+	mu_assert("Expected 3 results", w.count == 3);
+	mu_assert("Expected 4 total", w.total == 4);
+	mu_assert("Expected 1 success", w.success_count == 1);
+	mu_assert("Expected 1 in", w.in_count == 1);
+	mu_assert("Expected 1 out", w.out_count == 1);
+	mu_assert("Expected 1 unknown", w.unknown_count == 1);
+
+	push_result(&w, 0, MATCH_DIR_OUT);
+	push_result(&w, 0, MATCH_DIR_OUT);
+	mu_assert("Expected 0 successes", w.success_count == 0);
+	mu_assert("Expected 3 out", w.out_count == 3);
+
+	catcierge_match_window_reset(&w);
+	mu_assert("Expected empty window after reset", (w.count == 0) && (w.total == 0));
+	mu_assert("Expected no successes after reset", w.success_count == 0);
+
+	catcierge_match_window_destroy(&w);
+	mu_assert("Expected no entries after destroy", w.entries == NULL);
+
+	return NULL;
+}
+
+static char *run_window_direction_tests()
+{
+	catcierge_match_window_t w;
+
+	mu_assert("Expected window init to succeed", !catcierge_match_window_init(&w, 3));
+
+	mu_assert("Expected unknown direction for empty window",
+		catcierge_match_window_direction(&w) == MATCH_DIR_UNKNOWN);
+	mu_assert("Expected unknown success direction for empty window",
+		catcierge_match_window_success_direction(&w) == MATCH_DIR_UNKNOWN);
+
+	push_result(&w, 0, MATCH_DIR_OUT);
+	push_result(&w, 1, MATCH_DIR_IN);
+	push_result(&w, 0, MATCH_DIR_OUT);
+	mu_assert("Expected out direction",
+		catcierge_match_window_direction(&w) == MATCH_DIR_OUT);
+	mu_assert("Expected in success direction",
+		catcierge_match_window_success_direction(&w) == MATCH_DIR_IN);
+
+	push_result(&w, 0, MATCH_DIR_UNKNOWN);
+	mu_assert("Expected in success direction",
+		catcierge_match_window_success_direction(&w) == MATCH_DIR_IN);
+
+	// The only success falls out of the window.
+	push_result(&w, 0, MATCH_DIR_UNKNOWN);
+	mu_assert("Expected unknown success direction",
+		catcierge_match_window_success_direction(&w) == MATCH_DIR_UNKNOWN);
+	mu_assert("Expected unknown direction",
+		catcierge_match_window_direction(&w) == MATCH_DIR_UNKNOWN);
+
+	push_result(&w, 1, MATCH_DIR_IN);
+	push_result(&w, 1, MATCH_DIR_IN);
+	mu_assert("Expected in direction",
+		catcierge_match_window_direction(&w) == MATCH_DIR_IN);
+
+	catcierge_match_window_destroy(&w);
+
+	return NULL;
+}
+
+int TEST_catcierge_match_window(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_window_counter_tests()),
+		"Match window counters",
+		"", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_window_direction_tests()),
+		"Match window directions",
+		"", &ret);
+
+	return ret;
+}
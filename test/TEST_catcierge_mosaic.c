@@ -0,0 +1,184 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+#include "catcierge_mosaic.h"
+#include "catcierge_util.h"
+#ifdef CATCIERGE_HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#define TEST_MOSAIC_PATH "test_mosaic"
+
+static void create_match_group(match_group_t *mg)
+{
+	match_state_t *m;
+	size_t i;
+
+	memset(mg, 0, sizeof(*mg));
+	mg->match_count = 2;
+	mg->success = 1;
+	mg->success_count = 1;
+	mg->direction = MATCH_DIR_IN;
+	mg->start_time = time(NULL);
+	snprintf(mg->description, sizeof(mg->description), "Test group");
+
+	m = &mg->matches[0];
+	m->img = catcierge_test_create_image(160, 120, 1, 200);
+	m->result.success = 1;
+	m->result.direction = MATCH_DIR_IN;
+	m->result.result = 0.9;
+	m->result.match_rects[0] = cvRect(10, 10, 40, 30);
+	m->result.rect_count = 1;
+
+	for (i = 0; i < 4; i++)
+	{
+		m->result.steps[i].img = catcierge_test_create_image(40, 30, 1, 50);
+		m->result.steps[i].name = "step";
+	}
+
+	m->result.step_img_count = 4;
+
+	m = &mg->matches[1];
+	m->img = catcierge_test_create_image(160, 120, 3, 100);
+	m->result.direction = MATCH_DIR_OUT;
+}
+
+static void free_match_group(match_group_t *mg)
+{
+	size_t i;
+	size_t j;
+
+	for (i = 0; i < mg->match_count; i++)
+	{
+		if (mg->matches[i].img)
+			cvReleaseImage(&mg->matches[i].img);
+
+		for (j = 0; j < mg->matches[i].result.step_img_count; j++)
+		{
+			cvReleaseImage(&mg->matches[i].result.steps[j].img);
+		}
+	}
+}
+
+static int get_pixel(IplImage *img, int x, int y)
+{
+	return ((unsigned char *)(img->imageData + y * img->widthStep))[x * img->nChannels];
+}
+
+static char *run_compose_test()
+{
+	match_group_t mg;
+	catcierge_mosaic_job_t *job;
+	IplImage *mosaic;
+
+	create_match_group(&mg);
+
+	job = catcierge_mosaic_job_create(&mg, TEST_MOSAIC_PATH ".png", 0);
+	mu_assert("Expected job", job);
+	mu_assert("Expected 2 matches", job->match_count == 2);
+	mu_assert("Expected 4 steps", job->matches[0].step_count == 4);
+	mu_assert("Expected match frames to be copied", mg.matches[0].img && mg.matches[1].img);
+
+	mosaic = catcierge_mosaic_compose(job, 320);
+	mu_assert("Expected mosaic", mosaic);
+	catcierge_test_STATUS("Mosaic %dx%d", mosaic->width, mosaic->height);
+
+	// 2 columns, the first one is the tallest with 2 rows of steps.
+	mu_assert("Expected mosaic width", mosaic->width == (2 * 320 + 3 * 8));
+	mu_assert("Expected mosaic height", mosaic->height == (52 + 24 + 240 + 8 + 2 * (78 + 14 + 4) + 8));
+	mu_assert("Expected color mosaic", mosaic->nChannels == 3);
+
+	// Inside the frames and the first step thumbnail.
+	mu_assert("Expected first match frame", get_pixel(mosaic, 8 + 100, 52 + 24 + 200) == 200);
+	mu_assert("Expected second match frame", get_pixel(mosaic, 16 + 320 + 100, 52 + 24 + 200) == 100);
+	mu_assert("Expected step thumbnail", get_pixel(mosaic, 8 + 50, 52 + 24 + 248 + 40) == 50);
+
+	cvReleaseImage(&mosaic);
+	catcierge_mosaic_job_free(job);
+
+	// Taking over the match frames.
+	job = catcierge_mosaic_job_create(&mg, TEST_MOSAIC_PATH ".png", 1);
+	mu_assert("Expected job", job);
+	mu_assert("Expected match frames to be taken", !mg.matches[0].img && !mg.matches[1].img);
+	mu_assert("Expected steps to be copied", mg.matches[0].result.steps[0].img);
+	catcierge_mosaic_job_free(job);
+
+	free_match_group(&mg);
+
+	return NULL;
+}
+
+#ifdef CATCIERGE_HAVE_PTHREAD_H
+static char *run_worker_test()
+{
+	catcierge_mosaic_t m;
+	match_group_t mg;
+	char path[64];
+	int i;
+	int polled = 0;
+	FILE *f;
+
+	mu_assert("Expected too small width to fail", catcierge_mosaic_init(&m, 10));
+	mu_assert("Expected mosaic init to succeed", !catcierge_mosaic_init(&m, 200));
+
+	create_match_group(&mg);
+
+	for (i = 0; i < 2; i++)
+	{
+		snprintf(path, sizeof(path), TEST_MOSAIC_PATH "%d.png", i);
+		mu_assert("Expected push to succeed",
+			!catcierge_mosaic_push(&m, catcierge_mosaic_job_create(&mg, path, 0)));
+	}
+
+	for (i = 0; (i < 500) && (polled < 2); i++)
+	{
+		if (catcierge_mosaic_poll(&m))
+		{
+			catcierge_test_STATUS("Polled %s after %0.2f ms", m.path, m.last_latency * 1000.0);
+			snprintf(path, sizeof(path), TEST_MOSAIC_PATH "%d.png", polled);
+			mu_assert("Expected mosaics in order", !strcmp(m.path, path));
+			polled++;
+			continue;
+		}
+
+		usleep(10000);
+	}
+
+	mu_assert("Expected 2 mosaics", polled == 2);
+	mu_assert("Expected 2 written", m.written_count == 2);
+
+	for (i = 0; i < 2; i++)
+	{
+		snprintf(path, sizeof(path), TEST_MOSAIC_PATH "%d.png", i);
+		f = fopen(path, "rb");
+		mu_assert("Expected mosaic file", f);
+		fclose(f);
+		remove(path);
+	}
+
+	catcierge_mosaic_destroy(&m);
+	free_match_group(&mg);
+
+	return NULL;
+}
+#endif // CATCIERGE_HAVE_PTHREAD_H
+
+int TEST_catcierge_mosaic(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_compose_test()),
+		"Mosaic compose",
+		"", &ret);
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	CATCIERGE_RUN_TEST((e = run_worker_test()),
+		"Mosaic worker",
+		"", &ret);
+	#endif
+
+	return ret;
+}
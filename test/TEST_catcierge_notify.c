@@ -0,0 +1,393 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+#include "catcierge_notify.h"
+#include "catcierge_util.h"
+#ifdef CATCIERGE_HAVE_NOTIFY
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+
+static char *run_parse_tests()
+{
+	catcierge_notify_target_t t;
+
+	mu_assert("Expected smtp target to parse",
+		!catcierge_notify_parse_target("smtp://mail.example.com/cat@example.com", &t));
+	mu_assert("Expected smtp", t.proto == CATCIERGE_NOTIFY_SMTP);
+	mu_assert("Expected host", !strcmp(t.host, "mail.example.com"));
+	mu_assert("Expected default port 25", !strcmp(t.port, "25"));
+	mu_assert("Expected recipient", !strcmp(t.path, "cat@example.com"));
+
+	mu_assert("Expected http target to parse",
+		!catcierge_notify_parse_target("http://10.0.0.2:8080/hooks/cat?x=1", &t));
+	mu_assert("Expected http", t.proto == CATCIERGE_NOTIFY_HTTP);
+	mu_assert("Expected host", !strcmp(t.host, "10.0.0.2"));
+	mu_assert("Expected port 8080", !strcmp(t.port, "8080"));
+	mu_assert("Expected path", !strcmp(t.path, "/hooks/cat?x=1"));
+
+	mu_assert("Expected http target without path to parse",
+		!catcierge_notify_parse_target("http://[::1]:81", &t));
+	mu_assert("Expected IPv6 host", !strcmp(t.host, "::1"));
+	mu_assert("Expected port 81", !strcmp(t.port, "81"));
+	mu_assert("Expected root path", !strcmp(t.path, "/"));
+
+	mu_assert("Expected https to fail",
+		catcierge_notify_parse_target("https://example.com/", &t));
+	mu_assert("Expected smtp without recipient to fail",
+		catcierge_notify_parse_target("smtp://example.com", &t));
+	mu_assert("Expected smtp with invalid recipient to fail",
+		catcierge_notify_parse_target("smtp://example.com/cat", &t));
+	mu_assert("Expected invalid port to fail",
+		catcierge_notify_parse_target("http://example.com:80a/", &t));
+	mu_assert("Expected empty host to fail",
+		catcierge_notify_parse_target("http://:80/", &t));
+
+	return NULL;
+}
+
+#ifdef CATCIERGE_HAVE_NOTIFY
+
+#define TEST_MAX_MESSAGES 8
+
+// A local stand-in for an SMTP server or a webhook.
+typedef struct test_server_s
+{
+	int smtp;
+	int fd;
+	int port;
+	int running;
+	int http_status;
+	char *messages[TEST_MAX_MESSAGES];
+	size_t message_count;
+	pthread_t thread;
+	pthread_mutex_t lock;
+} test_server_t;
+
+static int test_read_line(int fd, char *buf, size_t bufsize)
+{
+	size_t len = 0;
+	char c;
+
+	while ((len < bufsize - 1) && (recv(fd, &c, 1, 0) == 1))
+	{
+		buf[len++] = c;
+
+		if (c == '\n')
+			break;
+	}
+
+	buf[len] = '\0';
+	return (int)len;
+}
+
+static void test_add_message(test_server_t *s, const char *msg)
+{
+	pthread_mutex_lock(&s->lock);
+	if (s->message_count < TEST_MAX_MESSAGES)
+		s->messages[s->message_count++] = strdup(msg);
+	pthread_mutex_unlock(&s->lock);
+}
+
+static void test_serve_smtp(test_server_t *s, int fd)
+{
+	char line[1024];
+	char msg[8192];
+	int data = 0;
+
+	msg[0] = '\0';
+
+	#define REPLY(str) send(fd, str, strlen(str), 0)
+	REPLY("220 test ESMTP\r\n");
+
+	while (test_read_line(fd, line, sizeof(line)) > 0)
+	{
+		if (data)
+		{
+			if (!strcmp(line, ".\r\n"))
+			{
+				data = 0;
+				test_add_message(s, msg);
+				REPLY("250 OK\r\n");
+				continue;
+			}
+
+			strncat(msg, line, sizeof(msg) - strlen(msg) - 1);
+			continue;
+		}
+
+		strncat(msg, line, sizeof(msg) - strlen(msg) - 1);
+
+		if (!strncmp(line, "EHLO", 4))
+			REPLY("250-test\r\n250 8BITMIME\r\n");
+		else if (!strncmp(line, "DATA", 4))
+		{
+			REPLY("354 Go ahead\r\n");
+			data = 1;
+		}
+		else if (!strncmp(line, "QUIT", 4))
+		{
+			REPLY("221 Bye\r\n");
+			break;
+		}
+		else
+			REPLY("250 OK\r\n");
+	}
+	#undef REPLY
+}
+
+static void test_serve_http(test_server_t *s, int fd)
+{
+	char line[1024];
+	char body[8192];
+	size_t len = 0;
+	size_t content_length = 0;
+	ssize_t n;
+
+	while (test_read_line(fd, line, sizeof(line)) > 0)
+	{
+		if (!strncmp(line, "Content-Length:", 15))
+			content_length = strtoul(line + 15, NULL, 10);
+
+		if (!strcmp(line, "\r\n"))
+			break;
+	}
+
+	while ((len < content_length) && (len < sizeof(body) - 1)
+		&& ((n = recv(fd, body + len, content_length - len, 0)) > 0))
+	{
+		len += n;
+	}
+
+	body[len] = '\0';
+	test_add_message(s, body);
+
+	snprintf(line, sizeof(line),
+		"HTTP/1.0 %d Test\r\nContent-Length: 0\r\n\r\n", s->http_status);
+	send(fd, line, strlen(line), 0);
+}
+
+static void *test_server_thread(void *arg)
+{
+	test_server_t *s = (test_server_t *)arg;
+	struct timeval tv;
+	fd_set fds;
+	int fd;
+
+	while (s->running)
+	{
+		FD_ZERO(&fds);
+		FD_SET(s->fd, &fds);
+		tv.tv_sec = 0;
+		tv.tv_usec = 20000;
+
+		if (select(s->fd + 1, &fds, NULL, NULL, &tv) <= 0)
+			continue;
+
+		if ((fd = accept(s->fd, NULL, NULL)) < 0)
+			continue;
+
+		if (s->smtp)
+			test_serve_smtp(s, fd);
+		else
+			test_serve_http(s, fd);
+
+		close(fd);
+	}
+
+	return NULL;
+}
+
+static int test_server_start(test_server_t *s, int smtp)
+{
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+
+	memset(s, 0, sizeof(*s));
+	s->smtp = smtp;
+	s->http_status = 200;
+
+	if ((s->fd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+		return -1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+
+	if (bind(s->fd, (struct sockaddr *)&addr, sizeof(addr))
+		|| listen(s->fd, 4)
+		|| getsockname(s->fd, (struct sockaddr *)&addr, &addrlen))
+	{
+		close(s->fd);
+		return -1;
+	}
+
+	s->port = ntohs(addr.sin_port);
+	s->running = 1;
+	pthread_mutex_init(&s->lock, NULL);
+	pthread_create(&s->thread, NULL, test_server_thread, s);
+
+	return 0;
+}
+
+static size_t test_server_count(test_server_t *s)
+{
+	size_t count;
+	pthread_mutex_lock(&s->lock);
+	count = s->message_count;
+	pthread_mutex_unlock(&s->lock);
+	return count;
+}
+
+static void test_server_stop(test_server_t *s)
+{
+	size_t i;
+
+	s->running = 0;
+	pthread_join(s->thread, NULL);
+	close(s->fd);
+	pthread_mutex_destroy(&s->lock);
+
+	for (i = 0; i < s->message_count; i++)
+	{
+		free(s->messages[i]);
+	}
+}
+
+static char *run_smtp_test()
+{
+	test_server_t s;
+	catcierge_notify_settings_t settings;
+	catcierge_notify_target_t target;
+	catcierge_notify_batch_t batch;
+	char url[256];
+
+	mu_assert("Expected server to start", !test_server_start(&s, 1));
+
+	snprintf(url, sizeof(url), "smtp://127.0.0.1:%d/owner@example.com", s.port);
+	mu_assert("Expected target to parse", !catcierge_notify_parse_target(url, &target));
+
+	memset(&settings, 0, sizeof(settings));
+	settings.timeout = 2;
+	settings.from = "catcierge@example.com";
+	settings.subject = "Cat door";
+
+	memset(&batch, 0, sizeof(batch));
+	batch.lines[batch.count++] = "12:00:01 success in";
+	batch.lines[batch.count++] = ".starts with a dot";
+	batch.overflow = 3;
+
+	mu_assert("Expected mail to be sent",
+		!catcierge_notify_send(&settings, &target, &batch));
+	mu_assert("Expected one mail", test_server_count(&s) == 1);
+
+	catcierge_test_STATUS("Mail:\n%s", s.messages[0]);
+	mu_assert("Expected sender",
+		strstr(s.messages[0], "MAIL FROM:<catcierge@example.com>\r\n"));
+	mu_assert("Expected recipient",
+		strstr(s.messages[0], "RCPT TO:<owner@example.com>\r\n"));
+	mu_assert("Expected subject with the number of events",
+		strstr(s.messages[0], "Subject: Cat door (5 events)\r\n"));
+	mu_assert("Expected first line", strstr(s.messages[0], "\r\n12:00:01 success in\r\n"));
+	mu_assert("Expected dot to be escaped", strstr(s.messages[0], "\r\n..starts with a dot\r\n"));
+	mu_assert("Expected overflow count", strstr(s.messages[0], "... and 3 more\r\n"));
+
+	test_server_stop(&s);
+
+	return NULL;
+}
+
+static char *run_batch_test()
+{
+	test_server_t s;
+	catcierge_notify_t n;
+	catcierge_notify_settings_t settings;
+	char url[256];
+
+	mu_assert("Expected server to start", !test_server_start(&s, 0));
+
+	memset(&settings, 0, sizeof(settings));
+	settings.window = 0.2;
+	settings.interval = 2.0;
+	settings.timeout = 2;
+	settings.subject = "Cat door";
+	snprintf(url, sizeof(url), "http://127.0.0.1:%d/hook", s.port);
+	mu_assert("Expected target to parse",
+		!catcierge_notify_parse_target(url, &settings.targets[settings.target_count++]));
+
+	mu_assert("Expected notify to start", !catcierge_notify_init(&n, &settings));
+
+	// A burst of events gives one message after the window.
+	catcierge_notify_push(&n, strdup("first"));
+	catcierge_notify_push(&n, strdup("second \"quoted\""));
+	catcierge_notify_push(&n, strdup("third"));
+	mu_assert("Expected nothing sent during the window", test_server_count(&s) == 0);
+	usleep(500000);
+
+	mu_assert("Expected one message", test_server_count(&s) == 1);
+	catcierge_test_STATUS("Webhook: %s", s.messages[0]);
+	mu_assert("Expected all events in the message", !strcmp(s.messages[0],
+		"{\"subject\":\"Cat door (3 events)\",\"count\":3,\"dropped\":0,"
+		"\"events\":[\"first\",\"second \\\"quoted\\\"\",\"third\"]}"));
+
+	// Rate limited until the interval has passed.
+	catcierge_notify_push(&n, strdup("fourth"));
+	usleep(400000);
+	mu_assert("Expected the interval to hold back the next message",
+		test_server_count(&s) == 1);
+
+	// Pending events are sent when stopping.
+	catcierge_notify_destroy(&n);
+	mu_assert("Expected two messages", test_server_count(&s) == 2);
+	mu_assert("Expected the held back event",
+		!strcmp(s.messages[1], "{\"subject\":\"Cat door\",\"count\":1,"
+		"\"dropped\":0,\"events\":[\"fourth\"]}"));
+	mu_assert("Expected 4 events", n.event_count == 4);
+	mu_assert("Expected 2 sent", n.sent_count == 2);
+	mu_assert("Expected none failed", n.failed_count == 0);
+
+	// Failed deliveries are counted.
+	s.http_status = 500;
+	mu_assert("Expected notify to start", !catcierge_notify_init(&n, &settings));
+	catcierge_notify_push(&n, strdup("fifth"));
+	catcierge_notify_destroy(&n);
+	mu_assert("Expected 1 failed", n.failed_count == 1);
+
+	test_server_stop(&s);
+
+	return NULL;
+}
+
+#endif // CATCIERGE_HAVE_NOTIFY
+
+int TEST_catcierge_notify(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_parse_tests()),
+		"Notify targets",
+		"", &ret);
+
+	#ifdef CATCIERGE_HAVE_NOTIFY
+	CATCIERGE_RUN_TEST((e = run_smtp_test()),
+		"Notify over SMTP",
+		"", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_batch_test()),
+		"Notify batching and rate limit",
+		"", &ret);
+	#else
+	catcierge_test_SKIPPED("Notifications are not supported on this platform, skipping tests");
+	#endif
+
+	return ret;
+}
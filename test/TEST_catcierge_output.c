@@ -751,6 +751,115 @@ static char *run_grow_template_array_test()
 	return NULL;
 }
 
+static char *run_event_mask_test()
+{
+	catcierge_grb_t grb;
+	catcierge_output_t *o = &grb.output;
+	catcierge_args_t *args = &grb.args;
+
+	catcierge_grabber_init(&grb);
+	catcierge_args_init(args, "catcierge");
+	{
+		mu_assert("Expected match_done event",
+			catcierge_output_event_from_name("match_done") == CATCIERGE_MATCH_DONE);
+		mu_assert("Expected unknown event",
+			catcierge_output_event_from_name("arne") == -1);
+		mu_assert("Expected state_change name",
+			!strcmp(catcierge_output_event_name(CATCIERGE_STATE_CHANGE), "state_change"));
+
+		if (catcierge_output_init(&grb, o))
+			return "Failed to init output context";
+
+		mu_assert("Expected no subscribed events", o->event_mask == 0);
+
+		if (catcierge_output_add_template(o,
+			"%!event match_done, arne\n"
+			"%!nofile\n"
+			"Template contents",
+			"path_a"))
+		{
+			return "Failed to add template";
+		}
+
+		mu_assert("Expected match_done mask",
+			o->templates[0].event_mask == CATCIERGE_EVENT_BIT(CATCIERGE_MATCH_DONE));
+		mu_assert("Expected match_done to be subscribed",
+			catcierge_output_has_event(o, CATCIERGE_MATCH_DONE));
+		mu_assert("Expected state_change to not be subscribed",
+			!catcierge_output_has_event(o, CATCIERGE_STATE_CHANGE));
+
+		// Unknown event names still work through the string matching.
+		mu_assert("Expected template to be registered to arne",
+			catcierge_output_template_registered_to_event(&o->templates[0], "arne"));
+
+		if (catcierge_output_add_template(o,
+			"%!event *\n"
+			"%!nofile\n"
+			"Template contents",
+			"path_b"))
+		{
+			return "Failed to add template";
+		}
+
+		mu_assert("Expected all events mask",
+			o->templates[1].event_mask == CATCIERGE_EVENT_ALL);
+		mu_assert("Expected state_change to be subscribed",
+			catcierge_output_has_event(o, CATCIERGE_STATE_CHANGE));
+
+		catcierge_output_destroy(o);
+		mu_assert("Expected no subscribed events after destroy", o->event_mask == 0);
+	}
+	catcierge_args_destroy(args);
+	catcierge_grabber_destroy(&grb);
+
+	return NULL;
+}
+
+static char *run_render_scope_test()
+{
+	catcierge_grb_t grb;
+	catcierge_output_t *o = &grb.output;
+	catcierge_args_t *args = &grb.args;
+	char *a = NULL;
+	char *b = NULL;
+
+	catcierge_grabber_init(&grb);
+	catcierge_args_init(args, "catcierge");
+	{
+		if (do_init_matcher(&grb, MATCHER_TEMPLATE))
+			return "Failed to init matcher";
+
+		if (catcierge_output_init(&grb, o))
+			return "Failed to init output context";
+
+		catcierge_output_render_begin(o);
+		{
+			a = catcierge_output_generate(o, &grb, "%time:@s.@f% %cwd%");
+			mu_assert("Expected generate to succeed", a);
+			mu_assert("Expected remembered values", o->memo_count == 2);
+
+			b = catcierge_output_generate(o, &grb, "%time:@s.@f% %cwd%");
+			mu_assert("Expected generate to succeed", b);
+			catcierge_test_STATUS("'%s' '%s'", a, b);
+			mu_assert("Expected the same time in the same render", !strcmp(a, b));
+			mu_assert("Expected remembered values to be reused", o->memo_count == 2);
+		}
+		catcierge_output_render_end(o);
+
+		mu_assert("Expected render to be done", o->render_depth == 0);
+		mu_assert("Expected remembered values to be cleared", o->memo_count == 0);
+
+		free(a);
+		free(b);
+		catcierge_output_destroy(o);
+	}
+	catcierge_matcher_destroy(&grb.matcher);
+	catcierge_args_destroy(args);
+	catcierge_grabber_destroy(&grb);
+
+	return NULL;
+}
+
 static char *run_test_paths_test()
 {
 	int i;
@@ -1157,6 +1266,11 @@ char *run_for_loop_test()
 
 			"def\n");
 
+		TEST_GENERATE(
+			"%if 1 == 1%%match_group_max_count%%endif%\n",
+
+			"4\n");
+
 		TEST_GENERATE_FAIL(
 			"%if abc != def%\n"
 			"abc\n"
@@ -1308,6 +1422,14 @@ int TEST_catcierge_output(int argc, char **argv)
 		"Run grow template array tests.",
 		"Grow template array tests", &ret);
 
+	CATCIERGE_RUN_TEST((e = run_event_mask_test()),
+		"Run event mask tests.",
+		"Event mask tests", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_render_scope_test()),
+		"Run render scope tests.",
+		"Render scope tests", &ret);
+
 	CATCIERGE_RUN_TEST((e = run_test_paths_test()),
 		"Run path tests.",
 		"Path tests", &ret);
@@ -0,0 +1,153 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+#include "catcierge_publisher.h"
+#include "catcierge_util.h"
+#ifdef WITH_ZMQ
+#include <czmq.h>
+#endif
+
+static char *run_msg_tests()
+{
+	catcierge_zmq_images_t images;
+	catcierge_publisher_msg_t *msg;
+	char *data;
+	size_t i;
+
+	mu_assert("Expected raw to parse",
+		!catcierge_zmq_images_parse("raw", &images) && (images == CATCIERGE_ZMQ_IMAGES_RAW));
+	mu_assert("Expected png to parse",
+		!catcierge_zmq_images_parse("png", &images) && (images == CATCIERGE_ZMQ_IMAGES_PNG));
+	mu_assert("Expected jpg to fail", catcierge_zmq_images_parse("jpg", &images));
+	mu_assert("Expected qoi string",
+		!strcmp(catcierge_zmq_images_str(CATCIERGE_ZMQ_IMAGES_QOI), "qoi"));
+
+	// Copied data.
+	msg = catcierge_publisher_msg_create("topic", NULL, "abc", 3);
+	mu_assert("Expected message", msg);
+	mu_assert("Expected topic", !strcmp(msg->topic, "topic"));
+	mu_assert("Expected copied data", (msg->len == 3) && !strcmp(msg->data, "abc"));
+	catcierge_publisher_msg_free(msg);
+
+	// Owned data, the pointer is kept.
+	data = strdup("owned");
+	msg = catcierge_publisher_msg_create("topic", data, NULL, strlen(data));
+	mu_assert("Expected the data to be taken over", msg && (msg->data == data));
+
+	for (i = 0; i < MATCH_MAX_COUNT; i++)
+	{
+		mu_assert("Expected image to be added",
+			!catcierge_publisher_msg_add_image(msg, catcierge_test_create_image(8, 8, 1, 0)));
+	}
+
+	mu_assert("Expected too many images to fail",
+		catcierge_publisher_msg_add_image(msg, catcierge_test_create_image(8, 8, 1, 0)));
+	mu_assert("Expected max images", msg->image_count == MATCH_MAX_COUNT);
+	catcierge_publisher_msg_free(msg);
+
+	return NULL;
+}
+
+#ifdef WITH_ZMQ
+static char *run_publish_test()
+{
+	catcierge_publisher_t p;
+	catcierge_publisher_msg_t *msg;
+	zctx_t *ctx;
+	void *pub;
+	void *sub;
+	zmsg_t *zmsg;
+	zframe_t *frame;
+	char *str;
+	int port;
+	int hwm = 8;
+
+	mu_assert("Expected ZMQ context", (ctx = zctx_new()));
+	pub = zsocket_new(ctx, ZMQ_PUB);
+	sub = zsocket_new(ctx, ZMQ_SUB);
+	zmq_setsockopt(pub, ZMQ_SNDHWM, &hwm, sizeof(hwm));
+	mu_assert("Expected to bind", (port = zsocket_bind(pub, "tcp://127.0.0.1:*")) > 0);
+	mu_assert("Expected to connect", !zsocket_connect(sub, "tcp://127.0.0.1:%d", port));
+	zsocket_set_subscribe(sub, "");
+	zsocket_set_rcvtimeo(sub, 2000);
+
+	// Let the subscriber join before publishing.
+	zclock_sleep(200);
+
+	mu_assert("Expected publisher to start",
+		!catcierge_publisher_init(&p, pub, (size_t)hwm, CATCIERGE_ZMQ_IMAGES_RAW));
+
+	msg = catcierge_publisher_msg_create("event", NULL, "{\"a\":1}", 7);
+	mu_assert("Expected message to be queued", !catcierge_publisher_push(&p, msg));
+
+	msg = catcierge_publisher_msg_create(CATCIERGE_ZMQ_IMAGES_TOPIC, NULL, "{}", 2);
+	catcierge_publisher_msg_add_image(msg, catcierge_test_create_image(32, 24, 1, 7));
+	catcierge_publisher_msg_add_image(msg, catcierge_test_create_image(16, 12, 3, 9));
+	mu_assert("Expected image message to be queued", !catcierge_publisher_push(&p, msg));
+
+	// Topic and data.
+	mu_assert("Expected message", (zmsg = zmsg_recv(sub)));
+	mu_assert("Expected 2 frames", zmsg_size(zmsg) == 2);
+	str = zmsg_popstr(zmsg);
+	mu_assert("Expected topic", !strcmp(str, "event"));
+	free(str);
+	str = zmsg_popstr(zmsg);
+	mu_assert("Expected data", !strcmp(str, "{\"a\":1}"));
+	free(str);
+	zmsg_destroy(&zmsg);
+
+	// Topic, data, description and the images.
+	mu_assert("Expected image message", (zmsg = zmsg_recv(sub)));
+	catcierge_test_STATUS("Image message with %d frames", (int)zmsg_size(zmsg));
+	mu_assert("Expected 5 frames", zmsg_size(zmsg) == 5);
+	str = zmsg_popstr(zmsg);
+	mu_assert("Expected images topic", !strcmp(str, CATCIERGE_ZMQ_IMAGES_TOPIC));
+	free(str);
+	str = zmsg_popstr(zmsg);
+	free(str);
+	str = zmsg_popstr(zmsg);
+	catcierge_test_STATUS("Description:\n%s", str);
+	mu_assert("Expected image description", !strncmp(str, "raw\n32 24 1 32\n16 12 3 48\n", 26));
+	free(str);
+
+	frame = zmsg_pop(zmsg);
+	mu_assert("Expected gray image", zframe_size(frame) == 32 * 24);
+	mu_assert("Expected pixel value", zframe_data(frame)[0] == 7);
+	zframe_destroy(&frame);
+
+	frame = zmsg_pop(zmsg);
+	mu_assert("Expected color image", zframe_size(frame) == 16 * 12 * 3);
+	zframe_destroy(&frame);
+	zmsg_destroy(&zmsg);
+
+	catcierge_publisher_destroy(&p);
+	mu_assert("Expected 2 sent", p.sent_count == 2);
+	mu_assert("Expected none dropped", p.dropped_count == 0);
+
+	zctx_destroy(&ctx);
+
+	return NULL;
+}
+#endif // WITH_ZMQ
+
+int TEST_catcierge_publisher(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_msg_tests()),
+		"Publisher messages",
+		"", &ret);
+
+	#ifdef WITH_ZMQ
+	CATCIERGE_RUN_TEST((e = run_publish_test()),
+		"Publish multipart messages",
+		"", &ret);
+	#else
+	catcierge_test_SKIPPED("Compiled without ZMQ, skipping publish test");
+	#endif
+
+	return ret;
+}
@@ -0,0 +1,243 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+#include "catcierge_retention.h"
+#include "catcierge_util.h"
+#ifdef CATCIERGE_HAVE_RETENTION
+#include <sys/types.h>
+#include <utime.h>
+#endif
+
+#define TEST_RETENTION_DIR "retention_output"
+
+static char *run_parse_tests()
+{
+	catcierge_retention_class_t cls;
+	catcierge_retention_quota_t quota;
+	char *s;
+
+	mu_assert("Expected quota to parse",
+		!catcierge_retention_parse_quota("steps:500:7", &cls, &quota));
+	mu_assert("Expected steps", cls == CATCIERGE_RETAIN_STEPS);
+	mu_assert("Expected 500 MB", quota.max_size == 500ULL * 1024 * 1024);
+	mu_assert("Expected 7 days", quota.max_age == 7);
+
+	mu_assert("Expected quota to parse",
+		!catcierge_retention_parse_quota("templates:0:30", &cls, &quota));
+	mu_assert("Expected templates", cls == CATCIERGE_RETAIN_TEMPLATES);
+	mu_assert("Expected no size limit", quota.max_size == 0);
+
+	mu_assert("Expected unknown class to fail",
+		catcierge_retention_parse_quota("images:1:1", &cls, &quota));
+	mu_assert("Expected missing days to fail",
+		catcierge_retention_parse_quota("match:1", &cls, &quota));
+	mu_assert("Expected negative size to fail",
+		catcierge_retention_parse_quota("match:-1:1", &cls, &quota));
+	mu_assert("Expected trailing garbage to fail",
+		catcierge_retention_parse_quota("match:1:1d", &cls, &quota));
+
+	s = catcierge_retention_root("/media/sd/cat/%time:@Y-@m%/steps", NULL);
+	catcierge_test_STATUS("Root: %s", s);
+	mu_assert("Expected root before the variable", !strcmp(s, "/media/sd/cat"));
+	free(s);
+
+	s = catcierge_retention_root("/media/sd/cat/img_%time%", NULL);
+	mu_assert("Expected root without the partial name", !strcmp(s, "/media/sd/cat"));
+	free(s);
+
+	s = catcierge_retention_root("%output_path%/steps", "/media/sd");
+	mu_assert("Expected fallback root", !strcmp(s, "/media/sd"));
+	free(s);
+
+	s = catcierge_retention_root("output", NULL);
+	mu_assert("Expected the path itself", !strcmp(s, "output"));
+	free(s);
+
+	s = catcierge_retention_pattern("%output_path%/event_%time:@Y-@m-@d @H:@M%.json");
+	catcierge_test_STATUS("Pattern: %s", s);
+	mu_assert("Expected pattern", s && !strcmp(s, "event_*.json"));
+	free(s);
+
+	mu_assert("Expected too generic pattern to be refused",
+		!catcierge_retention_pattern("%match_group_id%.%ext%"));
+
+	return NULL;
+}
+
+static char *run_classify_tests()
+{
+	catcierge_retention_settings_t settings;
+	memset(&settings, 0, sizeof(settings));
+	settings.template_patterns[0] = "event_*.json";
+	settings.template_pattern_count = 1;
+
+	mu_assert("Expected match",
+		catcierge_retention_classify(&settings,
+			"match__2026-10-19_10_00_00.123456__1.png") == CATCIERGE_RETAIN_MATCH);
+	mu_assert("Expected failed match",
+		catcierge_retention_classify(&settings,
+			"match_fail_2026-10-19_10_00_00.123456__4.qoi") == CATCIERGE_RETAIN_MATCH);
+	mu_assert("Expected step",
+		catcierge_retention_classify(&settings,
+			"match__2026-10-19_10_00_00.123456__1_03_threshold.pgm") == CATCIERGE_RETAIN_STEPS);
+	mu_assert("Expected obstruct",
+		catcierge_retention_classify(&settings,
+			"match_obstruct_2026-10-19_10_00_00.123456.png") == CATCIERGE_RETAIN_OBSTRUCT);
+	mu_assert("Expected template",
+		catcierge_retention_classify(&settings,
+			"event_2026-10-19.json") == CATCIERGE_RETAIN_TEMPLATES);
+
+	mu_assert("Expected other image to be left alone",
+		catcierge_retention_classify(&settings, "cat.png") < 0);
+	mu_assert("Expected archive to be left alone",
+		catcierge_retention_classify(&settings,
+			"match__2026-10-19_10_00_00.123456__1.cca") < 0);
+	mu_assert("Expected other file to be left alone",
+		catcierge_retention_classify(&settings, "notes.txt") < 0);
+
+	return NULL;
+}
+
+#ifdef CATCIERGE_HAVE_RETENTION
+static void create_file(const char *name, size_t size, int days_old)
+{
+	char path[256];
+	struct utimbuf times;
+	FILE *f;
+
+	snprintf(path, sizeof(path), TEST_RETENTION_DIR "/%s", name);
+
+	if ((f = fopen(path, "wb")))
+	{
+		while (size--)
+			fputc('x', f);
+		fclose(f);
+	}
+
+	times.actime = time(NULL) - (days_old * 24 * 60 * 60) - 60;
+	times.modtime = times.actime;
+	utime(path, &times);
+}
+
+static int file_exists(const char *name)
+{
+	char path[256];
+	FILE *f;
+
+	snprintf(path, sizeof(path), TEST_RETENTION_DIR "/%s", name);
+
+	if (!(f = fopen(path, "rb")))
+		return 0;
+
+	fclose(f);
+	return 1;
+}
+
+static char *run_pass_test()
+{
+	catcierge_retention_t r;
+	catcierge_retention_stats_t stats;
+	catcierge_retention_settings_t settings;
+	int i;
+
+	catcierge_make_path("%s", TEST_RETENTION_DIR "/steps");
+
+	create_file("match__old__1.png", 100, 10);
+	create_file("match__new__1.png", 100, 0);
+	create_file("match_obstruct_old.png", 100, 100);
+	create_file("steps/match__a__1_00_x.png", 100, 3);
+	create_file("steps/match__b__1_00_x.png", 100, 2);
+	create_file("steps/match__c__1_00_x.png", 100, 1);
+	create_file("event_old.json", 10, 40);
+	create_file("notes.txt", 10, 1000);
+
+	memset(&settings, 0, sizeof(settings));
+	settings.interval = 60;
+	settings.idle_time = 60;
+
+	for (i = 0; i < CATCIERGE_RETAIN_CLASS_COUNT; i++)
+		settings.roots[i] = TEST_RETENTION_DIR;
+
+	settings.roots[CATCIERGE_RETAIN_STEPS] = TEST_RETENTION_DIR "/steps";
+	settings.template_patterns[0] = "event_*.json";
+	settings.template_pattern_count = 1;
+	settings.quotas[CATCIERGE_RETAIN_MATCH].max_age = 7;
+	settings.quotas[CATCIERGE_RETAIN_STEPS].max_size = 250;
+	settings.quotas[CATCIERGE_RETAIN_TEMPLATES].max_age = 30;
+
+	mu_assert("Expected zero interval to fail",
+		(settings.interval = 0, catcierge_retention_init(&r, &settings)));
+	settings.interval = 60;
+
+	mu_assert("Expected retention init to succeed", !catcierge_retention_init(&r, &settings));
+	mu_assert("Expected pass to succeed", !catcierge_retention_pass(&r));
+
+	catcierge_test_STATUS("match %lu files %llu bytes, steps %lu files %llu bytes, %llu free",
+		r.usage[CATCIERGE_RETAIN_MATCH].files, r.usage[CATCIERGE_RETAIN_MATCH].bytes,
+		r.usage[CATCIERGE_RETAIN_STEPS].files, r.usage[CATCIERGE_RETAIN_STEPS].bytes,
+		r.disk_free);
+
+	mu_assert("Expected old match to be removed", !file_exists("match__old__1.png"));
+	mu_assert("Expected new match to be kept", file_exists("match__new__1.png"));
+	mu_assert("Expected obstruct without quota to be kept", file_exists("match_obstruct_old.png"));
+	mu_assert("Expected oldest step to be removed", !file_exists("steps/match__a__1_00_x.png"));
+	mu_assert("Expected newer steps to be kept",
+		file_exists("steps/match__b__1_00_x.png") && file_exists("steps/match__c__1_00_x.png"));
+	mu_assert("Expected old template to be removed", !file_exists("event_old.json"));
+	mu_assert("Expected other file to be kept", file_exists("notes.txt"));
+
+	mu_assert("Expected 1 match left", r.usage[CATCIERGE_RETAIN_MATCH].files == 1);
+	mu_assert("Expected 200 bytes of steps", r.usage[CATCIERGE_RETAIN_STEPS].bytes == 200);
+	mu_assert("Expected 1 match removed", r.usage[CATCIERGE_RETAIN_MATCH].deleted_count == 1);
+	mu_assert("Expected 1 step removed", r.usage[CATCIERGE_RETAIN_STEPS].deleted_count == 1);
+
+	// Nothing more to do the second time.
+	mu_assert("Expected pass to succeed", !catcierge_retention_pass(&r));
+	mu_assert("Expected still 1 step removed", r.usage[CATCIERGE_RETAIN_STEPS].deleted_count == 1);
+	mu_assert("Expected 2 passes", r.pass_count == 2);
+
+	catcierge_retention_stats(&r, &stats);
+	mu_assert("Expected the stats of the latest pass",
+		(stats.pass_count == 2)
+		&& (stats.usage[CATCIERGE_RETAIN_MATCH].files == 1)
+		&& (stats.usage[CATCIERGE_RETAIN_STEPS].bytes == 200)
+		&& (stats.disk_free == r.disk_free));
+
+	catcierge_retention_destroy(&r);
+
+	remove(TEST_RETENTION_DIR "/match__new__1.png");
+	remove(TEST_RETENTION_DIR "/match_obstruct_old.png");
+	remove(TEST_RETENTION_DIR "/steps/match__b__1_00_x.png");
+	remove(TEST_RETENTION_DIR "/steps/match__c__1_00_x.png");
+	remove(TEST_RETENTION_DIR "/notes.txt");
+
+	return NULL;
+}
+#endif // CATCIERGE_HAVE_RETENTION
+
+int TEST_catcierge_retention(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_parse_tests()),
+		"Retention settings",
+		"", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_classify_tests()),
+		"Retention file classes",
+		"", &ret);
+
+	#ifdef CATCIERGE_HAVE_RETENTION
+	CATCIERGE_RUN_TEST((e = run_pass_test()),
+		"Retention quotas",
+		"", &ret);
+	#else
+	catcierge_test_SKIPPED("Retention is not supported on this platform, skipping tests");
+	#endif
+
+	return ret;
+}
@@ -0,0 +1,125 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "catcierge_serialize.h"
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+
+static void write_event(catcierge_serializer_t *s)
+{
+	catcierge_serialize_map_begin(s, 4);
+	catcierge_serialize_kv_str(s, "id", "abc");
+	catcierge_serialize_kv_int(s, "count", 300);
+	catcierge_serialize_kv_bool(s, "success", 1);
+	catcierge_serialize_key(s, "list");
+	catcierge_serialize_array_begin(s, 2);
+	catcierge_serialize_int(s, -1);
+	catcierge_serialize_nil(s);
+	catcierge_serialize_array_end(s);
+	catcierge_serialize_map_end(s);
+}
+
+static char *run_json_tests()
+{
+	catcierge_serializer_t s;
+	const char *expected = "{\"id\":\"abc\",\"count\":300,\"success\":true,\"list\":[-1,null]}";
+
+	catcierge_serializer_init(&s, CATCIERGE_FORMAT_JSON);
+	write_event(&s);
+	catcierge_test_STATUS("%s", s.buf);
+	mu_assert("Expected no error", !s.error);
+	mu_assert("Unexpected JSON output", !strcmp(s.buf, expected));
+	mu_assert("Expected length to match", s.len == strlen(expected));
+
+	// The buffer is reused.
+	catcierge_serializer_reset(&s, CATCIERGE_FORMAT_JSON);
+	catcierge_serialize_str(&s, "a \"quoted\"\\ line\nnext\ttab\x01");
+	catcierge_test_STATUS("%s", s.buf);
+	mu_assert("Expected no error", !s.error);
+	mu_assert("Unexpected JSON escaping",
+		!strcmp(s.buf, "\"a \\\"quoted\\\"\\\\ line\\nnext\\ttab\\u0001\""));
+
+	catcierge_serializer_reset(&s, CATCIERGE_FORMAT_JSON);
+	catcierge_serialize_map_begin(&s, 1);
+	catcierge_serialize_int(&s, 1);
+	mu_assert("Expected error for a value without a key", s.error);
+
+	catcierge_serializer_reset(&s, CATCIERGE_FORMAT_JSON);
+	catcierge_serialize_array_begin(&s, 0);
+	catcierge_serialize_map_end(&s);
+	mu_assert("Expected error for unbalanced array", s.error);
+
+	catcierge_serializer_destroy(&s);
+
+	return NULL;
+}
+
+static char *run_msgpack_tests()
+{
+	catcierge_serializer_t s;
+	const unsigned char expected[] =
+	{
+		0x84,
+		0xa2, 'i', 'd', 0xa3, 'a', 'b', 'c',
+		0xa5, 'c', 'o', 'u', 'n', 't', 0xcd, 0x01, 0x2c,
+		0xa7, 's', 'u', 'c', 'c', 'e', 's', 's', 0xc3,
+		0xa4, 'l', 'i', 's', 't', 0x92, 0xff, 0xc0
+	};
+
+	catcierge_serializer_init(&s, CATCIERGE_FORMAT_MSGPACK);
+	write_event(&s);
+	mu_assert("Expected no error", !s.error);
+	mu_assert("Unexpected MessagePack length", s.len == sizeof(expected));
+	mu_assert("Unexpected MessagePack output", !memcmp(s.buf, expected, sizeof(expected)));
+
+	catcierge_serializer_reset(&s, CATCIERGE_FORMAT_MSGPACK);
+	catcierge_serialize_double(&s, 1.5);
+	mu_assert("Expected float64", (s.len == 9) && ((unsigned char)s.buf[0] == 0xcb));
+	mu_assert("Expected big endian 1.5", ((unsigned char)s.buf[1] == 0x3f)
+										&& ((unsigned char)s.buf[2] == 0xf8));
+
+	// The count is part of the MessagePack output, so it has to match.
+	catcierge_serializer_reset(&s, CATCIERGE_FORMAT_MSGPACK);
+	catcierge_serialize_array_begin(&s, 2);
+	catcierge_serialize_int(&s, 1);
+	catcierge_serialize_array_end(&s);
+	mu_assert("Expected error for count mismatch", s.error);
+
+	catcierge_serializer_destroy(&s);
+
+	return NULL;
+}
+
+static char *run_format_name_tests()
+{
+	catcierge_serialize_format_t format = CATCIERGE_FORMAT_TEXT;
+
+	mu_assert("Expected json", !catcierge_serialize_format_from_name("json", &format)
+								&& (format == CATCIERGE_FORMAT_JSON));
+	mu_assert("Expected msgpack", !catcierge_serialize_format_from_name("msgpack", &format)
+								&& (format == CATCIERGE_FORMAT_MSGPACK));
+	mu_assert("Expected unknown format to fail",
+		catcierge_serialize_format_from_name("xml", &format));
+
+	return NULL;
+}
+
+int TEST_catcierge_serialize(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_json_tests()),
+		"Serialize JSON",
+		"", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_msgpack_tests()),
+		"Serialize MessagePack",
+		"", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_format_name_tests()),
+		"Serialize format names",
+		"", &ret);
+
+	return ret;
+}
@@ -0,0 +1,198 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+#include "catcierge_staging.h"
+#include "catcierge_util.h"
+#ifdef CATCIERGE_HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#define TEST_STAGING_DIR "staging_output"
+
+static int file_has_contents(const char *path, const char *contents)
+{
+	char buf[256];
+	size_t len;
+	FILE *f;
+
+	if (!(f = fopen(path, "rb")))
+	{
+		return 0;
+	}
+
+	len = fread(buf, 1, sizeof(buf) - 1, f);
+	buf[len] = '\0';
+	fclose(f);
+
+	return !strcmp(buf, contents);
+}
+
+static char *run_flush_test()
+{
+	catcierge_staging_t st;
+	char path[256];
+	char data[64];
+	int i;
+
+	mu_assert("Expected zero staging size to fail",
+		catcierge_staging_init(&st, 0, 10, CATCIERGE_FSYNC_NEVER));
+	mu_assert("Expected zero flush interval to fail",
+		catcierge_staging_init(&st, 1024, 0, CATCIERGE_FSYNC_NEVER));
+
+	// Long interval so nothing is flushed until destroyed.
+	mu_assert("Expected staging init to succeed",
+		!catcierge_staging_init(&st, 1024 * 1024, CATCIERGE_MAX_FLUSH_INTERVAL,
+			CATCIERGE_FSYNC_BATCH));
+
+	for (i = 0; i < 10; i++)
+	{
+		snprintf(path, sizeof(path), TEST_STAGING_DIR "/sub/file_%d.txt", i);
+		snprintf(data, sizeof(data), "file %d", i);
+		remove(path);
+		mu_assert("Expected write to succeed",
+			!catcierge_staging_write(&st, path, data, strlen(data)));
+	}
+
+	mu_assert("Expected 10 staged", st.staged_count == 10);
+	mu_assert("Expected nothing on disk before flush",
+		!file_has_contents(TEST_STAGING_DIR "/sub/file_0.txt", "file 0"));
+
+	catcierge_staging_destroy(&st);
+
+	catcierge_test_STATUS("%lu flushed, %lu batches, %llu bytes",
+		st.flushed_count, st.batch_count, st.bytes_flushed);
+	mu_assert("Expected 10 flushed", st.flushed_count == 10);
+	mu_assert("Expected a single batch", st.batch_count == 1);
+	mu_assert("Expected nothing left staged", (st.size == 0) && !st.head);
+
+	for (i = 0; i < 10; i++)
+	{
+		snprintf(path, sizeof(path), TEST_STAGING_DIR "/sub/file_%d.txt", i);
+		snprintf(data, sizeof(data), "file %d", i);
+		mu_assert("Expected flushed file contents", file_has_contents(path, data));
+		remove(path);
+	}
+
+	return NULL;
+}
+
+static char *run_flush_now_test()
+{
+	catcierge_staging_t st;
+	const char *path = TEST_STAGING_DIR "/now.txt";
+	int i;
+
+	remove(path);
+
+	mu_assert("Expected staging init to succeed",
+		!catcierge_staging_init(&st, 1024, CATCIERGE_MAX_FLUSH_INTERVAL,
+			CATCIERGE_FSYNC_FILE));
+
+	mu_assert("Expected add to succeed",
+		!catcierge_staging_add(&st, path, strdup("now"), 3));
+	catcierge_staging_flush(&st);
+
+	for (i = 0; i < 200; i++)
+	{
+		if (file_has_contents(path, "now"))
+			break;
+
+		usleep(10000);
+	}
+
+	mu_assert("Expected file to be flushed", file_has_contents(path, "now"));
+
+	catcierge_staging_destroy(&st);
+	remove(path);
+
+	return NULL;
+}
+
+static char *run_bypass_test()
+{
+	catcierge_staging_t st;
+	const char *big_path = TEST_STAGING_DIR "/big.txt";
+	const char *direct_path = TEST_STAGING_DIR "/direct.txt";
+	char big[33];
+
+	remove(big_path);
+	remove(direct_path);
+
+	// Not running, written right away.
+	memset(&st, 0, sizeof(st));
+	mu_assert("Expected direct write to succeed",
+		!catcierge_staging_write(&st, direct_path, "direct", 6));
+	mu_assert("Expected file to be written directly",
+		file_has_contents(direct_path, "direct"));
+
+	mu_assert("Expected staging init to succeed",
+		!catcierge_staging_init(&st, 16, CATCIERGE_MAX_FLUSH_INTERVAL,
+			CATCIERGE_FSYNC_NEVER));
+
+	// Larger than the cap, written right away.
+	memset(big, 'x', sizeof(big) - 1);
+	big[sizeof(big) - 1] = '\0';
+	mu_assert("Expected write to succeed",
+		!catcierge_staging_write(&st, big_path, big, strlen(big)));
+	mu_assert("Expected 1 bypassed", st.bypassed_count == 1);
+	mu_assert("Expected big file to be written directly",
+		file_has_contents(big_path, big));
+
+	catcierge_staging_destroy(&st);
+	mu_assert("Expected nothing flushed", st.flushed_count == 0);
+
+	remove(big_path);
+	remove(direct_path);
+
+	return NULL;
+}
+
+static char *run_fsync_policy_test()
+{
+	catcierge_fsync_policy_t policy;
+
+	mu_assert("Expected never", !catcierge_fsync_policy_parse("never", &policy)
+		&& (policy == CATCIERGE_FSYNC_NEVER));
+	mu_assert("Expected batch", !catcierge_fsync_policy_parse("batch", &policy)
+		&& (policy == CATCIERGE_FSYNC_BATCH));
+	mu_assert("Expected file", !catcierge_fsync_policy_parse("file", &policy)
+		&& (policy == CATCIERGE_FSYNC_FILE));
+	mu_assert("Expected invalid policy to fail",
+		catcierge_fsync_policy_parse("sometimes", &policy));
+	mu_assert("Expected policy name",
+		!strcmp(catcierge_fsync_policy_str(CATCIERGE_FSYNC_FILE), "file"));
+
+	return NULL;
+}
+
+int TEST_catcierge_staging(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	catcierge_make_path("%s", TEST_STAGING_DIR);
+
+	CATCIERGE_RUN_TEST((e = run_fsync_policy_test()),
+		"Staging fsync policy",
+		"", &ret);
+
+	#ifdef CATCIERGE_HAVE_PTHREAD_H
+	CATCIERGE_RUN_TEST((e = run_flush_test()),
+		"Staging flush",
+		"", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_flush_now_test()),
+		"Staging flush now",
+		"", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_bypass_test()),
+		"Staging bypass",
+		"", &ret);
+	#else
+	catcierge_test_SKIPPED("Staging needs pthreads, skipping tests");
+	#endif
+
+	return ret;
+}
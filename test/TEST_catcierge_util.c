@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "catcierge_util.h"
 #include "catcierge_log.h"
 #include "minunit.h"
@@ -91,6 +92,63 @@ static char *run_make_path_tests()
 	return NULL;
 }
 
+static char *run_dir_cache_tests()
+{
+	catcierge_dir_cache_t cache;
+	char dir[64];
+	int i;
+
+	memset(&cache, 0, sizeof(cache));
+
+	mu_assert("Expected empty dir to succeed", !catcierge_dir_cache_make_path(&cache, ""));
+	mu_assert("Expected empty dir to not be cached", !cache.dirs[0]);
+
+	mu_assert("Expected dir to be created",
+		!catcierge_dir_cache_make_path(&cache, "dir_cache/a/b"));
+	mu_assert("Expected dir to be cached",
+		cache.dirs[0] && !strcmp(cache.dirs[0], "dir_cache/a/b"));
+
+	// Already cached, so it's not created again.
+	mu_assert("Expected cached dir to succeed",
+		!catcierge_dir_cache_make_path(&cache, "dir_cache/a/b"));
+	mu_assert("Expected dir to be cached once", !cache.dirs[1]);
+
+	// The oldest one is replaced when full.
+	for (i = 0; i < CATCIERGE_DIR_CACHE_SIZE; i++)
+	{
+		snprintf(dir, sizeof(dir), "dir_cache/%d", i);
+		mu_assert("Expected dir to be created", !catcierge_dir_cache_make_path(&cache, dir));
+	}
+
+	mu_assert("Expected the oldest dir to be replaced",
+		!strcmp(cache.dirs[0], "dir_cache/15") && (cache.next == 1));
+
+	catcierge_dir_cache_destroy(&cache);
+	mu_assert("Expected dirs to be freed", !cache.dirs[0] && !cache.next);
+
+	return NULL;
+}
+
+static char *run_parse_time_tests()
+{
+	uint64_t date;
+	uint64_t t;
+	uint64_t t2;
+
+	mu_assert("Expected date to parse", !catcierge_parse_time("2015-03-04", &date));
+	mu_assert("Expected date and time to parse", !catcierge_parse_time("2015-03-04 01:02:03", &t));
+	mu_assert("Expected date and time with T to parse", !catcierge_parse_time("2015-03-04T01:02:03", &t2));
+	mu_assert("Expected the same time with and without T", t == t2);
+	mu_assert("Expected the time of day to be added",
+		(t - date) == (uint64_t)((1 * 3600 + 2 * 60 + 3) * 1000000ULL));
+
+	mu_assert("Expected missing day to fail", catcierge_parse_time("2015-03", &t));
+	mu_assert("Expected missing seconds to fail", catcierge_parse_time("2015-03-04 01:02", &t));
+	mu_assert("Expected garbage to fail", catcierge_parse_time("yesterday", &t));
+
+	return NULL;
+}
+
 int TEST_catcierge_util(int argc, char *argv[])
 {
 	int ret = 0;
@@ -104,6 +162,14 @@ int TEST_catcierge_util(int argc, char *argv[])
 		"catcierge_make_path tests",
 		"catcierge_make_path tests", &ret);
 
+	CATCIERGE_RUN_TEST((e = run_dir_cache_tests()),
+		"catcierge_dir_cache tests",
+		"catcierge_dir_cache tests", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_parse_time_tests()),
+		"catcierge_parse_time tests",
+		"catcierge_parse_time tests", &ret);
+
 	CATCIERGE_RUN_TEST((e = run_test_catcierge_relative_path()),
 		"catcierge_relative_path",
 		"catcierge_relative_path", &ret);
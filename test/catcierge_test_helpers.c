@@ -264,4 +264,14 @@ void *catcierge_test_realloc(void *ptr, size_t sz)
 	return realloc(ptr, sz);
 }
 
+IplImage *catcierge_test_create_image(int width, int height, int channels, int val)
+{
+	IplImage *img;
+
+	if (!(img = cvCreateImage(cvSize(width, height), IPL_DEPTH_8U, channels)))
+		return NULL;
 
+	cvSet(img, cvScalarAll(val), NULL);
+
+	return img;
+}
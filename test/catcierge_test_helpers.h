@@ -34,6 +34,9 @@ void *catcierge_test_malloc(size_t sz);
 void catcierge_test_set_realloc_fail_count(int count);
 void *catcierge_test_realloc(void *ptr, size_t sz);
 
+// An 8-bit image with all pixels set to val.
+IplImage *catcierge_test_create_image(int width, int height, int channels, int val);
+
 #define CATCIERGE_RUN_TEST(err, headline, success, ret) \
 	do \
 	{ \